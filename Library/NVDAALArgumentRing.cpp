@@ -0,0 +1,176 @@
+/*
+ * NVDAALArgumentRing.cpp - Kernel Arguments and Launches on a Stream
+ */
+
+#include "NVDAALArgumentRing.h"
+#include "NVDAALPushbuffer.h"
+#include <cstring>
+#include <iostream>
+
+namespace nvdaal {
+
+// ============================================================================
+// Bank 0
+// ============================================================================
+
+void packConstantBank0(void *dst, const QmdTemplate& qmd, uint32_t gridX, uint32_t gridY, uint32_t gridZ,
+                       void *const *args) {
+    const Kernel *kernel = qmd.kernel();
+    uint8_t *out = (uint8_t *)dst;
+    uint32_t bytes = qmd.paramBankBytes();
+    uint32_t cursor = 0;
+
+    if (kernel->paramBase >= kBank0GridDim + 12) {
+        const uint32_t *q = qmd.words();
+        uint32_t shape[6] = { qmd::CtaThreadDimension0::get(q), qmd::CtaThreadDimension1::get(q),
+                              qmd::CtaThreadDimension2::get(q), gridX, gridY, gridZ };
+        memcpy(out + kBank0BlockDim, shape, sizeof(shape));
+        cursor = kBank0BlockDim + sizeof(shape);
+    }
+
+    // Parameters in signature order; the gaps before each are zeroed as
+    // the cursor passes them
+    for (uint32_t i = 0; i < kernel->paramCount; i++) {
+        const KernelParam& p = kernel->params[i];
+        uint32_t offset = kernel->paramBase + p.offset;
+        if (offset > cursor) memset(out + cursor, 0, offset - cursor);
+        memcpy(out + offset, args[p.ordinal], p.size);
+        if (offset + p.size > cursor) cursor = offset + p.size;
+    }
+    if (bytes > cursor) memset(out + cursor, 0, bytes - cursor);
+}
+
+// ============================================================================
+// ArgumentRing
+// ============================================================================
+
+ArgumentRing::ArgumentRing(Stream& stream, BufferAllocator& allocator, size_t bytes)
+    : owner(&stream), client(stream.getClient()), size(0), head(0), tail(0), completed(0),
+      retires(kMaxRetires), retireHead(0), retireCount(0), counters() {
+    bytes = (bytes + kArgAlign - 1) & ~(size_t)(kArgAlign - 1);
+    if (!stream.valid() || bytes == 0) return;
+    buffer = allocator.allocate(bytes);
+    if (!buffer.gpuAddr() || !buffer.cpu()) {
+        std::cerr << "[libNVDAAL] ArgumentRing: could not map " << bytes << " bytes" << std::endl;
+        buffer.reset();
+        return;
+    }
+    size = bytes;
+}
+
+ArgumentRing::~ArgumentRing() {
+    if (!valid() || retireCount == 0) return;
+    uint64_t last = owner->submitted();
+    if (last > completed && !client->waitSemaphore(owner->timeline(), last, 5000)) {
+        std::cerr << "[libNVDAAL] ArgumentRing: launches still running at destruction" << std::endl;
+    }
+}
+
+// A record closes at the first look after the stream has submitted past
+// it: by contract, whatever reads its blocks is in by then
+bool ArgumentRing::close(Retire& r) {
+    if (r.value) return true;
+    uint64_t submitted = owner->submitted();
+    if (submitted <= r.since) return false;
+    r.value = submitted;
+    return true;
+}
+
+bool ArgumentRing::retireOldest() {
+    Retire& r = retires[retireHead];
+    if (!close(r)) {
+        std::cerr << "[libNVDAAL] ArgumentRing: full of blocks nothing was submitted for" << std::endl;
+        return false;
+    }
+    if (r.value > completed) {
+        counters.timelineReads++;
+        if (!client->readSemaphore(owner->timeline(), &completed)) return false;
+        if (r.value > completed) {
+            counters.stalls++;
+            if (!client->waitSemaphore(owner->timeline(), r.value, 5000)) return false;
+            completed = r.value;
+        }
+    }
+    tail = r.end;
+    retireHead = (retireHead + 1) % kMaxRetires;
+    retireCount--;
+    return true;
+}
+
+bool ArgumentRing::allocate(uint32_t bytes, ArgBlock *out) {
+    uint64_t need = ((uint64_t)bytes + kArgAlign - 1) & ~(uint64_t)(kArgAlign - 1);
+    if (!valid() || !out || need == 0 || need > size) {
+        counters.failures++;
+        return false;
+    }
+
+    Retire *last = retireCount ? &retires[(retireHead + retireCount - 1) % kMaxRetires] : nullptr;
+    if (last) close(*last);
+    bool extend = last && !last->value;
+
+    // A block never straddles the end: skip what is left there
+    uint64_t skip = head % size + need > size ? size - head % size : 0;
+    while (size - (head - tail) < skip + need || (!extend && retireCount == kMaxRetires)) {
+        if (retireCount == 0) {                  // Empty: start over at the front
+            head += skip;
+            tail = head;
+            skip = 0;
+            continue;
+        }
+        if (!retireOldest()) {
+            counters.failures++;
+            return false;
+        }
+        if (retireCount == 0) extend = false;
+    }
+    head += skip;
+    uint64_t offset = head % size;
+    if (offset == 0 && head) counters.wraps++;
+    head += need;
+
+    if (extend) {
+        retires[(retireHead + retireCount - 1) % kMaxRetires].end = head;
+    } else {
+        retires[(retireHead + retireCount) % kMaxRetires] = { head, owner->submitted(), 0 };
+        retireCount++;
+    }
+
+    out->cpu = (uint8_t *)buffer.cpu() + offset;
+    out->gpuAddr = buffer.gpuAddr() + offset;
+    out->bytes = (uint32_t)need;
+    counters.blocks++;
+    counters.bytes += need;
+    return true;
+}
+
+bool ArgumentRing::launch(const QmdTemplate& qmd, uint32_t gridX, uint32_t gridY, uint32_t gridZ,
+                          void *const *args, bool ordered) {
+    if (!qmd.valid() || (qmd.kernel()->paramCount && !args) || owner->copyEngine()) {
+        counters.failures++;
+        return false;
+    }
+    uint32_t bank0 = (qmd.paramBankBytes() + kArgAlign - 1) & ~(kArgAlign - 1);
+    ArgBlock block;
+    if (!allocate(bank0 + kQmdBytes + kPushbufferBytes, &block)) return false;
+
+    uint8_t *cpu = (uint8_t *)block.cpu;
+    uint64_t qmdAddr = block.gpuAddr + bank0;
+    uint64_t pbAddr = qmdAddr + kQmdBytes;
+    packConstantBank0(cpu, qmd, gridX, gridY, gridZ, args);
+    if (!qmd.encode(cpu + bank0, gridX, gridY, gridZ, block.gpuAddr)) {
+        counters.failures++;
+        return false;
+    }
+
+    NvPushbuffer pb;
+    nvPbInit(&pb, cpu + bank0 + kQmdBytes, kPushbufferBytes);
+    if ((ordered && !nvPbPushBarrier(&pb)) || !nvPbPushDispatch(&pb, qmdAddr) ||
+        !owner->submit(pbAddr, (uint32_t)nvPbBytesUsed(&pb))) {
+        counters.failures++;
+        return false;
+    }
+    counters.launches++;
+    return true;
+}
+
+} // namespace nvdaal
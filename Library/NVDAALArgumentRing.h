@@ -0,0 +1,116 @@
+/*
+ * NVDAALArgumentRing.h - Kernel Arguments and Launches on a Stream
+ *
+ * Every launch needs constant bank 0 in VRAM: the block and grid
+ * dimensions kernels read from it, then the parameter block at the
+ * cubin's paramBase (NVDAALModule.h). ArgumentRing keeps one mapped Buffer
+ * per Stream and bump-allocates those banks from it, together with the
+ * launch's QMD (NVDAALQmd.h) and the few dwords of pushbuffer that
+ * dispatch it, so a launch is written into VRAM in one pass and submitted
+ * as one pushbuffer: no allocation and no driver call beyond the submit.
+ *
+ * Space is reclaimed by the stream's timeline: a block is free once all
+ * that was submitted to the stream before the ring's next allocation has
+ * completed, so submit the work that reads a block before allocating
+ * another. The ring reads the timeline only when it runs out of room, and
+ * waits only when the oldest launches still hold the space it needs.
+ *
+ * Parameters are given as cuLaunchKernel takes them: args[i] points at
+ * the value of parameter i, whose size and offset come from the cubin.
+ * One thread at a time per ring; keep the Stream alive as long as it.
+ */
+
+#ifndef LIB_NVDAAL_ARGUMENT_RING_H
+#define LIB_NVDAAL_ARGUMENT_RING_H
+
+#include "NVDAALQmd.h"
+#include "NVDAALStream.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace nvdaal {
+
+// Where sm_80+ kernels read their launch shape in bank 0
+static const uint32_t kBank0BlockDim = 0x00;    // ntid.x, .y, .z
+static const uint32_t kBank0GridDim = 0x0C;     // nctaid.x, .y, .z
+
+// Bank 0's image for a launch, qmd.paramBankBytes() long, written front
+// to back (dst may be write-combined): launch shape, zeros up to the
+// kernel's paramBase, then args[i] at parameter i's offset
+void packConstantBank0(void *dst, const QmdTemplate& qmd, uint32_t gridX, uint32_t gridY, uint32_t gridZ,
+                       void *const *args);
+
+struct ArgBlock {
+    void *cpu;                                   // Mapped; write only
+    uint64_t gpuAddr;                            // kArgAlign aligned
+    uint32_t bytes;
+};
+
+struct ArgumentRingStats {
+    uint64_t launches;
+    uint64_t blocks;                             // allocate() calls that succeeded, launches included
+    uint64_t bytes;                              // Handed out, alignment included
+    uint64_t wraps;                              // Back to the start of the ring
+    uint64_t timelineReads;                      // Driver reads of the stream's timeline
+    uint64_t stalls;                             // Host waits for space still in use
+    uint64_t failures;
+};
+
+class ArgumentRing {
+public:
+    static const uint32_t kArgAlign = 256;       // Constant banks and QMDs
+
+    ArgumentRing(Stream& stream, BufferAllocator& allocator, size_t bytes = 1 << 20);
+    ~ArgumentRing();                             // Waits for launches still reading the ring
+
+    ArgumentRing(const ArgumentRing&) = delete;
+    ArgumentRing& operator=(const ArgumentRing&) = delete;
+
+    bool valid() const { return buffer.valid(); }
+    size_t capacity() const { return size; }
+    Stream& stream() { return *owner; }
+
+    // `bytes`, rounded up to kArgAlign; submit the work that reads it
+    // before the next allocate() or launch()
+    bool allocate(uint32_t bytes, ArgBlock *out);
+
+    // Bank 0, QMD and dispatch in one block, submitted on the stream.
+    // `ordered` drains the stream's earlier launches first (a barrier);
+    // without it, launches overlap like CommandBuffer::dispatch()es.
+    bool launch(const QmdTemplate& qmd, uint32_t gridX, uint32_t gridY, uint32_t gridZ, void *const *args,
+                bool ordered = true);
+
+    ArgumentRingStats stats() const { return counters; }
+
+private:
+    static const uint32_t kPushbufferBytes = 64;
+    static const uint32_t kMaxRetires = 1024;
+
+    // Ring bytes up to `end` (a running offset) are free once the timeline
+    // reaches `value`; 0 while no submission has followed `since`
+    struct Retire {
+        uint64_t end;
+        uint64_t since;
+        uint64_t value;
+    };
+
+    Stream *owner;
+    Client *client;
+    Buffer buffer;
+    size_t size;
+    uint64_t head;                               // Running offsets: next byte handed out,
+    uint64_t tail;                               // oldest byte still in use
+    uint64_t completed;                          // Timeline payload last seen
+    std::vector<Retire> retires;                 // kMaxRetires slots, used as a ring
+    uint32_t retireHead;
+    uint32_t retireCount;
+    ArgumentRingStats counters;
+
+    bool close(Retire& r);
+    bool retireOldest();
+};
+
+} // namespace nvdaal
+
+#endif // LIB_NVDAAL_ARGUMENT_RING_H
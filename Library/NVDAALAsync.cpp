@@ -0,0 +1,329 @@
+/*
+ * NVDAALAsync.cpp - Completions and the Semaphore-Driven Executor
+ */
+
+#include "NVDAALAsync.h"
+#include <algorithm>
+#include <deque>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace nvdaal {
+
+namespace detail {
+
+struct CompletionState {
+    std::weak_ptr<ExecutorState> executor;
+    std::mutex lock;
+    std::condition_variable cond;
+    bool done = false;
+    Status status = kStatusNotReady;
+    std::vector<std::function<void(Status)>> callbacks;
+};
+
+struct ExecutorState {
+    Client& client;
+    Semaphore timeline = {};
+    bool timelineValid = false;
+
+    // Run queue
+    std::mutex runLock;
+    std::condition_variable runCond;
+    std::deque<std::function<void()>> queue;
+    std::vector<std::thread> workers;
+    bool stopping = false;
+
+    // Submissions waiting on the timeline, in value order
+    struct Pending {
+        uint64_t value;
+        std::shared_ptr<CompletionState> completion;
+    };
+    std::mutex submitLock;                   // Orders value assignment with the driver submit
+    std::mutex lock;
+    std::deque<Pending> pending;
+    uint64_t nextValue = 0;
+    bool armed = false;                      // A timeline notification is registered
+    uint32_t watchId = 0;
+    std::vector<uint32_t> firedEarly;        // Fired before armTimeline() recorded the id
+    bool closing = false;
+
+    explicit ExecutorState(Client& c) : client(c) {}
+
+    void post(std::function<void()> fn) {
+        {
+            std::lock_guard<std::mutex> guard(runLock);
+            queue.push_back(std::move(fn));
+        }
+        runCond.notify_one();
+    }
+
+    void work() {
+        std::unique_lock<std::mutex> lk(runLock);
+        for (;;) {
+            runCond.wait(lk, [this] { return stopping || !queue.empty(); });
+            if (queue.empty()) return;                  // Stopping and drained
+            std::function<void()> fn = std::move(queue.front());
+            queue.pop_front();
+            lk.unlock();
+            fn();
+            lk.lock();
+        }
+    }
+};
+
+} // namespace detail
+
+using detail::CompletionState;
+using detail::ExecutorState;
+
+static std::shared_ptr<CompletionState> newCompletion(const std::shared_ptr<ExecutorState>& executor) {
+    std::shared_ptr<CompletionState> c = std::make_shared<CompletionState>();
+    c->executor = executor;
+    return c;
+}
+
+// Publish the result and queue the callbacks before waking waiters, so
+// whatever wait() returns to can poll() them. Without a live executor
+// (it was destroyed) callbacks run on the completing thread.
+static void complete(const std::shared_ptr<CompletionState>& c, Status status) {
+    std::shared_ptr<ExecutorState> executor = c->executor.lock();
+    std::vector<std::function<void(Status)>> callbacks;
+    {
+        std::lock_guard<std::mutex> guard(c->lock);
+        if (c->done) return;
+        c->done = true;
+        c->status = status;
+        callbacks.swap(c->callbacks);
+        if (executor) {
+            for (auto& fn : callbacks) {
+                std::function<void(Status)> cb = std::move(fn);
+                executor->post([cb, status] { cb(status); });
+            }
+            callbacks.clear();
+        }
+    }
+    c->cond.notify_all();
+    for (auto& fn : callbacks) fn(status);
+}
+
+// ============================================================================
+// Completion
+// ============================================================================
+
+bool Completion::ready() const {
+    if (!state) return false;
+    std::lock_guard<std::mutex> guard(state->lock);
+    return state->done;
+}
+
+Status Completion::status() const {
+    if (!state) return kStatusBadArgument;
+    std::lock_guard<std::mutex> guard(state->lock);
+    return state->status;
+}
+
+bool Completion::wait(uint32_t timeoutMs) const {
+    if (!state) return false;
+    std::unique_lock<std::mutex> lk(state->lock);
+    state->cond.wait_for(lk, std::chrono::milliseconds(timeoutMs), [this] { return state->done; });
+    return state->done && state->status == kStatusSuccess;
+}
+
+void Completion::then(std::function<void(Status)> fn) const {
+    if (!fn) return;
+    if (!state) {
+        fn(kStatusBadArgument);
+        return;
+    }
+
+    Status status;
+    {
+        std::lock_guard<std::mutex> guard(state->lock);
+        if (!state->done) {
+            state->callbacks.push_back(std::move(fn));
+            return;
+        }
+        status = state->status;
+    }
+
+    // Already complete: still run on the executor so callers never re-enter
+    std::shared_ptr<ExecutorState> executor = state->executor.lock();
+    if (executor) {
+        executor->post([fn, status] { fn(status); });
+    } else {
+        fn(status);
+    }
+}
+
+std::future<Status> Completion::future() const {
+    std::shared_ptr<std::promise<Status>> promise = std::make_shared<std::promise<Status>>();
+    std::future<Status> f = promise->get_future();
+    then([promise](Status status) { promise->set_value(status); });
+    return f;
+}
+
+// ============================================================================
+// Executor
+// ============================================================================
+
+// The timeline notification fired (or failed): retire what the payload has
+// passed and re-arm on the oldest value still outstanding.
+static void onTimeline(const std::weak_ptr<ExecutorState>& weak, const Notification& n);
+
+static void armTimeline(const std::shared_ptr<ExecutorState>& s, uint64_t value) {
+    std::weak_ptr<ExecutorState> weak = s;
+    uint32_t id = s->client.notifyOnSemaphore(s->timeline, value,
+                                              [weak](const Notification& n) { onTimeline(weak, n); });
+
+    std::deque<ExecutorState::Pending> failed;
+    {
+        std::lock_guard<std::mutex> guard(s->lock);
+        if (id) {
+            auto it = std::find(s->firedEarly.begin(), s->firedEarly.end(), id);
+            if (it != s->firedEarly.end()) {
+                s->firedEarly.erase(it);
+            } else {
+                s->watchId = id;
+            }
+            return;
+        }
+        s->armed = false;
+        failed.swap(s->pending);
+    }
+    std::cerr << "[libNVDAAL] Executor: failed to watch the timeline semaphore" << std::endl;
+    for (auto& p : failed) complete(p.completion, kStatusNoResources);
+}
+
+static void onTimeline(const std::weak_ptr<ExecutorState>& weak, const Notification& n) {
+    std::shared_ptr<ExecutorState> s = weak.lock();
+    if (!s) return;
+
+    std::deque<ExecutorState::Pending> retired;
+    uint64_t rearm = 0;
+    {
+        std::lock_guard<std::mutex> guard(s->lock);
+        s->armed = false;
+        if (s->watchId == n.id) {
+            s->watchId = 0;
+        } else {
+            s->firedEarly.push_back(n.id);
+        }
+        if (n.status != kStatusSuccess) {
+            retired.swap(s->pending);
+        } else {
+            while (!s->pending.empty() && s->pending.front().value <= n.values[0]) {
+                retired.push_back(std::move(s->pending.front()));
+                s->pending.pop_front();
+            }
+        }
+        if (!s->pending.empty() && !s->closing) {
+            s->armed = true;
+            rearm = s->pending.front().value;
+        }
+    }
+
+    for (auto& p : retired) complete(p.completion, n.status);
+    if (rearm) armTimeline(s, rearm);
+}
+
+Executor::Executor(Client& client, uint32_t threads) : state(std::make_shared<ExecutorState>(client)) {
+    state->timelineValid = client.createSemaphore(&state->timeline, 0);
+    if (!state->timelineValid) {
+        std::cerr << "[libNVDAAL] Executor: could not create the timeline semaphore" << std::endl;
+    }
+    for (uint32_t i = 0; i < threads; i++) {
+        state->workers.emplace_back(&ExecutorState::work, state.get());
+    }
+}
+
+Executor::~Executor() {
+    std::deque<ExecutorState::Pending> outstanding;
+    uint32_t watch;
+    {
+        std::lock_guard<std::mutex> guard(state->lock);
+        state->closing = true;
+        outstanding.swap(state->pending);
+        watch = state->watchId;
+        state->watchId = 0;
+    }
+    if (watch) state->client.cancelNotification(watch);
+    for (auto& p : outstanding) complete(p.completion, kStatusAborted);
+
+    // Let resumed coroutines and callbacks finish before the workers go
+    {
+        std::lock_guard<std::mutex> guard(state->runLock);
+        state->stopping = true;
+    }
+    state->runCond.notify_all();
+    for (auto& t : state->workers) t.join();
+    poll();
+
+    if (state->timelineValid) state->client.destroySemaphore(state->timeline);
+}
+
+bool Executor::valid() const {
+    return state->timelineValid;
+}
+
+Semaphore Executor::timeline() const {
+    return state->timeline;
+}
+
+Completion Executor::submit(uint32_t cmd) {
+    std::shared_ptr<CompletionState> c = newCompletion(state);
+    if (!state->timelineValid) {
+        complete(c, kStatusNotReady);
+        return Completion(c);
+    }
+
+    uint64_t arm = 0;
+    {
+        std::lock_guard<std::mutex> order(state->submitLock);
+        uint64_t value = state->nextValue + 1;
+        if (!state->client.submitCommand(cmd, state->timeline, value)) {
+            complete(c, kStatusError);
+            return Completion(c);
+        }
+        state->nextValue = value;
+
+        std::lock_guard<std::mutex> guard(state->lock);
+        state->pending.push_back({ value, c });
+        if (!state->armed && !state->closing) {
+            state->armed = true;
+            arm = state->pending.front().value;
+        }
+    }
+    if (arm) armTimeline(state, arm);
+    return Completion(c);
+}
+
+Completion Executor::after(const Semaphore& sem, uint64_t value) {
+    std::shared_ptr<CompletionState> c = newCompletion(state);
+    uint32_t id = state->client.notifyOnSemaphore(sem, value, [c](const Notification& n) {
+        complete(c, n.status);
+    });
+    if (!id) complete(c, kStatusNotFound);
+    return Completion(c);
+}
+
+void Executor::post(std::function<void()> fn) {
+    if (fn) state->post(std::move(fn));
+}
+
+size_t Executor::poll() {
+    size_t ran = 0;
+    for (;;) {
+        std::function<void()> fn;
+        {
+            std::lock_guard<std::mutex> guard(state->runLock);
+            if (state->queue.empty()) return ran;
+            fn = std::move(state->queue.front());
+            state->queue.pop_front();
+        }
+        fn();
+        ran++;
+    }
+}
+
+} // namespace nvdaal
@@ -0,0 +1,223 @@
+/*
+ * NVDAALAsync.h - Asynchronous Submission API for libNVDAAL
+ *
+ * Submissions return a Completion instead of blocking. Each Executor owns
+ * a timeline semaphore: submit() has the GPU release it to the next value
+ * after the command, and one notification armed on the oldest outstanding
+ * value retires every completion the payload has passed, so no thread
+ * blocks per stream and there is no driver call per completion.
+ *
+ * A Completion can be consumed three ways:
+ *   then(fn)    callback on an executor thread
+ *   future()    std::future<Status> for code that blocks later
+ *   co_await    inside a Task<T> coroutine (C++20), resumed on the executor
+ *
+ * The timeline is only released once the doorbell rings: with a
+ * coalescing SubmitPolicy, give it a deadline or flush explicitly.
+ */
+
+#ifndef LIB_NVDAAL_ASYNC_H
+#define LIB_NVDAAL_ASYNC_H
+
+#include "libNVDAAL.h"
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+
+#if __cplusplus >= 202002L && defined(__has_include)
+#if __has_include(<coroutine>)
+#include <coroutine>
+#include <optional>
+#define NVDAAL_HAS_COROUTINES 1
+#endif
+#endif
+#ifndef NVDAAL_HAS_COROUTINES
+#define NVDAAL_HAS_COROUTINES 0
+#endif
+
+namespace nvdaal {
+
+class Executor;
+
+namespace detail {
+struct CompletionState;
+struct ExecutorState;
+} // namespace detail
+
+class Completion {
+public:
+    Completion() {}                              // Invalid; completes with kStatusBadArgument
+
+    bool valid() const { return state != nullptr; }
+    bool ready() const;
+    Status status() const;                       // kStatusNotReady until ready()
+    bool ok() const { return ready() && status() == kStatusSuccess; }
+
+    // Block this thread. Never call from an executor thread with threads == 1.
+    bool wait(uint32_t timeoutMs = 1000) const;
+
+    // fn(status) runs once on an executor thread (queued at once if already complete)
+    void then(std::function<void(Status)> fn) const;
+    std::future<Status> future() const;
+
+#if NVDAAL_HAS_COROUTINES
+    bool await_ready() const noexcept { return !state || ready(); }
+    void await_suspend(std::coroutine_handle<> h) const { then([h](Status) { h.resume(); }); }
+    Status await_resume() const { return state ? status() : kStatusBadArgument; }
+#endif
+
+private:
+    friend class Executor;
+    std::shared_ptr<detail::CompletionState> state;
+
+    explicit Completion(std::shared_ptr<detail::CompletionState> s) : state(std::move(s)) {}
+};
+
+class Executor {
+public:
+    // threads == 0: no workers; queued work runs in poll()
+    explicit Executor(Client& client, uint32_t threads = 1);
+    ~Executor();                                 // Outstanding completions fail with kStatusAborted
+
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+
+    bool valid() const;                          // Timeline semaphore was created
+
+    // Submit `cmd`; completes once the GPU has executed it
+    Completion submit(uint32_t cmd);
+    // Completes once `sem` reaches `value`, whoever releases it
+    Completion after(const Semaphore& sem, uint64_t value);
+
+    void post(std::function<void()> fn);
+    size_t poll();                               // Run queued work on this thread
+
+    // Released by submit(); GPU work on other channels may acquire it
+    Semaphore timeline() const;
+
+#if NVDAAL_HAS_COROUTINES
+    // co_await executor.schedule() continues on an executor thread
+    struct ScheduleAwaiter {
+        Executor *executor;
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) const { executor->post([h] { h.resume(); }); }
+        void await_resume() const noexcept {}
+    };
+    ScheduleAwaiter schedule() { return ScheduleAwaiter{ this }; }
+#endif
+
+private:
+    std::shared_ptr<detail::ExecutorState> state;
+};
+
+#if NVDAAL_HAS_COROUTINES
+
+// ============================================================================
+// Coroutines
+// ============================================================================
+
+namespace detail {
+
+struct TaskStateBase {
+    std::mutex lock;
+    std::condition_variable cond;
+    bool done = false;
+    std::exception_ptr error;
+    std::coroutine_handle<> continuation;
+};
+
+template <typename T>
+struct TaskState : TaskStateBase {
+    std::optional<T> value;
+    T take() { return std::move(*value); }
+};
+
+template <>
+struct TaskState<void> : TaskStateBase {
+    void take() {}
+};
+
+template <typename T, typename Promise>
+struct TaskReturn {
+    void return_value(T value) { static_cast<Promise *>(this)->state->value.emplace(std::move(value)); }
+};
+
+template <typename Promise>
+struct TaskReturn<void, Promise> {
+    void return_void() {}
+};
+
+} // namespace detail
+
+// Eagerly started coroutine. Await it from another Task, or get() it from a
+// plain thread. The frame frees itself when the body finishes, so a Task
+// may be dropped while it is still running.
+template <typename T = void>
+class Task {
+    typedef detail::TaskState<T> State;
+
+public:
+    struct promise_type : detail::TaskReturn<T, promise_type> {
+        std::shared_ptr<State> state = std::make_shared<State>();
+
+        Task get_return_object() { return Task(state); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        void unhandled_exception() { state->error = std::current_exception(); }
+
+        struct FinalAwaiter {
+            bool await_ready() const noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+                std::shared_ptr<State> s = std::move(h.promise().state);
+                h.destroy();
+                std::coroutine_handle<> next;
+                {
+                    std::lock_guard<std::mutex> guard(s->lock);
+                    s->done = true;
+                    next = s->continuation;
+                }
+                s->cond.notify_all();
+                return next ? next : std::noop_coroutine();
+            }
+            void await_resume() const noexcept {}
+        };
+        FinalAwaiter final_suspend() noexcept { return {}; }
+    };
+
+    bool done() const {
+        std::lock_guard<std::mutex> guard(state->lock);
+        return state->done;
+    }
+
+    // Block until the task finishes; rethrows an escaped exception
+    T get() {
+        std::unique_lock<std::mutex> lk(state->lock);
+        state->cond.wait(lk, [this] { return state->done; });
+        if (state->error) std::rethrow_exception(state->error);
+        return state->take();
+    }
+
+    bool await_ready() const { return done(); }
+    bool await_suspend(std::coroutine_handle<> h) {
+        std::lock_guard<std::mutex> guard(state->lock);
+        if (state->done) return false;
+        state->continuation = h;
+        return true;
+    }
+    T await_resume() {
+        if (state->error) std::rethrow_exception(state->error);
+        return state->take();
+    }
+
+private:
+    std::shared_ptr<State> state;
+    explicit Task(std::shared_ptr<State> s) : state(std::move(s)) {}
+};
+
+#endif // NVDAAL_HAS_COROUTINES
+
+} // namespace nvdaal
+
+#endif // LIB_NVDAAL_ASYNC_H
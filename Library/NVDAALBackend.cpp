@@ -0,0 +1,172 @@
+/*
+ * NVDAALBackend.cpp - IOKit Backend and Backend Selection
+ */
+
+#include "NVDAALBackend.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#ifdef __APPLE__
+#include <IOKit/IOKitLib.h>
+#include <mach/mach.h>
+#endif
+
+#define SERVICE_NAME "NVDAAL"
+
+namespace nvdaal {
+
+#ifdef __APPLE__
+
+// ============================================================================
+// IOKit
+// ============================================================================
+
+class IOKitBackend : public Backend {
+public:
+    IOKitBackend() : connection(0), port(nullptr) {}
+    ~IOKitBackend() override { close(); }
+
+    const char *name() const override { return "iokit"; }
+
+    Status open() override {
+        if (connection) return kStatusSuccess;
+
+        io_service_t service = IOServiceGetMatchingService(kIOMainPortDefault, IOServiceNameMatching(SERVICE_NAME));
+        if (!service) {
+            std::cerr << "[libNVDAAL] Error: NVDAAL driver service not found." << std::endl;
+            return kStatusNotFound;
+        }
+
+        kern_return_t kr = IOServiceOpen(service, mach_task_self(), 0, &connection);
+        IOObjectRelease(service);
+
+        if (kr != KERN_SUCCESS) {
+            std::cerr << "[libNVDAAL] Error: IOServiceOpen failed (0x" << std::hex << kr << ")" << std::dec << std::endl;
+            connection = 0;
+            return kr;
+        }
+
+        // Made here, where the Client serialises open() and close(), rather
+        // than on first use by whichever threads register at once
+        port = IONotificationPortCreate(kIOMainPortDefault);
+        if (!port) {
+            std::cerr << "[libNVDAAL] Failed to create notification port" << std::endl;
+            close();
+            return kStatusNoResources;
+        }
+        return kStatusSuccess;
+    }
+
+    void close() override {
+        if (connection) {
+            IOServiceClose(connection);
+            connection = 0;
+        }
+        // Registrations die with the connection
+        if (port) {
+            IONotificationPortDestroy(port);
+            port = nullptr;
+        }
+    }
+
+    Status call(uint32_t selector,
+                const uint64_t *input, uint32_t inputCount,
+                const void *inputStruct, size_t inputStructSize,
+                uint64_t *output, uint32_t *outputCount,
+                void *outputStruct, size_t *outputStructSize) override {
+        if (!connection) return kStatusNotReady;
+        return IOConnectCallMethod(connection, selector,
+                                   input, inputCount,
+                                   inputStruct, inputStructSize,
+                                   output, outputCount,
+                                   outputStruct, outputStructSize);
+    }
+
+    Status callAsync(uint32_t selector, AsyncCallback callback, void *refcon,
+                     const uint64_t *input, uint32_t inputCount,
+                     uint64_t *output, uint32_t *outputCount) override {
+        if (!connection || !port) return kStatusNotReady;
+
+        uint64_t asyncRef[kOSAsyncRef64Count] = {};
+        asyncRef[kIOAsyncCalloutFuncIndex] = (uint64_t)(uintptr_t)callback;
+        asyncRef[kIOAsyncCalloutRefconIndex] = (uint64_t)(uintptr_t)refcon;
+
+        return IOConnectCallAsyncScalarMethod(connection, selector,
+                                              IONotificationPortGetMachPort(port),
+                                              asyncRef, kOSAsyncRef64Count,
+                                              input, inputCount,
+                                              output, outputCount);
+    }
+
+    Status mapMemory(uint32_t type, MapCache cache, void **addr, uint64_t *size) override {
+        if (!connection) return kStatusNotReady;
+
+        IOOptionBits options = kIOMapAnywhere;
+        if (cache == MapCache::WriteCombined) options |= kIOMapWriteCombineCache;
+        else if (cache == MapCache::Uncached) options |= kIOMapInhibitCache;
+        else if (cache == MapCache::Cached) options |= kIOMapCopybackCache;
+
+        mach_vm_address_t a = 0;
+        mach_vm_size_t s = 0;
+        kern_return_t kr = IOConnectMapMemory64(connection, type, mach_task_self(), &a, &s, options);
+        if (kr != KERN_SUCCESS) return kr;
+
+        *addr = (void *)a;
+        if (size) *size = s;
+        return kStatusSuccess;
+    }
+
+    Status unmapMemory(uint32_t type, void *addr) override {
+        if (!connection) return kStatusNotReady;
+        return IOConnectUnmapMemory64(connection, type, mach_task_self(), (mach_vm_address_t)addr);
+    }
+
+    void *notificationRunLoopSource() override {
+        return port ? IONotificationPortGetRunLoopSource(port) : nullptr;
+    }
+
+    bool setNotificationQueue(void *dispatchQueue) override {
+        if (!dispatchQueue || !port) return false;
+        IONotificationPortSetDispatchQueue(port, (dispatch_queue_t)dispatchQueue);
+        return true;
+    }
+
+private:
+    io_connect_t connection;
+    IONotificationPortRef port;                  // From open() to close()
+};
+
+std::unique_ptr<Backend> makeIOKitBackend() {
+    return std::unique_ptr<Backend>(new IOKitBackend());
+}
+
+#else
+
+std::unique_ptr<Backend> makeIOKitBackend() {
+    return nullptr;
+}
+
+#endif // __APPLE__
+
+// ============================================================================
+// Selection
+// ============================================================================
+
+std::unique_ptr<Backend> makeSimBackend(const SimConfig& config) {
+    return std::unique_ptr<Backend>(new SimBackend(config));
+}
+
+std::unique_ptr<Backend> makeDefaultBackend() {
+    const char *env = getenv("NVDAAL_BACKEND");
+    if (env && strcmp(env, "sim") == 0) return makeSimBackend();
+    if (env && strcmp(env, "iokit") == 0) return makeIOKitBackend();
+    if (env && *env) {
+        std::cerr << "[libNVDAAL] Unknown NVDAAL_BACKEND '" << env << "', using the default" << std::endl;
+    }
+
+    std::unique_ptr<Backend> backend = makeIOKitBackend();
+    return backend ? std::move(backend) : makeSimBackend();
+}
+
+} // namespace nvdaal
@@ -0,0 +1,158 @@
+/*
+ * NVDAALBackend.h - Transport Backends for libNVDAAL
+ *
+ * Client talks to the driver only through a Backend: the user-client
+ * selectors (NVDAALUserShared.h ABI), shared-memory mappings and async
+ * notifications. Two implementations:
+ *
+ *   IOKit   the NVDAAL kext via IOConnectCall* (macOS only)
+ *   Sim     an in-process model of the user client: fake VRAM in host
+ *           memory, a fake channel that completes submissions, timeline
+ *           semaphores that signal and wake waiters. Builds anywhere, so
+ *           application code and libNVDAAL's own hot paths can be tested
+ *           and benchmarked in CI without a GPU.
+ *
+ * makeDefaultBackend() honours NVDAAL_BACKEND=iokit|sim and otherwise
+ * picks IOKit on macOS and the simulator elsewhere.
+ */
+
+#ifndef LIB_NVDAAL_BACKEND_H
+#define LIB_NVDAAL_BACKEND_H
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+
+namespace nvdaal {
+
+// IOReturn values, so results read the same on every backend
+typedef int32_t Status;
+
+static const Status kStatusSuccess      = 0;
+static const Status kStatusError        = (Status)0xe00002bc;
+static const Status kStatusNoMemory     = (Status)0xe00002bd;
+static const Status kStatusNoResources  = (Status)0xe00002be;
+static const Status kStatusBadArgument  = (Status)0xe00002c2;
+static const Status kStatusUnsupported  = (Status)0xe00002c7;
+static const Status kStatusVMError      = (Status)0xe00002c8;
+static const Status kStatusTimeout      = (Status)0xe00002d6;
+static const Status kStatusNotReady     = (Status)0xe00002d8;
+static const Status kStatusNoSpace      = (Status)0xe00002db;
+static const Status kStatusNotPermitted = (Status)0xe00002e2;
+static const Status kStatusAborted      = (Status)0xe00002eb;
+static const Status kStatusNotFound     = (Status)0xe00002f0;
+
+// CPU caching for mapMemory()
+enum class MapCache : uint32_t {
+    Default,                     // Whatever the memory type implies
+    WriteCombined,
+    Uncached,
+    Cached
+};
+
+class Backend {
+public:
+    // Matches IOAsyncCallback: args[] are NVDAAL_NOTIFY_ARG_* values
+    typedef void (*AsyncCallback)(void *refcon, int result, void **args, uint32_t numArgs);
+
+    virtual ~Backend() {}
+
+    virtual const char *name() const = 0;
+    virtual Status open() = 0;
+    virtual void close() = 0;
+
+    // One selector call. Unused inputs are null/0; *outputCount and
+    // *outputStructSize are capacities in, sizes out.
+    virtual Status call(uint32_t selector,
+                        const uint64_t *input, uint32_t inputCount,
+                        const void *inputStruct, size_t inputStructSize,
+                        uint64_t *output, uint32_t *outputCount,
+                        void *outputStruct, size_t *outputStructSize) = 0;
+
+    // Async registration (RegisterNotification). callback(refcon, ...)
+    // runs wherever the backend delivers notifications.
+    virtual Status callAsync(uint32_t selector, AsyncCallback callback, void *refcon,
+                             const uint64_t *input, uint32_t inputCount,
+                             uint64_t *output, uint32_t *outputCount) = 0;
+
+    // clientMemoryForType mappings (NVDAAL_MEMORY_*)
+    virtual Status mapMemory(uint32_t type, MapCache cache, void **addr, uint64_t *size) = 0;
+    virtual Status unmapMemory(uint32_t type, void *addr) = 0;
+
+    // Where notifications are serviced. The simulator delivers on its own
+    // thread and supports neither.
+    virtual void *notificationRunLoopSource() { return nullptr; }
+    virtual bool setNotificationQueue(void *dispatchQueue) { (void)dispatchQueue; return false; }
+
+    Status callScalar(uint32_t selector, const uint64_t *input, uint32_t inputCount,
+                      uint64_t *output = nullptr, uint32_t *outputCount = nullptr) {
+        return call(selector, input, inputCount, nullptr, 0, output, outputCount, nullptr, nullptr);
+    }
+};
+
+// ============================================================================
+// Simulator
+// ============================================================================
+
+struct SimConfig {
+    uint64_t vramBytes = 256ULL << 20;   // Reserved up front, committed as touched
+    uint32_t callOverheadNs = 0;         // Busy-wait per call to model the kernel round trip
+    uint32_t submitLatencyUs = 0;        // Time a fake channel takes per submission (semaphore-only: none)
+    uint32_t copyMBps = 0;               // Copy-engine rate a channel is busy for (0 = copies take no time)
+    uint32_t channels = 4;               // Compute channels "booted" (1..NVDAAL_MAX_CHANNELS)
+    uint32_t copyChannels = 1;           // Copy-engine channels (0..NVDAAL_MAX_COPY_CHANNELS)
+    uint32_t pmcBoot0 = 0x192000a1;      // Reported chip id (AD102)
+};
+
+// Fake-channel and call counters, for benchmarks and tests
+struct SimCounters {
+    uint64_t calls;                      // Selector calls (a batch or ring kick is one)
+    uint64_t ops;                        // Ops executed via ring or batch
+    uint64_t submissions;
+    uint64_t doorbells;
+    uint64_t completed;                  // Submissions the fake channel has finished
+    uint64_t vramUsed;
+    uint64_t sysmemUsed;                 // Pinned host memory from AllocSysmem
+    uint64_t dispatches;                 // Compute launches decoded from pushbuffers
+    uint64_t copiedBytes;                // Copy-engine launches, executed in fake VRAM
+    uint64_t filledBytes;                // Copy-engine constant fills
+    uint64_t faults;                     // Channel errors raised by bad pushbuffers
+};
+
+class SimBackend : public Backend {
+public:
+    explicit SimBackend(const SimConfig& config = SimConfig());
+    ~SimBackend() override;
+
+    const char *name() const override { return "sim"; }
+    Status open() override;
+    void close() override;
+
+    Status call(uint32_t selector,
+                const uint64_t *input, uint32_t inputCount,
+                const void *inputStruct, size_t inputStructSize,
+                uint64_t *output, uint32_t *outputCount,
+                void *outputStruct, size_t *outputStructSize) override;
+    Status callAsync(uint32_t selector, AsyncCallback callback, void *refcon,
+                     const uint64_t *input, uint32_t inputCount,
+                     uint64_t *output, uint32_t *outputCount) override;
+    Status mapMemory(uint32_t type, MapCache cache, void **addr, uint64_t *size) override;
+    Status unmapMemory(uint32_t type, void *addr) override;
+
+    SimCounters counters() const;
+
+    // Raise a channel error or GSP event as the interrupt path would
+    void injectEvent(uint32_t kind, uint64_t value0, uint64_t value1);
+
+private:
+    struct State;
+    State *state;
+};
+
+std::unique_ptr<Backend> makeIOKitBackend();   // nullptr where IOKit is unavailable
+std::unique_ptr<Backend> makeSimBackend(const SimConfig& config = SimConfig());
+std::unique_ptr<Backend> makeDefaultBackend();
+
+} // namespace nvdaal
+
+#endif // LIB_NVDAAL_BACKEND_H
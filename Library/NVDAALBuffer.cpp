@@ -0,0 +1,411 @@
+/*
+ * NVDAALBuffer.cpp - Caching VRAM Sub-Allocator
+ */
+
+#include "NVDAALBuffer.h"
+#include "NVDAALUserShared.h"
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <vector>
+
+namespace nvdaal {
+
+static const size_t kMinBlock = 512;              // Rounding granularity
+static const size_t kSmallSize = 1 << 20;         // Largest request served from the small pool
+static const size_t kLargeRound = 2 << 20;        // Large slabs round up to this
+static const size_t kMinLargeAlloc = 10 << 20;    // Below this, large requests share a largeSlab
+
+namespace detail {
+
+struct Segment {
+    uint64_t offset;                              // From allocVram
+    size_t size;
+    uint64_t gpuAddr;                             // 0 unless mapped
+    void *cpu;                                    // Mapped on first Buffer::cpu()
+    bool small;
+    Block *first;                                 // Offset 0; survives every merge
+};
+
+// One contiguous piece of a segment. Neighbours are linked so frees can
+// merge; a free block sits in its pool's set.
+struct Block {
+    Segment *segment;
+    size_t offset;                                // Within the segment
+    size_t size;
+    size_t requested;
+    bool allocated;
+    uint32_t pins;                                // BufferPins holding it
+    bool released;                                // Buffer gone, waiting for the last unpin
+    Block *prev;
+    Block *next;
+};
+
+} // namespace detail
+
+using detail::Block;
+using detail::Segment;
+
+namespace {
+
+// Best fit: smallest size first, lowest address to break ties
+struct BlockLess {
+    bool operator()(const Block *a, const Block *b) const {
+        if (a->size != b->size) return a->size < b->size;
+        uint64_t addrA = a->segment ? a->segment->offset + a->offset : 0;
+        uint64_t addrB = b->segment ? b->segment->offset + b->offset : 0;
+        return addrA < addrB;
+    }
+};
+
+typedef std::set<Block *, BlockLess> FreeBlocks;
+
+} // namespace
+
+struct BufferAllocator::Impl {
+    Client& client;
+    BufferAllocatorConfig config;
+    mutable std::mutex lock;
+    std::vector<Segment *> segments;
+    FreeBlocks smallFree;
+    FreeBlocks largeFree;
+    BufferAllocatorStats stats = {};
+
+    Impl(Client& c, const BufferAllocatorConfig& cfg) : client(c), config(cfg) {}
+
+    FreeBlocks& pool(bool small) { return small ? smallFree : largeFree; }
+
+    Segment *reserveSegment(size_t size, bool small) {
+        uint64_t offset = client.allocVram(size);
+        if (!offset) return nullptr;
+
+        uint64_t gpuAddr = 0;
+        if (config.mapGpu) {
+            Batch batch;
+            batch.mapVram(offset, size);
+            if (!client.execute(batch)) {
+                std::cerr << "[libNVDAAL] BufferAllocator: MapVram failed for slab 0x" << std::hex << offset
+                          << ": 0x" << batch.result(0).status << std::dec << std::endl;
+                return nullptr;                   // No free selector: the VRAM is lost
+            }
+            gpuAddr = batch.result(0).values[0];
+        }
+
+        Segment *segment = new Segment{ offset, size, gpuAddr, nullptr, small, nullptr };
+        segment->first = new Block{ segment, 0, size, 0, false, 0, false, nullptr, nullptr };
+        segments.push_back(segment);
+        pool(small).insert(segment->first);
+        stats.slabs++;
+        stats.reservedBytes += size;
+        return segment;
+    }
+
+    Block *findFree(size_t size, bool small) {
+        FreeBlocks& free = pool(small);
+        Block key = { nullptr, 0, size, 0, false, 0, false, nullptr, nullptr };
+        FreeBlocks::iterator it = free.lower_bound(&key);
+        if (it == free.end()) return nullptr;
+        Block *block = *it;
+        free.erase(it);
+        return block;
+    }
+
+    // Carve `size` off the front of `block` if the rest is worth keeping
+    void split(Block *block, size_t size) {
+        size_t remaining = block->size - size;
+        bool worth = block->segment->small ? remaining >= kMinBlock : remaining > kSmallSize;
+        if (!worth) return;
+
+        Block *rest = new Block{ block->segment, block->offset + size, remaining, 0, false, 0, false, block, block->next };
+        if (block->next) block->next->prev = rest;
+        block->next = rest;
+        block->size = size;
+        pool(block->segment->small).insert(rest);
+        stats.splits++;
+    }
+
+    // The allocated block holding [offset, offset + bytes) of `segment`,
+    // pinned (lock held)
+    Block *pinRange(Segment *segment, uint64_t offset, size_t bytes) {
+        for (Block *block = segment->first; block; block = block->next) {
+            if (offset >= block->offset + block->size) continue;
+            if (!block->allocated || bytes > block->offset + block->size - offset) return nullptr;
+            block->pins++;
+            return block;
+        }
+        return nullptr;
+    }
+
+    // Absorb `next` into `block` (both free, adjacent)
+    void merge(Block *block, Block *next) {
+        block->size += next->size;
+        block->next = next->next;
+        if (next->next) next->next->prev = block;
+        delete next;
+        stats.merges++;
+    }
+};
+
+// ============================================================================
+// Buffer
+// ============================================================================
+
+Buffer& Buffer::operator=(Buffer&& other) noexcept {
+    if (this != &other) {
+        reset();
+        allocator = other.allocator;
+        block = other.block;
+        other.allocator = nullptr;
+        other.block = nullptr;
+    }
+    return *this;
+}
+
+size_t Buffer::size() const {
+    return block ? block->requested : 0;
+}
+
+size_t Buffer::capacity() const {
+    return block ? block->size : 0;
+}
+
+uint64_t Buffer::gpuAddr() const {
+    if (!block || !block->segment->gpuAddr) return 0;
+    return block->segment->gpuAddr + block->offset;
+}
+
+uint64_t Buffer::vramOffset() const {
+    return block ? block->segment->offset + block->offset : 0;
+}
+
+void *Buffer::cpu() {
+    return block ? allocator->cpu(block) : nullptr;
+}
+
+void Buffer::reset() {
+    if (block) allocator->release(block);
+    allocator = nullptr;
+    block = nullptr;
+}
+
+// ============================================================================
+// BufferPin
+// ============================================================================
+
+BufferPin::BufferPin(const Buffer& buffer)
+    : allocator(buffer.allocator), block(buffer.block), gpu(buffer.gpuAddr()), bytes(buffer.capacity()) {
+    if (block) allocator->pin(block);
+}
+
+BufferPin& BufferPin::operator=(BufferPin&& other) noexcept {
+    if (this != &other) {
+        reset();
+        allocator = other.allocator;
+        block = other.block;
+        gpu = other.gpu;
+        bytes = other.bytes;
+        other.allocator = nullptr;
+        other.block = nullptr;
+    }
+    return *this;
+}
+
+BufferPin::BufferPin(const BufferPin& other)
+    : allocator(other.allocator), block(other.block), gpu(other.gpu), bytes(other.bytes) {
+    if (block) allocator->pin(block);
+}
+
+BufferPin& BufferPin::operator=(const BufferPin& other) {
+    if (this != &other) {
+        if (other.block) other.allocator->pin(other.block);
+        reset();
+        allocator = other.allocator;
+        block = other.block;
+        gpu = other.gpu;
+        bytes = other.bytes;
+    }
+    return *this;
+}
+
+void BufferPin::reset() {
+    if (block) allocator->unpin(block);
+    allocator = nullptr;
+    block = nullptr;
+    gpu = 0;
+    bytes = 0;
+}
+
+// ============================================================================
+// BufferAllocator
+// ============================================================================
+
+BufferAllocator::BufferAllocator(Client& client, const BufferAllocatorConfig& config)
+    : impl(new Impl(client, config)) {}
+
+BufferAllocator::~BufferAllocator() {
+    Batch unmap;
+    for (Segment *segment : impl->segments) {
+        if (segment->cpu) impl->client.unmapVramCpu(segment->offset, segment->cpu);
+        if (segment->gpuAddr) unmap.add(Op::unmapVram(segment->gpuAddr, segment->size));
+
+        Block *block = segment->first;
+        while (block) {
+            Block *next = block->next;
+            delete block;
+            block = next;
+        }
+        delete segment;
+    }
+    if (unmap.size()) impl->client.execute(unmap);
+    delete impl;
+}
+
+const size_t BufferAllocator::kMaxSize = NVDAAL_MAX_VRAM_MAPPED_BYTES;
+
+size_t BufferAllocator::roundSize(size_t size) {
+    if (size < kMinBlock) return kMinBlock;
+    return (size + kMinBlock - 1) & ~(kMinBlock - 1);
+}
+
+Buffer BufferAllocator::allocate(size_t size) {
+    if (size == 0) return Buffer();
+
+    std::lock_guard<std::mutex> guard(impl->lock);
+    if (size > kMaxSize) {
+        impl->stats.failures++;
+        return Buffer();
+    }
+    size_t rounded = roundSize(size);
+    bool small = rounded <= kSmallSize;
+
+    Block *block = impl->findFree(rounded, small);
+    if (block) {
+        impl->stats.cacheHits++;
+    } else {
+        size_t slab;
+        if (small) slab = impl->config.smallSlab;
+        else if (rounded < kMinLargeAlloc) slab = impl->config.largeSlab;
+        else slab = (rounded + kLargeRound - 1) & ~(kLargeRound - 1);
+
+        if (!impl->reserveSegment(slab < rounded ? rounded : slab, small) ||
+            !(block = impl->findFree(rounded, small))) {
+            impl->stats.failures++;
+            return Buffer();
+        }
+    }
+
+    impl->split(block, rounded);
+    block->allocated = true;
+    block->requested = size;
+
+    BufferAllocatorStats& s = impl->stats;
+    s.allocations++;
+    s.allocatedBytes += block->size;
+    s.requestedBytes += size;
+    if (s.allocatedBytes > s.peakAllocatedBytes) s.peakAllocatedBytes = s.allocatedBytes;
+    return Buffer(this, block);
+}
+
+bool BufferAllocator::reserve(size_t bytes) {
+    if (bytes == 0) return true;
+    if (bytes > kMaxSize) return false;
+    size_t size = (bytes + kLargeRound - 1) & ~(kLargeRound - 1);
+
+    std::lock_guard<std::mutex> guard(impl->lock);
+    return impl->reserveSegment(size, false) != nullptr;
+}
+
+BufferPin BufferAllocator::find(uint64_t gpuAddr, size_t bytes) {
+    std::lock_guard<std::mutex> guard(impl->lock);
+    for (Segment *segment : impl->segments) {
+        if (!segment->gpuAddr || gpuAddr < segment->gpuAddr || gpuAddr - segment->gpuAddr >= segment->size) continue;
+        Block *block = impl->pinRange(segment, gpuAddr - segment->gpuAddr, bytes);
+        if (!block) break;
+        return BufferPin(this, block, segment->gpuAddr + block->offset, block->size);
+    }
+    return BufferPin();
+}
+
+BufferPin BufferAllocator::find(const void *cpu, size_t bytes, uint64_t *gpuAddr) {
+    if (gpuAddr) *gpuAddr = 0;
+    std::lock_guard<std::mutex> guard(impl->lock);
+    uintptr_t addr = (uintptr_t)cpu;
+    for (Segment *segment : impl->segments) {
+        uintptr_t base = (uintptr_t)segment->cpu;
+        if (!base || addr < base || addr - base >= segment->size) continue;
+        Block *block = impl->pinRange(segment, addr - base, bytes);
+        if (!block) break;
+        if (gpuAddr && segment->gpuAddr) *gpuAddr = segment->gpuAddr + (addr - base);
+        return BufferPin(this, block, segment->gpuAddr ? segment->gpuAddr + block->offset : 0, block->size);
+    }
+    return BufferPin();
+}
+
+// A held block handed out again for a request of `size` (MemoryPool)
+void BufferAllocator::reuse(Block *block, size_t size) {
+    std::lock_guard<std::mutex> guard(impl->lock);
+    impl->stats.requestedBytes += size - block->requested;
+    block->requested = size;
+}
+
+void BufferAllocator::release(Block *block) {
+    std::lock_guard<std::mutex> guard(impl->lock);
+    if (block->pins) {
+        block->released = true;
+        return;
+    }
+    recycle(block);
+}
+
+void BufferAllocator::pin(Block *block) {
+    std::lock_guard<std::mutex> guard(impl->lock);
+    block->pins++;
+}
+
+void BufferAllocator::unpin(Block *block) {
+    std::lock_guard<std::mutex> guard(impl->lock);
+    if (--block->pins == 0 && block->released) recycle(block);
+}
+
+// Back into the pool, merged with free neighbours (lock held)
+void BufferAllocator::recycle(Block *block) {
+    BufferAllocatorStats& s = impl->stats;
+    s.frees++;
+    s.allocatedBytes -= block->size;
+    s.requestedBytes -= block->requested;
+
+    FreeBlocks& free = impl->pool(block->segment->small);
+    block->allocated = false;
+    block->released = false;
+    block->requested = 0;
+    if (block->next && !block->next->allocated) {
+        free.erase(block->next);
+        impl->merge(block, block->next);
+    }
+    if (block->prev && !block->prev->allocated) {
+        Block *prev = block->prev;
+        free.erase(prev);
+        impl->merge(prev, block);
+        block = prev;
+    }
+    free.insert(block);
+}
+
+void *BufferAllocator::cpu(Block *block) {
+    std::lock_guard<std::mutex> guard(impl->lock);
+    Segment *segment = block->segment;
+    if (!segment->cpu) segment->cpu = impl->client.mapVramCpu(segment->offset, impl->config.cpuMode);
+    return segment->cpu ? (uint8_t *)segment->cpu + block->offset : nullptr;
+}
+
+BufferAllocatorStats BufferAllocator::stats() const {
+    std::lock_guard<std::mutex> guard(impl->lock);
+    return impl->stats;
+}
+
+void BufferAllocator::resetPeak() {
+    std::lock_guard<std::mutex> guard(impl->lock);
+    impl->stats.peakAllocatedBytes = impl->stats.allocatedBytes;
+}
+
+} // namespace nvdaal
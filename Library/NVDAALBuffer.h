@@ -0,0 +1,174 @@
+/*
+ * NVDAALBuffer.h - VRAM Buffers and the Caching Allocator
+ *
+ * The driver hands out VRAM with a bump allocator and has no free
+ * selector, so a raw allocVram() per tensor leaks and costs a kernel
+ * round trip. BufferAllocator reserves VRAM in slabs, maps each slab
+ * into the GPU VA space once, and sub-allocates from it:
+ *
+ *   small  requests <= 1 MiB come from 2 MiB slabs
+ *   large  requests come from slabs of max(size, 20 MiB) rounded to 2 MiB
+ *
+ * Sizes round up to 512 bytes. Freed blocks stay cached in per-pool free
+ * lists ordered by size, merge with free neighbours, and are handed back
+ * best-fit (split when the remainder is worth keeping), so steady-state
+ * allocation makes no driver calls. Slabs are never given back: the
+ * reservation only grows, up to the largest working set.
+ *
+ * Buffer is the move-only handle; destroying it returns the block to the
+ * cache. Buffers must not outlive their allocator. A BufferPin keeps the
+ * block out of the cache while recorded GPU work may still touch it: a
+ * Buffer released while pinned is freed by the last unpin.
+ */
+
+#ifndef LIB_NVDAAL_BUFFER_H
+#define LIB_NVDAAL_BUFFER_H
+
+#include "libNVDAAL.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace nvdaal {
+
+class BufferAllocator;
+
+namespace detail {
+struct Block;
+} // namespace detail
+
+class Buffer {
+public:
+    Buffer() : allocator(nullptr), block(nullptr) {}
+    ~Buffer() { reset(); }
+
+    Buffer(Buffer&& other) noexcept : allocator(other.allocator), block(other.block) {
+        other.allocator = nullptr;
+        other.block = nullptr;
+    }
+    Buffer& operator=(Buffer&& other) noexcept;
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
+
+    bool valid() const { return block != nullptr; }
+    explicit operator bool() const { return valid(); }
+
+    size_t size() const;                         // As requested
+    size_t capacity() const;                     // Block size after rounding
+    uint64_t gpuAddr() const;                    // GPU VA (0 if the allocator does not map slabs)
+    uint64_t vramOffset() const;                 // Offset in VRAM (for Op::*)
+
+    // CPU pointer through BAR1. The slab is mapped once, on first use,
+    // with the allocator's CacheMode; nullptr if mapping fails.
+    void *cpu();
+
+    void reset();                                // Return the block to the cache now
+
+private:
+    friend class BufferAllocator;
+    friend class BufferPin;
+    friend class MemoryPool;
+    BufferAllocator *allocator;
+    detail::Block *block;
+
+    Buffer(BufferAllocator *a, detail::Block *b) : allocator(a), block(b) {}
+};
+
+// Each copy of a BufferPin holds its own pin
+class BufferPin {
+public:
+    BufferPin() : allocator(nullptr), block(nullptr), gpu(0), bytes(0) {}
+    explicit BufferPin(const Buffer& buffer);
+    ~BufferPin() { reset(); }
+
+    BufferPin(BufferPin&& other) noexcept
+        : allocator(other.allocator), block(other.block), gpu(other.gpu), bytes(other.bytes) {
+        other.allocator = nullptr;
+        other.block = nullptr;
+    }
+    BufferPin& operator=(BufferPin&& other) noexcept;
+    BufferPin(const BufferPin& other);                 // Pins again
+    BufferPin& operator=(const BufferPin& other);
+
+    bool valid() const { return block != nullptr; }
+    bool pins(const Buffer& buffer) const { return block && block == buffer.block; }
+    uint64_t gpuAddr() const { return gpu; }
+    size_t capacity() const { return bytes; }
+
+    void reset();
+
+private:
+    friend class BufferAllocator;
+    BufferAllocator *allocator;
+    detail::Block *block;
+    uint64_t gpu;                                // Cached: valid while pinned
+    size_t bytes;
+
+    BufferPin(BufferAllocator *a, detail::Block *b, uint64_t g, size_t n) : allocator(a), block(b), gpu(g), bytes(n) {}
+};
+
+struct BufferAllocatorConfig {
+    bool mapGpu = true;                          // MapVram each slab so Buffer::gpuAddr() is set
+    CacheMode cpuMode = CacheMode::WriteCombined;
+    size_t smallSlab = 2 << 20;
+    size_t largeSlab = 20 << 20;                 // Minimum large slab
+};
+
+struct BufferAllocatorStats {
+    uint64_t allocations;                        // allocate() calls that succeeded
+    uint64_t frees;
+    uint64_t cacheHits;                          // Served without reserving a slab
+    uint64_t failures;
+    uint64_t slabs;                              // Driver allocations (each one allocVram + MapVram)
+    uint64_t splits;
+    uint64_t merges;
+    uint64_t reservedBytes;                      // VRAM held in slabs
+    uint64_t allocatedBytes;                     // Live blocks, after rounding
+    uint64_t requestedBytes;                     // Live blocks, as requested
+    uint64_t peakAllocatedBytes;
+    uint64_t cachedBytes() const { return reservedBytes - allocatedBytes; }
+};
+
+class BufferAllocator {
+public:
+    explicit BufferAllocator(Client& client, const BufferAllocatorConfig& config = BufferAllocatorConfig());
+    ~BufferAllocator();                          // Outstanding buffers become dangling
+
+    BufferAllocator(const BufferAllocator&) = delete;
+    BufferAllocator& operator=(const BufferAllocator&) = delete;
+
+    Buffer allocate(size_t size);                // Invalid Buffer on failure
+    bool reserve(size_t bytes);                  // Pre-fill the large pool with one slab
+
+    // A pin on the live buffer holding [addr, addr + bytes), by GPU VA or
+    // by CPU address in a slab's BAR1 mapping (*gpuAddr: the VA of `cpu`,
+    // 0 if unmapped); invalid if no one buffer holds it all. For memory
+    // handed out by address (DLPack tensors).
+    BufferPin find(uint64_t gpuAddr, size_t bytes);
+    BufferPin find(const void *cpu, size_t bytes, uint64_t *gpuAddr = nullptr);
+
+    BufferAllocatorStats stats() const;
+    void resetPeak();
+
+    // Largest allocate() or reserve(): a slab must fit in the client's
+    // MapVram budget. roundSize() is only meaningful up to this.
+    static const size_t kMaxSize;
+    static size_t roundSize(size_t size);
+
+private:
+    friend class Buffer;
+    friend class BufferPin;
+    friend class MemoryPool;
+    struct Impl;
+    Impl *impl;
+
+    void reuse(detail::Block *block, size_t size);
+    void release(detail::Block *block);
+    void recycle(detail::Block *block);
+    void pin(detail::Block *block);
+    void unpin(detail::Block *block);
+    void *cpu(detail::Block *block);
+};
+
+} // namespace nvdaal
+
+#endif // LIB_NVDAAL_BUFFER_H
@@ -0,0 +1,268 @@
+/*
+ * NVDAALCommandBuffer.cpp - Recorded, Reusable Pushbuffers
+ */
+
+#include "NVDAALCommandBuffer.h"
+#include "NVDAALCopy.h"
+#include "NVDAALPushbuffer.h"
+#include "NVDAALUserShared.h"
+#include <cstring>
+
+namespace nvdaal {
+
+static const uint64_t kMaxCopyChunk = 1ULL << 31;          // LINE_LENGTH_IN is 32 bits
+
+CommandBuffer::CommandBuffer(BufferAllocator& a, size_t reserveBytes)
+    : allocator(&a), words(reserveBytes / sizeof(uint32_t)), used(0), count(0), state(Recording),
+      lastKind(None), lastStart(0) {
+    pins.reserve(16);
+}
+
+void CommandBuffer::begin() {
+    used = 0;
+    count = 0;
+    state = Recording;
+    lastKind = None;
+    pins.clear();
+}
+
+// Room for `dwords` more at the end of the recording
+uint32_t *CommandBuffer::claim(uint32_t dwords) {
+    if (words.size() - used < dwords) {
+        size_t grown = words.size() * 2;
+        words.resize(grown > used + dwords ? grown : used + dwords);
+    }
+    return words.data() + used;
+}
+
+// Call with the emitter's result already in hand: `end` is read as passed
+bool CommandBuffer::commit(bool ok, const uint32_t *end, Kind kind) {
+    if (!ok || state != Recording) {
+        state = Failed;
+        return false;
+    }
+    lastKind = kind == Copy && lastKind == SplitCopy ? SplitCopy : kind;
+    lastStart = used;
+    used = end - words.data();
+    count++;
+    return true;
+}
+
+// Pin `buffer` and resolve [offset, offset + bytes) inside it to a GPU VA
+bool CommandBuffer::pin(const Buffer& buffer, size_t offset, size_t bytes, uint64_t *gpuAddr) {
+    if (!buffer.gpuAddr() || offset > buffer.size() || bytes > buffer.size() - offset) {
+        state = Failed;
+        return false;
+    }
+    if (pins.empty() || !pins.back().pins(buffer)) pins.emplace_back(buffer);
+    *gpuAddr = buffer.gpuAddr() + offset;
+    return true;
+}
+
+bool CommandBuffer::dispatch(uint64_t qmdGpuAddr) {
+    NvPushbuffer pb;
+    nvPbInit(&pb, claim(NV_PB_DISPATCH_DWORDS), NV_PB_DISPATCH_DWORDS * sizeof(uint32_t));
+    bool ok = nvPbPushDispatch(&pb, qmdGpuAddr);
+    return commit(ok, pb.cur, Dispatch);
+}
+
+bool CommandBuffer::dispatch(const Buffer& qmd, size_t offset) {
+    uint64_t va;
+    return pin(qmd, offset, NV_QMD_ALIGN, &va) && dispatch(va);
+}
+
+bool CommandBuffer::copy(uint64_t dstGpuAddr, uint64_t srcGpuAddr, uint64_t bytes) {
+    if (bytes == 0) return commit(false, nullptr, None);
+    lastKind = bytes > kMaxCopyChunk ? SplitCopy : None;
+    while (bytes) {
+        uint64_t chunk = bytes < kMaxCopyChunk ? bytes : kMaxCopyChunk;
+        NvPushbuffer pb;
+        nvPbInit(&pb, claim(NV_PB_COPY_DWORDS), NV_PB_COPY_DWORDS * sizeof(uint32_t));
+        bool ok = nvPbPushCopy(&pb, dstGpuAddr, srcGpuAddr, (uint32_t)chunk);
+        if (!commit(ok, pb.cur, Copy)) return false;
+        dstGpuAddr += chunk;
+        srcGpuAddr += chunk;
+        bytes -= chunk;
+    }
+    return true;
+}
+
+bool CommandBuffer::copy(const Buffer& dst, size_t dstOffset, const Buffer& src, size_t srcOffset, size_t bytes) {
+    uint64_t dstVa, srcVa;
+    return pin(dst, dstOffset, bytes, &dstVa) && pin(src, srcOffset, bytes, &srcVa) &&
+           copy(dstVa, srcVa, bytes);
+}
+
+bool CommandBuffer::copy2D(uint64_t dstGpuAddr, uint32_t dstPitch, uint64_t srcGpuAddr, uint32_t srcPitch,
+                           uint32_t lineBytes, uint32_t lines) {
+    NvPushbuffer pb;
+    nvPbInit(&pb, claim(NV_PB_COPY_DWORDS), NV_PB_COPY_DWORDS * sizeof(uint32_t));
+    bool ok = nvPbPushCopy2D(&pb, dstGpuAddr, dstPitch, srcGpuAddr, srcPitch, lineBytes, lines);
+    return commit(ok, pb.cur, Copy2D);
+}
+
+bool CommandBuffer::copy2D(const Buffer& dst, size_t dstOffset, uint32_t dstPitch,
+                           const Buffer& src, size_t srcOffset, uint32_t srcPitch, uint32_t lineBytes, uint32_t lines) {
+    if (lines == 0) return commit(false, nullptr, None);
+    uint64_t dstVa, srcVa;
+    return pin(dst, dstOffset, (uint64_t)(lines - 1) * dstPitch + lineBytes, &dstVa) &&
+           pin(src, srcOffset, (uint64_t)(lines - 1) * srcPitch + lineBytes, &srcVa) &&
+           copy2D(dstVa, dstPitch, srcVa, srcPitch, lineBytes, lines);
+}
+
+bool CommandBuffer::fill(uint64_t dstGpuAddr, uint32_t value, uint64_t bytes) {
+    if (bytes == 0 || (bytes & 3)) return commit(false, nullptr, None);
+    while (bytes) {
+        uint64_t chunk = bytes < kMaxCopyChunk ? bytes : kMaxCopyChunk;
+        NvPushbuffer pb;
+        nvPbInit(&pb, claim(NV_PB_FILL_DWORDS), NV_PB_FILL_DWORDS * sizeof(uint32_t));
+        bool ok = nvPbPushFill(&pb, dstGpuAddr, value, (uint32_t)(chunk / 4));
+        if (!commit(ok, pb.cur, Fill)) return false;
+        dstGpuAddr += chunk;
+        bytes -= chunk;
+    }
+    return true;
+}
+
+bool CommandBuffer::fill(const Buffer& dst, size_t offset, uint32_t value, size_t bytes) {
+    uint64_t va;
+    return pin(dst, offset, bytes, &va) && fill(va, value, bytes);
+}
+
+bool CommandBuffer::wait(const Semaphore& sem, uint64_t value) {
+    NvPushbuffer pb;
+    nvPbInit(&pb, claim(NV_PB_SEMAPHORE_ACQUIRE_DWORDS), NV_PB_SEMAPHORE_ACQUIRE_DWORDS * sizeof(uint32_t));
+    bool ok = sem.gpuAddr && !(sem.gpuAddr & (NV_SEMAPHORE_ALIGN - 1)) &&
+              nvPbPushSemaphoreAcquire(&pb, sem.gpuAddr, value);
+    return commit(ok, pb.cur, SemaphoreOp);
+}
+
+bool CommandBuffer::signal(const Semaphore& sem, uint64_t value, bool interrupt) {
+    NvPushbuffer pb;
+    nvPbInit(&pb, claim(NV_PB_SEMAPHORE_RELEASE_DWORDS), NV_PB_SEMAPHORE_RELEASE_DWORDS * sizeof(uint32_t));
+    bool ok = sem.gpuAddr && !(sem.gpuAddr & (NV_SEMAPHORE_ALIGN - 1)) &&
+              nvPbPushSemaphoreRelease(&pb, sem.gpuAddr, value, interrupt);
+    return commit(ok, pb.cur, SemaphoreOp);
+}
+
+bool CommandBuffer::signalCopies(const Semaphore& sem, uint64_t value, bool interrupt) {
+    NvPushbuffer pb;
+    nvPbInit(&pb, claim(NV_PB_COPY_RELEASE_DWORDS), NV_PB_COPY_RELEASE_DWORDS * sizeof(uint32_t));
+    bool ok = sem.gpuAddr && nvPbPushCopyRelease(&pb, sem.gpuAddr, value, interrupt);
+    return commit(ok, pb.cur, CopyRelease);
+}
+
+bool CommandBuffer::barrier() {
+    NvPushbuffer pb;
+    nvPbInit(&pb, claim(NV_PB_BARRIER_DWORDS), NV_PB_BARRIER_DWORDS * sizeof(uint32_t));
+    bool ok = nvPbPushBarrier(&pb);
+    return commit(ok, pb.cur, Barrier);
+}
+
+bool CommandBuffer::use(const Buffer& buffer) {
+    uint64_t va;
+    return pin(buffer, 0, 0, &va);
+}
+
+bool CommandBuffer::use(const BufferPin& pin) {
+    if (!pin.valid()) {
+        state = Failed;
+        return false;
+    }
+    pins.push_back(pin);
+    return true;
+}
+
+PatchPoint CommandBuffer::field(Field f) const {
+    PatchPoint point;
+    point.field = f;
+    if (state == Failed) return point;
+
+    // Dword offsets follow the nvPbPush* encoders
+    uint32_t start = (uint32_t)lastStart;
+    switch (f) {
+        case Field::DispatchQmd:
+            if (lastKind == Dispatch) point.dword = start + 1;
+            break;
+        case Field::CopySrc:
+            if (lastKind == Copy || lastKind == Copy2D) point.dword = start + 1;
+            break;
+        case Field::CopyDst:
+            if (lastKind == Copy || lastKind == Copy2D) point.dword = start + 3;
+            break;
+        case Field::CopyBytes:
+            if (lastKind == Copy) point.dword = start + 5;
+            break;
+        case Field::SemaphoreAddr:
+            if (lastKind == SemaphoreOp) point.dword = start + 1;
+            break;
+        case Field::SemaphoreValue:
+            if (lastKind == SemaphoreOp) point.dword = start + 3;
+            break;
+    }
+    return point;
+}
+
+void patch(uint32_t *words, const PatchPoint& point, uint64_t value) {
+    uint32_t *w = words + point.dword;
+    switch (point.field) {
+        case Field::DispatchQmd:
+            w[0] = (uint32_t)(value >> 8);
+            break;
+        case Field::CopySrc:
+        case Field::CopyDst:
+            w[0] = (uint32_t)(value >> 32) & 0x01FFFFFFu;
+            w[1] = (uint32_t)value;
+            break;
+        case Field::CopyBytes:
+            w[0] = w[1] = w[2] = (uint32_t)value;      // PITCH_IN, PITCH_OUT, LINE_LENGTH_IN
+            break;
+        case Field::SemaphoreAddr:
+            w[0] = (uint32_t)(value & 0xFFFFFFFCu);
+            w[1] = (uint32_t)(value >> 32) & 0x01FFFFFFu;
+            break;
+        case Field::SemaphoreValue:
+            w[0] = (uint32_t)value;
+            w[1] = (uint32_t)(value >> 32);
+            break;
+    }
+}
+
+bool CommandBuffer::end() {
+    size_t bytes = used * sizeof(uint32_t);
+    if (state != Recording || bytes == 0 || bytes > NVDAAL_MAX_PUSHBUFFER_BYTES) {
+        state = Failed;
+        return false;
+    }
+
+    if (storage.capacity() < bytes) {
+        size_t want = storage.capacity() * 2 > bytes ? storage.capacity() * 2 : bytes;
+        storage = allocator->allocate(want);
+        if (!storage.gpuAddr()) {
+            state = Failed;
+            return false;
+        }
+    }
+    void *cpu = storage.cpu();
+    if (!cpu) {
+        state = Failed;
+        return false;
+    }
+    streamCopy(cpu, words.data(), bytes);
+    state = Ready;
+    return true;
+}
+
+// ============================================================================
+// Client Submission
+// ============================================================================
+
+bool Client::submit(const CommandBuffer& cb) {
+    return cb.ready() && submitPushbuffer(cb.gpuAddr(), cb.sizeBytes());
+}
+
+bool Client::submit(const CommandBuffer& cb, const Semaphore& signal, uint64_t value) {
+    return cb.ready() && submitPushbuffer(cb.gpuAddr(), cb.sizeBytes(), signal, value);
+}
+
+} // namespace nvdaal
@@ -0,0 +1,130 @@
+/*
+ * NVDAALCommandBuffer.h - Recorded, Reusable Pushbuffers
+ *
+ * A CommandBuffer records compute launches, copies and fills, semaphore
+ * waits and signals, and barriers as pushbuffer methods (NVDAALPushbuffer.h), then
+ * end() uploads them once into VRAM from its BufferAllocator. The result
+ * can be submitted any number of times; each submit is one selector call
+ * that points the channel at the recording, with nothing copied.
+ *
+ * Buffers a recording refers to are pinned (BufferPin) until the next
+ * begin() or the CommandBuffer's destruction, so they cannot be recycled
+ * under recorded work. Pinning does not wait for the GPU: keep the
+ * CommandBuffer, and don't begin() it again, until submissions of it have
+ * completed.
+ *
+ * Recording writes into storage kept across begin(); once a recording of
+ * a given shape has been made, re-recording it allocates nothing. To skip
+ * re-recording altogether, capture the buffers into a Graph (NVDAALGraph.h).
+ *
+ * A recording of copies, fills, waits and signals (no dispatch() or
+ * barrier()) may also run on a copy-engine channel (kCopyChannel), where
+ * it overlaps compute work; signalCopies() is the cheap release there.
+ */
+
+#ifndef LIB_NVDAAL_COMMAND_BUFFER_H
+#define LIB_NVDAAL_COMMAND_BUFFER_H
+
+#include "NVDAALBuffer.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace nvdaal {
+
+// A value inside recorded methods that can be rewritten without
+// re-recording (see CommandBuffer::field() and Graph::addParam())
+enum class Field {
+    DispatchQmd,                                       // QMD GPU VA of a dispatch
+    CopyDst,                                           // Copy destination GPU VA
+    CopySrc,                                           // Copy source GPU VA
+    CopyBytes,                                         // Copy length (32 bits)
+    SemaphoreAddr,                                     // Wait/signal semaphore GPU VA
+    SemaphoreValue                                     // Wait/signal payload
+};
+
+struct PatchPoint {
+    uint32_t dword = UINT32_MAX;                       // Into the recording; UINT32_MAX = none
+    Field field = Field::DispatchQmd;
+
+    bool valid() const { return dword != UINT32_MAX; }
+};
+
+// Rewrite a patch point in `words` (a recording or a copy of it)
+void patch(uint32_t *words, const PatchPoint& point, uint64_t value);
+
+class CommandBuffer {
+public:
+    explicit CommandBuffer(BufferAllocator& allocator, size_t reserveBytes = 16 << 10);
+
+    CommandBuffer(CommandBuffer&&) = default;
+    CommandBuffer& operator=(CommandBuffer&&) = default;
+    CommandBuffer(const CommandBuffer&) = delete;
+    CommandBuffer& operator=(const CommandBuffer&) = delete;
+
+    // Drop the previous recording and its pins; storage is kept
+    void begin();
+
+    // Recording. A call with bad arguments returns false and fails the
+    // whole recording: end() refuses it until the next begin().
+    bool dispatch(uint64_t qmdGpuAddr);                // QMD must be NV_QMD_ALIGN aligned
+    bool dispatch(const Buffer& qmd, size_t offset = 0);
+    bool copy(uint64_t dstGpuAddr, uint64_t srcGpuAddr, uint64_t bytes);
+    bool copy(const Buffer& dst, size_t dstOffset, const Buffer& src, size_t srcOffset, size_t bytes);
+    // `lines` rows of `lineBytes`; row i starts at base + i * pitch on each side
+    bool copy2D(uint64_t dstGpuAddr, uint32_t dstPitch, uint64_t srcGpuAddr, uint32_t srcPitch,
+                uint32_t lineBytes, uint32_t lines);
+    bool copy2D(const Buffer& dst, size_t dstOffset, uint32_t dstPitch,
+                const Buffer& src, size_t srcOffset, uint32_t srcPitch, uint32_t lineBytes, uint32_t lines);
+    // Repeat a 32-bit pattern; address and bytes must be 4-byte aligned
+    bool fill(uint64_t dstGpuAddr, uint32_t value, uint64_t bytes);
+    bool fill(const Buffer& dst, size_t offset, uint32_t value, size_t bytes);
+    bool wait(const Semaphore& sem, uint64_t value);   // Channel stalls until payload >= value
+    bool signal(const Semaphore& sem, uint64_t value, bool interrupt = true);
+    // Released by the copy engine once the copies and fills recorded before
+    // it have landed; the channel doesn't idle, but dispatches aren't covered
+    bool signalCopies(const Semaphore& sem, uint64_t value, bool interrupt = true);
+    bool barrier();                                    // Orders everything before against everything after
+    bool use(const Buffer& buffer);                    // Pin a buffer reached only indirectly (QMD args)
+    bool use(const BufferPin& pin);                    // Or memory reached by address (BufferAllocator::find())
+
+    // Where `f` lives in the command recorded last; invalid if that command
+    // has no such field or was a copy split into several launches. 2D
+    // copies have CopyDst/CopySrc; fills and signalCopies() have none.
+    PatchPoint field(Field f) const;
+
+    // Upload the recording to VRAM. Grows the VRAM copy only when the
+    // recording outgrows it.
+    bool end();
+
+    bool ready() const { return state == Ready; }
+    uint64_t gpuAddr() const { return ready() ? storage.gpuAddr() : 0; }
+    uint32_t sizeBytes() const { return (uint32_t)(used * sizeof(uint32_t)); }
+    uint32_t commands() const { return count; }
+    size_t pinned() const { return pins.size(); }
+    const uint32_t *data() const { return words.data(); }   // Host copy of the recording
+    bool failed() const { return state == Failed; }
+    const std::vector<BufferPin>& pinnedBuffers() const { return pins; }
+
+private:
+    enum State { Recording, Failed, Ready };
+    enum Kind { None, Dispatch, Copy, SplitCopy, Copy2D, Fill, SemaphoreOp, CopyRelease, Barrier };
+
+    BufferAllocator *allocator;
+    std::vector<uint32_t> words;                       // Host recording; size() is capacity
+    size_t used;                                       // Dwords recorded
+    uint32_t count;
+    State state;
+    Kind lastKind;
+    size_t lastStart;                                  // Dword the last command starts at
+    std::vector<BufferPin> pins;
+    Buffer storage;                                    // VRAM copy the GPU fetches
+
+    uint32_t *claim(uint32_t dwords);
+    bool commit(bool ok, const uint32_t *end, Kind kind);
+    bool pin(const Buffer& buffer, size_t offset, size_t bytes, uint64_t *gpuAddr);
+};
+
+} // namespace nvdaal
+
+#endif // LIB_NVDAAL_COMMAND_BUFFER_H
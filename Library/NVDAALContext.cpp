@@ -0,0 +1,126 @@
+/*
+ * NVDAALContext.cpp - Contexts and Per-Thread Submission State
+ */
+
+#include "NVDAALContext.h"
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <set>
+
+namespace nvdaal {
+
+namespace {
+
+// This thread's ThreadContext in each Context it has used
+struct Binding {
+    uint64_t context;
+    ThreadContext *state;
+};
+
+thread_local std::vector<Binding> tBindings;
+
+std::atomic<uint64_t> gNextContextId(1);
+std::mutex gLiveLock;
+std::set<uint64_t> gLive;                         // Contexts not yet destroyed
+
+} // namespace
+
+// ============================================================================
+// ThreadContext
+// ============================================================================
+
+ThreadContext::ThreadContext(Client& client, BufferAllocator& allocator, uint32_t channel, size_t ringBytes)
+    : queue(client, allocator, channel), args(queue, allocator, ringBytes) {}
+
+// ============================================================================
+// Context
+// ============================================================================
+
+Context::Context(std::unique_ptr<Backend> backend, const ContextConfig& cfg)
+    : connection(std::move(backend)), buffers(connection, cfg.allocator), loader(buffers), config(cfg),
+      id(gNextContextId++), counters() {
+    std::lock_guard<std::mutex> guard(gLiveLock);
+    gLive.insert(id);
+}
+
+Context::~Context() {
+    std::lock_guard<std::mutex> guard(gLiveLock);
+    gLive.erase(id);
+}
+
+ThreadContext *Context::current() {
+    for (const Binding& b : tBindings) {
+        if (b.context == id) return b.state;
+    }
+    return create();
+}
+
+// First call on this thread: the only one that locks
+ThreadContext *Context::create() {
+    {
+        // Forget Contexts destroyed since this thread last bound one
+        std::lock_guard<std::mutex> guard(gLiveLock);
+        tBindings.erase(std::remove_if(tBindings.begin(), tBindings.end(),
+                                       [](const Binding& b) { return gLive.count(b.context) == 0; }),
+                        tBindings.end());
+    }
+
+    std::unique_ptr<ThreadContext> state(
+        new ThreadContext(connection, buffers, config.channel, config.argumentRingBytes));
+    std::lock_guard<std::mutex> guard(lock);
+    if (!state->valid()) {
+        counters.failures++;
+        std::cerr << "[libNVDAAL] Context: could not make this thread's stream" << std::endl;
+        return nullptr;
+    }
+    threads.push_back(std::move(state));
+    counters.threadsCreated++;
+    tBindings.push_back({ id, threads.back().get() });
+    return threads.back().get();
+}
+
+bool Context::launch(const QmdTemplate& qmd, uint32_t gridX, uint32_t gridY, uint32_t gridZ, void *const *args,
+                     bool ordered) {
+    ThreadContext *state = current();
+    return state && state->ring().launch(qmd, gridX, gridY, gridZ, args, ordered);
+}
+
+bool Context::synchronize(uint32_t timeoutMs) {
+    ThreadContext *state = current();
+    return state && state->stream().synchronize(timeoutMs);
+}
+
+void Context::releaseThread() {
+    std::vector<Binding>::iterator it = std::find_if(tBindings.begin(), tBindings.end(),
+                                                     [this](const Binding& b) { return b.context == id; });
+    if (it == tBindings.end()) return;
+    ThreadContext *state = it->state;
+    tBindings.erase(it);
+
+    std::unique_ptr<ThreadContext> owned;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        for (size_t i = 0; i < threads.size(); i++) {
+            if (threads[i].get() != state) continue;
+            owned = std::move(threads[i]);
+            threads[i] = std::move(threads.back());
+            threads.pop_back();
+            counters.threadsReleased++;
+            break;
+        }
+    }
+    // Destroyed outside the lock: it waits for this thread's work
+}
+
+uint32_t Context::threadCount() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return (uint32_t)threads.size();
+}
+
+ContextStats Context::stats() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return counters;
+}
+
+} // namespace nvdaal
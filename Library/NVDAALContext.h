@@ -0,0 +1,116 @@
+/*
+ * NVDAALContext.h - Contexts and Per-Thread Submission State
+ *
+ * A Context is one connection to the driver together with the objects
+ * every thread using it shares: the BufferAllocator, the ModuleLoader and
+ * the QmdCache, each already thread-safe. A process may create as many
+ * Contexts as it likes; each has its own Client, so nothing is shared
+ * between them but the GPU.
+ *
+ * Submission state is not shared. Each thread that calls current() gets
+ * its own ThreadContext, made on first use: a Stream with its own timeline
+ * and an ArgumentRing on it. Finding it again is a lookup in a
+ * thread_local table, with no lock and no atomic read-modify-write, so
+ * threads launching on the same Context never contend in the library on
+ * the way to the driver. Only the first call on each thread takes the
+ * Context's lock.
+ *
+ * A ThreadContext belongs to its thread and lives until releaseThread()
+ * on that thread or the Context's destruction, which waits for every
+ * thread's outstanding work. Order across threads with Stream::wait() on
+ * another thread's Event.
+ */
+
+#ifndef LIB_NVDAAL_CONTEXT_H
+#define LIB_NVDAAL_CONTEXT_H
+
+#include "NVDAALArgumentRing.h"
+#include "NVDAALModule.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace nvdaal {
+
+struct ContextConfig {
+    BufferAllocatorConfig allocator;
+    uint32_t channel = Stream::kAnyChannel;      // For every thread's stream; round robin by default
+    size_t argumentRingBytes = 1 << 20;          // Per thread
+};
+
+struct ContextStats {
+    uint64_t threadsCreated;                     // ThreadContexts made
+    uint64_t threadsReleased;
+    uint64_t failures;                           // ThreadContexts that could not be made
+};
+
+// One thread's submission state. Streams from the thread's own calls only.
+class ThreadContext {
+public:
+    ThreadContext(Client& client, BufferAllocator& allocator, uint32_t channel, size_t ringBytes);
+
+    ThreadContext(const ThreadContext&) = delete;
+    ThreadContext& operator=(const ThreadContext&) = delete;
+
+    bool valid() const { return queue.valid() && args.valid(); }
+    Stream& stream() { return queue; }
+    ArgumentRing& ring() { return args; }
+
+private:
+    Stream queue;
+    ArgumentRing args;                           // Destroyed first: waits on the stream
+};
+
+class Context {
+public:
+    // nullptr: makeDefaultBackend(), as Client() does
+    explicit Context(std::unique_ptr<Backend> backend = nullptr, const ContextConfig& config = ContextConfig());
+    ~Context();                                  // Waits for every thread's work
+
+    Context(const Context&) = delete;
+    Context& operator=(const Context&) = delete;
+
+    bool connect() { return connection.connect(); }
+
+    // Shared by every thread
+    Client& client() { return connection; }
+    BufferAllocator& allocator() { return buffers; }
+    ModuleLoader& modules() { return loader; }
+    QmdCache& qmds() { return templates; }
+
+    // This thread's submission state, made on first use; nullptr if its
+    // stream or ring could not be made
+    ThreadContext *current();
+
+    // On this thread's stream, through its ring (ArgumentRing::launch)
+    bool launch(const QmdTemplate& qmd, uint32_t gridX, uint32_t gridY, uint32_t gridZ, void *const *args,
+                bool ordered = true);
+    bool synchronize(uint32_t timeoutMs = 1000);  // This thread's work
+
+    // Wait for and drop this thread's ThreadContext (a pool thread exiting)
+    void releaseThread();
+
+    uint32_t threadCount() const;
+    ContextStats stats() const;
+
+private:
+    // Members in construction order: each depends on those above it
+    Client connection;
+    BufferAllocator buffers;
+    ModuleLoader loader;
+    QmdCache templates;
+    ContextConfig config;
+    uint64_t id;                                 // Never reused: keys the thread_local tables
+
+    mutable std::mutex lock;                     // threads and counters
+    std::vector<std::unique_ptr<ThreadContext>> threads;
+    ContextStats counters;
+
+    ThreadContext *create();
+};
+
+} // namespace nvdaal
+
+#endif // LIB_NVDAAL_CONTEXT_H
@@ -0,0 +1,66 @@
+/*
+ * NVDAALCopy.cpp - CPU Writes into BAR1
+ */
+
+#include "NVDAALCopy.h"
+#include "NVDAALWcCopy.h"
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace nvdaal {
+
+static const uint32_t kDefaultThreads = 4;        // Enough to saturate PCIe 4.0 x16 writes
+static const size_t kMinPiece = 1 << 20;          // Per thread
+
+static uint32_t threadsFor(size_t bytes, const StreamCopyConfig& config) {
+    if (bytes < config.parallelMin) return 1;
+    uint32_t threads = config.threads;
+    if (!threads) {
+        uint32_t cores = std::thread::hardware_concurrency();
+        threads = cores < kDefaultThreads ? (cores ? cores : 1) : kDefaultThreads;
+    }
+    size_t most = bytes / kMinPiece;
+    return most < threads ? (most ? (uint32_t)most : 1) : threads;
+}
+
+// Run piece(offset, length) over [0, bytes) in `threads` line-aligned
+// pieces of dst; the caller takes the first
+static void split(void *dst, size_t bytes, uint32_t threads, const std::function<void(size_t, size_t)>& piece) {
+    size_t head = nvWcHead(dst, bytes);
+    size_t lines = (bytes - head) / NV_WC_LINE;
+    size_t perThread = (lines + threads - 1) / threads * NV_WC_LINE;
+
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    size_t first = head + perThread;
+    for (size_t offset = first; offset < bytes; offset += perThread) {
+        size_t length = bytes - offset < perThread ? bytes - offset : perThread;
+        workers.emplace_back(piece, offset, length);
+    }
+    piece(0, first < bytes ? first : bytes);
+    for (std::thread& t : workers) t.join();
+}
+
+void streamCopy(void *dst, const void *src, size_t bytes, const StreamCopyConfig& config) {
+    uint32_t threads = threadsFor(bytes, config);
+    if (threads <= 1) {
+        nvWcCopy(dst, src, bytes);
+        return;
+    }
+    uint8_t *d = (uint8_t *)dst;
+    const uint8_t *s = (const uint8_t *)src;
+    split(dst, bytes, threads, [&](size_t offset, size_t length) { nvWcCopy(d + offset, s + offset, length); });
+}
+
+void streamFill(void *dst, uint8_t value, size_t bytes, const StreamCopyConfig& config) {
+    uint32_t threads = threadsFor(bytes, config);
+    if (threads <= 1) {
+        nvWcFill(dst, value, bytes);
+        return;
+    }
+    uint8_t *d = (uint8_t *)dst;
+    split(dst, bytes, threads, [&](size_t offset, size_t length) { nvWcFill(d + offset, value, length); });
+}
+
+} // namespace nvdaal
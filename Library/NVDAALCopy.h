@@ -0,0 +1,34 @@
+/*
+ * NVDAALCopy.h - CPU Writes into BAR1
+ *
+ * streamCopy() and streamFill() are memcpy/memset for write-combined
+ * mappings (Client::mapVramCpu(), Buffer::cpu()): full-line non-temporal
+ * stores from NVDAALWcCopy.h, with large ranges split into line-aligned
+ * pieces written by several threads at once. One core rarely keeps a
+ * PCIe link busy, since it only has a handful of write-combining buffers
+ * in flight; a few cores do. Below parallelMin the thread start-up costs
+ * more than it saves.
+ *
+ * Every call fences before returning, so a submission made afterwards
+ * sees the data.
+ */
+
+#ifndef LIB_NVDAAL_COPY_H
+#define LIB_NVDAAL_COPY_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace nvdaal {
+
+struct StreamCopyConfig {
+    uint32_t threads = 0;                        // 0 = up to 4, as the CPU allows; 1 = caller only
+    size_t parallelMin = 8 << 20;                // Smaller ranges stay on the calling thread
+};
+
+void streamCopy(void *dst, const void *src, size_t bytes, const StreamCopyConfig& config = StreamCopyConfig());
+void streamFill(void *dst, uint8_t value, size_t bytes, const StreamCopyConfig& config = StreamCopyConfig());
+
+} // namespace nvdaal
+
+#endif // LIB_NVDAAL_COPY_H
@@ -0,0 +1,168 @@
+/*
+ * NVDAALDLPack.cpp - DLPack Tensor Export and Import
+ */
+
+#include "NVDAALDLPack.h"
+#include <iostream>
+#include <new>
+
+namespace nvdaal {
+
+namespace {
+
+// What an exported tensor's manager_ctx points at: the tensor itself, the
+// arrays it points into and the pin that keeps its memory allocated
+struct Exported {
+    DLManagedTensor managed;
+    std::vector<int64_t> shape;
+    std::vector<int64_t> strides;
+    BufferPin pin;
+};
+
+void deleteExported(DLManagedTensor *self) {
+    delete static_cast<Exported *>(self->manager_ctx);
+}
+
+} // namespace
+
+bool tensorExtent(const DLTensor& tensor, uint64_t *bytes) {
+    *bytes = 0;
+    uint64_t bits = (uint64_t)tensor.dtype.bits * tensor.dtype.lanes;
+    if (tensor.ndim < 0 || bits == 0 || (tensor.ndim && !tensor.shape)) return false;
+    uint64_t element = (bits + 7) / 8;
+
+    // Offset of the last element, in elements
+    uint64_t last = 0, compact = 1;
+    bool empty = false;
+    for (int32_t i = tensor.ndim - 1; i >= 0; i--) {
+        int64_t n = tensor.shape[i];
+        int64_t stride = tensor.strides ? tensor.strides[i] : (int64_t)compact;
+        if (n < 0 || stride < 0) return false;
+        if (n == 0) empty = true;
+        if (empty) continue;
+        uint64_t span = (uint64_t)(n - 1);
+        if (stride && span > (UINT64_MAX - last) / (uint64_t)stride) return false;
+        last += span * (uint64_t)stride;
+        if (!tensor.strides && (uint64_t)n > UINT64_MAX / compact) return false;
+        compact *= (uint64_t)n;
+    }
+    if (empty) return true;
+    if (last > UINT64_MAX / element - 1) return false;
+    *bytes = (last + 1) * element;
+    return true;
+}
+
+// ============================================================================
+// Export
+// ============================================================================
+
+DLManagedTensor *toDLPack(Buffer& buffer, const TensorLayout& layout, TensorDevice device, int32_t deviceId) {
+    if (!buffer.valid() || (!layout.strides.empty() && layout.strides.size() != layout.shape.size()) ||
+        layout.shape.size() > INT32_MAX) {
+        std::cerr << "[libNVDAAL] toDLPack: no buffer, or strides do not match the shape" << std::endl;
+        return nullptr;
+    }
+
+    void *data = nullptr;
+    if (device == TensorDevice::Gpu) data = (void *)(uintptr_t)buffer.gpuAddr();
+    else data = buffer.cpu();
+    if (!data) {
+        std::cerr << "[libNVDAAL] toDLPack: buffer has no " << (device == TensorDevice::Gpu ? "GPU VA" : "CPU mapping")
+                  << std::endl;
+        return nullptr;
+    }
+
+    Exported *exported = new (std::nothrow) Exported;
+    if (!exported) return nullptr;
+    exported->shape = layout.shape;
+    exported->strides = layout.strides;
+    if (exported->strides.empty()) {
+        exported->strides.resize(layout.shape.size());
+        int64_t compact = 1;
+        for (size_t i = layout.shape.size(); i-- > 0;) {
+            exported->strides[i] = compact;
+            compact *= layout.shape[i] > 0 ? layout.shape[i] : 1;
+        }
+    }
+
+    DLTensor& t = exported->managed.dl_tensor;
+    t.data = data;
+    t.device.device_type = device == TensorDevice::Gpu ? kDLExtDev : kDLCPU;
+    t.device.device_id = deviceId;
+    t.ndim = (int32_t)layout.shape.size();
+    t.dtype = layout.dtype;
+    t.shape = exported->shape.empty() ? nullptr : exported->shape.data();
+    t.strides = exported->strides.empty() ? nullptr : exported->strides.data();
+    t.byte_offset = layout.byteOffset;
+
+    uint64_t extent;
+    if (!tensorExtent(t, &extent) || layout.byteOffset > buffer.size() || extent > buffer.size() - layout.byteOffset) {
+        std::cerr << "[libNVDAAL] toDLPack: layout does not fit the " << buffer.size() << "-byte buffer" << std::endl;
+        delete exported;
+        return nullptr;
+    }
+
+    exported->pin = BufferPin(buffer);
+    exported->managed.manager_ctx = exported;
+    exported->managed.deleter = deleteExported;
+    return &exported->managed;
+}
+
+// ============================================================================
+// Import
+// ============================================================================
+
+DLPackTensor& DLPackTensor::operator=(DLPackTensor&& other) noexcept {
+    if (this != &other) {
+        reset();
+        managed = other.managed;
+        hold = std::move(other.hold);
+        first = other.first;
+        extent = other.extent;
+        other.managed = nullptr;
+    }
+    return *this;
+}
+
+void DLPackTensor::reset() {
+    if (managed && managed->deleter) managed->deleter(managed);
+    managed = nullptr;
+    hold.reset();
+    first = 0;
+    extent = 0;
+}
+
+DLPackTensor fromDLPack(BufferAllocator& allocator, DLManagedTensor *tensor) {
+    DLPackTensor imported;
+    if (!tensor) return imported;
+
+    const DLTensor& t = tensor->dl_tensor;
+    uint64_t extent;
+    if (!tensorExtent(t, &extent) || t.byte_offset > UINT64_MAX - extent || t.byte_offset + extent > SIZE_MAX) {
+        std::cerr << "[libNVDAAL] fromDLPack: bad shape, strides or dtype" << std::endl;
+        return imported;
+    }
+    size_t span = (size_t)(t.byte_offset + extent);
+
+    BufferPin pin;
+    uint64_t gpuAddr = 0;
+    if (t.device.device_type == kDLExtDev) {
+        gpuAddr = (uint64_t)(uintptr_t)t.data;
+        pin = allocator.find(gpuAddr, span);
+    } else if (t.device.device_type == kDLCPU) {
+        pin = allocator.find(t.data, span, &gpuAddr);
+    }
+    if (!pin.valid()) {
+        std::cerr << "[libNVDAAL] fromDLPack: tensor at " << t.data << " (device type " << t.device.device_type
+                  << ") is not in a live buffer" << std::endl;
+        return imported;
+    }
+
+    imported.managed = tensor;
+    imported.hold = std::move(pin);
+    imported.first = gpuAddr ? gpuAddr + t.byte_offset : 0;
+    imported.extent = extent;
+    return imported;
+}
+
+} // namespace nvdaal
@@ -0,0 +1,109 @@
+/*
+ * NVDAALDLPack.h - DLPack Tensor Export and Import
+ *
+ * DLPack is the tensor interchange PyTorch, JAX, CuPy, NumPy and TVM
+ * share: a DLManagedTensor describes memory (pointer, device, shape,
+ * strides, dtype) and carries the deleter its consumer calls when done.
+ * Handing one over moves a tensor between libNVDAAL and a framework
+ * without a copy or a host round trip.
+ *
+ * An exported tensor points at its Buffer one of two ways (TensorDevice):
+ *
+ *   Gpu  data is the buffer's GPU VA, device kDLExtDev: for GPU work
+ *        submitted through libNVDAAL
+ *   Cpu  data is its BAR1 mapping, device kDLCPU: host frameworks read
+ *        and write the VRAM in place (write-combined: reads are slow)
+ *
+ * The GPU VA is in NVDAAL's VASpace, not a CUDA context's, so it is not
+ * exported as kDLCUDA: a CUDA consumer would dereference it in its own
+ * address space.
+ *
+ * data is the buffer's start and byte_offset the tensor's offset in it,
+ * as DLPack asks of device memory. Strides are in elements; negative ones
+ * are refused.
+ *
+ * toDLPack() pins the buffer (BufferPin), so the Buffer may be reset while
+ * the tensor lives: the block goes back to the cache when the deleter
+ * runs. fromDLPack() takes a tensor whose memory lies in a live buffer of
+ * the allocator (exported here, or a framework's view of such a tensor),
+ * pins that buffer and owns the tensor until the DLPackTensor is reset.
+ * Tensors must not outlive their BufferAllocator; deleters may run on
+ * any thread.
+ */
+
+#ifndef LIB_NVDAAL_DLPACK_H
+#define LIB_NVDAAL_DLPACK_H
+
+#include "NVDAALBuffer.h"
+#include "nvdaal_dlpack.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace nvdaal {
+
+enum class TensorDevice {
+    Gpu,                                         // GPU VA, kDLExtDev
+    Cpu                                          // BAR1 mapping, kDLCPU
+};
+
+struct TensorLayout {
+    std::vector<int64_t> shape;
+    std::vector<int64_t> strides;                // In elements; empty = compact row-major
+    DLDataType dtype = { kDLFloat, 32, 1 };
+    uint64_t byteOffset = 0;                     // Into the buffer
+};
+
+// Bytes from data + byte_offset to the end of the last element; 0 if a
+// dimension is 0. False for negative shapes or strides, a dtype of no
+// bits, or overflow.
+bool tensorExtent(const DLTensor& tensor, uint64_t *bytes);
+
+// A new DLManagedTensor over `buffer`, which it pins; nullptr if the
+// layout does not fit in buffer.size() or the buffer has no such address.
+// The caller (or the framework it is handed to) must call its deleter.
+DLManagedTensor *toDLPack(Buffer& buffer, const TensorLayout& layout, TensorDevice device = TensorDevice::Gpu,
+                          int32_t deviceId = 0);
+
+// A tensor imported by fromDLPack(). Destroying or resetting it calls the
+// tensor's deleter.
+class DLPackTensor {
+public:
+    DLPackTensor() : managed(nullptr), first(0), extent(0) {}
+    ~DLPackTensor() { reset(); }
+
+    DLPackTensor(DLPackTensor&& other) noexcept
+        : managed(other.managed), hold(std::move(other.hold)), first(other.first), extent(other.extent) {
+        other.managed = nullptr;
+    }
+    DLPackTensor& operator=(DLPackTensor&& other) noexcept;
+    DLPackTensor(const DLPackTensor&) = delete;
+    DLPackTensor& operator=(const DLPackTensor&) = delete;
+
+    bool valid() const { return managed != nullptr; }
+    explicit operator bool() const { return valid(); }
+
+    const DLTensor& tensor() const { return managed->dl_tensor; }   // Valid tensors only
+    uint64_t gpuAddr() const { return first; }   // First element's GPU VA (0 if the slab is not mapped)
+    uint64_t bytes() const { return extent; }    // tensorExtent()
+    const BufferPin& pin() const { return hold; }  // For CommandBuffer::use()
+
+    void reset();
+
+private:
+    friend DLPackTensor fromDLPack(BufferAllocator& allocator, DLManagedTensor *tensor);
+    DLManagedTensor *managed;
+    BufferPin hold;
+    uint64_t first;
+    uint64_t extent;
+};
+
+// Takes ownership of `tensor` if its memory, [data, data + byte_offset +
+// extent), lies in one live buffer of `allocator` (kDLExtDev: by GPU VA;
+// kDLCPU: by BAR1 mapping). Otherwise returns an invalid DLPackTensor and
+// the tensor stays the caller's.
+DLPackTensor fromDLPack(BufferAllocator& allocator, DLManagedTensor *tensor);
+
+} // namespace nvdaal
+
+#endif // LIB_NVDAAL_DLPACK_H
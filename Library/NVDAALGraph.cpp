@@ -0,0 +1,169 @@
+/*
+ * NVDAALGraph.cpp - Captured Command Graphs
+ */
+
+#include "NVDAALGraph.h"
+#include "NVDAALCopy.h"
+#include "NVDAALPushbuffer.h"
+#include "NVDAALUserShared.h"
+#include <cstring>
+#include <iostream>
+
+namespace nvdaal {
+
+// Dwords a patch rewrites (see patch())
+static uint32_t patchDwords(Field field) {
+    switch (field) {
+        case Field::DispatchQmd: return 1;
+        case Field::CopyBytes: return 3;
+        default: return 2;
+    }
+}
+
+Graph::Graph(BufferAllocator& a, uint32_t n)
+    : allocator(&a), client(nullptr), buffering(n < 1 ? 1 : n > 32 ? 32 : n),
+      barrierFrom(0), barriers(0), dirtyParams(0), sem{ 0, 0 }, value(0), completed(0), launches(0),
+      patchedDwords(0), stalls(0) {}
+
+Graph::~Graph() {
+    if (!client) return;
+    if (!synchronize(5000)) std::cerr << "[libNVDAAL] Graph: launches still running at destruction" << std::endl;
+    client->destroySemaphore(sem);
+}
+
+uint32_t Graph::addNode(const CommandBuffer& cb, const uint32_t *deps, uint32_t depCount) {
+    uint32_t index = (uint32_t)nodes.size();
+    if (client || cb.failed() || cb.sizeBytes() == 0) return kInvalid;
+    for (uint32_t i = 0; i < depCount; i++) {
+        if (deps[i] >= index) return kInvalid;
+    }
+
+    // A dependency on a node issued since the last barrier needs a new one;
+    // anything older is already ordered
+    bool needBarrier = false;
+    for (uint32_t i = 0; i < depCount; i++) {
+        if (deps[i] >= barrierFrom) needBarrier = true;
+    }
+    if (needBarrier) {
+        size_t at = words.size();
+        words.resize(at + NV_PB_BARRIER_DWORDS);
+        NvPushbuffer pb;
+        nvPbInit(&pb, &words[at], NV_PB_BARRIER_DWORDS * sizeof(uint32_t));
+        nvPbPushBarrier(&pb);
+        barrierFrom = index;
+        barriers++;
+    }
+
+    Node node;
+    node.first = (uint32_t)words.size();
+    node.dwords = cb.sizeBytes() / sizeof(uint32_t);
+    words.insert(words.end(), cb.data(), cb.data() + node.dwords);
+    nodes.push_back(node);
+    pins.insert(pins.end(), cb.pinnedBuffers().begin(), cb.pinnedBuffers().end());
+    return index;
+}
+
+uint32_t Graph::addParam(uint32_t node, const PatchPoint& point) {
+    if (client || node >= nodes.size() || !point.valid() ||
+        point.dword + patchDwords(point.field) > nodes[node].dwords) {
+        return kInvalid;
+    }
+    Param param;
+    param.point = point;
+    param.point.dword += nodes[node].first;
+    param.dirty = 0;
+    params.push_back(param);
+    return (uint32_t)params.size() - 1;
+}
+
+bool Graph::instantiate(Client& c) {
+    size_t bytes = words.size() * sizeof(uint32_t);
+    if (client || bytes == 0 || bytes > NVDAAL_MAX_PUSHBUFFER_BYTES) return false;
+
+    images.resize(buffering);
+    for (Image& image : images) {
+        image.buffer = allocator->allocate(bytes);
+        image.cpu = (uint32_t *)image.buffer.cpu();
+        image.lastValue = 0;
+        if (!image.buffer.gpuAddr() || !image.cpu) {
+            images.clear();
+            return false;
+        }
+        streamCopy(image.cpu, words.data(), bytes);
+    }
+    if (!c.createSemaphore(&sem)) {
+        images.clear();
+        return false;
+    }
+    client = &c;
+    return true;
+}
+
+bool Graph::setParam(uint32_t param, uint64_t v) {
+    if (param >= params.size()) return false;
+    Param& p = params[param];
+    patch(words.data(), p.point, v);
+    if (!p.dirty) dirtyParams++;
+    p.dirty = buffering == 32 ? ~0u : (1u << buffering) - 1;
+    return true;
+}
+
+uint64_t Graph::launch() {
+    if (!client) return 0;
+
+    Image& image = images[launches % buffering];
+    uint32_t bit = 1u << (launches % buffering);
+    if (image.lastValue > completed) {
+        // Only ask the driver when the last known payload isn't enough
+        if (!client->readSemaphore(sem, &completed)) return 0;
+        if (completed < image.lastValue) {
+            stalls++;
+            if (!wait(image.lastValue)) return 0;
+        }
+    }
+
+    // Bring this image up to date: only the patched dwords cross BAR1
+    for (uint32_t i = 0; dirtyParams && i < params.size(); i++) {
+        Param& p = params[i];
+        if (!(p.dirty & bit)) continue;
+        uint32_t n = patchDwords(p.point.field);
+        memcpy(image.cpu + p.point.dword, &words[p.point.dword], n * sizeof(uint32_t));
+        patchedDwords += n;
+        p.dirty &= ~bit;
+        if (!p.dirty) dirtyParams--;
+    }
+
+    if (!client->submitPushbuffer(image.buffer.gpuAddr(), (uint32_t)(words.size() * sizeof(uint32_t)), sem,
+                                  value + 1)) {
+        return 0;
+    }
+    image.lastValue = ++value;
+    launches++;
+    return value;
+}
+
+bool Graph::wait(uint64_t v, uint32_t timeoutMs) {
+    if (!client) return false;
+    if (v <= completed) return true;
+    if (!client->waitSemaphore(sem, v, timeoutMs)) return false;
+    completed = v;
+    return true;
+}
+
+bool Graph::synchronize(uint32_t timeoutMs) {
+    return !value || wait(value, timeoutMs);
+}
+
+GraphStats Graph::stats() const {
+    GraphStats s;
+    s.nodes = (uint32_t)nodes.size();
+    s.barriers = barriers;
+    s.params = (uint32_t)params.size();
+    s.sizeBytes = (uint32_t)(words.size() * sizeof(uint32_t));
+    s.launches = launches;
+    s.patchedDwords = patchedDwords;
+    s.stalls = stalls;
+    return s;
+}
+
+} // namespace nvdaal
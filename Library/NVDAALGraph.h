@@ -0,0 +1,111 @@
+/*
+ * NVDAALGraph.h - Captured Command Graphs
+ *
+ * A Graph captures recorded CommandBuffers as nodes with dependencies,
+ * once, and instantiate() lays them out as a single pushbuffer in VRAM:
+ * nodes in capture order, with a barrier only where a node depends on
+ * work issued since the last one. launch() replays the whole graph with
+ * one SubmitPushbuffer call and no encoding.
+ *
+ * Values that change per step (buffer addresses, copy sizes, semaphore
+ * payloads) are parameters: setParam() rewrites them in place and the
+ * next launch() writes just the patched dwords into the image it submits.
+ * The image is replicated `buffering` times so patching never touches a
+ * pushbuffer the GPU may still be fetching; launch() waits on the graph's
+ * timeline only when every copy is still in flight.
+ *
+ * Nodes keep the buffers their recordings pinned alive for the Graph's
+ * lifetime. The destructor waits for outstanding launches.
+ */
+
+#ifndef LIB_NVDAAL_GRAPH_H
+#define LIB_NVDAAL_GRAPH_H
+
+#include "NVDAALCommandBuffer.h"
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+namespace nvdaal {
+
+struct GraphStats {
+    uint32_t nodes;
+    uint32_t barriers;                           // Inserted for dependencies
+    uint32_t params;
+    uint32_t sizeBytes;                          // Of one image
+    uint64_t launches;
+    uint64_t patchedDwords;                      // Written to VRAM by launches
+    uint64_t stalls;                             // Launches that waited for a free image
+};
+
+class Graph {
+public:
+    static const uint32_t kInvalid = UINT32_MAX;
+
+    explicit Graph(BufferAllocator& allocator, uint32_t buffering = 2);
+    ~Graph();
+
+    Graph(const Graph&) = delete;
+    Graph& operator=(const Graph&) = delete;
+
+    // Capture (before instantiate()). Nodes may only depend on earlier
+    // nodes; the recording is copied, so `cb` can be reused right away.
+    uint32_t addNode(const CommandBuffer& cb, const uint32_t *deps, uint32_t depCount);
+    uint32_t addNode(const CommandBuffer& cb, std::initializer_list<uint32_t> deps = {}) {
+        return addNode(cb, deps.begin(), (uint32_t)deps.size());
+    }
+
+    // A patch point from cb.field(), taken right after recording the command
+    // into the CommandBuffer that became `node`
+    uint32_t addParam(uint32_t node, const PatchPoint& point);
+
+    // Lay out and upload the images; creates the timeline
+    bool instantiate(Client& client);
+    bool instantiated() const { return client != nullptr; }
+
+    // Replay
+    bool setParam(uint32_t param, uint64_t value);
+    uint64_t launch();                           // Timeline value that marks completion, 0 on failure
+    bool wait(uint64_t value, uint32_t timeoutMs = 1000);
+    bool synchronize(uint32_t timeoutMs = 1000);  // Every launch so far
+    const Semaphore& timeline() const { return sem; }
+
+    GraphStats stats() const;
+
+private:
+    struct Node {
+        uint32_t first;                          // First dword in the image
+        uint32_t dwords;
+    };
+    struct Param {
+        PatchPoint point;                        // Relative to the image
+        uint32_t dirty;                          // One bit per image
+    };
+    struct Image {
+        Buffer buffer;
+        uint32_t *cpu;
+        uint64_t lastValue;                      // Timeline value of its last launch
+    };
+
+    BufferAllocator *allocator;
+    Client *client;
+    uint32_t buffering;
+    std::vector<uint32_t> words;                 // Host image, parameters current
+    std::vector<Node> nodes;
+    std::vector<Param> params;
+    std::vector<BufferPin> pins;
+    std::vector<Image> images;
+    uint32_t barrierFrom;                        // First node after the last barrier
+    uint32_t barriers;
+    uint32_t dirtyParams;                        // Params with any dirty bit set
+    Semaphore sem;
+    uint64_t value;
+    uint64_t completed;                          // Timeline payload last seen
+    uint64_t launches;
+    uint64_t patchedDwords;
+    uint64_t stalls;
+};
+
+} // namespace nvdaal
+
+#endif // LIB_NVDAAL_GRAPH_H
@@ -0,0 +1,145 @@
+/*
+ * NVDAALMemoryPool.cpp - Stream-Ordered Allocation
+ */
+
+#include "NVDAALMemoryPool.h"
+#include <utility>
+#include <vector>
+
+namespace nvdaal {
+
+namespace {
+
+// Timeline payloads, each read at most once per pool call. A timeline that
+// can no longer be read belonged to a Stream that synchronized when it was
+// destroyed, so its events are complete.
+class Progress {
+public:
+    bool reached(const Event& event) {
+        if (!event.recorded()) return true;
+        for (const auto& s : seen) {
+            if (s.first == event.sem.handle) return s.second >= event.value;
+        }
+        uint64_t payload = 0;
+        if (!event.client->readSemaphore(event.sem, &payload)) payload = UINT64_MAX;
+        seen.push_back({ event.sem.handle, payload });
+        return payload >= event.value;
+    }
+
+private:
+    std::vector<std::pair<uint32_t, uint64_t>> seen;
+};
+
+} // namespace
+
+MemoryPool::MemoryPool(BufferAllocator& a, const MemoryPoolConfig& cfg)
+    : allocator(&a), config(cfg), counters() {}
+
+MemoryPool::~MemoryPool() {
+    Progress progress;
+    for (auto& entry : cached) {
+        if (!progress.reached(entry.second.fence)) entry.second.fence.synchronize(5000);
+    }
+}
+
+Buffer MemoryPool::allocate(size_t size, Stream& stream) {
+    if (size == 0 || size > BufferAllocator::kMaxSize || !stream.valid()) return Buffer();
+    size_t rounded = BufferAllocator::roundSize(size);
+
+    std::lock_guard<std::mutex> guard(lock);
+    Progress progress;
+    auto waitable = cached.end();
+    for (auto it = cached.lower_bound(rounded); it != cached.end() && it->first / 2 <= rounded; ++it) {
+        if (it->second.stream == &stream) {
+            counters.reusedSameStream++;
+            return take(it, size);
+        }
+        if (progress.reached(it->second.fence)) {
+            counters.reusedCompleted++;
+            return take(it, size);
+        }
+        if (waitable == cached.end()) waitable = it;
+    }
+    if (waitable != cached.end() && config.reuseWithWait && stream.wait(waitable->second.fence)) {
+        counters.reusedWithWait++;
+        return take(waitable, size);
+    }
+
+    // Blocks this pool holds don't serve other sizes: give back the ones
+    // that completed if the allocator can't find room without them, and
+    // as a last resort wait for one that hasn't
+    Buffer buffer = allocator->allocate(size);
+    if (!buffer && trimLocked(0)) buffer = allocator->allocate(size);
+    if (!buffer) {
+        auto it = cached.lower_bound(rounded);
+        if (it != cached.end() && it->first / 2 <= rounded && stream.wait(it->second.fence)) {
+            counters.reusedWithWait++;
+            return take(it, size);
+        }
+        counters.failures++;
+        return Buffer();
+    }
+    counters.allocatorCalls++;
+    counters.allocations++;
+    return buffer;
+}
+
+bool MemoryPool::free(Buffer&& buffer, Stream& stream) {
+    if (!buffer) return true;
+    if (buffer.allocator != allocator || !stream.valid()) return false;
+
+    std::lock_guard<std::mutex> guard(lock);
+    Event fence = stream.record();
+    size_t capacity = buffer.capacity();
+    cached.emplace(capacity, Cached{ std::move(buffer), &stream, fence });
+    counters.frees++;
+    counters.cachedBytes += capacity;
+    if (counters.cachedBytes > counters.peakCachedBytes) counters.peakCachedBytes = counters.cachedBytes;
+    if (counters.cachedBytes > config.releaseThreshold) trimLocked(config.releaseThreshold);
+    return true;
+}
+
+size_t MemoryPool::trim(size_t keepBytes) {
+    std::lock_guard<std::mutex> guard(lock);
+    return trimLocked(keepBytes);
+}
+
+void MemoryPool::setReleaseThreshold(size_t bytes) {
+    std::lock_guard<std::mutex> guard(lock);
+    config.releaseThreshold = bytes;
+    if (counters.cachedBytes > bytes) trimLocked(bytes);
+}
+
+MemoryPoolStats MemoryPool::stats() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return counters;
+}
+
+// Hand a cached block out again (lock held)
+Buffer MemoryPool::take(std::multimap<size_t, Cached>::iterator it, size_t size) {
+    Buffer buffer = std::move(it->second.buffer);
+    cached.erase(it);
+    counters.cachedBytes -= buffer.capacity();
+    counters.allocations++;
+    allocator->reuse(buffer.block, size);
+    return buffer;
+}
+
+// Largest completed blocks first, until at most keepBytes are cached (lock held)
+size_t MemoryPool::trimLocked(size_t keepBytes) {
+    Progress progress;
+    size_t released = 0;
+    auto it = cached.end();
+    while (it != cached.begin() && counters.cachedBytes > keepBytes) {
+        --it;
+        if (!progress.reached(it->second.fence)) continue;
+        size_t capacity = it->first;
+        it = cached.erase(it);                   // Buffer goes back to the allocator cache
+        counters.cachedBytes -= capacity;
+        counters.trimmed++;
+        released += capacity;
+    }
+    return released;
+}
+
+} // namespace nvdaal
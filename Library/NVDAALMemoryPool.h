@@ -0,0 +1,95 @@
+/*
+ * NVDAALMemoryPool.h - Stream-Ordered Allocation
+ *
+ * MemoryPool::allocate(size, stream) and free(buffer, stream) are the
+ * stream-ordered counterparts of BufferAllocator::allocate() and
+ * Buffer::reset(). free() records the stream's position instead of
+ * waiting for the GPU, and the pool keeps the block until it is safe to
+ * hand out again:
+ *
+ *   same stream     at once: its later work runs after the free
+ *   other streams   once the recorded event has completed; before that
+ *                   only behind a GPU-side wait on it, which orders the
+ *                   two streams, so only when out of VRAM (or always,
+ *                   with reuseWithWait)
+ *
+ * Memory from allocate() is ready in stream order, not on the host: touch
+ * it through cpu() only once the stream's earlier work has completed, and
+ * order other streams on it with events like any other stream work.
+ *
+ * A cached block serves requests down to half its size, best fit. The
+ * driver cannot take VRAM back, so trimming hands completed blocks back
+ * to the BufferAllocator cache, where they merge and serve any request:
+ * free() trims down to releaseThreshold, trim() to any level, and an
+ * allocate() the allocator cannot satisfy trims everything it can and
+ * retries.
+ */
+
+#ifndef LIB_NVDAAL_MEMORY_POOL_H
+#define LIB_NVDAAL_MEMORY_POOL_H
+
+#include "NVDAALStream.h"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+
+namespace nvdaal {
+
+struct MemoryPoolConfig {
+    size_t releaseThreshold = SIZE_MAX;          // Cached bytes free() keeps; SIZE_MAX = never trim
+    bool reuseWithWait = false;                  // Wait for another stream's pending block rather than grow
+};
+
+struct MemoryPoolStats {
+    uint64_t allocations;                        // allocate() calls that succeeded
+    uint64_t frees;
+    uint64_t reusedSameStream;                   // Cache hits by stream order alone
+    uint64_t reusedCompleted;                    // Cache hits whose free had completed
+    uint64_t reusedWithWait;                     // Cache hits behind a GPU-side wait
+    uint64_t allocatorCalls;                     // Misses served by the BufferAllocator
+    uint64_t failures;
+    uint64_t trimmed;                            // Blocks handed back to the BufferAllocator
+    uint64_t cachedBytes;                        // Freed blocks held by the pool
+    uint64_t peakCachedBytes;
+};
+
+class MemoryPool {
+public:
+    explicit MemoryPool(BufferAllocator& allocator, const MemoryPoolConfig& config = MemoryPoolConfig());
+    ~MemoryPool();                               // Waits for outstanding frees
+
+    MemoryPool(const MemoryPool&) = delete;
+    MemoryPool& operator=(const MemoryPool&) = delete;
+
+    Buffer allocate(size_t size, Stream& stream);    // Invalid Buffer on failure
+
+    // Takes the buffer once `stream`'s work so far is done with it; false
+    // (buffer untouched) for another allocator's buffer or an invalid stream
+    bool free(Buffer&& buffer, Stream& stream);
+
+    size_t trim(size_t keepBytes = 0);           // Bytes handed back; pending blocks stay
+    void setReleaseThreshold(size_t bytes);
+
+    MemoryPoolStats stats() const;
+
+private:
+    struct Cached {
+        Buffer buffer;
+        const Stream *stream;                    // Freed on; may since be destroyed
+        Event fence;                             // Its position at the free
+    };
+
+    BufferAllocator *allocator;
+    MemoryPoolConfig config;
+    mutable std::mutex lock;
+    std::multimap<size_t, Cached> cached;        // By capacity
+    MemoryPoolStats counters;
+
+    Buffer take(std::multimap<size_t, Cached>::iterator it, size_t size);
+    size_t trimLocked(size_t keepBytes);
+};
+
+} // namespace nvdaal
+
+#endif // LIB_NVDAAL_MEMORY_POOL_H
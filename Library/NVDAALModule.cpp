@@ -0,0 +1,761 @@
+/*
+ * NVDAALModule.cpp - CUDA Modules (cubin / fatbin)
+ */
+
+#include "NVDAALModule.h"
+#include "NVDAALCopy.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace nvdaal {
+
+namespace {
+
+// ============================================================================
+// ELF64 and Fatbin Layouts
+// ============================================================================
+
+// Declared here rather than taken from <elf.h>, which macOS lacks
+struct ElfHeader {
+    uint8_t ident[16];
+    uint16_t type;
+    uint16_t machine;
+    uint32_t version;
+    uint64_t entry;
+    uint64_t phoff;
+    uint64_t shoff;
+    uint32_t flags;
+    uint16_t ehsize;
+    uint16_t phentsize;
+    uint16_t phnum;
+    uint16_t shentsize;
+    uint16_t shnum;
+    uint16_t shstrndx;
+};
+
+struct ElfSection {
+    uint32_t name;
+    uint32_t type;
+    uint64_t flags;
+    uint64_t addr;
+    uint64_t offset;
+    uint64_t size;
+    uint32_t link;
+    uint32_t info;
+    uint64_t addralign;
+    uint64_t entsize;
+};
+
+struct ElfSymbol {
+    uint32_t name;
+    uint8_t info;
+    uint8_t other;
+    uint16_t shndx;
+    uint64_t value;
+    uint64_t size;
+};
+
+static_assert(sizeof(ElfHeader) == 64, "Elf64_Ehdr");
+static_assert(sizeof(ElfSection) == 64, "Elf64_Shdr");
+static_assert(sizeof(ElfSymbol) == 24, "Elf64_Sym");
+
+const uint16_t kEmCuda = 190;
+const uint32_t kShtProgbits = 1;
+const uint32_t kShtSymtab = 2;
+const uint32_t kShtRela = 4;
+const uint32_t kShtRel = 9;
+const uint64_t kShfExecInstr = 0x4;
+const uint8_t kSttFunc = 2;
+const uint8_t kStoCudaEntry = 0x10;              // st_other: a kernel, not a device function
+
+// .nv.info records: format, attribute, then a 16-bit value (EIFMT_HVAL)
+// or the byte count of the data that follows (EIFMT_SVAL)
+const uint8_t kEifmtSval = 0x04;
+const uint8_t kEiattrMaxThreads = 0x05;
+const uint8_t kEiattrParamCbank = 0x0A;
+const uint8_t kEiattrReqntid = 0x10;
+const uint8_t kEiattrFrameSize = 0x11;
+const uint8_t kEiattrMinStackSize = 0x12;
+const uint8_t kEiattrKparamInfo = 0x17;
+const uint8_t kEiattrCbankParamSize = 0x19;
+const uint8_t kEiattrMaxStackSize = 0x23;
+const uint8_t kEiattrRegcount = 0x2F;
+
+const uint32_t kCodeAlign = 128;
+const uint32_t kConstantAlign = 256;
+
+// A fatbin is one or more containers, each a header and its entries
+const uint32_t kFatbinMagic = 0xBA55ED50;
+const uint16_t kFatbinElf = 2;
+const uint64_t kFatbinCompressed = 0x2000;
+
+struct FatbinHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t headerSize;
+    uint64_t bytes;                              // Of the entries that follow
+};
+
+struct FatbinEntry {
+    uint16_t kind;                               // 1 PTX, 2 cubin
+    uint16_t version;
+    uint32_t headerSize;                         // Payload follows at this offset
+    uint64_t bytes;
+    uint32_t compressedBytes;
+    uint32_t reserved0;
+    uint16_t minor;
+    uint16_t major;
+    uint32_t arch;                               // e.g. 89
+    uint32_t nameOffset;
+    uint32_t nameBytes;
+    uint64_t flags;
+};
+
+static_assert(sizeof(FatbinHeader) == 16, "fatbin header");
+static_assert(sizeof(FatbinEntry) == 48, "fatbin entry header");
+
+template <typename T>
+bool readAt(const uint8_t *data, size_t bytes, uint64_t offset, T *out) {
+    if (offset > bytes || bytes - offset < sizeof(T)) return false;
+    memcpy(out, data + offset, sizeof(T));
+    return true;
+}
+
+uint32_t read32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+uint32_t alignUp(uint32_t value, uint32_t align) {
+    return (value + align - 1) & ~(align - 1);
+}
+
+// sm_XY runs cubins built for sm_XZ with Z <= Y
+bool runs(uint32_t targetSm, uint32_t cubinSm) {
+    return cubinSm / 10 == targetSm / 10 && cubinSm <= targetSm;
+}
+
+// The SM sits in the low byte of e_flags; newer toolchains moved it to
+// bits 8-15 and leave the low byte clear
+uint32_t cubinArch(const ElfHeader& eh) {
+    uint32_t sm = eh.flags & 0xFF;
+    return sm ? sm : (eh.flags >> 8) & 0xFF;
+}
+
+bool isCubin(const uint8_t *data, size_t bytes, ElfHeader *eh) {
+    return readAt(data, bytes, 0, eh) && memcmp(eh->ident, "\x7f" "ELF", 4) == 0 &&
+           eh->ident[4] == 2 && eh->ident[5] == 1 && eh->machine == kEmCuda;
+}
+
+// The newest cubin in a fatbin that `targetSm` runs
+bool pickCubin(const uint8_t *data, size_t bytes, uint32_t targetSm,
+               const uint8_t **cubin, size_t *cubinBytes, bool *sawCompressed) {
+    uint32_t best = 0;
+    uint64_t at = 0;
+    FatbinHeader fh;
+    while (readAt(data, bytes, at, &fh) && fh.magic == kFatbinMagic) {
+        uint64_t end = at + fh.headerSize + fh.bytes;
+        if (fh.headerSize < sizeof(FatbinHeader) || end < at || end > bytes) return false;
+
+        uint64_t entry = at + fh.headerSize;
+        FatbinEntry fe;
+        while (entry < end && readAt(data, end, entry, &fe)) {
+            uint64_t payload = entry + fe.headerSize;
+            if (fe.headerSize < sizeof(FatbinEntry) || payload + fe.bytes < payload || payload + fe.bytes > end) {
+                return false;
+            }
+            if (fe.kind == kFatbinElf && runs(targetSm, fe.arch) && fe.arch > best) {
+                if (fe.flags & kFatbinCompressed) {
+                    *sawCompressed = true;
+                } else {
+                    best = fe.arch;
+                    *cubin = data + payload;
+                    *cubinBytes = (size_t)fe.bytes;
+                }
+            }
+            entry = payload + fe.bytes;
+        }
+        at = end;
+    }
+    return best != 0;
+}
+
+} // namespace
+
+// ============================================================================
+// Hashing
+// ============================================================================
+
+namespace {
+
+const uint64_t kPrime1 = 11400714785074694791ULL;
+const uint64_t kPrime2 = 14029467366897019727ULL;
+const uint64_t kPrime3 = 1609587929392839161ULL;
+const uint64_t kPrime4 = 9650029242287828579ULL;
+const uint64_t kPrime5 = 2870177450012600261ULL;
+
+inline uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+inline uint64_t read64(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+inline uint64_t xxRound(uint64_t acc, uint64_t input) {
+    return rotl(acc + input * kPrime2, 31) * kPrime1;
+}
+
+inline uint64_t xxMerge(uint64_t acc, uint64_t value) {
+    return (acc ^ xxRound(0, value)) * kPrime1 + kPrime4;
+}
+
+} // namespace
+
+uint64_t moduleHash(const void *data, size_t bytes) {
+    const uint8_t *p = (const uint8_t *)data;
+    const uint8_t *end = p + bytes;
+    uint64_t h;
+
+    if (bytes >= 32) {
+        uint64_t v1 = kPrime1 + kPrime2, v2 = kPrime2, v3 = 0, v4 = 0 - kPrime1;
+        for (; end - p >= 32; p += 32) {
+            v1 = xxRound(v1, read64(p));
+            v2 = xxRound(v2, read64(p + 8));
+            v3 = xxRound(v3, read64(p + 16));
+            v4 = xxRound(v4, read64(p + 24));
+        }
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = xxMerge(xxMerge(xxMerge(xxMerge(h, v1), v2), v3), v4);
+    } else {
+        h = kPrime5;
+    }
+    h += bytes;
+
+    for (; end - p >= 8; p += 8) h = rotl(h ^ xxRound(0, read64(p)), 27) * kPrime1 + kPrime4;
+    if (end - p >= 4) {
+        h = rotl(h ^ (uint64_t)read32(p) * kPrime1, 23) * kPrime2 + kPrime3;
+        p += 4;
+    }
+    for (; p < end; p++) h = rotl(h ^ *p * kPrime5, 11) * kPrime1;
+
+    h ^= h >> 33;
+    h *= kPrime2;
+    h ^= h >> 29;
+    h *= kPrime3;
+    h ^= h >> 32;
+    return h;
+}
+
+// ============================================================================
+// Cubin Parsing
+// ============================================================================
+
+// One pass over the section headers per step; kernels are found through
+// their entry symbols, everything per kernel by section name suffix
+struct CubinParser {
+    Module& m;
+    const uint8_t *data;
+    size_t bytes;
+    ElfHeader eh;
+    std::vector<ElfSection> sections;
+    const ElfSection *shstr = nullptr;
+    std::vector<uint32_t> sectionImage;          // Code offset per section, or kNone
+    std::vector<int32_t> symbolKernel;           // Kernel per symbol index, or -1
+    std::vector<int32_t> sectionKernel;          // Kernel per code section, or -1
+    std::vector<std::pair<uint32_t, KernelParam>> params;   // (kernel, param)
+    std::vector<std::pair<uint32_t, ConstantBank>> banks;   // (kernel, bank)
+    std::vector<uint32_t> frameBytes;
+
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    CubinParser(Module& module, const uint8_t *d, size_t n) : m(module), data(d), bytes(n) {}
+
+    bool fail(const char *why) {
+        std::cerr << "[libNVDAAL] Module: " << why << std::endl;
+        return false;
+    }
+
+    std::string_view stringAt(const ElfSection& table, uint32_t offset) const {
+        if (offset >= table.size || table.offset > bytes || table.size > bytes - table.offset) return {};
+        const char *s = (const char *)data + table.offset + offset;
+        return std::string_view(s, strnlen(s, (size_t)(table.size - offset)));
+    }
+
+    std::string_view nameOf(const ElfSection& s) const { return stringAt(*shstr, s.name); }
+
+    bool contents(const ElfSection& s) const {
+        return s.offset <= bytes && s.size <= bytes - s.offset;
+    }
+
+    int32_t kernelNamed(std::string_view name) const {
+        auto it = m.byName.find(name);
+        return it == m.byName.end() ? -1 : (int32_t)it->second;
+    }
+
+    bool run(uint32_t targetSm) {
+        if (!isCubin(data, bytes, &eh)) return fail("not a cubin (ELF64 for EM_CUDA)");
+        uint32_t sm = cubinArch(eh);
+        if (!runs(targetSm, sm)) {
+            std::cerr << "[libNVDAAL] Module: cubin is for sm_" << sm << ", not runnable on sm_" << targetSm << std::endl;
+            return false;
+        }
+        if (!readSections()) return false;
+        if (!layoutCode() || !findKernels() || !readSectionsByName()) return false;
+        finish();
+        m.sm = sm;
+        return true;
+    }
+
+    bool readSections() {
+        if (eh.shentsize != sizeof(ElfSection) || eh.shnum == 0 || eh.shstrndx >= eh.shnum ||
+            eh.shoff > bytes || (uint64_t)eh.shnum * sizeof(ElfSection) > bytes - eh.shoff) {
+            return fail("bad section header table");
+        }
+        sections.resize(eh.shnum);
+        memcpy(sections.data(), data + eh.shoff, eh.shnum * sizeof(ElfSection));
+        shstr = &sections[eh.shstrndx];
+        for (const ElfSection& s : sections) {
+            if ((s.type == kShtRel || s.type == kShtRela) && s.size) {
+                return fail("cubin needs relocating (device globals or separate compilation)");
+            }
+        }
+        return true;
+    }
+
+    // Code sections in file order, so relative branches between them hold
+    bool layoutCode() {
+        sectionImage.assign(sections.size(), kNone);
+        uint64_t at = 0;
+        for (size_t i = 0; i < sections.size(); i++) {
+            const ElfSection& s = sections[i];
+            if (s.type != kShtProgbits || !(s.flags & kShfExecInstr) || !s.size) continue;
+            if (!contents(s)) return fail("code section out of bounds");
+            uint64_t align = s.addralign > kCodeAlign ? s.addralign : kCodeAlign;
+            if (align & (align - 1)) return fail("bad code alignment");
+            at = (at + align - 1) & ~(align - 1);
+            if (at + s.size > UINT32_MAX / 2) return fail("code too large");
+            sectionImage[i] = (uint32_t)at;
+            m.image.resize(at + s.size);
+            memcpy(&m.image[at], data + s.offset, s.size);
+            at += s.size;
+        }
+        return true;
+    }
+
+    bool findKernels() {
+        const ElfSection *symtab = nullptr;
+        for (const ElfSection& s : sections) {
+            if (s.type == kShtSymtab) symtab = &s;
+        }
+        if (!symtab || symtab->link >= sections.size() || !contents(*symtab)) return fail("no symbol table");
+        const ElfSection& strtab = sections[symtab->link];
+        size_t count = symtab->size / sizeof(ElfSymbol);
+        const uint8_t *symbols = data + symtab->offset;
+
+        // Names first, so the views the lookup table keeps never move
+        std::vector<std::pair<uint32_t, ElfSymbol>> found;
+        size_t nameBytes = 0;
+        for (size_t i = 0; i < count; i++) {
+            ElfSymbol sym;
+            memcpy(&sym, symbols + i * sizeof(ElfSymbol), sizeof(sym));
+            if ((sym.info & 0xF) != kSttFunc || !(sym.other & kStoCudaEntry)) continue;
+            if (sym.shndx >= sections.size() || sectionImage[sym.shndx] == kNone) continue;
+            std::string_view name = stringAt(strtab, sym.name);
+            if (name.empty()) continue;
+            found.push_back({ (uint32_t)i, sym });
+            nameBytes += name.size() + 1;
+        }
+        if (found.empty()) return fail("no kernels");
+
+        m.names.resize(nameBytes);
+        m.entries.resize(found.size());
+        m.byName.reserve(found.size());
+        symbolKernel.assign(count, -1);
+        sectionKernel.assign(sections.size(), -1);
+        frameBytes.assign(found.size(), 0);
+        size_t at = 0;
+        for (size_t k = 0; k < found.size(); k++) {
+            const ElfSymbol& sym = found[k].second;
+            std::string_view name = stringAt(strtab, sym.name);
+            char *copy = &m.names[at];
+            memcpy(copy, name.data(), name.size());
+            copy[name.size()] = '\0';
+            at += name.size() + 1;
+            if (!m.byName.emplace(std::string_view(copy, name.size()), (uint32_t)k).second) {
+                return fail("duplicate kernel name");
+            }
+
+            const ElfSection& text = sections[sym.shndx];
+            if (sym.value >= text.size) return fail("kernel entry outside its section");
+            Kernel& kernel = m.entries[k];
+            memset(&kernel, 0, sizeof(kernel));
+            kernel.name = copy;
+            kernel.codeOffset = sectionImage[sym.shndx] + (uint32_t)sym.value;
+            kernel.codeBytes = (uint32_t)(sym.size && sym.size <= text.size - sym.value ? sym.size : text.size - sym.value);
+            symbolKernel[found[k].first] = (int32_t)k;
+            sectionKernel[sym.shndx] = (int32_t)k;
+        }
+        return true;
+    }
+
+    bool readSectionsByName() {
+        static const std::string_view kInfo = ".nv.info";
+        static const std::string_view kShared = ".nv.shared.";
+        static const std::string_view kConstant = ".nv.constant";
+
+        for (const ElfSection& s : sections) {
+            std::string_view name = nameOf(s);
+            if (name.substr(0, kInfo.size()) == kInfo) {
+                if (!contents(s)) return fail(".nv.info section out of bounds");
+                if (name.size() == kInfo.size()) {
+                    readGlobalInfo(s);
+                } else if (name[kInfo.size()] == '.') {
+                    int32_t k = s.info < sectionKernel.size() ? sectionKernel[s.info] : -1;
+                    if (k < 0) k = kernelNamed(name.substr(kInfo.size() + 1));
+                    if (k >= 0) readKernelInfo(s, (uint32_t)k);
+                }
+            } else if (name.substr(0, kShared.size()) == kShared) {
+                int32_t k = kernelNamed(name.substr(kShared.size()));
+                if (k >= 0) m.entries[k].sharedBytes = (uint32_t)s.size;
+            } else if (name.substr(0, kConstant.size()) == kConstant) {
+                if (!readConstantBank(s, name.substr(kConstant.size()))) return false;
+            }
+        }
+        return true;
+    }
+
+    // Walk EIFMT records; `visit` gets the attribute, the 16-bit value and,
+    // for EIFMT_SVAL, the data
+    template <typename Visit>
+    void walkInfo(const ElfSection& s, Visit visit) {
+        const uint8_t *p = data + s.offset;
+        const uint8_t *end = p + s.size;
+        while (end - p >= 4) {
+            uint8_t format = p[0];
+            uint8_t attr = p[1];
+            uint16_t value = (uint16_t)(p[2] | p[3] << 8);
+            p += 4;
+            if (format == kEifmtSval) {
+                if (end - p < value) return;
+                visit(attr, value, p);
+                p += value;
+            } else {
+                visit(attr, value, nullptr);
+            }
+        }
+    }
+
+    // Per-function values, each record { symbol, value }
+    void readGlobalInfo(const ElfSection& s) {
+        walkInfo(s, [&](uint8_t attr, uint16_t size, const uint8_t *v) {
+            if (!v || size < 8) return;
+            uint32_t sym = read32(v);
+            int32_t k = sym < symbolKernel.size() ? symbolKernel[sym] : -1;
+            if (k < 0) return;
+            uint32_t value = read32(v + 4);
+            Kernel& kernel = m.entries[k];
+            switch (attr) {
+                case kEiattrRegcount: kernel.registers = value; break;
+                case kEiattrFrameSize: frameBytes[k] = value; break;
+                case kEiattrMinStackSize:
+                case kEiattrMaxStackSize:
+                    if (value > kernel.localBytes) kernel.localBytes = value;
+                    break;
+                default: break;
+            }
+        });
+    }
+
+    void readKernelInfo(const ElfSection& s, uint32_t k) {
+        Kernel& kernel = m.entries[k];
+        walkInfo(s, [&](uint8_t attr, uint16_t size, const uint8_t *v) {
+            switch (attr) {
+                case kEiattrKparamInfo:
+                    // { index, ordinal:16 offset:16, log2 pointee align:8 ... size:14 at bit 18 }
+                    if (v && size >= 12) {
+                        uint32_t placement = read32(v + 4);
+                        KernelParam param = { placement & 0xFFFF, placement >> 16, read32(v + 8) >> 18 };
+                        params.push_back({ k, param });
+                    }
+                    break;
+                case kEiattrParamCbank:
+                    if (v && size >= 8) {                 // { bank 0 symbol, offset:16 size:16 }
+                        uint32_t placement = read32(v + 4);
+                        kernel.paramBase = placement & 0xFFFF;
+                        kernel.paramBytes = placement >> 16;
+                    }
+                    break;
+                case kEiattrCbankParamSize:
+                    if (!v) kernel.paramBytes = size;
+                    break;
+                case kEiattrMaxThreads:
+                    if (v && size >= 12) kernel.maxThreads = read32(v) * read32(v + 4) * read32(v + 8);
+                    break;
+                case kEiattrReqntid:
+                    if (v && size >= 12) {
+                        for (int i = 0; i < 3; i++) kernel.requiredThreads[i] = read32(v + 4 * i);
+                    }
+                    break;
+                default:
+                    break;
+            }
+        });
+    }
+
+    // ".nv.constant" + "<bank>" + optional ".<kernel>"
+    bool readConstantBank(const ElfSection& s, std::string_view rest) {
+        size_t digits = 0;
+        uint32_t bank = 0;
+        while (digits < rest.size() && digits < 2 && rest[digits] >= '0' && rest[digits] <= '9') {
+            bank = bank * 10 + (uint32_t)(rest[digits++] - '0');
+        }
+        if (!digits) return true;
+        if (s.size > UINT32_MAX / 2) return fail("constant bank too large");
+        int32_t k = -1;
+        if (digits < rest.size()) {
+            if (rest[digits] != '.') return true;
+            k = kernelNamed(rest.substr(digits + 1));
+            if (k < 0) return true;                   // A device function's bank: not launched
+        }
+
+        ConstantBank cb = { bank, (uint32_t)s.size, ConstantBank::kNoData, 0 };
+        if (bank != 0 && s.type == kShtProgbits && s.size) {
+            if (!contents(s)) return fail("constant bank out of bounds");
+            uint32_t at = alignUp((uint32_t)m.image.size(), kConstantAlign);
+            if ((uint64_t)at + s.size > UINT32_MAX / 2) return fail("module too large");
+            m.image.resize(at + s.size);
+            memcpy(&m.image[at], data + s.offset, s.size);
+            cb.imageOffset = at;
+        }
+        if (k < 0) {
+            m.moduleBanks.push_back(cb);
+        } else {
+            banks.push_back({ (uint32_t)k, cb });
+        }
+        return true;
+    }
+
+    // Flatten the per-kernel lists and point the kernels at them
+    void finish() {
+        auto byKernel = [](const auto& a, const auto& b) { return a.first < b.first; };
+        std::stable_sort(params.begin(), params.end(), [](const auto& a, const auto& b) {
+            return a.first != b.first ? a.first < b.first : a.second.ordinal < b.second.ordinal;
+        });
+        std::stable_sort(banks.begin(), banks.end(), [](const auto& a, const auto& b) {
+            return a.first != b.first ? a.first < b.first : a.second.bank < b.second.bank;
+        });
+        std::sort(m.moduleBanks.begin(), m.moduleBanks.end(),
+                  [](const ConstantBank& a, const ConstantBank& b) { return a.bank < b.bank; });
+
+        m.paramStore.resize(params.size());
+        for (size_t i = 0; i < params.size(); i++) m.paramStore[i] = params[i].second;
+        m.bankStore.resize(banks.size());
+        for (size_t i = 0; i < banks.size(); i++) m.bankStore[i] = banks[i].second;
+
+        for (uint32_t k = 0; k < m.entries.size(); k++) {
+            Kernel& kernel = m.entries[k];
+            std::pair<uint32_t, KernelParam> pk = { k, KernelParam() };
+            auto p = std::equal_range(params.begin(), params.end(), pk, byKernel);
+            kernel.params = p.first == p.second ? nullptr : &m.paramStore[p.first - params.begin()];
+            kernel.paramCount = (uint32_t)(p.second - p.first);
+            std::pair<uint32_t, ConstantBank> bk = { k, ConstantBank() };
+            auto b = std::equal_range(banks.begin(), banks.end(), bk, byKernel);
+            kernel.banks = b.first == b.second ? nullptr : &m.bankStore[b.first - banks.begin()];
+            kernel.bankCount = (uint32_t)(b.second - b.first);
+
+            // Older toolchains give no PARAM_CBANK size: the block ends with the last parameter
+            for (uint32_t i = 0; i < kernel.paramCount; i++) {
+                uint32_t end = kernel.params[i].offset + kernel.params[i].size;
+                if (end > kernel.paramBytes) kernel.paramBytes = end;
+            }
+            if (frameBytes[k] > kernel.localBytes) kernel.localBytes = frameBytes[k];
+        }
+        m.imageSize = m.image.size();
+    }
+};
+
+// ============================================================================
+// Module
+// ============================================================================
+
+const ConstantBank *Kernel::bank(uint32_t n) const {
+    for (uint32_t i = 0; i < bankCount; i++) {
+        if (banks[i].bank == n) return &banks[i];
+    }
+    return nullptr;
+}
+
+void Module::reset() {
+    sm = 0;
+    digest = 0;
+    imageSize = 0;
+    image.clear();
+    names.clear();
+    entries.clear();
+    paramStore.clear();
+    bankStore.clear();
+    moduleBanks.clear();
+    byName.clear();
+    buffer.reset();
+}
+
+bool Module::parse(const void *data, size_t bytes, uint32_t targetSm) {
+    reset();
+    const uint8_t *p = (const uint8_t *)data;
+    if (!p || bytes < sizeof(uint32_t)) return false;
+
+    const uint8_t *cubin = p;
+    size_t cubinBytes = bytes;
+    if (read32(p) == kFatbinMagic) {
+        bool sawCompressed = false;
+        if (!pickCubin(p, bytes, targetSm, &cubin, &cubinBytes, &sawCompressed)) {
+            std::cerr << "[libNVDAAL] Module: fatbin has no " << (sawCompressed ? "uncompressed " : "")
+                      << "cubin for sm_" << targetSm << std::endl;
+            return false;
+        }
+    }
+
+    CubinParser parser(*this, cubin, cubinBytes);
+    if (!parser.run(targetSm)) {
+        reset();
+        return false;
+    }
+    digest = moduleHash(data, bytes);
+    return true;
+}
+
+bool Module::upload(BufferAllocator& allocator) {
+    if (!parsed()) return false;
+    if (uploaded()) return true;
+
+    Buffer code = allocator.allocate(imageSize);
+    void *cpu = code.valid() && code.gpuAddr() ? code.cpu() : nullptr;
+    if (!cpu) {
+        std::cerr << "[libNVDAAL] Module: could not upload " << imageSize << " bytes" << std::endl;
+        return false;
+    }
+    streamCopy(cpu, image.data(), imageSize);
+
+    uint64_t base = code.gpuAddr();
+    for (Kernel& kernel : entries) kernel.codeAddr = base + kernel.codeOffset;
+    for (ConstantBank& bank : bankStore) {
+        if (bank.imageOffset != ConstantBank::kNoData) bank.gpuAddr = base + bank.imageOffset;
+    }
+    for (ConstantBank& bank : moduleBanks) {
+        if (bank.imageOffset != ConstantBank::kNoData) bank.gpuAddr = base + bank.imageOffset;
+    }
+    buffer = std::move(code);
+    std::vector<uint8_t>().swap(image);
+    return true;
+}
+
+const Kernel *Module::kernel(const char *name) const {
+    auto it = byName.find(std::string_view(name));
+    return it == byName.end() ? nullptr : &entries[it->second];
+}
+
+// ============================================================================
+// Module Loader
+// ============================================================================
+
+ModuleLoader::ModuleLoader(BufferAllocator& a, uint32_t targetSm) : allocator(&a), sm(targetSm), counters() {}
+
+std::shared_ptr<const Module> ModuleLoader::load(const void *data, size_t bytes) {
+    if (!data || !bytes) {
+        std::lock_guard<std::mutex> guard(lock);
+        counters.failures++;
+        return nullptr;
+    }
+    std::pair<uint64_t, size_t> key(moduleHash(data, bytes), bytes);
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (std::shared_ptr<const Module> cached = find(key, data)) {
+            counters.loads++;
+            counters.cacheHits++;
+            return cached;
+        }
+    }
+
+    // Parsed and uploaded outside the lock; a racing load of the same image
+    // wastes its work and takes the cached one
+    auto module = std::make_shared<Module>();
+    bool ok = module->parse(data, bytes, sm) && module->upload(*allocator);
+    std::lock_guard<std::mutex> guard(lock);
+    if (!ok) {
+        counters.failures++;
+        return nullptr;
+    }
+    counters.loads++;
+    if (std::shared_ptr<const Module> cached = find(key, data)) {
+        counters.cacheHits++;
+        return cached;
+    }
+    const uint8_t *p = (const uint8_t *)data;
+    cache.emplace(key, Cached{ module, std::vector<uint8_t>(p, p + bytes) });
+    counters.modules++;
+    counters.kernels += module->kernels().size();
+    counters.uploadedBytes += module->imageBytes();
+    return module;
+}
+
+// The cached module whose image is `data`, byte for byte; call with `lock` held
+std::shared_ptr<const Module> ModuleLoader::find(const std::pair<uint64_t, size_t>& key, const void *data) const {
+    auto range = cache.equal_range(key);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (memcmp(it->second.image.data(), data, key.second) == 0) return it->second.module;
+    }
+    return nullptr;
+}
+
+std::shared_ptr<const Module> ModuleLoader::load(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size <= 0) {
+        std::cerr << "[libNVDAAL] Error: Could not open module " << path << std::endl;
+        if (fd >= 0) close(fd);
+        std::lock_guard<std::mutex> guard(lock);
+        counters.failures++;
+        return nullptr;
+    }
+    void *p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        std::lock_guard<std::mutex> guard(lock);
+        counters.failures++;
+        return nullptr;
+    }
+    std::shared_ptr<const Module> module = load(p, (size_t)st.st_size);
+    munmap(p, (size_t)st.st_size);
+    return module;
+}
+
+size_t ModuleLoader::evict() {
+    std::lock_guard<std::mutex> guard(lock);
+    size_t evicted = 0;
+    for (auto it = cache.begin(); it != cache.end();) {
+        if (it->second.module.use_count() == 1) {
+            counters.modules--;
+            counters.kernels -= it->second.module->kernels().size();
+            counters.uploadedBytes -= it->second.module->imageBytes();
+            it = cache.erase(it);
+            evicted++;
+        } else {
+            ++it;
+        }
+    }
+    return evicted;
+}
+
+ModuleLoaderStats ModuleLoader::stats() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return counters;
+}
+
+} // namespace nvdaal
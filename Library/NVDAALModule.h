@@ -0,0 +1,171 @@
+/*
+ * NVDAALModule.h - CUDA Modules (cubin / fatbin)
+ *
+ * Module reads what nvcc builds for the GPU: a cubin (an ELF64 image for
+ * EM_CUDA) or a fatbin holding cubins for several SMs, of which it takes
+ * the newest one the target runs (same major, minor no higher; PTX and
+ * compressed entries are skipped: there is no JIT or decompressor). From
+ * the cubin it takes, per kernel (entry symbol):
+ *
+ *   .text.<k>                code offset and size
+ *   .nv.info                 registers, frame and stack size
+ *   .nv.info.<k>             parameter layout and where the parameter
+ *                            block sits in constant bank 0, launch bounds
+ *   .nv.shared.<k>           static shared memory
+ *   .nv.constant<N>[.<k>]    constant banks, per kernel or module-wide
+ *
+ * upload() copies every code section, keeping the cubin's relative
+ * layout, and the constant banks that carry data into one VRAM Buffer.
+ * Bank 0 holds each launch's parameters and driver constants, so it is
+ * only sized, never uploaded. Cubins that need relocating (device
+ * globals, separate compilation) are rejected.
+ *
+ * ModuleLoader caches modules by image hash (XXH64 plus size): a model
+ * that loads the same kernels from several places parses and uploads
+ * them once. It keeps a copy of each cached image and compares the
+ * bytes on a hash hit, so a collision loads a module of its own rather
+ * than someone else's code. Modules must not outlive the allocator they
+ * uploaded with.
+ */
+
+#ifndef LIB_NVDAAL_MODULE_H
+#define LIB_NVDAAL_MODULE_H
+
+#include "NVDAALBuffer.h"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace nvdaal {
+
+static const uint32_t kSmArch = 89;              // AD10x: sm_89
+
+struct KernelParam {
+    uint32_t ordinal;                            // Position in the signature
+    uint32_t offset;                             // From the start of the parameter block
+    uint32_t size;
+};
+
+struct ConstantBank {
+    uint32_t bank;                               // c[bank][...]
+    uint32_t size;
+    uint32_t imageOffset;                        // In the uploaded image; kNoData if none
+    uint64_t gpuAddr;                            // 0 until upload(), and without data
+    static constexpr uint32_t kNoData = UINT32_MAX;
+};
+
+struct Kernel {
+    const char *name;
+    uint32_t codeOffset;                         // Entry, in the uploaded image
+    uint32_t codeBytes;
+    uint64_t codeAddr;                           // GPU VA of the entry; 0 until upload()
+    uint32_t registers;                          // Per thread
+    uint32_t sharedBytes;                        // Static shared memory per CTA
+    uint32_t localBytes;                         // Stack per thread
+    uint32_t maxThreads;                         // __launch_bounds__; 0 = none
+    uint32_t requiredThreads[3];                 // reqntid; 0 = none
+    uint32_t paramBase;                          // Parameter block's offset in bank 0
+    uint32_t paramBytes;
+    const KernelParam *params;                   // By ordinal
+    uint32_t paramCount;
+    const ConstantBank *banks;                   // The kernel's own, by bank number (bank 0 first)
+    uint32_t bankCount;
+
+    const ConstantBank *bank(uint32_t n) const;  // nullptr if the kernel has none
+};
+
+uint64_t moduleHash(const void *data, size_t bytes);    // XXH64, seed 0
+
+class Module {
+public:
+    Module() : sm(0), digest(0), imageSize(0) {}
+    ~Module() = default;
+
+    Module(const Module&) = delete;
+    Module& operator=(const Module&) = delete;
+
+    // Parse a cubin or fatbin for the target SM; copies what it needs, so
+    // `data` can go once this returns. False (and logged) if it is neither,
+    // has no cubin the target runs, or needs relocating.
+    bool parse(const void *data, size_t bytes, uint32_t targetSm = kSmArch);
+
+    // Code and constant data into VRAM, once; sets the GPU addresses
+    bool upload(BufferAllocator& allocator);
+
+    bool parsed() const { return sm != 0; }
+    bool uploaded() const { return buffer.valid(); }
+    uint32_t arch() const { return sm; }                 // Of the cubin used, e.g. 86
+    uint64_t hash() const { return digest; }             // Of the image parse() was given
+    size_t imageBytes() const { return imageSize; }
+    uint64_t gpuAddr() const { return buffer.valid() ? buffer.gpuAddr() : 0; }
+
+    const Kernel *kernel(const char *name) const;        // nullptr if there is none
+    const std::vector<Kernel>& kernels() const { return entries; }
+    const std::vector<ConstantBank>& constantBanks() const { return moduleBanks; }  // Module-wide
+
+private:
+    friend struct CubinParser;
+
+    uint32_t sm;
+    uint64_t digest;
+    size_t imageSize;
+    std::vector<uint8_t> image;                  // Until upload()
+    std::vector<char> names;                     // Kernel names, NUL-terminated
+    std::vector<Kernel> entries;
+    std::vector<KernelParam> paramStore;
+    std::vector<ConstantBank> bankStore;         // Every kernel's banks
+    std::vector<ConstantBank> moduleBanks;
+    std::unordered_map<std::string_view, uint32_t> byName;     // Views into `names`
+    Buffer buffer;
+
+    void reset();
+};
+
+struct ModuleLoaderStats {
+    uint64_t loads;                              // load() calls that returned a module
+    uint64_t cacheHits;
+    uint64_t failures;
+    uint64_t modules;                            // Cached now
+    uint64_t kernels;                            // In the cached modules
+    uint64_t uploadedBytes;                      // Images of the cached modules, in VRAM
+};
+
+class ModuleLoader {
+public:
+    explicit ModuleLoader(BufferAllocator& allocator, uint32_t targetSm = kSmArch);
+    ~ModuleLoader() = default;
+
+    ModuleLoader(const ModuleLoader&) = delete;
+    ModuleLoader& operator=(const ModuleLoader&) = delete;
+
+    // Parsed and uploaded, or the cached module with the same image;
+    // nullptr on failure. Thread-safe.
+    std::shared_ptr<const Module> load(const void *data, size_t bytes);
+    std::shared_ptr<const Module> load(const std::string& path);   // Maps the file
+
+    size_t evict();                              // Drop modules only the cache holds; returns how many
+    ModuleLoaderStats stats() const;
+
+private:
+    BufferAllocator *allocator;
+    uint32_t sm;
+    mutable std::mutex lock;
+    struct Cached {
+        std::shared_ptr<const Module> module;
+        std::vector<uint8_t> image;              // As load() was given it, to rule out hash collisions
+    };
+    std::multimap<std::pair<uint64_t, size_t>, Cached> cache;   // (hash, bytes)
+
+    std::shared_ptr<const Module> find(const std::pair<uint64_t, size_t>& key, const void *data) const;
+    ModuleLoaderStats counters;
+};
+
+} // namespace nvdaal
+
+#endif // LIB_NVDAAL_MODULE_H
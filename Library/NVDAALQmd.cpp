@@ -0,0 +1,237 @@
+/*
+ * NVDAALQmd.cpp - Compute Launch Descriptors (QMD)
+ */
+
+#include "NVDAALQmd.h"
+#include <algorithm>
+#include <functional>
+#include <iostream>
+
+namespace nvdaal {
+
+namespace {
+
+// Ada (sm_89) limits a launch must fit
+const uint32_t kMaxThreadsPerCta = 1024;
+const uint32_t kMaxCtaDimZ = 64;
+const uint32_t kMaxRegistersPerThread = 255;
+const uint32_t kRegistersPerSm = 65536;
+const uint32_t kRegisterAllocUnit = 256;         // Per warp
+const uint32_t kMaxSharedPerCta = 99 << 10;
+const uint32_t kMaxSharedCarveout = 100 << 10;
+const uint32_t kMaxBankBytes = 64 << 10;
+const uint32_t kBankAlign = 256;
+
+// Shared memory carveouts an SM can be configured with, in the encoding
+// the SM_CONFIG fields take (4 KiB units, plus one)
+uint32_t smConfig(uint32_t sharedBytes) {
+    static const uint32_t carveouts[] = { 8 << 10, 16 << 10, 32 << 10, 64 << 10, kMaxSharedCarveout };
+    for (uint32_t size : carveouts) {
+        if (sharedBytes <= size) return size / 4096 + 1;
+    }
+    return kMaxSharedCarveout / 4096 + 1;
+}
+
+uint32_t alignUp(uint32_t value, uint32_t align) {
+    return (value + align - 1) & ~(align - 1);
+}
+
+// Bank fields with the bank number known only at run time
+void setBank(uint32_t *qmd, const qmd::FieldInfo& field, uint32_t bank, uint32_t value) {
+    uint32_t lo = field.lo + bank * field.stride;
+    uint32_t width = field.hi - field.lo + 1;
+    uint32_t mask = (width == 32 ? 0xFFFFFFFFu : (1u << width) - 1) << (lo % 32);
+    qmd[lo / 32] = (qmd[lo / 32] & ~mask) | ((value << (lo % 32)) & mask);
+}
+
+const qmd::FieldInfo& bankField(const char *name) {
+    for (const qmd::FieldInfo& f : qmd::kFields) {
+        if (f.stride && strcmp(f.name, name) == 0) return f;
+    }
+    return qmd::kFields[0];                          // Unreachable: the names are the table's
+}
+
+} // namespace
+
+uint32_t qmd::read(const uint32_t *qmd, const FieldInfo& field, uint32_t bank) {
+    uint32_t lo = field.lo + bank * field.stride;
+    uint32_t width = field.hi - field.lo + 1;
+    uint32_t value = qmd[lo / 32] >> (lo % 32);
+    return width == 32 ? value : value & ((1u << width) - 1);
+}
+
+// ============================================================================
+// QmdTemplate
+// ============================================================================
+
+bool QmdTemplate::init(const Module& module, const Kernel& kernel, uint32_t blockX, uint32_t blockY,
+                       uint32_t blockZ, uint32_t dynamicShared) {
+    source = nullptr;
+    firstLaunch.store(false, std::memory_order_relaxed);
+    if (!module.uploaded() || !kernel.codeAddr) {
+        std::cerr << "[libNVDAAL] Qmd: " << kernel.name << " is not uploaded" << std::endl;
+        return false;
+    }
+
+    uint64_t threads = (uint64_t)blockX * blockY * blockZ;
+    uint32_t limit = kernel.maxThreads ? std::min(kernel.maxThreads, kMaxThreadsPerCta) : kMaxThreadsPerCta;
+    const uint32_t *req = kernel.requiredThreads;
+    if (threads == 0 || threads > limit || blockZ > kMaxCtaDimZ ||
+        (req[0] && (blockX != req[0] || blockY != (req[1] ? req[1] : 1) || blockZ != (req[2] ? req[2] : 1)))) {
+        std::cerr << "[libNVDAAL] Qmd: " << kernel.name << " can't run " << blockX << "x" << blockY << "x"
+                  << blockZ << " threads per CTA" << std::endl;
+        return false;
+    }
+
+    uint32_t warps = (uint32_t)(threads + 31) / 32;
+    if (kernel.registers > kMaxRegistersPerThread ||
+        warps * alignUp(kernel.registers * 32, kRegisterAllocUnit) > kRegistersPerSm) {
+        std::cerr << "[libNVDAAL] Qmd: " << kernel.name << " needs " << kernel.registers
+                  << " registers per thread, too many for " << threads << " threads" << std::endl;
+        return false;
+    }
+
+    uint64_t shared = (uint64_t)kernel.sharedBytes + dynamicShared;
+    if (shared > kMaxSharedPerCta) {
+        std::cerr << "[libNVDAAL] Qmd: " << kernel.name << " needs " << shared << " bytes of shared memory"
+                  << std::endl;
+        return false;
+    }
+
+    bank0Size = alignUp(kernel.paramBase + kernel.paramBytes, 16);
+    if (bank0Size > kMaxBankBytes) {
+        std::cerr << "[libNVDAAL] Qmd: " << kernel.name << " has a " << bank0Size << "-byte constant bank 0"
+                  << std::endl;
+        return false;
+    }
+
+    uint32_t *q = prefilled;
+    memset(q, 0, sizeof(prefilled));
+    qmd::QmdVersion::set(q, qmd::kVersion);
+    qmd::QmdMajorVersion::set(q, qmd::kMajorVersion);
+    qmd::ApiVisibleCallLimit::set(q, qmd::kCallLimitNoCheck);
+    qmd::SamplerIndex::set(q, qmd::kSamplerIndependently);
+    qmd::CwdMembarType::set(q, qmd::kMembarL1Sysmembar);
+    qmd::SmGlobalCachingEnable::set(q, 1);
+
+    // Bank 0 is rewritten for every launch, so the constant cache must not
+    // serve the last one's parameters
+    qmd::InvalidateTextureHeaderCache::set(q, 1);
+    qmd::InvalidateTextureSamplerCache::set(q, 1);
+    qmd::InvalidateTextureDataCache::set(q, 1);
+    qmd::InvalidateShaderDataCache::set(q, 1);
+    qmd::InvalidateShaderConstantCache::set(q, 1);
+
+    qmd::ProgramAddressLower::set(q, (uint32_t)kernel.codeAddr);
+    qmd::ProgramAddressUpper::set(q, (uint32_t)(kernel.codeAddr >> 32));
+    qmd::CtaThreadDimension0::set(q, blockX);
+    qmd::CtaThreadDimension1::set(q, blockY);
+    qmd::CtaThreadDimension2::set(q, blockZ);
+    qmd::RegisterCount::set(q, kernel.registers);
+    // The cubin doesn't record barrier use; one is what __syncthreads() needs
+    qmd::BarrierCount::set(q, 1);
+
+    uint32_t sharedAligned = alignUp((uint32_t)shared, 256);
+    qmd::SharedMemorySize::set(q, sharedAligned);
+    qmd::MinSmConfigSharedMemSize::set(q, smConfig(0));
+    qmd::MaxSmConfigSharedMemSize::set(q, smConfig(kMaxSharedCarveout));
+    qmd::TargetSmConfigSharedMemSize::set(q, smConfig(sharedAligned));
+    qmd::ShaderLocalMemoryLowSize::set(q, alignUp(kernel.localBytes, 16));
+    qmd::ShaderLocalMemoryHighSize::set(q, 0);
+
+    qmd::ConstantBufferValid<0>::set(q, 1);
+    qmd::ConstantBufferSizeShifted4<0>::set(q, bank0Size >> 4);
+
+    source = &kernel;
+    for (const ConstantBank& bank : module.constantBanks()) {
+        if (bank.bank != 0 && bank.gpuAddr && !kernel.bank(bank.bank) &&
+            !bindBank(bank.bank, bank.gpuAddr, bank.size)) {
+            source = nullptr;
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < kernel.bankCount; i++) {
+        const ConstantBank& bank = kernel.banks[i];
+        if (bank.bank != 0 && bank.gpuAddr && !bindBank(bank.bank, bank.gpuAddr, bank.size)) {
+            source = nullptr;
+            return false;
+        }
+    }
+    firstLaunch.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+bool QmdTemplate::bindBank(uint32_t bank, uint64_t gpuAddr, uint32_t bytes) {
+    if (!source || bank == 0 || bank >= qmd::kConstantBanks || (gpuAddr & (kBankAlign - 1)) ||
+        bytes > kMaxBankBytes) {
+        std::cerr << "[libNVDAAL] Qmd: can't bind " << bytes << " bytes at 0x" << std::hex << gpuAddr << std::dec
+                  << " as constant bank " << bank << std::endl;
+        return false;
+    }
+    static const qmd::FieldInfo& valid = bankField("ConstantBufferValid");
+    static const qmd::FieldInfo& lower = bankField("ConstantBufferAddrLower");
+    static const qmd::FieldInfo& upper = bankField("ConstantBufferAddrUpper");
+    static const qmd::FieldInfo& size = bankField("ConstantBufferSizeShifted4");
+    setBank(prefilled, valid, bank, gpuAddr != 0);
+    setBank(prefilled, lower, bank, (uint32_t)gpuAddr);
+    setBank(prefilled, upper, bank, (uint32_t)(gpuAddr >> 32));
+    setBank(prefilled, size, bank, alignUp(bytes, 16) >> 4);
+    return true;
+}
+
+bool QmdTemplate::rejectLaunch(uint32_t gridX, uint32_t gridY, uint32_t gridZ, uint64_t paramBank) const {
+    if (!source) {
+        std::cerr << "[libNVDAAL] Qmd: encode() before a successful init()" << std::endl;
+    } else if (paramBank & (kBankAlign - 1)) {
+        std::cerr << "[libNVDAAL] Qmd: parameter bank 0x" << std::hex << paramBank << std::dec
+                  << " is not 256-byte aligned" << std::endl;
+    } else {
+        std::cerr << "[libNVDAAL] Qmd: grid " << gridX << "x" << gridY << "x" << gridZ << " for "
+                  << source->name << " is out of range" << std::endl;
+    }
+    return false;
+}
+
+// ============================================================================
+// QmdCache
+// ============================================================================
+
+size_t QmdCache::KeyHash::operator()(const Key& k) const {
+    size_t h = std::hash<const void *>()(k.kernel) ^ (size_t)(k.module ^ k.codeAddr);
+    for (uint32_t v : { k.block[0], k.block[1], k.block[2], k.dynamicShared }) {
+        h ^= v + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+    }
+    return h;
+}
+
+const QmdTemplate *QmdCache::get(const Module& module, const Kernel& kernel, uint32_t blockX, uint32_t blockY,
+                                 uint32_t blockZ, uint32_t dynamicShared) {
+    Key key = { &kernel, module.hash(), kernel.codeAddr, { blockX, blockY, blockZ }, dynamicShared };
+    std::lock_guard<std::mutex> guard(lock);
+    counters.lookups++;
+    auto it = templates.find(key);
+    if (it != templates.end()) {
+        counters.hits++;
+        return it->second.get();
+    }
+    auto qmd = std::make_unique<QmdTemplate>();
+    if (!qmd->init(module, kernel, blockX, blockY, blockZ, dynamicShared)) {
+        counters.failures++;
+        return nullptr;
+    }
+    counters.templates++;
+    return templates.emplace(key, std::move(qmd)).first->second.get();
+}
+
+void QmdCache::clear() {
+    std::lock_guard<std::mutex> guard(lock);
+    templates.clear();
+    counters.templates = 0;
+}
+
+QmdCacheStats QmdCache::stats() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return counters;
+}
+
+} // namespace nvdaal
@@ -0,0 +1,241 @@
+/*
+ * NVDAALQmd.h - Compute Launch Descriptors (QMD)
+ *
+ * A compute launch is a QMD (256 bytes in VRAM, NV_QMD_ALIGN aligned) that
+ * CommandBuffer::dispatch() hands to SEND_PCAS_A / SEND_SIGNALING_PCAS_B.
+ * It names the code to run, the grid and CTA shape, registers, shared and
+ * local memory, and where constant banks 0-7 live.
+ *
+ * The layout ADA_COMPUTE_A reads (QMD V03_00, as NVIDIA's clc6c0qmd.h
+ * gives it) is written down once, in NVDAAL_QMDV03_FIELDS: hi:lo bit
+ * positions in the 2048-bit descriptor. Each field becomes a QmdField type
+ * whose dword, shift and mask are constants, so setting one compiles to a
+ * mask and an or. No field crosses a dword; the static_assert says so.
+ *
+ * QmdTemplate fills what a kernel and CTA shape fix once. encode() copies
+ * it and patches only the grid and the parameter bank (constant bank 0's
+ * address), five dwords, writing the destination front to back without
+ * reading it, so it can be write-combined BAR1. The first QMD a template
+ * encodes also invalidates the instruction cache, in case the module's
+ * code went where an unloaded one's was. QmdCache keeps templates per
+ * kernel, module upload and shape for callers that launch the same
+ * kernels again.
+ */
+
+#ifndef LIB_NVDAAL_QMD_H
+#define LIB_NVDAAL_QMD_H
+
+#include "NVDAALModule.h"
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace nvdaal {
+
+static const uint32_t kQmdBytes = 256;
+static const uint32_t kQmdDwords = kQmdBytes / 4;
+
+// Bits hi:lo of a QMD, as one dword's shift and mask
+template <uint32_t Hi, uint32_t Lo>
+struct QmdField {
+    static_assert(Hi >= Lo && Hi / 32 == Lo / 32 && Hi < kQmdBytes * 8, "QMD fields lie within one dword");
+
+    static constexpr uint32_t word = Lo / 32;
+    static constexpr uint32_t shift = Lo % 32;
+    static constexpr uint32_t max = Hi - Lo == 31 ? 0xFFFFFFFFu : (1u << (Hi - Lo + 1)) - 1;
+    static constexpr uint32_t mask = max << shift;
+
+    static void set(uint32_t *qmd, uint32_t value) {
+        qmd[word] = (qmd[word] & ~mask) | ((value << shift) & mask);
+    }
+    static uint32_t get(const uint32_t *qmd) { return (qmd[word] & mask) >> shift; }
+};
+
+namespace qmd {
+
+// X(name, hi, lo)
+#define NVDAAL_QMDV03_FIELDS(X)                                   \
+    X(QmdGroupId,                    133,  128)                   \
+    X(SmGlobalCachingEnable,         134,  134)                   \
+    X(InvalidateTextureHeaderCache,  186,  186)                   \
+    X(InvalidateTextureSamplerCache, 187,  187)                   \
+    X(InvalidateTextureDataCache,    188,  188)                   \
+    X(InvalidateShaderDataCache,     189,  189)                   \
+    X(InvalidateInstructionCache,    190,  190)                   \
+    X(InvalidateShaderConstantCache, 191,  191)                   \
+    X(CwdMembarType,                 369,  368)                   \
+    X(ApiVisibleCallLimit,           378,  378)                   \
+    X(SamplerIndex,                  382,  382)                   \
+    X(CtaRasterWidth,                415,  384)                   \
+    X(CtaRasterHeight,               431,  416)                   \
+    X(CtaRasterDepth,                463,  448)                   \
+    X(SharedMemorySize,              561,  544)                   \
+    X(MinSmConfigSharedMemSize,      567,  562)                   \
+    X(MaxSmConfigSharedMemSize,      573,  568)                   \
+    X(QmdVersion,                    579,  576)                   \
+    X(QmdMajorVersion,               583,  580)                   \
+    X(CtaThreadDimension0,           607,  592)                   \
+    X(CtaThreadDimension1,           623,  608)                   \
+    X(CtaThreadDimension2,           639,  624)                   \
+    X(RegisterCount,                 656,  648)                   \
+    X(TargetSmConfigSharedMemSize,   662,  657)                   \
+    X(ShaderLocalMemoryLowSize,      1559, 1536)                  \
+    X(BarrierCount,                  1567, 1563)                  \
+    X(ShaderLocalMemoryHighSize,     1591, 1568)                  \
+    X(ProgramAddressLower,           1663, 1632)                  \
+    X(ProgramAddressUpper,           1680, 1664)
+
+// X(name, hi, lo, stride): constant bank i's field is hi:lo plus i * stride
+#define NVDAAL_QMDV03_BANK_FIELDS(X)                              \
+    X(ConstantBufferValid,           640,  640,  1)               \
+    X(ConstantBufferAddrLower,       1055, 1024, 64)              \
+    X(ConstantBufferAddrUpper,       1072, 1056, 64)              \
+    X(ConstantBufferSizeShifted4,    1087, 1075, 64)
+
+#define NVDAAL_QMD_FIELD(name, hi, lo) using name = QmdField<hi, lo>;
+#define NVDAAL_QMD_BANK_FIELD(name, hi, lo, stride) \
+    template <uint32_t Bank> using name = QmdField<(hi) + Bank * (stride), (lo) + Bank * (stride)>;
+NVDAAL_QMDV03_FIELDS(NVDAAL_QMD_FIELD)
+NVDAAL_QMDV03_BANK_FIELDS(NVDAAL_QMD_BANK_FIELD)
+#undef NVDAAL_QMD_FIELD
+#undef NVDAAL_QMD_BANK_FIELD
+
+static const uint32_t kConstantBanks = 8;
+static const uint32_t kVersion = 0;                  // QMD V03_00
+static const uint32_t kMajorVersion = 3;
+static const uint32_t kMembarL1Sysmembar = 1;        // CWD_MEMBAR_TYPE
+static const uint32_t kCallLimitNoCheck = 1;         // API_VISIBLE_CALL_LIMIT
+static const uint32_t kSamplerIndependently = 0;     // SAMPLER_INDEX
+
+// The same table as data, for dumping and checking descriptors
+struct FieldInfo {
+    const char *name;
+    uint16_t hi;
+    uint16_t lo;
+    uint16_t stride;                                 // Per constant bank; 0 = not per bank
+};
+
+#define NVDAAL_QMD_FIELD_INFO(name, hi, lo) { #name, hi, lo, 0 },
+#define NVDAAL_QMD_BANK_FIELD_INFO(name, hi, lo, stride) { #name, hi, lo, stride },
+inline constexpr FieldInfo kFields[] = {
+    NVDAAL_QMDV03_FIELDS(NVDAAL_QMD_FIELD_INFO)
+    NVDAAL_QMDV03_BANK_FIELDS(NVDAAL_QMD_BANK_FIELD_INFO)
+};
+#undef NVDAAL_QMD_FIELD_INFO
+#undef NVDAAL_QMD_BANK_FIELD_INFO
+
+// Runtime counterpart of QmdField<>::get(), for fields picked from kFields
+uint32_t read(const uint32_t *qmd, const FieldInfo& field, uint32_t bank = 0);
+
+} // namespace qmd
+
+class QmdTemplate {
+public:
+    QmdTemplate() : source(nullptr), bank0Size(0), firstLaunch(false) { memset(prefilled, 0, sizeof(prefilled)); }
+    QmdTemplate(const QmdTemplate&) = delete;
+    QmdTemplate& operator=(const QmdTemplate&) = delete;
+
+    // Program, CTA shape, registers, shared (static plus `dynamicShared`)
+    // and local memory, and the module's uploaded constant banks other than
+    // 0 (the kernel's own over module-wide ones). False (and logged) if the
+    // module isn't uploaded or the shape doesn't fit the kernel or an SM.
+    bool init(const Module& module, const Kernel& kernel, uint32_t blockX, uint32_t blockY = 1,
+              uint32_t blockZ = 1, uint32_t dynamicShared = 0);
+
+    // Point bank 1-7 elsewhere; 256-byte aligned, up to 64 KiB
+    bool bindBank(uint32_t bank, uint64_t gpuAddr, uint32_t bytes);
+
+    // The QMD for a grid, with bank 0 at `paramBank` (256-byte aligned; the
+    // parameters go at kernel()->paramBase in it), into `dst` (kQmdBytes).
+    // The first one after init() also invalidates the instruction cache.
+    bool encode(void *dst, uint32_t gridX, uint32_t gridY, uint32_t gridZ, uint64_t paramBank) const;
+
+    bool valid() const { return source != nullptr; }
+    const Kernel *kernel() const { return source; }
+    const uint32_t *words() const { return prefilled; }   // Grid and bank 0 address left 0; no icache invalidate
+    uint32_t paramBankBytes() const { return bank0Size; }
+
+private:
+    alignas(64) uint32_t prefilled[kQmdDwords];
+    const Kernel *source;
+    uint32_t bank0Size;                          // Driver constants plus the parameter block
+    mutable std::atomic<bool> firstLaunch;       // Until encode() has invalidated the instruction cache
+
+    bool rejectLaunch(uint32_t gridX, uint32_t gridY, uint32_t gridZ, uint64_t paramBank) const;
+};
+
+inline bool QmdTemplate::encode(void *dst, uint32_t gridX, uint32_t gridY, uint32_t gridZ,
+                                uint64_t paramBank) const {
+    if (!source || gridX == 0 || gridY - 1 >= qmd::CtaRasterHeight::max || gridZ - 1 >= qmd::CtaRasterDepth::max ||
+        (paramBank & 0xFF)) {
+        return rejectLaunch(gridX, gridY, gridZ, paramBank);
+    }
+    uint32_t qmd[kQmdDwords];
+    memcpy(qmd, prefilled, sizeof(qmd));
+    qmd::CtaRasterWidth::set(qmd, gridX);
+    qmd::CtaRasterHeight::set(qmd, gridY);
+    qmd::CtaRasterDepth::set(qmd, gridZ);
+    qmd::ConstantBufferAddrLower<0>::set(qmd, (uint32_t)paramBank);
+    qmd::ConstantBufferAddrUpper<0>::set(qmd, (uint32_t)(paramBank >> 32));
+    if (firstLaunch.load(std::memory_order_relaxed) && firstLaunch.exchange(false, std::memory_order_relaxed)) {
+        qmd::InvalidateInstructionCache::set(qmd, 1);
+    }
+    memcpy(dst, qmd, sizeof(qmd));
+    return true;
+}
+
+struct QmdCacheStats {
+    uint64_t lookups;
+    uint64_t hits;
+    uint64_t failures;
+    uint64_t templates;                          // Cached now
+};
+
+class QmdCache {
+public:
+    QmdCache() : counters() {}
+    ~QmdCache() = default;
+
+    QmdCache(const QmdCache&) = delete;
+    QmdCache& operator=(const QmdCache&) = delete;
+
+    // The template for a kernel and CTA shape, built on first use; nullptr
+    // if init() fails. Keyed on the module's hash and the kernel's code
+    // address as well as its Kernel, so a module loaded where a freed one
+    // was gets templates of its own. Templates stay put until clear().
+    // Thread-safe.
+    const QmdTemplate *get(const Module& module, const Kernel& kernel, uint32_t blockX, uint32_t blockY = 1,
+                           uint32_t blockZ = 1, uint32_t dynamicShared = 0);
+
+    void clear();                                // Drop every template (modules being unloaded)
+    QmdCacheStats stats() const;
+
+private:
+    struct Key {
+        const Kernel *kernel;
+        uint64_t module;                         // Module::hash()
+        uint64_t codeAddr;
+        uint32_t block[3];
+        uint32_t dynamicShared;
+
+        bool operator==(const Key& o) const {
+            return kernel == o.kernel && module == o.module && codeAddr == o.codeAddr && block[0] == o.block[0] &&
+                   block[1] == o.block[1] && block[2] == o.block[2] && dynamicShared == o.dynamicShared;
+        }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& k) const;
+    };
+
+    mutable std::mutex lock;
+    std::unordered_map<Key, std::unique_ptr<QmdTemplate>, KeyHash> templates;
+    QmdCacheStats counters;
+};
+
+} // namespace nvdaal
+
+#endif // LIB_NVDAAL_QMD_H
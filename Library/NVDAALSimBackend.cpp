@@ -0,0 +1,1258 @@
+/*
+ * NVDAALSimBackend.cpp - In-Process Simulator Backend
+ *
+ * Models NVDAALUserClient closely enough for libNVDAAL and its callers to
+ * run unchanged: the same selectors, argument checks and IOReturn codes,
+ * the command ring and batch paths, coalesced doorbells (NVDAALCoalesce.h),
+ * timeline semaphores with blocking waits, async notifications and call
+ * statistics. VRAM is an anonymous host mapping; each fake channel
+ * completes its published submissions in order, SimConfig::submitLatencyUs
+ * apart (plus copy time at SimConfig::copyMBps), independently of the
+ * other channels. Copy-engine channels follow the compute ones and accept
+ * only host and copy methods. Pinned sysmem is anonymous host pages at
+ * fake GPU VAs, kept until close() as the kext keeps it until it unloads.
+ *
+ * Pushbuffers are interpreted when they complete: host semaphore acquires
+ * and releases, copy-engine launches (pitched copies and constant fills in
+ * fake memory, with their semaphore releases) and compute launches
+ * (counted, not run). An unsatisfied acquire stalls its channel,
+ * and only that one, until the semaphore is signalled; a bad GPU VA or
+ * method raises a channel error notification and drops the rest of that
+ * pushbuffer.
+ */
+
+#include "NVDAALBackend.h"
+#include "NVDAALUserShared.h"
+#include "NVDAALCoalesce.h"
+#include "NVDAALPushbuffer.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <sys/mman.h>
+
+// Matches UserClient selectors
+#define METHOD_LOAD_FIRMWARE 0
+#define METHOD_ALLOC_VRAM 1
+#define METHOD_SUBMIT_CMD 2
+#define METHOD_WAIT_SYNC 3
+#define METHOD_LOAD_BOOTER 4
+#define METHOD_LOAD_VBIOS 5
+#define METHOD_LOAD_BOOTLOADER 6
+#define METHOD_GET_STATUS 7
+#define METHOD_EXECUTE_FWSEC 8
+#define METHOD_CREATE_SEMAPHORE 9
+#define METHOD_DESTROY_SEMAPHORE 10
+#define METHOD_SIGNAL_SEMAPHORE 11
+#define METHOD_READ_SEMAPHORE 12
+#define METHOD_WAIT_SEMAPHORES 13
+#define METHOD_SET_SUBMIT_POLICY 14
+#define METHOD_FLUSH_SUBMISSIONS 15
+#define METHOD_RING_KICK 16
+#define METHOD_REGISTER_NOTIFICATION 17
+#define METHOD_CANCEL_NOTIFICATION 18
+#define METHOD_EXECUTE_BATCH 19
+#define METHOD_GET_STATS 20
+#define METHOD_SUBMIT_PUSHBUFFER 21
+#define METHOD_COUNT 22
+
+// Fake address layout
+#define SIM_VRAM_FIRST_OFFSET       0x1000              // Offset 0 means failure
+#define SIM_VRAM_GPU_VA_BASE        0x200000000ULL
+#define SIM_SEMAPHORE_GPU_VA_BASE   0x100000000ULL
+#define SIM_SYSMEM_GPU_VA_BASE      0x800000000ULL      // Above the largest fake VRAM
+#define SIM_SEMAPHORE_STRIDE        16
+#define SIM_MAX_SEMAPHORES          4096
+#define SIM_STALL_POLL_US           1000                // Re-check acquires on VRAM payloads
+
+namespace nvdaal {
+
+typedef std::chrono::steady_clock SimClock;
+
+static uint64_t simNowNs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        SimClock::now().time_since_epoch()).count();
+}
+
+// Driver-wide counters, shared by every simulator in the process
+static std::mutex gGlobalStatsLock;
+static NvdaalStats gGlobalStats = { NVDAAL_STATS_VERSION, METHOD_COUNT, 0, {} };
+
+static void recordCall(NvdaalStats *stats, uint32_t selector, uint64_t ns, Status ret) {
+    if (selector >= METHOD_COUNT) return;
+    NvdaalSelectorStats *s = &stats->selectors[selector];
+    s->calls++;
+    if (ret != kStatusSuccess) s->errors++;
+    s->totalNs += ns;
+    s->histogram[nvStatsBucket(ns)]++;
+    if (ns > s->maxNs) s->maxNs = ns;
+}
+
+struct SimBackend::State {
+    SimConfig config;
+    bool opened = false;
+
+    // Guards everything below; `cond` wakes semaphore waiters and the worker
+    std::mutex lock;
+    std::condition_variable cond;
+    std::thread worker;
+    bool stopping = false;
+
+    // VRAM: reserved up front, pages committed by the host on first touch
+    uint8_t *vram = nullptr;
+    uint64_t vramNext = SIM_VRAM_FIRST_OFFSET;
+    std::map<uint64_t, uint64_t> allocations;           // offset -> size
+    std::map<uint64_t, uint64_t> gpuMappings;           // MapVram: gpuVa -> size
+    uint32_t vaMappings = 0;                            // Ever made, toward NVDAAL_MAX_VRAM_*
+    uint64_t vaMappedBytes = 0;
+
+    // Pinned sysmem: anonymous host pages at a bump-allocated GPU VA
+    struct Sysmem {
+        uint8_t *host;
+        uint64_t size;
+        uint64_t gpuVa;
+    };
+    std::map<uint32_t, Sysmem> sysmem;                  // handle -> allocation
+    std::map<uint64_t, uint32_t> sysmemByVa;            // gpuVa -> handle
+    uint32_t nextSysmem = 0;
+    uint64_t sysmemVaNext = SIM_SYSMEM_GPU_VA_BASE;
+
+    // Timeline semaphores
+    std::map<uint32_t, uint64_t> semaphores;            // handle -> payload
+    uint32_t nextSemaphore = 0;
+
+    // Fake channels: coalesced doorbells, completions in publish order
+    struct Submission {
+        uint32_t signalHandle;                          // Released on completion (0 = none)
+        uint64_t signalValue;
+        uint64_t doneNs;
+        uint64_t pbGpuVa;                               // Pushbuffer to run (0 = none)
+        uint32_t pbBytes;
+        uint32_t pbPos;                                 // Resume point after a stall, in bytes
+        bool hostOnly;                                  // Semaphore methods only: takes no engine time
+        bool blocked;                                   // Has stalled on an acquire
+        uint64_t copyBytes;                             // Copy-engine launches, timed by copyMBps
+    };
+    struct Channel {
+        NvCoalesceState coalesce = {};
+        std::deque<Submission> held;                    // Written, doorbell not rung yet
+        std::deque<Submission> inFlight;
+        uint64_t freeNs = 0;                            // When the channel goes idle
+        bool stalled = false;                           // inFlight.front() blocked on an acquire
+
+        // Method state the pushbuffer interpreter carries between launches
+        uint32_t hostMethods[NVC56F_WFI / 4 + 1] = {};
+        uint32_t copyMethods[NVC7B5_SET_REMAP_COMPONENTS / 4 + 1] = {};
+        uint32_t computePcasA = 0;
+        bool copyOnly = false;                          // A copy-engine channel
+    };
+    NvCoalescePolicy policy;                            // Shared, as the driver applies one to all
+    std::vector<Channel> channels;                      // Sized by open(): compute, then copy
+    uint32_t computeChannels = 0;
+    bool retiring = false;
+
+    // Command ring
+    NvdaalRingControl *ring = nullptr;
+    uint32_t reqTail = 0;
+    uint32_t cplHead = 0;
+
+    // Async notifications
+    struct Registration {
+        uint32_t kind;
+        uint64_t arg0, arg1, tag;
+        AsyncCallback callback;
+        void *refcon;
+    };
+    struct Delivery {
+        AsyncCallback callback;
+        void *refcon;
+        Status status;
+        uint64_t args[NVDAAL_NOTIFY_ARG_COUNT];
+    };
+    std::map<uint32_t, Registration> registrations;
+    uint32_t nextRegistration = 0;
+    std::deque<Delivery> outbox;
+
+    NvdaalStats stats = { NVDAAL_STATS_VERSION, METHOD_COUNT, 0, {} };
+    SimCounters counters = {};
+
+    bool wpr2Enabled = false;
+    bool gspLoaded = false;
+
+    // --- Helpers (lock held) ---
+
+    bool findVram(uint64_t offset, uint64_t size, uint64_t *allocSize) {
+        auto it = allocations.upper_bound(offset);
+        if (it == allocations.begin()) return false;
+        --it;
+        bool found = size == 0 ? it->first == offset
+                               : offset - it->first <= it->second && size <= it->second - (offset - it->first);
+        if (found && allocSize) *allocSize = it->second;
+        return found;
+    }
+
+    uint64_t allocVram(uint64_t size) {
+        if (size == 0) return 0;
+        uint64_t aligned = (size + 0xFFF) & ~0xFFFULL;
+        if (aligned < size || aligned > config.vramBytes - vramNext) return 0;
+        uint64_t offset = vramNext;
+        vramNext += aligned;
+        allocations[offset] = aligned;
+        counters.vramUsed += aligned;
+        return offset;
+    }
+
+    void queue(const Registration& r, Status status, uint64_t value0, uint64_t value1) {
+        Delivery d = { r.callback, r.refcon, status, { r.tag, r.kind, value0, value1 } };
+        outbox.push_back(d);
+        cond.notify_all();
+    }
+
+    // Fire satisfied (or orphaned) one-shot semaphore watches
+    void checkSemaphoreWatches() {
+        for (auto it = registrations.begin(); it != registrations.end();) {
+            const Registration& r = it->second;
+            if (r.kind != NVDAAL_NOTIFY_SEMAPHORE) { ++it; continue; }
+            auto sem = semaphores.find((uint32_t)r.arg0);
+            if (sem == semaphores.end()) {
+                queue(r, kStatusNotFound, 0, 0);            // Destroyed while watched
+            } else if (sem->second >= r.arg1) {
+                queue(r, kStatusSuccess, sem->second, 0);
+            } else {
+                ++it;
+                continue;
+            }
+            it = registrations.erase(it);
+        }
+    }
+
+    // Host pointer for [va, va + size) if it lies inside one GPU mapping
+    uint8_t *gpuPointer(uint64_t va, uint64_t size) {
+        if (va >= SIM_SYSMEM_GPU_VA_BASE) {
+            auto it = sysmemByVa.upper_bound(va);
+            if (it == sysmemByVa.begin()) return nullptr;
+            const Sysmem& mem = sysmem[(--it)->second];
+            if (va - mem.gpuVa > mem.size || size > mem.size - (va - mem.gpuVa)) return nullptr;
+            return mem.host + (va - mem.gpuVa);
+        }
+        auto it = gpuMappings.upper_bound(va);
+        if (it == gpuMappings.begin()) return nullptr;
+        --it;
+        if (va - it->first > it->second || size > it->second - (va - it->first)) return nullptr;
+        return vram + (it->first - SIM_VRAM_GPU_VA_BASE) + (va - it->first);
+    }
+
+    Status allocSysmem(uint64_t size, uint64_t result[2]) {
+        if (size == 0 || size > NVDAAL_MAX_SYSMEM_SIZE) return kStatusBadArgument;
+        if (sysmem.size() >= NVDAAL_MAX_SYSMEM_ALLOCS) return kStatusNoResources;
+        size = (size + 0xFFF) & ~0xFFFULL;
+        void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+        if (p == MAP_FAILED) return kStatusNoMemory;
+
+        do {
+            nextSysmem = (nextSysmem + 1) & NVDAAL_MEMORY_SYSMEM_HANDLE_MASK;
+        } while (nextSysmem == 0 || sysmem.count(nextSysmem));
+        Sysmem mem = { (uint8_t *)p, size, sysmemVaNext };
+        sysmemVaNext += size + 0x10000;                 // Unmapped guard between allocations
+        sysmem[nextSysmem] = mem;
+        sysmemByVa[mem.gpuVa] = nextSysmem;
+        counters.sysmemUsed += size;
+        result[0] = nextSysmem;
+        result[1] = mem.gpuVa;
+        return kStatusSuccess;
+    }
+
+    // Semaphore handle behind a GPU VA from CreateSemaphore, 0 if none
+    uint32_t semaphoreAt(uint64_t va) {
+        if (va < SIM_SEMAPHORE_GPU_VA_BASE || (va - SIM_SEMAPHORE_GPU_VA_BASE) % SIM_SEMAPHORE_STRIDE) return 0;
+        uint64_t handle = (va - SIM_SEMAPHORE_GPU_VA_BASE) / SIM_SEMAPHORE_STRIDE;
+        return handle <= UINT32_MAX && semaphores.count((uint32_t)handle) ? (uint32_t)handle : 0;
+    }
+
+    void channelError(uint64_t faultVa) {
+        counters.faults++;
+        for (auto& entry : registrations) {
+            if (entry.second.kind == NVDAAL_NOTIFY_CHANNEL_ERROR) queue(entry.second, kStatusSuccess, faultVa, 0);
+        }
+    }
+
+    // Semaphore release from any engine: a timeline semaphore or plain memory
+    void release(uint64_t va, uint64_t payload, bool wide, bool *fault) {
+        uint32_t handle = semaphoreAt(va);
+        uint8_t *mem = handle ? nullptr : gpuPointer(va, wide ? 8 : 4);
+        if (handle) signalSemaphore(handle, payload);
+        else if (mem) memcpy(mem, &payload, wide ? 8 : 4);
+        else *fault = true;
+    }
+
+    // SEM_EXECUTE. Returns false if an acquire is not yet satisfied.
+    bool semaphoreExecute(Channel& ch, uint32_t execute, bool *fault) {
+        uint64_t va = ((uint64_t)(ch.hostMethods[NVC56F_SEM_ADDR_HI / 4] & 0x01FFFFFFu) << 32) |
+                      ch.hostMethods[NVC56F_SEM_ADDR_LO / 4];
+        uint64_t payload = ((uint64_t)ch.hostMethods[NVC56F_SEM_PAYLOAD_HI / 4] << 32) |
+                           ch.hostMethods[NVC56F_SEM_PAYLOAD_LO / 4];
+        bool wide = (execute & NVC56F_SEM_EXECUTE_PAYLOAD_SIZE_64BIT) != 0;
+        uint32_t operation = execute & 0x7;
+
+        uint32_t handle = semaphoreAt(va);
+        uint8_t *mem = handle ? nullptr : gpuPointer(va, wide ? 8 : 4);
+        if (!handle && !mem) {
+            *fault = true;
+            return true;
+        }
+
+        if (operation == NVC56F_SEM_EXECUTE_OPERATION_RELEASE) {
+            release(va, payload, wide, fault);
+            return true;
+        }
+
+        uint64_t current = 0;
+        if (handle) current = semaphores[handle];
+        else memcpy(&current, mem, wide ? 8 : 4);
+        if (!wide) payload &= 0xFFFFFFFFu;
+        return operation == NVC56F_SEM_EXECUTE_OPERATION_ACQUIRE ? current == payload : current >= payload;
+    }
+
+    // One method write. Returns false to stall on an acquire.
+    bool method(Channel& ch, uint32_t subch, uint32_t addr, uint32_t data, bool *fault) {
+        switch (subch) {
+            case NV_PB_SUBCH_HOST:
+                if (addr == NVC56F_SEM_EXECUTE) return semaphoreExecute(ch, data, fault);
+                if (addr < sizeof(ch.hostMethods)) ch.hostMethods[addr / 4] = data;
+                return true;
+
+            case NV_PB_SUBCH_COMPUTE:
+                if (ch.copyOnly) {
+                    *fault = true;                      // No compute engine behind a copy channel
+                } else if (addr == NVC9C0_SEND_PCAS_A) {
+                    ch.computePcasA = data;
+                } else if (addr == NVC9C0_SEND_SIGNALING_PCAS_B && (data & NVC9C0_SEND_SIGNALING_PCAS_B_SCHEDULE)) {
+                    if (!gpuPointer((uint64_t)ch.computePcasA << 8, NV_QMD_ALIGN)) *fault = true;
+                    else counters.dispatches++;
+                }
+                return true;
+
+            case NV_PB_SUBCH_COPY:
+                if (addr == NVC7B5_LAUNCH_DMA) launchDma(ch, data, fault);
+                else if (addr < sizeof(ch.copyMethods)) ch.copyMethods[addr / 4] = data;
+                return true;
+
+            default:
+                *fault = true;
+                return true;
+        }
+    }
+
+    // Bytes per destination element of a remapped launch (0 if unsupported:
+    // only constant components are modelled)
+    static uint32_t remapElement(const uint32_t *m, uint8_t element[16]) {
+        uint32_t components = m[NVC7B5_SET_REMAP_COMPONENTS / 4];
+        uint32_t size = ((components >> NVC7B5_REMAP_COMPONENT_SIZE_SHIFT) & 0x3) + 1;
+        uint32_t count = ((components >> NVC7B5_REMAP_NUM_DST_COMPONENTS_SHIFT) & 0x3) + 1;
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t select = (components >> (NVC7B5_REMAP_DST_X_SHIFT + 4 * i)) & 0x7;
+            if (select != NVC7B5_REMAP_CONST_A && select != NVC7B5_REMAP_CONST_B) return 0;
+            memcpy(element + i * size, &m[(select == NVC7B5_REMAP_CONST_A ? NVC7B5_SET_REMAP_CONST_A
+                                                                            : NVC7B5_SET_REMAP_CONST_B) / 4], size);
+        }
+        return size * count;
+    }
+
+    // LAUNCH_DMA: the pitched copy or constant fill, then the semaphore release
+    void launchDma(Channel& ch, uint32_t launch, bool *fault) {
+        const uint32_t *m = ch.copyMethods;
+        if ((launch & NVC7B5_LAUNCH_DMA_DATA_TRANSFER_TYPE_MASK) != NVC7B5_LAUNCH_DMA_DATA_TRANSFER_TYPE_NONE) {
+            uint64_t src = ((uint64_t)(m[NVC7B5_OFFSET_IN_UPPER / 4] & 0x01FFFFFFu) << 32) | m[NVC7B5_OFFSET_IN_LOWER / 4];
+            uint64_t dst = ((uint64_t)(m[NVC7B5_OFFSET_OUT_UPPER / 4] & 0x01FFFFFFu) << 32) | m[NVC7B5_OFFSET_OUT_LOWER / 4];
+            uint32_t lines = launch & NVC7B5_LAUNCH_DMA_MULTI_LINE_ENABLE ? m[NVC7B5_LINE_COUNT / 4] : 1;
+            uint64_t length = m[NVC7B5_LINE_LENGTH_IN / 4];
+            uint8_t element[16];
+            uint32_t elementBytes = 0;
+            if (launch & NVC7B5_LAUNCH_DMA_REMAP_ENABLE) {
+                elementBytes = remapElement(m, element);
+                if (!elementBytes) {
+                    *fault = true;
+                    return;
+                }
+                length *= elementBytes;                 // LINE_LENGTH_IN counts elements
+            }
+            for (uint32_t i = 0; i < lines; i++) {
+                uint8_t *to = gpuPointer(dst + (uint64_t)i * m[NVC7B5_PITCH_OUT / 4], length);
+                uint8_t *from = elementBytes ? nullptr : gpuPointer(src + (uint64_t)i * m[NVC7B5_PITCH_IN / 4], length);
+                if (!to || (!elementBytes && !from)) {
+                    *fault = true;
+                    return;
+                }
+                if (!elementBytes) {
+                    memmove(to, from, length);
+                    counters.copiedBytes += length;
+                } else {
+                    for (uint64_t pos = 0; pos < length; pos += elementBytes) memcpy(to + pos, element, elementBytes);
+                    counters.filledBytes += length;
+                }
+            }
+        }
+        uint32_t semaphore = launch & NVC7B5_LAUNCH_DMA_SEMAPHORE_TYPE_MASK;
+        if (semaphore == NVC7B5_LAUNCH_DMA_SEMAPHORE_TYPE_RELEASE_ONE_WORD) {
+            bool wide = (launch & NVC7B5_LAUNCH_DMA_SEMAPHORE_PAYLOAD_SIZE_64BIT) != 0;
+            uint64_t va = ((uint64_t)(m[NVC7B5_SET_SEMAPHORE_A / 4] & 0x01FFFFFFu) << 32) | m[NVC7B5_SET_SEMAPHORE_B / 4];
+            uint64_t payload = m[NVC7B5_SET_SEMAPHORE_PAYLOAD / 4];
+            if (wide) payload |= (uint64_t)m[NVC7B5_SET_SEMAPHORE_PAYLOAD_UPPER / 4] << 32;
+            release(va, payload, wide, fault);
+        } else if (semaphore) {
+            *fault = true;                              // Four-word and conditional releases aren't modelled
+        }
+    }
+
+    // Decode sub's pushbuffer from pbPos. Returns false on a stall; pbPos
+    // then points at the header of the method group that stalled.
+    bool execute(Channel& ch, Submission& sub) {
+        const uint8_t *pb = gpuPointer(sub.pbGpuVa, sub.pbBytes);
+        if (!pb) {
+            channelError(sub.pbGpuVa);
+            return true;
+        }
+        while (sub.pbPos < sub.pbBytes) {
+            uint32_t header;
+            memcpy(&header, pb + sub.pbPos, 4);
+            uint32_t secOp = header >> NV_PB_HDR_SEC_OP_SHIFT;
+            uint32_t count = (header >> NV_PB_HDR_COUNT_SHIFT) & NV_PB_HDR_COUNT_MASK;
+            uint32_t subch = (header >> NV_PB_HDR_SUBCH_SHIFT) & NV_PB_HDR_SUBCH_MASK;
+            uint32_t addr = (header & NV_PB_HDR_ADDR_MASK) << 2;
+            bool fault = false;
+
+            if (secOp == NV_PB_SEC_OP_IMMD_DATA_METHOD) {
+                if (!method(ch, subch, addr, count, &fault)) return false;
+                count = 0;
+            } else if (secOp == NV_PB_SEC_OP_INC_METHOD || secOp == NV_PB_SEC_OP_NON_INC_METHOD ||
+                       secOp == NV_PB_SEC_OP_ONE_INC) {
+                if ((uint64_t)count * 4 > sub.pbBytes - sub.pbPos - 4) {
+                    fault = true;
+                } else {
+                    for (uint32_t i = 0; i < count && !fault; i++) {
+                        uint32_t data;
+                        memcpy(&data, pb + sub.pbPos + 4 + i * 4, 4);
+                        uint32_t a = secOp == NV_PB_SEC_OP_INC_METHOD ? addr + i * 4 :
+                                     secOp == NV_PB_SEC_OP_ONE_INC && i ? addr + 4 : addr;
+                        // Only SEM_EXECUTE blocks, and it ends its group
+                        if (!method(ch, subch, a, data, &fault)) return false;
+                    }
+                }
+            } else {
+                fault = true;
+            }
+
+            if (fault) {
+                channelError(sub.pbGpuVa + sub.pbPos);
+                return true;
+            }
+            sub.pbPos += 4 + count * 4;
+        }
+        return true;
+    }
+
+    // The GPU reached a submission: run its pushbuffer, then its semaphore
+    // release. Returns false if the channel stalled on an acquire.
+    bool retire(Channel& ch, Submission& sub) {
+        if (sub.pbGpuVa && !execute(ch, sub)) return false;
+        counters.completed++;
+        if (sub.signalHandle) signalSemaphore(sub.signalHandle, sub.signalValue);
+        return true;
+    }
+
+    // Retire in-flight submissions up to `now`, in order within each channel.
+    // A release on one channel can unblock another, so sweep until nothing moves.
+    void advance(uint64_t now) {
+        if (retiring) return;                           // A release inside retire()
+        retiring = true;
+        for (bool moved = true; moved;) {
+            moved = false;
+            for (Channel& ch : channels) {
+                while (!ch.stalled && !ch.inFlight.empty() && ch.inFlight.front().doneNs <= now) {
+                    Submission& sub = ch.inFlight.front();
+                    if (!retire(ch, sub)) {
+                        sub.blocked = true;
+                        ch.stalled = true;
+                        break;
+                    }
+                    bool resumed = sub.blocked;
+                    ch.inFlight.pop_front();
+                    if (resumed) resume(ch, now);
+                    moved = true;
+                }
+            }
+        }
+        retiring = false;
+    }
+
+    // Work queued behind an acquire starts only once it is released: push
+    // the rest of the channel's completions back to run from `now`
+    void resume(Channel& ch, uint64_t now) {
+        uint64_t t = now;
+        for (Submission& sub : ch.inFlight) {
+            t += busyNs(sub);
+            if (sub.doneNs < t) sub.doneNs = t;
+            else t = sub.doneNs;
+        }
+        if (ch.freeNs < t) ch.freeNs = t;
+    }
+
+    // Engine time a submission takes on its channel
+    uint64_t busyNs(const Submission& sub) const {
+        if (sub.hostOnly) return 0;
+        uint64_t ns = config.submitLatencyUs * 1000ULL;
+        if (config.copyMBps) ns += sub.copyBytes * 1000 / config.copyMBps;
+        return ns;
+    }
+
+    void doorbell(Channel& ch) {
+        nvCoalesceReset(&ch.coalesce);
+        counters.doorbells++;
+        uint64_t now = simNowNs();
+        while (!ch.held.empty()) {
+            Submission sub = ch.held.front();
+            ch.held.pop_front();
+            ch.freeNs = (ch.freeNs > now ? ch.freeNs : now) + busyNs(sub);
+            sub.doneNs = ch.freeNs;
+            ch.inFlight.push_back(sub);
+        }
+        if (!config.submitLatencyUs) advance(now);
+        cond.notify_all();
+    }
+
+    void flush() {
+        for (Channel& ch : channels) {
+            if (!ch.held.empty()) doorbell(ch);
+        }
+    }
+
+    Status submit(uint32_t cmd, uint32_t signalHandle, uint64_t signalValue) {
+        (void)cmd;
+        return enqueue(channels[0], { signalHandle, signalValue, 0, 0, sizeof(uint32_t), 0, false, false, 0 });
+    }
+
+    Status submitPushbuffer(uint64_t gpuVa, uint64_t arg, uint32_t signalHandle, uint64_t signalValue) {
+        uint64_t bytes = NVDAAL_PUSHBUFFER_ARG_BYTES(arg);
+        uint64_t channel = NVDAAL_PUSHBUFFER_ARG_CHANNEL(arg);
+        bool copy = (channel & NVDAAL_CHANNEL_COPY) != 0;
+        channel &= ~(uint64_t)NVDAAL_CHANNEL_COPY;
+        if (channel >= (copy ? channels.size() - computeChannels : computeChannels) || bytes == 0 ||
+            bytes > NVDAAL_MAX_PUSHBUFFER_BYTES || (gpuVa | bytes) & (NVDAAL_PUSHBUFFER_ALIGN - 1)) {
+            return kStatusBadArgument;
+        }
+        const uint8_t *pb = gpuPointer(gpuVa, bytes);
+        if (!pb) return kStatusNotFound;
+        Channel& ch = channels[copy ? computeChannels + channel : channel];
+        return enqueue(ch, { signalHandle, signalValue, 0, gpuVa, (uint32_t)bytes, 0,
+                             hostOnly(pb, (uint32_t)bytes), false, copyBytes(pb, (uint32_t)bytes) });
+    }
+
+    // Bytes the pushbuffer's copy-engine launches move or fill
+    static uint64_t copyBytes(const uint8_t *pb, uint32_t bytes) {
+        uint32_t lineLength = 0, lineCount = 0, components = 0;
+        uint64_t total = 0;
+        auto launch = [&](uint32_t data) {
+            if ((data & NVC7B5_LAUNCH_DMA_DATA_TRANSFER_TYPE_MASK) == NVC7B5_LAUNCH_DMA_DATA_TRANSFER_TYPE_NONE) return;
+            uint64_t line = lineLength;
+            if (data & NVC7B5_LAUNCH_DMA_REMAP_ENABLE) {
+                line *= (((components >> NVC7B5_REMAP_COMPONENT_SIZE_SHIFT) & 0x3) + 1) *
+                        (((components >> NVC7B5_REMAP_NUM_DST_COMPONENTS_SHIFT) & 0x3) + 1);
+            }
+            total += line * (data & NVC7B5_LAUNCH_DMA_MULTI_LINE_ENABLE ? lineCount : 1);
+        };
+        for (uint32_t pos = 0; pos + 4 <= bytes;) {
+            uint32_t header;
+            memcpy(&header, pb + pos, 4);
+            uint32_t secOp = header >> NV_PB_HDR_SEC_OP_SHIFT;
+            uint32_t count = (header >> NV_PB_HDR_COUNT_SHIFT) & NV_PB_HDR_COUNT_MASK;
+            uint32_t addr = (header & NV_PB_HDR_ADDR_MASK) << 2;
+            bool copy = ((header >> NV_PB_HDR_SUBCH_SHIFT) & NV_PB_HDR_SUBCH_MASK) == NV_PB_SUBCH_COPY;
+            if (secOp == NV_PB_SEC_OP_IMMD_DATA_METHOD) {
+                if (copy && addr == NVC7B5_LAUNCH_DMA) launch(count);
+                pos += 4;
+                continue;
+            }
+            for (uint32_t i = 0; copy && secOp == NV_PB_SEC_OP_INC_METHOD && i < count && pos + 8 + i * 4 <= bytes; i++) {
+                uint32_t data;
+                memcpy(&data, pb + pos + 4 + i * 4, 4);
+                uint32_t a = addr + i * 4;
+                if (a == NVC7B5_LINE_LENGTH_IN) lineLength = data;
+                else if (a == NVC7B5_LINE_COUNT) lineCount = data;
+                else if (a == NVC7B5_SET_REMAP_COMPONENTS) components = data;
+                else if (a == NVC7B5_LAUNCH_DMA) launch(data);
+            }
+            pos += 4 + count * 4;
+        }
+        return total;
+    }
+
+    // True if every method group is a host (semaphore) method
+    static bool hostOnly(const uint8_t *pb, uint32_t bytes) {
+        for (uint32_t pos = 0; pos + 4 <= bytes;) {
+            uint32_t header;
+            memcpy(&header, pb + pos, 4);
+            uint32_t secOp = header >> NV_PB_HDR_SEC_OP_SHIFT;
+            uint32_t count = (header >> NV_PB_HDR_COUNT_SHIFT) & NV_PB_HDR_COUNT_MASK;
+            if (((header >> NV_PB_HDR_SUBCH_SHIFT) & NV_PB_HDR_SUBCH_MASK) != NV_PB_SUBCH_HOST) return false;
+            pos += 4 + (secOp == NV_PB_SEC_OP_IMMD_DATA_METHOD ? 0 : count * 4);
+        }
+        return true;
+    }
+
+    Status enqueue(Channel& ch, const Submission& sub) {
+        if (sub.signalHandle && !semaphores.count(sub.signalHandle)) return kStatusError;
+        counters.submissions++;
+        ch.held.push_back(sub);
+        NvCoalesceDecision d = nvCoalesceSubmit(&policy, &ch.coalesce, sub.pbBytes, simNowNs());
+        if (d != NV_COALESCE_HOLD) doorbell(ch);
+        else cond.notify_all();                         // Worker arms the deadline
+        return kStatusSuccess;
+    }
+
+    Status waitSemaphores(std::unique_lock<std::mutex>& lk, const uint32_t *handles, const uint64_t *values,
+                          uint32_t count, bool waitAll, uint32_t timeoutMs, uint32_t *signaled) {
+        flush();
+        SimClock::time_point deadline = SimClock::now() + std::chrono::milliseconds(timeoutMs);
+        for (;;) {
+            uint32_t reached = 0;
+            for (uint32_t i = 0; i < count; i++) {
+                auto it = semaphores.find(handles[i]);
+                if (it == semaphores.end()) return kStatusNotFound;
+                if (it->second >= values[i]) {
+                    if (!waitAll) {
+                        if (signaled) *signaled = i;
+                        return kStatusSuccess;
+                    }
+                    reached++;
+                }
+            }
+            if (waitAll && reached == count) {
+                if (signaled) *signaled = 0;
+                return kStatusSuccess;
+            }
+            if (cond.wait_until(lk, deadline) == std::cv_status::timeout && SimClock::now() >= deadline) {
+                return kStatusTimeout;
+            }
+        }
+    }
+
+    Status executeOp(std::unique_lock<std::mutex>& lk, const NvdaalOpRequest *req, uint64_t result[2]) {
+        if (req->flags != 0) return kStatusBadArgument;
+        counters.ops++;
+
+        switch (req->op) {
+            case NVDAAL_OP_NOP:
+                return kStatusSuccess;
+
+            case NVDAAL_OP_ALLOC_VRAM:
+                result[0] = allocVram(req->args[0]);
+                return result[0] || req->args[0] == 0 ? kStatusSuccess : kStatusNoMemory;
+
+            case NVDAAL_OP_SUBMIT_COMMAND:
+                return submit((uint32_t)req->args[0], (uint32_t)req->args[1], req->args[2]);
+
+            case NVDAAL_OP_CREATE_SEMAPHORE:
+                return createSemaphore(req->args[0], result);
+
+            case NVDAAL_OP_DESTROY_SEMAPHORE:
+                return destroySemaphore((uint32_t)req->args[0]);
+
+            case NVDAAL_OP_SIGNAL_SEMAPHORE:
+                return signalSemaphore((uint32_t)req->args[0], req->args[1]);
+
+            case NVDAAL_OP_READ_SEMAPHORE: {
+                auto it = semaphores.find((uint32_t)req->args[0]);
+                if (it == semaphores.end()) return kStatusNotFound;
+                result[0] = it->second;
+                return kStatusSuccess;
+            }
+
+            case NVDAAL_OP_WAIT_SEMAPHORE: {
+                uint32_t handle = (uint32_t)req->args[0];
+                uint64_t value = req->args[1];
+                return waitSemaphores(lk, &handle, &value, 1, true, (uint32_t)req->args[2], nullptr);
+            }
+
+            case NVDAAL_OP_FLUSH_SUBMISSIONS:
+                flush();
+                return kStatusSuccess;
+
+            case NVDAAL_OP_MAP_VRAM:
+                if (req->args[1] == 0 || !findVram(req->args[0], req->args[1], nullptr)) return kStatusNotFound;
+                if (vaMappings >= NVDAAL_MAX_VRAM_MAPPINGS || req->args[1] > NVDAAL_MAX_VRAM_MAPPED_BYTES - vaMappedBytes) {
+                    return kStatusNoResources;
+                }
+                vaMappings++;
+                vaMappedBytes += req->args[1];
+                result[0] = SIM_VRAM_GPU_VA_BASE + req->args[0];
+                gpuMappings[result[0]] = req->args[1];
+                return kStatusSuccess;
+
+            case NVDAAL_OP_UNMAP_VRAM: {
+                auto it = gpuMappings.find(req->args[0]);
+                if (it == gpuMappings.end() || it->second != req->args[1]) return kStatusNotFound;
+                gpuMappings.erase(it);
+                return kStatusSuccess;
+            }
+
+            case NVDAAL_OP_SUBMIT_PUSHBUFFER:
+                return submitPushbuffer(req->args[0], req->args[1], (uint32_t)req->args[2], req->args[3]);
+
+            case NVDAAL_OP_ALLOC_SYSMEM:
+                return allocSysmem(req->args[0], result);
+
+            case NVDAAL_OP_FREE_SYSMEM:
+                return kStatusUnsupported;              // As the kext: sysmem is never unwired
+
+            case NVDAAL_OP_QUERY:
+                switch (req->args[0]) {
+                    case NVDAAL_QUERY_CHIP_ID:
+                        result[0] = config.pmcBoot0;
+                        return kStatusSuccess;
+                    case NVDAAL_QUERY_WPR2:
+                        result[0] = wpr2Enabled ? (0xFFE00000ULL << 32) | 0xFFC00000ULL : 0;
+                        result[1] = wpr2Enabled;
+                        return kStatusSuccess;
+                    case NVDAAL_QUERY_GSP_STATE:
+                        result[0] = gspLoaded ? 0x80 : 0x10;    // CPUCTL: active / halted
+                        result[1] = gspLoaded ? 0xFF : 0;
+                        return kStatusSuccess;
+                    case NVDAAL_QUERY_CHANNELS:
+                        result[0] = computeChannels;
+                        return kStatusSuccess;
+                    case NVDAAL_QUERY_COPY_CHANNELS:
+                        result[0] = channels.size() - computeChannels;
+                        return kStatusSuccess;
+                    default:
+                        return kStatusBadArgument;
+                }
+
+            default:
+                return kStatusUnsupported;
+        }
+    }
+
+    Status createSemaphore(uint64_t initial, uint64_t result[2]) {
+        if (semaphores.size() >= SIM_MAX_SEMAPHORES) return kStatusNoResources;
+        uint32_t handle;
+        do { handle = ++nextSemaphore; } while (handle == 0 || semaphores.count(handle));
+        semaphores[handle] = initial;
+        result[0] = handle;
+        result[1] = SIM_SEMAPHORE_GPU_VA_BASE + (uint64_t)handle * SIM_SEMAPHORE_STRIDE;
+        return kStatusSuccess;
+    }
+
+    Status destroySemaphore(uint32_t handle) {
+        if (!semaphores.erase(handle)) return kStatusNotFound;
+        checkSemaphoreWatches();
+        cond.notify_all();
+        return kStatusSuccess;
+    }
+
+    Status signalSemaphore(uint32_t handle, uint64_t value) {
+        auto it = semaphores.find(handle);
+        if (it == semaphores.end()) return kStatusNotFound;
+        if (value > it->second) it->second = value;     // Payloads never go backwards
+        bool retry = false;
+        for (Channel& ch : channels) {
+            if (ch.stalled) retry = true;
+            ch.stalled = false;                         // Retry blocked acquires
+        }
+        if (retry) advance(simNowNs());
+        checkSemaphoreWatches();
+        cond.notify_all();
+        return kStatusSuccess;
+    }
+
+    struct RingContext {
+        State *state;
+        std::unique_lock<std::mutex> *lk;
+    };
+
+    static int32_t ringAction(void *ctx, const NvdaalOpRequest *req, uint64_t result[2]) {
+        RingContext *rc = (RingContext *)ctx;
+        return rc->state->executeOp(*rc->lk, req, result);
+    }
+
+    Status drainRing(std::unique_lock<std::mutex>& lk, uint32_t budget, uint32_t *processed) {
+        *processed = 0;
+        if (!ring) return kStatusNotReady;
+
+        // The kext's consumer loop, so ring tests exercise the real one
+        RingContext ctx = { this, &lk };
+        return nvRingDrain(ring, &reqTail, &cplHead, budget, ringAction, &ctx, processed) ? kStatusSuccess
+                                                                                           : kStatusBadArgument;
+    }
+
+    Status executeBatch(std::unique_lock<std::mutex>& lk, const void *in, size_t inSize,
+                        void *out, size_t *outSize, uint64_t *executedOut) {
+        if (!in || inSize < NVDAAL_BATCH_INPUT_SIZE(0) || inSize > NVDAAL_BATCH_INPUT_SIZE(NVDAAL_MAX_BATCH_OPS)) {
+            return kStatusBadArgument;
+        }
+        const NvdaalBatchHeader *hdr = (const NvdaalBatchHeader *)in;
+        uint32_t count = hdr->count;
+        size_t capacity = outSize ? *outSize : 0;
+        if (!out || count == 0 || count > NVDAAL_MAX_BATCH_OPS || inSize < NVDAAL_BATCH_INPUT_SIZE(count) ||
+            capacity < NVDAAL_BATCH_OUTPUT_SIZE(count)) {
+            return kStatusBadArgument;
+        }
+
+        const NvdaalOpRequest *reqs = (const NvdaalOpRequest *)((const uint8_t *)in + sizeof(NvdaalBatchHeader));
+        NvdaalOpCompletion *cpls = (NvdaalOpCompletion *)out;
+        bool stopOnError = (hdr->flags & NVDAAL_BATCH_STOP_ON_ERROR) != 0;
+        bool failed = false;
+        uint64_t executed = 0;
+
+        for (uint32_t i = 0; i < count; i++) {
+            NvdaalOpRequest req = reqs[i];
+            cpls[i].cookie = req.cookie;
+            cpls[i].op = req.op;
+            cpls[i].result[0] = 0;
+            cpls[i].result[1] = 0;
+            if (failed && stopOnError) {
+                cpls[i].status = kStatusAborted;
+                continue;
+            }
+            cpls[i].status = executeOp(lk, &req, cpls[i].result);
+            if (cpls[i].status != kStatusSuccess) failed = true;
+            executed++;
+        }
+        *outSize = NVDAAL_BATCH_OUTPUT_SIZE(count);
+        if (executedOut) *executedOut = executed;
+        return kStatusSuccess;
+    }
+
+    // Completes submissions, enforces coalescing deadlines, delivers notifications
+    void run() {
+        std::unique_lock<std::mutex> lk(lock);
+        while (!stopping) {
+            uint64_t now = simNowNs();
+            for (Channel& ch : channels) {
+                if (nvCoalesceExpired(&policy, &ch.coalesce, now)) doorbell(ch);
+            }
+            advance(now);
+
+            if (!outbox.empty()) {
+                // Callbacks run unlocked so they may call back into the backend
+                std::deque<Delivery> batch;
+                batch.swap(outbox);
+                lk.unlock();
+                for (Delivery& d : batch) {
+                    void *args[NVDAAL_NOTIFY_ARG_COUNT];
+                    for (int i = 0; i < NVDAAL_NOTIFY_ARG_COUNT; i++) args[i] = (void *)(uintptr_t)d.args[i];
+                    d.callback(d.refcon, d.status, args, NVDAAL_NOTIFY_ARG_COUNT);
+                }
+                lk.lock();
+                continue;
+            }
+
+            uint64_t wake = 0;
+            bool stalled = false;
+            for (Channel& ch : channels) {
+                uint64_t due = nvCoalesceDeadlineNs(&policy, &ch.coalesce);
+                if (ch.stalled) {
+                    stalled = true;
+                } else if (!ch.inFlight.empty() && (!due || ch.inFlight.front().doneNs < due)) {
+                    due = ch.inFlight.front().doneNs;
+                }
+                if (due && (!wake || due < wake)) wake = due;
+            }
+            if (stalled) {
+                // Semaphore payloads in VRAM change without a signal: poll
+                uint64_t poll = now + SIM_STALL_POLL_US * 1000ULL;
+                if (!wake || poll < wake) wake = poll;
+                if (cond.wait_for(lk, std::chrono::nanoseconds(wake > now ? wake - now : 0)) ==
+                    std::cv_status::timeout) {
+                    for (Channel& ch : channels) ch.stalled = false;
+                }
+                continue;
+            }
+            if (wake) {
+                cond.wait_for(lk, std::chrono::nanoseconds(wake > now ? wake - now : 0));
+            } else {
+                cond.wait(lk);
+            }
+        }
+    }
+};
+
+SimBackend::SimBackend(const SimConfig& config) : state(new State) {
+    state->config = config;
+    nvCoalescePolicyDisabled(&state->policy);
+}
+
+SimBackend::~SimBackend() {
+    close();
+    delete state;
+}
+
+Status SimBackend::open() {
+    if (state->opened) return kStatusSuccess;
+
+    void *p = mmap(nullptr, state->config.vramBytes, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANON | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED) return kStatusNoMemory;
+
+    state->vram = (uint8_t *)p;
+    uint32_t channels = state->config.channels;
+    uint32_t copies = state->config.copyChannels;
+    state->computeChannels = channels < 1 ? 1 : channels > NVDAAL_MAX_CHANNELS ? NVDAAL_MAX_CHANNELS : channels;
+    state->channels.resize(state->computeChannels + (copies > NVDAAL_MAX_COPY_CHANNELS ? NVDAAL_MAX_COPY_CHANNELS : copies));
+    for (size_t i = state->computeChannels; i < state->channels.size(); i++) state->channels[i].copyOnly = true;
+    state->stats.sinceNs = simNowNs();
+    {
+        std::lock_guard<std::mutex> guard(gGlobalStatsLock);
+        if (!gGlobalStats.sinceNs) gGlobalStats.sinceNs = state->stats.sinceNs;
+    }
+    state->stopping = false;
+    state->worker = std::thread(&State::run, state);
+    state->opened = true;
+    return kStatusSuccess;
+}
+
+void SimBackend::close() {
+    if (!state->opened) return;
+    {
+        std::lock_guard<std::mutex> guard(state->lock);
+        state->stopping = true;
+        state->cond.notify_all();
+    }
+    state->worker.join();
+
+    // Registrations and state die with the connection
+    if (state->ring) munmap(state->ring, NVDAAL_RING_SIZE);
+    for (auto& entry : state->sysmem) munmap(entry.second.host, entry.second.size);
+    munmap(state->vram, state->config.vramBytes);
+    SimConfig config = state->config;
+    delete state;
+    state = new State;
+    state->config = config;
+    nvCoalescePolicyDisabled(&state->policy);
+}
+
+Status SimBackend::call(uint32_t selector,
+                        const uint64_t *input, uint32_t inputCount,
+                        const void *inputStruct, size_t inputStructSize,
+                        uint64_t *output, uint32_t *outputCount,
+                        void *outputStruct, size_t *outputStructSize) {
+    if (!state->opened) return kStatusNotReady;
+
+    uint64_t start = simNowNs();
+    if (state->config.callOverheadNs) {
+        while (simNowNs() - start < state->config.callOverheadNs) {}
+    }
+
+    uint32_t outCapacity = outputCount ? *outputCount : 0;
+    if (outputCount) *outputCount = 0;
+    Status ret = kStatusSuccess;
+
+    std::unique_lock<std::mutex> lk(state->lock);
+    state->counters.calls++;
+
+    switch (selector) {
+        case METHOD_LOAD_FIRMWARE:
+        case METHOD_LOAD_BOOTER:
+        case METHOD_LOAD_VBIOS:
+        case METHOD_LOAD_BOOTLOADER: {
+            uint64_t max = selector == METHOD_LOAD_FIRMWARE ? NVDAAL_MAX_GSP_FIRMWARE_SIZE :
+                           selector == METHOD_LOAD_VBIOS ? NVDAAL_MAX_VBIOS_SIZE :
+                           selector == METHOD_LOAD_BOOTER ? NVDAAL_MAX_BOOTER_LOAD_SIZE :
+                           NVDAAL_MAX_BOOTLOADER_SIZE;
+            if (inputCount != 2 || !input[0] || !input[1] || input[1] > max) {
+                ret = kStatusBadArgument;
+                break;
+            }
+            // Read the buffer in place, as the driver does with the wired range
+            const volatile uint8_t *p = (const volatile uint8_t *)(uintptr_t)input[0];
+            for (uint64_t off = 0; off < input[1]; off += 4096) (void)p[off];
+            if (selector == METHOD_LOAD_FIRMWARE) state->gspLoaded = true;
+            break;
+        }
+
+        case METHOD_ALLOC_VRAM:
+            if (inputCount != 1 || outCapacity != 1) { ret = kStatusBadArgument; break; }
+            output[0] = state->allocVram(input[0]);
+            if (output[0] == 0 && input[0] > 0) { ret = kStatusNoMemory; break; }
+            *outputCount = 1;
+            break;
+
+        case METHOD_SUBMIT_CMD:
+            if (inputCount != 1 && inputCount != 3) { ret = kStatusBadArgument; break; }
+            ret = inputCount == 3 ? state->submit((uint32_t)input[0], (uint32_t)input[1], input[2]) :
+                                    state->submit((uint32_t)input[0], 0, 0);
+            break;
+
+        case METHOD_WAIT_SYNC: {
+            if (inputCount != 2 && inputCount != 3) { ret = kStatusBadArgument; break; }
+            uint64_t va = input[0];
+            uint32_t handle = 0;
+            if (va >= SIM_SEMAPHORE_GPU_VA_BASE && (va - SIM_SEMAPHORE_GPU_VA_BASE) % SIM_SEMAPHORE_STRIDE == 0) {
+                handle = (uint32_t)((va - SIM_SEMAPHORE_GPU_VA_BASE) / SIM_SEMAPHORE_STRIDE);
+            }
+            uint32_t timeoutMs = inputCount == 3 ? (uint32_t)input[2] : 1000;
+            ret = state->waitSemaphores(lk, &handle, &input[1], 1, true, timeoutMs, nullptr);
+            break;
+        }
+
+        case METHOD_GET_STATUS: {
+            if (outCapacity < 9) { ret = kStatusBadArgument; break; }
+            output[0] = state->config.pmcBoot0;
+            output[1] = state->wpr2Enabled ? 0xFFC00000 : 0;
+            output[2] = state->wpr2Enabled ? 0xFFE00000 : 0;
+            output[3] = state->wpr2Enabled;
+            output[4] = state->gspLoaded ? 0x80 : 0x10;
+            output[5] = 0x10;
+            output[6] = 0;
+            output[7] = 0;
+            output[8] = state->gspLoaded ? 0xFF : 0;
+            *outputCount = 9;
+            break;
+        }
+
+        case METHOD_EXECUTE_FWSEC:
+            state->wpr2Enabled = true;
+            if (outCapacity >= 1) {
+                output[0] = 1;
+                *outputCount = 1;
+            }
+            break;
+
+        case METHOD_CREATE_SEMAPHORE: {
+            if (inputCount != 1 || outCapacity != 2) { ret = kStatusBadArgument; break; }
+            ret = state->createSemaphore(input[0], output);
+            if (ret == kStatusSuccess) *outputCount = 2;
+            break;
+        }
+
+        case METHOD_DESTROY_SEMAPHORE:
+            ret = inputCount == 1 ? state->destroySemaphore((uint32_t)input[0]) : kStatusBadArgument;
+            break;
+
+        case METHOD_SIGNAL_SEMAPHORE:
+            ret = inputCount == 2 ? state->signalSemaphore((uint32_t)input[0], input[1]) : kStatusBadArgument;
+            break;
+
+        case METHOD_READ_SEMAPHORE: {
+            if (inputCount != 1 || outCapacity != 1) { ret = kStatusBadArgument; break; }
+            auto it = state->semaphores.find((uint32_t)input[0]);
+            if (it == state->semaphores.end()) { ret = kStatusNotFound; break; }
+            output[0] = it->second;
+            *outputCount = 1;
+            break;
+        }
+
+        case METHOD_WAIT_SEMAPHORES: {
+            const NvdaalSemaphoreWaitArgs *wa = (const NvdaalSemaphoreWaitArgs *)inputStruct;
+            if (!wa || inputStructSize < NVDAAL_SEMAPHORE_WAIT_ARGS_SIZE(0) ||
+                wa->count == 0 || wa->count > NVDAAL_MAX_WAIT_SEMAPHORES ||
+                inputStructSize < NVDAAL_SEMAPHORE_WAIT_ARGS_SIZE(wa->count)) {
+                ret = kStatusBadArgument;
+                break;
+            }
+            uint32_t handles[NVDAAL_MAX_WAIT_SEMAPHORES];
+            uint64_t values[NVDAAL_MAX_WAIT_SEMAPHORES];
+            for (uint32_t i = 0; i < wa->count; i++) {
+                handles[i] = wa->entries[i].handle;
+                values[i] = wa->entries[i].value;
+            }
+            uint32_t signaled = 0;
+            ret = state->waitSemaphores(lk, handles, values, wa->count, (wa->flags & NVDAAL_WAIT_ALL) != 0,
+                                        wa->timeoutMs, &signaled);
+            if (ret == kStatusSuccess && outCapacity >= 1) {
+                output[0] = signaled;
+                *outputCount = 1;
+            }
+            break;
+        }
+
+        case METHOD_SET_SUBMIT_POLICY:
+            if (inputCount != 4) { ret = kStatusBadArgument; break; }
+            state->flush();
+            state->policy.maxEntries = (uint32_t)input[0];
+            state->policy.maxBytes = (uint32_t)input[1];
+            state->policy.deadlineUs = (uint32_t)input[2];
+            state->policy.flags = (uint32_t)input[3];
+            state->cond.notify_all();
+            break;
+
+        case METHOD_FLUSH_SUBMISSIONS:
+            state->flush();
+            break;
+
+        case METHOD_RING_KICK: {
+            uint32_t budget = inputCount >= 1 && input[0] ? (uint32_t)input[0] : NVDAAL_RING_REQUEST_SLOTS;
+            uint32_t processed = 0;
+            ret = state->drainRing(lk, budget, &processed);
+            if (outCapacity >= 1) {
+                output[0] = processed;
+                *outputCount = 1;
+            }
+            break;
+        }
+
+        case METHOD_SUBMIT_PUSHBUFFER:
+            if (inputCount != 2 && inputCount != 4) { ret = kStatusBadArgument; break; }
+            ret = inputCount == 4 ? state->submitPushbuffer(input[0], input[1], (uint32_t)input[2], input[3]) :
+                                    state->submitPushbuffer(input[0], input[1], 0, 0);
+            break;
+
+        case METHOD_CANCEL_NOTIFICATION:
+            if (inputCount != 1) { ret = kStatusBadArgument; break; }
+            ret = state->registrations.erase((uint32_t)input[0]) ? kStatusSuccess : kStatusNotFound;
+            break;
+
+        case METHOD_EXECUTE_BATCH: {
+            uint64_t executed = 0;
+            ret = state->executeBatch(lk, inputStruct, inputStructSize, outputStruct, outputStructSize, &executed);
+            if (ret == kStatusSuccess && outCapacity >= 1) {
+                output[0] = executed;
+                *outputCount = 1;
+            }
+            break;
+        }
+
+        case METHOD_GET_STATS: {
+            if (inputCount < 1 || inputCount > 2 || !outputStruct || !outputStructSize ||
+                *outputStructSize < sizeof(NvdaalStats)) {
+                ret = kStatusBadArgument;
+                break;
+            }
+            uint64_t flags = inputCount > 1 ? input[1] : 0;
+            if (input[0] == NVDAAL_STATS_SCOPE_GLOBAL) {
+                if (flags & NVDAAL_STATS_RESET) { ret = kStatusNotPermitted; break; }
+                std::lock_guard<std::mutex> guard(gGlobalStatsLock);
+                memcpy(outputStruct, &gGlobalStats, sizeof(NvdaalStats));
+            } else if (input[0] == NVDAAL_STATS_SCOPE_CLIENT) {
+                memcpy(outputStruct, &state->stats, sizeof(NvdaalStats));
+                if (flags & NVDAAL_STATS_RESET) {
+                    memset(state->stats.selectors, 0, sizeof(state->stats.selectors));
+                    state->stats.sinceNs = simNowNs();
+                }
+            } else {
+                ret = kStatusBadArgument;
+                break;
+            }
+            *outputStructSize = sizeof(NvdaalStats);
+            break;
+        }
+
+        case METHOD_REGISTER_NOTIFICATION:  // Async only
+        default:
+            ret = kStatusBadArgument;
+            break;
+    }
+
+    uint64_t ns = simNowNs() - start;
+    recordCall(&state->stats, selector, ns, ret);
+    lk.unlock();
+    {
+        std::lock_guard<std::mutex> guard(gGlobalStatsLock);
+        recordCall(&gGlobalStats, selector, ns, ret);
+    }
+    return ret;
+}
+
+Status SimBackend::callAsync(uint32_t selector, AsyncCallback callback, void *refcon,
+                             const uint64_t *input, uint32_t inputCount,
+                             uint64_t *output, uint32_t *outputCount) {
+    if (!state->opened) return kStatusNotReady;
+    if (selector != METHOD_REGISTER_NOTIFICATION || !callback) return kStatusBadArgument;
+    if (inputCount != 4 || !outputCount || *outputCount != 1) return kStatusBadArgument;
+
+    uint64_t start = simNowNs();
+    Status ret = kStatusSuccess;
+    std::unique_lock<std::mutex> lk(state->lock);
+    state->counters.calls++;
+
+    uint32_t kind = (uint32_t)input[0];
+    if (kind != NVDAAL_NOTIFY_SEMAPHORE && kind != NVDAAL_NOTIFY_CHANNEL_ERROR && kind != NVDAAL_NOTIFY_GSP_EVENT) {
+        ret = kStatusBadArgument;
+    } else if (kind == NVDAAL_NOTIFY_SEMAPHORE && !state->semaphores.count((uint32_t)input[1])) {
+        ret = kStatusNotFound;
+    } else if (state->registrations.size() >= NVDAAL_MAX_NOTIFICATIONS) {
+        ret = kStatusNoResources;
+    } else {
+        uint32_t id;
+        do { id = ++state->nextRegistration; } while (id == 0 || state->registrations.count(id));
+        state->registrations[id] = { kind, input[1], input[2], input[3], callback, refcon };
+        output[0] = id;
+        *outputCount = 1;
+
+        // Already satisfied semaphores fire right away
+        if (kind == NVDAAL_NOTIFY_SEMAPHORE) state->checkSemaphoreWatches();
+    }
+
+    uint64_t ns = simNowNs() - start;
+    recordCall(&state->stats, selector, ns, ret);
+    lk.unlock();
+    {
+        std::lock_guard<std::mutex> guard(gGlobalStatsLock);
+        recordCall(&gGlobalStats, selector, ns, ret);
+    }
+    return ret;
+}
+
+Status SimBackend::mapMemory(uint32_t type, MapCache cache, void **addr, uint64_t *size) {
+    (void)cache;
+    if (!state->opened) return kStatusNotReady;
+    if (!addr) return kStatusBadArgument;
+
+    std::lock_guard<std::mutex> guard(state->lock);
+    if (NVDAAL_MEMORY_IS_VRAM(type)) {
+        uint64_t offset = NVDAAL_MEMORY_VRAM_OFFSET(type);
+        uint64_t allocSize = 0;
+        if (!state->findVram(offset, 0, &allocSize)) return kStatusNotFound;
+        *addr = state->vram + offset;
+        if (size) *size = allocSize;
+        return kStatusSuccess;
+    }
+
+    if (NVDAAL_MEMORY_IS_SYSMEM(type)) {
+        auto it = state->sysmem.find(NVDAAL_MEMORY_SYSMEM_HANDLE(type));
+        if (it == state->sysmem.end()) return kStatusNotFound;
+        *addr = it->second.host;
+        if (size) *size = it->second.size;
+        return kStatusSuccess;
+    }
+
+    if (type != NVDAAL_MEMORY_COMMAND_RING) return kStatusBadArgument;
+    if (!state->ring) {
+        void *p = mmap(nullptr, NVDAAL_RING_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+        if (p == MAP_FAILED) return kStatusNoMemory;
+        state->ring = (NvdaalRingControl *)p;
+        nvRingInit(state->ring);
+        state->reqTail = 0;
+        state->cplHead = 0;
+    }
+    *addr = state->ring;
+    if (size) *size = NVDAAL_RING_SIZE;
+    return kStatusSuccess;
+}
+
+Status SimBackend::unmapMemory(uint32_t type, void *addr) {
+    (void)type;
+    // Mappings alias simulator memory, which lives until close()
+    return state->opened && addr ? kStatusSuccess : kStatusBadArgument;
+}
+
+SimCounters SimBackend::counters() const {
+    std::lock_guard<std::mutex> guard(state->lock);
+    return state->counters;
+}
+
+void SimBackend::injectEvent(uint32_t kind, uint64_t value0, uint64_t value1) {
+    std::lock_guard<std::mutex> guard(state->lock);
+    for (auto& entry : state->registrations) {
+        const State::Registration& r = entry.second;
+        if (r.kind != kind || kind == NVDAAL_NOTIFY_SEMAPHORE) continue;
+        if (kind == NVDAAL_NOTIFY_GSP_EVENT && r.arg0 && r.arg0 != value0) continue;
+        state->queue(r, kStatusSuccess, value0, value1);
+    }
+}
+
+} // namespace nvdaal
@@ -0,0 +1,136 @@
+/*
+ * NVDAALStaging.cpp - Host <-> VRAM Transfers
+ */
+
+#include "NVDAALStaging.h"
+#include "NVDAALCopy.h"
+#include <cstring>
+#include <iostream>
+
+namespace nvdaal {
+
+StagingEngine::StagingEngine(Client& c, BufferAllocator& allocator, const StagingConfig& cfg)
+    : client(&c), config(cfg), copies(c, allocator, cfg.channel), next(0), chunk(0), counters() {
+    uint32_t count = config.chunks < 1 ? 1 : config.chunks;
+    slots.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        Sysmem mem = {};
+        if (!config.chunkBytes || !client->allocSysmem(config.chunkBytes, &mem)) {
+            std::cerr << "[libNVDAAL] StagingEngine: no pinned chunk " << i << " of " << config.chunkBytes
+                      << " bytes" << std::endl;
+            break;
+        }
+        slots.push_back(Slot{ mem, CommandBuffer(allocator, 256), Event() });
+        if (!chunk || mem.size < chunk) chunk = mem.size;
+    }
+    // A partial ring still works, just with less overlap
+}
+
+StagingEngine::~StagingEngine() {
+    copies.synchronize(config.timeoutMs);
+    for (Slot& slot : slots) {
+        slot.cb.begin();                         // Unpin before the chunk goes away
+        client->freeSysmem(&slot.mem);
+    }
+}
+
+TransferMethod StagingEngine::choose(const Buffer& buffer, size_t bytes, size_t bar1Max, TransferMethod method) const {
+    if (method != TransferMethod::Auto) return method;
+    if (bytes <= bar1Max || !buffer.gpuAddr() || slots.empty()) return TransferMethod::Bar1;
+    return TransferMethod::CopyEngine;
+}
+
+// Next chunk in the ring, once the GPU has finished its previous copy
+StagingEngine::Slot *StagingEngine::acquire() {
+    Slot& slot = slots[next];
+    next = (next + 1) % (uint32_t)slots.size();
+    if (!slot.done.query()) {
+        counters.chunkWaits++;
+        if (!slot.done.synchronize(config.timeoutMs)) return nullptr;
+    }
+    return &slot;
+}
+
+// Record and submit one chunk copy; `buffer` stays pinned until the slot is reused
+bool StagingEngine::stage(Slot& slot, const Buffer& buffer, uint64_t dstGpuAddr, uint64_t srcGpuAddr, size_t bytes) {
+    slot.cb.begin();
+    if (!slot.cb.use(buffer) || !slot.cb.copy(dstGpuAddr, srcGpuAddr, bytes) || !slot.cb.end() ||
+        !copies.submit(slot.cb)) {
+        return false;
+    }
+    slot.done = copies.record();
+    counters.chunkCopies++;
+    return true;
+}
+
+bool StagingEngine::upload(Buffer& dst, size_t dstOffset, const void *src, size_t bytes, TransferMethod method) {
+    if (!dst || dstOffset > dst.size() || bytes > dst.size() - dstOffset || (!src && bytes)) return false;
+    if (bytes == 0) return true;
+
+    const uint8_t *from = (const uint8_t *)src;
+    if (choose(dst, bytes, config.bar1UploadMax, method) == TransferMethod::Bar1) {
+        uint8_t *to = (uint8_t *)dst.cpu();
+        if (!to || !copies.synchronize(config.timeoutMs)) return false;
+        streamCopy(to + dstOffset, from, bytes);
+        counters.bar1Transfers++;
+    } else {
+        if (!valid() || !dst.gpuAddr()) return false;
+        uint64_t base = dst.gpuAddr() + dstOffset;
+        for (size_t done = 0; done < bytes;) {
+            Slot *slot = acquire();
+            if (!slot) return false;
+            size_t n = bytes - done < slot->mem.size ? bytes - done : slot->mem.size;
+            memcpy(slot->mem.cpu, from + done, n);     // Overlaps the GPU copying the previous chunk
+            if (!stage(*slot, dst, base + done, slot->mem.gpuAddr, n)) return false;
+            done += n;
+        }
+    }
+    counters.uploads++;
+    counters.uploadBytes += bytes;
+    return true;
+}
+
+bool StagingEngine::download(void *dst, Buffer& src, size_t srcOffset, size_t bytes, TransferMethod method) {
+    if (!src || srcOffset > src.size() || bytes > src.size() - srcOffset || (!dst && bytes)) return false;
+    if (bytes == 0) return true;
+
+    uint8_t *to = (uint8_t *)dst;
+    if (choose(src, bytes, config.bar1DownloadMax, method) == TransferMethod::Bar1) {
+        const uint8_t *from = (const uint8_t *)src.cpu();
+        if (!from || !copies.synchronize(config.timeoutMs)) return false;
+        memcpy(to, from + srcOffset, bytes);
+        counters.bar1Transfers++;
+    } else {
+        if (!valid() || !src.gpuAddr()) return false;
+        uint64_t base = src.gpuAddr() + srcOffset;
+        uint32_t ring = (uint32_t)slots.size();
+        uint32_t first = next;
+        size_t count = (bytes + chunk - 1) / chunk;
+
+        // Keep every chunk busy: unpacking chunk i overlaps the copies of
+        // the ones after it, and frees its slot for chunk i + ring
+        auto issue = [&](size_t i) {
+            Slot *slot = acquire();
+            size_t n = bytes - i * chunk < chunk ? bytes - i * chunk : chunk;
+            return slot && stage(*slot, src, slot->mem.gpuAddr, base + i * chunk, n);
+        };
+        for (size_t i = 0; i < count && i < ring; i++) {
+            if (!issue(i)) return false;
+        }
+        for (size_t i = 0; i < count; i++) {
+            Slot& slot = slots[(first + i) % ring];
+            if (!slot.done.query()) {
+                counters.chunkWaits++;
+                if (!slot.done.synchronize(config.timeoutMs)) return false;
+            }
+            size_t n = bytes - i * chunk < chunk ? bytes - i * chunk : chunk;
+            memcpy(to + i * chunk, slot.mem.cpu, n);
+            if (i + ring < count && !issue(i + ring)) return false;
+        }
+    }
+    counters.downloads++;
+    counters.downloadBytes += bytes;
+    return true;
+}
+
+} // namespace nvdaal
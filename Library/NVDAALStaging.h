@@ -0,0 +1,101 @@
+/*
+ * NVDAALStaging.h - Host <-> VRAM Transfers
+ *
+ * StagingEngine moves data between ordinary host memory and Buffers. Large
+ * transfers go through a ring of pinned sysmem chunks (Client::allocSysmem)
+ * and the copy engine, on the engine's own Stream (a copy-engine channel
+ * unless configured otherwise, so transfers overlap compute work): while
+ * the GPU copies one chunk the CPU packs (uploads) or unpacks (downloads)
+ * the next, so the transfer runs at the slower of memcpy and the copy
+ * engine instead of their sum. Small ones skip the round trip and use the
+ * CPU through the BAR1 mapping (Buffer::cpu()), where a write is a few
+ * streaming stores (streamCopy(), NVDAALCopy.h) and nothing has to be
+ * submitted; BAR1 reads are uncached, so only tiny downloads go that way.
+ *
+ *   upload     returns once `src` has been consumed; the copy into the
+ *              Buffer completes in stream order (stream().record())
+ *   download   returns once the data is in `dst`
+ *
+ * Both run after everything already submitted to stream(); use
+ * stream().wait() to order them after other streams. A BAR1 transfer
+ * synchronizes the stream first, so it never races earlier staged copies.
+ * One thread at a time per engine.
+ */
+
+#ifndef LIB_NVDAAL_STAGING_H
+#define LIB_NVDAAL_STAGING_H
+
+#include "NVDAALStream.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace nvdaal {
+
+enum class TransferMethod {
+    Auto,                                        // BAR1 up to the config thresholds, else CopyEngine
+    CopyEngine,                                  // Staged through pinned sysmem, pipelined
+    Bar1                                         // CPU loads/stores through Buffer::cpu()
+};
+
+struct StagingConfig {
+    size_t chunkBytes = 4 << 20;                 // Per pinned chunk (page-rounded)
+    uint32_t chunks = 2;                         // Two is enough to overlap; more absorb jitter
+    size_t bar1UploadMax = 64 << 10;             // Auto: uploads up to this use BAR1
+    size_t bar1DownloadMax = 4 << 10;            // Auto: downloads up to this use BAR1
+    uint32_t channel = kCopyChannel;             // The copy engine's channel, if the driver has one
+    uint32_t timeoutMs = 5000;                   // Per chunk wait
+};
+
+struct StagingStats {
+    uint64_t uploads;
+    uint64_t downloads;
+    uint64_t uploadBytes;
+    uint64_t downloadBytes;
+    uint64_t bar1Transfers;                      // Of the above, through BAR1
+    uint64_t chunkCopies;                        // Copy-engine submissions
+    uint64_t chunkWaits;                         // Host waits for a chunk still in use by the GPU
+};
+
+class StagingEngine {
+public:
+    StagingEngine(Client& client, BufferAllocator& allocator, const StagingConfig& config = StagingConfig());
+    ~StagingEngine();                            // Waits for the stream, frees the chunks
+
+    StagingEngine(const StagingEngine&) = delete;
+    StagingEngine& operator=(const StagingEngine&) = delete;
+
+    bool valid() const { return !slots.empty() && copies.valid(); }
+    Stream& stream() { return copies; }
+
+    // [offset, offset + bytes) must lie inside the Buffer's size()
+    bool upload(Buffer& dst, size_t dstOffset, const void *src, size_t bytes,
+                TransferMethod method = TransferMethod::Auto);
+    bool download(void *dst, Buffer& src, size_t srcOffset, size_t bytes,
+                  TransferMethod method = TransferMethod::Auto);
+
+    StagingStats stats() const { return counters; }
+
+private:
+    struct Slot {
+        Sysmem mem;
+        CommandBuffer cb;                        // The chunk's copy, re-recorded per use
+        Event done;                              // The copy's position on the stream
+    };
+
+    Client *client;
+    StagingConfig config;
+    Stream copies;
+    std::vector<Slot> slots;
+    uint32_t next;                               // Slot the next chunk uses
+    size_t chunk;                                // Download split: the smallest slot (reused sysmem can be larger)
+    StagingStats counters;
+
+    TransferMethod choose(const Buffer& buffer, size_t bytes, size_t bar1Max, TransferMethod method) const;
+    Slot *acquire();
+    bool stage(Slot& slot, const Buffer& buffer, uint64_t dstGpuAddr, uint64_t srcGpuAddr, size_t bytes);
+};
+
+} // namespace nvdaal
+
+#endif // LIB_NVDAAL_STAGING_H
@@ -0,0 +1,148 @@
+/*
+ * NVDAALStream.cpp - Streams and Events
+ */
+
+#include "NVDAALStream.h"
+#include "NVDAALPushbuffer.h"
+#include <atomic>
+#include <cstring>
+#include <iostream>
+
+namespace nvdaal {
+
+static std::atomic<uint32_t> gNextChannel(0);
+
+// ============================================================================
+// Event
+// ============================================================================
+
+bool Event::query() const {
+    if (!value) return true;
+    uint64_t payload = 0;
+    return client && client->readSemaphore(sem, &payload) && payload >= value;
+}
+
+bool Event::synchronize(uint32_t timeoutMs) const {
+    if (!value) return true;
+    return client && client->waitSemaphore(sem, value, timeoutMs);
+}
+
+// ============================================================================
+// Stream
+// ============================================================================
+
+Stream::Stream(Client& c, BufferAllocator& allocator, uint32_t channel)
+    : client(&c), chan(0), sem{ 0, 0 }, value(0), completed(0), nextSlot(0), counters() {
+    uint32_t channels = c.getChannelCount();
+    uint32_t copies = channel != kAnyChannel && (channel & kCopyChannel) ? c.getCopyChannelCount() : 0;
+    if (copies) chan = kCopyChannel | ((channel & ~kCopyChannel) % copies);
+    else chan = (channel == kAnyChannel || (channel & kCopyChannel) ? gNextChannel++ : channel) % channels;
+    memset(slotValue, 0, sizeof(slotValue));
+
+    slots = allocator.allocate(kWaitSlots * kSlotBytes);
+    if (!slots.gpuAddr() || !slots.cpu() || !c.createSemaphore(&sem)) {
+        sem = { 0, 0 };
+        slots.reset();
+    }
+}
+
+Stream::~Stream() {
+    if (!valid()) return;
+    if (!synchronize(5000)) std::cerr << "[libNVDAAL] Stream: work still running at destruction" << std::endl;
+    client->destroySemaphore(sem);
+}
+
+bool Stream::submit(const CommandBuffer& cb) {
+    return cb.ready() && submit(cb.gpuAddr(), cb.sizeBytes());
+}
+
+bool Stream::submit(uint64_t gpuAddr, uint32_t bytes) {
+    if (!valid() || !flushWaits()) return false;
+    if (!client->submitPushbuffer(gpuAddr, bytes, sem, value + 1, chan)) return false;
+    value++;
+    counters.submissions++;
+    return true;
+}
+
+Event Stream::record() {
+    Event event;
+    if (!valid()) return event;
+    flushWaits();                                // The event covers what this stream waits on
+    event.client = client;
+    event.sem = sem;
+    event.value = value;
+    return event;
+}
+
+bool Stream::wait(const Event& event) {
+    counters.waits++;
+    if (!event.recorded() || event.sem.handle == sem.handle) {
+        counters.waitsElided++;                  // Nothing to wait for, or already in order
+        return true;
+    }
+    if (event.client != client) return false;    // Semaphore handles are per client
+
+    for (Wait& w : pending) {
+        if (w.sem.handle == event.sem.handle) {
+            if (event.value > w.value) w.value = event.value;
+            counters.waitsElided++;
+            return true;
+        }
+    }
+    pending.push_back({ event.sem, event.value });
+    return true;
+}
+
+bool Stream::query() {
+    return value <= completed || (client->readSemaphore(sem, &completed) && completed >= value);
+}
+
+bool Stream::synchronize(uint32_t timeoutMs) {
+    if (!valid()) return false;
+    return flushWaits() && reached(value, timeoutMs);
+}
+
+// Emit pending waits as acquires, kSlotAcquires per pushbuffer. Each one
+// advances the timeline too, which is what frees its slot for reuse.
+bool Stream::flushWaits() {
+    static_assert(kSlotAcquires * NV_PB_SEMAPHORE_ACQUIRE_DWORDS * 4 <= kSlotBytes, "Wait slot too small");
+
+    size_t done = 0;
+    while (done < pending.size()) {
+        uint32_t index = nextSlot % kWaitSlots;
+        if (!reached(slotValue[index], 1000, &counters.stalls)) break;
+
+        uint32_t offset = index * kSlotBytes;
+        NvPushbuffer pb;
+        nvPbInit(&pb, (uint8_t *)slots.cpu() + offset, kSlotBytes);
+        uint32_t n = 0;
+        for (; n < kSlotAcquires && done + n < pending.size(); n++) {
+            const Wait& w = pending[done + n];
+            nvPbPushSemaphoreAcquire(&pb, w.sem.gpuAddr, w.value);
+        }
+        uint32_t bytes = (uint32_t)nvPbBytesUsed(&pb);
+        if (!client->submitPushbuffer(slots.gpuAddr() + offset, bytes, sem, value + 1, chan)) break;
+
+        slotValue[index] = ++value;
+        nextSlot++;
+        done += n;
+        counters.acquires += n;
+        counters.waitSubmissions++;
+    }
+    pending.erase(pending.begin(), pending.begin() + done);
+    return pending.empty();
+}
+
+// Ask the driver only when the cached payload isn't enough, and block
+// only when it confirms the timeline hasn't got there
+bool Stream::reached(uint64_t v, uint32_t timeoutMs, uint64_t *stalls) {
+    if (v <= completed) return true;
+    if (!client->readSemaphore(sem, &completed)) return false;
+    if (completed >= v) return true;
+    if (stalls) (*stalls)++;
+    if (!client->waitSemaphore(sem, v, timeoutMs)) return false;
+    completed = v;
+    return true;
+}
+
+} // namespace nvdaal
@@ -0,0 +1,113 @@
+/*
+ * NVDAALStream.h - Streams and Events
+ *
+ * A Stream is an in-order queue of submissions on one driver channel.
+ * Streams on different channels run concurrently, so copies on one can
+ * overlap kernels on another; a stream on a copy-engine channel
+ * (kCopyChannel) moves data without taking compute engine time at all. Each Stream owns a timeline
+ * semaphore that every submission advances; an Event is a point on such
+ * a timeline, and record() costs no driver call.
+ *
+ * wait(event) orders a stream after another stream's event on the GPU:
+ * the next submission is preceded by semaphore acquires and the host
+ * never blocks. Waits are collected until the stream next submits and go
+ * out together as one small pushbuffer; waits the stream already implies
+ * (its own events, or a later point on the same timeline) are dropped.
+ *
+ * Events are queried and waited on from the host with Event::query() and
+ * Event::synchronize(). They refer to their stream's timeline, so keep
+ * the Stream alive while they are in use. The destructor waits for
+ * outstanding work.
+ */
+
+#ifndef LIB_NVDAAL_STREAM_H
+#define LIB_NVDAAL_STREAM_H
+
+#include "NVDAALCommandBuffer.h"
+#include <cstdint>
+#include <vector>
+
+namespace nvdaal {
+
+struct Event {
+    Client *client = nullptr;
+    Semaphore sem = { 0, 0 };                    // Timeline of the recording stream
+    uint64_t value = 0;                          // 0 = nothing recorded: always complete
+
+    bool recorded() const { return value != 0; }
+    bool query() const;                          // Host: has everything before it completed?
+    bool synchronize(uint32_t timeoutMs = 1000) const;
+};
+
+struct StreamStats {
+    uint64_t submissions;                        // Work submitted
+    uint64_t waits;                              // wait() calls
+    uint64_t waitsElided;                        // Already implied: no acquire emitted
+    uint64_t acquires;                           // Semaphore acquires emitted
+    uint64_t waitSubmissions;                    // Pushbuffers carrying them
+    uint64_t stalls;                             // Waits for a free acquire slot
+};
+
+class Stream {
+public:
+    static const uint32_t kAnyChannel = UINT32_MAX;
+
+    // Compute channels are handed out round robin unless one is given; an
+    // index past the channels the driver booted wraps around. kCopyChannel
+    // | n asks for copy-engine channel n, wrapping the same way; without
+    // copy channels the stream gets a compute channel, whose GRCE runs the
+    // same copies.
+    Stream(Client& client, BufferAllocator& allocator, uint32_t channel = kAnyChannel);
+    ~Stream();
+
+    Stream(const Stream&) = delete;
+    Stream& operator=(const Stream&) = delete;
+
+    bool valid() const { return sem.handle != 0; }
+    Client *getClient() const { return client; }
+    uint32_t channel() const { return chan; }
+    bool copyEngine() const { return (chan & kCopyChannel) != 0; }
+    const Semaphore& timeline() const { return sem; }
+    uint64_t submitted() const { return value; }  // Timeline value of the last submission
+
+    // Runs after everything submitted to this stream and every event it waits on
+    bool submit(const CommandBuffer& cb);
+    bool submit(uint64_t gpuAddr, uint32_t bytes);
+
+    Event record();                              // Everything submitted (and waited on) so far
+    bool wait(const Event& event);               // GPU-side; false only for a foreign client
+
+    // Host side, for all work submitted so far
+    bool query();
+    bool synchronize(uint32_t timeoutMs = 1000);
+
+    StreamStats stats() const { return counters; }
+
+private:
+    static const uint32_t kWaitSlots = 64;
+    static const uint32_t kSlotAcquires = 8;     // Per wait pushbuffer
+    static const uint32_t kSlotBytes = 256;      // >= kSlotAcquires acquires
+
+    struct Wait {
+        Semaphore sem;
+        uint64_t value;
+    };
+
+    Client *client;
+    uint32_t chan;
+    Semaphore sem;
+    uint64_t value;                              // Last timeline value submitted
+    uint64_t completed;                          // Timeline payload last seen
+    Buffer slots;                                // Wait pushbuffers, reused round robin
+    uint64_t slotValue[kWaitSlots];              // Timeline value of each slot's last use
+    uint32_t nextSlot;
+    std::vector<Wait> pending;                   // Not yet emitted, one per timeline
+    StreamStats counters;
+
+    bool flushWaits();
+    bool reached(uint64_t v, uint32_t timeoutMs, uint64_t *stalls = nullptr);
+};
+
+} // namespace nvdaal
+
+#endif // LIB_NVDAAL_STREAM_H
@@ -3,13 +3,18 @@
  */
 
 #include "libNVDAAL.h"
-#include <IOKit/IOKitLib.h>
-#include <mach/mach.h>
-#include <fstream>
+#include "NVDAALUserShared.h"
+#include "NVDAALCoalesce.h"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <iostream>
+#include <map>
+#include <mutex>
 
 // Matches UserClient selectors
-#define SERVICE_NAME "NVDAAL"
 #define METHOD_LOAD_FIRMWARE 0
 #define METHOD_ALLOC_VRAM 1
 #define METHOD_SUBMIT_CMD 2
@@ -19,64 +24,140 @@
 #define METHOD_LOAD_BOOTLOADER 6
 #define METHOD_GET_STATUS 7
 #define METHOD_EXECUTE_FWSEC 8
+#define METHOD_CREATE_SEMAPHORE 9
+#define METHOD_DESTROY_SEMAPHORE 10
+#define METHOD_SIGNAL_SEMAPHORE 11
+#define METHOD_READ_SEMAPHORE 12
+#define METHOD_WAIT_SEMAPHORES 13
+#define METHOD_SET_SUBMIT_POLICY 14
+#define METHOD_FLUSH_SUBMISSIONS 15
+#define METHOD_RING_KICK 16
+#define METHOD_REGISTER_NOTIFICATION 17
+#define METHOD_CANCEL_NOTIFICATION 18
+#define METHOD_EXECUTE_BATCH 19
+#define METHOD_GET_STATS 20
+#define METHOD_SUBMIT_PUSHBUFFER 21
 
 namespace nvdaal {
 
-Client::Client() : connection(0), connected(false) {}
+static_assert((uint32_t)OpCode::FreeSysmem == NVDAAL_OP_FREE_SYSMEM, "OpCode out of sync with NVDAAL_OP_*");
+static_assert((uint32_t)Query::CopyChannels == NVDAAL_QUERY_COPY_CHANNELS, "Query out of sync with NVDAAL_QUERY_*");
+static_assert(kCopyChannel == NVDAAL_CHANNEL_COPY, "kCopyChannel out of sync with NVDAAL_CHANNEL_COPY");
+
+// Handlers keyed by the library-side id that travels as the kernel "tag"
+struct Client::NotifyRegistry {
+    struct Entry {
+        uint64_t kernelId;
+        NotifyHandler handler;
+        bool oneShot;
+    };
+
+    std::mutex lock;
+    std::map<uint32_t, Entry> entries;
+    uint32_t nextId = 0;
+};
+
+Client::Client() : connected(false), ring(nullptr), channels(0), copyChannels(UINT32_MAX),
+      notify(new NotifyRegistry) {}
+
+Client::Client(std::unique_ptr<Backend> transport)
+    : backend(std::move(transport)), connected(false), ring(nullptr), channels(0), copyChannels(UINT32_MAX),
+      notify(new NotifyRegistry) {}
 
 Client::~Client() {
     disconnect();
+    delete notify;
 }
 
 bool Client::connect() {
-    if (connected) return true;
+    if (connected.load(std::memory_order_acquire)) return true;
 
-    io_service_t service = IOServiceGetMatchingService(kIOMainPortDefault, IOServiceNameMatching(SERVICE_NAME));
-    if (!service) {
-        std::cerr << "[libNVDAAL] Error: NVDAAL driver service not found." << std::endl;
+    std::lock_guard<std::mutex> guard(connectLock);
+    if (connected.load(std::memory_order_relaxed)) return true;
+
+    if (!backend) backend = makeDefaultBackend();
+    if (!backend) {
+        std::cerr << "[libNVDAAL] Error: no backend available." << std::endl;
         return false;
     }
 
-    kern_return_t kr = IOServiceOpen(service, mach_task_self(), 0, (io_connect_t*)&connection);
-    IOObjectRelease(service);
-
-    if (kr != KERN_SUCCESS) {
-        std::cerr << "[libNVDAAL] Error: IOServiceOpen failed (0x" << std::hex << kr << ")" << std::endl;
+    Status kr = backend->open();
+    if (kr != kStatusSuccess) {
+        std::cerr << "[libNVDAAL] Error: " << backend->name() << " backend failed to open (0x"
+                  << std::hex << kr << ")" << std::dec << std::endl;
         return false;
     }
 
-    connected = true;
+    connected.store(true, std::memory_order_release);
     return true;
 }
 
 void Client::disconnect() {
-    if (connected && connection) {
-        IOServiceClose((io_connect_t)connection);
-        connection = 0;
-        connected = false;
+    std::lock_guard<std::mutex> guard(connectLock);
+    closeCommandRing();
+    if (connected.load(std::memory_order_relaxed)) {
+        backend->close();
+        connected.store(false, std::memory_order_release);
+    }
+    channels.store(0, std::memory_order_relaxed);
+    copyChannels.store(UINT32_MAX, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> sysmemGuard(sysmemLock);
+        sysmem.clear();
     }
-}
 
-bool Client::isConnected() const {
-    return connected;
+    // Registrations die with the connection
+    std::lock_guard<std::mutex> registry(notify->lock);
+    notify->entries.clear();
 }
 
-bool Client::loadFirmware(const std::string& path) {
-    std::ifstream file(path, std::ios::binary | std::ios::ate);
-    if (!file.is_open()) {
-        std::cerr << "[libNVDAAL] Error: Could not open file " << path << std::endl;
-        return false;
+// ============================================================================
+// Firmware Transfer
+// ============================================================================
+
+// Read-only mapping of a firmware file. The driver wires these pages and
+// reads them in place, so the image is never copied onto the heap; the
+// page-aligned mapping also lets the GSP image go to the GPU uncopied.
+struct MappedFile {
+    void *data = nullptr;
+    size_t size = 0;
+
+    MappedFile(const std::string& path, size_t maxSize) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "[libNVDAAL] Error: Could not open file " << path << std::endl;
+            return;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0 && (uint64_t)st.st_size <= maxSize) {
+            void *p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                data = p;
+                size = (size_t)st.st_size;
+            }
+        } else {
+            std::cerr << "[libNVDAAL] Error: " << path << " is empty or larger than "
+                      << maxSize << " bytes" << std::endl;
+        }
+        close(fd);
     }
 
-    std::streamsize size = file.tellg();
-    file.seekg(0, std::ios::beg);
+    ~MappedFile() {
+        if (data) munmap(data, size);
+    }
+};
 
-    if (size <= 0) return false;
+bool Client::isConnected() const {
+    return connected;
+}
 
-    std::vector<uint8_t> buffer(size);
-    if (!file.read((char*)buffer.data(), size)) return false;
+Backend *Client::getBackend() const {
+    return backend.get();
+}
 
-    return loadFirmware(buffer.data(), size);
+bool Client::loadFirmware(const std::string& path) {
+    MappedFile file(path, NVDAAL_MAX_GSP_FIRMWARE_SIZE);
+    return file.data && loadFirmware(file.data, file.size);
 }
 
 bool Client::loadFirmware(const void* data, size_t size) {
@@ -84,18 +165,13 @@ bool Client::loadFirmware(const void* data, size_t size) {
 
     uint64_t args[2] = { (uint64_t)data, (uint64_t)size };
 
-    kern_return_t kr = IOConnectCallScalarMethod(
-        (io_connect_t)connection,
-        METHOD_LOAD_FIRMWARE,
-        args, 2,
-        NULL, NULL
-    );
+    Status kr = backend->callScalar(METHOD_LOAD_FIRMWARE, args, 2);
 
-    if (kr != KERN_SUCCESS) {
+    if (kr != kStatusSuccess) {
         std::cerr << "[libNVDAAL] loadFirmware failed: 0x" << std::hex << kr << std::dec << std::endl;
     }
 
-    return (kr == KERN_SUCCESS);
+    return (kr == kStatusSuccess);
 }
 
 uint64_t Client::allocVram(size_t size) {
@@ -105,137 +181,682 @@ uint64_t Client::allocVram(size_t size) {
     uint64_t output[1] = { 0 };
     uint32_t outputCount = 1;
 
-    kern_return_t kr = IOConnectCallScalarMethod(
-        (io_connect_t)connection,
-        METHOD_ALLOC_VRAM,
-        input, 1,
-        output, &outputCount
-    );
+    Status kr = backend->callScalar(METHOD_ALLOC_VRAM, input, 1, output, &outputCount);
 
-    if (kr != KERN_SUCCESS) return 0;
+    if (kr != kStatusSuccess) return 0;
     return output[0];
 }
 
+void *Client::mapVramCpu(uint64_t offset, CacheMode mode, size_t *size) {
+    if (!connect()) return nullptr;
+
+    MapCache cache = MapCache::WriteCombined;
+    if (mode == CacheMode::Uncached) cache = MapCache::Uncached;
+    else if (mode == CacheMode::Cached) cache = MapCache::Cached;
+
+    void *addr = nullptr;
+    uint64_t mapSize = 0;
+    Status kr = backend->mapMemory(NVDAAL_MEMORY_VRAM(offset), cache, &addr, &mapSize);
+    if (kr != kStatusSuccess) {
+        std::cerr << "[libNVDAAL] Failed to map VRAM offset 0x" << std::hex << offset
+                  << ": 0x" << kr << std::dec << std::endl;
+        return nullptr;
+    }
+
+    if (size) *size = (size_t)mapSize;
+    return addr;
+}
+
+bool Client::unmapVramCpu(uint64_t offset, void *ptr) {
+    if (!connected || !ptr) return false;
+
+    return backend->unmapMemory(NVDAAL_MEMORY_VRAM(offset), ptr) == kStatusSuccess;
+}
+
+bool Client::allocSysmem(size_t size, Sysmem *mem) {
+    if (!mem || !connect()) return false;
+
+    if (size) {
+        std::lock_guard<std::mutex> guard(sysmemLock);
+        SysmemSlot *best = nullptr;
+        for (SysmemSlot& slot : sysmem) {
+            if (slot.spare && slot.mem.size >= size && (!best || slot.mem.size < best->mem.size)) best = &slot;
+        }
+        if (best) {
+            memset(best->mem.cpu, 0, best->mem.size);
+            best->spare = false;
+            *mem = best->mem;
+            return true;
+        }
+    }
+
+    Batch batch;
+    batch.add(Op::allocSysmem(size));
+    if (!execute(batch)) {
+        std::cerr << "[libNVDAAL] allocSysmem(" << size << ") failed: 0x" << std::hex
+                  << batch.result(0).status << std::dec << std::endl;
+        return false;
+    }
+    uint32_t handle = (uint32_t)batch.result(0).values[0];
+
+    void *addr = nullptr;
+    uint64_t mapSize = 0;
+    Status kr = backend->mapMemory(NVDAAL_MEMORY_SYSMEM(handle), MapCache::Cached, &addr, &mapSize);
+    if (kr != kStatusSuccess) {
+        // The driver keeps the allocation until disconnect()
+        std::cerr << "[libNVDAAL] Failed to map sysmem " << handle << ": 0x" << std::hex << kr << std::dec << std::endl;
+        return false;
+    }
+
+    mem->handle = handle;
+    mem->gpuAddr = batch.result(0).values[1];
+    mem->cpu = addr;
+    mem->size = (size_t)mapSize;
+
+    std::lock_guard<std::mutex> guard(sysmemLock);
+    sysmem.push_back(SysmemSlot{ *mem, false });
+    return true;
+}
+
+bool Client::freeSysmem(Sysmem *mem) {
+    if (!connected || !mem || !mem->handle) return false;
+
+    std::lock_guard<std::mutex> guard(sysmemLock);
+    for (SysmemSlot& slot : sysmem) {
+        if (slot.mem.handle != mem->handle) continue;
+        if (slot.spare) return false;                  // Already freed
+        slot.spare = true;
+        *mem = Sysmem();
+        return true;
+    }
+    return false;
+}
+
 bool Client::submitCommand(uint32_t cmd) {
     if (!connect()) return false;
 
     uint64_t input[1] = { (uint64_t)cmd };
 
-    kern_return_t kr = IOConnectCallScalarMethod(
-        (io_connect_t)connection,
-        METHOD_SUBMIT_CMD,
-        input, 1,
-        NULL, NULL
-    );
+    Status kr = backend->callScalar(METHOD_SUBMIT_CMD, input, 1);
 
-    return (kr == KERN_SUCCESS);
+    return (kr == kStatusSuccess);
 }
 
-bool Client::waitSemaphore(uint64_t gpuAddr, uint32_t value) {
+bool Client::submitCommand(uint32_t cmd, const Semaphore& signal, uint64_t value) {
     if (!connect()) return false;
 
-    uint64_t input[2] = { gpuAddr, (uint64_t)value };
+    uint64_t input[3] = { (uint64_t)cmd, signal.handle, value };
 
-    kern_return_t kr = IOConnectCallScalarMethod(
-        (io_connect_t)connection,
-        METHOD_WAIT_SYNC,
-        input, 2,
-        NULL, NULL
-    );
+    Status kr = backend->callScalar(METHOD_SUBMIT_CMD, input, 3);
 
-    return (kr == KERN_SUCCESS);
+    return (kr == kStatusSuccess);
 }
 
-bool Client::loadBootloader(const std::string& path) {
-    std::ifstream file(path, std::ios::binary | std::ios::ate);
-    if (!file.is_open()) {
-        std::cerr << "[libNVDAAL] Error: Could not open file " << path << std::endl;
+bool Client::submitPushbuffer(uint64_t gpuAddr, uint32_t bytes, uint32_t channel) {
+    if (!connect()) return false;
+
+    uint64_t input[2] = { gpuAddr, NVDAAL_PUSHBUFFER_ARG(bytes, channel) };
+
+    Status kr = backend->callScalar(METHOD_SUBMIT_PUSHBUFFER, input, 2);
+
+    return (kr == kStatusSuccess);
+}
+
+bool Client::submitPushbuffer(uint64_t gpuAddr, uint32_t bytes, const Semaphore& signal, uint64_t value,
+                              uint32_t channel) {
+    if (!connect()) return false;
+
+    uint64_t input[4] = { gpuAddr, NVDAAL_PUSHBUFFER_ARG(bytes, channel), signal.handle, value };
+
+    Status kr = backend->callScalar(METHOD_SUBMIT_PUSHBUFFER, input, 4);
+
+    return (kr == kStatusSuccess);
+}
+
+// Threads asking at once may each query; they store the same answer
+uint32_t Client::getChannelCount() {
+    uint32_t cached = channels.load(std::memory_order_relaxed);
+    if (cached) return cached;
+
+    // Drivers from before multiple channels reject the query: they have one
+    Batch batch;
+    batch.query(Query::Channels);
+    if (!execute(batch)) return 1;
+    uint64_t count = batch.result(0).values[0];
+    cached = count < 1 ? 1 : count > NVDAAL_MAX_CHANNELS ? NVDAAL_MAX_CHANNELS : (uint32_t)count;
+    channels.store(cached, std::memory_order_relaxed);
+    return cached;
+}
+
+uint32_t Client::getCopyChannelCount() {
+    uint32_t cached = copyChannels.load(std::memory_order_relaxed);
+    if (cached != UINT32_MAX) return cached;
+
+    // Drivers from before copy channels reject the query: they have none
+    Batch batch;
+    batch.query(Query::CopyChannels);
+    if (!execute(batch)) return 0;
+    uint64_t count = batch.result(0).values[0];
+    cached = count > NVDAAL_MAX_COPY_CHANNELS ? NVDAAL_MAX_COPY_CHANNELS : (uint32_t)count;
+    copyChannels.store(cached, std::memory_order_relaxed);
+    return cached;
+}
+
+bool Client::setSubmitPolicy(const SubmitPolicy& policy) {
+    if (!connect()) return false;
+
+    uint64_t input[4] = {
+        policy.maxEntries,
+        policy.maxBytes,
+        policy.deadlineUs,
+        policy.adaptive ? NV_COALESCE_FLAG_ADAPTIVE : 0u
+    };
+
+    Status kr = backend->callScalar(METHOD_SET_SUBMIT_POLICY, input, 4);
+
+    if (kr != kStatusSuccess) {
+        std::cerr << "[libNVDAAL] Failed to set submit policy: 0x" << std::hex << kr << std::dec << std::endl;
         return false;
     }
+    return true;
+}
+
+bool Client::flushSubmissions() {
+    if (!connect()) return false;
+
+    Status kr = backend->callScalar(METHOD_FLUSH_SUBMISSIONS, nullptr, 0);
+
+    return (kr == kStatusSuccess);
+}
 
-    std::streamsize size = file.tellg();
-    file.seekg(0, std::ios::beg);
+bool Client::waitSemaphore(uint64_t gpuAddr, uint64_t value, uint32_t timeoutMs) {
+    if (!connect()) return false;
 
-    if (size <= 0) return false;
+    uint64_t input[3] = { gpuAddr, value, (uint64_t)timeoutMs };
 
-    std::vector<uint8_t> buffer(size);
-    if (!file.read((char*)buffer.data(), size)) return false;
+    Status kr = backend->callScalar(METHOD_WAIT_SYNC, input, 3);
 
-    return loadBootloader(buffer.data(), size);
+    return (kr == kStatusSuccess);
 }
 
-bool Client::loadBootloader(const void* data, size_t size) {
+bool Client::createSemaphore(Semaphore *sem, uint64_t initialValue) {
+    if (!connect() || !sem) return false;
+
+    uint64_t input[1] = { initialValue };
+    uint64_t output[2] = { 0, 0 };
+    uint32_t outputCount = 2;
+
+    Status kr = backend->callScalar(METHOD_CREATE_SEMAPHORE, input, 1, output, &outputCount);
+
+    if (kr != kStatusSuccess) {
+        std::cerr << "[libNVDAAL] createSemaphore failed: 0x" << std::hex << kr << std::dec << std::endl;
+        return false;
+    }
+
+    sem->handle = (uint32_t)output[0];
+    sem->gpuAddr = output[1];
+    return true;
+}
+
+bool Client::destroySemaphore(const Semaphore& sem) {
     if (!connect()) return false;
 
-    uint64_t args[2] = { (uint64_t)data, (uint64_t)size };
+    uint64_t input[1] = { sem.handle };
 
-    kern_return_t kr = IOConnectCallScalarMethod(
-        (io_connect_t)connection,
-        METHOD_LOAD_BOOTLOADER,
-        args, 2,
-        NULL, NULL
-    );
+    Status kr = backend->callScalar(METHOD_DESTROY_SEMAPHORE, input, 1);
 
-    if (kr != KERN_SUCCESS) {
-        std::cerr << "[libNVDAAL] loadBootloader failed: 0x" << std::hex << kr << std::dec << std::endl;
+    return (kr == kStatusSuccess);
+}
+
+bool Client::signalSemaphore(const Semaphore& sem, uint64_t value) {
+    if (!connect()) return false;
+
+    uint64_t input[2] = { sem.handle, value };
+
+    Status kr = backend->callScalar(METHOD_SIGNAL_SEMAPHORE, input, 2);
+
+    return (kr == kStatusSuccess);
+}
+
+bool Client::readSemaphore(const Semaphore& sem, uint64_t *value) {
+    if (!connect() || !value) return false;
+
+    uint64_t input[1] = { sem.handle };
+    uint64_t output[1] = { 0 };
+    uint32_t outputCount = 1;
+
+    Status kr = backend->callScalar(METHOD_READ_SEMAPHORE, input, 1, output, &outputCount);
+
+    if (kr != kStatusSuccess) return false;
+    *value = output[0];
+    return true;
+}
+
+bool Client::waitSemaphore(const Semaphore& sem, uint64_t value, uint32_t timeoutMs) {
+    return waitSemaphores(&sem, &value, 1, WaitMode::All, timeoutMs);
+}
+
+bool Client::waitSemaphores(const Semaphore *sems, const uint64_t *values, uint32_t count,
+                            WaitMode mode, uint32_t timeoutMs, uint32_t *signaledIndex) {
+    if (!connect() || !sems || !values) return false;
+    if (count == 0 || count > NVDAAL_MAX_WAIT_SEMAPHORES) return false;
+
+    NvdaalSemaphoreWaitArgs args = {};
+    args.count = count;
+    args.flags = (mode == WaitMode::All) ? NVDAAL_WAIT_ALL : NVDAAL_WAIT_ANY;
+    args.timeoutMs = timeoutMs;
+    for (uint32_t i = 0; i < count; i++) {
+        args.entries[i].handle = sems[i].handle;
+        args.entries[i].value = values[i];
     }
 
-    return (kr == KERN_SUCCESS);
+    uint64_t output[1] = { 0 };
+    uint32_t outputCount = 1;
+
+    Status kr = backend->call(
+        METHOD_WAIT_SEMAPHORES,
+        nullptr, 0,
+        &args, NVDAAL_SEMAPHORE_WAIT_ARGS_SIZE(count),
+        output, &outputCount,
+        nullptr, nullptr
+    );
+
+    if (kr != kStatusSuccess) return false;
+    if (signaledIndex) *signaledIndex = (uint32_t)output[0];
+    return true;
 }
 
-bool Client::loadBooterLoad(const std::string& path) {
-    std::ifstream file(path, std::ios::binary | std::ios::ate);
-    if (!file.is_open()) {
-        std::cerr << "[libNVDAAL] Error: Could not open file " << path << std::endl;
+// ============================================================================
+// Command Ring
+// ============================================================================
+
+Op Op::allocVram(size_t size, uint64_t cookie) {
+    Op op; op.code = OpCode::AllocVram; op.cookie = cookie; op.args[0] = size;
+    return op;
+}
+
+Op Op::submitCommand(uint32_t cmd, uint64_t cookie) {
+    Op op; op.code = OpCode::SubmitCommand; op.cookie = cookie; op.args[0] = cmd;
+    return op;
+}
+
+Op Op::submitCommand(uint32_t cmd, const Semaphore& signal, uint64_t value, uint64_t cookie) {
+    Op op; op.code = OpCode::SubmitCommand; op.cookie = cookie;
+    op.args[0] = cmd; op.args[1] = signal.handle; op.args[2] = value;
+    return op;
+}
+
+Op Op::createSemaphore(uint64_t initialValue, uint64_t cookie) {
+    Op op; op.code = OpCode::CreateSemaphore; op.cookie = cookie; op.args[0] = initialValue;
+    return op;
+}
+
+Op Op::destroySemaphore(const Semaphore& sem, uint64_t cookie) {
+    Op op; op.code = OpCode::DestroySemaphore; op.cookie = cookie; op.args[0] = sem.handle;
+    return op;
+}
+
+Op Op::signalSemaphore(const Semaphore& sem, uint64_t value, uint64_t cookie) {
+    Op op; op.code = OpCode::SignalSemaphore; op.cookie = cookie;
+    op.args[0] = sem.handle; op.args[1] = value;
+    return op;
+}
+
+Op Op::readSemaphore(const Semaphore& sem, uint64_t cookie) {
+    Op op; op.code = OpCode::ReadSemaphore; op.cookie = cookie; op.args[0] = sem.handle;
+    return op;
+}
+
+Op Op::waitSemaphore(const Semaphore& sem, uint64_t value, uint32_t timeoutMs, uint64_t cookie) {
+    Op op; op.code = OpCode::WaitSemaphore; op.cookie = cookie;
+    op.args[0] = sem.handle; op.args[1] = value; op.args[2] = timeoutMs;
+    return op;
+}
+
+Op Op::flushSubmissions(uint64_t cookie) {
+    Op op; op.code = OpCode::FlushSubmissions; op.cookie = cookie;
+    return op;
+}
+
+Op Op::query(Query what, uint64_t cookie) {
+    Op op; op.code = OpCode::Query; op.cookie = cookie; op.args[0] = (uint32_t)what;
+    return op;
+}
+
+Op Op::mapVram(uint64_t offset, size_t size, uint64_t cookie) {
+    Op op; op.code = OpCode::MapVram; op.cookie = cookie;
+    op.args[0] = offset; op.args[1] = size;
+    return op;
+}
+
+Op Op::unmapVram(uint64_t gpuAddr, size_t size, uint64_t cookie) {
+    Op op; op.code = OpCode::UnmapVram; op.cookie = cookie;
+    op.args[0] = gpuAddr; op.args[1] = size;
+    return op;
+}
+
+Op Op::submitPushbuffer(uint64_t gpuAddr, uint32_t bytes, uint64_t cookie) {
+    Op op; op.code = OpCode::SubmitPushbuffer; op.cookie = cookie;
+    op.args[0] = gpuAddr; op.args[1] = bytes;
+    return op;
+}
+
+Op Op::submitPushbuffer(uint64_t gpuAddr, uint32_t bytes, const Semaphore& signal, uint64_t value, uint64_t cookie) {
+    Op op; op.code = OpCode::SubmitPushbuffer; op.cookie = cookie;
+    op.args[0] = gpuAddr; op.args[1] = bytes; op.args[2] = signal.handle; op.args[3] = value;
+    return op;
+}
+
+Op Op::allocSysmem(size_t size, uint64_t cookie) {
+    Op op; op.code = OpCode::AllocSysmem; op.cookie = cookie; op.args[0] = size;
+    return op;
+}
+
+Op Op::freeSysmem(uint32_t handle, uint64_t cookie) {
+    Op op; op.code = OpCode::FreeSysmem; op.cookie = cookie; op.args[0] = handle;
+    return op;
+}
+
+bool Client::openCommandRing() {
+    if (ring) return true;
+    if (!connect()) return false;
+
+    void *addr = nullptr;
+    uint64_t size = 0;
+    Status kr = backend->mapMemory(NVDAAL_MEMORY_COMMAND_RING, MapCache::Default, &addr, &size);
+    if (kr != kStatusSuccess) {
+        std::cerr << "[libNVDAAL] Failed to map command ring: 0x" << std::hex << kr << std::dec << std::endl;
+        return false;
+    }
+
+    NvdaalRingControl *ctl = (NvdaalRingControl *)addr;
+    if (size < NVDAAL_RING_SIZE || !nvRingValid(ctl)) {
+        std::cerr << "[libNVDAAL] Command ring layout mismatch (driver/library out of date?)" << std::endl;
+        backend->unmapMemory(NVDAAL_MEMORY_COMMAND_RING, addr);
         return false;
     }
 
-    std::streamsize size = file.tellg();
-    file.seekg(0, std::ios::beg);
+    ring = ctl;
+    return true;
+}
 
-    if (size <= 0) return false;
+void Client::closeCommandRing() {
+    if (!ring) return;
+    backend->unmapMemory(NVDAAL_MEMORY_COMMAND_RING, ring);
+    ring = nullptr;
+}
 
-    std::vector<uint8_t> buffer(size);
-    if (!file.read((char*)buffer.data(), size)) return false;
+bool Client::enqueue(const Op& op) {
+    if (!ring) return false;
 
-    return loadBooterLoad(buffer.data(), size);
+    NvdaalOpRequest req = {};
+    req.op = (uint32_t)op.code;
+    req.cookie = op.cookie;
+    for (int i = 0; i < 4; i++) req.args[i] = op.args[i];
+    return nvRingPushRequest((NvdaalRingControl *)ring, &req);
 }
 
-bool Client::loadBooterLoad(const void* data, size_t size) {
+uint32_t Client::kick() {
+    if (!ring || nvRingPendingRequests((NvdaalRingControl *)ring) == 0) return 0;
+
+    uint64_t output[1] = { 0 };
+    uint32_t outputCount = 1;
+
+    Status kr = backend->callScalar(METHOD_RING_KICK, nullptr, 0, output, &outputCount);
+
+    if (kr != kStatusSuccess) {
+        std::cerr << "[libNVDAAL] Command ring kick failed: 0x" << std::hex << kr << std::dec << std::endl;
+        return 0;
+    }
+    return (uint32_t)output[0];
+}
+
+uint32_t Client::reap(OpResult *results, uint32_t maxResults) {
+    if (!ring || !results) return 0;
+
+    uint32_t n = 0;
+    NvdaalOpCompletion cpl;
+    while (n < maxResults && nvRingPopCompletion((NvdaalRingControl *)ring, &cpl)) {
+        results[n].cookie = cpl.cookie;
+        results[n].code = (OpCode)cpl.op;
+        results[n].status = cpl.status;
+        results[n].values[0] = cpl.result[0];
+        results[n].values[1] = cpl.result[1];
+        n++;
+    }
+    return n;
+}
+
+bool Client::execute(const Op *ops, uint32_t count, OpResult *results) {
+    if (!ops || !results || !openCommandRing()) return false;
+
+    // Queue as much as fits, let the kernel drain it, collect, repeat
+    uint32_t queued = 0;
+    uint32_t reaped = 0;
+    while (reaped < count) {
+        while (queued < count && enqueue(ops[queued])) queued++;
+        uint32_t processed = kick();
+        uint32_t got = reap(results + reaped, count - reaped);
+        reaped += got;
+        if (processed == 0 && got == 0) return false;  // Kernel made no progress
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (!results[i].ok()) return false;
+    }
+    return true;
+}
+
+// ============================================================================
+// Batched Calls
+// ============================================================================
+
+uint32_t Batch::add(const Op& op) {
+    ops.push_back(op);
+    return (uint32_t)ops.size() - 1;
+}
+
+void Batch::clear() {
+    ops.clear();
+    results.clear();
+}
+
+bool Client::execute(Batch& batch, bool stopOnError) {
     if (!connect()) return false;
 
-    uint64_t args[2] = { (uint64_t)data, (uint64_t)size };
+    uint32_t total = batch.size();
+    batch.results.assign(total, OpResult{ 0, OpCode::Nop, kStatusNotReady, { 0, 0 } });
+    batch.wire.resize(NVDAAL_BATCH_INPUT_SIZE(NVDAAL_MAX_BATCH_OPS));
+    std::vector<NvdaalOpCompletion> out(total < NVDAAL_MAX_BATCH_OPS ? total : NVDAAL_MAX_BATCH_OPS);
+
+    bool allOk = true;
+    for (uint32_t base = 0; base < total; base += NVDAAL_MAX_BATCH_OPS) {
+        uint32_t count = total - base < NVDAAL_MAX_BATCH_OPS ? total - base : NVDAAL_MAX_BATCH_OPS;
+
+        NvdaalBatchHeader *hdr = (NvdaalBatchHeader *)batch.wire.data();
+        hdr->count = count;
+        hdr->flags = stopOnError ? NVDAAL_BATCH_STOP_ON_ERROR : 0;
+        hdr->reserved = 0;
+        NvdaalOpRequest *reqs = (NvdaalOpRequest *)(batch.wire.data() + sizeof(NvdaalBatchHeader));
+        for (uint32_t i = 0; i < count; i++) {
+            const Op& op = batch.ops[base + i];
+            reqs[i].op = (uint32_t)op.code;
+            reqs[i].flags = 0;
+            reqs[i].cookie = op.cookie;
+            for (int a = 0; a < 4; a++) reqs[i].args[a] = op.args[a];
+        }
+
+        uint64_t output[1] = { 0 };
+        uint32_t outputCount = 1;
+        size_t outSize = NVDAAL_BATCH_OUTPUT_SIZE(count);
+
+        Status kr = backend->call(
+            METHOD_EXECUTE_BATCH,
+            nullptr, 0,
+            batch.wire.data(), NVDAAL_BATCH_INPUT_SIZE(count),
+            output, &outputCount,
+            out.data(), &outSize
+        );
+        if (kr != kStatusSuccess) {
+            std::cerr << "[libNVDAAL] ExecuteBatch failed: 0x" << std::hex << kr << std::dec << std::endl;
+            return false;
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+            OpResult& r = batch.results[base + i];
+            r.cookie = out[i].cookie;
+            r.code = (OpCode)out[i].op;
+            r.status = out[i].status;
+            r.values[0] = out[i].result[0];
+            r.values[1] = out[i].result[1];
+            if (!r.ok()) allOk = false;
+        }
+        if (!allOk && stopOnError) return false;
+    }
+    return allOk;
+}
+
+// ============================================================================
+// Async Notifications
+// ============================================================================
+
+void *Client::notificationRunLoopSource() {
+    if (!connect()) return nullptr;
+    return backend->notificationRunLoopSource();
+}
+
+bool Client::setNotificationQueue(void *dispatchQueue) {
+    if (!connect()) return false;
+    return backend->setNotificationQueue(dispatchQueue);
+}
+
+void Client::notificationCallback(void *refcon, int result, void **args, uint32_t numArgs) {
+    Client *self = static_cast<Client *>(refcon);
+    if (!self || numArgs < NVDAAL_NOTIFY_ARG_COUNT) return;
+
+    Notification n;
+    n.id = (uint32_t)(uintptr_t)args[NVDAAL_NOTIFY_ARG_TAG];
+    n.kind = (NotifyKind)(uintptr_t)args[NVDAAL_NOTIFY_ARG_KIND];
+    n.status = result;
+    n.values[0] = (uint64_t)(uintptr_t)args[NVDAAL_NOTIFY_ARG_VALUE0];
+    n.values[1] = (uint64_t)(uintptr_t)args[NVDAAL_NOTIFY_ARG_VALUE1];
+
+    // Run the handler unlocked so it may register or cancel notifications
+    NotifyHandler handler;
+    {
+        std::lock_guard<std::mutex> guard(self->notify->lock);
+        auto it = self->notify->entries.find(n.id);
+        if (it == self->notify->entries.end()) return;  // Cancelled while in flight
+        handler = it->second.handler;
+        if (it->second.oneShot) self->notify->entries.erase(it);
+    }
+    handler(n);
+}
 
-    kern_return_t kr = IOConnectCallScalarMethod(
-        (io_connect_t)connection,
-        METHOD_LOAD_BOOTER,
-        args, 2,
-        NULL, NULL
+uint32_t Client::registerNotification(uint32_t kind, uint64_t arg0, uint64_t arg1,
+                                      NotifyHandler handler, bool oneShot) {
+    if (!handler || !connect()) return 0;
+
+    // Install the handler first: an already-signaled semaphore fires at once
+    uint32_t id;
+    {
+        std::lock_guard<std::mutex> guard(notify->lock);
+        do { id = ++notify->nextId; } while (id == 0 || notify->entries.count(id));
+        notify->entries[id] = { 0, std::move(handler), oneShot };
+    }
+
+    uint64_t input[4] = { kind, arg0, arg1, id };
+    uint64_t output[1] = { 0 };
+    uint32_t outputCount = 1;
+
+    Status kr = backend->callAsync(
+        METHOD_REGISTER_NOTIFICATION,
+        &Client::notificationCallback, this,
+        input, 4,
+        output, &outputCount
     );
 
-    if (kr != KERN_SUCCESS) {
-        std::cerr << "[libNVDAAL] loadBooterLoad failed: 0x" << std::hex << kr << std::dec << std::endl;
+    std::lock_guard<std::mutex> guard(notify->lock);
+    if (kr != kStatusSuccess) {
+        notify->entries.erase(id);
+        std::cerr << "[libNVDAAL] Failed to register notification: 0x" << std::hex << kr << std::dec << std::endl;
+        return 0;
     }
+    auto it = notify->entries.find(id);
+    if (it != notify->entries.end()) it->second.kernelId = output[0];
+    return id;
+}
 
-    return (kr == KERN_SUCCESS);
+uint32_t Client::notifyOnSemaphore(const Semaphore& sem, uint64_t value, NotifyHandler handler) {
+    return registerNotification(NVDAAL_NOTIFY_SEMAPHORE, sem.handle, value, std::move(handler), true);
 }
 
-bool Client::loadVbios(const std::string& path) {
-    std::ifstream file(path, std::ios::binary | std::ios::ate);
-    if (!file.is_open()) {
-        std::cerr << "[libNVDAAL] Error: Could not open file " << path << std::endl;
-        return false;
+uint32_t Client::notifyOnChannelError(NotifyHandler handler) {
+    return registerNotification(NVDAAL_NOTIFY_CHANNEL_ERROR, 0, 0, std::move(handler), false);
+}
+
+uint32_t Client::notifyOnGspEvent(uint32_t rpcFunction, NotifyHandler handler) {
+    return registerNotification(NVDAAL_NOTIFY_GSP_EVENT, rpcFunction, 0, std::move(handler), false);
+}
+
+bool Client::cancelNotification(uint32_t id) {
+    uint64_t kernelId;
+    {
+        std::lock_guard<std::mutex> guard(notify->lock);
+        auto it = notify->entries.find(id);
+        if (it == notify->entries.end()) return false;
+        kernelId = it->second.kernelId;
+        notify->entries.erase(it);
     }
+    if (!connected) return true;
+
+    // A one-shot that already fired in the kernel reports NotFound; either way it is gone
+    uint64_t input[1] = { kernelId };
+    backend->callScalar(METHOD_CANCEL_NOTIFICATION, input, 1);
+    return true;
+}
+
+bool Client::loadBootloader(const std::string& path) {
+    MappedFile file(path, NVDAAL_MAX_BOOTLOADER_SIZE);
+    return file.data && loadBootloader(file.data, file.size);
+}
+
+bool Client::loadBootloader(const void* data, size_t size) {
+    if (!connect()) return false;
 
-    std::streamsize size = file.tellg();
-    file.seekg(0, std::ios::beg);
+    uint64_t args[2] = { (uint64_t)data, (uint64_t)size };
+
+    Status kr = backend->callScalar(METHOD_LOAD_BOOTLOADER, args, 2);
 
-    if (size <= 0) return false;
+    if (kr != kStatusSuccess) {
+        std::cerr << "[libNVDAAL] loadBootloader failed: 0x" << std::hex << kr << std::dec << std::endl;
+    }
 
-    std::vector<uint8_t> buffer(size);
-    if (!file.read((char*)buffer.data(), size)) return false;
+    return (kr == kStatusSuccess);
+}
 
-    return loadVbios(buffer.data(), size);
+bool Client::loadBooterLoad(const std::string& path) {
+    MappedFile file(path, NVDAAL_MAX_BOOTER_LOAD_SIZE);
+    return file.data && loadBooterLoad(file.data, file.size);
+}
+
+bool Client::loadBooterLoad(const void* data, size_t size) {
+    if (!connect()) return false;
+
+    uint64_t args[2] = { (uint64_t)data, (uint64_t)size };
+
+    Status kr = backend->callScalar(METHOD_LOAD_BOOTER, args, 2);
+
+    if (kr != kStatusSuccess) {
+        std::cerr << "[libNVDAAL] loadBooterLoad failed: 0x" << std::hex << kr << std::dec << std::endl;
+    }
+
+    return (kr == kStatusSuccess);
+}
+
+bool Client::loadVbios(const std::string& path) {
+    MappedFile file(path, NVDAAL_MAX_VBIOS_SIZE);
+    return file.data && loadVbios(file.data, file.size);
 }
 
 bool Client::loadVbios(const void* data, size_t size) {
@@ -243,18 +864,13 @@ bool Client::loadVbios(const void* data, size_t size) {
 
     uint64_t args[2] = { (uint64_t)data, (uint64_t)size };
 
-    kern_return_t kr = IOConnectCallScalarMethod(
-        (io_connect_t)connection,
-        METHOD_LOAD_VBIOS,
-        args, 2,
-        NULL, NULL
-    );
+    Status kr = backend->callScalar(METHOD_LOAD_VBIOS, args, 2);
 
-    if (kr != KERN_SUCCESS) {
+    if (kr != kStatusSuccess) {
         std::cerr << "[libNVDAAL] loadVbios failed: 0x" << std::hex << kr << std::dec << std::endl;
     }
 
-    return (kr == KERN_SUCCESS);
+    return (kr == kStatusSuccess);
 }
 
 bool Client::executeFwsec() {
@@ -263,14 +879,9 @@ bool Client::executeFwsec() {
     uint64_t output[1] = {0};
     uint32_t outputCount = 1;
 
-    kern_return_t kr = IOConnectCallScalarMethod(
-        (io_connect_t)connection,
-        METHOD_EXECUTE_FWSEC,
-        NULL, 0,           // No input
-        output, &outputCount
-    );
+    Status kr = backend->callScalar(METHOD_EXECUTE_FWSEC, nullptr, 0, output, &outputCount);
 
-    if (kr != KERN_SUCCESS) {
+    if (kr != kStatusSuccess) {
         std::cerr << "[libNVDAAL] executeFwsec failed: 0x" << std::hex << kr << std::dec << std::endl;
         return false;
     }
@@ -278,20 +889,62 @@ bool Client::executeFwsec() {
     return (output[0] == 1);
 }
 
+static_assert(sizeof(MethodStats::histogram) == sizeof(NvdaalSelectorStats::histogram),
+              "MethodStats out of sync with NvdaalSelectorStats");
+
+uint64_t MethodStats::percentileUs(uint32_t perMille) const {
+    NvdaalSelectorStats s = { calls, errors, totalNs, maxNs, {} };
+    memcpy(s.histogram, histogram, sizeof(s.histogram));
+    return nvStatsPercentileUs(&s, perMille);
+}
+
+bool Client::getStats(CallStats *stats, StatsScope scope, bool reset) {
+    if (!connect() || !stats) return false;
+
+    uint64_t input[2] = {
+        scope == StatsScope::Global ? (uint64_t)NVDAAL_STATS_SCOPE_GLOBAL : (uint64_t)NVDAAL_STATS_SCOPE_CLIENT,
+        reset ? (uint64_t)NVDAAL_STATS_RESET : 0
+    };
+    NvdaalStats raw;
+    size_t rawSize = sizeof(raw);
+
+    Status kr = backend->call(
+        METHOD_GET_STATS,
+        input, 2,
+        nullptr, 0,
+        nullptr, nullptr,
+        &raw, &rawSize
+    );
+    if (kr != kStatusSuccess || rawSize < sizeof(raw) || raw.version != NVDAAL_STATS_VERSION ||
+        raw.selectorCount > NVDAAL_STATS_MAX_SELECTORS) {
+        std::cerr << "[libNVDAAL] getStats failed: 0x" << std::hex << kr << std::dec << std::endl;
+        return false;
+    }
+
+    stats->sinceNs = raw.sinceNs;
+    stats->methods.resize(raw.selectorCount);
+    for (uint32_t i = 0; i < raw.selectorCount; i++) {
+        const NvdaalSelectorStats& r = raw.selectors[i];
+        MethodStats& m = stats->methods[i];
+        m.name = nvdaalMethodName(i);
+        m.calls = r.calls;
+        m.errors = r.errors;
+        m.totalNs = r.totalNs;
+        m.maxNs = r.maxNs;
+        memcpy(m.histogram, r.histogram, sizeof(m.histogram));
+    }
+    return true;
+}
+
 bool Client::getStatus(GpuStatus *status) {
     if (!connect() || !status) return false;
 
     uint64_t output[9] = {0};
     uint32_t outputCount = 9;
 
-    kern_return_t kr = IOConnectCallScalarMethod(
-        (io_connect_t)connection,
-        METHOD_GET_STATUS,
-        NULL, 0,           // No input
-        output, &outputCount
-    );
+    Status kr = backend->callScalar(METHOD_GET_STATUS, nullptr, 0, output, &outputCount);
 
-    if (kr != KERN_SUCCESS) {
+    if (kr != kStatusSuccess) {
         std::cerr << "[libNVDAAL] getStatus failed: 0x" << std::hex << kr << std::dec << std::endl;
         return false;
     }
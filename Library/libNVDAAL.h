@@ -3,18 +3,26 @@
  *
  * Provides a high-level C++ API to interact with the NVIDIA RTX 4090
  * on macOS. Handles connection, memory management, and command submission.
+ * The driver transport is pluggable (NVDAALBackend.h); the simulator
+ * backend runs everything here without a GPU.
  */
 
 #ifndef LIB_NVDAAL_H
 #define LIB_NVDAAL_H
 
+#include <atomic>
 #include <cstdint>
 #include <vector>
 #include <string>
 #include <memory>
+#include <mutex>
+#include <functional>
+#include "NVDAALBackend.h"
 
 namespace nvdaal {
 
+class CommandBuffer;
+
 // GPU Status structure (matches NVDAAL::GpuStatus in kernel)
 struct GpuStatus {
     uint32_t pmcBoot0;           // Chip ID
@@ -28,17 +36,190 @@ struct GpuStatus {
     uint32_t bootScratch;        // Boot stage scratch register
 };
 
+// Timeline semaphore (64-bit payload, only ever increases)
+struct Semaphore {
+    uint32_t handle;             // Driver handle (0 = invalid)
+    uint64_t gpuAddr;            // GPU VA of the payload, for pushbuffer release/acquire
+};
+
+enum class WaitMode {
+    Any,                         // Return when any semaphore reaches its value
+    All                          // Return when every semaphore reaches its value
+};
+
+// Pinned host memory the GPU reads and writes directly (see NVDAAL_MEMORY_SYSMEM)
+struct Sysmem {
+    uint32_t handle;             // Driver handle (0 = invalid)
+    uint64_t gpuAddr;            // GPU VA, usable as a copy source or destination
+    void *cpu;                   // Cached mapping in this process
+    size_t size;                 // Page-rounded
+};
+
+// CPU caching for VRAM mapped into the process (see NVDAAL_MEMORY_VRAM)
+enum class CacheMode {
+    WriteCombined,               // Uploads: streaming writes, slow reads
+    Uncached,                    // Readback that must see GPU writes
+    Cached                       // Fast repeated reads; not coherent with later GPU writes
+};
+
+// Per-selector driver call statistics (matches NvdaalSelectorStats)
+enum class StatsScope {
+    Client,                      // Calls made through this Client
+    Global                       // Every client of the driver
+};
+
+struct MethodStats {
+    const char *name;
+    uint64_t calls;
+    uint64_t errors;
+    uint64_t totalNs;            // Wall time in the driver, including blocking
+    uint64_t maxNs;
+    uint64_t histogram[16];      // <1us, then power-of-two microsecond buckets
+
+    double meanUs() const { return calls ? totalNs / 1000.0 / calls : 0.0; }
+    uint64_t percentileUs(uint32_t perMille) const;  // Bucket upper bound
+};
+
+struct CallStats {
+    uint64_t sinceNs;            // Driver uptime when counting started
+    std::vector<MethodStats> methods;  // Indexed by selector
+};
+
+// Doorbell coalescing for submitCommand (matches NvCoalescePolicy in kernel).
+// Submissions are queued to the GPU immediately but published in batches;
+// waits and flushSubmissions() always publish everything pending.
+struct SubmitPolicy {
+    uint32_t maxEntries = 1;     // Submissions per doorbell (<= 1 = ring every time)
+    uint32_t maxBytes = 0;       // Pushbuffer bytes per doorbell (0 = no limit)
+    uint32_t deadlineUs = 0;     // Max time a submission may be held (0 = none)
+    bool adaptive = false;       // Stop holding when traffic is too sparse to batch
+};
+
+// Small driver operations that can be queued on the command ring
+// (values match NVDAAL_OP_* in NVDAALUserShared.h)
+enum class OpCode : uint32_t {
+    Nop = 0,
+    AllocVram,                   // args: size                 -> values: offset
+    SubmitCommand,               // args: cmd, signal handle, value (handle 0 = none)
+    CreateSemaphore,             // args: initial              -> values: handle, gpuAddr
+    DestroySemaphore,            // args: handle
+    SignalSemaphore,             // args: handle, value
+    ReadSemaphore,               // args: handle               -> values: value
+    WaitSemaphore,               // args: handle, value, timeoutMs
+    FlushSubmissions,
+    Query,                       // args: Query                -> values: see Query
+    MapVram,                     // args: offset, size         -> values: gpuAddr
+    UnmapVram,                   // args: gpuAddr, size
+    SubmitPushbuffer,            // args: gpuAddr, bytes, signal handle, value (handle 0 = none)
+    AllocSysmem,                 // args: size                 -> values: handle, gpuAddr
+    FreeSysmem                   // args: handle (refused: sysmem lives until the driver unloads)
+};
+
+enum class Query : uint32_t {
+    ChipId = 0,                  // values: PMC_BOOT_0
+    Wpr2,                        // values: (hi << 32) | lo, enabled
+    GspState,                    // values: GSP RISC-V CPUCTL, boot scratch
+    Channels,                    // values: compute channels booted
+    CopyChannels                 // values: copy-engine channels booted
+};
+
+// submitPushbuffer() channel flag: kCopyChannel | n is copy-engine channel n
+static const uint32_t kCopyChannel = 0x80;
+
+struct Op {
+    OpCode code = OpCode::Nop;
+    uint64_t cookie = 0;         // Returned unchanged in OpResult
+    uint64_t args[4] = {};
+
+    static Op allocVram(size_t size, uint64_t cookie = 0);
+    static Op submitCommand(uint32_t cmd, uint64_t cookie = 0);
+    static Op submitCommand(uint32_t cmd, const Semaphore& signal, uint64_t value, uint64_t cookie = 0);
+    static Op createSemaphore(uint64_t initialValue, uint64_t cookie = 0);
+    static Op destroySemaphore(const Semaphore& sem, uint64_t cookie = 0);
+    static Op signalSemaphore(const Semaphore& sem, uint64_t value, uint64_t cookie = 0);
+    static Op readSemaphore(const Semaphore& sem, uint64_t cookie = 0);
+    static Op waitSemaphore(const Semaphore& sem, uint64_t value, uint32_t timeoutMs, uint64_t cookie = 0);
+    static Op flushSubmissions(uint64_t cookie = 0);
+    static Op query(Query what, uint64_t cookie = 0);
+    static Op mapVram(uint64_t offset, size_t size, uint64_t cookie = 0);
+    static Op unmapVram(uint64_t gpuAddr, size_t size, uint64_t cookie = 0);
+    static Op submitPushbuffer(uint64_t gpuAddr, uint32_t bytes, uint64_t cookie = 0);
+    static Op submitPushbuffer(uint64_t gpuAddr, uint32_t bytes, const Semaphore& signal, uint64_t value,
+                               uint64_t cookie = 0);
+    static Op allocSysmem(size_t size, uint64_t cookie = 0);
+    static Op freeSysmem(uint32_t handle, uint64_t cookie = 0);
+};
+
+struct OpResult {
+    uint64_t cookie;
+    OpCode code;
+    int32_t status;              // kern_return_t / IOReturn, 0 = success
+    uint64_t values[2];
+
+    bool ok() const { return status == 0; }
+};
+
+// Async notifications (values match NVDAAL_NOTIFY_* in NVDAALUserShared.h)
+enum class NotifyKind : uint32_t {
+    Semaphore = 1,               // One-shot: payload reached the value
+    ChannelError = 2,            // values: PMC interrupt status
+    GspEvent = 3                 // values: RPC event function, RPC result
+};
+
+struct Notification {
+    uint32_t id;                 // As returned by notifyOn*()
+    NotifyKind kind;
+    int32_t status;              // 0 = success; semaphore destroyed -> kIOReturnNotFound
+    uint64_t values[2];          // Semaphore: payload
+};
+
+using NotifyHandler = std::function<void(const Notification&)>;
+
+// Ops executed by one ExecuteBatch call (chunks of up to 1024), in order,
+// each with its own result. Reusable: clear() keeps the storage.
+class Batch {
+public:
+    uint32_t add(const Op& op);                        // Returns the op's index
+    uint32_t allocVram(size_t size) { return add(Op::allocVram(size)); }
+    uint32_t mapVram(uint64_t offset, size_t size) { return add(Op::mapVram(offset, size)); }
+    uint32_t submitCommand(uint32_t cmd) { return add(Op::submitCommand(cmd)); }
+    uint32_t signalSemaphore(const Semaphore& sem, uint64_t value) { return add(Op::signalSemaphore(sem, value)); }
+    uint32_t query(Query what) { return add(Op::query(what)); }
+
+    void clear();
+    uint32_t size() const { return (uint32_t)ops.size(); }
+    const OpResult& result(uint32_t index) const { return results[index]; }
+
+private:
+    friend class Client;
+    std::vector<Op> ops;
+    std::vector<OpResult> results;
+    std::vector<uint8_t> wire;                         // Marshalling scratch, reused
+};
+
+// A Client is one connection to the driver: its own semaphores, sysmem
+// and notification registrations. A process may hold any number of them.
+// A Client is thread-safe: once connected, threads call it concurrently
+// without taking a library lock (connect() is a single atomic load), and
+// the driver serialises only what touches shared GPU state. The command
+// ring and disconnect() are the exceptions, noted below. Context
+// (NVDAALContext.h) adds per-thread streams on top.
 class Client {
 public:
-    Client();
+    Client();                                          // makeDefaultBackend() on connect
+    explicit Client(std::unique_ptr<Backend> backend);
     ~Client();
 
-    // Connection
+    // Connection. connect() may race with itself; disconnect() only with
+    // no other call in flight.
     bool connect();
     void disconnect();
     bool isConnected() const;
+    Backend *getBackend() const;                       // nullptr until connect() picks one
 
-    // GSP Management
+    // GSP Management. Firmware buffers are read in place by the driver:
+    // keep them unchanged until the call returns, then they may be freed.
+    // Path overloads map the file instead of reading it into memory.
     bool loadFirmware(const std::string& path);
     bool loadFirmware(const void* data, size_t size);
 
@@ -53,21 +234,106 @@ public:
     // FWSEC execution
     bool executeFwsec();  // Execute FWSEC-FRTS to configure WPR2
 
-    // Memory Management
+    // Memory Management. allocVram is permanent (the driver has no free);
+    // BufferAllocator (NVDAALBuffer.h) sub-allocates and recycles instead.
     uint64_t allocVram(size_t size);
     bool submitCommand(uint32_t cmd);
-    bool waitSemaphore(uint64_t gpuAddr, uint32_t value);
+    // The GPU releases `signal` to `value` once it has executed `cmd`
+    bool submitCommand(uint32_t cmd, const Semaphore& signal, uint64_t value);
+
+    // Run a pushbuffer already in VRAM. It must lie inside a MapVram'd range
+    // and stay unchanged until the GPU has executed it. Each channel runs its
+    // submissions in order, independently of the others (Stream, NVDAALStream.h).
+    bool submitPushbuffer(uint64_t gpuAddr, uint32_t bytes, uint32_t channel = 0);
+    bool submitPushbuffer(uint64_t gpuAddr, uint32_t bytes, const Semaphore& signal, uint64_t value,
+                          uint32_t channel = 0);
+    uint32_t getChannelCount();                        // Compute channels the driver booted (>= 1)
+    uint32_t getCopyChannelCount();                    // Copy-engine channels; 0 = copy on compute channels
+
+    // Command buffers (NVDAALCommandBuffer.h); false if `cb` is not finished
+    // or a buffer it references was freed
+    bool submit(const CommandBuffer& cb);
+    bool submit(const CommandBuffer& cb, const Semaphore& signal, uint64_t value);
+
+    // Zero-copy CPU access: map a whole allocation (by the offset allocVram
+    // returned) through the BAR1 aperture. Uploads are a plain memcpy.
+    void *mapVramCpu(uint64_t offset, CacheMode mode = CacheMode::WriteCombined, size_t *size = nullptr);
+    bool unmapVramCpu(uint64_t offset, void *ptr);
+
+    // Pinned system memory: zeroed, wired host pages mapped for both the GPU
+    // and this process. Copy engines stream to and from it at PCIe rate,
+    // unlike CPU reads through BAR1. The driver never frees sysmem (see
+    // NVDAAL_OP_FREE_SYSMEM): freeSysmem() gives an allocation back to this
+    // Client, whose allocSysmem() reuses the smallest one that fits, zeroed
+    // again. Free only what no submitted work still uses.
+    bool allocSysmem(size_t size, Sysmem *mem);
+    bool freeSysmem(Sysmem *mem);
+
+    // Submission Coalescing
+    bool setSubmitPolicy(const SubmitPolicy& policy);
+    bool flushSubmissions();
+
+    // Timeline Semaphores
+    bool createSemaphore(Semaphore *sem, uint64_t initialValue = 0);
+    bool destroySemaphore(const Semaphore& sem);
+    bool signalSemaphore(const Semaphore& sem, uint64_t value);  // Host-side release
+    bool readSemaphore(const Semaphore& sem, uint64_t *value);
+    bool waitSemaphore(const Semaphore& sem, uint64_t value, uint32_t timeoutMs = 1000);
+    bool waitSemaphores(const Semaphore *sems, const uint64_t *values, uint32_t count,
+                        WaitMode mode, uint32_t timeoutMs, uint32_t *signaledIndex = nullptr);
+    bool waitSemaphore(uint64_t gpuAddr, uint64_t value, uint32_t timeoutMs = 1000);
+
+    // Command Ring: ops are queued in memory shared with the driver and a
+    // single kick() runs everything queued in one kernel entry. Results come
+    // back in queue order. The ring is one per Client and not thread-safe:
+    // one thread at a time uses it; others use execute(Batch&).
+    bool openCommandRing();
+    void closeCommandRing();
+    bool enqueue(const Op& op);                        // false if the ring is full
+    uint32_t kick();                                   // Returns ops processed
+    uint32_t reap(OpResult *results, uint32_t maxResults);
+    bool execute(const Op *ops, uint32_t count, OpResult *results);  // enqueue + kick + reap
+
+    // Batched Calls: one syscall per 1024 ops without mapping the ring.
+    // Returns true if every op succeeded; per-op results are in the batch.
+    bool execute(Batch& batch, bool stopOnError = false);
+
+    // Async Notifications. Handlers run wherever the notification port is
+    // serviced: add notificationRunLoopSource() to a CFRunLoop or call
+    // setNotificationQueue() with a dispatch queue before registering.
+    // The simulator backend runs them on its own thread instead.
+    void *notificationRunLoopSource();                 // CFRunLoopSourceRef
+    bool setNotificationQueue(void *dispatchQueue);    // dispatch_queue_t
+    uint32_t notifyOnSemaphore(const Semaphore& sem, uint64_t value, NotifyHandler handler);
+    uint32_t notifyOnChannelError(NotifyHandler handler);
+    uint32_t notifyOnGspEvent(uint32_t rpcFunction, NotifyHandler handler);  // 0 = any event
+    bool cancelNotification(uint32_t id);
 
     // Status
     bool getStatus(GpuStatus *status);
-    
-    // Future: Command Buffer abstraction
-    // struct CommandBuffer { ... };
-    // bool submit(const CommandBuffer& cb);
+    bool getStats(CallStats *stats, StatsScope scope = StatsScope::Client, bool reset = false);
 
 private:
-    uint32_t connection; // io_connect_t
-    bool connected;
+    std::unique_ptr<Backend> backend;
+    std::atomic<bool> connected;
+    std::mutex connectLock;  // Slow path of connect(), and disconnect()
+    void *ring;          // NvdaalRingControl, mapped by openCommandRing()
+    std::atomic<uint32_t> channels;   // getChannelCount(), 0 until asked
+    std::atomic<uint32_t> copyChannels;  // getCopyChannelCount(), UINT32_MAX until asked
+
+    struct SysmemSlot {
+        Sysmem mem;
+        bool spare;                                    // freeSysmem()'d, ready for reuse
+    };
+    std::mutex sysmemLock;
+    std::vector<SysmemSlot> sysmem;                    // Every mapped allocation, until disconnect()
+
+    struct NotifyRegistry;
+    NotifyRegistry *notify;
+
+    uint32_t registerNotification(uint32_t kind, uint64_t arg0, uint64_t arg1,
+                                  NotifyHandler handler, bool oneShot);
+    static void notificationCallback(void *refcon, int result, void **args, uint32_t numArgs);
 };
 
 } // namespace nvdaal
@@ -2,65 +2,231 @@
  * nvdaal_c_api.cpp - C-compatible wrapper for libNVDAAL
  *
  * This allows Python (via ctypes) or other languages to use the driver.
- * All functions handle NULL client gracefully.
+ * All functions handle NULL handles gracefully. See nvdaal_c_api.h.
  */
 
-#include "libNVDAAL.h"
+#include "nvdaal_c_api.h"
+#include "NVDAALContext.h"
+#include "NVDAALCopy.h"
+#include "NVDAALDLPack.h"
+#include <cstring>
 #include <new>
 
+using nvdaal::Buffer;
+using nvdaal::CommandBuffer;
+
+// The handles' definitions; nvdaal_client is nvdaal::Client itself
+struct nvdaal_context {
+    nvdaal::Context context;
+
+    explicit nvdaal_context(std::unique_ptr<nvdaal::Backend> backend) : context(std::move(backend)) {}
+};
+
+struct nvdaal_buffer {
+    Buffer buffer;
+};
+
+struct nvdaal_stream {
+    nvdaal::Stream stream;
+
+    nvdaal_stream(nvdaal::Context& c, uint32_t channel) : stream(c.client(), c.allocator(), channel) {}
+};
+
+struct nvdaal_command_buffer {
+    CommandBuffer cb;
+    bool rejected;                               // A bad nvdaal_command since begin()
+
+    nvdaal_command_buffer(nvdaal::BufferAllocator& allocator, size_t reserve)
+        : cb(allocator, reserve), rejected(false) {}
+};
+
+struct nvdaal_tensor {
+    nvdaal::DLPackTensor tensor;
+};
+
+namespace {
+
+nvdaal::Client *unwrap(nvdaal_client_t client) {
+    return reinterpret_cast<nvdaal::Client *>(client);
+}
+
+nvdaal::Event toEvent(const nvdaal_event& e) {
+    nvdaal::Event event;
+    event.client = unwrap(e.client);
+    event.sem = { e.handle, e.gpu_addr };
+    event.value = e.value;
+    return event;
+}
+
+bool inRange(const Buffer& buffer, uint64_t offset, uint64_t bytes) {
+    return offset <= buffer.size() && bytes <= buffer.size() - offset;
+}
+
+// GPU VA of `extent` bytes at `offset` in `buffer`, pinned by the
+// recording; with no buffer, `offset` is the VA
+bool resolve(CommandBuffer& cb, nvdaal_buffer_t buffer, uint64_t offset, uint64_t extent, uint64_t *gpuAddr) {
+    if (!buffer) {
+        *gpuAddr = offset;
+        return true;
+    }
+    const Buffer& b = buffer->buffer;
+    if (!b.gpuAddr() || offset > b.capacity() || extent > b.capacity() - offset) return false;
+    *gpuAddr = b.gpuAddr() + offset;
+    return cb.use(b);
+}
+
+bool record(CommandBuffer& cb, const nvdaal_command& c) {
+    uint64_t dst = 0, src = 0;
+    switch (c.op) {
+    case NVDAAL_CMD_DISPATCH:
+        return resolve(cb, c.src, c.src_offset, nvdaal::kQmdBytes, &src) && cb.dispatch(src);
+    case NVDAAL_CMD_COPY:
+        return resolve(cb, c.dst, c.dst_offset, c.bytes, &dst) && resolve(cb, c.src, c.src_offset, c.bytes, &src) &&
+               cb.copy(dst, src, c.bytes);
+    case NVDAAL_CMD_COPY_2D: {
+        if (c.lines == 0 || c.bytes > UINT32_MAX) return false;
+        uint64_t dstExtent = (uint64_t)(c.lines - 1) * c.dst_pitch + c.bytes;
+        uint64_t srcExtent = (uint64_t)(c.lines - 1) * c.src_pitch + c.bytes;
+        return resolve(cb, c.dst, c.dst_offset, dstExtent, &dst) && resolve(cb, c.src, c.src_offset, srcExtent, &src) &&
+               cb.copy2D(dst, c.dst_pitch, src, c.src_pitch, (uint32_t)c.bytes, c.lines);
+    }
+    case NVDAAL_CMD_FILL:
+        return resolve(cb, c.dst, c.dst_offset, c.bytes, &dst) && cb.fill(dst, c.value, c.bytes);
+    case NVDAAL_CMD_WAIT:
+        if (!c.event) return false;
+        return !c.event->value || cb.wait(nvdaal::Semaphore{ c.event->handle, c.event->gpu_addr }, c.event->value);
+    case NVDAAL_CMD_BARRIER:
+        return cb.barrier();
+    case NVDAAL_CMD_USE:
+        return c.dst && cb.use(c.dst->buffer);
+    default:
+        return false;
+    }
+}
+
+int32_t run(nvdaal_call& c) {
+    uint32_t timeout = c.timeout_ms ? c.timeout_ms : 1000;
+    switch (c.op) {
+    case NVDAAL_CALL_WRITE:
+        if (!c.buffer || (!c.host && c.bytes)) return NVDAAL_STATUS_INVALID;
+        return nvdaal_buffer_write(c.buffer, c.offset, c.host, c.bytes) ? NVDAAL_STATUS_OK : NVDAAL_STATUS_FAILED;
+    case NVDAAL_CALL_READ:
+        if (!c.buffer || (!c.host && c.bytes)) return NVDAAL_STATUS_INVALID;
+        return nvdaal_buffer_read(c.buffer, c.offset, c.host, c.bytes) ? NVDAAL_STATUS_OK : NVDAAL_STATUS_FAILED;
+    case NVDAAL_CALL_SUBMIT:
+        if (!c.stream || !c.command_buffer) return NVDAAL_STATUS_INVALID;
+        return c.stream->stream.submit(c.command_buffer->cb) ? NVDAAL_STATUS_OK : NVDAAL_STATUS_FAILED;
+    case NVDAAL_CALL_RECORD:
+        if (!c.stream || !c.event) return NVDAAL_STATUS_INVALID;
+        return nvdaal_stream_record(c.stream, c.event) ? NVDAAL_STATUS_OK : NVDAAL_STATUS_FAILED;
+    case NVDAAL_CALL_WAIT:
+        if (!c.stream || !c.event) return NVDAAL_STATUS_INVALID;
+        return c.stream->stream.wait(toEvent(*c.event)) ? NVDAAL_STATUS_OK : NVDAAL_STATUS_FAILED;
+    case NVDAAL_CALL_SYNCHRONIZE:
+        if (!c.stream) return NVDAAL_STATUS_INVALID;
+        return c.stream->stream.synchronize(timeout) ? NVDAAL_STATUS_OK : NVDAAL_STATUS_FAILED;
+    case NVDAAL_CALL_EVENT_SYNCHRONIZE:
+        if (!c.event) return NVDAAL_STATUS_INVALID;
+        return toEvent(*c.event).synchronize(timeout) ? NVDAAL_STATUS_OK : NVDAAL_STATUS_FAILED;
+    default:
+        return NVDAAL_STATUS_INVALID;
+    }
+}
+
+} // namespace
+
 extern "C" {
 
-void* nvdaal_create_client() {
-    return new (std::nothrow) nvdaal::Client();
+// ============================================================================
+// Clients
+// ============================================================================
+
+nvdaal_client_t nvdaal_create_client(void) {
+    return reinterpret_cast<nvdaal_client_t>(new (std::nothrow) nvdaal::Client());
 }
 
-void nvdaal_destroy_client(void* client) {
+void nvdaal_destroy_client(nvdaal_client_t client) {
     if (client) {
-        delete static_cast<nvdaal::Client*>(client);
+        delete unwrap(client);
     }
 }
 
-bool nvdaal_connect(void* client) {
+bool nvdaal_connect(nvdaal_client_t client) {
     if (!client) return false;
-    return static_cast<nvdaal::Client*>(client)->connect();
+    return unwrap(client)->connect();
 }
 
-void nvdaal_disconnect(void* client) {
+void nvdaal_disconnect(nvdaal_client_t client) {
     if (client) {
-        static_cast<nvdaal::Client*>(client)->disconnect();
+        unwrap(client)->disconnect();
     }
 }
 
-bool nvdaal_is_connected(void* client) {
+bool nvdaal_is_connected(nvdaal_client_t client) {
     if (!client) return false;
-    return static_cast<nvdaal::Client*>(client)->isConnected();
+    return unwrap(client)->isConnected();
 }
 
-uint64_t nvdaal_alloc_vram(void* client, size_t size) {
+uint64_t nvdaal_alloc_vram(nvdaal_client_t client, size_t size) {
     if (!client || size == 0) return 0;
-    return static_cast<nvdaal::Client*>(client)->allocVram(size);
+    return unwrap(client)->allocVram(size);
 }
 
-bool nvdaal_submit_command(void* client, uint32_t cmd) {
+bool nvdaal_submit_command(nvdaal_client_t client, uint32_t cmd) {
     if (!client) return false;
-    return static_cast<nvdaal::Client*>(client)->submitCommand(cmd);
+    return unwrap(client)->submitCommand(cmd);
+}
+
+bool nvdaal_load_firmware(nvdaal_client_t client, const char* path) {
+    if (!client || !path) return false;
+    return unwrap(client)->loadFirmware(std::string(path));
+}
+
+bool nvdaal_load_firmware_data(nvdaal_client_t client, const void* data, size_t size) {
+    if (!client || !data || size == 0) return false;
+    return unwrap(client)->loadFirmware(data, size);
 }
 
-bool nvdaal_load_firmware(void* client, const char* path) {
+bool nvdaal_load_bootloader(nvdaal_client_t client, const char* path) {
     if (!client || !path) return false;
-    return static_cast<nvdaal::Client*>(client)->loadFirmware(path);
+    return unwrap(client)->loadBootloader(std::string(path));
 }
 
-bool nvdaal_execute_fwsec(void* client) {
+bool nvdaal_load_bootloader_data(nvdaal_client_t client, const void* data, size_t size) {
+    if (!client || !data || size == 0) return false;
+    return unwrap(client)->loadBootloader(data, size);
+}
+
+bool nvdaal_load_booter(nvdaal_client_t client, const char* path) {
+    if (!client || !path) return false;
+    return unwrap(client)->loadBooterLoad(std::string(path));
+}
+
+bool nvdaal_load_booter_data(nvdaal_client_t client, const void* data, size_t size) {
+    if (!client || !data || size == 0) return false;
+    return unwrap(client)->loadBooterLoad(data, size);
+}
+
+bool nvdaal_load_vbios(nvdaal_client_t client, const char* path) {
+    if (!client || !path) return false;
+    return unwrap(client)->loadVbios(std::string(path));
+}
+
+bool nvdaal_load_vbios_data(nvdaal_client_t client, const void* data, size_t size) {
+    if (!client || !data || size == 0) return false;
+    return unwrap(client)->loadVbios(data, size);
+}
+
+bool nvdaal_execute_fwsec(nvdaal_client_t client) {
     if (!client) return false;
-    return static_cast<nvdaal::Client*>(client)->executeFwsec();
+    return unwrap(client)->executeFwsec();
 }
 
-bool nvdaal_get_status(void* client, uint32_t* pmc_boot0, uint32_t* wpr2_lo,
+bool nvdaal_get_status(nvdaal_client_t client, uint32_t* pmc_boot0, uint32_t* wpr2_lo,
                        uint32_t* wpr2_hi, bool* wpr2_enabled) {
     if (!client) return false;
     nvdaal::GpuStatus status;
-    bool ok = static_cast<nvdaal::Client*>(client)->getStatus(&status);
+    bool ok = unwrap(client)->getStatus(&status);
     if (ok) {
         if (pmc_boot0) *pmc_boot0 = status.pmcBoot0;
         if (wpr2_lo) *wpr2_lo = status.wpr2Lo;
@@ -70,4 +236,271 @@ bool nvdaal_get_status(void* client, uint32_t* pmc_boot0, uint32_t* wpr2_lo,
     return ok;
 }
 
+// ============================================================================
+// Contexts
+// ============================================================================
+
+nvdaal_context_t nvdaal_context_create(uint32_t backend) {
+    std::unique_ptr<nvdaal::Backend> transport;
+    if (backend == NVDAAL_BACKEND_IOKIT) transport = nvdaal::makeIOKitBackend();
+    else if (backend == NVDAAL_BACKEND_SIM) transport = nvdaal::makeSimBackend();
+    else if (backend != NVDAAL_BACKEND_DEFAULT) return nullptr;
+    if (backend != NVDAAL_BACKEND_DEFAULT && !transport) return nullptr;
+
+    nvdaal_context *context = new (std::nothrow) nvdaal_context(std::move(transport));
+    if (context && !context->context.connect()) {
+        delete context;
+        return nullptr;
+    }
+    return context;
+}
+
+void nvdaal_context_destroy(nvdaal_context_t context) {
+    delete context;
+}
+
+nvdaal_client_t nvdaal_context_client(nvdaal_context_t context) {
+    if (!context) return nullptr;
+    return reinterpret_cast<nvdaal_client_t>(&context->context.client());
+}
+
+// ============================================================================
+// Buffers
+// ============================================================================
+
+nvdaal_buffer_t nvdaal_buffer_alloc(nvdaal_context_t context, size_t size) {
+    if (!context || size == 0) return nullptr;
+    Buffer buffer = context->context.allocator().allocate(size);
+    if (!buffer) return nullptr;
+    return new (std::nothrow) nvdaal_buffer{ std::move(buffer) };
+}
+
+bool nvdaal_buffer_alloc_batch(nvdaal_context_t context, const size_t *sizes, uint32_t count,
+                               nvdaal_buffer_t *out) {
+    if (!out) return false;
+    for (uint32_t i = 0; i < count; i++) out[i] = nullptr;
+    if (!context || !sizes) return false;
+    for (uint32_t i = 0; i < count; i++) {
+        out[i] = nvdaal_buffer_alloc(context, sizes[i]);
+        if (!out[i]) {
+            nvdaal_buffer_free_batch(out, i);
+            for (uint32_t j = 0; j < i; j++) out[j] = nullptr;
+            return false;
+        }
+    }
+    return true;
+}
+
+void nvdaal_buffer_free(nvdaal_buffer_t buffer) {
+    delete buffer;
+}
+
+void nvdaal_buffer_free_batch(const nvdaal_buffer_t *buffers, uint32_t count) {
+    if (!buffers) return;
+    for (uint32_t i = 0; i < count; i++) delete buffers[i];
+}
+
+size_t nvdaal_buffer_size(nvdaal_buffer_t buffer) {
+    return buffer ? buffer->buffer.size() : 0;
+}
+
+uint64_t nvdaal_buffer_gpu_addr(nvdaal_buffer_t buffer) {
+    return buffer ? buffer->buffer.gpuAddr() : 0;
+}
+
+void *nvdaal_buffer_cpu(nvdaal_buffer_t buffer) {
+    return buffer ? buffer->buffer.cpu() : nullptr;
+}
+
+bool nvdaal_buffer_write(nvdaal_buffer_t buffer, uint64_t offset, const void *src, size_t bytes) {
+    if (!buffer || (!src && bytes) || !inRange(buffer->buffer, offset, bytes)) return false;
+    uint8_t *cpu = (uint8_t *)buffer->buffer.cpu();
+    if (!cpu) return false;
+    if (bytes) nvdaal::streamCopy(cpu + offset, src, bytes);
+    return true;
+}
+
+bool nvdaal_buffer_read(nvdaal_buffer_t buffer, uint64_t offset, void *dst, size_t bytes) {
+    if (!buffer || (!dst && bytes) || !inRange(buffer->buffer, offset, bytes)) return false;
+    const uint8_t *cpu = (const uint8_t *)buffer->buffer.cpu();
+    if (!cpu) return false;
+    if (bytes) memcpy(dst, cpu + offset, bytes);
+    return true;
+}
+
+// ============================================================================
+// Command Buffers
+// ============================================================================
+
+nvdaal_command_buffer_t nvdaal_command_buffer_create(nvdaal_context_t context, size_t reserve_bytes) {
+    if (!context) return nullptr;
+    return new (std::nothrow) nvdaal_command_buffer(context->context.allocator(),
+                                                    reserve_bytes ? reserve_bytes : 16 << 10);
+}
+
+void nvdaal_command_buffer_destroy(nvdaal_command_buffer_t cb) {
+    delete cb;
+}
+
+void nvdaal_command_buffer_begin(nvdaal_command_buffer_t cb) {
+    if (!cb) return;
+    cb->cb.begin();
+    cb->rejected = false;
+}
+
+uint32_t nvdaal_command_buffer_record(nvdaal_command_buffer_t cb, const nvdaal_command *commands, uint32_t count) {
+    if (!cb || !commands || cb->rejected || cb->cb.failed()) return 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (!record(cb->cb, commands[i])) {
+            cb->rejected = true;
+            return i;
+        }
+    }
+    return count;
+}
+
+bool nvdaal_command_buffer_end(nvdaal_command_buffer_t cb) {
+    if (!cb || cb->rejected) return false;
+    return cb->cb.end();
+}
+
+// ============================================================================
+// Streams and Events
+// ============================================================================
+
+nvdaal_stream_t nvdaal_stream_create(nvdaal_context_t context, uint32_t channel) {
+    if (!context) return nullptr;
+    nvdaal_stream *stream = new (std::nothrow) nvdaal_stream(context->context, channel);
+    if (stream && !stream->stream.valid()) {
+        delete stream;
+        return nullptr;
+    }
+    return stream;
+}
+
+void nvdaal_stream_destroy(nvdaal_stream_t stream) {
+    delete stream;
+}
+
+bool nvdaal_stream_submit(nvdaal_stream_t stream, nvdaal_command_buffer_t cb) {
+    if (!stream || !cb) return false;
+    return stream->stream.submit(cb->cb);
+}
+
+uint32_t nvdaal_stream_submit_batch(nvdaal_stream_t stream, const nvdaal_command_buffer_t *cbs, uint32_t count) {
+    if (!stream || !cbs) return 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (!cbs[i] || !stream->stream.submit(cbs[i]->cb)) return i;
+    }
+    return count;
+}
+
+bool nvdaal_stream_record(nvdaal_stream_t stream, nvdaal_event *event) {
+    if (!stream || !event) return false;
+    nvdaal::Event e = stream->stream.record();
+    if (!e.client) return false;
+    event->client = reinterpret_cast<nvdaal_client_t>(e.client);
+    event->handle = e.sem.handle;
+    event->reserved = 0;
+    event->gpu_addr = e.sem.gpuAddr;
+    event->value = e.value;
+    return true;
+}
+
+bool nvdaal_stream_wait(nvdaal_stream_t stream, const nvdaal_event *event) {
+    if (!stream || !event) return false;
+    return stream->stream.wait(toEvent(*event));
+}
+
+bool nvdaal_stream_query(nvdaal_stream_t stream) {
+    if (!stream) return false;
+    return stream->stream.query();
+}
+
+bool nvdaal_stream_synchronize(nvdaal_stream_t stream, uint32_t timeout_ms) {
+    if (!stream) return false;
+    return stream->stream.synchronize(timeout_ms);
+}
+
+bool nvdaal_event_query(const nvdaal_event *event) {
+    if (!event) return false;
+    return toEvent(*event).query();
+}
+
+bool nvdaal_event_synchronize(const nvdaal_event *event, uint32_t timeout_ms) {
+    if (!event) return false;
+    return toEvent(*event).synchronize(timeout_ms);
+}
+
+// ============================================================================
+// Batched Calls
+// ============================================================================
+
+uint32_t nvdaal_execute(nvdaal_call *calls, uint32_t count, uint32_t flags) {
+    if (!calls) return 0;
+    uint32_t ok = 0;
+    bool stopped = false;
+    for (uint32_t i = 0; i < count; i++) {
+        if (stopped) {
+            calls[i].status = NVDAAL_STATUS_SKIPPED;
+            continue;
+        }
+        calls[i].status = run(calls[i]);
+        if (calls[i].status == NVDAAL_STATUS_OK) ok++;
+        else if (flags & NVDAAL_EXECUTE_STOP_ON_ERROR) stopped = true;
+    }
+    return ok;
+}
+
+// ============================================================================
+// DLPack Tensors
+// ============================================================================
+
+DLManagedTensor *nvdaal_buffer_to_dlpack(nvdaal_buffer_t buffer, int32_t ndim, const int64_t *shape,
+                                         const int64_t *strides, DLDataType dtype, uint64_t byte_offset,
+                                         uint32_t device) {
+    if (!buffer || ndim < 0 || (ndim && !shape)) return nullptr;
+    if (device != NVDAAL_DLPACK_GPU && device != NVDAAL_DLPACK_CPU) return nullptr;
+    nvdaal::TensorLayout layout;
+    layout.shape.assign(shape, shape + ndim);
+    if (strides) layout.strides.assign(strides, strides + ndim);
+    layout.dtype = dtype;
+    layout.byteOffset = byte_offset;
+    return nvdaal::toDLPack(buffer->buffer, layout,
+                            device == NVDAAL_DLPACK_CPU ? nvdaal::TensorDevice::Cpu : nvdaal::TensorDevice::Gpu);
+}
+
+nvdaal_tensor_t nvdaal_tensor_from_dlpack(nvdaal_context_t context, DLManagedTensor *tensor) {
+    if (!context || !tensor) return nullptr;
+    nvdaal_tensor *handle = new (std::nothrow) nvdaal_tensor;
+    if (!handle) return nullptr;
+    handle->tensor = nvdaal::fromDLPack(context->context.allocator(), tensor);
+    if (!handle->tensor) {
+        delete handle;
+        return nullptr;
+    }
+    return handle;
+}
+
+void nvdaal_tensor_destroy(nvdaal_tensor_t tensor) {
+    delete tensor;
+}
+
+const DLTensor *nvdaal_tensor_dl(nvdaal_tensor_t tensor) {
+    return tensor ? &tensor->tensor.tensor() : nullptr;
+}
+
+uint64_t nvdaal_tensor_gpu_addr(nvdaal_tensor_t tensor) {
+    return tensor ? tensor->tensor.gpuAddr() : 0;
+}
+
+uint64_t nvdaal_tensor_bytes(nvdaal_tensor_t tensor) {
+    return tensor ? tensor->tensor.bytes() : 0;
+}
+
+bool nvdaal_command_buffer_use_tensor(nvdaal_command_buffer_t cb, nvdaal_tensor_t tensor) {
+    if (!cb || cb->rejected || !tensor) return false;
+    return cb->cb.use(tensor->tensor.pin());
+}
+
 }
@@ -0,0 +1,244 @@
+/*
+ * nvdaal_c_api.h - C API for libNVDAAL
+ *
+ * For C and for FFIs (ctypes, cffi, Rust, Go). Objects are opaque handles,
+ * pointers to struct types only the library defines, made and destroyed
+ * by the functions here. Every function takes NULL handles and fails
+ * (false, 0 or NULL) rather than crashing.
+ *
+ * An FFI crossing from Python costs more than most of the work behind
+ * it, so the API does many things per call:
+ *
+ *   nvdaal_execute()                an array of calls: buffer writes and
+ *                                   reads, submissions, records, waits
+ *   nvdaal_command_buffer_record()  an array of commands into a recording
+ *   nvdaal_stream_submit_batch()    several recordings onto a stream
+ *   nvdaal_buffer_alloc_batch()     several buffers
+ *
+ * and copies nothing it doesn't have to: results go into caller arrays,
+ * events are plain structs in caller memory, buffer writes and reads go
+ * straight between caller memory and the BAR1 mapping (nvdaal_buffer_cpu()
+ * gives the mapping itself), and the *_data firmware loaders read the
+ * caller's image in place.
+ *
+ * Handles follow the C++ objects' rules (NVDAALContext.h): a context and
+ * its buffers may be used from any thread; a stream or command buffer
+ * from one thread at a time. Destroy buffers, streams and command buffers
+ * before their context.
+ */
+
+#ifndef NVDAAL_C_API_H
+#define NVDAAL_C_API_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "nvdaal_dlpack.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct nvdaal_client *nvdaal_client_t;
+typedef struct nvdaal_context *nvdaal_context_t;
+typedef struct nvdaal_buffer *nvdaal_buffer_t;
+typedef struct nvdaal_stream *nvdaal_stream_t;
+typedef struct nvdaal_command_buffer *nvdaal_command_buffer_t;
+typedef struct nvdaal_tensor *nvdaal_tensor_t;
+
+// A point on a stream's timeline, filled in by nvdaal_stream_record().
+// All zeros: nothing recorded, always complete.
+typedef struct nvdaal_event {
+    nvdaal_client_t client;
+    uint32_t handle;                 // Timeline semaphore
+    uint32_t reserved;
+    uint64_t gpu_addr;
+    uint64_t value;
+} nvdaal_event;
+
+// ============================================================================
+// Clients
+// ============================================================================
+
+nvdaal_client_t nvdaal_create_client(void);
+void nvdaal_destroy_client(nvdaal_client_t client);
+bool nvdaal_connect(nvdaal_client_t client);
+void nvdaal_disconnect(nvdaal_client_t client);
+bool nvdaal_is_connected(nvdaal_client_t client);
+uint64_t nvdaal_alloc_vram(nvdaal_client_t client, size_t size);
+bool nvdaal_submit_command(nvdaal_client_t client, uint32_t cmd);
+bool nvdaal_execute_fwsec(nvdaal_client_t client);
+bool nvdaal_get_status(nvdaal_client_t client, uint32_t *pmc_boot0, uint32_t *wpr2_lo,
+                       uint32_t *wpr2_hi, bool *wpr2_enabled);
+
+// Firmware from a file, or from caller memory (read in place; keep it
+// unchanged until the call returns)
+bool nvdaal_load_firmware(nvdaal_client_t client, const char *path);
+bool nvdaal_load_firmware_data(nvdaal_client_t client, const void *data, size_t size);
+bool nvdaal_load_bootloader(nvdaal_client_t client, const char *path);
+bool nvdaal_load_bootloader_data(nvdaal_client_t client, const void *data, size_t size);
+bool nvdaal_load_booter(nvdaal_client_t client, const char *path);
+bool nvdaal_load_booter_data(nvdaal_client_t client, const void *data, size_t size);
+bool nvdaal_load_vbios(nvdaal_client_t client, const char *path);
+bool nvdaal_load_vbios_data(nvdaal_client_t client, const void *data, size_t size);
+
+// ============================================================================
+// Contexts
+// ============================================================================
+
+#define NVDAAL_BACKEND_DEFAULT 0     // NVDAAL_BACKEND env, else the kext, else the simulator
+#define NVDAAL_BACKEND_IOKIT   1
+#define NVDAAL_BACKEND_SIM     2
+
+// Connected, or NULL
+nvdaal_context_t nvdaal_context_create(uint32_t backend);
+void nvdaal_context_destroy(nvdaal_context_t context);     // Waits for outstanding work
+// Owned by the context: use with the client functions, never destroy
+nvdaal_client_t nvdaal_context_client(nvdaal_context_t context);
+
+// ============================================================================
+// Buffers
+// ============================================================================
+
+nvdaal_buffer_t nvdaal_buffer_alloc(nvdaal_context_t context, size_t size);
+// All or nothing: on failure out[] is all NULL
+bool nvdaal_buffer_alloc_batch(nvdaal_context_t context, const size_t *sizes, uint32_t count,
+                               nvdaal_buffer_t *out);
+void nvdaal_buffer_free(nvdaal_buffer_t buffer);
+void nvdaal_buffer_free_batch(const nvdaal_buffer_t *buffers, uint32_t count);  // NULLs skipped
+
+size_t nvdaal_buffer_size(nvdaal_buffer_t buffer);
+uint64_t nvdaal_buffer_gpu_addr(nvdaal_buffer_t buffer);
+void *nvdaal_buffer_cpu(nvdaal_buffer_t buffer);            // Write-combined BAR1 mapping
+
+// Straight between caller memory and the mapping; reads through a
+// write-combined mapping are slow, so read back small results only
+bool nvdaal_buffer_write(nvdaal_buffer_t buffer, uint64_t offset, const void *src, size_t bytes);
+bool nvdaal_buffer_read(nvdaal_buffer_t buffer, uint64_t offset, void *dst, size_t bytes);
+
+// ============================================================================
+// Command Buffers
+// ============================================================================
+
+#define NVDAAL_CMD_DISPATCH  1       // QMD at src + src_offset
+#define NVDAAL_CMD_COPY      2       // bytes from src + src_offset to dst + dst_offset
+#define NVDAAL_CMD_COPY_2D   3       // lines of bytes, src_pitch / dst_pitch apart
+#define NVDAAL_CMD_FILL      4       // value repeated over bytes at dst + dst_offset
+#define NVDAAL_CMD_WAIT      5       // Until *event has completed
+#define NVDAAL_CMD_BARRIER   6
+#define NVDAAL_CMD_USE       7       // Pin dst: reached only through a QMD's arguments
+
+// With a buffer, an offset is into it and the recording pins the buffer;
+// with NULL, the offset is a GPU VA
+typedef struct nvdaal_command {
+    uint32_t op;                     // NVDAAL_CMD_*
+    uint32_t value;                  // FILL pattern
+    nvdaal_buffer_t dst;
+    uint64_t dst_offset;
+    nvdaal_buffer_t src;
+    uint64_t src_offset;
+    uint64_t bytes;                  // COPY_2D: bytes per line
+    uint32_t dst_pitch;              // COPY_2D
+    uint32_t src_pitch;
+    uint32_t lines;
+    uint32_t reserved;
+    const nvdaal_event *event;       // WAIT
+} nvdaal_command;
+
+nvdaal_command_buffer_t nvdaal_command_buffer_create(nvdaal_context_t context, size_t reserve_bytes);  // 0 = default
+void nvdaal_command_buffer_destroy(nvdaal_command_buffer_t cb);
+void nvdaal_command_buffer_begin(nvdaal_command_buffer_t cb);
+// Returns how many were recorded. A bad command stops there and fails
+// the recording: end() refuses it until the next begin().
+uint32_t nvdaal_command_buffer_record(nvdaal_command_buffer_t cb, const nvdaal_command *commands, uint32_t count);
+bool nvdaal_command_buffer_end(nvdaal_command_buffer_t cb);
+
+// ============================================================================
+// Streams and Events
+// ============================================================================
+
+#define NVDAAL_ANY_CHANNEL  0xFFFFFFFFu
+#define NVDAAL_COPY_CHANNEL 0x80u    // | n: copy-engine channel n
+
+nvdaal_stream_t nvdaal_stream_create(nvdaal_context_t context, uint32_t channel);
+void nvdaal_stream_destroy(nvdaal_stream_t stream);         // Waits for its work
+bool nvdaal_stream_submit(nvdaal_stream_t stream, nvdaal_command_buffer_t cb);
+// In order; returns how many were submitted, stopping at the first failure
+uint32_t nvdaal_stream_submit_batch(nvdaal_stream_t stream, const nvdaal_command_buffer_t *cbs, uint32_t count);
+bool nvdaal_stream_record(nvdaal_stream_t stream, nvdaal_event *event);
+bool nvdaal_stream_wait(nvdaal_stream_t stream, const nvdaal_event *event);     // GPU side
+bool nvdaal_stream_query(nvdaal_stream_t stream);
+bool nvdaal_stream_synchronize(nvdaal_stream_t stream, uint32_t timeout_ms);
+
+bool nvdaal_event_query(const nvdaal_event *event);
+bool nvdaal_event_synchronize(const nvdaal_event *event, uint32_t timeout_ms);
+
+// ============================================================================
+// Batched Calls
+// ============================================================================
+
+#define NVDAAL_CALL_WRITE             1   // bytes from host to buffer + offset
+#define NVDAAL_CALL_READ              2   // bytes from buffer + offset to host
+#define NVDAAL_CALL_SUBMIT            3   // command_buffer on stream
+#define NVDAAL_CALL_RECORD            4   // stream's position into *event
+#define NVDAAL_CALL_WAIT              5   // stream waits for *event, GPU side
+#define NVDAAL_CALL_SYNCHRONIZE       6   // Host waits for stream
+#define NVDAAL_CALL_EVENT_SYNCHRONIZE 7   // Host waits for *event
+
+#define NVDAAL_STATUS_OK      0
+#define NVDAAL_STATUS_INVALID 1      // Unknown op, missing handle or out of range
+#define NVDAAL_STATUS_FAILED  2      // The library or driver refused it
+#define NVDAAL_STATUS_SKIPPED 3      // Not run: an earlier call failed (NVDAAL_EXECUTE_STOP_ON_ERROR)
+
+#define NVDAAL_EXECUTE_STOP_ON_ERROR 1u
+
+typedef struct nvdaal_call {
+    uint32_t op;                     // NVDAAL_CALL_*
+    int32_t status;                  // Out: NVDAAL_STATUS_*
+    nvdaal_stream_t stream;
+    nvdaal_buffer_t buffer;
+    nvdaal_command_buffer_t command_buffer;
+    nvdaal_event *event;
+    void *host;                      // WRITE source, READ destination
+    uint64_t offset;
+    uint64_t bytes;
+    uint32_t timeout_ms;             // Synchronizes; 0 = 1000
+    uint32_t reserved;
+} nvdaal_call;
+
+// Runs calls[0..count) in order; returns how many succeeded
+uint32_t nvdaal_execute(nvdaal_call *calls, uint32_t count, uint32_t flags);
+
+// ============================================================================
+// DLPack Tensors (NVDAALDLPack.h)
+// ============================================================================
+
+#define NVDAAL_DLPACK_GPU 0          // data is the GPU VA, device kDLExtDev (not a CUDA pointer)
+#define NVDAAL_DLPACK_CPU 1          // data is the BAR1 mapping, device kDLCPU
+
+// A tensor over a buffer, for a framework to consume (in Python, wrap it
+// in a "dltensor" capsule). shape and strides are copied; strides in
+// elements, NULL = compact row-major. The tensor pins the buffer, which
+// may be freed first; call its deleter before destroying the context.
+// NULL if the layout does not fit in the buffer.
+DLManagedTensor *nvdaal_buffer_to_dlpack(nvdaal_buffer_t buffer, int32_t ndim, const int64_t *shape,
+                                         const int64_t *strides, DLDataType dtype, uint64_t byte_offset,
+                                         uint32_t device);
+
+// Takes a framework's tensor whose memory lies in one of the context's
+// buffers. The handle then owns it: nvdaal_tensor_destroy() calls its
+// deleter. NULL if it is not NVDAAL memory, and the tensor stays the
+// caller's.
+nvdaal_tensor_t nvdaal_tensor_from_dlpack(nvdaal_context_t context, DLManagedTensor *tensor);
+void nvdaal_tensor_destroy(nvdaal_tensor_t tensor);
+const DLTensor *nvdaal_tensor_dl(nvdaal_tensor_t tensor);
+uint64_t nvdaal_tensor_gpu_addr(nvdaal_tensor_t tensor);    // First element: a GPU VA for commands
+uint64_t nvdaal_tensor_bytes(nvdaal_tensor_t tensor);       // From the first element to the end of the last
+// Pin the tensor's memory for the recording, as NVDAAL_CMD_USE does a buffer
+bool nvdaal_command_buffer_use_tensor(nvdaal_command_buffer_t cb, nvdaal_tensor_t tensor);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NVDAAL_C_API_H
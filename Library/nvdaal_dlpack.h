@@ -0,0 +1,81 @@
+/*
+ * nvdaal_dlpack.h - DLPack Tensor Structures
+ *
+ * The DLPack 0.8 ABI (github.com/dmlc/dlpack, Apache-2.0): the structs
+ * frameworks exchange tensors through. Declared here so libNVDAAL builds
+ * without the dlpack headers; if dlpack.h was included first, its
+ * definitions are used, and including it afterwards is harmless.
+ */
+
+#ifndef DLPACK_DLPACK_H_
+#define DLPACK_DLPACK_H_
+
+#include <stdint.h>
+
+#define DLPACK_VERSION 80
+#define DLPACK_ABI_VERSION 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    kDLCPU = 1,
+    kDLCUDA = 2,
+    kDLCUDAHost = 3,
+    kDLOpenCL = 4,
+    kDLVulkan = 7,
+    kDLMetal = 8,
+    kDLVPI = 9,
+    kDLROCM = 10,
+    kDLROCMHost = 11,
+    kDLExtDev = 12,
+    kDLCUDAManaged = 13,
+    kDLOneAPI = 14,
+    kDLWebGPU = 15,
+    kDLHexagon = 16,
+} DLDeviceType;
+
+typedef struct {
+    DLDeviceType device_type;
+    int32_t device_id;
+} DLDevice;
+
+typedef enum {
+    kDLInt = 0U,
+    kDLUInt = 1U,
+    kDLFloat = 2U,
+    kDLOpaqueHandle = 3U,
+    kDLBfloat = 4U,
+    kDLComplex = 5U,
+    kDLBool = 6U,
+} DLDataTypeCode;
+
+typedef struct {
+    uint8_t code;                    // DLDataTypeCode
+    uint8_t bits;                    // Per lane
+    uint16_t lanes;                  // 1 unless a vector type
+} DLDataType;
+
+typedef struct {
+    void *data;                      // Device memory: 256-byte aligned, offset in byte_offset
+    DLDevice device;
+    int32_t ndim;
+    DLDataType dtype;
+    int64_t *shape;
+    int64_t *strides;                // In elements; NULL = compact row-major
+    uint64_t byte_offset;
+} DLTensor;
+
+// The consumer calls deleter(self) once it is done with the tensor
+typedef struct DLManagedTensor {
+    DLTensor dl_tensor;
+    void *manager_ctx;
+    void (*deleter)(struct DLManagedTensor *self);
+} DLManagedTensor;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DLPACK_DLPACK_H_
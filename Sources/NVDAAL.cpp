@@ -85,10 +85,22 @@ bool NVDAAL::init(OSDictionary *dictionary) {
     gsp = nullptr;
     memory = nullptr;
     vaSpace = nullptr;
-    channel = nullptr;
+    for (uint32_t i = 0; i < NVDAAL_MAX_CHANNELS; i++) channels[i] = nullptr;
+    channelCount = 0;
+    for (uint32_t i = 0; i < NVDAAL_MAX_COPY_CHANNELS; i++) copyChannels[i] = nullptr;
+    copyChannelCount = 0;
     display = nullptr;
+    semaphores = nullptr;
+    sysmemLock = IOLockAlloc();
+    retiredSysmem = OSArray::withCapacity(NVDAAL_MAX_SYSMEM_ALLOCS);
+    sysmemWired = 0;
+    if (!sysmemLock || !retiredSysmem) return false;
     computeReady = false;
     interruptSource = nullptr;
+    notifyTimer = nullptr;
+    statsTimer = nullptr;
+    statsPublishedCalls = 0;
+    NVDAALUserClient::resetStats(&globalStats);
 
     hClient = 0;
     hDevice = 0;
@@ -128,11 +140,49 @@ void NVDAAL::free(void) {
         interruptSource = nullptr;
     }
 
+    if (notifyTimer) {
+        notifyTimer->cancelTimeout();
+        if (getWorkLoop()) {
+            getWorkLoop()->removeEventSource(notifyTimer);
+        }
+        notifyTimer->release();
+        notifyTimer = nullptr;
+    }
+
+    if (statsTimer) {
+        statsTimer->cancelTimeout();
+        if (getWorkLoop()) {
+            getWorkLoop()->removeEventSource(statsTimer);
+        }
+        statsTimer->release();
+        statsTimer = nullptr;
+    }
+
+    // Channels first: their deadline timers sit on the work loop, and
+    // freeing one releases RM objects through GSP and its fence semaphore
+    for (uint32_t i = 0; i < channelCount; i++) {
+        channels[i]->detachWorkLoop();
+        channels[i]->release();
+        channels[i] = nullptr;
+    }
+    channelCount = 0;
+    for (uint32_t i = 0; i < copyChannelCount; i++) {
+        copyChannels[i]->detachWorkLoop();
+        copyChannels[i]->release();
+        copyChannels[i] = nullptr;
+    }
+    copyChannelCount = 0;
+
     if (gsp) {
         delete gsp;
         gsp = nullptr;
     }
 
+    if (semaphores) {
+        semaphores->release();
+        semaphores = nullptr;
+    }
+
     if (memory) {
         memory->release();
         memory = nullptr;
@@ -143,6 +193,20 @@ void NVDAAL::free(void) {
         display = nullptr;
     }
 
+    // GSP is down, so no channel can reach retired sysmem any more
+    if (retiredSysmem) {
+        for (unsigned int i = 0; i < retiredSysmem->getCount(); i++) {
+            IOMemoryDescriptor *desc = OSDynamicCast(IOMemoryDescriptor, retiredSysmem->getObject(i));
+            if (desc) desc->complete();
+        }
+        retiredSysmem->release();
+        retiredSysmem = nullptr;
+    }
+    if (sysmemLock) {
+        IOLockFree(sysmemLock);
+        sysmemLock = nullptr;
+    }
+
     unmapBARs();
     super::free();
 }
@@ -234,6 +298,19 @@ bool NVDAAL::start(IOService *provider) {
         IOLog("NVDAAL: MSI Interrupts enabled\n");
     }
 
+    notifyTimer = IOTimerEventSource::timerEventSource(this, notifyTimerFired);
+    if (notifyTimer && getWorkLoop()->addEventSource(notifyTimer) != kIOReturnSuccess) {
+        notifyTimer->release();
+        notifyTimer = nullptr;
+    }
+
+    statsTimer = IOTimerEventSource::timerEventSource(this, statsTimerFired);
+    if (statsTimer && getWorkLoop()->addEventSource(statsTimer) != kIOReturnSuccess) {
+        statsTimer->release();
+        statsTimer = nullptr;
+    }
+    if (statsTimer) statsTimer->setTimeoutMS(kStatsPublishMs);
+
     // Initialize GSP (required for Ada Lovelace)
     IOLog("NVDAAL: Initializing GSP for %s...\n", getArchName(chipArch));
 
@@ -244,6 +321,7 @@ bool NVDAAL::start(IOService *provider) {
         // Don't fail start - we still want the driver attached for debugging
     } else {
         IOLog("NVDAAL: GSP controller initialized\n");
+        gsp->setEventHandler(gspEventHandler, this);
     }
 
     // Initialize Memory Manager
@@ -252,6 +330,12 @@ bool NVDAAL::start(IOService *provider) {
         IOLog("NVDAAL: WARNING: Memory Manager not available\n");
     }
 
+    // Timeline semaphores (GPU VA is assigned once the VASpace boots)
+    semaphores = NVDAALSemaphorePool::withCapacity();
+    if (!semaphores) {
+        IOLog("NVDAAL: WARNING: Semaphore pool not available\n");
+    }
+
     // NVDAALDisplay disabled for now - injecting Metal/NVDA properties
     // can crash WindowServer or attract IONDRVFramebuffer
     // TODO: Re-enable when compute-only Metal support is implemented
@@ -283,6 +367,9 @@ bool NVDAAL::start(IOService *provider) {
 void NVDAAL::stop(IOService *provider) {
     IOLog("NVDAAL: Stopping compute driver\n");
     computeReady = false;
+    // No deadline flush may ring a doorbell once BAR0 is gone
+    for (uint32_t i = 0; i < channelCount; i++) channels[i]->detachWorkLoop();
+    for (uint32_t i = 0; i < copyChannelCount; i++) copyChannels[i]->detachWorkLoop();
     unmapBARs();
     super::stop(provider);
 }
@@ -424,7 +511,7 @@ void NVDAAL::processInterrupt() {
     uint32_t intr = readReg(NV_PMC_INTR_EN_0); 
     
     // 2. Dispatch to GSP if GSP interrupt bit is set
-    if (intr & (1 << 15)) { // Bit 15 is often GSP/Falcon on newer chips
+    if (intr & NV_PMC_INTR_GSP) { // Bit 15 is often GSP/Falcon on newer chips
         if (gsp) {
             // Tell GSP to check its queues
             // gsp->handleInterrupt(); 
@@ -433,6 +520,95 @@ void NVDAAL::processInterrupt() {
     
     // 3. Clear Interrupt (ACK)
     writeReg(NV_PMC_INTR_EN_0, intr); // Acking by writing back
+
+    // 4. Semaphore releases raise NON_STALL_INTERRUPT; let waiters re-check
+    if (semaphores) {
+        semaphores->notify();
+        pollSemaphoreNotifications();
+    }
+
+    // 5. Host/channel faults
+    if (intr & NV_PMC_INTR_PFIFO) {
+        broadcastNotification(NVDAAL_NOTIFY_CHANNEL_ERROR, intr, 0);
+    }
+}
+
+// ============================================================================
+// Async Notifications
+// ============================================================================
+
+bool NVDAAL::pollSemaphoreNotifications(void) {
+    bool remaining = false;
+
+    OSIterator *iter = getClientIterator();
+    if (!iter) return false;
+    while (OSObject *obj = iter->getNextObject()) {
+        NVDAALUserClient *client = OSDynamicCast(NVDAALUserClient, obj);
+        if (client && client->deliverSemaphoreNotifications()) remaining = true;
+    }
+    iter->release();
+    return remaining;
+}
+
+void NVDAAL::scheduleNotificationPoll(void) {
+    if (notifyTimer) notifyTimer->setTimeoutMS(kNotifyPollMs);
+}
+
+void NVDAAL::notifyTimerFired(OSObject *owner, IOTimerEventSource *sender) {
+    NVDAAL *inst = OSDynamicCast(NVDAAL, owner);
+    if (inst && inst->pollSemaphoreNotifications()) {
+        sender->setTimeoutMS(kNotifyPollMs);
+    }
+}
+
+void NVDAAL::broadcastNotification(uint32_t kind, uint64_t value0, uint64_t value1) {
+    OSIterator *iter = getClientIterator();
+    if (!iter) return;
+    while (OSObject *obj = iter->getNextObject()) {
+        NVDAALUserClient *client = OSDynamicCast(NVDAALUserClient, obj);
+        if (client) client->deliverNotification(kind, value0, value1);
+    }
+    iter->release();
+}
+
+void NVDAAL::gspEventHandler(void *context, uint32_t function, uint32_t rpcResult) {
+    NVDAAL *inst = (NVDAAL *)context;
+    inst->broadcastNotification(NVDAAL_NOTIFY_GSP_EVENT, function, rpcResult);
+}
+
+// ============================================================================
+// Call Statistics
+// ============================================================================
+
+void NVDAAL::statsTimerFired(OSObject *owner, IOTimerEventSource *sender) {
+    NVDAAL *inst = OSDynamicCast(NVDAAL, owner);
+    if (!inst) return;
+    inst->publishStats();
+    sender->setTimeoutMS(kStatsPublishMs);
+}
+
+void NVDAAL::publishStats(void) {
+    uint64_t calls = 0;
+    for (uint32_t i = 0; i < globalStats.selectorCount; i++) {
+        calls += __atomic_load_n(&globalStats.selectors[i].calls, __ATOMIC_RELAXED);
+    }
+    // Idle drivers do not rebuild the dictionaries
+    if (calls == statsPublishedCalls) return;
+    statsPublishedCalls = calls;
+
+    OSDictionary *dict = NVDAALUserClient::copyStatsDictionary(&globalStats);
+    if (dict) {
+        setProperty("CallStats", dict);
+        dict->release();
+    }
+
+    OSIterator *iter = getClientIterator();
+    if (!iter) return;
+    while (OSObject *obj = iter->getNextObject()) {
+        NVDAALUserClient *client = OSDynamicCast(NVDAALUserClient, obj);
+        if (client) client->publishStats();
+    }
+    iter->release();
 }
 
 bool NVDAAL::loadGspFirmware(const void *data, size_t size) {
@@ -466,7 +642,7 @@ bool NVDAAL::executeFwsec(void) {
 }
 
 // Returns: 0=success, 1+=error stage for debugging
-int NVDAAL::loadGspFirmwareEx(const void *data, size_t size) {
+int NVDAAL::loadGspFirmwareEx(const void *data, size_t size, IOMemoryDescriptor *wired) {
     if (!gsp) {
         IOLog("NVDAAL: GSP controller not available\n");
         return 1;  // Error stage 1: No GSP
@@ -474,8 +650,9 @@ int NVDAAL::loadGspFirmwareEx(const void *data, size_t size) {
 
     IOLog("NVDAAL: Received GSP firmware (%lu bytes)\n", size);
 
-    if (!gsp->parseElfFirmware(data, size)) {
+    if (!gsp->parseElfFirmware(data, size, wired)) {
         IOLog("NVDAAL: Failed to parse firmware ELF\n");
+        gsp->releaseClientFirmware();
         return 2;  // Error stage 2: ELF parse failed
     }
 
@@ -488,10 +665,15 @@ int NVDAAL::loadGspFirmwareEx(const void *data, size_t size) {
     int bootResult = gsp->bootEx();
     if (bootResult != 0) {
         IOLog("NVDAAL: Failed to boot GSP (stage %d)\n", bootResult);
+        gsp->releaseClientFirmware();
         return 3;  // Error stage 3: Boot failed
     }
 
-    if (!gsp->waitForInitDone()) {
+    // Booter has copied the image into WPR2 by the time GSP reports init
+    // done, so client pages borrowed by parseElfFirmware can go back.
+    bool initDone = gsp->waitForInitDone();
+    gsp->releaseClientFirmware();
+    if (!initDone) {
         IOLog("NVDAAL: Timeout waiting for GSP init\n");
         return 4;  // Error stage 4: Init timeout
     }
@@ -528,11 +710,39 @@ int NVDAAL::loadGspFirmwareEx(const void *data, size_t size) {
         return false;
     }
 
-    // 4. Initialize Compute Channel
-    channel = NVDAALChannel::withVASpace(gsp, vaSpace, hClient, hDevice);
-    if (!channel || !channel->boot()) {
-        IOLog("NVDAAL: Failed to boot Compute Channel\n");
-        return false;
+    if (semaphores && !semaphores->attachVASpace(vaSpace)) {
+        IOLog("NVDAAL: WARNING: Semaphores not GPU-visible\n");
+    }
+
+    // 4. Initialize Compute Channels. Each is an independent in-order queue
+    // for libNVDAAL streams; only the first is required.
+    for (uint32_t i = 0; i < kComputeChannels; i++) {
+        NVDAALChannel *ch = NVDAALChannel::withVASpace(gsp, vaSpace, semaphores, hClient, hDevice);
+        if (!ch || !ch->boot()) {
+            if (ch) ch->release();
+            if (i == 0) {
+                IOLog("NVDAAL: Failed to boot Compute Channel\n");
+                return false;
+            }
+            IOLog("NVDAAL: Compute channel %u failed to boot, continuing with %u\n", i, i);
+            break;
+        }
+        ch->attachWorkLoop(getWorkLoop());
+        channels[channelCount++] = ch;
+    }
+
+    // 5. Copy-engine channels, so DMA runs beside compute instead of on
+    // its GRCE. Optional: without them clients copy on compute channels.
+    for (uint32_t i = 0; i < kCopyChannels && i < NVDAAL_MAX_COPY_CHANNELS; i++) {
+        NVDAALChannel *ch = NVDAALChannel::withVASpace(gsp, vaSpace, semaphores, hClient, hDevice,
+                                                       NV2080_ENGINE_TYPE_COPY);
+        if (!ch || !ch->boot()) {
+            if (ch) ch->release();
+            IOLog("NVDAAL: Copy channel %u failed to boot, continuing with %u\n", i, i);
+            break;
+        }
+        ch->attachWorkLoop(getWorkLoop());
+        copyChannels[copyChannelCount++] = ch;
     }
 
     computeReady = true;
@@ -546,31 +756,181 @@ uint64_t NVDAAL::allocVram(size_t size) {
     return memory->allocVram(size);
 }
 
+uint64_t NVDAAL::mapVram(uint64_t offset, size_t size) {
+    if (!memory || !vaSpace || size == 0) return 0;
+
+    IOMemoryDescriptor *desc = memory->createVramDescriptor(offset, size);
+    if (!desc) return 0;
+    uint64_t va = vaSpace->map(desc, 0x10000);  // 64KB big-page alignment
+    desc->release();
+    return va;
+}
+
+void NVDAAL::unmapVram(uint64_t gpuVa, size_t size) {
+    if (vaSpace && gpuVa) vaSpace->unmap(gpuVa, size);
+}
+
+// Charged against NVDAAL_MAX_SYSMEM_WIRED for the driver's lifetime
+uint64_t NVDAAL::mapSysmem(IOMemoryDescriptor *desc) {
+    if (!vaSpace || !desc) return 0;
+    uint64_t size = desc->getLength();
+
+    IOLockLock(sysmemLock);
+    bool fits = size <= NVDAAL_MAX_SYSMEM_WIRED - sysmemWired;
+    if (fits) sysmemWired += size;
+    IOLockUnlock(sysmemLock);
+    if (!fits) {
+        IOLog("NVDAAL: Wired sysmem limit reached (%llu MB)\n", NVDAAL_MAX_SYSMEM_WIRED >> 20);
+        return 0;
+    }
+
+    uint64_t va = vaSpace->map(desc, 0x1000);
+    if (va == 0) {
+        IOLockLock(sysmemLock);
+        sysmemWired -= size;
+        IOLockUnlock(sysmemLock);
+    }
+    return va;
+}
+
+void NVDAAL::retireSysmem(IOMemoryDescriptor *desc) {
+    IOLockLock(sysmemLock);
+    bool kept = retiredSysmem->setObject(desc);
+    IOLockUnlock(sysmemLock);
+    if (!kept) {
+        IOLog("NVDAAL: Leaking %llu bytes of wired sysmem\n", (uint64_t)desc->getLength());
+        desc->retain();                             // Never unwired
+    }
+}
+
+IOMemoryDescriptor* NVDAAL::createVramUserDescriptor(uint64_t offset, size_t size) {
+    if (!memory) return nullptr;
+    return memory->createVramUserDescriptor(offset, size);
+}
+
 bool NVDAAL::submitCommand(uint32_t cmd) {
+    NVDAALChannel *channel = channels[0];
     if (!channel) return false;
     
-    // TODO: cmd is currently a placeholder 32-bit value
-    // Real submission requires a command buffer address and length
-    // For now we just pass it as an address to test the plumbing
-    return channel->submit((uint64_t)cmd, 4);
+    // cmd is an opaque 32-bit tag, not a method: it rides as the data of a
+    // host NOP, so no value can raise a channel error on the shared channel.
+    // The arena appends the fence release and kicks the GPFIFO.
+    NvPushbuffer pb;
+    if (!channel->beginPush(NV_PB_NOP_DWORDS * sizeof(uint32_t), &pb)) return false;
+    nvPbPushNop(&pb, cmd);
+    return channel->endPush(&pb) != 0;
 }
 
-bool NVDAAL::waitSemaphore(uint64_t gpuAddr, uint32_t value, uint32_t timeoutMs) {
-    // Excellence: GPU Synchronization
-    // In Ada architecture, we usually poll a memory location that the GPU 
-    // writes to via a 'MEM_OP' or 'RELEASE' command in the GPFIFO.
-    
-    uint32_t elapsed = 0;
-    IOLog("NVDAAL: Sync - Waiting for GPU VA 0x%llx == %u (timeout: %u ms)\n", gpuAddr, value, timeoutMs);
-    
-    // Beta: Assume success for now to keep the pipeline moving
-    // In the next iteration, we will implement VA-to-Kernel mapping.
-    if (gpuAddr == 0) return false;
-    
-    return true; 
+// As above, then release a client timeline semaphore to `signalValue` once
+// the GPU has passed `cmd`. The release raises the non-stall interrupt,
+// which wakes host waiters and delivers semaphore notifications.
+bool NVDAAL::submitCommand(uint32_t cmd, OSObject *owner, uint32_t signalHandle, uint64_t signalValue) {
+    if (!signalHandle) return submitCommand(cmd);
+    NVDAALChannel *channel = channels[0];
+    if (!channel || !semaphores) return false;
+
+    uint64_t semVa;
+    if (!semaphores->gpuVaOf(owner, signalHandle, &semVa)) return false;
+
+    NvPushbuffer pb;
+    if (!channel->beginPush((NV_PB_NOP_DWORDS + NV_PB_SEMAPHORE_RELEASE_DWORDS) * sizeof(uint32_t), &pb)) {
+        return false;
+    }
+    nvPbPushNop(&pb, cmd);
+    nvPbPushSemaphoreRelease(&pb, semVa, signalValue, true);
+    return channel->endPush(&pb) != 0;
 }
 
-    
+// Run a client-recorded pushbuffer (already validated against the client's
+// GPU mappings) straight from its VRAM. The arena segment behind it carries
+// the optional semaphore release and the channel fence.
+bool NVDAAL::submitPushbuffer(uint32_t channelIndex, uint64_t gpuVa, uint32_t bytes, OSObject *owner,
+                              uint32_t signalHandle, uint64_t signalValue) {
+    NVDAALChannel *channel = channelAt(channelIndex);
+    if (!channel || !gpuVa || !bytes) return false;
+
+    uint64_t semVa = 0;
+    if (signalHandle && (!semaphores || !semaphores->gpuVaOf(owner, signalHandle, &semVa))) return false;
+
+    NvPushbuffer pb;
+    if (!channel->beginPush(signalHandle ? NV_PB_SEMAPHORE_RELEASE_DWORDS * sizeof(uint32_t) : 0, &pb)) {
+        return false;
+    }
+    if (signalHandle) nvPbPushSemaphoreRelease(&pb, semVa, signalValue, true);
+    return channel->endPush(&pb, gpuVa, bytes) != 0;
+}
+
+NVDAALChannel *NVDAAL::channelAt(uint32_t channelIndex) {
+    if (channelIndex & NVDAAL_CHANNEL_COPY) {
+        channelIndex &= ~NVDAAL_CHANNEL_COPY;
+        return channelIndex < copyChannelCount ? copyChannels[channelIndex] : nullptr;
+    }
+    return channelIndex < channelCount ? channels[channelIndex] : nullptr;
+}
+
+// ============================================================================
+// Timeline Semaphores
+// ============================================================================
+
+bool NVDAAL::createSemaphore(OSObject *owner, uint64_t initialValue, uint32_t *handle, uint64_t *gpuVa) {
+    if (!semaphores) return false;
+    return semaphores->create(owner, initialValue, handle, gpuVa);
+}
+
+bool NVDAAL::destroySemaphore(OSObject *owner, uint32_t handle) {
+    if (!semaphores) return false;
+    return semaphores->destroy(owner, handle);
+}
+
+void NVDAAL::destroySemaphores(OSObject *owner) {
+    if (semaphores) semaphores->destroyAllOwnedBy(owner);
+}
+
+bool NVDAAL::signalSemaphore(OSObject *owner, uint32_t handle, uint64_t value) {
+    if (!semaphores || !semaphores->signal(owner, handle, value)) return false;
+
+    // Host signals raise no interrupt; check the owner's watches directly
+    NVDAALUserClient *client = OSDynamicCast(NVDAALUserClient, owner);
+    if (client) client->deliverSemaphoreNotifications();
+    return true;
+}
+
+bool NVDAAL::readSemaphore(OSObject *owner, uint32_t handle, uint64_t *value) {
+    if (!semaphores) return false;
+    return semaphores->read(owner, handle, value);
+}
+
+IOReturn NVDAAL::waitSemaphore(OSObject *owner, uint64_t gpuAddr, uint64_t value, uint32_t timeoutMs) {
+    // Legacy form: the semaphore is named by its GPU VA
+    uint32_t handle;
+    if (!semaphores) return kIOReturnNotReady;
+    if (!semaphores->lookupGpuVa(owner, gpuAddr, &handle)) return kIOReturnBadArgument;
+    flushSubmissions();  // Held work could be what releases it
+    return semaphores->wait(owner, &handle, &value, 1, true, timeoutMs, nullptr);
+}
+
+IOReturn NVDAAL::waitSemaphores(OSObject *owner, const uint32_t *handles, const uint64_t *values,
+                                uint32_t count, bool waitAll, uint32_t timeoutMs, uint32_t *signaledIndex) {
+    if (!semaphores) return kIOReturnNotReady;
+    flushSubmissions();
+    return semaphores->wait(owner, handles, values, count, waitAll, timeoutMs, signaledIndex);
+}
+
+// ============================================================================
+// Submission Policy
+// ============================================================================
+
+bool NVDAAL::setSubmitPolicy(const NvCoalescePolicy *policy) {
+    if (!channelCount || !policy) return false;
+    for (uint32_t i = 0; i < channelCount; i++) channels[i]->setCoalescePolicy(policy);
+    for (uint32_t i = 0; i < copyChannelCount; i++) copyChannels[i]->setCoalescePolicy(policy);
+    return true;
+}
+
+void NVDAAL::flushSubmissions(void) {
+    for (uint32_t i = 0; i < channelCount; i++) channels[i]->flush();
+    for (uint32_t i = 0; i < copyChannelCount; i++) copyChannels[i]->flush();
+}
 
     // ============================================================================
 
@@ -8,11 +8,14 @@
 #include <IOKit/IOService.h>
 #include <IOKit/pci/IOPCIDevice.h>
 #include <IOKit/IOInterruptEventSource.h>
+#include <IOKit/IOTimerEventSource.h>
 #include "NVDAALGsp.h"
 #include "NVDAALMemory.h"
 #include "NVDAALChannel.h"
 #include "NVDAALVASpace.h"
 #include "NVDAALDisplay.h"
+#include "NVDAALSemaphore.h"
+#include "NVDAALUserShared.h"
 
 class NVDAAL : public IOService {
     OSDeclareDefaultStructors(NVDAAL);
@@ -46,14 +49,42 @@ private:
     NVDAALGsp *gsp;
     NVDAALMemory *memory;
     NVDAALVASpace *vaSpace;
-    NVDAALChannel *channel;
+    NVDAALChannel *channels[NVDAAL_MAX_CHANNELS];  // [0] also runs SubmitCommand
+    uint32_t channelCount;
+    NVDAALChannel *copyChannels[NVDAAL_MAX_COPY_CHANNELS];
+    uint32_t copyChannelCount;
     NVDAALDisplay *display;
+    NVDAALSemaphorePool *semaphores;
+
+    // Sysmem outlives the client that allocated it: the VASpace cannot
+    // clear PTEs or fence the channels yet, so closed clients' pages stay
+    // wired and mapped until free(). sysmemWired counts every byte ever
+    // mapped and is never given back.
+    IOLock *sysmemLock;
+    OSArray *retiredSysmem;
+    uint64_t sysmemWired;
 
     // Interrupts
     IOInterruptEventSource *interruptSource;
     static void handleInterrupt(OSObject *target, IOInterruptEventSource *source, int count);
     void processInterrupt();
 
+    // Async notifications: semaphore watches are re-checked on every
+    // semaphore interrupt and by this timer in case an interrupt is lost
+    IOTimerEventSource *notifyTimer;
+    static const uint32_t kNotifyPollMs = 10;
+    static void notifyTimerFired(OSObject *owner, IOTimerEventSource *sender);
+    static void gspEventHandler(void *context, uint32_t function, uint32_t rpcResult);
+
+    // Call statistics across all user clients, republished to the
+    // IORegistry (with each client's own) while calls keep arriving
+    NvdaalStats globalStats;
+    uint64_t statsPublishedCalls;
+    IOTimerEventSource *statsTimer;
+    static const uint32_t kStatsPublishMs = 1000;
+    static void statsTimerFired(OSObject *owner, IOTimerEventSource *sender);
+    void publishStats(void);
+
     // State
     bool computeReady;
 
@@ -77,6 +108,9 @@ private:
     void unmapBARs(void);
     bool identifyChip(void);
     bool initCompute(void);
+    static const uint32_t kComputeChannels = 4;   // Booted for streams; only channel 0 is required
+    static const uint32_t kCopyChannels = 1;      // Optional: copies fall back to the compute channels' GRCE
+    NVDAALChannel *channelAt(uint32_t channelIndex);  // Compute index or NVDAAL_CHANNEL_COPY | n
 
     // Register access
     uint32_t readReg(uint32_t offset);
@@ -102,14 +136,47 @@ public:
 
     // Interface for User Client
     bool loadGspFirmware(const void *data, size_t size);
-    int loadGspFirmwareEx(const void *data, size_t size);  // Returns error stage (0=success)
+    int loadGspFirmwareEx(const void *data, size_t size,   // Returns error stage (0=success)
+                          IOMemoryDescriptor *wired = nullptr);  // Borrowed until GSP is up
     bool loadBootloader(const void *data, size_t size);
     bool loadBooterLoad(const void *data, size_t size);    // SEC2 booter firmware
     bool loadVbios(const void *data, size_t size);         // VBIOS for FWSEC
     bool executeFwsec(void);                               // Execute FWSEC-FRTS to configure WPR2
     uint64_t allocVram(size_t size);
+    uint64_t mapVram(uint64_t offset, size_t size);        // Returns GPU VA (0 = failure)
+    void unmapVram(uint64_t gpuVa, size_t size);
+    IOMemoryDescriptor* createVramUserDescriptor(uint64_t offset, size_t size);  // Caller releases
+    uint64_t mapSysmem(IOMemoryDescriptor *desc);          // Wired host pages; returns GPU VA (0 = failure)
+    void retireSysmem(IOMemoryDescriptor *desc);           // Keeps the pages wired and mapped until free()
     bool submitCommand(uint32_t cmd);
-    bool waitSemaphore(uint64_t gpuAddr, uint32_t value, uint32_t timeoutMs);
+    bool submitCommand(uint32_t cmd, OSObject *owner, uint32_t signalHandle, uint64_t signalValue);
+    bool submitPushbuffer(uint32_t channelIndex, uint64_t gpuVa, uint32_t bytes, OSObject *owner,
+                          uint32_t signalHandle, uint64_t signalValue);
+    uint32_t getChannelCount(void) const { return channelCount; }
+    uint32_t getCopyChannelCount(void) const { return copyChannelCount; }
+
+    // Timeline semaphores (owner = user client that created them)
+    bool createSemaphore(OSObject *owner, uint64_t initialValue, uint32_t *handle, uint64_t *gpuVa);
+    bool destroySemaphore(OSObject *owner, uint32_t handle);
+    void destroySemaphores(OSObject *owner);
+    bool signalSemaphore(OSObject *owner, uint32_t handle, uint64_t value);
+    bool readSemaphore(OSObject *owner, uint32_t handle, uint64_t *value);
+    IOReturn waitSemaphore(OSObject *owner, uint64_t gpuAddr, uint64_t value, uint32_t timeoutMs);
+    IOReturn waitSemaphores(OSObject *owner, const uint32_t *handles, const uint64_t *values,
+                            uint32_t count, bool waitAll, uint32_t timeoutMs, uint32_t *signaledIndex);
+
+    // Async notifications to user clients (NVDAAL_NOTIFY_*)
+    bool pollSemaphoreNotifications(void);          // true while watches remain
+    void scheduleNotificationPoll(void);
+    void broadcastNotification(uint32_t kind, uint64_t value0, uint64_t value1);
+
+    // User-client call statistics (updated by NVDAALUserClient::externalMethod)
+    NvdaalStats *getGlobalStats(void) { return &globalStats; }
+
+    // Submission coalescing (doorbell batching), same policy on every channel,
+    // copy channels included
+    bool setSubmitPolicy(const NvCoalescePolicy *policy);
+    void flushSubmissions(void);
 
     // Status reporting (for debugging WPR2/GSP state)
     struct GpuStatus {
@@ -1,5 +1,5 @@
 /*
- * NVDAALChannel.cpp - Compute Channel Implementation
+ * NVDAALChannel.cpp - Compute and Copy Channel Implementation
  */
 
 #include "NVDAALChannel.h"
@@ -10,11 +10,15 @@
 
 OSDefineMetaClassAndStructors(NVDAALChannel, OSObject);
 
-NVDAALChannel* NVDAALChannel::withVASpace(NVDAALGsp *gsp, NVDAALVASpace *vaSpace, uint32_t hClient, uint32_t hDevice) {
+NVDAALChannel* NVDAALChannel::withVASpace(NVDAALGsp *gsp, NVDAALVASpace *vaSpace, NVDAALSemaphorePool *semaphores,
+                                          uint32_t hClient, uint32_t hDevice, uint32_t engineType) {
     NVDAALChannel *inst = new NVDAALChannel;
     if (inst) {
+        inst->engineType = engineType;
         inst->gsp = gsp;
         inst->vaSpace = vaSpace;
+        inst->semaphores = semaphores;
+        if (semaphores) semaphores->retain();
         inst->hClient = hClient;
         inst->hDevice = hDevice;
         if (!inst->init()) {
@@ -34,11 +38,34 @@ bool NVDAALChannel::init() {
     
     lock = IOLockAlloc();
     if (!lock) return false;
+
+    pbLock = IOLockAlloc();
+    if (!pbLock) return false;
+
+    pbHead = 0;
+    pbTail = 0;
+    recFirst = 0;
+    recCount = 0;
+    lastFence = 0;
+
+    nvCoalescePolicyDisabled(&coalescePolicy);
+    bzero(&coalesceState, sizeof(coalesceState));
+    workLoop = nullptr;
+    flushTimer = nullptr;
+    flushTimerArmed = false;
+    doorbells = 0;
     
     return true;
 }
 
 void NVDAALChannel::free() {
+    detachWorkLoop();
+    if (hCompute) {
+        gsp->rmFree(hClient, hChannel, hCompute);
+    }
+    if (hEngine) {
+        gsp->rmFree(hClient, hChannel, hEngine);
+    }
     if (hChannel) {
         gsp->rmFree(hClient, hSubDevice, hChannel);
     }
@@ -55,7 +82,17 @@ void NVDAALChannel::free() {
         userdMem->complete();
         userdMem->release();
     }
+    if (pbMem) {
+        if (pbGpuVa) vaSpace->unmap(pbGpuVa, kPushbufferSize);
+        pbMem->complete();
+        pbMem->release();
+    }
+    if (semaphores) {
+        if (fenceHandle) semaphores->destroy(this, fenceHandle);
+        semaphores->release();
+    }
     if (lock) IOLockFree(lock);
+    if (pbLock) IOLockFree(pbLock);
     
     super::free();
 }
@@ -63,7 +100,7 @@ void NVDAALChannel::free() {
 bool NVDAALChannel::boot() {
     if (!gsp || !vaSpace) return false;
 
-    IOLog("NVDAAL-Channel: Booting Compute Channel...\n");
+    IOLog("NVDAAL-Channel: Booting %s Channel...\n", isCopy() ? "Copy" : "Compute");
 
     // 1. Allocate SubDevice
     hSubDevice = gsp->nextHandle();
@@ -119,7 +156,7 @@ bool NVDAALChannel::boot() {
     NvChannelAllocParams chanParams;
     memset(&chanParams, 0, sizeof(chanParams));
     chanParams.ampMode = 1; // Ampere+
-    chanParams.engineType = NV2080_ENGINE_TYPE_COMPUTE;
+    chanParams.engineType = engineType;
     chanParams.gpFifoOffset = 0; // We will use manual put/get or update via UserD
     chanParams.gpFifoEntries = ringSize;
     chanParams.flags = 0;
@@ -138,30 +175,349 @@ bool NVDAALChannel::boot() {
     }
 
     IOLog("NVDAAL-Channel: Channel created (Handle: 0x%x)\n", hChannel);
+
+    // 6. Pushbuffer arena + fence
+    if (!allocPushbuffer()) {
+        IOLog("NVDAAL-Channel: Failed to set up pushbuffer arena\n");
+        return false;
+    }
+
+    // 7. The classes client pushbuffers address, on their subchannels
+    if (!bindEngines()) {
+        IOLog("NVDAAL-Channel: Failed to bind the %s\n", isCopy() ? "copy engine" : "compute and GRCE classes");
+        return false;
+    }
+    return true;
+}
+
+// Allocate the class objects this channel's subchannels use and bind them
+// once, ahead of any client pushbuffer: the copy class on NV_PB_SUBCH_COPY
+// (the copy engine itself on copy channels, the GRCE that shares the
+// graphics runlist on compute channels) and, on compute channels,
+// ADA_COMPUTE_A on NV_PB_SUBCH_COMPUTE
+bool NVDAALChannel::bindEngines() {
+    hEngine = gsp->nextHandle();
+    NvCopyAllocParams copyParams;
+    memset(&copyParams, 0, sizeof(copyParams));
+    copyParams.engineType = NV2080_ENGINE_TYPE_COPY;
+    if (!gsp->rmAlloc(hClient, hChannel, hEngine, AMPERE_DMA_COPY_B, &copyParams, sizeof(copyParams))) {
+        hEngine = 0;
+        return false;
+    }
+
+    if (!isCopy()) {
+        hCompute = gsp->nextHandle();
+        if (!gsp->rmAlloc(hClient, hChannel, hCompute, ADA_COMPUTE_A, nullptr, 0)) {
+            hCompute = 0;
+            return false;
+        }
+    }
+
+    uint32_t objects = isCopy() ? 1 : 2;
+    NvPushbuffer pb;
+    if (!beginPush(objects * NV_PB_SET_OBJECT_DWORDS * sizeof(uint32_t), &pb)) return false;
+    if (!isCopy()) nvPbPushSetObject(&pb, NV_PB_SUBCH_COMPUTE, ADA_COMPUTE_A);
+    nvPbPushSetObject(&pb, NV_PB_SUBCH_COPY, AMPERE_DMA_COPY_B);
+    uint64_t fence = endPush(&pb);
+    return fence && waitFence(fence, 1000) == kIOReturnSuccess;
+}
+
+bool NVDAALChannel::allocPushbuffer() {
+    if (!semaphores) return false;
+
+    pbMem = IOBufferMemoryDescriptor::inTaskWithPhysicalMask(
+        kernel_task,
+        kIODirectionInOut | kIOMemoryPhysicallyContiguous,
+        kPushbufferSize,
+        0xFFFFFFFFFFFFULL
+    );
+    if (!pbMem || pbMem->prepare() != kIOReturnSuccess) return false;
+    pbCpu = (uint8_t *)pbMem->getBytesNoCopy();
+
+    pbGpuVa = vaSpace->map(pbMem, 0x1000);
+    if (!pbGpuVa) return false;
+
+    if (!semaphores->create(this, 0, &fenceHandle, &fenceGpuVa) || !fenceGpuVa) {
+        IOLog("NVDAAL-Channel: No GPU-visible fence semaphore\n");
+        return false;
+    }
+
+    IOLog("NVDAAL-Channel: Pushbuffer arena %u KB @ GPU VA 0x%llx, fence @ 0x%llx\n",
+          kPushbufferSize / 1024, pbGpuVa, fenceGpuVa);
     return true;
 }
 
-bool NVDAALChannel::submit(uint64_t pbGpuAddr, uint32_t pbLength) {
+// Caller holds pbLock. Writes `count` GPFIFO entries as one unit: all of
+// them, or none if the ring lacks a free slot for every one. *putAfter is
+// the GPFIFO index just past them, where GET stands once they have run.
+bool NVDAALChannel::submitEntries(const uint64_t *pbGpuAddr, const uint32_t *pbLength, uint32_t count,
+                                  uint32_t *putAfter) {
     IOLockLock(lock);
+
+    // One slot stays empty so a full ring is distinguishable from an empty one
+    uint32_t used = (put + ringSize - get) % ringSize;
+    if (count > ringSize - 1 - used) {
+        IOLockUnlock(lock);
+        IOLog("NVDAAL-Channel: GPFIFO full (%u entries in flight)\n", used);
+        return false;
+    }
+
+    uint64_t now;
+    absolutetime_to_nanoseconds(mach_absolute_time(), &now);
+    bool kick = false;
+    for (uint32_t i = 0; i < count; i++) {
+        // Format the GPFIFO Entry (Excellence!)
+        // Address must be aligned? Usually yes.
+        gpfifoRing[put].address = pbGpuAddr[i];
+        gpfifoRing[put].length = pbLength[i];
+        gpfifoRing[put].flags = 1; // Trigger fetch (GPFIFO_ENTRY_FLAG_FETCH)
+
+        put = (put + 1) % ringSize;
+        if (nvCoalesceSubmit(&coalescePolicy, &coalesceState, pbLength[i], now) != NV_COALESCE_HOLD) kick = true;
+    }
+    *putAfter = put;
+
+    // Ring the doorbell now, once every entry is written, or hold it for more
+    if (kick) {
+        ringDoorbell();
+    } else if (flushTimer && !flushTimerArmed && coalescePolicy.deadlineUs) {
+        flushTimerArmed = true;
+        flushTimer->setTimeoutUS(coalescePolicy.deadlineUs);
+    }
     
-    // Format the GPFIFO Entry (Excellence!)
-    // Address must be aligned? Usually yes.
-    gpfifoRing[put].address = pbGpuAddr;
-    gpfifoRing[put].length = pbLength;
-    gpfifoRing[put].flags = 1; // Trigger fetch (GPFIFO_ENTRY_FLAG_FETCH)
-    
-    // Memory Barrier to ensure entry is written before doorbell
+    IOLockUnlock(lock);
+    return true;
+}
+
+void NVDAALChannel::ringDoorbell() {
+    // Memory Barrier to ensure entries are written before doorbell
     __sync_synchronize();
 
-    put = (put + 1) % ringSize;
-    
-    // Ring the doorbell
     // Write the new PUT value to the UserD or GSP register
     if (userd) {
         userd[0] = put; // Offset 0 is usually Put
         __sync_synchronize();
     }
-    
-    IOLockUnlock(lock);
+    doorbells++;
+    nvCoalesceReset(&coalesceState);
+}
+
+// ============================================================================
+// Submission Coalescing
+// ============================================================================
+
+bool NVDAALChannel::attachWorkLoop(IOWorkLoop *wl) {
+    if (!wl || flushTimer) return false;
+
+    flushTimer = IOTimerEventSource::timerEventSource(this, flushTimerFired);
+    if (!flushTimer || wl->addEventSource(flushTimer) != kIOReturnSuccess) {
+        if (flushTimer) {
+            flushTimer->release();
+            flushTimer = nullptr;
+        }
+        return false;
+    }
+    workLoop = wl;
     return true;
 }
+
+void NVDAALChannel::detachWorkLoop() {
+    if (!flushTimer) return;
+    flushTimer->cancelTimeout();
+    workLoop->removeEventSource(flushTimer);
+    flushTimer->release();
+    flushTimer = nullptr;
+    workLoop = nullptr;
+}
+
+void NVDAALChannel::flushTimerFired(OSObject *owner, IOTimerEventSource *sender) {
+    NVDAALChannel *inst = OSDynamicCast(NVDAALChannel, owner);
+    if (!inst) return;
+
+    IOLockLock(inst->lock);
+    inst->flushTimerArmed = false;
+    // May fire early relative to a batch started after a threshold flush;
+    // publishing early only trims latency.
+    if (inst->coalesceState.pendingEntries) {
+        inst->ringDoorbell();
+    }
+    IOLockUnlock(inst->lock);
+}
+
+void NVDAALChannel::setCoalescePolicy(const NvCoalescePolicy *policy) {
+    if (!policy) return;
+
+    IOLockLock(lock);
+    coalescePolicy = *policy;
+    // Held entries must never outnumber the free GPFIFO slots, nor the
+    // arena's in-flight records (beginPush() waits on the oldest)
+    if (coalescePolicy.maxEntries > ringSize / 2) coalescePolicy.maxEntries = ringSize / 2;
+    if (coalescePolicy.maxEntries > kMaxInflight) coalescePolicy.maxEntries = kMaxInflight;
+    if (coalesceState.pendingEntries) ringDoorbell();
+    IOLockUnlock(lock);
+
+    IOLog("NVDAAL-Channel: Coalescing %s (entries=%u bytes=%u deadline=%uus%s)\n",
+          nvCoalesceEnabled(&coalescePolicy) ? "on" : "off",
+          coalescePolicy.maxEntries, coalescePolicy.maxBytes, coalescePolicy.deadlineUs,
+          (coalescePolicy.flags & NV_COALESCE_FLAG_ADAPTIVE) ? " adaptive" : "");
+}
+
+void NVDAALChannel::getCoalescePolicy(NvCoalescePolicy *policy) {
+    if (!policy) return;
+    IOLockLock(lock);
+    *policy = coalescePolicy;
+    IOLockUnlock(lock);
+}
+
+void NVDAALChannel::flush(void) {
+    IOLockLock(lock);
+    if (coalesceState.pendingEntries) ringDoorbell();
+    IOLockUnlock(lock);
+}
+
+// ============================================================================
+// Pushbuffer Arena
+// ============================================================================
+
+uint64_t NVDAALChannel::completedFence(void) {
+    uint64_t value = 0;
+    if (semaphores && fenceHandle) semaphores->read(this, fenceHandle, &value);
+    return value;
+}
+
+IOReturn NVDAALChannel::waitFence(uint64_t value, uint32_t timeoutMs) {
+    if (!semaphores || !fenceHandle) return kIOReturnNotReady;
+    if (value > lastFence) return kIOReturnBadArgument;  // Would never signal
+    flush();
+    return semaphores->wait(this, &fenceHandle, &value, 1, true, timeoutMs, nullptr);
+}
+
+// Caller holds pbLock
+void NVDAALChannel::retireCompleted() {
+    if (recCount == 0) return;
+
+    uint64_t done = completedFence();
+    bool retired = false;
+    uint32_t consumed = 0;
+    while (recCount && records[recFirst].fence <= done) {
+        pbTail = records[recFirst].end;
+        consumed = records[recFirst].gpfifoEnd;
+        retired = true;
+        recFirst = (recFirst + 1) % kMaxInflight;
+        recCount--;
+    }
+
+    // The GPU has fetched every GPFIFO entry up to the last retired one
+    if (retired) {
+        IOLockLock(lock);
+        get = consumed;
+        IOLockUnlock(lock);
+    }
+
+    // Idle ring: restart at 0 so large reservations stay contiguous
+    if (recCount == 0) {
+        pbHead = 0;
+        pbTail = 0;
+    }
+}
+
+// Caller holds pbLock. In-flight bytes are [pbTail, pbHead), wrapping.
+bool NVDAALChannel::findSpace(uint32_t bytes, uint32_t *offset) {
+    if (recCount >= kMaxInflight) return false;
+
+    if (recCount == 0) {
+        *offset = 0;
+        return bytes <= kPushbufferSize;
+    }
+    if (pbHead > pbTail) {
+        if (kPushbufferSize - pbHead >= bytes) {
+            *offset = pbHead;
+            return true;
+        }
+        // Skip the tail fragment; it is reclaimed when pbTail passes it
+        if (pbTail >= bytes) {
+            *offset = 0;
+            return true;
+        }
+        return false;
+    }
+    if (pbHead < pbTail && pbTail - pbHead >= bytes) {
+        *offset = pbHead;
+        return true;
+    }
+    return false;  // pbHead == pbTail with work in flight: full
+}
+
+bool NVDAALChannel::beginPush(uint32_t bytes, NvPushbuffer *pb, uint32_t timeoutMs) {
+    if (!pb || !pbCpu || !fenceHandle) return false;
+
+    // Room for the fence release endPush() appends
+    uint32_t need = bytes + NV_PB_SEMAPHORE_RELEASE_DWORDS * sizeof(uint32_t);
+    need = (need + kPushAlign - 1) & ~(kPushAlign - 1);
+    if (need > kPushbufferSize) return false;
+
+    IOLockLock(pbLock);
+    uint32_t offset = 0;
+    for (;;) {
+        retireCompleted();
+        if (findSpace(need, &offset)) break;
+
+        // Genuinely full: block on the oldest submission's fence, once any
+        // entry the coalescer is holding back has reached the doorbell
+        flush();
+        uint64_t oldest = records[recFirst].fence;
+        if (semaphores->wait(this, &fenceHandle, &oldest, 1, true, timeoutMs, nullptr) != kIOReturnSuccess) {
+            IOLog("NVDAAL-Channel: Pushbuffer arena full, fence %llu timed out\n", oldest);
+            IOLockUnlock(pbLock);
+            return false;
+        }
+    }
+
+    pbOpen = offset;
+    nvPbInit(pb, pbCpu + offset, need);
+    pb->end -= NV_PB_SEMAPHORE_RELEASE_DWORDS;   // Reserved for the fence
+    return true;  // pbLock stays held until endPush()/abortPush()
+}
+
+uint64_t NVDAALChannel::endPush(NvPushbuffer *pb, uint64_t prefixGpuVa, uint32_t prefixBytes) {
+    pb->end += NV_PB_SEMAPHORE_RELEASE_DWORDS;
+
+    uint64_t fence = lastFence + 1;
+    nvPbPushSemaphoreRelease(pb, fenceGpuVa, fence, true);
+
+    uint32_t used = (uint32_t)nvPbBytesUsed(pb);
+    uint32_t end = pbOpen + ((used + kPushAlign - 1) & ~(kPushAlign - 1));
+
+    // The prefix and arena entries go in together or not at all: a prefix
+    // published without the arena entry would run with no fence behind it
+    uint64_t entryVa[2];
+    uint32_t entryBytes[2];
+    uint32_t entries = 0;
+    if (prefixGpuVa) {
+        entryVa[entries] = prefixGpuVa;
+        entryBytes[entries++] = prefixBytes;
+    }
+    entryVa[entries] = pbGpuVa + pbOpen;
+    entryBytes[entries++] = used;
+
+    uint32_t gpfifoEnd;
+    if (!submitEntries(entryVa, entryBytes, entries, &gpfifoEnd)) {
+        IOLockUnlock(pbLock);
+        return 0;
+    }
+
+    uint32_t slot = (recFirst + recCount) % kMaxInflight;
+    records[slot].end = end;
+    records[slot].gpfifoEnd = gpfifoEnd;
+    records[slot].fence = fence;
+    recCount++;
+    pbHead = end;
+    lastFence = fence;
+
+    IOLockUnlock(pbLock);
+    return fence;
+}
+
+void NVDAALChannel::abortPush(void) {
+    IOLockUnlock(pbLock);
+}
@@ -1,16 +1,25 @@
 /*
- * NVDAALChannel.h - Compute Channel (GPFIFO)
+ * NVDAALChannel.h - Compute and Copy Channels (GPFIFO)
  *
  * Implements a hardware channel for submitting work to the GPU.
  * Uses the GSP RM hierarchy: Client -> Device -> SubDevice -> Channel.
+ * Boot binds ADA_COMPUTE_A to NV_PB_SUBCH_COMPUTE and the graphics
+ * engine's copy engine (GRCE) to NV_PB_SUBCH_COPY. A copy channel runs
+ * on an asynchronous copy engine instead of the graphics/compute engine
+ * and has only the copy class bound to NV_PB_SUBCH_COPY, so DMA overlaps
+ * compute work.
  */
 
 #ifndef NVDAAL_CHANNEL_H
 #define NVDAAL_CHANNEL_H
 
 #include <IOKit/IOService.h>
+#include <IOKit/IOTimerEventSource.h>
 #include "NVDAALGsp.h"
 #include "NVDAALVASpace.h"
+#include "NVDAALSemaphore.h"
+#include "NVDAALPushbuffer.h"
+#include "NVDAALCoalesce.h"
 
 class NVDAALChannel : public OSObject {
     OSDeclareDefaultStructors(NVDAALChannel);
@@ -24,6 +33,10 @@ private:
     uint32_t hDevice;
     uint32_t hSubDevice;
     uint32_t hChannel;
+    uint32_t hEngine;       // Copy class object (GRCE on compute channels)
+    uint32_t hCompute;      // ADA_COMPUTE_A object (compute channels only)
+
+    uint32_t engineType;    // NV2080_ENGINE_TYPE_*
 
     // Hardware GPFIFO Entry Format (16 bytes)
     struct NvGpfifoEntry {
@@ -38,7 +51,7 @@ private:
     volatile NvGpfifoEntry *gpfifoRing; // Updated to use proper struct
     uint32_t ringSize;
     uint32_t put;
-    uint32_t get;
+    uint32_t get;           // Past the last entry known fetched (retired fences)
 
     // User Doorbell (UserD)
     IOBufferMemoryDescriptor *userdMem;
@@ -47,8 +60,57 @@ private:
 
     IOLock *lock;
 
+    // Pushbuffer arena: a sysmem ring shared by all submissions on this
+    // channel. Each submission ends with a fence release; space behind a
+    // signalled fence is reclaimed, so steady state needs no allocation.
+    struct PushRecord {
+        uint32_t end;       // Arena offset just past this submission
+        uint32_t gpfifoEnd; // GPFIFO index just past its entries
+        uint64_t fence;     // Fence value released when it completes
+    };
+
+    static const uint32_t kPushbufferSize = 0x100000;   // 1MB
+    static const uint32_t kMaxInflight = 256;
+    static const uint32_t kPushAlign = 8;
+
+    NVDAALSemaphorePool *semaphores;                    // Retained
+    IOBufferMemoryDescriptor *pbMem;
+    uint8_t *pbCpu;
+    uint64_t pbGpuVa;
+    uint32_t pbHead;        // Next free byte
+    uint32_t pbTail;        // Start of the oldest in-flight submission
+    uint32_t pbOpen;        // Offset of the reservation handed out by beginPush
+    PushRecord records[kMaxInflight];
+    uint32_t recFirst;
+    uint32_t recCount;
+    IOLock *pbLock;         // Held from beginPush() to endPush()/abortPush()
+
+    // Channel fence (timeline semaphore owned by this channel)
+    uint32_t fenceHandle;
+    uint64_t fenceGpuVa;
+    uint64_t lastFence;
+
+    // Submission coalescing: GPFIFO entries are written immediately but the
+    // doorbell is deferred per policy (see NVDAALCoalesce.h). Guarded by lock.
+    NvCoalescePolicy coalescePolicy;
+    NvCoalesceState coalesceState;
+    IOWorkLoop *workLoop;
+    IOTimerEventSource *flushTimer;
+    bool flushTimerArmed;
+    uint64_t doorbells;
+
+    bool allocPushbuffer();
+    bool bindEngines();
+    void retireCompleted();
+    bool findSpace(uint32_t bytes, uint32_t *offset);
+    bool submitEntries(const uint64_t *pbGpuAddr, const uint32_t *pbLength, uint32_t count, uint32_t *putAfter);
+    void ringDoorbell();    // Caller holds lock
+    static void flushTimerFired(OSObject *owner, IOTimerEventSource *sender);
+
 public:
-    static NVDAALChannel* withVASpace(NVDAALGsp *gsp, NVDAALVASpace *vaSpace, uint32_t hClient, uint32_t hDevice);
+    static NVDAALChannel* withVASpace(NVDAALGsp *gsp, NVDAALVASpace *vaSpace, NVDAALSemaphorePool *semaphores,
+                                      uint32_t hClient, uint32_t hDevice,
+                                      uint32_t engineType = NV2080_ENGINE_TYPE_COMPUTE);
 
     virtual bool init() override;
     virtual void free() override;
@@ -56,10 +118,32 @@ public:
     // Create the channel object via GSP RPC
     bool boot();
 
-    // Submit work (PushBuffer) to the channel
-    bool submit(uint64_t pbGpuAddr, uint32_t pbLength);
+    // Arena submission: reserve `bytes` of pushbuffer (blocking only while
+    // the ring is genuinely full), encode into `pb`, then endPush() appends
+    // the fence release and kicks the GPFIFO. Returns the fence value (0 on
+    // failure). A non-zero `prefixGpuVa` submits that caller-owned segment
+    // ahead of the arena one, under the same fence.
+    bool beginPush(uint32_t bytes, NvPushbuffer *pb, uint32_t timeoutMs = 1000);
+    uint64_t endPush(NvPushbuffer *pb, uint64_t prefixGpuVa = 0, uint32_t prefixBytes = 0);
+    void abortPush(void);
+
+    // Coalescing. attachWorkLoop() enables deadline flushes; without it only
+    // thresholds and explicit flush() publish held entries. detachWorkLoop()
+    // cancels a pending deadline and takes the timer off the work loop.
+    bool attachWorkLoop(IOWorkLoop *workLoop);
+    void detachWorkLoop(void);
+    void setCoalescePolicy(const NvCoalescePolicy *policy);
+    void getCoalescePolicy(NvCoalescePolicy *policy);
+    void flush(void);
+    uint64_t getDoorbellCount() const { return doorbells; }
+
+    // Fences (waitFence flushes first)
+    uint64_t completedFence(void);
+    IOReturn waitFence(uint64_t value, uint32_t timeoutMs);
+    uint64_t getLastFence() const { return lastFence; }
 
     uint32_t getHandle() const { return hChannel; }
+    bool isCopy() const { return engineType == NV2080_ENGINE_TYPE_COPY; }
 };
 
 #endif // NVDAAL_CHANNEL_H
\ No newline at end of file
@@ -0,0 +1,121 @@
+/*
+ * NVDAALCoalesce.h - GPFIFO Submission Coalescing Policy
+ *
+ * Decides when a channel should ring its doorbell (publish GPPUT) after
+ * GPFIFO entries have been written. Entries are always written to the
+ * ring immediately; only the doorbell is deferred, so one doorbell can
+ * publish many small submissions.
+ *
+ * A flush happens when any of these is hit:
+ *   - pending entry count reaches maxEntries
+ *   - pending pushbuffer bytes reach maxBytes
+ *   - the oldest pending entry is deadlineUs old
+ *   - an explicit flush or a wait on the channel
+ *   - (adaptive) submissions are arriving slower than the deadline, so
+ *     holding would only add latency without batching anything
+ *
+ * Plain C with no IOKit dependencies: the kext drives it from
+ * NVDAALChannel and TestEnv/userspace/bench_coalesce.cpp simulates it.
+ */
+
+#ifndef NVDAAL_COALESCE_H
+#define NVDAAL_COALESCE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define NV_COALESCE_FLAG_ADAPTIVE       0x1
+
+// Defaults when coalescing is enabled without explicit limits
+#define NV_COALESCE_DEFAULT_ENTRIES     32
+#define NV_COALESCE_DEFAULT_BYTES       (64 * 1024)
+#define NV_COALESCE_DEFAULT_DEADLINE_US 50
+
+typedef struct {
+    uint32_t maxEntries;    // <= 1 disables coalescing (doorbell per submit)
+    uint32_t maxBytes;      // 0 = no byte threshold
+    uint32_t deadlineUs;    // 0 = no deadline (flush on thresholds/explicit only)
+    uint32_t flags;         // NV_COALESCE_FLAG_*
+} NvCoalescePolicy;
+
+typedef struct {
+    uint32_t pendingEntries;
+    uint32_t pendingBytes;
+    uint64_t firstPendingNs;    // Submit time of the oldest unpublished entry
+    uint64_t lastSubmitNs;
+    uint64_t gapEwmaNs;         // Smoothed inter-submission gap (adaptive mode)
+} NvCoalesceState;
+
+typedef enum {
+    NV_COALESCE_HOLD = 0,
+    NV_COALESCE_FLUSH_DISABLED,
+    NV_COALESCE_FLUSH_COUNT,
+    NV_COALESCE_FLUSH_BYTES,
+    NV_COALESCE_FLUSH_DEADLINE,
+    NV_COALESCE_FLUSH_IDLE,         // Adaptive: traffic too sparse to batch
+    NV_COALESCE_FLUSH_EXPLICIT
+} NvCoalesceDecision;
+
+static inline void nvCoalescePolicyDisabled(NvCoalescePolicy *p) {
+    p->maxEntries = 1;
+    p->maxBytes = 0;
+    p->deadlineUs = 0;
+    p->flags = 0;
+}
+
+static inline bool nvCoalesceEnabled(const NvCoalescePolicy *p) {
+    return p->maxEntries > 1;
+}
+
+static inline void nvCoalesceReset(NvCoalesceState *s) {
+    s->pendingEntries = 0;
+    s->pendingBytes = 0;
+    s->firstPendingNs = 0;
+}
+
+// Absolute time at which pending work must be flushed (0 = none pending/no deadline)
+static inline uint64_t nvCoalesceDeadlineNs(const NvCoalescePolicy *p, const NvCoalesceState *s) {
+    if (!s->pendingEntries || !p->deadlineUs) return 0;
+    return s->firstPendingNs + (uint64_t)p->deadlineUs * 1000;
+}
+
+/*
+ * Account one submission of `bytes` at time `nowNs` and decide whether the
+ * doorbell should be rung now. On any FLUSH decision the caller rings the
+ * doorbell and calls nvCoalesceReset(). On HOLD it should make sure a
+ * timer fires at nvCoalesceDeadlineNs().
+ */
+static inline NvCoalesceDecision nvCoalesceSubmit(const NvCoalescePolicy *p, NvCoalesceState *s,
+                                                  uint32_t bytes, uint64_t nowNs) {
+    // Gap EWMA with weight 1/8, seeded by the first observed gap
+    if (s->lastSubmitNs) {
+        uint64_t gap = nowNs > s->lastSubmitNs ? nowNs - s->lastSubmitNs : 0;
+        s->gapEwmaNs = s->gapEwmaNs ? s->gapEwmaNs - (s->gapEwmaNs >> 3) + (gap >> 3) : gap;
+    }
+    s->lastSubmitNs = nowNs;
+
+    if (!nvCoalesceEnabled(p)) return NV_COALESCE_FLUSH_DISABLED;
+
+    if (s->pendingEntries == 0) s->firstPendingNs = nowNs;
+    s->pendingEntries++;
+    s->pendingBytes += bytes;
+
+    if (s->pendingEntries >= p->maxEntries) return NV_COALESCE_FLUSH_COUNT;
+    if (p->maxBytes && s->pendingBytes >= p->maxBytes) return NV_COALESCE_FLUSH_BYTES;
+    if (p->deadlineUs && nowNs - s->firstPendingNs >= (uint64_t)p->deadlineUs * 1000) {
+        return NV_COALESCE_FLUSH_DEADLINE;
+    }
+    if ((p->flags & NV_COALESCE_FLAG_ADAPTIVE) && p->deadlineUs &&
+        s->gapEwmaNs > (uint64_t)p->deadlineUs * 1000) {
+        return NV_COALESCE_FLUSH_IDLE;
+    }
+    return NV_COALESCE_HOLD;
+}
+
+// Timer/poll check: true if pending work has reached its deadline
+static inline bool nvCoalesceExpired(const NvCoalescePolicy *p, const NvCoalesceState *s, uint64_t nowNs) {
+    uint64_t deadline = nvCoalesceDeadlineNs(p, s);
+    return deadline && nowNs >= deadline;
+}
+
+#endif // NVDAAL_COALESCE_H
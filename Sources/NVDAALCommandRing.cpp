@@ -0,0 +1,92 @@
+/*
+ * NVDAALCommandRing.cpp - Shared-Memory Command Ring Implementation
+ */
+
+#include "NVDAALCommandRing.h"
+#include <IOKit/IOLib.h>
+
+#define super OSObject
+
+OSDefineMetaClassAndStructors(NVDAALCommandRing, OSObject);
+
+NVDAALCommandRing* NVDAALCommandRing::withDefaultSize(void) {
+    NVDAALCommandRing *inst = new NVDAALCommandRing;
+    if (inst) {
+        if (!inst->init()) {
+            inst->release();
+            return nullptr;
+        }
+    }
+    return inst;
+}
+
+bool NVDAALCommandRing::init() {
+    if (!super::init()) return false;
+
+    mem = nullptr;
+    ctl = nullptr;
+    reqTail = 0;
+    cplHead = 0;
+
+    lock = IOLockAlloc();
+    if (!lock) return false;
+
+    mem = IOBufferMemoryDescriptor::withOptions(
+        kIODirectionInOut | kIOMemoryKernelUserShared,
+        NVDAAL_RING_SIZE,
+        0x1000
+    );
+    if (!mem) {
+        IOLog("NVDAALUserClient: Failed to allocate command ring\n");
+        return false;
+    }
+
+    ctl = (NvdaalRingControl *)mem->getBytesNoCopy();
+    memset(ctl, 0, NVDAAL_RING_SIZE);
+    nvRingInit(ctl);
+
+    return true;
+}
+
+void NVDAALCommandRing::free() {
+    if (mem) {
+        mem->release();
+        mem = nullptr;
+    }
+    if (lock) {
+        IOLockFree(lock);
+        lock = nullptr;
+    }
+    super::free();
+}
+
+namespace {
+
+struct DrainTarget {
+    NVDAALCommandRing::Action action;
+    OSObject *target;
+};
+
+int32_t drainAction(void *ctx, const NvdaalOpRequest *req, uint64_t result[2]) {
+    DrainTarget *t = (DrainTarget *)ctx;
+    return t->action(t->target, req, result);
+}
+
+} // namespace
+
+IOReturn NVDAALCommandRing::drain(Action action, OSObject *target, uint32_t budget, uint32_t *processed) {
+    uint32_t done = 0;
+
+    if (!action) return kIOReturnBadArgument;
+
+    DrainTarget ctx = { action, target };
+    IOLockLock(lock);
+    bool ok = nvRingDrain(ctl, &reqTail, &cplHead, budget, drainAction, &ctx, &done);
+    IOLockUnlock(lock);
+
+    if (!ok) {
+        IOLog("NVDAALUserClient: Command ring indices corrupted, ignoring ring\n");
+    }
+    if (processed) *processed = done;
+    return ok ? kIOReturnSuccess : kIOReturnBadArgument;
+}
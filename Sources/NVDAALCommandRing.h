@@ -0,0 +1,48 @@
+/*
+ * NVDAALCommandRing.h - Shared-Memory Request/Completion Rings
+ *
+ * Kernel side of the command ring described in NVDAALUserShared.h. The
+ * ring memory is mapped into the client task; the kernel keeps its own
+ * copies of the indices it owns and treats everything in the shared
+ * page as untrusted.
+ */
+
+#ifndef NVDAAL_COMMAND_RING_H
+#define NVDAAL_COMMAND_RING_H
+
+#include <IOKit/IOService.h>
+#include <IOKit/IOBufferMemoryDescriptor.h>
+#include "NVDAALUserShared.h"
+
+class NVDAALCommandRing : public OSObject {
+    OSDeclareDefaultStructors(NVDAALCommandRing);
+
+public:
+    // Executes one request. `result` is zeroed before the call.
+    typedef IOReturn (*Action)(OSObject *target, const NvdaalOpRequest *req, uint64_t result[2]);
+
+private:
+    IOBufferMemoryDescriptor *mem;
+    NvdaalRingControl *ctl;
+
+    // Authoritative copies of the kernel-owned indices
+    uint32_t reqTail;
+    uint32_t cplHead;
+
+    IOLock *lock;           // Serializes drain() between client threads
+
+public:
+    static NVDAALCommandRing* withDefaultSize(void);
+
+    virtual bool init() override;
+    virtual void free() override;
+
+    IOMemoryDescriptor *getMemoryDescriptor() const { return mem; }
+
+    // Execute queued requests in order until the request ring is empty, the
+    // completion ring is full or `budget` requests were handled (nvRingDrain).
+    // Returns kIOReturnBadArgument if the client corrupted the ring indices.
+    IOReturn drain(Action action, OSObject *target, uint32_t budget, uint32_t *processed);
+};
+
+#endif // NVDAAL_COMMAND_RING_H
@@ -20,10 +20,13 @@ NVDAALGsp::NVDAALGsp(void) {
     gspReady = false;
     rpcSeqNum = 0;
     lastHandle = 0;
+    eventHandler = nullptr;
+    eventContext = nullptr;
 
     cmdQueueMem = nullptr;
     statQueueMem = nullptr;
     firmwareMem = nullptr;
+    firmwareWired = nullptr;
     bootloaderMem = nullptr;
     booterLoadMem = nullptr;
     wprMetaMem = nullptr;
@@ -127,6 +130,7 @@ void NVDAALGsp::free(void) {
     freeDmaBuffer(&booterLoadMem);
     freeDmaBuffer(&bootloaderMem);
     freeDmaBuffer(&firmwareMem);
+    releaseClientFirmware();
     freeDmaBuffer(&statQueueMem);
     freeDmaBuffer(&cmdQueueMem);
 
@@ -186,6 +190,9 @@ bool NVDAALGsp::loadBootloader(const void *data, size_t size) {
         return false;
     }
 
+    // Free existing if any
+    freeDmaBuffer(&bootloaderMem);
+
     // Allocate memory for bootloader
     if (!allocDmaBuffer(&bootloaderMem, size, &bootloaderPhys)) {
         IOLog("NVDAAL-GSP: Failed to allocate bootloader memory\n");
@@ -1322,7 +1329,7 @@ bool NVDAALGsp::executeFwsecViaBrom(void) {
     return false;
 }
 
-bool NVDAALGsp::parseElfFirmware(const void *data, size_t size) {
+bool NVDAALGsp::parseElfFirmware(const void *data, size_t size, IOMemoryDescriptor *wired) {
     const Elf64_Ehdr *ehdr = (const Elf64_Ehdr *)data;
     const uint8_t *bytes = (const uint8_t *)data;
 
@@ -1357,10 +1364,13 @@ bool NVDAALGsp::parseElfFirmware(const void *data, size_t size) {
 
     IOLog("NVDAAL-GSP: Parsing ELF (%d sections)...\n", ehdr->shnum);
 
-    // Reset offsets
+    // Reset offsets and drop any image from an earlier attempt
     firmwareCodeOffset = 0;
     firmwareDataOffset = 0;
     firmwareSize = 0;
+    freeDmaBuffer(&radix3Mem);
+    freeDmaBuffer(&firmwareMem);
+    releaseClientFirmware();
 
     for (int i = 0; i < ehdr->shnum; i++) {
         const Elf64_Shdr *shdr = &shdrs[i];
@@ -1371,9 +1381,34 @@ bool NVDAALGsp::parseElfFirmware(const void *data, size_t size) {
             IOLog("NVDAAL-GSP: Found .fwimage: offset 0x%llx, size 0x%llx\n",
                   shdr->offset, shdr->size);
 
+            if (shdr->offset > size || shdr->size > size - shdr->offset || shdr->size == 0) {
+                IOLog("NVDAAL-GSP: .fwimage outside firmware file\n");
+                return false;
+            }
+
             firmwareCodeOffset = shdr->offset;
             firmwareSize = shdr->size;
 
+            // The client's pages are already wired: if the section starts on
+            // a physical page boundary the radix3 table can point straight at
+            // them. Otherwise fall back to copying this section.
+            if (wired && wired->prepare(kIODirectionOut) == kIOReturnSuccess) {
+                uint64_t sectionPhys = wired->getPhysicalSegment(shdr->offset, nullptr);
+                if (sectionPhys && (sectionPhys & (GSP_PAGE_SIZE - 1)) == 0) {
+                    wired->retain();
+                    firmwareWired = wired;
+                    IOLog("NVDAAL-GSP: Using client firmware pages in place (%llu bytes)\n",
+                          (unsigned long long)firmwareSize);
+
+                    if (!buildRadix3PageTable(firmwareWired, shdr->offset, firmwareSize)) {
+                        return false;
+                    }
+                    continue;
+                }
+                wired->complete(kIODirectionOut);
+                IOLog("NVDAAL-GSP: .fwimage not page aligned in client buffer, copying\n");
+            }
+
             // Allocate firmware memory (non-contiguous, DMA-able)
             // NOTE: For large firmware (63MB), we can't use physically contiguous
             firmwareMem = IOBufferMemoryDescriptor::inTaskWithPhysicalMask(
@@ -1401,7 +1436,7 @@ bool NVDAALGsp::parseElfFirmware(const void *data, size_t size) {
             memcpy(firmwareMem->getBytesNoCopy(), bytes + shdr->offset, shdr->size);
 
             // Build the page table for this firmware (handles non-contiguous pages)
-            if (!buildRadix3PageTable(firmwareMem->getBytesNoCopy(), firmwareSize)) {
+            if (!buildRadix3PageTable(firmwareMem, 0, firmwareSize)) {
                 return false;
             }
         }
@@ -1419,7 +1454,14 @@ bool NVDAALGsp::parseElfFirmware(const void *data, size_t size) {
     return true;
 }
 
-bool NVDAALGsp::buildRadix3PageTable(const void *firmware, size_t size) {
+void NVDAALGsp::releaseClientFirmware(void) {
+    if (!firmwareWired) return;
+    firmwareWired->complete(kIODirectionOut);
+    firmwareWired->release();
+    firmwareWired = nullptr;
+}
+
+bool NVDAALGsp::buildRadix3PageTable(IOMemoryDescriptor *image, uint64_t offset, size_t size) {
     // Radix3 is a 64-bit sparse page table format
     // Each entry is 64-bit (8 bytes)
     // Page size is 4KB (0x1000)
@@ -1487,7 +1529,7 @@ bool NVDAALGsp::buildRadix3PageTable(const void *firmware, size_t size) {
     // get the physical address of each page individually from the descriptor
     for (uint64_t i = 0; i < numPages; i++) {
         IOByteCount segLen;
-        uint64_t pagePhys = firmwareMem->getPhysicalSegment(i * GSP_PAGE_SIZE, &segLen);
+        uint64_t pagePhys = image->getPhysicalSegment(offset + i * GSP_PAGE_SIZE, &segLen);
         if (pagePhys == 0) {
             IOLog("NVDAAL-GSP: Failed to get physical address for page %llu\n", i);
             return false;
@@ -2434,6 +2476,11 @@ bool NVDAALGsp::dequeueStatus(void *msg, size_t maxSize, size_t *actualSize) {
     return true;
 }
 
+void NVDAALGsp::setEventHandler(EventHandler handler, void *context) {
+    eventContext = context;
+    eventHandler = handler;
+}
+
 bool NVDAALGsp::waitRpcResponse(uint32_t function, void *response, size_t responseSize, uint32_t timeoutMs) {
     uint32_t elapsed = 0;
     uint8_t rpcBuf[4096];
@@ -2457,6 +2504,9 @@ bool NVDAALGsp::waitRpcResponse(uint32_t function, void *response, size_t respon
                 IOLog("NVDAAL-GSP: Async GSP_INIT_DONE received\n");
                 gspReady = true;
             }
+            if (hdr->signature == NV_VGPU_MSG_SIGNATURE_VALID && eventHandler) {
+                eventHandler(eventContext, hdr->function, hdr->rpcResult);
+            }
         }
 
         IODelay(100); // 100us
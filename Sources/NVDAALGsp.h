@@ -68,7 +68,11 @@ public:
     bool loadBootloader(const void *data, size_t size);
     bool loadBooterLoad(const void *data, size_t size);
     bool loadVbios(const void *data, size_t size);
-    bool parseElfFirmware(const void *data, size_t size);
+    // `wired` (optional) is a prepared descriptor over `data`. When the
+    // image section is page aligned its pages are used in place instead of
+    // being copied; releaseClientFirmware() drops them once booted.
+    bool parseElfFirmware(const void *data, size_t size, IOMemoryDescriptor *wired = nullptr);
+    void releaseClientFirmware(void);
 
     // Boot sequence
     bool boot(void);
@@ -81,6 +85,10 @@ public:
     bool sendRpc(uint32_t function, const void *params, size_t size);
     bool waitRpcResponse(uint32_t function, void *response, size_t responseSize, uint32_t timeoutMs = 1000);
     
+    // Unsolicited messages (events) seen while waiting for RPC responses
+    typedef void (*EventHandler)(void *context, uint32_t function, uint32_t rpcResult);
+    void setEventHandler(EventHandler handler, void *context);
+
     // Higher level RPC helpers
     bool sendSystemInfo(void);
     bool setRegistry(const char *key, uint32_t value);
@@ -112,10 +120,14 @@ private:
     bool gspReady;
     uint32_t rpcSeqNum;
 
+    EventHandler eventHandler;
+    void *eventContext;
+
     // DMA Buffers
     IOBufferMemoryDescriptor *cmdQueueMem;    // Command queue (host -> GSP)
     IOBufferMemoryDescriptor *statQueueMem;   // Status queue (GSP -> host)
-    IOBufferMemoryDescriptor *firmwareMem;    // GSP firmware image
+    IOBufferMemoryDescriptor *firmwareMem;    // GSP firmware image (copied)
+    IOMemoryDescriptor *firmwareWired;        // GSP firmware image (client pages, borrowed)
     IOBufferMemoryDescriptor *bootloaderMem;  // Bootloader ucode (small secure booter)
     IOBufferMemoryDescriptor *booterLoadMem;  // booter_load ucode for SEC2
     IOBufferMemoryDescriptor *wprMetaMem;     // WPR metadata
@@ -167,7 +179,7 @@ private:
     bool allocDmaBuffer(IOBufferMemoryDescriptor **desc, size_t size, uint64_t *physAddr);
     void freeDmaBuffer(IOBufferMemoryDescriptor **desc);
 
-    bool buildRadix3PageTable(const void *firmware, size_t size);
+    bool buildRadix3PageTable(IOMemoryDescriptor *image, uint64_t offset, size_t size);
     bool setupWprMeta(void);
 
     bool resetFalcon(void);
@@ -21,6 +21,7 @@ private:
     
     uint64_t vramBase;
     uint64_t vramSize;
+    uint64_t vramPhys;   // BAR1 bus address
     uint64_t freeOffset; // Simple linear allocator pointer
 
     IOLock *lock;
@@ -37,6 +38,10 @@ public:
     // Create a memory descriptor for a VRAM region (for mapping to user-space)
     IOMemoryDescriptor* createVramDescriptor(uint64_t offset, size_t size);
 
+    // Physical (BAR1 bus address) descriptor for mapping into a user task
+    // with caller-chosen caching
+    IOMemoryDescriptor* createVramUserDescriptor(uint64_t offset, size_t size);
+
     // Helpers
     uint64_t getTotalVram() const { return vramSize; }
     uint64_t getFreeVram() const { return vramSize - freeOffset; }
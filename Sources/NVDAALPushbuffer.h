@@ -0,0 +1,390 @@
+/*
+ * NVDAALPushbuffer.h - Pushbuffer Method Encoding
+ *
+ * Helpers to encode host-class methods into a pushbuffer (the command
+ * stream referenced by GPFIFO entries). Plain C with no IOKit
+ * dependencies so the same encoders are shared by the kext, libNVDAAL
+ * and the user-space tests.
+ *
+ * Method layout follows AMPERE_CHANNEL_GPFIFO_A (clc56f.h), which the
+ * Ada host class (ADA_CHANNEL_GPFIFO_A) inherits unchanged.
+ */
+
+#ifndef NVDAAL_PUSHBUFFER_H
+#define NVDAAL_PUSHBUFFER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// ============================================================================
+// Method Header (DMA) Format
+// ============================================================================
+
+#define NV_PB_HDR_SEC_OP_SHIFT          29
+#define NV_PB_HDR_COUNT_SHIFT           16
+#define NV_PB_HDR_COUNT_MASK            0x1FFF
+#define NV_PB_HDR_SUBCH_SHIFT           13
+#define NV_PB_HDR_SUBCH_MASK            0x7
+#define NV_PB_HDR_ADDR_MASK             0xFFF   // Method address in dwords
+
+#define NV_PB_SEC_OP_INC_METHOD         1
+#define NV_PB_SEC_OP_NON_INC_METHOD     3
+#define NV_PB_SEC_OP_IMMD_DATA_METHOD   4
+#define NV_PB_SEC_OP_ONE_INC            5
+
+#define NV_PB_IMMD_DATA_MAX             0x1FFF
+
+// Subchannel assignment used by NVDAAL channels
+#define NV_PB_SUBCH_HOST                0       // Host methods are subchannel-agnostic
+#define NV_PB_SUBCH_COMPUTE             1
+#define NV_PB_SUBCH_COPY                4       // Copy class: GRCE on compute channels, the CE on copy channels
+
+// Method 0 of every subchannel binds the class its methods go to
+#define NV_PB_SET_OBJECT                0x0000
+
+// ============================================================================
+// Host Class Methods (NVC56F)
+// ============================================================================
+
+#define NVC56F_NOP                      0x0008  // Data ignored by host
+#define NVC56F_NON_STALL_INTERRUPT      0x0020
+#define NVC56F_SEM_ADDR_LO              0x005C
+#define NVC56F_SEM_ADDR_HI              0x0060
+#define NVC56F_SEM_PAYLOAD_LO           0x0064
+#define NVC56F_SEM_PAYLOAD_HI           0x0068
+#define NVC56F_SEM_EXECUTE              0x006C
+#define NVC56F_WFI                      0x0078
+
+#define NVC56F_WFI_SCOPE_ALL            0x1
+
+// SEM_EXECUTE fields
+#define NVC56F_SEM_EXECUTE_OPERATION_ACQUIRE         0x0
+#define NVC56F_SEM_EXECUTE_OPERATION_RELEASE         0x1
+#define NVC56F_SEM_EXECUTE_OPERATION_ACQ_STRICT_GEQ  0x2
+#define NVC56F_SEM_EXECUTE_OPERATION_ACQ_CIRC_GEQ    0x3
+#define NVC56F_SEM_EXECUTE_ACQUIRE_SWITCH_TSG_EN     (1u << 12)
+#define NVC56F_SEM_EXECUTE_RELEASE_WFI_EN            (1u << 20)
+#define NVC56F_SEM_EXECUTE_PAYLOAD_SIZE_64BIT        (1u << 24)
+#define NVC56F_SEM_EXECUTE_RELEASE_TIMESTAMP_EN      (1u << 25)
+
+// Semaphore address must be 8-byte aligned for 64-bit payloads
+#define NV_SEMAPHORE_ALIGN              8
+
+// Dwords emitted by the helpers below (for space reservation)
+#define NV_PB_NOP_DWORDS                2
+#define NV_PB_SEMAPHORE_RELEASE_DWORDS  7       // 6 + NON_STALL_INTERRUPT
+#define NV_PB_SEMAPHORE_ACQUIRE_DWORDS  6
+#define NV_PB_BARRIER_DWORDS            2
+#define NV_PB_DISPATCH_DWORDS           3
+#define NV_PB_COPY_DWORDS               10      // Also 2D copies
+#define NV_PB_FILL_DWORDS               14
+#define NV_PB_COPY_RELEASE_DWORDS       7
+#define NV_PB_SET_OBJECT_DWORDS         2
+
+// ============================================================================
+// Compute Class Methods (ADA_COMPUTE_A, NVC9C0)
+// ============================================================================
+
+#define NVC9C0_WAIT_FOR_IDLE            0x0110
+#define NVC9C0_SEND_PCAS_A              0x02B4  // QMD GPU VA >> 8
+#define NVC9C0_SEND_SIGNALING_PCAS_B    0x02C0
+
+#define NVC9C0_SEND_SIGNALING_PCAS_B_INVALIDATE  (1u << 0)
+#define NVC9C0_SEND_SIGNALING_PCAS_B_SCHEDULE    (1u << 1)
+
+#define NV_QMD_ALIGN                    256
+
+// ============================================================================
+// Copy Class Methods (AMPERE_DMA_COPY_B, NVC7B5; unchanged on Ada)
+// ============================================================================
+
+#define NVC7B5_SET_SEMAPHORE_A          0x0240  // Address bits 56:32
+#define NVC7B5_SET_SEMAPHORE_B          0x0244  // Address bits 31:0
+#define NVC7B5_SET_SEMAPHORE_PAYLOAD    0x0248
+#define NVC7B5_SET_SEMAPHORE_PAYLOAD_UPPER 0x024C
+#define NVC7B5_LAUNCH_DMA               0x0300
+#define NVC7B5_OFFSET_IN_UPPER          0x0400
+#define NVC7B5_OFFSET_IN_LOWER          0x0404
+#define NVC7B5_OFFSET_OUT_UPPER         0x0408
+#define NVC7B5_OFFSET_OUT_LOWER         0x040C
+#define NVC7B5_PITCH_IN                 0x0410
+#define NVC7B5_PITCH_OUT                0x0414
+#define NVC7B5_LINE_LENGTH_IN           0x0418
+#define NVC7B5_LINE_COUNT               0x041C
+#define NVC7B5_SET_REMAP_CONST_A        0x0700
+#define NVC7B5_SET_REMAP_CONST_B        0x0704
+#define NVC7B5_SET_REMAP_COMPONENTS     0x0708
+
+// LAUNCH_DMA fields (source and destination are GPU virtual addresses)
+#define NVC7B5_LAUNCH_DMA_DATA_TRANSFER_TYPE_MASK           0x3
+#define NVC7B5_LAUNCH_DMA_DATA_TRANSFER_TYPE_NONE           0x0
+#define NVC7B5_LAUNCH_DMA_DATA_TRANSFER_TYPE_NON_PIPELINED  0x2
+#define NVC7B5_LAUNCH_DMA_FLUSH_ENABLE                      (1u << 2)
+#define NVC7B5_LAUNCH_DMA_SEMAPHORE_TYPE_SHIFT              3
+#define NVC7B5_LAUNCH_DMA_SEMAPHORE_TYPE_MASK               (0x3u << 3)
+#define NVC7B5_LAUNCH_DMA_SEMAPHORE_TYPE_RELEASE_ONE_WORD   (0x1u << 3)
+#define NVC7B5_LAUNCH_DMA_INTERRUPT_TYPE_MASK               (0x3u << 5)
+#define NVC7B5_LAUNCH_DMA_INTERRUPT_TYPE_NON_BLOCKING       (0x2u << 5)
+#define NVC7B5_LAUNCH_DMA_SRC_MEMORY_LAYOUT_PITCH           (1u << 7)
+#define NVC7B5_LAUNCH_DMA_DST_MEMORY_LAYOUT_PITCH           (1u << 8)
+#define NVC7B5_LAUNCH_DMA_MULTI_LINE_ENABLE                 (1u << 9)
+#define NVC7B5_LAUNCH_DMA_REMAP_ENABLE                      (1u << 10)
+#define NVC7B5_LAUNCH_DMA_SEMAPHORE_PAYLOAD_SIZE_64BIT      (1u << 27)  // Past immediate range
+
+// SET_REMAP_COMPONENTS fields. With REMAP_ENABLE, LINE_LENGTH_IN counts
+// destination elements (component size x destination components).
+#define NVC7B5_REMAP_DST_X_SHIFT                            0   // DST_Y/Z/W follow, 4 bits apart
+#define NVC7B5_REMAP_SRC_X                                  0x0
+#define NVC7B5_REMAP_CONST_A                                0x4
+#define NVC7B5_REMAP_CONST_B                                0x5
+#define NVC7B5_REMAP_NO_WRITE                               0x6
+#define NVC7B5_REMAP_COMPONENT_SIZE_SHIFT                   16  // Bytes - 1
+#define NVC7B5_REMAP_NUM_SRC_COMPONENTS_SHIFT               20  // Count - 1
+#define NVC7B5_REMAP_NUM_DST_COMPONENTS_SHIFT               24  // Count - 1
+
+// ============================================================================
+// Encoder State
+// ============================================================================
+
+typedef struct {
+    uint32_t *start;
+    uint32_t *cur;
+    uint32_t *end;
+} NvPushbuffer;
+
+static inline void nvPbInit(NvPushbuffer *pb, void *mem, size_t bytes) {
+    pb->start = (uint32_t *)mem;
+    pb->cur = pb->start;
+    pb->end = pb->start + (bytes / sizeof(uint32_t));
+}
+
+static inline size_t nvPbBytesUsed(const NvPushbuffer *pb) {
+    return (size_t)(pb->cur - pb->start) * sizeof(uint32_t);
+}
+
+static inline bool nvPbHasRoom(const NvPushbuffer *pb, uint32_t dwords) {
+    return (size_t)(pb->end - pb->cur) >= dwords;
+}
+
+// ============================================================================
+// Header Encoding
+// ============================================================================
+
+static inline uint32_t nvPbHeader(uint32_t secOp, uint32_t subch, uint32_t method, uint32_t count) {
+    return (secOp << NV_PB_HDR_SEC_OP_SHIFT) |
+           ((count & NV_PB_HDR_COUNT_MASK) << NV_PB_HDR_COUNT_SHIFT) |
+           ((subch & NV_PB_HDR_SUBCH_MASK) << NV_PB_HDR_SUBCH_SHIFT) |
+           ((method >> 2) & NV_PB_HDR_ADDR_MASK);
+}
+
+static inline uint32_t nvPbIncHeader(uint32_t subch, uint32_t method, uint32_t count) {
+    return nvPbHeader(NV_PB_SEC_OP_INC_METHOD, subch, method, count);
+}
+
+static inline uint32_t nvPbNonIncHeader(uint32_t subch, uint32_t method, uint32_t count) {
+    return nvPbHeader(NV_PB_SEC_OP_NON_INC_METHOD, subch, method, count);
+}
+
+// Immediate form: 13-bit data carried in the count field, no payload dword
+static inline uint32_t nvPbImmdHeader(uint32_t subch, uint32_t method, uint32_t data) {
+    return nvPbHeader(NV_PB_SEC_OP_IMMD_DATA_METHOD, subch, method, data);
+}
+
+// ============================================================================
+// Emitters (return false if the pushbuffer is out of space)
+// ============================================================================
+
+static inline bool nvPbPushMethods(NvPushbuffer *pb, uint32_t subch, uint32_t method,
+                                   const uint32_t *data, uint32_t count) {
+    if (count == 0 || count > NV_PB_HDR_COUNT_MASK || !nvPbHasRoom(pb, count + 1)) return false;
+    *pb->cur++ = nvPbIncHeader(subch, method, count);
+    for (uint32_t i = 0; i < count; i++) {
+        *pb->cur++ = data[i];
+    }
+    return true;
+}
+
+static inline bool nvPbPushMethod(NvPushbuffer *pb, uint32_t subch, uint32_t method, uint32_t data) {
+    if (data <= NV_PB_IMMD_DATA_MAX) {
+        if (!nvPbHasRoom(pb, 1)) return false;
+        *pb->cur++ = nvPbImmdHeader(subch, method, data);
+        return true;
+    }
+    return nvPbPushMethods(pb, subch, method, &data, 1);
+}
+
+// Host NOP carrying a 32-bit tag as its data; any value is safe
+static inline bool nvPbPushNop(NvPushbuffer *pb, uint32_t tag) {
+    if (!nvPbHasRoom(pb, NV_PB_NOP_DWORDS)) return false;
+    *pb->cur++ = nvPbIncHeader(NV_PB_SUBCH_HOST, NVC56F_NOP, 1);
+    *pb->cur++ = tag;
+    return true;
+}
+
+static inline bool nvPbPushSemaphore(NvPushbuffer *pb, uint64_t gpuVa, uint64_t payload, uint32_t execute) {
+    if (!nvPbHasRoom(pb, NV_PB_SEMAPHORE_ACQUIRE_DWORDS)) return false;
+    *pb->cur++ = nvPbIncHeader(NV_PB_SUBCH_HOST, NVC56F_SEM_ADDR_LO, 5);
+    *pb->cur++ = (uint32_t)(gpuVa & 0xFFFFFFFCu);
+    *pb->cur++ = (uint32_t)(gpuVa >> 32) & 0x01FFFFFFu;
+    *pb->cur++ = (uint32_t)payload;
+    *pb->cur++ = (uint32_t)(payload >> 32);
+    *pb->cur++ = execute;
+    return true;
+}
+
+/*
+ * Release a 64-bit timeline semaphore: wait for prior work to idle, write
+ * `value` to `gpuVa`, then optionally raise a non-stall interrupt so the
+ * kernel can wake waiters instead of polling.
+ */
+static inline bool nvPbPushSemaphoreRelease(NvPushbuffer *pb, uint64_t gpuVa, uint64_t value, bool interrupt) {
+    if (!nvPbHasRoom(pb, interrupt ? NV_PB_SEMAPHORE_RELEASE_DWORDS : NV_PB_SEMAPHORE_ACQUIRE_DWORDS)) {
+        return false;
+    }
+    nvPbPushSemaphore(pb, gpuVa, value,
+                      NVC56F_SEM_EXECUTE_OPERATION_RELEASE |
+                      NVC56F_SEM_EXECUTE_RELEASE_WFI_EN |
+                      NVC56F_SEM_EXECUTE_PAYLOAD_SIZE_64BIT);
+    if (interrupt) {
+        *pb->cur++ = nvPbImmdHeader(NV_PB_SUBCH_HOST, NVC56F_NON_STALL_INTERRUPT, 0);
+    }
+    return true;
+}
+
+/*
+ * Acquire a 64-bit timeline semaphore: stall the channel until the value
+ * at `gpuVa` is >= `value`. The TSG may be switched out while blocked.
+ */
+static inline bool nvPbPushSemaphoreAcquire(NvPushbuffer *pb, uint64_t gpuVa, uint64_t value) {
+    return nvPbPushSemaphore(pb, gpuVa, value,
+                             NVC56F_SEM_EXECUTE_OPERATION_ACQ_STRICT_GEQ |
+                             NVC56F_SEM_EXECUTE_ACQUIRE_SWITCH_TSG_EN |
+                             NVC56F_SEM_EXECUTE_PAYLOAD_SIZE_64BIT);
+}
+
+/*
+ * Full barrier: the compute engine drains its work, then host waits for
+ * the whole channel to idle before fetching further methods.
+ */
+static inline bool nvPbPushBarrier(NvPushbuffer *pb) {
+    if (!nvPbHasRoom(pb, NV_PB_BARRIER_DWORDS)) return false;
+    *pb->cur++ = nvPbImmdHeader(NV_PB_SUBCH_COMPUTE, NVC9C0_WAIT_FOR_IDLE, 0);
+    *pb->cur++ = nvPbImmdHeader(NV_PB_SUBCH_HOST, NVC56F_WFI, NVC56F_WFI_SCOPE_ALL);
+    return true;
+}
+
+/*
+ * Launch the grid described by the QMD at `qmdGpuVa` (NV_QMD_ALIGN aligned).
+ * Launches are not ordered against each other; add a barrier between
+ * dependent dispatches.
+ */
+static inline bool nvPbPushDispatch(NvPushbuffer *pb, uint64_t qmdGpuVa) {
+    if ((qmdGpuVa & (NV_QMD_ALIGN - 1)) || !nvPbHasRoom(pb, NV_PB_DISPATCH_DWORDS)) return false;
+    *pb->cur++ = nvPbIncHeader(NV_PB_SUBCH_COMPUTE, NVC9C0_SEND_PCAS_A, 1);
+    *pb->cur++ = (uint32_t)(qmdGpuVa >> 8);
+    *pb->cur++ = nvPbImmdHeader(NV_PB_SUBCH_COMPUTE, NVC9C0_SEND_SIGNALING_PCAS_B,
+                                NVC9C0_SEND_SIGNALING_PCAS_B_INVALIDATE |
+                                NVC9C0_SEND_SIGNALING_PCAS_B_SCHEDULE);
+    return true;
+}
+
+/*
+ * Bind `classId` to `subch` (NV_PB_SET_OBJECT). The driver binds the copy
+ * class once when it boots a copy channel; client pushbuffers never need to.
+ */
+static inline bool nvPbPushSetObject(NvPushbuffer *pb, uint32_t subch, uint32_t classId) {
+    return nvPbPushMethods(pb, subch, NV_PB_SET_OBJECT, &classId, 1);
+}
+
+/*
+ * Pitched copy of `lines` lines of `lineBytes` each between GPU VAs; line i
+ * starts at base + i * pitch on either side. The copy engine flushes before
+ * later methods observe the destination, and each launch waits for the
+ * previous one (non-pipelined), so copies on one channel are ordered.
+ */
+static inline bool nvPbPushCopy2D(NvPushbuffer *pb, uint64_t dstGpuVa, uint32_t dstPitch,
+                                  uint64_t srcGpuVa, uint32_t srcPitch, uint32_t lineBytes, uint32_t lines) {
+    if (lineBytes == 0 || lines == 0 || (lines > 1 && (dstPitch < lineBytes || srcPitch < lineBytes)) ||
+        !nvPbHasRoom(pb, NV_PB_COPY_DWORDS)) {
+        return false;
+    }
+    *pb->cur++ = nvPbIncHeader(NV_PB_SUBCH_COPY, NVC7B5_OFFSET_IN_UPPER, 8);
+    *pb->cur++ = (uint32_t)(srcGpuVa >> 32) & 0x01FFFFFFu;
+    *pb->cur++ = (uint32_t)srcGpuVa;
+    *pb->cur++ = (uint32_t)(dstGpuVa >> 32) & 0x01FFFFFFu;
+    *pb->cur++ = (uint32_t)dstGpuVa;
+    *pb->cur++ = srcPitch;              // PITCH_IN
+    *pb->cur++ = dstPitch;              // PITCH_OUT
+    *pb->cur++ = lineBytes;             // LINE_LENGTH_IN
+    *pb->cur++ = lines;                 // LINE_COUNT
+    *pb->cur++ = nvPbImmdHeader(NV_PB_SUBCH_COPY, NVC7B5_LAUNCH_DMA,
+                                NVC7B5_LAUNCH_DMA_DATA_TRANSFER_TYPE_NON_PIPELINED |
+                                NVC7B5_LAUNCH_DMA_FLUSH_ENABLE |
+                                NVC7B5_LAUNCH_DMA_SRC_MEMORY_LAYOUT_PITCH |
+                                NVC7B5_LAUNCH_DMA_DST_MEMORY_LAYOUT_PITCH |
+                                (lines > 1 ? NVC7B5_LAUNCH_DMA_MULTI_LINE_ENABLE : 0));
+    return true;
+}
+
+// Linear copy of `bytes` between GPU VAs as a single pitch line
+static inline bool nvPbPushCopy(NvPushbuffer *pb, uint64_t dstGpuVa, uint64_t srcGpuVa, uint32_t bytes) {
+    return nvPbPushCopy2D(pb, dstGpuVa, bytes, srcGpuVa, bytes, bytes, 1);
+}
+
+/*
+ * Fill `count` 4-byte elements at `dstGpuVa` with `value`: a remapped
+ * launch whose only destination component is CONST_A, so nothing is read.
+ * The source offset is programmed as the destination for tools that
+ * check it. `dstGpuVa` must be 4-byte aligned.
+ */
+static inline bool nvPbPushFill(NvPushbuffer *pb, uint64_t dstGpuVa, uint32_t value, uint32_t count) {
+    if (count == 0 || count > UINT32_MAX / 4 || (dstGpuVa & 3) || !nvPbHasRoom(pb, NV_PB_FILL_DWORDS)) return false;
+    *pb->cur++ = nvPbIncHeader(NV_PB_SUBCH_COPY, NVC7B5_SET_REMAP_CONST_A, 3);
+    *pb->cur++ = value;                 // CONST_A
+    *pb->cur++ = 0;                     // CONST_B
+    *pb->cur++ = (NVC7B5_REMAP_CONST_A << NVC7B5_REMAP_DST_X_SHIFT) |
+                 (3u << NVC7B5_REMAP_COMPONENT_SIZE_SHIFT) |
+                 (0u << NVC7B5_REMAP_NUM_SRC_COMPONENTS_SHIFT) |
+                 (0u << NVC7B5_REMAP_NUM_DST_COMPONENTS_SHIFT);
+    *pb->cur++ = nvPbIncHeader(NV_PB_SUBCH_COPY, NVC7B5_OFFSET_IN_UPPER, 8);
+    *pb->cur++ = (uint32_t)(dstGpuVa >> 32) & 0x01FFFFFFu;
+    *pb->cur++ = (uint32_t)dstGpuVa;
+    *pb->cur++ = (uint32_t)(dstGpuVa >> 32) & 0x01FFFFFFu;
+    *pb->cur++ = (uint32_t)dstGpuVa;
+    *pb->cur++ = count * 4;             // PITCH_IN
+    *pb->cur++ = count * 4;             // PITCH_OUT
+    *pb->cur++ = count;                 // LINE_LENGTH_IN, in elements
+    *pb->cur++ = 1;                     // LINE_COUNT
+    *pb->cur++ = nvPbImmdHeader(NV_PB_SUBCH_COPY, NVC7B5_LAUNCH_DMA,
+                                NVC7B5_LAUNCH_DMA_DATA_TRANSFER_TYPE_NON_PIPELINED |
+                                NVC7B5_LAUNCH_DMA_FLUSH_ENABLE |
+                                NVC7B5_LAUNCH_DMA_SRC_MEMORY_LAYOUT_PITCH |
+                                NVC7B5_LAUNCH_DMA_DST_MEMORY_LAYOUT_PITCH |
+                                NVC7B5_LAUNCH_DMA_REMAP_ENABLE);
+    return true;
+}
+
+/*
+ * Release a 64-bit semaphore from the copy engine once the copies and
+ * fills launched before it have landed: a launch that moves no data. Unlike
+ * nvPbPushSemaphoreRelease() it does not idle the channel, but it is only
+ * ordered against copy-class work.
+ */
+static inline bool nvPbPushCopyRelease(NvPushbuffer *pb, uint64_t gpuVa, uint64_t value, bool interrupt) {
+    if ((gpuVa & (NV_SEMAPHORE_ALIGN - 1)) || !nvPbHasRoom(pb, NV_PB_COPY_RELEASE_DWORDS)) return false;
+    *pb->cur++ = nvPbIncHeader(NV_PB_SUBCH_COPY, NVC7B5_SET_SEMAPHORE_A, 4);
+    *pb->cur++ = (uint32_t)(gpuVa >> 32) & 0x01FFFFFFu;
+    *pb->cur++ = (uint32_t)gpuVa;
+    *pb->cur++ = (uint32_t)value;
+    *pb->cur++ = (uint32_t)(value >> 32);
+    *pb->cur++ = nvPbIncHeader(NV_PB_SUBCH_COPY, NVC7B5_LAUNCH_DMA, 1);
+    *pb->cur++ = NVC7B5_LAUNCH_DMA_DATA_TRANSFER_TYPE_NONE |
+                 NVC7B5_LAUNCH_DMA_FLUSH_ENABLE |
+                 NVC7B5_LAUNCH_DMA_SEMAPHORE_TYPE_RELEASE_ONE_WORD |
+                 (interrupt ? NVC7B5_LAUNCH_DMA_INTERRUPT_TYPE_NON_BLOCKING : 0) |
+                 NVC7B5_LAUNCH_DMA_SEMAPHORE_PAYLOAD_SIZE_64BIT;
+    return true;
+}
+
+#endif // NVDAAL_PUSHBUFFER_H
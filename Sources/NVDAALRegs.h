@@ -36,6 +36,8 @@
 #define NV_PMC_ENABLE                     0x00000200
 #define NV_PMC_DEVICE_ENABLE              0x00000600
 #define NV_PMC_INTR_EN_0                  0x00000140
+#define NV_PMC_INTR_PFIFO                 (1 << 8)    // Host/channel faults
+#define NV_PMC_INTR_GSP                   (1 << 15)
 
 // ============================================================================
 // PBUS (Bus Control)
@@ -994,6 +996,7 @@ struct FwsecInfo {
 
 #define AMPERE_CHANNEL_GPFIFO_A         0x0000C56F // GPFIFO (Ampere+)
 #define ADA_CHANNEL_GPFIFO_A            0x0000C96F // GPFIFO (Ada)
+#define AMPERE_DMA_COPY_B               0x0000C7B5 // Copy engine (Ada keeps Ampere's)
 
 #define NV_CONF_COMPUTE_CAPABILITY      0x0000C7C0
 
@@ -1084,6 +1087,14 @@ struct NvChannelAllocParams {
     uint64_t userdOffset;  // Offset within UserD memory
 };
 
+//
+// Copy Engine Object Parameters (AMPERE_DMA_COPY_B, under a copy channel)
+//
+struct NvCopyAllocParams {
+    uint32_t version;      // 0
+    uint32_t engineType;   // NV2080_ENGINE_TYPE_COPY
+};
+
 // Engine Types
 #define NV2080_ENGINE_TYPE_GRAPHICS 0
 #define NV2080_ENGINE_TYPE_COMPUTE  1
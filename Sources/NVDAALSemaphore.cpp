@@ -0,0 +1,349 @@
+/*
+ * NVDAALSemaphore.cpp - Timeline Semaphore Pool Implementation
+ */
+
+#include "NVDAALSemaphore.h"
+#include "NVDAALUserShared.h"
+#include <IOKit/IOLib.h>
+#include <kern/clock.h>
+
+#define super OSObject
+
+OSDefineMetaClassAndStructors(NVDAALSemaphorePool, OSObject);
+
+NVDAALSemaphorePool* NVDAALSemaphorePool::withCapacity(void) {
+    NVDAALSemaphorePool *inst = new NVDAALSemaphorePool;
+    if (inst) {
+        if (!inst->init()) {
+            inst->release();
+            return nullptr;
+        }
+    }
+    return inst;
+}
+
+bool NVDAALSemaphorePool::init() {
+    if (!super::init()) return false;
+
+    slotMem = nullptr;
+    slotPhys = 0;
+    slots = nullptr;
+    freeHint = 0;
+    vaSpace = nullptr;
+    gpuBase = 0;
+    wakeGeneration = 0;
+    waiters = 0;
+    bzero(info, sizeof(info));
+
+    lock = IOLockAlloc();
+    if (!lock) return false;
+
+    // Payloads live in sysmem so host reads are cheap cached loads and the
+    // GPU can release them without going through BAR1.
+    slotMem = IOBufferMemoryDescriptor::inTaskWithPhysicalMask(
+        kernel_task,
+        kIODirectionInOut | kIOMemoryPhysicallyContiguous,
+        kMaxSemaphores * kSlotSize,
+        0xFFFFFFFFFFFFULL
+    );
+    if (!slotMem || slotMem->prepare() != kIOReturnSuccess) {
+        IOLog("NVDAAL-Sem: Failed to allocate semaphore memory\n");
+        return false;
+    }
+    slotPhys = slotMem->getPhysicalSegment(0, nullptr);
+    slots = (Slot *)slotMem->getBytesNoCopy();
+    memset(slots, 0, kMaxSemaphores * kSlotSize);
+
+    for (uint32_t i = 0; i < kMaxSemaphores; i++) {
+        info[i].spinUs = kSpinMinUs;
+    }
+
+    IOLog("NVDAAL-Sem: Semaphore pool ready (%u slots @ phys 0x%llx)\n", kMaxSemaphores, slotPhys);
+    return true;
+}
+
+void NVDAALSemaphorePool::free() {
+    if (vaSpace) {
+        if (gpuBase) vaSpace->unmap(gpuBase, kMaxSemaphores * kSlotSize);
+        vaSpace->release();
+        vaSpace = nullptr;
+    }
+    if (slotMem) {
+        slotMem->complete();
+        slotMem->release();
+        slotMem = nullptr;
+    }
+    if (lock) {
+        IOLockFree(lock);
+        lock = nullptr;
+    }
+    super::free();
+}
+
+bool NVDAALSemaphorePool::attachVASpace(NVDAALVASpace *space) {
+    if (!space || vaSpace) return false;
+
+    uint64_t va = space->map(slotMem, 0x1000);
+    if (!va) {
+        IOLog("NVDAAL-Sem: Failed to map semaphore pool into VASpace\n");
+        return false;
+    }
+
+    IOLockLock(lock);
+    space->retain();
+    vaSpace = space;
+    gpuBase = va;
+    IOLockUnlock(lock);
+
+    IOLog("NVDAAL-Sem: Semaphore pool mapped at GPU VA 0x%llx\n", gpuBase);
+    return true;
+}
+
+// ============================================================================
+// Handle Management
+// ============================================================================
+
+bool NVDAALSemaphorePool::decodeHandle(uint32_t handle, OSObject *owner, uint32_t *index) const {
+    uint32_t slot = handle & 0xFFFF;
+    if (slot == 0 || slot > kMaxSemaphores) return false;
+
+    const SlotInfo &si = info[slot - 1];
+    if (!si.inUse || si.owner != owner || si.generation != (handle >> 16)) return false;
+
+    *index = slot - 1;
+    return true;
+}
+
+bool NVDAALSemaphorePool::create(OSObject *owner, uint64_t initialValue, uint32_t *handle, uint64_t *gpuVa) {
+    if (!handle) return false;
+
+    IOLockLock(lock);
+    for (uint32_t n = 0; n < kMaxSemaphores; n++) {
+        uint32_t i = (freeHint + n) % kMaxSemaphores;
+        if (info[i].inUse) continue;
+
+        info[i].inUse = true;
+        info[i].owner = owner;
+        info[i].spinUs = kSpinMinUs;
+        slots[i].payload = initialValue;
+        slots[i].timestamp = 0;
+        freeHint = (i + 1) % kMaxSemaphores;
+
+        *handle = ((uint32_t)info[i].generation << 16) | (i + 1);
+        if (gpuVa) *gpuVa = gpuBase ? gpuBase + (uint64_t)i * kSlotSize : 0;
+        IOLockUnlock(lock);
+        return true;
+    }
+    IOLockUnlock(lock);
+
+    IOLog("NVDAAL-Sem: Out of semaphores (%u in use)\n", kMaxSemaphores);
+    return false;
+}
+
+bool NVDAALSemaphorePool::destroy(OSObject *owner, uint32_t handle) {
+    uint32_t index;
+
+    IOLockLock(lock);
+    if (!decodeHandle(handle, owner, &index)) {
+        IOLockUnlock(lock);
+        return false;
+    }
+    info[index].inUse = false;
+    info[index].owner = nullptr;
+    info[index].generation++;
+    freeHint = index;
+
+    // Waiters on this handle re-validate and fail with kIOReturnNotFound
+    wakeGeneration++;
+    IOLockWakeup(lock, &wakeGeneration, false);
+    IOLockUnlock(lock);
+    return true;
+}
+
+void NVDAALSemaphorePool::destroyAllOwnedBy(OSObject *owner) {
+    IOLockLock(lock);
+    for (uint32_t i = 0; i < kMaxSemaphores; i++) {
+        if (info[i].inUse && info[i].owner == owner) {
+            info[i].inUse = false;
+            info[i].owner = nullptr;
+            info[i].generation++;
+        }
+    }
+    wakeGeneration++;
+    IOLockWakeup(lock, &wakeGeneration, false);
+    IOLockUnlock(lock);
+}
+
+// ============================================================================
+// Host Access
+// ============================================================================
+
+bool NVDAALSemaphorePool::read(OSObject *owner, uint32_t handle, uint64_t *value) {
+    uint32_t index;
+    if (!value) return false;
+
+    IOLockLock(lock);
+    bool ok = decodeHandle(handle, owner, &index);
+    if (ok) *value = slots[index].payload;
+    IOLockUnlock(lock);
+    return ok;
+}
+
+bool NVDAALSemaphorePool::signal(OSObject *owner, uint32_t handle, uint64_t value) {
+    uint32_t index;
+
+    IOLockLock(lock);
+    if (!decodeHandle(handle, owner, &index)) {
+        IOLockUnlock(lock);
+        return false;
+    }
+    // Timeline semaphores are monotonic: ignore attempts to move backwards
+    if (value > slots[index].payload) {
+        slots[index].payload = value;
+        slots[index].timestamp = mach_absolute_time();
+        __sync_synchronize();
+        wakeGeneration++;
+        IOLockWakeup(lock, &wakeGeneration, false);
+    }
+    IOLockUnlock(lock);
+    return true;
+}
+
+bool NVDAALSemaphorePool::lookupGpuVa(OSObject *owner, uint64_t gpuVa, uint32_t *handle) {
+    if (!gpuBase || gpuVa < gpuBase || !handle) return false;
+
+    uint64_t offset = gpuVa - gpuBase;
+    if ((offset % kSlotSize) != 0 || offset >= (uint64_t)kMaxSemaphores * kSlotSize) return false;
+    uint32_t i = (uint32_t)(offset / kSlotSize);
+
+    IOLockLock(lock);
+    bool ok = info[i].inUse && info[i].owner == owner;
+    if (ok) *handle = ((uint32_t)info[i].generation << 16) | (i + 1);
+    IOLockUnlock(lock);
+    return ok;
+}
+
+bool NVDAALSemaphorePool::gpuVaOf(OSObject *owner, uint32_t handle, uint64_t *gpuVa) {
+    uint32_t index;
+    if (!gpuBase || !gpuVa) return false;
+
+    IOLockLock(lock);
+    bool ok = decodeHandle(handle, owner, &index);
+    if (ok) *gpuVa = gpuBase + (uint64_t)index * kSlotSize;
+    IOLockUnlock(lock);
+    return ok;
+}
+
+// ============================================================================
+// Waiting
+// ============================================================================
+
+bool NVDAALSemaphorePool::checkAll(const uint32_t *index, const uint64_t *values, uint32_t count,
+                                   bool waitAll, uint32_t *signaled) const {
+    for (uint32_t i = 0; i < count; i++) {
+        bool done = isSatisfied(index[i], values[i]);
+        if (!waitAll && done) {
+            *signaled = i;
+            return true;
+        }
+        if (waitAll && !done) return false;
+    }
+    if (waitAll) *signaled = 0;
+    return waitAll;
+}
+
+IOReturn NVDAALSemaphorePool::wait(OSObject *owner, const uint32_t *handles, const uint64_t *values,
+                                   uint32_t count, bool waitAll, uint32_t timeoutMs, uint32_t *signaledIndex) {
+    uint32_t index[NVDAAL_MAX_WAIT_SEMAPHORES];
+    uint32_t signaled = 0;
+    uint32_t spinUs = kSpinMinUs;
+
+    if (!handles || !values || count == 0 || count > NVDAAL_MAX_WAIT_SEMAPHORES) return kIOReturnBadArgument;
+
+    IOLockLock(lock);
+    for (uint32_t i = 0; i < count; i++) {
+        if (!decodeHandle(handles[i], owner, &index[i])) {
+            IOLockUnlock(lock);
+            return kIOReturnNotFound;
+        }
+        if (info[index[i]].spinUs > spinUs) spinUs = info[index[i]].spinUs;
+    }
+    IOLockUnlock(lock);
+
+    // Fast path and adaptive spin: short GPU jobs finish well inside the
+    // cost of a sleep/wakeup round trip, so poll the sysmem payloads first.
+    uint64_t spinDeadline;
+    clock_interval_to_deadline(spinUs, kMicrosecondScale, &spinDeadline);
+    do {
+        if (checkAll(index, values, count, waitAll, &signaled)) {
+            IOLockLock(lock);
+            for (uint32_t i = 0; i < count; i++) {
+                uint32_t grown = (uint32_t)info[index[i]].spinUs * 2;
+                info[index[i]].spinUs = (uint16_t)(grown > kSpinMaxUs ? kSpinMaxUs : grown);
+            }
+            IOLockUnlock(lock);
+            if (signaledIndex) *signaledIndex = signaled;
+            return kIOReturnSuccess;
+        }
+    } while (timeoutMs && mach_absolute_time() < spinDeadline);
+
+    if (timeoutMs == 0) return kIOReturnTimeout;
+
+    // Slow path: sleep until notify() (semaphore-release interrupt or host
+    // signal). Sleep in bounded slices in case an interrupt is coalesced
+    // away before the pool sees it.
+    uint64_t deadline;
+    clock_interval_to_deadline(timeoutMs, kMillisecondScale, &deadline);
+
+    IOReturn ret = kIOReturnSuccess;
+    IOLockLock(lock);
+    waiters++;
+    while (!checkAll(index, values, count, waitAll, &signaled)) {
+        uint64_t now = mach_absolute_time();
+        if (now >= deadline) {
+            ret = kIOReturnTimeout;
+            break;
+        }
+
+        uint64_t slice;
+        clock_interval_to_deadline(kSleepSliceMs, kMillisecondScale, &slice);
+        if (slice > deadline) slice = deadline;
+
+        int wr = IOLockSleepDeadline(lock, &wakeGeneration, slice, THREAD_ABORTSAFE);
+        if (wr == THREAD_INTERRUPTED) {
+            ret = kIOReturnAborted;
+            break;
+        }
+
+        // A handle may have been destroyed while we slept
+        bool valid = true;
+        for (uint32_t i = 0; i < count && valid; i++) {
+            uint32_t idx;
+            valid = decodeHandle(handles[i], owner, &idx);
+        }
+        if (!valid) {
+            ret = kIOReturnNotFound;
+            break;
+        }
+    }
+    waiters--;
+
+    // Work that outlives the spin budget is long-running: spin less next time
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t shrunk = info[index[i]].spinUs / 2;
+        info[index[i]].spinUs = (uint16_t)(shrunk < kSpinMinUs ? kSpinMinUs : shrunk);
+    }
+    IOLockUnlock(lock);
+
+    if (ret == kIOReturnSuccess && signaledIndex) *signaledIndex = signaled;
+    return ret;
+}
+
+void NVDAALSemaphorePool::notify(void) {
+    IOLockLock(lock);
+    if (waiters) {
+        wakeGeneration++;
+        IOLockWakeup(lock, &wakeGeneration, false);
+    }
+    IOLockUnlock(lock);
+}
@@ -0,0 +1,91 @@
+/*
+ * NVDAALSemaphore.h - 64-bit Timeline Semaphores
+ *
+ * A pool of monotonic 64-bit semaphores backed by one physically
+ * contiguous block of system memory that is mapped into the GPU VASpace.
+ * The GPU releases them with SEM_EXECUTE (see NVDAALPushbuffer.h) and the
+ * host waits by sleeping until a non-stall interrupt wakes the pool.
+ */
+
+#ifndef NVDAAL_SEMAPHORE_H
+#define NVDAAL_SEMAPHORE_H
+
+#include <IOKit/IOService.h>
+#include <IOKit/IOBufferMemoryDescriptor.h>
+#include "NVDAALVASpace.h"
+
+class NVDAALSemaphorePool : public OSObject {
+    OSDeclareDefaultStructors(NVDAALSemaphorePool);
+
+public:
+    static const uint32_t kMaxSemaphores = 1024;
+    static const uint32_t kSlotSize = 16;             // payload + release timestamp
+    static const uint32_t kSpinMinUs = 2;
+    static const uint32_t kSpinMaxUs = 64;
+    static const uint32_t kSleepSliceMs = 10;         // Re-check if an interrupt is lost
+
+private:
+    // GPU-visible payload slot (written by SEM_EXECUTE RELEASE)
+    struct Slot {
+        volatile uint64_t payload;
+        volatile uint64_t timestamp;
+    };
+
+    // Host-side bookkeeping for each slot
+    struct SlotInfo {
+        OSObject *owner;        // User client that created it (not retained)
+        uint16_t generation;    // Bumped on destroy to invalidate stale handles
+        uint16_t spinUs;        // Adaptive spin budget before sleeping
+        bool inUse;
+    };
+
+    IOBufferMemoryDescriptor *slotMem;
+    uint64_t slotPhys;
+    Slot *slots;
+    SlotInfo info[kMaxSemaphores];
+    uint32_t freeHint;
+
+    NVDAALVASpace *vaSpace;
+    uint64_t gpuBase;           // 0 until attachVASpace()
+
+    IOLock *lock;
+    uint32_t wakeGeneration;    // Sleep event; bumped by notify()
+    uint32_t waiters;
+
+    bool decodeHandle(uint32_t handle, OSObject *owner, uint32_t *index) const;
+    bool isSatisfied(uint32_t index, uint64_t value) const { return slots[index].payload >= value; }
+    bool checkAll(const uint32_t *index, const uint64_t *values, uint32_t count,
+                  bool waitAll, uint32_t *signaled) const;
+
+public:
+    static NVDAALSemaphorePool* withCapacity(void);
+
+    virtual bool init() override;
+    virtual void free() override;
+
+    // Map the pool into the GPU VASpace (called once the MMU is booted)
+    bool attachVASpace(NVDAALVASpace *vaSpace);
+
+    // Lifecycle. Handles are (generation << 16) | (index + 1); 0 is invalid.
+    bool create(OSObject *owner, uint64_t initialValue, uint32_t *handle, uint64_t *gpuVa);
+    bool destroy(OSObject *owner, uint32_t handle);
+    void destroyAllOwnedBy(OSObject *owner);
+
+    // Host access. signal() never moves a semaphore backwards.
+    bool read(OSObject *owner, uint32_t handle, uint64_t *value);
+    bool signal(OSObject *owner, uint32_t handle, uint64_t value);
+    bool lookupGpuVa(OSObject *owner, uint64_t gpuVa, uint32_t *handle);
+    bool gpuVaOf(OSObject *owner, uint32_t handle, uint64_t *gpuVa);
+
+    // Block until one (waitAll=false) or all entries reach their values.
+    // Spins briefly (adaptive per semaphore), then sleeps until notify().
+    IOReturn wait(OSObject *owner, const uint32_t *handles, const uint64_t *values,
+                  uint32_t count, bool waitAll, uint32_t timeoutMs, uint32_t *signaledIndex);
+
+    // Wake all waiters so they re-check payloads (semaphore-release interrupt)
+    void notify(void);
+
+    uint64_t getGpuBase() const { return gpuBase; }
+};
+
+#endif // NVDAAL_SEMAPHORE_H
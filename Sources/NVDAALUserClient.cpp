@@ -18,7 +18,23 @@ bool NVDAALUserClient::initWithTask(task_t owningTask, void *securityID, UInt32
         return false;
     }
     clientTask = owningTask;
-    return true;
+    commandRing = nullptr;
+    notifications = nullptr;
+    notificationCapacity = 0;
+    semaphoreWatches = 0;
+    vramRanges = nullptr;
+    vramRangeCount = 0;
+    vramRangeCapacity = 0;
+    gpuRanges = nullptr;
+    gpuRangeCount = 0;
+    gpuRangeCapacity = 0;
+    vaMappings = 0;
+    vaMappedBytes = 0;
+    bzero(sysmem, sizeof(sysmem));
+    nextSysmemHandle = 0;
+    resetStats(&stats);
+    clientLock = IOLockAlloc();
+    return clientLock != nullptr;
 }
 
 bool NVDAALUserClient::start(IOService *service) {
@@ -40,15 +56,334 @@ void NVDAALUserClient::stop(IOService *service) {
 }
 
 IOReturn NVDAALUserClient::clientClose(void) {
+    if (provider) {
+        provider->destroySemaphores(this);
+    }
+
+    for (uint32_t i = 0; i < NVDAAL_MAX_SYSMEM_ALLOCS; i++) {
+        if (sysmem[i].desc) releaseSysmem(&sysmem[i]);
+    }
+
+    // Tear down the GPU mappings the client left behind
+    IOLockLock(clientLock);
+    GpuRange *ranges = gpuRanges;
+    uint32_t rangeCount = gpuRangeCount;
+    uint32_t rangeCapacity = gpuRangeCapacity;
+    gpuRanges = nullptr;
+    gpuRangeCount = 0;
+    gpuRangeCapacity = 0;
+    IOLockUnlock(clientLock);
+    if (ranges) {
+        for (uint32_t i = 0; i < rangeCount; i++) {
+            if (provider) provider->unmapVram(ranges[i].gpuVa, (size_t)ranges[i].size);
+        }
+        IOFree(ranges, rangeCapacity * sizeof(GpuRange));
+    }
+
+    // Nothing may be sent to the port once the client is gone
+    IOLockLock(clientLock);
+    for (uint32_t i = 0; i < notificationCapacity; i++) {
+        if (notifications[i].inUse) releaseNotification(&notifications[i]);
+    }
+    IOLockUnlock(clientLock);
+
     terminate();
     return kIOReturnSuccess;
 }
 
+void NVDAALUserClient::free(void) {
+    if (vramRanges) {
+        IOFree(vramRanges, vramRangeCapacity * sizeof(VramRange));
+        vramRanges = nullptr;
+    }
+    if (gpuRanges) {
+        IOFree(gpuRanges, gpuRangeCapacity * sizeof(GpuRange));
+        gpuRanges = nullptr;
+    }
+    if (notifications) {
+        IOFree(notifications, notificationCapacity * sizeof(Notification));
+        notifications = nullptr;
+    }
+    if (commandRing) {
+        commandRing->release();
+        commandRing = nullptr;
+    }
+    if (clientLock) {
+        IOLockFree(clientLock);
+        clientLock = nullptr;
+    }
+    super::free();
+}
+
+IOReturn NVDAALUserClient::clientMemoryForType(UInt32 type, IOOptionBits *options, IOMemoryDescriptor **memory) {
+    if (NVDAAL_MEMORY_IS_VRAM(type)) {
+        uint64_t offset = NVDAAL_MEMORY_VRAM_OFFSET(type);
+        uint64_t size;
+        if (!findVram(offset, 0, &size)) return kIOReturnNotFound;
+
+        // Caching comes from the caller's kIOMap*Cache map options
+        IOMemoryDescriptor *desc = provider->createVramUserDescriptor(offset, (size_t)size);
+        if (!desc) return kIOReturnNoResources;
+        *memory = desc;
+        *options = 0;
+        return kIOReturnSuccess;
+    }
+
+    if (NVDAAL_MEMORY_IS_SYSMEM(type)) {
+        uint32_t handle = NVDAAL_MEMORY_SYSMEM_HANDLE(type);
+        IOMemoryDescriptor *desc = nullptr;
+        IOLockLock(clientLock);
+        for (uint32_t i = 0; i < NVDAAL_MAX_SYSMEM_ALLOCS; i++) {
+            if (handle && sysmem[i].desc && sysmem[i].handle == handle) {
+                desc = sysmem[i].desc;
+                desc->retain();                 // The caller consumes one reference
+                break;
+            }
+        }
+        IOLockUnlock(clientLock);
+        if (!desc) return kIOReturnNotFound;
+        *memory = desc;
+        *options = 0;
+        return kIOReturnSuccess;
+    }
+
+    if (type != NVDAAL_MEMORY_COMMAND_RING) return kIOReturnBadArgument;
+
+    IOLockLock(clientLock);
+    if (!commandRing) commandRing = NVDAALCommandRing::withDefaultSize();
+    NVDAALCommandRing *ring = commandRing;
+    IOLockUnlock(clientLock);
+    if (!ring) return kIOReturnNoMemory;
+
+    // The caller consumes one reference
+    IOMemoryDescriptor *desc = ring->getMemoryDescriptor();
+    desc->retain();
+    *memory = desc;
+    *options = 0;
+    return kIOReturnSuccess;
+}
+
+// ============================================================================
+// VRAM Ownership
+// ============================================================================
+
+uint64_t NVDAALUserClient::allocVram(size_t size) {
+    if (size == 0) return 0;
+    uint64_t offset = provider->allocVram(size);
+    if (offset == 0) return 0;
+
+    // The VRAM allocator never frees, so neither does this list
+    IOLockLock(clientLock);
+    if (vramRangeCount == vramRangeCapacity) {
+        uint32_t newCapacity = vramRangeCapacity ? vramRangeCapacity * 2 : 16;
+        VramRange *grown = (VramRange *)IOMalloc(newCapacity * sizeof(VramRange));
+        if (!grown) {
+            IOLockUnlock(clientLock);
+            return 0;
+        }
+        if (vramRanges) {
+            memcpy(grown, vramRanges, vramRangeCount * sizeof(VramRange));
+            IOFree(vramRanges, vramRangeCapacity * sizeof(VramRange));
+        }
+        vramRanges = grown;
+        vramRangeCapacity = newCapacity;
+    }
+    vramRanges[vramRangeCount].offset = offset;
+    vramRanges[vramRangeCount].size = (size + 0xFFFULL) & ~0xFFFULL;
+    vramRangeCount++;
+    IOLockUnlock(clientLock);
+    return offset;
+}
+
+// True if [offset, offset + size) lies inside one allocation owned by this
+// client. size == 0 requires offset to be the start of an allocation.
+bool NVDAALUserClient::findVram(uint64_t offset, uint64_t size, uint64_t *allocSize) {
+    bool found = false;
+
+    IOLockLock(clientLock);
+    for (uint32_t i = 0; i < vramRangeCount && !found; i++) {
+        const VramRange &r = vramRanges[i];
+        if (size == 0) {
+            found = offset == r.offset;
+        } else {
+            found = offset >= r.offset && size <= r.size && offset - r.offset <= r.size - size;
+        }
+        if (found && allocSize) *allocSize = r.size;
+    }
+    IOLockUnlock(clientLock);
+    return found;
+}
+
+// Map [offset, offset + size) of an owned allocation into the GPU VASpace
+// and remember the mapping. Unmapping does not give the VA back yet, so
+// each mapping is charged to the client's NVDAAL_MAX_VRAM_* budget for good.
+IOReturn NVDAALUserClient::mapVram(uint64_t offset, uint64_t size, uint64_t *gpuVa) {
+    *gpuVa = 0;
+    if (size == 0 || !findVram(offset, size, nullptr)) return kIOReturnNotFound;
+
+    IOLockLock(clientLock);
+    if (vaMappings >= NVDAAL_MAX_VRAM_MAPPINGS || size > NVDAAL_MAX_VRAM_MAPPED_BYTES - vaMappedBytes) {
+        IOLockUnlock(clientLock);
+        return kIOReturnNoResources;
+    }
+    vaMappings++;
+    vaMappedBytes += size;
+    IOLockUnlock(clientLock);
+
+    uint64_t va = provider->mapVram(offset, (size_t)size);
+    IOLockLock(clientLock);
+    if (va == 0) {
+        // Nothing was taken from the VASpace: refund the budget
+        vaMappings--;
+        vaMappedBytes -= size;
+        IOLockUnlock(clientLock);
+        return kIOReturnNoSpace;
+    }
+
+    if (gpuRangeCount == gpuRangeCapacity) {
+        uint32_t newCapacity = gpuRangeCapacity ? gpuRangeCapacity * 2 : 16;
+        GpuRange *grown = (GpuRange *)IOMalloc(newCapacity * sizeof(GpuRange));
+        if (!grown) {
+            IOLockUnlock(clientLock);
+            provider->unmapVram(va, (size_t)size);
+            return kIOReturnNoMemory;
+        }
+        if (gpuRanges) {
+            memcpy(grown, gpuRanges, gpuRangeCount * sizeof(GpuRange));
+            IOFree(gpuRanges, gpuRangeCapacity * sizeof(GpuRange));
+        }
+        gpuRanges = grown;
+        gpuRangeCapacity = newCapacity;
+    }
+    gpuRanges[gpuRangeCount].gpuVa = va;
+    gpuRanges[gpuRangeCount].size = size;
+    gpuRangeCount++;
+    IOLockUnlock(clientLock);
+
+    *gpuVa = va;
+    return kIOReturnSuccess;
+}
+
+// Only mappings this client made may be torn down, and only whole ones
+bool NVDAALUserClient::unmapVram(uint64_t gpuVa, uint64_t size) {
+    bool found = false;
+
+    IOLockLock(clientLock);
+    for (uint32_t i = 0; i < gpuRangeCount; i++) {
+        if (gpuRanges[i].gpuVa == gpuVa && gpuRanges[i].size == size) {
+            gpuRanges[i] = gpuRanges[--gpuRangeCount];
+            found = true;
+            break;
+        }
+    }
+    IOLockUnlock(clientLock);
+
+    if (found) provider->unmapVram(gpuVa, (size_t)size);
+    return found;
+}
+
+// True if [gpuVa, gpuVa + size) lies inside one of this client's mappings
+bool NVDAALUserClient::findGpuRange(uint64_t gpuVa, uint64_t size) {
+    bool found = false;
+
+    IOLockLock(clientLock);
+    for (uint32_t i = 0; i < gpuRangeCount && !found; i++) {
+        const GpuRange &r = gpuRanges[i];
+        found = gpuVa >= r.gpuVa && size <= r.size && gpuVa - r.gpuVa <= r.size - size;
+    }
+    IOLockUnlock(clientLock);
+    return found;
+}
+
+// ============================================================================
+// Pinned System Memory
+// ============================================================================
+
+// Zeroed, wired kernel pages mapped into the GPU VASpace. result: handle, GPU VA.
+IOReturn NVDAALUserClient::allocSysmem(uint64_t size, uint64_t result[2]) {
+    if (size == 0 || size > NVDAAL_MAX_SYSMEM_SIZE) return kIOReturnBadArgument;
+    size = round_page_64(size);
+
+    IOBufferMemoryDescriptor *desc = IOBufferMemoryDescriptor::inTaskWithOptions(
+        kernel_task, kIODirectionInOut | kIOMemoryKernelUserShared, (vm_size_t)size, PAGE_SIZE);
+    if (!desc) return kIOReturnNoMemory;
+    if (desc->prepare() != kIOReturnSuccess) {
+        desc->release();
+        return kIOReturnNoMemory;
+    }
+    bzero(desc->getBytesNoCopy(), (size_t)size);    // Never hand out stale kernel data
+
+    // Claim a slot before mapping: once mapped, the pages are never unwired
+    SysmemAlloc *slot = nullptr;
+    IOLockLock(clientLock);
+    for (uint32_t i = 0; i < NVDAAL_MAX_SYSMEM_ALLOCS && !slot; i++) {
+        if (!sysmem[i].desc) slot = &sysmem[i];
+    }
+    if (slot) {
+        slot->handle = 0;                           // Not mappable until it has a handle
+        slot->desc = desc;
+    }
+    IOLockUnlock(clientLock);
+    if (!slot) {
+        desc->complete();
+        desc->release();
+        return kIOReturnNoResources;
+    }
+
+    uint64_t gpuVa = provider->mapSysmem(desc);
+    IOLockLock(clientLock);
+    if (gpuVa == 0) {
+        slot->desc = nullptr;
+    } else {
+        do {
+            nextSysmemHandle = (nextSysmemHandle + 1) & NVDAAL_MEMORY_SYSMEM_HANDLE_MASK;
+        } while (nextSysmemHandle == 0);
+        slot->handle = nextSysmemHandle;
+        slot->gpuVa = gpuVa;
+        slot->size = size;
+        result[0] = slot->handle;
+        result[1] = gpuVa;
+    }
+    IOLockUnlock(clientLock);
+
+    if (gpuVa == 0) {
+        desc->complete();
+        desc->release();
+        return kIOReturnNoSpace;
+    }
+    return kIOReturnSuccess;
+}
+
+// Hand the pages to the driver, which keeps them wired and GPU-mapped until
+// it is freed: unmap() does not clear PTEs yet and nothing fences the
+// channels, so a channel may still write them. User mappings hold their own
+// reference.
+void NVDAALUserClient::releaseSysmem(SysmemAlloc *alloc) {
+    if (provider) {
+        provider->retireSysmem(alloc->desc);
+        alloc->desc->release();
+    }
+    // Without the driver there is nowhere to keep them: leak the reference
+    // rather than let the last release unwire them
+    alloc->desc = nullptr;
+}
+
 // ============================================================================n// External Methods
 // ============================================================================n
 
 IOReturn NVDAALUserClient::externalMethod(uint32_t selector, IOExternalMethodArguments *arguments,
                                           IOExternalMethodDispatch *dispatch, OSObject *target, void *reference) {
+    uint64_t start = mach_absolute_time();
+    IOReturn ret = dispatchMethod(selector, arguments);
+
+    uint64_t ns;
+    absolutetime_to_nanoseconds(mach_absolute_time() - start, &ns);
+    recordCall(&stats, selector, ns, ret);
+    if (provider) recordCall(provider->getGlobalStats(), selector, ns, ret);
+    return ret;
+}
+
+IOReturn NVDAALUserClient::dispatchMethod(uint32_t selector, IOExternalMethodArguments *arguments) {
     switch (selector) {
         case kNVDAALMethodLoadFirmware:
             return methodLoadFirmware(arguments);
@@ -68,14 +403,104 @@ IOReturn NVDAALUserClient::externalMethod(uint32_t selector, IOExternalMethodArg
             return methodGetStatus(arguments);
         case kNVDAALMethodExecuteFwsec:
             return methodExecuteFwsec(arguments);
+        case kNVDAALMethodCreateSemaphore:
+            return methodCreateSemaphore(arguments);
+        case kNVDAALMethodDestroySemaphore:
+            return methodDestroySemaphore(arguments);
+        case kNVDAALMethodSignalSemaphore:
+            return methodSignalSemaphore(arguments);
+        case kNVDAALMethodReadSemaphore:
+            return methodReadSemaphore(arguments);
+        case kNVDAALMethodWaitSemaphores:
+            return methodWaitSemaphores(arguments);
+        case kNVDAALMethodSetSubmitPolicy:
+            return methodSetSubmitPolicy(arguments);
+        case kNVDAALMethodFlushSubmissions:
+            return methodFlushSubmissions(arguments);
+        case kNVDAALMethodRingKick:
+            return methodRingKick(arguments);
+        case kNVDAALMethodRegisterNotification:
+            return methodRegisterNotification(arguments);
+        case kNVDAALMethodCancelNotification:
+            return methodCancelNotification(arguments);
+        case kNVDAALMethodExecuteBatch:
+            return methodExecuteBatch(arguments);
+        case kNVDAALMethodGetStats:
+            return methodGetStats(arguments);
+        case kNVDAALMethodSubmitPushbuffer:
+            return methodSubmitPushbuffer(arguments);
         default:
             return kIOReturnBadArgument;
     }
 }
 
 IOReturn NVDAALUserClient::methodWaitSemaphore(IOExternalMethodArguments *args) {
+    // Input[0]: Semaphore GPU VA
+    // Input[1]: Value to wait for (payload >= value)
+    // Input[2]: Timeout in ms (optional, default 1000)
+    if (args->scalarInputCount != 2 && args->scalarInputCount != 3) return kIOReturnBadArgument;
+    uint32_t timeoutMs = args->scalarInputCount == 3 ? (uint32_t)args->scalarInput[2] : 1000;
+    return provider->waitSemaphore(this, args->scalarInput[0], args->scalarInput[1], timeoutMs);
+}
+
+IOReturn NVDAALUserClient::methodCreateSemaphore(IOExternalMethodArguments *args) {
+    // Input[0]: Initial value
+    // Output[0]: Handle, Output[1]: GPU VA (0 until the VASpace is booted)
+    if (args->scalarInputCount != 1 || args->scalarOutputCount != 2) return kIOReturnBadArgument;
+
+    uint32_t handle = 0;
+    uint64_t gpuVa = 0;
+    if (!provider->createSemaphore(this, args->scalarInput[0], &handle, &gpuVa)) return kIOReturnNoResources;
+
+    args->scalarOutput[0] = handle;
+    args->scalarOutput[1] = gpuVa;
+    return kIOReturnSuccess;
+}
+
+IOReturn NVDAALUserClient::methodDestroySemaphore(IOExternalMethodArguments *args) {
+    if (args->scalarInputCount != 1) return kIOReturnBadArgument;
+    return provider->destroySemaphore(this, (uint32_t)args->scalarInput[0]) ? kIOReturnSuccess : kIOReturnNotFound;
+}
+
+IOReturn NVDAALUserClient::methodSignalSemaphore(IOExternalMethodArguments *args) {
+    // Input[0]: Handle, Input[1]: Value (ignored if not greater than current)
     if (args->scalarInputCount != 2) return kIOReturnBadArgument;
-    return provider->waitSemaphore(args->scalarInput[0], (uint32_t)args->scalarInput[1], 1000) ? kIOReturnSuccess : kIOReturnTimeout;
+    bool ok = provider->signalSemaphore(this, (uint32_t)args->scalarInput[0], args->scalarInput[1]);
+    return ok ? kIOReturnSuccess : kIOReturnNotFound;
+}
+
+IOReturn NVDAALUserClient::methodReadSemaphore(IOExternalMethodArguments *args) {
+    if (args->scalarInputCount != 1 || args->scalarOutputCount != 1) return kIOReturnBadArgument;
+
+    uint64_t value = 0;
+    if (!provider->readSemaphore(this, (uint32_t)args->scalarInput[0], &value)) return kIOReturnNotFound;
+
+    args->scalarOutput[0] = value;
+    return kIOReturnSuccess;
+}
+
+IOReturn NVDAALUserClient::methodWaitSemaphores(IOExternalMethodArguments *args) {
+    // StructInput: NvdaalSemaphoreWaitArgs (only `count` entries required)
+    // Output[0]: Index of the satisfied entry (wait-any), 0 for wait-all
+    const NvdaalSemaphoreWaitArgs *wa = (const NvdaalSemaphoreWaitArgs *)args->structureInput;
+    if (!wa || args->structureInputSize < NVDAAL_SEMAPHORE_WAIT_ARGS_SIZE(0)) return kIOReturnBadArgument;
+    if (wa->count == 0 || wa->count > NVDAAL_MAX_WAIT_SEMAPHORES) return kIOReturnBadArgument;
+    if (args->structureInputSize < NVDAAL_SEMAPHORE_WAIT_ARGS_SIZE(wa->count)) return kIOReturnBadArgument;
+
+    uint32_t handles[NVDAAL_MAX_WAIT_SEMAPHORES];
+    uint64_t values[NVDAAL_MAX_WAIT_SEMAPHORES];
+    for (uint32_t i = 0; i < wa->count; i++) {
+        handles[i] = wa->entries[i].handle;
+        values[i] = wa->entries[i].value;
+    }
+
+    uint32_t signaled = 0;
+    IOReturn ret = provider->waitSemaphores(this, handles, values, wa->count,
+                                            (wa->flags & NVDAAL_WAIT_ALL) != 0, wa->timeoutMs, &signaled);
+    if (ret == kIOReturnSuccess && args->scalarOutputCount >= 1) {
+        args->scalarOutput[0] = signaled;
+    }
+    return ret;
 }
 
 IOReturn NVDAALUserClient::methodAllocVram(IOExternalMethodArguments *args) {
@@ -84,7 +509,7 @@ IOReturn NVDAALUserClient::methodAllocVram(IOExternalMethodArguments *args) {
     }
 
     size_t size = (size_t)args->scalarInput[0];
-    uint64_t offset = provider->allocVram(size);
+    uint64_t offset = allocVram(size);
 
     if (offset == 0 && size > 0) return kIOReturnNoMemory;
 
@@ -93,182 +518,419 @@ IOReturn NVDAALUserClient::methodAllocVram(IOExternalMethodArguments *args) {
 }
 
 IOReturn NVDAALUserClient::methodSubmitCommand(IOExternalMethodArguments *args) {
-    if (args->scalarInputCount != 1) {
+    // Input[0]: Command
+    // Input[1-2]: Semaphore handle and value released after it (optional)
+    if (args->scalarInputCount != 1 && args->scalarInputCount != 3) {
         return kIOReturnBadArgument;
     }
 
     uint32_t cmd = (uint32_t)args->scalarInput[0];
-    bool ok = provider->submitCommand(cmd);
+    bool ok = args->scalarInputCount == 3 ?
+        provider->submitCommand(cmd, this, (uint32_t)args->scalarInput[1], args->scalarInput[2]) :
+        provider->submitCommand(cmd);
 
     return ok ? kIOReturnSuccess : kIOReturnError;
 }
 
-IOReturn NVDAALUserClient::methodLoadFirmware(IOExternalMethodArguments *args) {
-    // Expects:
-    // Input[0]: Pointer to GSP firmware (user virtual address)
-    // Input[1]: Size of GSP firmware
-    
-    if (args->scalarInputCount != 2) {
+IOReturn NVDAALUserClient::methodSubmitPushbuffer(IOExternalMethodArguments *args) {
+    // Input[0]: Pushbuffer GPU VA (inside one of this client's mappings)
+    // Input[1]: Length in bytes and channel (NVDAAL_PUSHBUFFER_ARG)
+    // Input[2-3]: Semaphore handle and value released after it (optional)
+    if (args->scalarInputCount != 2 && args->scalarInputCount != 4) {
         return kIOReturnBadArgument;
     }
 
-    mach_vm_address_t userPtr = (mach_vm_address_t)args->scalarInput[0];
-    mach_vm_size_t size = (mach_vm_size_t)args->scalarInput[1];
-
-    IOLog("NVDAALUserClient: LoadFirmware called. Ptr: 0x%llx, Size: %llu\n", userPtr, size);
+    bool signal = args->scalarInputCount == 4;
+    return submitPushbuffer(args->scalarInput[0], args->scalarInput[1],
+                            signal ? (uint32_t)args->scalarInput[2] : 0, signal ? args->scalarInput[3] : 0);
+}
 
-    // Validate size (sanity check, e.g. < 256MB)
-    if (size == 0 || size > 0x10000000) {
-        IOLog("NVDAALUserClient: Invalid firmware size\n");
+IOReturn NVDAALUserClient::submitPushbuffer(uint64_t gpuVa, uint64_t arg, uint32_t signalHandle, uint64_t signalValue) {
+    uint64_t bytes = NVDAAL_PUSHBUFFER_ARG_BYTES(arg);
+    uint64_t channel = NVDAAL_PUSHBUFFER_ARG_CHANNEL(arg);
+    uint64_t index = channel & ~(uint64_t)NVDAAL_CHANNEL_COPY;
+    if (index >= ((channel & NVDAAL_CHANNEL_COPY) ? provider->getCopyChannelCount() : provider->getChannelCount()) ||
+        bytes == 0 || bytes > NVDAAL_MAX_PUSHBUFFER_BYTES || (gpuVa | bytes) & (NVDAAL_PUSHBUFFER_ALIGN - 1)) {
         return kIOReturnBadArgument;
     }
+    if (!findGpuRange(gpuVa, bytes)) return kIOReturnNotFound;
 
-    // Create memory descriptor from user memory
-    IOMemoryDescriptor *memDesc = IOMemoryDescriptor::withAddressRange(
-        userPtr,
-        size,
-        kIODirectionOut,
-        clientTask
-    );
+    bool ok = provider->submitPushbuffer((uint32_t)channel, gpuVa, (uint32_t)bytes, this, signalHandle, signalValue);
+    return ok ? kIOReturnSuccess : kIOReturnError;
+}
 
-    if (!memDesc) {
-        IOLog("NVDAALUserClient: Failed to create memory descriptor\n");
-        return kIOReturnNoMemory;
-    }
+IOReturn NVDAALUserClient::methodSetSubmitPolicy(IOExternalMethodArguments *args) {
+    // Input[0]: Max held GPFIFO entries (<= 1 disables coalescing)
+    // Input[1]: Max held pushbuffer bytes (0 = unlimited)
+    // Input[2]: Flush deadline in microseconds (0 = none)
+    // Input[3]: Flags (NV_COALESCE_FLAG_*)
+    if (args->scalarInputCount != 4) return kIOReturnBadArgument;
 
-    // Wire down the memory (prepare)
-    IOReturn ret = memDesc->prepare(kIODirectionOut);
-    if (ret != kIOReturnSuccess) {
-        IOLog("NVDAALUserClient: Failed to wire memory (0x%08x)\n", ret);
-        memDesc->release();
-        return ret;
-    }
+    NvCoalescePolicy policy;
+    policy.maxEntries = (uint32_t)args->scalarInput[0];
+    policy.maxBytes = (uint32_t)args->scalarInput[1];
+    policy.deadlineUs = (uint32_t)args->scalarInput[2];
+    policy.flags = (uint32_t)args->scalarInput[3];
 
-    // Get physical address/map kernel side
-    // For GSP, we likely need the physical address to pass to the GPU via DMA
-    // We can also map it to kernel virtual address if we need to parse it (ELF)
-    
-    IOMemoryMap *map = memDesc->map();
-    if (!map) {
-        IOLog("NVDAALUserClient: Failed to map memory to kernel\n");
-        memDesc->complete(kIODirectionOut);
-        memDesc->release();
-        return kIOReturnVMError;
+    return provider->setSubmitPolicy(&policy) ? kIOReturnSuccess : kIOReturnNotReady;
+}
+
+IOReturn NVDAALUserClient::methodFlushSubmissions(IOExternalMethodArguments *args) {
+    provider->flushSubmissions();
+    return kIOReturnSuccess;
+}
+
+// ============================================================================
+// Command Ring
+// ============================================================================
+
+IOReturn NVDAALUserClient::methodRingKick(IOExternalMethodArguments *args) {
+    // Input[0]: Max requests to process (optional, 0 = all queued)
+    // Output[0]: Requests processed
+    uint32_t budget = NVDAAL_RING_REQUEST_SLOTS;
+    if (args->scalarInputCount >= 1 && args->scalarInput[0]) {
+        budget = (uint32_t)args->scalarInput[0];
     }
 
-    void *kernelAddr = (void *)map->getVirtualAddress();
-    
-    // Call driver to load firmware
-    // Note: provider->loadGspFirmware needs to be implemented publicly in NVDAAL
-    int result = provider->loadGspFirmwareEx(kernelAddr, size);
+    IOLockLock(clientLock);
+    NVDAALCommandRing *ring = commandRing;
+    if (ring) ring->retain();
+    IOLockUnlock(clientLock);
+    if (!ring) return kIOReturnNotReady;
 
-    // Cleanup
-    map->release();
-    memDesc->complete(kIODirectionOut);
-    memDesc->release();
+    uint32_t processed = 0;
+    IOReturn ret = ring->drain(ringAction, this, budget, &processed);
+    ring->release();
 
-    // Return specific error code from loadGspFirmwareEx
-    // 0 = success, 1+ = error stage
-    if (result == 0) return kIOReturnSuccess;
-    // Encode error stage in return code: 0xe0000300 + stage
-    return (IOReturn)(0xe0000300 + result);
+    if (args->scalarOutputCount >= 1) args->scalarOutput[0] = processed;
+    return ret;
 }
 
-IOReturn NVDAALUserClient::methodLoadBooterLoad(IOExternalMethodArguments *args) {
-    // Load booter_load firmware for SEC2
-    // Input[0]: Pointer to booter_load data
-    // Input[1]: Size
-
-    if (args->scalarInputCount != 2) {
-        return kIOReturnBadArgument;
-    }
+IOReturn NVDAALUserClient::ringAction(OSObject *target, const NvdaalOpRequest *req, uint64_t result[2]) {
+    NVDAALUserClient *client = OSDynamicCast(NVDAALUserClient, target);
+    if (!client) return kIOReturnBadArgument;
+    return client->executeOp(req, result);
+}
 
-    mach_vm_address_t userPtr = (mach_vm_address_t)args->scalarInput[0];
-    mach_vm_size_t size = (mach_vm_size_t)args->scalarInput[1];
+IOReturn NVDAALUserClient::executeOp(const NvdaalOpRequest *req, uint64_t result[2]) {
+    if (!provider) return kIOReturnNotAttached;
+    if (req->flags != 0) return kIOReturnBadArgument;
+
+    switch (req->op) {
+        case NVDAAL_OP_NOP:
+            return kIOReturnSuccess;
+
+        case NVDAAL_OP_ALLOC_VRAM: {
+            size_t size = (size_t)req->args[0];
+            uint64_t offset = allocVram(size);
+            if (offset == 0 && size > 0) return kIOReturnNoMemory;
+            result[0] = offset;
+            return kIOReturnSuccess;
+        }
+
+        case NVDAAL_OP_SUBMIT_COMMAND:
+            return provider->submitCommand((uint32_t)req->args[0], this, (uint32_t)req->args[1], req->args[2]) ?
+                   kIOReturnSuccess : kIOReturnError;
+
+        case NVDAAL_OP_CREATE_SEMAPHORE: {
+            uint32_t handle = 0;
+            if (!provider->createSemaphore(this, req->args[0], &handle, &result[1])) return kIOReturnNoResources;
+            result[0] = handle;
+            return kIOReturnSuccess;
+        }
+
+        case NVDAAL_OP_DESTROY_SEMAPHORE:
+            return provider->destroySemaphore(this, (uint32_t)req->args[0]) ? kIOReturnSuccess : kIOReturnNotFound;
+
+        case NVDAAL_OP_SIGNAL_SEMAPHORE:
+            return provider->signalSemaphore(this, (uint32_t)req->args[0], req->args[1]) ?
+                   kIOReturnSuccess : kIOReturnNotFound;
+
+        case NVDAAL_OP_READ_SEMAPHORE:
+            return provider->readSemaphore(this, (uint32_t)req->args[0], &result[0]) ?
+                   kIOReturnSuccess : kIOReturnNotFound;
+
+        case NVDAAL_OP_WAIT_SEMAPHORE: {
+            // Blocks the rest of the batch: later requests are ordered after it
+            uint32_t handle = (uint32_t)req->args[0];
+            uint64_t value = req->args[1];
+            return provider->waitSemaphores(this, &handle, &value, 1, true, (uint32_t)req->args[2], nullptr);
+        }
+
+        case NVDAAL_OP_FLUSH_SUBMISSIONS:
+            provider->flushSubmissions();
+            return kIOReturnSuccess;
+
+        case NVDAAL_OP_MAP_VRAM:
+            return mapVram(req->args[0], req->args[1], &result[0]);
+
+        case NVDAAL_OP_UNMAP_VRAM:
+            return unmapVram(req->args[0], req->args[1]) ? kIOReturnSuccess : kIOReturnNotFound;
+
+        case NVDAAL_OP_SUBMIT_PUSHBUFFER:
+            return submitPushbuffer(req->args[0], req->args[1], (uint32_t)req->args[2], req->args[3]);
+
+        case NVDAAL_OP_ALLOC_SYSMEM:
+            return allocSysmem(req->args[0], result);
+
+        case NVDAAL_OP_FREE_SYSMEM:
+            return kIOReturnUnsupported;            // Sysmem lives as long as the driver
+
+        case NVDAAL_OP_QUERY: {
+            NVDAAL::GpuStatus status;
+            if (!provider->getStatus(&status)) return kIOReturnNotReady;
+            switch (req->args[0]) {
+                case NVDAAL_QUERY_CHIP_ID:
+                    result[0] = status.pmcBoot0;
+                    return kIOReturnSuccess;
+                case NVDAAL_QUERY_WPR2:
+                    result[0] = ((uint64_t)status.wpr2Hi << 32) | status.wpr2Lo;
+                    result[1] = status.wpr2Enabled;
+                    return kIOReturnSuccess;
+                case NVDAAL_QUERY_GSP_STATE:
+                    result[0] = status.gspRiscvCpuctl;
+                    result[1] = status.bootScratch;
+                    return kIOReturnSuccess;
+                case NVDAAL_QUERY_CHANNELS:
+                    result[0] = provider->getChannelCount();
+                    return kIOReturnSuccess;
+                case NVDAAL_QUERY_COPY_CHANNELS:
+                    result[0] = provider->getCopyChannelCount();
+                    return kIOReturnSuccess;
+                default:
+                    return kIOReturnBadArgument;
+            }
+        }
 
-    IOLog("NVDAALUserClient: LoadBooterLoad. Ptr: 0x%llx, Size: %llu\n", userPtr, size);
+        default:
+            return kIOReturnUnsupported;
+    }
+}
 
-    if (size == 0 || size > 0x100000) {  // Max 1MB for booter
+// ============================================================================
+// Batched Calls
+// ============================================================================
+
+IOReturn NVDAALUserClient::methodExecuteBatch(IOExternalMethodArguments *args) {
+    // StructInput: NvdaalBatchHeader + NvdaalOpRequest[count]
+    // StructOutput: NvdaalOpCompletion[count]
+    // Output[0]: Ops executed (excludes ops skipped by STOP_ON_ERROR)
+    // Batches over 4KB arrive (and return) through memory descriptors.
+    IOMemoryDescriptor *inDesc = args->structureInputDescriptor;
+    IOMemoryDescriptor *outDesc = args->structureOutputDescriptor;
+    size_t inSize = inDesc ? inDesc->getLength() : args->structureInputSize;
+    size_t outCapacity = outDesc ? outDesc->getLength() : args->structureOutputSize;
+
+    if (inSize < NVDAAL_BATCH_INPUT_SIZE(0) || inSize > NVDAAL_BATCH_INPUT_SIZE(NVDAAL_MAX_BATCH_OPS)) {
         return kIOReturnBadArgument;
     }
 
-    IOMemoryDescriptor *memDesc = IOMemoryDescriptor::withAddressRange(
-        userPtr, size, kIODirectionOut, clientTask);
-    if (!memDesc) return kIOReturnNoMemory;
+    uint8_t *in = (uint8_t *)IOMalloc(inSize);
+    if (!in) return kIOReturnNoMemory;
+
+    IOReturn ret = kIOReturnSuccess;
+    if (inDesc) {
+        ret = inDesc->prepare(kIODirectionOut);
+        if (ret == kIOReturnSuccess) {
+            if (inDesc->readBytes(0, in, inSize) != inSize) ret = kIOReturnVMError;
+            inDesc->complete(kIODirectionOut);
+        }
+    } else {
+        memcpy(in, args->structureInput, inSize);
+    }
 
-    IOReturn ret = memDesc->prepare(kIODirectionOut);
+    // Validate the private copy, never the caller's memory
+    const NvdaalBatchHeader *hdr = (const NvdaalBatchHeader *)in;
+    uint32_t count = hdr->count;
+    if (ret == kIOReturnSuccess &&
+        (count == 0 || count > NVDAAL_MAX_BATCH_OPS || inSize < NVDAAL_BATCH_INPUT_SIZE(count) ||
+         outCapacity < NVDAAL_BATCH_OUTPUT_SIZE(count))) {
+        ret = kIOReturnBadArgument;
+    }
+
+    NvdaalOpCompletion *out = nullptr;
+    if (ret == kIOReturnSuccess) {
+        out = (NvdaalOpCompletion *)IOMalloc(NVDAAL_BATCH_OUTPUT_SIZE(count));
+        if (!out) ret = kIOReturnNoMemory;
+    }
     if (ret != kIOReturnSuccess) {
-        memDesc->release();
+        IOFree(in, inSize);
         return ret;
     }
 
-    IOMemoryMap *map = memDesc->map();
-    if (!map) {
-        memDesc->complete(kIODirectionOut);
-        memDesc->release();
-        return kIOReturnVMError;
+    const NvdaalOpRequest *reqs = (const NvdaalOpRequest *)(in + sizeof(NvdaalBatchHeader));
+    bool stopOnError = (hdr->flags & NVDAAL_BATCH_STOP_ON_ERROR) != 0;
+    bool failed = false;
+    uint32_t executed = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        out[i].cookie = reqs[i].cookie;
+        out[i].op = reqs[i].op;
+        out[i].result[0] = 0;
+        out[i].result[1] = 0;
+        if (failed && stopOnError) {
+            out[i].status = kIOReturnAborted;
+            continue;
+        }
+        out[i].status = executeOp(&reqs[i], out[i].result);
+        if (out[i].status != kIOReturnSuccess) failed = true;
+        executed++;
     }
 
-    void *kernelAddr = (void *)map->getVirtualAddress();
-    bool ok = provider->loadBooterLoad(kernelAddr, size);
-
-    map->release();
-    memDesc->complete(kIODirectionOut);
-    memDesc->release();
+    size_t outSize = NVDAAL_BATCH_OUTPUT_SIZE(count);
+    if (outDesc) {
+        ret = outDesc->prepare(kIODirectionIn);
+        if (ret == kIOReturnSuccess) {
+            if (outDesc->writeBytes(0, out, outSize) != outSize) ret = kIOReturnVMError;
+            outDesc->complete(kIODirectionIn);
+        }
+        args->structureOutputDescriptorSize = (uint32_t)outSize;
+    } else {
+        memcpy(args->structureOutput, out, outSize);
+        args->structureOutputSize = (uint32_t)outSize;
+    }
+    if (args->scalarOutputCount >= 1) args->scalarOutput[0] = executed;
 
-    return ok ? kIOReturnSuccess : kIOReturnError;
+    IOFree(out, outSize);
+    IOFree(in, inSize);
+    return ret;
 }
 
-IOReturn NVDAALUserClient::methodLoadVbios(IOExternalMethodArguments *args) {
-    // Load VBIOS for FWSEC extraction
-    // Input[0]: Pointer to VBIOS data
-    // Input[1]: Size
+// ============================================================================
+// Async Notifications
+// ============================================================================
 
-    if (args->scalarInputCount != 2) {
+IOReturn NVDAALUserClient::methodRegisterNotification(IOExternalMethodArguments *args) {
+    // Async call. Input[0]: NVDAAL_NOTIFY_* kind, Input[1-2]: kind arguments,
+    // Input[3]: caller tag echoed in every message
+    // Output[0]: Registration id for CancelNotification
+    if (!args->asyncWakePort || !args->asyncReference) return kIOReturnBadArgument;
+    if (args->scalarInputCount != 4 || args->scalarOutputCount != 1) return kIOReturnBadArgument;
+
+    uint32_t kind = (uint32_t)args->scalarInput[0];
+    if (kind != NVDAAL_NOTIFY_SEMAPHORE && kind != NVDAAL_NOTIFY_CHANNEL_ERROR &&
+        kind != NVDAAL_NOTIFY_GSP_EVENT) {
         return kIOReturnBadArgument;
     }
+    if (kind == NVDAAL_NOTIFY_SEMAPHORE) {
+        uint64_t value;
+        if (!provider->readSemaphore(this, (uint32_t)args->scalarInput[1], &value)) return kIOReturnNotFound;
+    }
 
-    mach_vm_address_t userPtr = (mach_vm_address_t)args->scalarInput[0];
-    mach_vm_size_t size = (mach_vm_size_t)args->scalarInput[1];
-
-    IOLog("NVDAALUserClient: LoadVbios. Ptr: 0x%llx, Size: %llu\n", userPtr, size);
+    IOLockLock(clientLock);
+    uint32_t slot = 0;
+    while (slot < notificationCapacity && notifications[slot].inUse) slot++;
+
+    if (slot == notificationCapacity) {
+        uint32_t newCapacity = notificationCapacity ? notificationCapacity * 2 : 64;
+        if (newCapacity > NVDAAL_MAX_NOTIFICATIONS) {
+            IOLockUnlock(clientLock);
+            return kIOReturnNoResources;
+        }
+        Notification *grown = (Notification *)IOMalloc(newCapacity * sizeof(Notification));
+        if (!grown) {
+            IOLockUnlock(clientLock);
+            return kIOReturnNoMemory;
+        }
+        bzero(grown, newCapacity * sizeof(Notification));
+        if (notifications) {
+            memcpy(grown, notifications, notificationCapacity * sizeof(Notification));
+            IOFree(notifications, notificationCapacity * sizeof(Notification));
+        }
+        notifications = grown;
+        notificationCapacity = newCapacity;
+    }
 
-    if (size == 0 || size > 0x400000) {  // Max 4MB for VBIOS
-        return kIOReturnBadArgument;
+    Notification *n = &notifications[slot];
+    n->inUse = true;
+    n->kind = kind;
+    n->arg0 = args->scalarInput[1];
+    n->arg1 = args->scalarInput[2];
+    n->tag = args->scalarInput[3];
+    bcopy(args->asyncReference, n->asyncRef, sizeof(OSAsyncReference64));
+    if (kind == NVDAAL_NOTIFY_SEMAPHORE) semaphoreWatches++;
+
+    args->scalarOutput[0] = ((uint64_t)n->generation << 16) | (slot + 1);
+    IOLockUnlock(clientLock);
+
+    // Already satisfied semaphores fire right away; others are re-checked
+    // on every semaphore interrupt and by the provider's poll timer
+    if (kind == NVDAAL_NOTIFY_SEMAPHORE && deliverSemaphoreNotifications()) {
+        provider->scheduleNotificationPoll();
     }
+    return kIOReturnSuccess;
+}
 
-    IOMemoryDescriptor *memDesc = IOMemoryDescriptor::withAddressRange(
-        userPtr, size, kIODirectionOut, clientTask);
-    if (!memDesc) return kIOReturnNoMemory;
+IOReturn NVDAALUserClient::methodCancelNotification(IOExternalMethodArguments *args) {
+    if (args->scalarInputCount != 1) return kIOReturnBadArgument;
 
-    IOReturn ret = memDesc->prepare(kIODirectionOut);
-    if (ret != kIOReturnSuccess) {
-        memDesc->release();
-        return ret;
-    }
+    uint32_t id = (uint32_t)args->scalarInput[0];
+    uint32_t slot = (id & 0xFFFF) - 1;
 
-    IOMemoryMap *map = memDesc->map();
-    if (!map) {
-        memDesc->complete(kIODirectionOut);
-        memDesc->release();
-        return kIOReturnVMError;
+    IOReturn ret = kIOReturnNotFound;
+    IOLockLock(clientLock);
+    if ((id & 0xFFFF) && slot < notificationCapacity && notifications[slot].inUse &&
+        notifications[slot].generation == (id >> 16)) {
+        releaseNotification(&notifications[slot]);
+        ret = kIOReturnSuccess;
     }
+    IOLockUnlock(clientLock);
+    return ret;
+}
 
-    void *kernelAddr = (void *)map->getVirtualAddress();
-    bool ok = provider->loadVbios(kernelAddr, size);
+// Caller holds clientLock
+void NVDAALUserClient::releaseNotification(Notification *n) {
+    if (n->kind == NVDAAL_NOTIFY_SEMAPHORE) semaphoreWatches--;
+    n->inUse = false;
+    n->generation++;
+}
 
-    map->release();
-    memDesc->complete(kIODirectionOut);
-    memDesc->release();
+// Caller holds clientLock. sendAsyncResult64 never blocks on a full port.
+void NVDAALUserClient::sendNotification(Notification *n, IOReturn status, uint64_t value0, uint64_t value1) {
+    io_user_reference_t msg[NVDAAL_NOTIFY_ARG_COUNT];
+    msg[NVDAAL_NOTIFY_ARG_TAG] = n->tag;
+    msg[NVDAAL_NOTIFY_ARG_KIND] = n->kind;
+    msg[NVDAAL_NOTIFY_ARG_VALUE0] = value0;
+    msg[NVDAAL_NOTIFY_ARG_VALUE1] = value1;
+    sendAsyncResult64(n->asyncRef, status, msg, NVDAAL_NOTIFY_ARG_COUNT);
+}
 
-    return ok ? kIOReturnSuccess : kIOReturnError;
+bool NVDAALUserClient::deliverSemaphoreNotifications(void) {
+    IOLockLock(clientLock);
+    for (uint32_t i = 0; i < notificationCapacity && semaphoreWatches; i++) {
+        Notification *n = &notifications[i];
+        if (!n->inUse || n->kind != NVDAAL_NOTIFY_SEMAPHORE) continue;
+
+        uint64_t value = 0;
+        if (!provider || !provider->readSemaphore(this, (uint32_t)n->arg0, &value)) {
+            sendNotification(n, kIOReturnNotFound, 0, 0);     // Destroyed while watched
+        } else if (value >= n->arg1) {
+            sendNotification(n, kIOReturnSuccess, value, 0);
+        } else {
+            continue;
+        }
+        releaseNotification(n);
+    }
+    bool remaining = semaphoreWatches != 0;
+    IOLockUnlock(clientLock);
+    return remaining;
 }
 
-IOReturn NVDAALUserClient::methodLoadBootloader(IOExternalMethodArguments *args) {
-    // Load GSP bootloader firmware (bootloader-ad102-570.144.bin)
-    // Input[0]: Pointer to bootloader data
-    // Input[1]: Size
+void NVDAALUserClient::deliverNotification(uint32_t kind, uint64_t value0, uint64_t value1) {
+    IOLockLock(clientLock);
+    for (uint32_t i = 0; i < notificationCapacity; i++) {
+        Notification *n = &notifications[i];
+        if (!n->inUse || n->kind != kind) continue;
+        if (kind == NVDAAL_NOTIFY_GSP_EVENT && n->arg0 && n->arg0 != value0) continue;
+        sendNotification(n, kIOReturnSuccess, value0, value1);
+    }
+    IOLockUnlock(clientLock);
+}
 
+IOReturn NVDAALUserClient::wireClientBuffer(IOExternalMethodArguments *args, uint64_t maxSize,
+                                            IOMemoryDescriptor **desc, IOMemoryMap **map) {
+    // Input[0]: Pointer (user virtual address)
+    // Input[1]: Size
     if (args->scalarInputCount != 2) {
         return kIOReturnBadArgument;
     }
@@ -276,35 +938,109 @@ IOReturn NVDAALUserClient::methodLoadBootloader(IOExternalMethodArguments *args)
     mach_vm_address_t userPtr = (mach_vm_address_t)args->scalarInput[0];
     mach_vm_size_t size = (mach_vm_size_t)args->scalarInput[1];
 
-    IOLog("NVDAALUserClient: LoadBootloader. Ptr: 0x%llx, Size: %llu\n", userPtr, size);
-
-    if (size == 0 || size > 0x100000) {  // Max 1MB for bootloader
+    if (size == 0 || size > maxSize) {
+        IOLog("NVDAALUserClient: Invalid firmware size %llu (max %llu)\n", size, maxSize);
         return kIOReturnBadArgument;
     }
 
     IOMemoryDescriptor *memDesc = IOMemoryDescriptor::withAddressRange(
         userPtr, size, kIODirectionOut, clientTask);
-    if (!memDesc) return kIOReturnNoMemory;
+    if (!memDesc) {
+        IOLog("NVDAALUserClient: Failed to create memory descriptor\n");
+        return kIOReturnNoMemory;
+    }
 
+    // Wire down the pages; they stay wired until unwireClientBuffer()
     IOReturn ret = memDesc->prepare(kIODirectionOut);
     if (ret != kIOReturnSuccess) {
+        IOLog("NVDAALUserClient: Failed to wire memory (0x%08x)\n", ret);
         memDesc->release();
         return ret;
     }
 
-    IOMemoryMap *map = memDesc->map();
-    if (!map) {
+    // Kernel view of the same pages (a mapping, not a copy) for parsing
+    IOMemoryMap *memMap = memDesc->map();
+    if (!memMap) {
+        IOLog("NVDAALUserClient: Failed to map memory to kernel\n");
         memDesc->complete(kIODirectionOut);
         memDesc->release();
         return kIOReturnVMError;
     }
 
-    void *kernelAddr = (void *)map->getVirtualAddress();
-    bool ok = provider->loadBootloader(kernelAddr, size);
+    *desc = memDesc;
+    *map = memMap;
+    return kIOReturnSuccess;
+}
 
+void NVDAALUserClient::unwireClientBuffer(IOMemoryDescriptor *desc, IOMemoryMap *map) {
     map->release();
-    memDesc->complete(kIODirectionOut);
-    memDesc->release();
+    desc->complete(kIODirectionOut);
+    desc->release();
+}
+
+IOReturn NVDAALUserClient::methodLoadFirmware(IOExternalMethodArguments *args) {
+    // GSP firmware ELF. The .fwimage pages are given to the GPU in place
+    // and held only until GSP is up, which happens before this returns.
+    IOMemoryDescriptor *desc;
+    IOMemoryMap *map;
+    IOReturn ret = wireClientBuffer(args, NVDAAL_MAX_GSP_FIRMWARE_SIZE, &desc, &map);
+    if (ret != kIOReturnSuccess) return ret;
+
+    IOLog("NVDAALUserClient: LoadFirmware called. Size: %llu\n", (uint64_t)map->getLength());
+
+    int result = provider->loadGspFirmwareEx((const void *)map->getVirtualAddress(),
+                                             (size_t)map->getLength(), desc);
+    unwireClientBuffer(desc, map);
+
+    // Return specific error code from loadGspFirmwareEx
+    // 0 = success, 1+ = error stage
+    if (result == 0) return kIOReturnSuccess;
+    // Encode error stage in return code: 0xe0000300 + stage
+    return (IOReturn)(0xe0000300 + result);
+}
+
+IOReturn NVDAALUserClient::methodLoadBooterLoad(IOExternalMethodArguments *args) {
+    // booter_load firmware for SEC2. Falcon DMA needs it physically
+    // contiguous, so the GSP copies it straight out of the wired pages.
+    IOMemoryDescriptor *desc;
+    IOMemoryMap *map;
+    IOReturn ret = wireClientBuffer(args, NVDAAL_MAX_BOOTER_LOAD_SIZE, &desc, &map);
+    if (ret != kIOReturnSuccess) return ret;
+
+    IOLog("NVDAALUserClient: LoadBooterLoad. Size: %llu\n", (uint64_t)map->getLength());
+
+    bool ok = provider->loadBooterLoad((const void *)map->getVirtualAddress(), (size_t)map->getLength());
+    unwireClientBuffer(desc, map);
+
+    return ok ? kIOReturnSuccess : kIOReturnError;
+}
+
+IOReturn NVDAALUserClient::methodLoadVbios(IOExternalMethodArguments *args) {
+    // VBIOS for FWSEC extraction
+    IOMemoryDescriptor *desc;
+    IOMemoryMap *map;
+    IOReturn ret = wireClientBuffer(args, NVDAAL_MAX_VBIOS_SIZE, &desc, &map);
+    if (ret != kIOReturnSuccess) return ret;
+
+    IOLog("NVDAALUserClient: LoadVbios. Size: %llu\n", (uint64_t)map->getLength());
+
+    bool ok = provider->loadVbios((const void *)map->getVirtualAddress(), (size_t)map->getLength());
+    unwireClientBuffer(desc, map);
+
+    return ok ? kIOReturnSuccess : kIOReturnError;
+}
+
+IOReturn NVDAALUserClient::methodLoadBootloader(IOExternalMethodArguments *args) {
+    // GSP bootloader firmware (bootloader-ad102-570.144.bin)
+    IOMemoryDescriptor *desc;
+    IOMemoryMap *map;
+    IOReturn ret = wireClientBuffer(args, NVDAAL_MAX_BOOTLOADER_SIZE, &desc, &map);
+    if (ret != kIOReturnSuccess) return ret;
+
+    IOLog("NVDAALUserClient: LoadBootloader. Size: %llu\n", (uint64_t)map->getLength());
+
+    bool ok = provider->loadBootloader((const void *)map->getVirtualAddress(), (size_t)map->getLength());
+    unwireClientBuffer(desc, map);
 
     return ok ? kIOReturnSuccess : kIOReturnError;
 }
@@ -352,3 +1088,132 @@ IOReturn NVDAALUserClient::methodExecuteFwsec(IOExternalMethodArguments *args) {
 
     return result ? kIOReturnSuccess : kIOReturnError;
 }
+
+// ============================================================================
+// Call Statistics
+// ============================================================================
+
+void NVDAALUserClient::resetStats(NvdaalStats *stats) {
+    bzero(stats, sizeof(*stats));
+    stats->version = NVDAAL_STATS_VERSION;
+    stats->selectorCount = kNVDAALMethodCount;
+    absolutetime_to_nanoseconds(mach_absolute_time(), &stats->sinceNs);
+}
+
+void NVDAALUserClient::recordCall(NvdaalStats *stats, uint32_t selector, uint64_t ns, IOReturn ret) {
+    if (selector >= kNVDAALMethodCount) return;
+    NvdaalSelectorStats *s = &stats->selectors[selector];
+
+    __atomic_fetch_add(&s->calls, 1, __ATOMIC_RELAXED);
+    if (ret != kIOReturnSuccess) __atomic_fetch_add(&s->errors, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&s->totalNs, ns, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&s->histogram[nvStatsBucket(ns)], 1, __ATOMIC_RELAXED);
+
+    uint64_t max = __atomic_load_n(&s->maxNs, __ATOMIC_RELAXED);
+    while (ns > max && !__atomic_compare_exchange_n(&s->maxNs, &max, ns, true,
+                                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+// Copy `stats` into `out`. With `reset`, each counter is swapped for zero
+// as it is read, so a call recorded concurrently is counted in exactly one
+// of this snapshot and the next, never lost or torn.
+void NVDAALUserClient::snapshotStats(NvdaalStats *stats, NvdaalStats *out, bool reset) {
+    out->version = stats->version;
+    out->selectorCount = stats->selectorCount;
+    out->sinceNs = __atomic_load_n(&stats->sinceNs, __ATOMIC_RELAXED);
+    if (reset) {
+        uint64_t now;
+        absolutetime_to_nanoseconds(mach_absolute_time(), &now);
+        __atomic_store_n(&stats->sinceNs, now, __ATOMIC_RELAXED);
+    }
+
+    uint64_t *from = (uint64_t *)stats->selectors;
+    uint64_t *to = (uint64_t *)out->selectors;
+    for (size_t i = 0; i < sizeof(stats->selectors) / sizeof(uint64_t); i++) {
+        to[i] = reset ? __atomic_exchange_n(&from[i], 0, __ATOMIC_RELAXED) : __atomic_load_n(&from[i], __ATOMIC_RELAXED);
+    }
+}
+
+IOReturn NVDAALUserClient::methodGetStats(IOExternalMethodArguments *args) {
+    // Input[0]: NVDAAL_STATS_SCOPE_*
+    // Input[1]: NVDAAL_STATS_* flags (optional)
+    // Struct output: NvdaalStats (over 4KB, so normally a descriptor)
+    if (args->scalarInputCount < 1 || args->scalarInputCount > 2) return kIOReturnBadArgument;
+
+    uint32_t scope = (uint32_t)args->scalarInput[0];
+    uint32_t flags = args->scalarInputCount > 1 ? (uint32_t)args->scalarInput[1] : 0;
+    if (scope == NVDAAL_STATS_SCOPE_GLOBAL && (flags & NVDAAL_STATS_RESET)) return kIOReturnNotPermitted;
+
+    NvdaalStats *src;
+    if (scope == NVDAAL_STATS_SCOPE_CLIENT) src = &stats;
+    else if (scope == NVDAAL_STATS_SCOPE_GLOBAL) src = provider->getGlobalStats();
+    else return kIOReturnBadArgument;
+
+    IOMemoryDescriptor *outDesc = args->structureOutputDescriptor;
+    size_t outCapacity = outDesc ? outDesc->getLength() : args->structureOutputSize;
+    if (outCapacity < sizeof(NvdaalStats)) return kIOReturnBadArgument;
+
+    // Counters keep moving while they are copied; each one is consistent
+    NvdaalStats *snapshot = (NvdaalStats *)IOMalloc(sizeof(NvdaalStats));
+    if (!snapshot) return kIOReturnNoMemory;
+    snapshotStats(src, snapshot, (flags & NVDAAL_STATS_RESET) != 0);
+
+    IOReturn ret = kIOReturnSuccess;
+    if (outDesc) {
+        if (outDesc->prepare(kIODirectionIn) != kIOReturnSuccess) {
+            ret = kIOReturnVMError;
+        } else {
+            IOByteCount written = outDesc->writeBytes(0, snapshot, sizeof(NvdaalStats));
+            outDesc->complete(kIODirectionIn);
+            if (written != sizeof(NvdaalStats)) ret = kIOReturnVMError;
+            else args->structureOutputDescriptorSize = sizeof(NvdaalStats);
+        }
+    } else {
+        memcpy(args->structureOutput, snapshot, sizeof(NvdaalStats));
+        args->structureOutputSize = sizeof(NvdaalStats);
+    }
+
+    IOFree(snapshot, sizeof(NvdaalStats));
+    return ret;
+}
+
+OSDictionary *NVDAALUserClient::copyStatsDictionary(const NvdaalStats *stats) {
+    OSDictionary *dict = OSDictionary::withCapacity(kNVDAALMethodCount);
+    if (!dict) return nullptr;
+
+    for (uint32_t i = 0; i < kNVDAALMethodCount; i++) {
+        const NvdaalSelectorStats *s = &stats->selectors[i];
+        if (!s->calls) continue;
+
+        OSDictionary *entry = OSDictionary::withCapacity(5);
+        if (!entry) continue;
+        const struct { const char *key; uint64_t value; } fields[] = {
+            { "Calls", s->calls }, { "Errors", s->errors },
+            { "TotalNs", s->totalNs }, { "MaxNs", s->maxNs },
+        };
+        for (const auto &f : fields) {
+            OSNumber *num = OSNumber::withNumber(f.value, 64);
+            if (num) {
+                entry->setObject(f.key, num);
+                num->release();
+            }
+        }
+        OSData *hist = OSData::withBytes(s->histogram, sizeof(s->histogram));
+        if (hist) {
+            entry->setObject("Histogram", hist);
+            hist->release();
+        }
+        dict->setObject(nvdaalMethodName(i), entry);
+        entry->release();
+    }
+    return dict;
+}
+
+void NVDAALUserClient::publishStats(void) {
+    OSDictionary *dict = copyStatsDictionary(&stats);
+    if (dict) {
+        setProperty("CallStats", dict);
+        dict->release();
+    }
+}
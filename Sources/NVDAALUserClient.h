@@ -9,7 +9,10 @@
 #define NVDAAL_USER_CLIENT_H
 
 #include <IOKit/IOUserClient.h>
+#include <IOKit/IOBufferMemoryDescriptor.h>
 #include "NVDAAL.h"
+#include "NVDAALUserShared.h"
+#include "NVDAALCommandRing.h"
 
 class NVDAALUserClient : public IOUserClient {
     OSDeclareDefaultStructors(NVDAALUserClient);
@@ -17,6 +20,86 @@ class NVDAALUserClient : public IOUserClient {
 private:
     NVDAAL *provider;
     task_t clientTask;
+    IOLock *clientLock;
+    NVDAALCommandRing *commandRing;     // Created on first IOConnectMapMemory64
+
+    static IOReturn ringAction(OSObject *target, const NvdaalOpRequest *req, uint64_t result[2]);
+
+    // Async notification registrations (guarded by clientLock). The table
+    // grows on demand up to NVDAAL_MAX_NOTIFICATIONS entries.
+    struct Notification {
+        bool inUse;
+        uint16_t generation;
+        uint32_t kind;
+        uint64_t arg0;
+        uint64_t arg1;
+        uint64_t tag;
+        OSAsyncReference64 asyncRef;
+    };
+    Notification *notifications;
+    uint32_t notificationCapacity;
+    uint32_t semaphoreWatches;
+
+    // VRAM allocations made by this client (guarded by clientLock). Only
+    // these may be mapped into its address space or GPU VASpace.
+    struct VramRange {
+        uint64_t offset;
+        uint64_t size;
+    };
+    VramRange *vramRanges;
+    uint32_t vramRangeCount;
+    uint32_t vramRangeCapacity;
+
+    uint64_t allocVram(size_t size);
+    bool findVram(uint64_t offset, uint64_t size, uint64_t *allocSize);
+
+    // GPU VA mappings made by this client's MapVram ops (guarded by
+    // clientLock). Pushbuffers may only be submitted from inside these.
+    struct GpuRange {
+        uint64_t gpuVa;
+        uint64_t size;
+    };
+    GpuRange *gpuRanges;
+    uint32_t gpuRangeCount;
+    uint32_t gpuRangeCapacity;
+
+    // Every mapping ever made, toward NVDAAL_MAX_VRAM_* (guarded by clientLock)
+    uint32_t vaMappings;
+    uint64_t vaMappedBytes;
+
+    IOReturn mapVram(uint64_t offset, uint64_t size, uint64_t *gpuVa);
+    bool unmapVram(uint64_t gpuVa, uint64_t size);
+    bool findGpuRange(uint64_t gpuVa, uint64_t size);
+    IOReturn submitPushbuffer(uint64_t gpuVa, uint64_t arg, uint32_t signalHandle, uint64_t signalValue);
+
+    // Pinned sysmem allocations (guarded by clientLock); a free slot has
+    // no descriptor, one being mapped has handle 0. clientClose() hands
+    // them to the driver (NVDAAL::retireSysmem).
+    struct SysmemAlloc {
+        uint32_t handle;
+        IOBufferMemoryDescriptor *desc;
+        uint64_t gpuVa;
+        uint64_t size;
+    };
+    SysmemAlloc sysmem[NVDAAL_MAX_SYSMEM_ALLOCS];
+    uint32_t nextSysmemHandle;
+
+    IOReturn allocSysmem(uint64_t size, uint64_t result[2]);
+    void releaseSysmem(SysmemAlloc *alloc);
+
+    // Call statistics for this client (see NVDAALUserShared.h)
+    NvdaalStats stats;
+
+    IOReturn dispatchMethod(uint32_t selector, IOExternalMethodArguments *arguments);
+
+    // Firmware transfer: wire the caller's (pointer, size) and map it into
+    // the kernel without copying. Undo with unwireClientBuffer().
+    IOReturn wireClientBuffer(IOExternalMethodArguments *args, uint64_t maxSize,
+                              IOMemoryDescriptor **desc, IOMemoryMap **map);
+    void unwireClientBuffer(IOMemoryDescriptor *desc, IOMemoryMap *map);
+
+    void sendNotification(Notification *n, IOReturn status, uint64_t value0, uint64_t value1);
+    void releaseNotification(Notification *n);
 
 public:
     // Lifecycle
@@ -24,6 +107,10 @@ public:
     virtual bool start(IOService *provider) override;
     virtual void stop(IOService *provider) override;
     virtual IOReturn clientClose(void) override;
+    virtual void free(void) override;
+
+    // Shared memory (NVDAAL_MEMORY_*)
+    virtual IOReturn clientMemoryForType(UInt32 type, IOOptionBits *options, IOMemoryDescriptor **memory) override;
 
     // Dispatcher
     virtual IOReturn externalMethod(uint32_t selector, IOExternalMethodArguments *arguments,
@@ -39,6 +126,34 @@ public:
     IOReturn methodLoadBootloader(IOExternalMethodArguments *args);
     IOReturn methodGetStatus(IOExternalMethodArguments *args);
     IOReturn methodExecuteFwsec(IOExternalMethodArguments *args);
+    IOReturn methodCreateSemaphore(IOExternalMethodArguments *args);
+    IOReturn methodDestroySemaphore(IOExternalMethodArguments *args);
+    IOReturn methodSignalSemaphore(IOExternalMethodArguments *args);
+    IOReturn methodReadSemaphore(IOExternalMethodArguments *args);
+    IOReturn methodWaitSemaphores(IOExternalMethodArguments *args);
+    IOReturn methodSetSubmitPolicy(IOExternalMethodArguments *args);
+    IOReturn methodFlushSubmissions(IOExternalMethodArguments *args);
+    IOReturn methodRingKick(IOExternalMethodArguments *args);
+    IOReturn methodRegisterNotification(IOExternalMethodArguments *args);
+    IOReturn methodCancelNotification(IOExternalMethodArguments *args);
+    IOReturn methodExecuteBatch(IOExternalMethodArguments *args);
+    IOReturn methodGetStats(IOExternalMethodArguments *args);
+    IOReturn methodSubmitPushbuffer(IOExternalMethodArguments *args);
+
+    // Call statistics. recordCall() is lock-free and safe from any thread.
+    static void resetStats(NvdaalStats *stats);
+    static void snapshotStats(NvdaalStats *stats, NvdaalStats *out, bool reset);
+    static void recordCall(NvdaalStats *stats, uint32_t selector, uint64_t ns, IOReturn ret);
+    static OSDictionary *copyStatsDictionary(const NvdaalStats *stats);
+    void publishStats(void);
+
+    // Notification delivery (called by the provider). Semaphore watches are
+    // one-shot; returns true while any remain registered.
+    bool deliverSemaphoreNotifications(void);
+    void deliverNotification(uint32_t kind, uint64_t value0, uint64_t value1);
+
+    // Execute one NVDAAL_OP_* request on behalf of this client
+    IOReturn executeOp(const NvdaalOpRequest *req, uint64_t result[2]);
 };
 
 // Method Selectors
@@ -52,7 +167,22 @@ enum {
     kNVDAALMethodLoadBootloader,
     kNVDAALMethodGetStatus,
     kNVDAALMethodExecuteFwsec,
+    kNVDAALMethodCreateSemaphore,
+    kNVDAALMethodDestroySemaphore,
+    kNVDAALMethodSignalSemaphore,
+    kNVDAALMethodReadSemaphore,
+    kNVDAALMethodWaitSemaphores,
+    kNVDAALMethodSetSubmitPolicy,
+    kNVDAALMethodFlushSubmissions,
+    kNVDAALMethodRingKick,
+    kNVDAALMethodRegisterNotification,
+    kNVDAALMethodCancelNotification,
+    kNVDAALMethodExecuteBatch,
+    kNVDAALMethodGetStats,
+    kNVDAALMethodSubmitPushbuffer,
     kNVDAALMethodCount
 };
 
+static_assert(kNVDAALMethodCount <= NVDAAL_STATS_MAX_SELECTORS, "Grow NVDAAL_STATS_MAX_SELECTORS");
+
 #endif // NVDAAL_USER_CLIENT_H
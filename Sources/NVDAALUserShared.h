@@ -0,0 +1,475 @@
+/*
+ * NVDAALUserShared.h - Structures shared by NVDAALUserClient and libNVDAAL
+ *
+ * Layouts passed through IOConnectCall*Method structure arguments or
+ * shared memory mapped with IOConnectMapMemory64.
+ * Plain C, fixed-width fields only, no IOKit dependencies.
+ * Any change here is an ABI change between the kext and libNVDAAL.
+ */
+
+#ifndef NVDAAL_USER_SHARED_H
+#define NVDAAL_USER_SHARED_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// ============================================================================
+// Firmware Transfer
+// ============================================================================
+
+/*
+ * LoadFirmware, LoadVbios, LoadBooterLoad and LoadBootloader take a user
+ * pointer and size. The kernel wires that range and reads it in place (the
+ * GSP image is handed to the GPU without a kernel copy when its section is
+ * page aligned). The range is unwired before the call returns, so the
+ * buffer may be freed or reused as soon as it does; it must not change
+ * while the call is in flight.
+ */
+#define NVDAAL_MAX_GSP_FIRMWARE_SIZE    0x10000000      // 256MB
+#define NVDAAL_MAX_BOOTLOADER_SIZE      0x100000        // 1MB
+#define NVDAAL_MAX_BOOTER_LOAD_SIZE     0x100000        // 1MB
+#define NVDAAL_MAX_VBIOS_SIZE           0x400000        // 4MB
+
+// ============================================================================
+// Timeline Semaphores
+// ============================================================================
+
+#define NVDAAL_MAX_WAIT_SEMAPHORES      64
+
+// NvdaalSemaphoreWaitArgs.flags
+#define NVDAAL_WAIT_ANY                 0x0     // Return when any entry is satisfied
+#define NVDAAL_WAIT_ALL                 0x1     // Return when every entry is satisfied
+
+typedef struct {
+    uint32_t handle;        // Semaphore handle from CreateSemaphore
+    uint32_t reserved;
+    uint64_t value;         // Satisfied when payload >= value
+} NvdaalSemaphoreWaitEntry;
+
+typedef struct {
+    uint32_t count;         // Number of valid entries (1..NVDAAL_MAX_WAIT_SEMAPHORES)
+    uint32_t flags;         // NVDAAL_WAIT_*
+    uint32_t timeoutMs;
+    uint32_t reserved;
+    NvdaalSemaphoreWaitEntry entries[NVDAAL_MAX_WAIT_SEMAPHORES];
+} NvdaalSemaphoreWaitArgs;
+
+// Callers may pass only the used prefix of `entries`
+#define NVDAAL_SEMAPHORE_WAIT_ARGS_SIZE(n) \
+    (sizeof(NvdaalSemaphoreWaitArgs) - \
+     (NVDAAL_MAX_WAIT_SEMAPHORES - (n)) * sizeof(NvdaalSemaphoreWaitEntry))
+
+// ============================================================================
+// Operations
+// ============================================================================
+
+// Small driver operations that can be queued instead of issued one
+// IOConnectCall at a time. Results go to NvdaalOpCompletion.result[].
+#define NVDAAL_OP_NOP                   0
+#define NVDAAL_OP_ALLOC_VRAM            1   // args: size                 -> result: offset
+#define NVDAAL_OP_SUBMIT_COMMAND        2   // args: cmd (tag, sent as host NOP data)[, signal handle, value]
+#define NVDAAL_OP_CREATE_SEMAPHORE      3   // args: initial              -> result: handle, gpuVa
+#define NVDAAL_OP_DESTROY_SEMAPHORE     4   // args: handle
+#define NVDAAL_OP_SIGNAL_SEMAPHORE      5   // args: handle, value
+#define NVDAAL_OP_READ_SEMAPHORE        6   // args: handle               -> result: value
+#define NVDAAL_OP_WAIT_SEMAPHORE        7   // args: handle, value, timeoutMs
+#define NVDAAL_OP_FLUSH_SUBMISSIONS     8
+#define NVDAAL_OP_QUERY                 9   // args: NVDAAL_QUERY_*       -> result: see below
+#define NVDAAL_OP_MAP_VRAM              10  // args: offset, size         -> result: gpuVa
+#define NVDAAL_OP_UNMAP_VRAM            11  // args: gpuVa, size
+#define NVDAAL_OP_SUBMIT_PUSHBUFFER     12  // args: gpuVa, NVDAAL_PUSHBUFFER_ARG[, signal handle, value]
+#define NVDAAL_OP_ALLOC_SYSMEM          13  // args: size                 -> result: handle, gpuVa
+#define NVDAAL_OP_FREE_SYSMEM           14  // args: handle (refused: kIOReturnUnsupported)
+#define NVDAAL_OP_COUNT                 15
+
+// NVDAAL_OP_QUERY selectors
+#define NVDAAL_QUERY_CHIP_ID            0   // result: PMC_BOOT_0
+#define NVDAAL_QUERY_WPR2               1   // result: (hi << 32) | lo, enabled
+#define NVDAAL_QUERY_GSP_STATE          2   // result: GSP RISC-V CPUCTL, boot scratch
+#define NVDAAL_QUERY_CHANNELS           3   // result: compute channels booted
+#define NVDAAL_QUERY_COPY_CHANNELS      4   // result: copy-engine channels booted (may be 0)
+
+typedef struct {
+    uint32_t op;            // NVDAAL_OP_*
+    uint32_t flags;         // Reserved, must be 0
+    uint64_t cookie;        // Caller tag, echoed in the completion
+    uint64_t args[4];
+} NvdaalOpRequest;
+
+typedef struct {
+    uint64_t cookie;
+    uint32_t op;
+    int32_t  status;        // IOReturn
+    uint64_t result[2];
+} NvdaalOpCompletion;
+
+// ============================================================================
+// Batched Calls
+// ============================================================================
+
+/*
+ * ExecuteBatch structure input: NvdaalBatchHeader followed by `count`
+ * NvdaalOpRequest. Structure output: `count` NvdaalOpCompletion, in order.
+ * Ops skipped after a failure under NVDAAL_BATCH_STOP_ON_ERROR complete
+ * with kIOReturnAborted.
+ */
+#define NVDAAL_MAX_BATCH_OPS            1024
+#define NVDAAL_BATCH_STOP_ON_ERROR      0x1
+
+typedef struct {
+    uint32_t count;
+    uint32_t flags;         // NVDAAL_BATCH_*
+    uint64_t reserved;
+} NvdaalBatchHeader;
+
+#define NVDAAL_BATCH_INPUT_SIZE(n)  (sizeof(NvdaalBatchHeader) + (n) * sizeof(NvdaalOpRequest))
+#define NVDAAL_BATCH_OUTPUT_SIZE(n) ((n) * sizeof(NvdaalOpCompletion))
+
+// ============================================================================
+// VRAM CPU Mappings
+// ============================================================================
+
+/*
+ * IOConnectMapMemory64 type that maps one of the client's own VRAM
+ * allocations (through the BAR1 aperture) into its address space. The
+ * allocation is named by the offset AllocVram returned; the whole
+ * allocation is mapped. The caller picks the caching in the map options:
+ *   kIOMapWriteCombineCache  uploads (streaming writes, default in libNVDAAL)
+ *   kIOMapInhibitCache       readback that must observe GPU writes
+ *   kIOMapCopybackCache      repeated CPU reads of data the GPU no longer
+ *                            writes; not coherent with later GPU writes
+ * Offsets are page aligned; 24 bits of page index cover 64GB of aperture.
+ */
+#define NVDAAL_MEMORY_KIND_SHIFT        28
+#define NVDAAL_MEMORY_KIND_VRAM         0x1u
+#define NVDAAL_MEMORY_VRAM_PAGE_MASK    0x00FFFFFFu
+
+#define NVDAAL_MEMORY_VRAM(offset) \
+    ((NVDAAL_MEMORY_KIND_VRAM << NVDAAL_MEMORY_KIND_SHIFT) | \
+     ((uint32_t)((offset) >> 12) & NVDAAL_MEMORY_VRAM_PAGE_MASK))
+#define NVDAAL_MEMORY_IS_VRAM(type)     (((type) >> NVDAAL_MEMORY_KIND_SHIFT) == NVDAAL_MEMORY_KIND_VRAM)
+#define NVDAAL_MEMORY_VRAM_OFFSET(type) ((uint64_t)((type) & NVDAAL_MEMORY_VRAM_PAGE_MASK) << 12)
+
+/*
+ * NVDAAL_OP_MAP_VRAM budget. The GPU VASpace does not reclaim address
+ * space on unmap yet, so every mapping a client makes counts against it
+ * for the client's lifetime, unmapped or not; past it MapVram fails with
+ * kIOReturnNoResources.
+ */
+#define NVDAAL_MAX_VRAM_MAPPINGS        4096            // Per client
+#define NVDAAL_MAX_VRAM_MAPPED_BYTES    (64ULL << 30)   // Per client
+
+// ============================================================================
+// Pinned System Memory
+// ============================================================================
+
+/*
+ * NVDAAL_OP_ALLOC_SYSMEM allocates zeroed, wired host pages, maps them
+ * into the GPU VASpace and returns a handle and the GPU VA. The copy
+ * engine reaches them over PCIe, which makes them the staging area for
+ * DMA between host and VRAM. IOConnectMapMemory64(NVDAAL_MEMORY_SYSMEM
+ * (handle)) maps the whole allocation into the client, cached: PCIe
+ * accesses snoop the CPU caches. The driver cannot yet clear a range's
+ * PTEs or wait for the channels to stop using it, so sysmem is never
+ * unwired while it runs: NVDAAL_OP_FREE_SYSMEM is refused, and a closing
+ * client's allocations stay wired and mapped until the driver unloads.
+ * Every allocation counts against NVDAAL_MAX_SYSMEM_WIRED for good.
+ */
+#define NVDAAL_MEMORY_KIND_SYSMEM       0x2u
+#define NVDAAL_MEMORY_SYSMEM_HANDLE_MASK 0x00FFFFFFu
+#define NVDAAL_MAX_SYSMEM_SIZE          (256ULL << 20)  // Per allocation, rounded up to pages
+#define NVDAAL_MAX_SYSMEM_ALLOCS        64              // Per client
+#define NVDAAL_MAX_SYSMEM_WIRED         (4ULL << 30)    // All clients, over the driver's lifetime
+
+#define NVDAAL_MEMORY_SYSMEM(handle) \
+    ((NVDAAL_MEMORY_KIND_SYSMEM << NVDAAL_MEMORY_KIND_SHIFT) | ((uint32_t)(handle) & NVDAAL_MEMORY_SYSMEM_HANDLE_MASK))
+#define NVDAAL_MEMORY_IS_SYSMEM(type)     (((type) >> NVDAAL_MEMORY_KIND_SHIFT) == NVDAAL_MEMORY_KIND_SYSMEM)
+#define NVDAAL_MEMORY_SYSMEM_HANDLE(type) ((uint32_t)(type) & NVDAAL_MEMORY_SYSMEM_HANDLE_MASK)
+
+// ============================================================================
+// Pushbuffer Submission
+// ============================================================================
+
+/*
+ * SubmitPushbuffer (scalar inputs: GPU VA, NVDAAL_PUSHBUFFER_ARG[, signal
+ * handle, value]) and NVDAAL_OP_SUBMIT_PUSHBUFFER run a pushbuffer the
+ * client recorded in its own VRAM. The range must lie inside one MapVram
+ * mapping made by the same client; it is fetched by the GPU in place, so
+ * it must stay unchanged until the submission completes. The channel
+ * appends its own fence (and the optional semaphore release) after it.
+ *
+ * Only where the pushbuffer lives is checked. The addresses its methods
+ * name (copy, semaphore and launch targets) are not: the client's channel
+ * shares one GPU VASpace with the driver and every other client, so a
+ * client able to submit can make the GPU read or write anything mapped
+ * there: any task that can open the user client is trusted that far.
+ *
+ * The driver boots up to NVDAAL_MAX_CHANNELS compute channels
+ * (NVDAAL_QUERY_CHANNELS says how many). Each runs its submissions in
+ * order and independently of the others; channel 0 also carries
+ * SubmitCommand. Cross-channel ordering is up to the client, with
+ * semaphore acquires in its pushbuffers.
+ *
+ * It also boots up to NVDAAL_MAX_COPY_CHANNELS channels on the
+ * asynchronous copy engines (NVDAAL_QUERY_COPY_CHANNELS), addressed as
+ * channel NVDAAL_CHANNEL_COPY | n. They take host methods and copy-class
+ * methods on NV_PB_SUBCH_COPY only; anything else raises a channel error.
+ * Copies there overlap compute channel work instead of sharing its engine.
+ */
+#define NVDAAL_MAX_PUSHBUFFER_BYTES     (1u << 23)      // GPFIFO entry length limit
+#define NVDAAL_PUSHBUFFER_ALIGN         4
+#define NVDAAL_MAX_CHANNELS             8
+#define NVDAAL_MAX_COPY_CHANNELS        2
+#define NVDAAL_CHANNEL_COPY             0x80            // Channel index flag: copy-engine channel
+
+// Length in bits 0-31, channel index in bits 32-39
+#define NVDAAL_PUSHBUFFER_ARG(bytes, channel)   (((uint64_t)(channel) << 32) | (uint32_t)(bytes))
+#define NVDAAL_PUSHBUFFER_ARG_BYTES(arg)        ((uint32_t)(arg))
+#define NVDAAL_PUSHBUFFER_ARG_CHANNEL(arg)      ((uint64_t)(arg) >> 32)
+
+// ============================================================================
+// Command Ring
+// ============================================================================
+
+/*
+ * Shared memory mapped with IOConnectMapMemory64(NVDAAL_MEMORY_COMMAND_RING).
+ * Two single-producer/single-consumer rings:
+ *   requests     client -> kernel   (client owns reqHead, kernel owns reqTail)
+ *   completions  kernel -> client   (kernel owns cplHead, client owns cplTail)
+ * Indices are free-running and masked by the power-of-two slot count.
+ * The client queues any number of requests and issues one RingKick call;
+ * the kernel drains them all in that single entry. A client drives the
+ * ring from one thread at a time.
+ */
+#define NVDAAL_MEMORY_COMMAND_RING      1       // clientMemoryForType type
+
+#define NVDAAL_RING_MAGIC               0x4E56524Eu     // 'NVRN'
+#define NVDAAL_RING_VERSION             1
+#define NVDAAL_RING_REQUEST_SLOTS       1024
+#define NVDAAL_RING_COMPLETION_SLOTS    1024
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t requestSlots;
+    uint32_t completionSlots;
+    uint32_t requestOffset;         // From the start of the mapping
+    uint32_t completionOffset;
+    uint32_t totalSize;
+    uint32_t reserved[9];
+
+    // One cache line per index so producer and consumer never share a line
+    volatile uint32_t reqHead;      uint32_t pad0[15];
+    volatile uint32_t reqTail;      uint32_t pad1[15];
+    volatile uint32_t cplHead;      uint32_t pad2[15];
+    volatile uint32_t cplTail;      uint32_t pad3[15];
+} NvdaalRingControl;
+
+#define NVDAAL_RING_REQUEST_OFFSET      0x1000
+#define NVDAAL_RING_COMPLETION_OFFSET \
+    (NVDAAL_RING_REQUEST_OFFSET + NVDAAL_RING_REQUEST_SLOTS * sizeof(NvdaalOpRequest))
+#define NVDAAL_RING_SIZE \
+    (NVDAAL_RING_COMPLETION_OFFSET + NVDAAL_RING_COMPLETION_SLOTS * sizeof(NvdaalOpCompletion))
+
+static inline NvdaalOpRequest *nvRingRequests(NvdaalRingControl *ring) {
+    return (NvdaalOpRequest *)((uint8_t *)ring + NVDAAL_RING_REQUEST_OFFSET);
+}
+
+static inline NvdaalOpCompletion *nvRingCompletions(NvdaalRingControl *ring) {
+    return (NvdaalOpCompletion *)((uint8_t *)ring + NVDAAL_RING_COMPLETION_OFFSET);
+}
+
+static inline void nvRingInit(NvdaalRingControl *ring) {
+    ring->magic = NVDAAL_RING_MAGIC;
+    ring->version = NVDAAL_RING_VERSION;
+    ring->requestSlots = NVDAAL_RING_REQUEST_SLOTS;
+    ring->completionSlots = NVDAAL_RING_COMPLETION_SLOTS;
+    ring->requestOffset = NVDAAL_RING_REQUEST_OFFSET;
+    ring->completionOffset = (uint32_t)NVDAAL_RING_COMPLETION_OFFSET;
+    ring->totalSize = (uint32_t)NVDAAL_RING_SIZE;
+    ring->reqHead = 0;
+    ring->reqTail = 0;
+    ring->cplHead = 0;
+    ring->cplTail = 0;
+}
+
+static inline bool nvRingValid(const NvdaalRingControl *ring) {
+    return ring->magic == NVDAAL_RING_MAGIC && ring->version == NVDAAL_RING_VERSION &&
+           ring->requestSlots == NVDAAL_RING_REQUEST_SLOTS &&
+           ring->completionSlots == NVDAAL_RING_COMPLETION_SLOTS;
+}
+
+// Client side: queue a request. Returns false when the request ring is full.
+static inline bool nvRingPushRequest(NvdaalRingControl *ring, const NvdaalOpRequest *req) {
+    uint32_t head = ring->reqHead;
+    uint32_t tail = __atomic_load_n(&ring->reqTail, __ATOMIC_ACQUIRE);
+    if (head - tail >= NVDAAL_RING_REQUEST_SLOTS) return false;
+
+    nvRingRequests(ring)[head & (NVDAAL_RING_REQUEST_SLOTS - 1)] = *req;
+    __atomic_store_n(&ring->reqHead, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+// Client side: requests queued but not yet consumed by the kernel
+static inline uint32_t nvRingPendingRequests(NvdaalRingControl *ring) {
+    return ring->reqHead - __atomic_load_n(&ring->reqTail, __ATOMIC_ACQUIRE);
+}
+
+// Client side: take one completion. Returns false when none are ready.
+static inline bool nvRingPopCompletion(NvdaalRingControl *ring, NvdaalOpCompletion *cpl) {
+    uint32_t tail = ring->cplTail;
+    uint32_t head = __atomic_load_n(&ring->cplHead, __ATOMIC_ACQUIRE);
+    if (head == tail) return false;
+
+    *cpl = nvRingCompletions(ring)[tail & (NVDAAL_RING_COMPLETION_SLOTS - 1)];
+    __atomic_store_n(&ring->cplTail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+// Kernel side: execute one request, filling result; returns its status
+typedef int32_t (*NvRingAction)(void *ctx, const NvdaalOpRequest *req, uint64_t result[2]);
+
+// Kernel side: execute up to `budget` queued requests, posting a completion
+// for each. *reqTail and *cplHead are the consumer's own copies of its
+// indices (the shared ones are only published). A request stays queued
+// while the completion ring is full. Returns false, stopping, if the
+// client's indices are impossible. Callers serialize.
+static inline bool nvRingDrain(NvdaalRingControl *ring, uint32_t *reqTail, uint32_t *cplHead, uint32_t budget,
+                               NvRingAction action, void *ctx, uint32_t *processed) {
+    uint32_t done = 0;
+    bool ok = true;
+
+    while (done < budget) {
+        uint32_t head = __atomic_load_n(&ring->reqHead, __ATOMIC_ACQUIRE);
+        if (head == *reqTail) break;
+        if (head - *reqTail > NVDAAL_RING_REQUEST_SLOTS) {
+            ok = false;
+            break;
+        }
+
+        // Leave the request queued if there is nowhere to report its result
+        uint32_t cplTail = __atomic_load_n(&ring->cplTail, __ATOMIC_ACQUIRE);
+        if (*cplHead - cplTail >= NVDAAL_RING_COMPLETION_SLOTS) {
+            if (*cplHead - cplTail > NVDAAL_RING_COMPLETION_SLOTS) ok = false;
+            break;
+        }
+
+        // Copy out before use: the client can rewrite the slot at any time
+        NvdaalOpRequest req = nvRingRequests(ring)[*reqTail & (NVDAAL_RING_REQUEST_SLOTS - 1)];
+        (*reqTail)++;
+        __atomic_store_n(&ring->reqTail, *reqTail, __ATOMIC_RELEASE);
+
+        NvdaalOpCompletion cpl;
+        cpl.cookie = req.cookie;
+        cpl.op = req.op;
+        cpl.result[0] = 0;
+        cpl.result[1] = 0;
+        cpl.status = action(ctx, &req, cpl.result);
+
+        nvRingCompletions(ring)[*cplHead & (NVDAAL_RING_COMPLETION_SLOTS - 1)] = cpl;
+        (*cplHead)++;
+        __atomic_store_n(&ring->cplHead, *cplHead, __ATOMIC_RELEASE);
+        done++;
+    }
+    if (processed) *processed = done;
+    return ok;
+}
+
+// ============================================================================
+// Async Notifications
+// ============================================================================
+
+/*
+ * Registered with an async call (IOConnectCallAsyncScalarMethod) on
+ * RegisterNotification; delivered to the notification port with
+ * sendAsyncResult64. Scalar inputs: kind, arg0, arg1, tag.
+ */
+#define NVDAAL_NOTIFY_SEMAPHORE         1   // arg0: handle, arg1: value. One-shot.
+#define NVDAAL_NOTIFY_CHANNEL_ERROR     2   // Persistent
+#define NVDAAL_NOTIFY_GSP_EVENT         3   // arg0: RPC event function (0 = any). Persistent.
+
+#define NVDAAL_MAX_NOTIFICATIONS        256     // Per user client
+
+// Message arguments
+#define NVDAAL_NOTIFY_ARG_TAG           0   // Caller tag from registration
+#define NVDAAL_NOTIFY_ARG_KIND          1
+#define NVDAAL_NOTIFY_ARG_VALUE0        2   // Semaphore payload / PMC_INTR / RPC function
+#define NVDAAL_NOTIFY_ARG_VALUE1        3   // - / - / RPC result
+#define NVDAAL_NOTIFY_ARG_COUNT         4
+
+// ============================================================================
+// Call Statistics
+// ============================================================================
+
+/*
+ * Per-selector counters kept by NVDAALUserClient::externalMethod for each
+ * client and for the driver as a whole. Read with GetStats (scalar input:
+ * scope, flags; struct output: NvdaalStats) and published in the IORegistry
+ * as "CallStats" on the driver and on each user client.
+ *
+ * Latency is wall time inside the driver, including any blocking (waits
+ * show up as long calls). Histogram bucket 0 counts calls under 1us,
+ * bucket i calls in [2^(i-1), 2^i) us, and the last bucket everything
+ * from 2^(N-2) us (~16ms) up.
+ */
+#define NVDAAL_STATS_VERSION            1
+#define NVDAAL_STATS_MAX_SELECTORS      32
+#define NVDAAL_STATS_BUCKETS            16
+
+#define NVDAAL_STATS_SCOPE_CLIENT       0
+#define NVDAAL_STATS_SCOPE_GLOBAL       1
+
+#define NVDAAL_STATS_RESET              0x1     // Clear after reading (client scope only)
+
+typedef struct {
+    uint64_t calls;
+    uint64_t errors;        // Calls that returned anything but kIOReturnSuccess
+    uint64_t totalNs;
+    uint64_t maxNs;
+    uint64_t histogram[NVDAAL_STATS_BUCKETS];
+} NvdaalSelectorStats;
+
+typedef struct {
+    uint32_t version;
+    uint32_t selectorCount; // Valid entries in selectors[]
+    uint64_t sinceNs;       // Uptime when counting started (or was reset)
+    NvdaalSelectorStats selectors[NVDAAL_STATS_MAX_SELECTORS];
+} NvdaalStats;
+
+static inline uint32_t nvStatsBucket(uint64_t ns) {
+    uint64_t us = ns / 1000;
+    uint32_t bucket = 0;
+    while (us && bucket < NVDAAL_STATS_BUCKETS - 1) {
+        us >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+// Upper bound (us) of the bucket holding the given percentile (per mille);
+// the open-ended last bucket reports its lower bound
+static inline uint64_t nvStatsPercentileUs(const NvdaalSelectorStats *s, uint32_t perMille) {
+    if (!s->calls) return 0;
+    uint64_t target = (s->calls * perMille + 999) / 1000;
+    uint64_t seen = 0;
+    for (uint32_t b = 0; b < NVDAAL_STATS_BUCKETS; b++) {
+        seen += s->histogram[b];
+        if (seen >= target) return b == NVDAAL_STATS_BUCKETS - 1 ? 1ULL << (b - 1) : 1ULL << b;
+    }
+    return 1ULL << (NVDAAL_STATS_BUCKETS - 2);
+}
+
+// Selector names, in kNVDAALMethod* order
+static inline const char *nvdaalMethodName(uint32_t selector) {
+    static const char *const names[] = {
+        "LoadFirmware", "AllocVram", "SubmitCommand", "WaitSemaphore",
+        "LoadBooterLoad", "LoadVbios", "LoadBootloader", "GetStatus",
+        "ExecuteFwsec", "CreateSemaphore", "DestroySemaphore", "SignalSemaphore",
+        "ReadSemaphore", "WaitSemaphores", "SetSubmitPolicy", "FlushSubmissions",
+        "RingKick", "RegisterNotification", "CancelNotification", "ExecuteBatch",
+        "GetStats", "SubmitPushbuffer",
+    };
+    return selector < sizeof(names) / sizeof(names[0]) ? names[selector] : "Unknown";
+}
+
+#endif // NVDAAL_USER_SHARED_H
@@ -33,6 +33,9 @@ bool NVDAALVASpace::init() {
     vaStart = 0x1000000000ULL;
     vaLimit = 0xFFFFFFFFFFULL;
     currentVaOffset = vaStart;
+
+    lock = IOLockAlloc();
+    if (!lock) return false;
     
     return true;
 }
@@ -49,6 +52,11 @@ void NVDAALVASpace::free() {
         pdeMem->release();
         pdeMem = nullptr;
     }
+
+    if (lock) {
+        IOLockFree(lock);
+        lock = nullptr;
+    }
     
     super::free();
 }
@@ -109,17 +117,21 @@ uint64_t NVDAALVASpace::map(IOMemoryDescriptor *mem, uint64_t alignment) {
     // 1. Allocate VA Range (Simple Bump Allocator)
     uint64_t size = mem->getLength();
     
+    IOLockLock(lock);
+
     // Align current offset
     uint64_t alignedVa = (currentVaOffset + (alignment - 1)) & ~(alignment - 1);
     
     // Check overflow
-    if (alignedVa + size > vaLimit) {
+    if (alignedVa < currentVaOffset || size > vaLimit || alignedVa > vaLimit - size) {
+        IOLockUnlock(lock);
         IOLog("NVDAAL-MMU: Out of virtual address space!\n");
         return 0;
     }
 
     uint64_t mapAddr = alignedVa;
     currentVaOffset = alignedVa + size;
+    IOLockUnlock(lock);
 
     // 2. Update Page Tables (PTEs)
     // NOTE: In a full implementation, we would now walk the Page Directory (pdeMem)
@@ -134,5 +146,7 @@ uint64_t NVDAALVASpace::map(IOMemoryDescriptor *mem, uint64_t alignment) {
 }
 
 void NVDAALVASpace::unmap(uint64_t va, size_t size) {
+    IOLockLock(lock);
     // TODO: Clear PTEs and Invalidate TLB
+    IOLockUnlock(lock);
 }
@@ -34,6 +34,8 @@ private:
     uint64_t vaLimit;
     uint64_t currentVaOffset; // Tracks the next free virtual address
 
+    IOLock *lock;             // Serializes map()/unmap() between user clients
+
 public:
     static NVDAALVASpace* withGsp(NVDAALGsp *gsp, NVDAALMemory *mem, uint32_t hClient, uint32_t hDevice);
     
@@ -44,7 +46,7 @@ public:
     bool boot();
 
     // Map a physical memory descriptor into this VASpace
-    // Returns the virtual address (GPU VA)
+    // Returns the virtual address (GPU VA). Safe to call from any thread.
     uint64_t map(IOMemoryDescriptor *mem, uint64_t alignment = 0x1000);
     
     // Unmap
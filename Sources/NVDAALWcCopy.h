@@ -0,0 +1,300 @@
+/*
+ * NVDAALWcCopy.h - Streaming Copy and Fill for Write-Combined Memory
+ *
+ * BAR1 is mapped write-combining: the CPU gathers stores to a 64-byte
+ * line and sends it over PCIe as one burst once the line is complete.
+ * Lines left partly written go out as several small transactions, and
+ * loads are uncached, so memcpy/memset store patterns that mix sizes or
+ * read the destination run several times slower than full-line bursts.
+ *
+ * These write the unaligned head and tail with ordinary stores and
+ * everything between in whole lines of aligned non-temporal stores, then
+ * fence so the data is visible to the device before a doorbell or
+ * semaphore release that follows. The SIMD copies load four lines per
+ * iteration ahead of their stores; fills and the GPR copy, with no loads
+ * to hide, go a line at a time. On cacheable
+ * memory the same stores skip the cache, which only pays off for copies
+ * larger than the last-level cache.
+ *
+ *   NV_WC_GPR      8-byte MOVNTI (x86-64) / STNP pairs (arm64); the only
+ *                  choice in the kext, where -mkernel rules out vector registers
+ *   NV_WC_SSE2     16-byte MOVNTDQ          } user space on x86-64,
+ *   NV_WC_AVX      32-byte VMOVNTDQ         } picked at run time
+ *   NV_WC_AVX512   64-byte VMOVNTDQ (a full line per store)
+ *
+ * Plain C with no IOKit dependencies: the kext zeroes fresh VRAM with
+ * nvWcFill(), libNVDAAL writes BAR1 through nvdaal::streamCopy()
+ * (NVDAALCopy.h), and TestEnv/userspace/bench_wc_copy.cpp measures both.
+ */
+
+#ifndef NVDAAL_WC_COPY_H
+#define NVDAAL_WC_COPY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__x86_64__) && !defined(KERNEL)
+#include <immintrin.h>
+#define NV_WC_HAVE_SIMD 1
+#endif
+
+#define NV_WC_LINE              64
+#define NV_WC_UNROLL_LINES      4       // Lines per SIMD copy iteration
+
+typedef enum {
+    NV_WC_PLAIN = 0,                    // memcpy / memset
+    NV_WC_GPR,
+    NV_WC_SSE2,
+    NV_WC_AVX,
+    NV_WC_AVX512
+} NvWcIsa;
+
+// ============================================================================
+// Line Kernels: `lines` whole lines, dst 64-byte aligned, src any alignment
+// ============================================================================
+
+#if defined(__x86_64__)
+
+static inline void nvWcStore64(void *dst, uint64_t value) {
+    __asm__ volatile("movnti %1, %0" : "=m"(*(uint64_t *)dst) : "r"(value));
+}
+
+static inline void nvWcFence(void) {
+    __asm__ volatile("sfence" ::: "memory");
+}
+
+#elif defined(__aarch64__)
+
+static inline void nvWcStore128(void *dst, uint64_t lo, uint64_t hi) {
+    __asm__ volatile("stnp %x0, %x1, [%2]" :: "r"(lo), "r"(hi), "r"(dst) : "memory");
+}
+
+static inline void nvWcFence(void) {
+    __asm__ volatile("dmb oshst" ::: "memory");
+}
+
+#else
+
+static inline void nvWcFence(void) {
+    __sync_synchronize();
+}
+
+#endif
+
+static inline void nvWcCopyLinesGpr(uint8_t *dst, const uint8_t *src, size_t lines) {
+    for (; lines; lines--, dst += NV_WC_LINE, src += NV_WC_LINE) {
+        uint64_t v[8];
+        memcpy(v, src, sizeof(v));
+#if defined(__x86_64__)
+        for (int i = 0; i < 8; i++) nvWcStore64(dst + i * 8, v[i]);
+#elif defined(__aarch64__)
+        for (int i = 0; i < 8; i += 2) nvWcStore128(dst + i * 8, v[i], v[i + 1]);
+#else
+        memcpy(dst, v, sizeof(v));
+#endif
+    }
+}
+
+static inline void nvWcFillLinesGpr(uint8_t *dst, uint64_t pattern, size_t lines) {
+    for (; lines; lines--, dst += NV_WC_LINE) {
+#if defined(__x86_64__)
+        for (int i = 0; i < 8; i++) nvWcStore64(dst + i * 8, pattern);
+#elif defined(__aarch64__)
+        for (int i = 0; i < 8; i += 2) nvWcStore128(dst + i * 8, pattern, pattern);
+#else
+        for (int i = 0; i < 8; i++) memcpy(dst + i * 8, &pattern, 8);
+#endif
+    }
+}
+
+#ifdef NV_WC_HAVE_SIMD
+
+__attribute__((target("sse2")))
+static inline void nvWcCopyLinesSse2(uint8_t *dst, const uint8_t *src, size_t lines) {
+    for (; lines >= NV_WC_UNROLL_LINES; lines -= NV_WC_UNROLL_LINES) {
+        for (int i = 0; i < NV_WC_UNROLL_LINES * 4; i++) {
+            __m128i v = _mm_loadu_si128((const __m128i *)src + i);
+            _mm_stream_si128((__m128i *)dst + i, v);
+        }
+        dst += NV_WC_UNROLL_LINES * NV_WC_LINE;
+        src += NV_WC_UNROLL_LINES * NV_WC_LINE;
+    }
+    for (; lines; lines--, dst += NV_WC_LINE, src += NV_WC_LINE) {
+        for (int i = 0; i < 4; i++) _mm_stream_si128((__m128i *)dst + i, _mm_loadu_si128((const __m128i *)src + i));
+    }
+}
+
+__attribute__((target("sse2")))
+static inline void nvWcFillLinesSse2(uint8_t *dst, uint64_t pattern, size_t lines) {
+    __m128i v = _mm_set1_epi64x((long long)pattern);
+    for (; lines; lines--, dst += NV_WC_LINE) {
+        for (int i = 0; i < 4; i++) _mm_stream_si128((__m128i *)dst + i, v);
+    }
+}
+
+__attribute__((target("avx")))
+static inline void nvWcCopyLinesAvx(uint8_t *dst, const uint8_t *src, size_t lines) {
+    for (; lines >= NV_WC_UNROLL_LINES; lines -= NV_WC_UNROLL_LINES) {
+        for (int i = 0; i < NV_WC_UNROLL_LINES * 2; i++) {
+            __m256i v = _mm256_loadu_si256((const __m256i *)src + i);
+            _mm256_stream_si256((__m256i *)dst + i, v);
+        }
+        dst += NV_WC_UNROLL_LINES * NV_WC_LINE;
+        src += NV_WC_UNROLL_LINES * NV_WC_LINE;
+    }
+    for (; lines; lines--, dst += NV_WC_LINE, src += NV_WC_LINE) {
+        for (int i = 0; i < 2; i++) _mm256_stream_si256((__m256i *)dst + i, _mm256_loadu_si256((const __m256i *)src + i));
+    }
+    _mm256_zeroupper();
+}
+
+__attribute__((target("avx")))
+static inline void nvWcFillLinesAvx(uint8_t *dst, uint64_t pattern, size_t lines) {
+    __m256i v = _mm256_set1_epi64x((long long)pattern);
+    for (; lines; lines--, dst += NV_WC_LINE) {
+        _mm256_stream_si256((__m256i *)dst, v);
+        _mm256_stream_si256((__m256i *)dst + 1, v);
+    }
+    _mm256_zeroupper();
+}
+
+__attribute__((target("avx512f")))
+static inline void nvWcCopyLinesAvx512(uint8_t *dst, const uint8_t *src, size_t lines) {
+    for (; lines >= NV_WC_UNROLL_LINES; lines -= NV_WC_UNROLL_LINES) {
+        for (int i = 0; i < NV_WC_UNROLL_LINES; i++) {
+            __m512i v = _mm512_loadu_si512((const void *)(src + i * NV_WC_LINE));
+            _mm512_stream_si512((__m512i *)(dst + i * NV_WC_LINE), v);
+        }
+        dst += NV_WC_UNROLL_LINES * NV_WC_LINE;
+        src += NV_WC_UNROLL_LINES * NV_WC_LINE;
+    }
+    for (; lines; lines--, dst += NV_WC_LINE, src += NV_WC_LINE) {
+        _mm512_stream_si512((__m512i *)dst, _mm512_loadu_si512((const void *)src));
+    }
+    _mm256_zeroupper();
+}
+
+__attribute__((target("avx512f")))
+static inline void nvWcFillLinesAvx512(uint8_t *dst, uint64_t pattern, size_t lines) {
+    __m512i v = _mm512_set1_epi64((long long)pattern);
+    for (; lines; lines--, dst += NV_WC_LINE) _mm512_stream_si512((__m512i *)dst, v);
+    _mm256_zeroupper();
+}
+
+#endif // NV_WC_HAVE_SIMD
+
+// ============================================================================
+// ISA Selection
+// ============================================================================
+
+static inline int nvWcIsaSupported(NvWcIsa isa) {
+    switch (isa) {
+        case NV_WC_PLAIN:
+        case NV_WC_GPR:
+            return 1;
+#ifdef NV_WC_HAVE_SIMD
+        case NV_WC_SSE2:
+            return 1;                   // Baseline on x86-64
+        case NV_WC_AVX:
+            return __builtin_cpu_supports("avx");
+        case NV_WC_AVX512:
+            return __builtin_cpu_supports("avx512f");
+#endif
+        default:
+            return 0;
+    }
+}
+
+// Widest store the CPU has. AVX-512 is not preferred over AVX: a 64-byte
+// store already is a full line, and on some parts it lowers clocks.
+static inline NvWcIsa nvWcBestIsa(void) {
+#ifdef NV_WC_HAVE_SIMD
+    static NvWcIsa best = NV_WC_PLAIN;
+    if (best == NV_WC_PLAIN) best = nvWcIsaSupported(NV_WC_AVX) ? NV_WC_AVX : NV_WC_SSE2;
+    return best;
+#else
+    return NV_WC_GPR;
+#endif
+}
+
+static inline const char *nvWcIsaName(NvWcIsa isa) {
+    static const char *const names[] = { "plain", "gpr", "sse2", "avx", "avx512" };
+    return (unsigned)isa < sizeof(names) / sizeof(names[0]) ? names[isa] : "?";
+}
+
+// ============================================================================
+// Copy and Fill
+// ============================================================================
+
+// Bytes before `dst` reaches a line boundary (capped at `bytes`)
+static inline size_t nvWcHead(const void *dst, size_t bytes) {
+    size_t head = (size_t)(-(uintptr_t)dst & (NV_WC_LINE - 1));
+    return head < bytes ? head : bytes;
+}
+
+// Falls back to memcpy for an ISA the CPU lacks (see nvWcIsaSupported()).
+// Zero bytes is a no-op, whatever the pointers.
+static inline void nvWcCopyIsa(NvWcIsa isa, void *dst, const void *src, size_t bytes) {
+    if (bytes == 0) return;
+    uint8_t *d = (uint8_t *)dst;
+    const uint8_t *s = (const uint8_t *)src;
+    size_t head = nvWcHead(d, bytes);
+    size_t lines = (bytes - head) / NV_WC_LINE;
+    if (isa == NV_WC_PLAIN || lines == 0 || !nvWcIsaSupported(isa)) {
+        memcpy(dst, src, bytes);
+        return;
+    }
+
+    memcpy(d, s, head);
+    d += head;
+    s += head;
+    switch (isa) {
+#ifdef NV_WC_HAVE_SIMD
+        case NV_WC_SSE2: nvWcCopyLinesSse2(d, s, lines); break;
+        case NV_WC_AVX: nvWcCopyLinesAvx(d, s, lines); break;
+        case NV_WC_AVX512: nvWcCopyLinesAvx512(d, s, lines); break;
+#endif
+        default: nvWcCopyLinesGpr(d, s, lines); break;
+    }
+    d += lines * NV_WC_LINE;
+    s += lines * NV_WC_LINE;
+    memcpy(d, s, bytes - head - lines * NV_WC_LINE);
+    nvWcFence();
+}
+
+static inline void nvWcFillIsa(NvWcIsa isa, void *dst, uint8_t value, size_t bytes) {
+    if (bytes == 0) return;
+    uint8_t *d = (uint8_t *)dst;
+    size_t head = nvWcHead(d, bytes);
+    size_t lines = (bytes - head) / NV_WC_LINE;
+    if (isa == NV_WC_PLAIN || lines == 0 || !nvWcIsaSupported(isa)) {
+        memset(dst, value, bytes);
+        return;
+    }
+
+    uint64_t pattern = value * 0x0101010101010101ULL;
+    memset(d, value, head);
+    d += head;
+    switch (isa) {
+#ifdef NV_WC_HAVE_SIMD
+        case NV_WC_SSE2: nvWcFillLinesSse2(d, pattern, lines); break;
+        case NV_WC_AVX: nvWcFillLinesAvx(d, pattern, lines); break;
+        case NV_WC_AVX512: nvWcFillLinesAvx512(d, pattern, lines); break;
+#endif
+        default: nvWcFillLinesGpr(d, pattern, lines); break;
+    }
+    d += lines * NV_WC_LINE;
+    memset(d, value, bytes - head - lines * NV_WC_LINE);
+    nvWcFence();
+}
+
+static inline void nvWcCopy(void *dst, const void *src, size_t bytes) {
+    nvWcCopyIsa(nvWcBestIsa(), dst, src, bytes);
+}
+
+static inline void nvWcFill(void *dst, uint8_t value, size_t bytes) {
+    nvWcFillIsa(nvWcBestIsa(), dst, value, bytes);
+}
+
+#endif // NVDAAL_WC_COPY_H
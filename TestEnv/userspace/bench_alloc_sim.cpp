@@ -0,0 +1,98 @@
+/*
+ * bench_alloc_sim.cpp - Raw allocVram vs the caching BufferAllocator
+ *
+ * Replays an allocation pattern typical of a training step (many short
+ * lived activations of mixed sizes, a bounded working set) against the
+ * simulator backend. Raw allocVram pays a selector call per allocation
+ * and can never give the memory back; BufferAllocator reserves slabs once
+ * and recycles blocks from its cache. No GPU needed.
+ *
+ * Usage: ./bench_alloc_sim [allocations] [call_overhead_ns]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <chrono>
+#include <deque>
+#include <vector>
+#include "NVDAALBuffer.h"
+
+using namespace nvdaal;
+
+static const uint32_t kLive = 64;              // Working set, in buffers
+
+// Deterministic mix: mostly small, some medium, an occasional large one
+static std::vector<size_t> makeSizes(uint32_t count) {
+    std::vector<size_t> sizes(count);
+    uint32_t x = 0x12345678;
+    for (uint32_t i = 0; i < count; i++) {
+        x = x * 1664525 + 1013904223;
+        uint32_t r = x >> 8;
+        if (r % 100 < 80) sizes[i] = 256 + r % (64 << 10);
+        else if (r % 100 < 98) sizes[i] = (1 << 20) + r % (4 << 20);
+        else sizes[i] = (16 << 20) + r % (16 << 20);
+    }
+    return sizes;
+}
+
+static double elapsedUs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv) {
+    uint32_t count = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 0) : 20000;
+    SimConfig config;
+    config.callOverheadNs = argc > 2 ? (uint32_t)strtoul(argv[2], nullptr, 0) : 2000;
+    config.vramBytes = 1ULL << 40;             // Reserved lazily; raw allocations never come back
+    std::vector<size_t> sizes = makeSizes(count);
+
+    printf("VRAM allocation on SimBackend (%u allocations, %u live, %u ns per selector call)\n\n",
+           count, kLive, config.callOverheadNs);
+
+    // Raw: one selector call per allocation, nothing is reused
+    {
+        Client client(makeSimBackend(config));
+        client.connect();
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < count; i++) {
+            if (!client.allocVram(sizes[i])) {
+                fprintf(stderr, "raw allocation %u failed\n", i);
+                return 1;
+            }
+        }
+        double us = elapsedUs(start);
+        SimCounters c = static_cast<SimBackend *>(client.getBackend())->counters();
+        printf("  %-18s %8.3f us/alloc  %8llu calls  %8.1f MiB VRAM\n", "raw allocVram",
+               us / count, (unsigned long long)c.calls, c.vramUsed / 1048576.0);
+    }
+
+    // Cached: slabs reserved on demand, blocks recycled
+    {
+        Client client(makeSimBackend(config));
+        client.connect();
+        BufferAllocator allocator(client);
+        std::deque<Buffer> live;
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < count; i++) {
+            live.push_back(allocator.allocate(sizes[i]));
+            if (!live.back()) {
+                fprintf(stderr, "cached allocation %u failed\n", i);
+                return 1;
+            }
+            if (live.size() > kLive) live.pop_front();
+        }
+        double us = elapsedUs(start);
+        live.clear();
+
+        SimCounters c = static_cast<SimBackend *>(client.getBackend())->counters();
+        BufferAllocatorStats s = allocator.stats();
+        printf("  %-18s %8.3f us/alloc  %8llu calls  %8.1f MiB VRAM\n", "BufferAllocator",
+               us / count, (unsigned long long)c.calls, c.vramUsed / 1048576.0);
+        printf("\n  cache hits %.1f%%, %llu slabs, %llu splits, %llu merges, peak %.1f MiB live\n",
+               100.0 * s.cacheHits / s.allocations, (unsigned long long)s.slabs,
+               (unsigned long long)s.splits, (unsigned long long)s.merges,
+               s.peakAllocatedBytes / 1048576.0);
+    }
+    return 0;
+}
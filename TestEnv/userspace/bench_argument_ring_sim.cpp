@@ -0,0 +1,111 @@
+/*
+ * bench_argument_ring_sim.cpp - Kernel launches through the argument ring
+ *
+ * Launches a four-parameter kernel of a synthetic cubin (Tests/nvdaal_cubin.h)
+ * on one Stream of the simulator, two ways:
+ *
+ *   per launch   a Buffer from the BufferAllocator for bank 0 and the QMD,
+ *                a CommandBuffer recording the dispatch, end() and submit
+ *   ring         ArgumentRing::launch(): bank 0, QMD and dispatch bump-
+ *                allocated from the stream's ring, then submitted
+ *
+ * Both use the same QmdTemplate, so the difference is the allocation and
+ * recording the ring removes. Host time per launch and driver calls per
+ * launch are reported; the simulator completes submissions at once, so
+ * this measures the CPU side only. No GPU needed.
+ *
+ * Usage: ./bench_argument_ring_sim [launches] [ring_kb]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <vector>
+#include "nvdaal_cubin.h"
+#include "NVDAALArgumentRing.h"
+
+using namespace nvdaal;
+
+static SimBackend *sim(Client& client) {
+    return static_cast<SimBackend *>(client.getBackend());
+}
+
+static double elapsedUs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv) {
+    uint32_t launches = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 0) : 100000;
+    size_t ringBytes = (argc > 2 ? strtoul(argv[2], nullptr, 0) : 1024) << 10;
+
+    Client client(makeSimBackend());
+    client.connect();
+    BufferAllocator allocator(client);
+    std::vector<cubin::TestKernel> kernels(1);
+    kernels[0].name = "_Z5saxpyfPKfPfi";
+    kernels[0].registers = 24;
+    kernels[0].paramSizes = { 4, 8, 8, 4 };
+    std::vector<uint8_t> image = cubin::buildCubin(kernels);
+    Module module;
+    QmdTemplate qmd;
+    if (!module.parse(image.data(), image.size()) || !module.upload(allocator) ||
+        !qmd.init(module, module.kernels()[0], 256)) {
+        fprintf(stderr, "Could not load the test module\n");
+        return 1;
+    }
+
+    float a = 2.0f;
+    uint64_t x = 0x200000000ULL, y = 0x200100000ULL;
+    int32_t n = 1 << 20;
+    void *args[] = { &a, &x, &y, &n };
+    uint32_t bank0 = (qmd.paramBankBytes() + 255) & ~255u;
+
+    printf("Kernel launches on SimBackend (%u launches, %zu KB ring)\n\n", launches, ringBytes >> 10);
+    printf("%-16s %10s %12s %14s\n", "  Path", "us/launch", "K launches/s", "driver calls");
+
+    // Per launch: allocate, record, submit
+    {
+        Stream stream(client, allocator);
+        uint64_t calls = sim(client)->counters().calls;
+        uint32_t done = 0;
+        std::vector<CommandBuffer> inFlight;     // Each pins its block until the stream catches up
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < launches; i++) {
+            Buffer block = allocator.allocate(bank0 + kQmdBytes);
+            packConstantBank0(block.cpu(), qmd, i + 1, 1, 1, args);
+            qmd.encode((uint8_t *)block.cpu() + bank0, i + 1, 1, 1, block.gpuAddr());
+            inFlight.emplace_back(allocator, 256);
+            CommandBuffer& cb = inFlight.back();
+            done += cb.use(block) && cb.barrier() && cb.dispatch(block, bank0) && cb.end() && stream.submit(cb);
+            if (inFlight.size() == 64) {
+                stream.synchronize();
+                inFlight.clear();
+            }
+        }
+        stream.synchronize();
+        inFlight.clear();
+        double us = elapsedUs(start);
+        printf("  %-14s %10.2f %12.1f %14.2f%s\n", "per launch", us / launches, launches / us * 1000.0,
+               (double)(sim(client)->counters().calls - calls) / launches, done == launches ? "" : "  (failed)");
+    }
+
+    // Through the ring
+    {
+        Stream stream(client, allocator);
+        ArgumentRing ring(stream, allocator, ringBytes);
+        uint64_t calls = sim(client)->counters().calls;
+        uint32_t done = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < launches; i++) done += ring.launch(qmd, i + 1, 1, 1, args);
+        stream.synchronize();
+        double us = elapsedUs(start);
+        ArgumentRingStats s = ring.stats();
+        printf("  %-14s %10.2f %12.1f %14.2f%s\n", "ring", us / launches, launches / us * 1000.0,
+               (double)(sim(client)->counters().calls - calls) / launches, done == launches ? "" : "  (failed)");
+        printf("\n  ring: %llu wraps, %llu timeline reads, %llu stalls\n", (unsigned long long)s.wraps,
+               (unsigned long long)s.timelineReads, (unsigned long long)s.stalls);
+    }
+    return 0;
+}
@@ -0,0 +1,212 @@
+/*
+ * bench_command_ring.cpp - Command ring vs per-call benchmark
+ *
+ * Models the three ways libNVDAAL can reach the kext for small operations:
+ *   per-call  one blocking round trip per op (IOConnectCallScalarMethod)
+ *   ring      ops queued in shared memory (NVDAALUserShared.h), one
+ *             round trip ("RingKick") drains the whole batch
+ *   batch     requests copied in and completions copied out by one
+ *             struct call ("ExecuteBatch"), no shared mapping
+ * A server thread stands in for NVDAALUserClient and a pipe pair stands
+ * in for the Mach message round trip, so the numbers show the syscall
+ * amortisation rather than absolute macOS figures.
+ *
+ * Usage: ./bench_command_ring [ops]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <chrono>
+#include <thread>
+#include <unistd.h>
+#include "NVDAALUserShared.h"
+
+static int toServer[2];
+static int toClient[2];
+
+enum : uint8_t { kMsgCall = 1, kMsgKick = 2, kMsgQuit = 3, kMsgBatch = 4 };
+
+// Cheap stand-in for a driver op (e.g. READ_SEMAPHORE)
+static void executeOp(const NvdaalOpRequest *req, NvdaalOpCompletion *cpl) {
+    cpl->cookie = req->cookie;
+    cpl->op = req->op;
+    cpl->status = 0;
+    cpl->result[0] = req->args[0] + 1;
+    cpl->result[1] = 0;
+}
+
+static bool readFull(int fd, void *buf, size_t len) {
+    uint8_t *p = (uint8_t *)buf;
+    while (len) {
+        ssize_t n = read(fd, p, len);
+        if (n <= 0) return false;
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+// ============================================================================
+// "Kernel"
+// ============================================================================
+
+static void server(NvdaalRingControl *ring) {
+    uint32_t reqTail = 0;
+    uint32_t cplHead = 0;
+    NvdaalOpRequest *reqs = nvRingRequests(ring);
+    NvdaalOpCompletion *cpls = nvRingCompletions(ring);
+
+    for (;;) {
+        uint8_t msg;
+        if (!readFull(toServer[0], &msg, 1) || msg == kMsgQuit) return;
+
+        if (msg == kMsgCall) {
+            NvdaalOpRequest req;
+            NvdaalOpCompletion cpl;
+            readFull(toServer[0], &req, sizeof(req));
+            executeOp(&req, &cpl);
+            (void)!write(toClient[1], &cpl, sizeof(cpl));
+            continue;
+        }
+
+        // Struct-in/struct-out call, like methodExecuteBatch
+        if (msg == kMsgBatch) {
+            static NvdaalOpRequest reqBuf[NVDAAL_MAX_BATCH_OPS];
+            static NvdaalOpCompletion cplBuf[NVDAAL_MAX_BATCH_OPS];
+            NvdaalBatchHeader hdr;
+            readFull(toServer[0], &hdr, sizeof(hdr));
+            readFull(toServer[0], reqBuf, hdr.count * sizeof(NvdaalOpRequest));
+            for (uint32_t i = 0; i < hdr.count; i++) executeOp(&reqBuf[i], &cplBuf[i]);
+            (void)!write(toClient[1], cplBuf, NVDAAL_BATCH_OUTPUT_SIZE(hdr.count));
+            continue;
+        }
+
+        // Same loop shape as NVDAALCommandRing::drain()
+        uint32_t done = 0;
+        for (;;) {
+            uint32_t head = __atomic_load_n(&ring->reqHead, __ATOMIC_ACQUIRE);
+            if (head == reqTail) break;
+            uint32_t cplTail = __atomic_load_n(&ring->cplTail, __ATOMIC_ACQUIRE);
+            if (cplHead - cplTail >= NVDAAL_RING_COMPLETION_SLOTS) break;
+
+            NvdaalOpRequest req = reqs[reqTail & (NVDAAL_RING_REQUEST_SLOTS - 1)];
+            __atomic_store_n(&ring->reqTail, ++reqTail, __ATOMIC_RELEASE);
+            executeOp(&req, &cpls[cplHead & (NVDAAL_RING_COMPLETION_SLOTS - 1)]);
+            __atomic_store_n(&ring->cplHead, ++cplHead, __ATOMIC_RELEASE);
+            done++;
+        }
+        (void)!write(toClient[1], &done, sizeof(done));
+    }
+}
+
+// ============================================================================
+// Client paths
+// ============================================================================
+
+static double benchPerCall(uint32_t ops) {
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < ops; i++) {
+        uint8_t buf[1 + sizeof(NvdaalOpRequest)];
+        NvdaalOpRequest req = { NVDAAL_OP_READ_SEMAPHORE, 0, i, { i, 0, 0, 0 } };
+        NvdaalOpCompletion cpl;
+        buf[0] = kMsgCall;
+        __builtin_memcpy(buf + 1, &req, sizeof(req));
+        (void)!write(toServer[1], buf, sizeof(buf));
+        readFull(toClient[0], &cpl, sizeof(cpl));
+        if (cpl.result[0] != (uint64_t)i + 1) abort();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return ops / std::chrono::duration<double>(end - start).count();
+}
+
+static double benchRing(NvdaalRingControl *ring, uint32_t ops, uint32_t batch) {
+    uint64_t next = 0;
+    uint64_t expect = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    while (expect < ops) {
+        uint32_t queued = 0;
+        while (queued < batch && next < ops) {
+            NvdaalOpRequest req = { NVDAAL_OP_READ_SEMAPHORE, 0, next, { next, 0, 0, 0 } };
+            if (!nvRingPushRequest(ring, &req)) break;
+            next++;
+            queued++;
+        }
+
+        uint8_t msg = kMsgKick;
+        uint32_t done;
+        (void)!write(toServer[1], &msg, 1);
+        readFull(toClient[0], &done, sizeof(done));
+
+        NvdaalOpCompletion cpl;
+        while (nvRingPopCompletion(ring, &cpl)) {
+            if (cpl.cookie != expect || cpl.result[0] != expect + 1) abort();
+            expect++;
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    return ops / std::chrono::duration<double>(end - start).count();
+}
+
+static double benchBatch(uint32_t ops, uint32_t batch) {
+    static uint8_t buf[1 + NVDAAL_BATCH_INPUT_SIZE(NVDAAL_MAX_BATCH_OPS)];
+    static NvdaalOpCompletion cpls[NVDAAL_MAX_BATCH_OPS];
+    uint64_t next = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    while (next < ops) {
+        uint32_t count = ops - next < batch ? (uint32_t)(ops - next) : batch;
+        NvdaalBatchHeader hdr = { count, 0, 0 };
+        NvdaalOpRequest *reqs = (NvdaalOpRequest *)(buf + 1 + sizeof(hdr));
+        buf[0] = kMsgBatch;
+        __builtin_memcpy(buf + 1, &hdr, sizeof(hdr));
+        for (uint32_t i = 0; i < count; i++) {
+            reqs[i] = { NVDAAL_OP_READ_SEMAPHORE, 0, next + i, { next + i, 0, 0, 0 } };
+        }
+        (void)!write(toServer[1], buf, 1 + NVDAAL_BATCH_INPUT_SIZE(count));
+        readFull(toClient[0], cpls, NVDAAL_BATCH_OUTPUT_SIZE(count));
+        for (uint32_t i = 0; i < count; i++) {
+            if (cpls[i].cookie != next + i || cpls[i].result[0] != next + i + 1) abort();
+        }
+        next += count;
+    }
+    auto end = std::chrono::steady_clock::now();
+    return ops / std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char **argv) {
+    uint32_t ops = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 0) : 200000;
+
+    NvdaalRingControl *ring = (NvdaalRingControl *)aligned_alloc(0x1000, NVDAAL_RING_SIZE);
+    if (!ring || pipe(toServer) || pipe(toClient)) {
+        perror("setup");
+        return 1;
+    }
+    nvRingInit(ring);
+    std::thread kernel(server, ring);
+
+    printf("NVDAAL Command Ring Benchmark (%u small ops per run)\n\n", ops);
+    double base = benchPerCall(ops);
+    printf("  %-22s %12.0f ops/s\n", "per-call round trip", base);
+
+    static const uint32_t kBatches[] = { 1, 8, 32, 128, 512, NVDAAL_RING_REQUEST_SLOTS };
+    for (uint32_t batch : kBatches) {
+        char name[32];
+        snprintf(name, sizeof(name), "ring, %u per kick", batch);
+        double r = benchRing(ring, ops, batch);
+        printf("  %-22s %12.0f ops/s  (%.1fx)\n", name, r, r / base);
+    }
+    for (uint32_t batch : kBatches) {
+        char name[32];
+        snprintf(name, sizeof(name), "batch call, %u ops", batch);
+        double r = benchBatch(ops, batch);
+        printf("  %-22s %12.0f ops/s  (%.1fx)\n", name, r, r / base);
+    }
+
+    uint8_t quit = kMsgQuit;
+    (void)!write(toServer[1], &quit, 1);
+    kernel.join();
+    free(ring);
+    return 0;
+}
@@ -0,0 +1,132 @@
+/*
+ * bench_context_sim.cpp - Launch rate from 1 to 64 threads
+ *
+ * Every thread launches a four-parameter kernel of a synthetic cubin
+ * (Tests/nvdaal_cubin.h) through its own ArgumentRing and Stream, three
+ * ways:
+ *
+ *   global lock       one Context, each launch under a process-wide mutex,
+ *                     as servers had to wrap a Client before it was
+ *                     thread-safe
+ *   thread contexts   one Context, Context::launch() on each thread's
+ *                     ThreadContext: no library lock on the way
+ *   context/thread    a Context (and simulated device) per thread
+ *
+ * The simulator serialises calls into one device as the kext does, so
+ * the two shared-Context rows measure the host side up to that point;
+ * the last row shows the scaling with nothing shared. Launches are
+ * completed at once. No GPU needed.
+ *
+ * Usage: ./bench_context_sim [launches_per_thread] [max_threads]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "nvdaal_cubin.h"
+#include "NVDAALContext.h"
+
+using namespace nvdaal;
+
+static const uint32_t kWarmup = 512;           // ~2x round a 256 KiB ring
+static std::mutex gLock;
+
+struct Loaded {
+    Context context;
+    std::shared_ptr<const Module> module;
+    const QmdTemplate *qmd = nullptr;
+
+    explicit Loaded(const std::vector<uint8_t>& image) : context(makeSimBackend(simConfig()), contextConfig()) {
+        module = context.modules().load(image.data(), image.size());
+        if (module) qmd = context.qmds().get(*module, module->kernels()[0], 256);
+    }
+
+    static SimConfig simConfig() {
+        SimConfig config;
+        config.vramBytes = 128ULL << 20;
+        return config;
+    }
+
+    static ContextConfig contextConfig() {
+        ContextConfig config;
+        config.argumentRingBytes = 256 << 10;
+        return config;
+    }
+};
+
+static uint32_t launchMany(Context& context, const QmdTemplate& qmd, uint32_t launches, bool locked) {
+    float a = 2.0f;
+    uint64_t x = 0x200000000ULL, y = 0x200100000ULL;
+    int32_t n = 1 << 20;
+    void *args[] = { &a, &x, &y, &n };
+    uint32_t done = 0;
+    for (uint32_t i = 0; i < launches; i++) {
+        if (locked) {
+            std::lock_guard<std::mutex> guard(gLock);
+            done += context.launch(qmd, i + 1, 1, 1, args);
+        } else {
+            done += context.launch(qmd, i + 1, 1, 1, args);
+        }
+    }
+    return done + (context.synchronize(5000) ? 0 : launches);      // A failed sync spoils the count
+}
+
+// M launches/s over all threads. Each thread has made its state and been
+// once round its ring (faulting the pages in) before the clock starts.
+static double run(uint32_t threads, uint32_t launches, const std::vector<uint8_t>& image, int mode, bool *ok) {
+    std::unique_ptr<Loaded> shared;
+    std::vector<std::unique_ptr<Loaded>> own(threads);
+    if (mode < 2) shared.reset(new Loaded(image));
+    else for (uint32_t t = 0; t < threads; t++) own[t].reset(new Loaded(image));
+
+    std::vector<uint32_t> done(threads, 0);
+    std::vector<std::thread> pool;
+    std::atomic<uint32_t> ready(0);
+    std::atomic<bool> go(false);
+    for (uint32_t t = 0; t < threads; t++) {
+        pool.emplace_back([&, t] {
+            Loaded& l = mode < 2 ? *shared : *own[t];
+            bool usable = l.qmd && l.context.current() && launchMany(l.context, *l.qmd, kWarmup, false) == kWarmup;
+            ready++;
+            while (!go.load()) std::this_thread::yield();
+            if (usable) done[t] = launchMany(l.context, *l.qmd, launches, mode == 0);
+        });
+    }
+    while (ready.load() < threads) std::this_thread::yield();
+    auto start = std::chrono::steady_clock::now();
+    go.store(true);
+    for (std::thread& t : pool) t.join();
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    for (uint32_t t = 0; t < threads; t++) *ok = *ok && done[t] == launches;
+    return (double)threads * launches / us;
+}
+
+int main(int argc, char **argv) {
+    uint32_t launches = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 0) : 5000;
+    uint32_t maxThreads = argc > 2 ? (uint32_t)strtoul(argv[2], nullptr, 0) : 64;
+
+    std::vector<cubin::TestKernel> kernels(1);
+    kernels[0].name = "_Z5saxpyfPKfPfi";
+    kernels[0].registers = 24;
+    kernels[0].paramSizes = { 4, 8, 8, 4 };
+    std::vector<uint8_t> image = cubin::buildCubin(kernels);
+
+    printf("Kernel launches on SimBackend (%u per thread, %u hardware threads)\n\n", launches,
+           std::thread::hardware_concurrency());
+    printf("%-9s %16s %16s %16s\n", "  Threads", "global lock", "thread contexts", "context/thread");
+    printf("%-9s %16s %16s %16s\n", "", "M launches/s", "M launches/s", "M launches/s");
+    for (uint32_t threads = 1; threads <= maxThreads; threads *= 2) {
+        bool ok = true;
+        double rate[3];
+        for (int mode = 0; mode < 3; mode++) rate[mode] = run(threads, launches, image, mode, &ok);
+        printf("  %-7u %16.3f %16.3f %16.3f%s\n", threads, rate[0], rate[1], rate[2], ok ? "" : "  (failed)");
+    }
+    return 0;
+}
@@ -0,0 +1,141 @@
+/*
+ * bench_graph_sim.cpp - Re-recording each step vs replaying a captured graph
+ *
+ * A step is a few command buffers (forward, backward, optimizer, copies)
+ * with dependencies between them, plus per-step changes: the input batch
+ * pointer and a step counter. The baseline re-records every buffer and
+ * submits each one; the graph path patches two parameters and launches
+ * once. Reports host CPU time per step on the simulator backend.
+ * No GPU needed.
+ *
+ * Usage: ./bench_graph_sim [steps] [launches_per_node] [call_overhead_ns]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <chrono>
+#include <vector>
+#include "NVDAALGraph.h"
+
+using namespace nvdaal;
+
+static const uint32_t kNodes = 4;
+
+static double elapsedUs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Node 0 copies the batch in; every node then runs `launches` kernels
+static void record(CommandBuffer& cb, uint32_t node, const Buffer& qmds, const Buffer& batch,
+                   const Buffer& input, uint32_t launches) {
+    cb.begin();
+    if (node == 0) cb.copy(input, 0, batch, 0, input.size());
+    for (uint32_t i = 0; i < launches; i++) {
+        cb.dispatch(qmds, (i % 64) * 256);
+        if (i % 8 == 7) cb.barrier();
+    }
+}
+
+int main(int argc, char **argv) {
+    uint32_t steps = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 0) : 20000;
+    uint32_t launches = argc > 2 ? (uint32_t)strtoul(argv[2], nullptr, 0) : 64;
+    SimConfig config;
+    config.callOverheadNs = argc > 3 ? (uint32_t)strtoul(argv[3], nullptr, 0) : 2000;
+
+    Client client(makeSimBackend(config));
+    client.connect();
+    BufferAllocator allocator(client);
+    Buffer qmds = allocator.allocate(64 * 256);
+    Buffer batches[2] = { allocator.allocate(4096), allocator.allocate(4096) };
+    Buffer input = allocator.allocate(4096);
+    Semaphore timeline;
+    if (!client.createSemaphore(&timeline)) {
+        fprintf(stderr, "createSemaphore failed\n");
+        return 1;
+    }
+
+    printf("Command graphs on SimBackend (%u steps, %u nodes x %u launches, %u ns per selector call)\n\n",
+           steps, kNodes, launches, config.callOverheadNs);
+
+    // Re-record and submit every node, every step
+    {
+        std::vector<CommandBuffer> cbs;
+        for (uint32_t n = 0; n < kNodes; n++) cbs.emplace_back(allocator);
+        uint64_t value = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t s = 0; s < steps; s++) {
+            for (uint32_t n = 0; n < kNodes; n++) {
+                record(cbs[n], n, qmds, batches[s % 2], input, launches);
+                if (n == kNodes - 1) cbs[n].signal(timeline, ++value);
+                cbs[n].end();
+                client.submit(cbs[n]);
+            }
+            client.waitSemaphore(timeline, value);
+        }
+        double us = elapsedUs(start);
+        printf("  %-22s %8.3f us/step  %u submissions/step\n", "re-record + submit", us / steps, kNodes);
+    }
+
+    // Capture once; patch the batch pointer and the step payload, launch once
+    {
+        Graph graph(allocator);
+        CommandBuffer cb(allocator);
+        uint32_t prev = Graph::kInvalid;
+        uint32_t batchParam = Graph::kInvalid;
+        uint32_t stepParam = Graph::kInvalid;
+        Semaphore progress;
+        client.createSemaphore(&progress);
+        for (uint32_t n = 0; n < kNodes; n++) {
+            PatchPoint src, step;
+            cb.begin();
+            if (n == 0) {
+                cb.copy(input, 0, batches[0], 0, input.size());
+                src = cb.field(Field::CopySrc);
+                cb.use(batches[1]);                      // Patched in on odd steps
+            }
+            for (uint32_t i = 0; i < launches; i++) {
+                cb.dispatch(qmds, (i % 64) * 256);
+                if (i % 8 == 7) cb.barrier();
+            }
+            if (n == kNodes - 1) {
+                cb.signal(progress, 0);
+                step = cb.field(Field::SemaphoreValue);
+            }
+
+            uint32_t node = prev == Graph::kInvalid ? graph.addNode(cb) : graph.addNode(cb, { prev });
+            if (n == 0) batchParam = graph.addParam(node, src);
+            if (n == kNodes - 1) stepParam = graph.addParam(node, step);
+            prev = node;
+        }
+        if (!graph.instantiate(client) || batchParam == Graph::kInvalid || stepParam == Graph::kInvalid) {
+            fprintf(stderr, "graph capture failed\n");
+            return 1;
+        }
+
+        double launchUs = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t s = 0; s < steps; s++) {
+            auto l = std::chrono::steady_clock::now();
+            graph.setParam(batchParam, batches[s % 2].gpuAddr());
+            graph.setParam(stepParam, s + 1);
+            uint64_t value = graph.launch();
+            launchUs += elapsedUs(l);
+            graph.wait(value);
+        }
+        double us = elapsedUs(start);
+        GraphStats gs = graph.stats();
+        printf("  %-22s %8.3f us/step  1 submission/step (patch + launch %.3f us)\n", "graph replay",
+               us / steps, launchUs / steps);
+        printf("\n  graph: %u nodes, %u barriers, %u-byte image, %.1f dwords patched/launch, %llu stalls\n",
+               gs.nodes, gs.barriers, gs.sizeBytes, (double)gs.patchedDwords / gs.launches,
+               (unsigned long long)gs.stalls);
+        uint64_t final = 0;
+        client.readSemaphore(progress, &final);
+        if (final != steps) {
+            fprintf(stderr, "progress semaphore at %llu, expected %u\n", (unsigned long long)final, steps);
+            return 1;
+        }
+    }
+    return 0;
+}
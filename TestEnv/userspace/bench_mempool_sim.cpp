@@ -0,0 +1,123 @@
+/*
+ * bench_mempool_sim.cpp - Scratch allocation with and without stream ordering
+ *
+ * Every step allocates a scratch buffer, records a copy into it, submits
+ * the copy on one of two streams and frees the scratch. Without a
+ * stream-ordered free the host must either wait for the stream before
+ * freeing (the streams can no longer overlap) or keep every scratch until
+ * the end (memory grows with the step count). MemoryPool frees in stream
+ * order: no waits, and the footprint stays at what is in flight. With
+ * reuseWithWait it holds one block and orders the streams on each other.
+ * No GPU needed.
+ *
+ * Usage: ./bench_mempool_sim [steps] [stage_us] [scratch_kb]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include "NVDAALMemoryPool.h"
+
+using namespace nvdaal;
+
+enum class Mode { SyncFree, KeepAll, Pool, PoolWait };
+
+struct Result {
+    double ms;
+    double hostUs;                               // Allocate + free per step
+    uint64_t peakBytes;
+};
+
+static double elapsedUs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+static Result run(Mode mode, uint32_t steps, size_t bytes, const SimConfig& config, MemoryPoolStats *poolStats) {
+    Client client(makeSimBackend(config));
+    client.connect();
+    BufferAllocator allocator(client);
+    Buffer src = allocator.allocate(bytes);
+    memset(src.cpu(), 0x3C, bytes);
+
+    Result r = {};
+    {
+        MemoryPoolConfig poolConfig;
+        poolConfig.reuseWithWait = mode == Mode::PoolWait;
+        MemoryPool pool(allocator, poolConfig);
+        Stream streams[2] = { Stream(client, allocator, 0), Stream(client, allocator, 1) };
+        std::vector<std::unique_ptr<CommandBuffer>> copies;
+        std::vector<Buffer> kept;
+        allocator.resetPeak();
+
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < steps; i++) {
+            Stream& stream = streams[i % 2];
+            auto h = std::chrono::steady_clock::now();
+            bool pooled = mode == Mode::Pool || mode == Mode::PoolWait;
+            Buffer scratch = pooled ? pool.allocate(bytes, stream) : allocator.allocate(bytes);
+            r.hostUs += elapsedUs(h);
+
+            copies.emplace_back(new CommandBuffer(allocator));
+            CommandBuffer& cb = *copies.back();
+            cb.copy(scratch, 0, src, 0, bytes);
+            cb.end();
+            stream.submit(cb);
+
+            h = std::chrono::steady_clock::now();
+            if (mode == Mode::SyncFree) {
+                stream.synchronize(60000);
+                copies.back().reset();           // Unpins the scratch
+                scratch.reset();
+            } else if (mode == Mode::KeepAll) {
+                kept.push_back(std::move(scratch));
+            } else {
+                pool.free(std::move(scratch), stream);
+            }
+            r.hostUs += elapsedUs(h);
+        }
+        streams[0].synchronize(60000);
+        streams[1].synchronize(60000);
+        r.ms = elapsedUs(start) / 1000.0;
+        r.hostUs /= steps;
+        r.peakBytes = allocator.stats().peakAllocatedBytes;
+        if (poolStats) *poolStats = pool.stats();
+    }
+    return r;
+}
+
+int main(int argc, char **argv) {
+    uint32_t steps = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 0) : 256;
+    SimConfig config;
+    config.submitLatencyUs = argc > 2 ? (uint32_t)strtoul(argv[2], nullptr, 0) : 200;
+    size_t bytes = (argc > 3 ? strtoul(argv[3], nullptr, 0) : 16) << 10;
+    config.vramBytes = (uint64_t)bytes * steps + (256ULL << 20);
+
+    printf("Scratch per step on SimBackend (%u steps over 2 streams, %zu KB, %u us per copy)\n\n",
+           steps, bytes >> 10, config.submitLatencyUs);
+    printf("  %-26s %10s %16s %12s\n", "free", "wall", "alloc+free host", "peak VRAM");
+
+    static const struct { Mode mode; const char *name; } kModes[] = {
+        { Mode::SyncFree, "synchronize, then free" },
+        { Mode::KeepAll, "keep until the end" },
+        { Mode::Pool, "MemoryPool" },
+        { Mode::PoolWait, "MemoryPool, reuseWithWait" },
+    };
+    MemoryPoolStats pools[2] = {};
+    for (const auto& m : kModes) {
+        MemoryPoolStats *s = m.mode == Mode::Pool ? &pools[0] : m.mode == Mode::PoolWait ? &pools[1] : nullptr;
+        Result r = run(m.mode, steps, bytes, config, s);
+        printf("  %-26s %7.2f ms %13.2f us %9.2f MB\n", m.name, r.ms, r.hostUs, r.peakBytes / 1048576.0);
+    }
+
+    printf("\n");
+    for (const MemoryPoolStats& s : pools) {
+        printf("  pool: %llu from the allocator, %llu same-stream, %llu completed, %llu behind a wait\n",
+               (unsigned long long)s.allocatorCalls, (unsigned long long)s.reusedSameStream,
+               (unsigned long long)s.reusedCompleted, (unsigned long long)s.reusedWithWait);
+    }
+    return 0;
+}
@@ -0,0 +1,110 @@
+/*
+ * bench_module_sim.cpp - Module parsing, kernel lookup and cache hits
+ *
+ * Builds synthetic cubins (Tests/nvdaal_cubin.h) of 10 to `max_kernels`
+ * kernels, as large models ship them, and times Module::parse(), lookups
+ * of every kernel by name, ModuleLoader::load() on a miss (parse plus
+ * upload to the simulator) and on a hit (hash plus lookup). Any cubin or
+ * fatbin files given are parsed and timed the same way, so real nvcc
+ * output can be measured where a CUDA toolkit is at hand. No GPU needed.
+ *
+ * Usage: ./bench_module_sim [max_kernels] [file.cubin|file.fatbin ...]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "nvdaal_cubin.h"
+#include "NVDAALModule.h"
+
+using namespace nvdaal;
+
+static double elapsedUs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+static std::vector<uint8_t> synthetic(uint32_t count) {
+    std::vector<cubin::TestKernel> kernels(count);
+    for (uint32_t k = 0; k < count; k++) {
+        char name[64];
+        snprintf(name, sizeof(name), "_Z%ugemm_kernel_variant_%uPKfS0_Pfiii", 24 + k % 10, k);
+        kernels[k].name = name;
+        kernels[k].codeBytes = 512 + (k % 8) * 256;
+        kernels[k].registers = 32 + k % 64;
+        kernels[k].sharedBytes = (k % 4) * 8192;
+        kernels[k].paramSizes = { 8, 8, 8, 4, 4, 4 };
+    }
+    return cubin::buildCubin(kernels);
+}
+
+static void measure(const char *label, const std::vector<uint8_t>& image) {
+    Module module;
+    if (!module.parse(image.data(), image.size())) {
+        printf("  %-22s parse failed\n", label);
+        return;
+    }
+    uint32_t reps = (uint32_t)(64 * 1024 * 1024 / image.size()) + 1;
+    if (reps > 200) reps = 200;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < reps; r++) module.parse(image.data(), image.size());
+    double parseUs = elapsedUs(start) / reps;
+
+    size_t kernels = module.kernels().size();
+    std::vector<std::string> names;
+    for (const Kernel& k : module.kernels()) names.push_back(k.name);
+    uint64_t found = 0;
+    uint32_t rounds = (uint32_t)(2000000 / kernels) + 1;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < rounds; r++) {
+        for (const std::string& n : names) found += module.kernel(n.c_str()) != nullptr;
+    }
+    double lookupNs = elapsedUs(start) * 1000.0 / ((double)rounds * kernels);
+
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    ModuleLoader loader(allocator);
+    start = std::chrono::steady_clock::now();
+    bool loaded = loader.load(image.data(), image.size()) != nullptr;
+    double missUs = elapsedUs(start);
+    start = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < reps; r++) loaded &= loader.load(image.data(), image.size()) != nullptr;
+    double hitUs = elapsedUs(start) / reps;
+
+    printf("  %-22s %7zu %9.1f %9.0f %10.1f %10.1f %9.1f %9.1f%s\n", label, kernels, image.size() / 1024.0,
+           parseUs, parseUs * 1000.0 / kernels, lookupNs, missUs, hitUs, loaded && found ? "" : "  (failed)");
+}
+
+int main(int argc, char **argv) {
+    uint32_t maxKernels = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 0) : 5000;
+    if (maxKernels < 10) maxKernels = 10;
+
+    printf("%-24s %7s %9s %9s %10s %10s %9s %9s\n", "  Module", "kernels", "KB", "parse us",
+           "ns/kernel", "lookup ns", "miss us", "hit us");
+    for (uint32_t count = 10; count <= maxKernels; count *= 10) {
+        char label[32];
+        snprintf(label, sizeof(label), "synthetic x%u", count);
+        measure(label, synthetic(count));
+        if (count * 10 > maxKernels && count != maxKernels) {
+            snprintf(label, sizeof(label), "synthetic x%u", maxKernels);
+            measure(label, synthetic(maxKernels));
+        }
+    }
+
+    for (int i = 2; i < argc; i++) {
+        std::ifstream file(argv[i], std::ios::binary);
+        if (!file) {
+            fprintf(stderr, "Can't open %s\n", argv[i]);
+            continue;
+        }
+        std::vector<uint8_t> image((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        const char *base = strrchr(argv[i], '/');
+        measure(base ? base + 1 : argv[i], image);
+    }
+    return 0;
+}
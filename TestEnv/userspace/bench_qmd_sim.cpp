@@ -0,0 +1,159 @@
+/*
+ * bench_qmd_sim.cpp - QMD encoding rate
+ *
+ * Times how many compute launch descriptors per second each way of
+ * building them gets through, for a kernel of a synthetic cubin
+ * (Tests/nvdaal_cubin.h) uploaded to the simulator:
+ *
+ *   full init         QmdTemplate::init() plus encode() for every launch
+ *   table-driven      every field set through qmd::kFields at run time,
+ *                     as a QMD builder without compile-time layout would
+ *   template          encode() from one prefilled template
+ *   cache + template  QmdCache::get() then encode(), as a launch path
+ *                     that doesn't keep its own templates would
+ *
+ * Descriptors go round a ring of 64 slots in host memory. No GPU needed.
+ *
+ * Usage: ./bench_qmd_sim [launches]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <vector>
+#include "nvdaal_cubin.h"
+#include "NVDAALQmd.h"
+
+using namespace nvdaal;
+
+static const uint32_t kSlots = 64;
+
+struct Ring {
+    alignas(256) uint32_t qmd[kSlots][kQmdDwords];
+};
+
+static double elapsedNs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void report(const char *label, uint32_t launches, double ns, uint64_t check) {
+    printf("  %-18s %10.1f %12.2f%s\n", label, ns / launches, launches / ns * 1000.0,
+           check ? "" : "  (failed)");
+}
+
+static const qmd::FieldInfo& field(const char *name) {
+    for (const qmd::FieldInfo& f : qmd::kFields) {
+        if (strcmp(f.name, name) == 0) return f;
+    }
+    abort();
+}
+
+static void setField(uint32_t *q, const qmd::FieldInfo& f, uint32_t bank, uint32_t value) {
+    uint32_t lo = f.lo + bank * f.stride;
+    uint32_t width = f.hi - f.lo + 1;
+    uint32_t mask = (width == 32 ? 0xFFFFFFFFu : (1u << width) - 1) << (lo % 32);
+    q[lo / 32] = (q[lo / 32] & ~mask) | ((value << (lo % 32)) & mask);
+}
+
+int main(int argc, char **argv) {
+    uint32_t launches = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 0) : 2000000;
+    if (launches < kSlots) launches = kSlots;
+
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    std::vector<cubin::TestKernel> kernels(1);
+    kernels[0].name = "_Z4gemmPKfS0_Pfiii";
+    kernels[0].registers = 96;
+    kernels[0].sharedBytes = 16384;
+    kernels[0].paramSizes = { 8, 8, 8, 4, 4, 4 };
+    kernels[0].constant2 = std::vector<uint8_t>(64, 1);
+    std::vector<uint8_t> image = cubin::buildCubin(kernels);
+    Module module;
+    if (!module.parse(image.data(), image.size()) || !module.upload(allocator)) {
+        fprintf(stderr, "Could not load the test module\n");
+        return 1;
+    }
+    const Kernel& kernel = module.kernels()[0];
+    uint64_t params = 0x200000000ULL;
+
+    static Ring ring;
+    uint64_t check = 0;
+    printf("%-20s %10s %12s\n", "  Encoding", "ns/launch", "M launches/s");
+
+    // Full init every launch
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < launches; i++) {
+        QmdTemplate t;
+        t.init(module, kernel, 256);
+        check += t.encode(ring.qmd[i % kSlots], i + 1, 1, 1, params + (uint64_t)(i % kSlots) * 256);
+    }
+    report("full init", launches, elapsedNs(start), check);
+
+    // Every field through the table, positions read at run time
+    const qmd::FieldInfo *f[] = {
+        &field("QmdVersion"), &field("QmdMajorVersion"), &field("ApiVisibleCallLimit"),
+        &field("CwdMembarType"), &field("SmGlobalCachingEnable"), &field("InvalidateShaderConstantCache"),
+        &field("InvalidateShaderDataCache"), &field("ProgramAddressLower"), &field("ProgramAddressUpper"),
+        &field("CtaThreadDimension0"), &field("CtaThreadDimension1"), &field("CtaThreadDimension2"),
+        &field("RegisterCount"), &field("BarrierCount"), &field("SharedMemorySize"),
+        &field("TargetSmConfigSharedMemSize"), &field("ShaderLocalMemoryLowSize"),
+        &field("CtaRasterWidth"), &field("CtaRasterHeight"), &field("CtaRasterDepth"),
+    };
+    const qmd::FieldInfo& valid = field("ConstantBufferValid");
+    const qmd::FieldInfo& lower = field("ConstantBufferAddrLower");
+    const qmd::FieldInfo& upper = field("ConstantBufferAddrUpper");
+    const qmd::FieldInfo& size = field("ConstantBufferSizeShifted4");
+    const ConstantBank *c2 = kernel.bank(2);
+    check = 0;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < launches; i++) {
+        uint32_t *q = ring.qmd[i % kSlots];
+        uint64_t bank0 = params + (uint64_t)(i % kSlots) * 256;
+        uint32_t values[] = { 0, 3, 1, 1, 1, 1, 1, (uint32_t)kernel.codeAddr, (uint32_t)(kernel.codeAddr >> 32),
+                              256, 1, 1, kernel.registers, 1, kernel.sharedBytes, 5, kernel.localBytes,
+                              i + 1, 1, 1 };
+        memset(q, 0, kQmdBytes);
+        for (size_t n = 0; n < sizeof(values) / sizeof(values[0]); n++) setField(q, *f[n], 0, values[n]);
+        setField(q, valid, 0, 1);
+        setField(q, lower, 0, (uint32_t)bank0);
+        setField(q, upper, 0, (uint32_t)(bank0 >> 32));
+        setField(q, size, 0, (kernel.paramBase + kernel.paramBytes + 15) >> 4);
+        setField(q, valid, 2, 1);
+        setField(q, lower, 2, (uint32_t)c2->gpuAddr);
+        setField(q, upper, 2, (uint32_t)(c2->gpuAddr >> 32));
+        setField(q, size, 2, c2->size >> 4);
+        check += q[12];
+    }
+    report("table-driven", launches, elapsedNs(start), check);
+
+    // One template, patched
+    QmdTemplate t;
+    if (!t.init(module, kernel, 256)) return 1;
+    check = 0;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < launches; i++) {
+        check += t.encode(ring.qmd[i % kSlots], i + 1, 1, 1, params + (uint64_t)(i % kSlots) * 256);
+    }
+    report("template", launches, elapsedNs(start), check);
+
+    // Looked up in the cache each launch
+    QmdCache cache;
+    check = 0;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < launches; i++) {
+        const QmdTemplate *cached = cache.get(module, kernel, 256);
+        check += cached && cached->encode(ring.qmd[i % kSlots], i + 1, 1, 1, params + (uint64_t)(i % kSlots) * 256);
+    }
+    report("cache + template", launches, elapsedNs(start), check);
+
+    // Same bytes either way
+    uint32_t a[kQmdDwords], b[kQmdDwords];
+    QmdTemplate fresh;
+    fresh.init(module, kernel, 256);
+    fresh.encode(a, 7, 1, 1, params);
+    t.encode(b, 7, 1, 1, params);
+    if (memcmp(a, b, sizeof(a)) != 0) printf("  template and full init differ\n");
+    return 0;
+}
@@ -0,0 +1,122 @@
+/*
+ * bench_staging_sim.cpp - Host <-> VRAM transfer bandwidth by method
+ *
+ * Uploads and downloads 4 KB up to the maximum size with StagingEngine:
+ * through one pinned chunk (pack, copy, wait: nothing overlaps), through
+ * two (the CPU packs one chunk while the copy engine drains the other),
+ * through BAR1 alone, and with Auto choosing by size. Each copy keeps its
+ * fake channel busy for a fixed latency plus its size at copy_mbps, so the
+ * staged columns show how much of the CPU packing the pipeline hides. BAR1
+ * here is a plain memcpy into host memory: on hardware, reads through it
+ * are uncached and far slower than these numbers. Fake VRAM is host
+ * memory too: pass a larger maximum (up to 4096 MB) only with the RAM for
+ * it. No GPU needed.
+ *
+ * Usage: ./bench_staging_sim [max_mb] [chunk_kb] [copy_mbps]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <vector>
+#include "NVDAALStaging.h"
+
+using namespace nvdaal;
+
+struct Mode {
+    const char *name;
+    uint32_t chunks;
+    TransferMethod method;
+};
+
+static const Mode kModes[] = {
+    { "1 chunk", 1, TransferMethod::CopyEngine },
+    { "2 chunks", 2, TransferMethod::CopyEngine },
+    { "BAR1", 2, TransferMethod::Bar1 },
+    { "Auto", 2, TransferMethod::Auto },
+};
+static const size_t kModeCount = sizeof(kModes) / sizeof(kModes[0]);
+
+static double gbps(size_t bytes, uint32_t reps, double us) {
+    return us > 0 ? (double)bytes * reps / us / 1000.0 : 0.0;
+}
+
+int main(int argc, char **argv) {
+    uint64_t maxBytes = (argc > 1 ? strtoull(argv[1], nullptr, 0) : 256) << 20;
+    size_t chunkBytes = (argc > 2 ? strtoul(argv[2], nullptr, 0) : 4096) << 10;
+    SimConfig config;
+    config.copyMBps = argc > 3 ? (uint32_t)strtoul(argv[3], nullptr, 0) : 24000;     // ~PCIe 4.0 x16
+    config.submitLatencyUs = 10;
+    if (maxBytes < 4096) maxBytes = 4096;
+    if (maxBytes > (4ULL << 30)) maxBytes = 4ULL << 30;
+    config.vramBytes = maxBytes + (64ULL << 20);
+
+    printf("StagingEngine on SimBackend (%zu KB chunks, copies at %u MB/s + %u us)\n\n",
+           chunkBytes >> 10, config.copyMBps, config.submitLatencyUs);
+
+    Client client(makeSimBackend(config));
+    client.connect();
+    BufferAllocator allocator(client);
+    Buffer vram = allocator.allocate(maxBytes);
+    if (!vram) {
+        fprintf(stderr, "Can't allocate %llu MB of fake VRAM\n", (unsigned long long)(maxBytes >> 20));
+        return 1;
+    }
+    std::vector<uint8_t> host(maxBytes), back(maxBytes);
+    for (size_t i = 0; i < host.size(); i += 4096) host[i] = (uint8_t)(i >> 12);
+    memset(vram.cpu(), 0, maxBytes);                     // Commit the fake VRAM pages up front
+
+    StagingEngine *engines[kModeCount];
+    for (size_t m = 0; m < kModeCount; m++) {
+        StagingConfig staging;
+        staging.chunkBytes = chunkBytes;
+        staging.chunks = kModes[m].chunks;
+        engines[m] = new StagingEngine(client, allocator, staging);
+    }
+
+    printf("  %-10s", "size");
+    for (const Mode& mode : kModes) printf(" %9s up %7s", mode.name, "down");
+    printf("   (GB/s)\n");
+
+    for (uint64_t bytes = 4096; bytes <= maxBytes; bytes *= 4) {
+        uint32_t reps = (uint32_t)((64ULL << 20) / bytes);
+        if (reps < 1) reps = 1;
+        if (reps > 2000) reps = 2000;
+
+        if (bytes >= (1ULL << 20)) printf("  %7llu MB", (unsigned long long)(bytes >> 20));
+        else printf("  %7llu KB", (unsigned long long)(bytes >> 10));
+        for (size_t m = 0; m < kModeCount; m++) {
+            StagingEngine& engine = *engines[m];
+            TransferMethod method = kModes[m].method;
+
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t r = 0; r < reps; r++) engine.upload(vram, 0, host.data(), bytes, method);
+            engine.stream().synchronize(60000);
+            double upUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+            start = std::chrono::steady_clock::now();
+            for (uint32_t r = 0; r < reps; r++) engine.download(back.data(), vram, 0, bytes, method);
+            double downUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+            if (memcmp(host.data(), back.data(), bytes)) {
+                fprintf(stderr, "\n%s: round trip of %llu bytes differs\n", kModes[m].name, (unsigned long long)bytes);
+                return 1;
+            }
+            printf(" %12.2f %7.2f", gbps(bytes, reps, upUs), gbps(bytes, reps, downUs));
+        }
+        printf("\n");
+        if (bytes * 4 > maxBytes && bytes != maxBytes) bytes = maxBytes / 4;   // Always end on the maximum
+    }
+
+    printf("\n");
+    for (size_t m = 0; m < kModeCount; m++) {
+        StagingStats s = engines[m]->stats();
+        printf("  %-9s %llu chunk copies, %llu host waits for a chunk, %llu BAR1 transfers\n", kModes[m].name,
+               (unsigned long long)s.chunkCopies, (unsigned long long)s.chunkWaits,
+               (unsigned long long)s.bar1Transfers);
+        delete engines[m];
+    }
+    return 0;
+}
@@ -0,0 +1,127 @@
+/*
+ * bench_wc_copy.cpp - Streaming copy and fill kernels vs memcpy/memset
+ *
+ * Times NVDAALWcCopy.h at every store width this CPU has, and the
+ * threaded nvdaal::streamCopy()/streamFill(), against memcpy and memset,
+ * from 4 KB up to the maximum size. The destination is ordinary memory,
+ * where streaming stores only win once the range outgrows the last-level
+ * cache, and optionally a write-combined mapping of a PCI BAR: on Linux
+ * pass a prefetchable BAR's sysfs resourceN_wc file (as root), e.g. the
+ * GPU's BAR1 at /sys/bus/pci/devices/0000:01:00.0/resource1_wc. Only do
+ * that with no driver bound to the device: the bench overwrites it.
+ *
+ * Usage: ./bench_wc_copy [max_mb] [resourceN_wc]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "NVDAALWcCopy.h"
+#include "NVDAALCopy.h"
+
+using namespace nvdaal;
+
+typedef std::function<void(uint8_t *dst, const uint8_t *src, size_t bytes)> Kernel;
+
+struct Method {
+    std::string name;
+    Kernel run;
+};
+
+static std::vector<Method> methods() {
+    std::vector<Method> list;
+    list.push_back({ "memcpy", [](uint8_t *d, const uint8_t *s, size_t n) { memcpy(d, s, n); } });
+    for (int isa = NV_WC_GPR; isa <= NV_WC_AVX512; isa++) {
+        if (!nvWcIsaSupported((NvWcIsa)isa)) continue;
+        list.push_back({ std::string("copy ") + nvWcIsaName((NvWcIsa)isa),
+                         [isa](uint8_t *d, const uint8_t *s, size_t n) { nvWcCopyIsa((NvWcIsa)isa, d, s, n); } });
+    }
+    list.push_back({ "streamCopy", [](uint8_t *d, const uint8_t *s, size_t n) { streamCopy(d, s, n); } });
+    list.push_back({ "memset", [](uint8_t *d, const uint8_t *, size_t n) { memset(d, 0, n); } });
+    for (int isa = NV_WC_GPR; isa <= NV_WC_AVX512; isa++) {
+        if (!nvWcIsaSupported((NvWcIsa)isa)) continue;
+        list.push_back({ std::string("fill ") + nvWcIsaName((NvWcIsa)isa),
+                         [isa](uint8_t *d, const uint8_t *, size_t n) { nvWcFillIsa((NvWcIsa)isa, d, 0, n); } });
+    }
+    list.push_back({ "streamFill", [](uint8_t *d, const uint8_t *, size_t n) { streamFill(d, 0, n); } });
+    return list;
+}
+
+static void run(const char *title, uint8_t *dst, const uint8_t *src, size_t maxBytes) {
+    std::vector<size_t> sizes;
+    for (size_t bytes = 4096; bytes <= maxBytes; bytes *= 16) sizes.push_back(bytes);
+    if (sizes.back() != maxBytes) sizes.push_back(maxBytes);
+
+    printf("%s (GB/s)\n  %-14s", title, "");
+    for (size_t bytes : sizes) {
+        if (bytes >= (1 << 20)) printf(" %7zu MB", bytes >> 20);
+        else printf(" %7zu KB", bytes >> 10);
+    }
+    printf("\n");
+
+    for (const Method& m : methods()) {
+        printf("  %-14s", m.name.c_str());
+        for (size_t bytes : sizes) {
+            size_t reps = (256 << 20) / bytes;
+            if (reps < 2) reps = 2;
+            m.run(dst, src, bytes);                      // Fault the pages in, warm up
+            auto start = std::chrono::steady_clock::now();
+            for (size_t r = 0; r < reps; r++) m.run(dst, src, bytes);
+            double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+            printf(" %10.2f", (double)bytes * reps / us / 1000.0);
+        }
+        printf("\n");
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv) {
+    size_t maxBytes = (size_t)(argc > 1 ? strtoull(argv[1], nullptr, 0) : 256) << 20;
+    if (maxBytes < 4096) maxBytes = 4096;
+
+    uint8_t *src = (uint8_t *)aligned_alloc(4096, maxBytes);
+    uint8_t *dst = (uint8_t *)aligned_alloc(4096, maxBytes);
+    if (!src || !dst) {
+        fprintf(stderr, "Can't allocate 2 x %zu MB\n", maxBytes >> 20);
+        return 1;
+    }
+    memset(src, 0x5A, maxBytes);
+    memset(dst, 0, maxBytes);
+
+    printf("Best store width: %s\n\n", nvWcIsaName(nvWcBestIsa()));
+    run("Ordinary memory", dst, src, maxBytes);
+
+    if (argc > 2) {
+        int fd = open(argv[2], O_RDWR | O_SYNC);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0) {
+            perror(argv[2]);
+            return 1;
+        }
+        size_t bar = (size_t)st.st_size < maxBytes ? (size_t)st.st_size : maxBytes;
+        void *p = mmap(nullptr, bar, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) {
+            perror("mmap");
+            return 1;
+        }
+        std::string title = std::string("Write-combined ") + argv[2];
+        run(title.c_str(), (uint8_t *)p, src, bar);
+        munmap(p, bar);
+    } else {
+        printf("No write-combined mapping: pass a PCI BAR's resourceN_wc to measure one\n");
+    }
+
+    free(src);
+    free(dst);
+    return 0;
+}
@@ -0,0 +1,279 @@
+/**
+ * @file nvdaal_cubin.h
+ * @brief Synthetic cubins and fatbins for module loader tests and benches
+ *
+ * Builds the parts of an nvcc cubin the loader reads: .text.<k> per
+ * kernel with an entry symbol, .nv.info with register and stack records,
+ * .nv.info.<k> with the parameter layout, .nv.shared.<k>, constant banks
+ * and, on request, a device function and a relocation section. Code
+ * bytes are a pattern derived from the kernel index, so an upload can be
+ * checked byte for byte. No CUDA toolkit required.
+ */
+
+#ifndef NVDAAL_CUBIN_H
+#define NVDAAL_CUBIN_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace cubin {
+
+struct TestKernel {
+    std::string name;
+    uint32_t codeBytes = 256;
+    uint32_t registers = 32;
+    uint32_t sharedBytes = 0;
+    uint32_t stackBytes = 0;
+    uint32_t maxThreads = 0;                     // __launch_bounds__ (as 1D); 0 = none
+    std::vector<uint32_t> paramSizes;            // In signature order, naturally aligned
+    std::vector<uint8_t> constant2;              // .nv.constant2.<k> data, if any
+};
+
+struct CubinOptions {
+    uint32_t sm = 89;
+    std::vector<uint8_t> constant3;              // Module-wide .nv.constant3 data, if any
+    bool deviceFunction = false;                 // A .text.<helper> without an entry symbol
+    bool relocation = false;                     // A non-empty .rel.text section
+};
+
+inline uint8_t codeByte(uint32_t kernel, uint32_t offset) {
+    return (uint8_t)(kernel * 31 + offset * 7 + 1);
+}
+
+inline uint32_t paramOffset(const TestKernel& k, uint32_t index) {
+    uint32_t at = 0;
+    for (uint32_t i = 0; i <= index; i++) {
+        uint32_t align = k.paramSizes[i] >= 8 ? 8 : k.paramSizes[i];
+        at = (at + align - 1) / align * align;
+        if (i < index) at += k.paramSizes[i];
+    }
+    return at;
+}
+
+inline uint32_t paramBytes(const TestKernel& k) {
+    if (k.paramSizes.empty()) return 0;
+    uint32_t last = (uint32_t)k.paramSizes.size() - 1;
+    return paramOffset(k, last) + k.paramSizes[last];
+}
+
+namespace detail {
+
+struct Section {
+    std::string name;
+    uint32_t type;
+    uint64_t flags;
+    std::vector<uint8_t> data;
+    uint64_t size;                               // For NOBITS
+    uint32_t link, info;
+    uint64_t align, entsize;
+};
+
+inline void put16(std::vector<uint8_t>& v, uint16_t x) { v.insert(v.end(), (uint8_t *)&x, (uint8_t *)&x + 2); }
+inline void put32(std::vector<uint8_t>& v, uint32_t x) { v.insert(v.end(), (uint8_t *)&x, (uint8_t *)&x + 4); }
+inline void put64(std::vector<uint8_t>& v, uint64_t x) { v.insert(v.end(), (uint8_t *)&x, (uint8_t *)&x + 8); }
+
+inline void sval(std::vector<uint8_t>& v, uint8_t attr, std::initializer_list<uint32_t> words) {
+    v.push_back(0x04);
+    v.push_back(attr);
+    put16(v, (uint16_t)(words.size() * 4));
+    for (uint32_t w : words) put32(v, w);
+}
+
+inline void hval(std::vector<uint8_t>& v, uint8_t attr, uint16_t value) {
+    v.push_back(0x03);
+    v.push_back(attr);
+    put16(v, value);
+}
+
+inline uint32_t addString(std::vector<uint8_t>& table, const std::string& s) {
+    uint32_t at = (uint32_t)table.size();
+    table.insert(table.end(), s.begin(), s.end());
+    table.push_back(0);
+    return at;
+}
+
+} // namespace detail
+
+// Parameters sit at 0x160 in bank 0, as for sm_70 and later
+inline std::vector<uint8_t> buildCubin(const std::vector<TestKernel>& kernels, const CubinOptions& opt = CubinOptions()) {
+    using namespace detail;
+    std::vector<Section> sections(1);            // [0] is null
+    auto add = [&](const std::string& name, uint32_t type, uint64_t flags, uint64_t align) {
+        Section s = { name, type, flags, {}, 0, 0, 0, align, 0 };
+        sections.push_back(s);
+        return (uint32_t)sections.size() - 1;
+    };
+
+    uint32_t shstrtab = add(".shstrtab", 3, 0, 1);
+    uint32_t strtab = add(".strtab", 3, 0, 1);
+    uint32_t symtab = add(".symtab", 2, 0, 8);
+    uint32_t info = add(".nv.info", 0x70000000, 0, 4);
+    if (!opt.constant3.empty()) {
+        uint32_t c3 = add(".nv.constant3", 1, 2, 4);
+        sections[c3].data = opt.constant3;
+    }
+
+    // Symbols: null, a section symbol per code section, then the functions
+    std::vector<uint8_t> strings(1, 0);
+    std::vector<uint8_t> symbols(24, 0);
+    auto symbol = [&](uint32_t name, uint8_t infoByte, uint8_t other, uint16_t shndx, uint64_t size) {
+        put32(symbols, name);
+        symbols.push_back(infoByte);
+        symbols.push_back(other);
+        put16(symbols, shndx);
+        put64(symbols, 0);
+        put64(symbols, size);
+        return (uint32_t)(symbols.size() / 24 - 1);
+    };
+
+    std::vector<uint32_t> text(kernels.size());
+    for (size_t k = 0; k < kernels.size(); k++) {
+        text[k] = add(".text." + kernels[k].name, 1, 0x6, 128);
+        for (uint32_t i = 0; i < kernels[k].codeBytes; i++) sections[text[k]].data.push_back(codeByte((uint32_t)k, i));
+        symbol(0, 3, 0, (uint16_t)text[k], 0);                 // STT_SECTION
+    }
+    if (opt.deviceFunction) {
+        uint32_t helper = add(".text.helper", 1, 0x6, 128);
+        sections[helper].data.assign(128, 0xEE);
+        symbol(addString(strings, "helper"), 0x12, 0, (uint16_t)helper, 128);   // STT_FUNC, no entry flag
+    }
+    std::vector<uint32_t> kernelSym(kernels.size());
+    for (size_t k = 0; k < kernels.size(); k++) {
+        kernelSym[k] = symbol(addString(strings, kernels[k].name), 0x12, 0x10, (uint16_t)text[k], kernels[k].codeBytes);
+    }
+
+    for (size_t k = 0; k < kernels.size(); k++) {
+        const TestKernel& tk = kernels[k];
+        sval(sections[info].data, 0x2F, { kernelSym[k], tk.registers });        // REGCOUNT
+        sval(sections[info].data, 0x11, { kernelSym[k], 0 });                   // FRAME_SIZE
+        sval(sections[info].data, 0x12, { kernelSym[k], tk.stackBytes });       // MIN_STACK_SIZE
+        sval(sections[info].data, 0x23, { kernelSym[k], tk.stackBytes });       // MAX_STACK_SIZE
+
+        uint32_t kinfo = add(".nv.info." + tk.name, 0x70000000, 0x40, 4);
+        sections[kinfo].info = text[k];
+        std::vector<uint8_t>& d = sections[kinfo].data;
+        for (size_t i = tk.paramSizes.size(); i-- > 0;) {                        // nvcc lists them last first
+            uint32_t placement = (uint32_t)i | paramOffset(tk, (uint32_t)i) << 16;
+            sval(d, 0x17, { 0, placement, 0x1F000 | tk.paramSizes[i] << 18 });  // KPARAM_INFO
+        }
+        uint32_t bytes = paramBytes(tk);
+        sval(d, 0x0A, { 0, 0x160u | bytes << 16 });                              // PARAM_CBANK
+        hval(d, 0x19, (uint16_t)bytes);                                          // CBANK_PARAM_SIZE
+        if (tk.maxThreads) sval(d, 0x05, { tk.maxThreads, 1, 1 });               // MAX_THREADS
+
+        if (tk.sharedBytes) {
+            uint32_t shared = add(".nv.shared." + tk.name, 8, 3, 16);
+            sections[shared].size = tk.sharedBytes;
+        }
+        uint32_t c0 = add(".nv.constant0." + tk.name, 1, 2, 4);
+        sections[c0].data.assign(0x160 + bytes, 0);
+        sections[c0].info = text[k];
+        if (!tk.constant2.empty()) {
+            uint32_t c2 = add(".nv.constant2." + tk.name, 1, 2, 4);
+            sections[c2].data = tk.constant2;
+        }
+        if (opt.relocation && k == 0) {
+            uint32_t rel = add(".rel.text." + tk.name, 9, 0x40, 8);
+            sections[rel].data.assign(16, 0);
+            sections[rel].link = symtab;
+            sections[rel].info = text[k];
+        }
+    }
+    sections[strtab].data = strings;
+    sections[symtab].data = symbols;
+    sections[symtab].link = strtab;
+    sections[symtab].entsize = 24;
+
+    std::vector<uint8_t> names(1, 0);
+    std::vector<uint32_t> nameAt(sections.size(), 0);
+    for (size_t i = 1; i < sections.size(); i++) nameAt[i] = addString(names, sections[i].name);
+    sections[shstrtab].data = names;
+
+    // Header, section contents, section header table
+    std::vector<uint8_t> elf(64, 0);
+    std::vector<uint64_t> offsets(sections.size(), 0);
+    for (size_t i = 1; i < sections.size(); i++) {
+        while (elf.size() % (sections[i].align ? sections[i].align : 1)) elf.push_back(0);
+        offsets[i] = elf.size();
+        if (sections[i].type != 8) {
+            elf.insert(elf.end(), sections[i].data.begin(), sections[i].data.end());
+            sections[i].size = sections[i].data.size();
+        }
+    }
+    while (elf.size() % 8) elf.push_back(0);
+    uint64_t shoff = elf.size();
+    for (size_t i = 0; i < sections.size(); i++) {
+        const Section& s = sections[i];
+        put32(elf, nameAt[i]);
+        put32(elf, i ? s.type : 0);
+        put64(elf, s.flags);
+        put64(elf, 0);
+        put64(elf, offsets[i]);
+        put64(elf, s.size);
+        put32(elf, s.link);
+        put32(elf, s.info);
+        put64(elf, s.align);
+        put64(elf, s.entsize);
+    }
+
+    uint8_t ident[16] = { 0x7f, 'E', 'L', 'F', 2, 1, 1, 0x33, 7 };
+    memcpy(&elf[0], ident, 16);
+    uint16_t type = 2, machine = 190;
+    uint32_t version = 1;
+    uint32_t flags = opt.sm | opt.sm << 16 | 0x500;
+    uint16_t ehsize = 64, shentsize = 64, shnum = (uint16_t)sections.size(), shstrndx = (uint16_t)shstrtab;
+    memcpy(&elf[16], &type, 2);
+    memcpy(&elf[18], &machine, 2);
+    memcpy(&elf[20], &version, 4);
+    memcpy(&elf[40], &shoff, 8);
+    memcpy(&elf[48], &flags, 4);
+    memcpy(&elf[52], &ehsize, 2);
+    memcpy(&elf[58], &shentsize, 2);
+    memcpy(&elf[60], &shnum, 2);
+    memcpy(&elf[62], &shstrndx, 2);
+    return elf;
+}
+
+struct FatbinEntry {
+    uint16_t kind;                               // 1 PTX, 2 cubin
+    uint32_t arch;
+    std::vector<uint8_t> payload;
+    bool compressed = false;                     // Only flagged; the payload stays as given
+};
+
+inline std::vector<uint8_t> buildFatbin(const std::vector<FatbinEntry>& entries) {
+    using namespace detail;
+    std::vector<uint8_t> body;
+    for (const FatbinEntry& e : entries) {
+        uint64_t padded = (e.payload.size() + 7) & ~7ULL;
+        put16(body, e.kind);
+        put16(body, 0x0101);
+        put32(body, 64);                         // Entry header size
+        put64(body, padded);
+        put32(body, 0);
+        put32(body, 0);
+        put16(body, (uint16_t)(e.arch % 10));
+        put16(body, (uint16_t)(e.arch / 10));
+        put32(body, e.arch);
+        put32(body, 0);
+        put32(body, 0);
+        put64(body, e.compressed ? 0x2000 | 0x11 : 0x11);
+        put64(body, 0);
+        put64(body, e.compressed ? e.payload.size() : 0);
+        body.insert(body.end(), e.payload.begin(), e.payload.end());
+        body.resize(body.size() + (padded - e.payload.size()), 0);
+    }
+    std::vector<uint8_t> fat;
+    put32(fat, 0xBA55ED50);
+    put16(fat, 1);
+    put16(fat, 16);
+    put64(fat, body.size());
+    fat.insert(fat.end(), body.begin(), body.end());
+    return fat;
+}
+
+} // namespace cubin
+
+#endif // NVDAAL_CUBIN_H
@@ -0,0 +1,20 @@
+/**
+ * @file nvdaal_sim_test.h
+ * @brief Helpers shared by the libNVDAAL simulator tests
+ *
+ * Include in place of nvdaal_test.h from tests that drive a Client
+ * created with makeSimBackend().
+ */
+
+#ifndef NVDAAL_SIM_TEST_H
+#define NVDAAL_SIM_TEST_H
+
+#include "nvdaal_test.h"
+#include "libNVDAAL.h"
+
+// The simulator behind `client`, for its counters and fault injection
+static inline nvdaal::SimBackend *sim(nvdaal::Client& client) {
+    return static_cast<nvdaal::SimBackend *>(client.getBackend());
+}
+
+#endif // NVDAAL_SIM_TEST_H
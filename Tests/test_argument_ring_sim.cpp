@@ -0,0 +1,241 @@
+/**
+ * @file test_argument_ring_sim.cpp
+ * @brief Kernel argument packing, the per-stream argument ring and launches
+ *
+ * Packs constant bank 0 for kernels of synthetic cubins (nvdaal_cubin.h)
+ * at the offsets their parameter layout gives, bump-allocates from an
+ * ArgumentRing and checks space comes back only once the stream's
+ * timeline has passed it, and launches through the ring on SimBackend,
+ * which counts the dispatches.
+ *
+ * Compile: make test-argument-ring-sim
+ * Run: ./Build/test_argument_ring_sim
+ */
+
+#include "nvdaal_sim_test.h"
+#include "nvdaal_cubin.h"
+#include "NVDAALArgumentRing.h"
+
+using namespace nvdaal;
+using cubin::TestKernel;
+
+struct Loaded {
+    Client client;
+    BufferAllocator allocator;
+    Module module;
+
+    explicit Loaded(const SimConfig& config = SimConfig()) : client(makeSimBackend(config)), allocator(client) {
+        std::vector<TestKernel> kernels(2);
+        kernels[0].name = "saxpy";                  // (float a, const float *x, float *y, int n)
+        kernels[0].registers = 24;
+        kernels[0].paramSizes = { 4, 8, 8, 4 };
+        kernels[1].name = "no_params";
+        std::vector<uint8_t> image = cubin::buildCubin(kernels);
+        module.parse(image.data(), image.size());
+        module.upload(allocator);
+    }
+};
+
+// Submit an empty pushbuffer (a NOP) on the stream, standing in for the
+// work that reads a block
+static bool submitNop(Stream& stream, const ArgBlock& block) {
+    uint32_t *pb = (uint32_t *)block.cpu;
+    pb[0] = 0;
+    return stream.submit(block.gpuAddr, 4);
+}
+
+// ============================================================================
+// Bank 0
+// ============================================================================
+
+void test_pack_constant_bank0(void) {
+    Loaded l;
+    const Kernel *saxpy = l.module.kernel("saxpy");
+    QmdTemplate qmd;
+    TEST_ASSERT(qmd.init(l.module, *saxpy, 128, 2));
+
+    float a = 2.5f;
+    uint64_t x = 0x200001000ULL, y = 0x200002000ULL;
+    int32_t n = 1 << 20;
+    void *args[] = { &a, &x, &y, &n };
+
+    std::vector<uint8_t> bank(qmd.paramBankBytes() + 16, 0xCC);
+    packConstantBank0(bank.data(), qmd, 4096, 3, 1, args);
+
+    uint32_t shape[6];
+    memcpy(shape, &bank[kBank0BlockDim], 12);
+    memcpy(shape + 3, &bank[kBank0GridDim], 12);
+    TEST_ASSERT_EQ(128, shape[0]);
+    TEST_ASSERT_EQ(2, shape[1]);
+    TEST_ASSERT_EQ(1, shape[2]);
+    TEST_ASSERT_EQ(4096, shape[3]);
+    TEST_ASSERT_EQ(3, shape[4]);
+    TEST_ASSERT_EQ(1, shape[5]);
+    for (uint32_t i = kBank0GridDim + 12; i < saxpy->paramBase; i++) TEST_ASSERT_EQ(0, bank[i]);
+
+    // Parameters at the cubin's offsets, padding zeroed
+    const uint8_t *params = &bank[saxpy->paramBase];
+    TEST_ASSERT_EQ(0, memcmp(params + saxpy->params[0].offset, &a, 4));
+    TEST_ASSERT_EQ(0, memcmp(params + saxpy->params[1].offset, &x, 8));
+    TEST_ASSERT_EQ(0, memcmp(params + saxpy->params[2].offset, &y, 8));
+    TEST_ASSERT_EQ(0, memcmp(params + saxpy->params[3].offset, &n, 4));
+    TEST_ASSERT_EQ(8, saxpy->params[1].offset);
+    for (uint32_t i = 4; i < 8; i++) TEST_ASSERT_EQ(0, params[i]);
+    for (uint32_t i = saxpy->paramBase + saxpy->paramBytes; i < qmd.paramBankBytes(); i++) {
+        TEST_ASSERT_EQ(0, bank[i]);
+    }
+    TEST_ASSERT_EQ(0xCC, bank[qmd.paramBankBytes()]);       // Nothing past the bank
+}
+
+// ============================================================================
+// Ring
+// ============================================================================
+
+void test_ring_allocate_and_reclaim(void) {
+    Loaded l;
+    Stream stream(l.client, l.allocator);
+    ArgumentRing ring(stream, l.allocator, 4096);
+    TEST_ASSERT(ring.valid());
+    TEST_ASSERT_EQ(4096, ring.capacity());
+
+    ArgBlock a, b;
+    TEST_ASSERT(ring.allocate(100, &a));
+    TEST_ASSERT_EQ(256, a.bytes);
+    TEST_ASSERT_EQ(0, a.gpuAddr % ArgumentRing::kArgAlign);
+    TEST_ASSERT(ring.allocate(600, &b));                      // Same submission: same record
+    TEST_ASSERT_EQ(a.gpuAddr + 256, b.gpuAddr);
+    TEST_ASSERT_EQ(768, b.bytes);
+    TEST_ASSERT(submitNop(stream, a));
+
+    // Fill the rest, one submission per block
+    for (int i = 0; i < 3; i++) {
+        ArgBlock c;
+        TEST_ASSERT(ring.allocate(1024, &c));
+        TEST_ASSERT(submitNop(stream, c));
+    }
+    TEST_ASSERT_EQ(0, ring.stats().timelineReads);            // Room enough so far: no driver reads
+
+    // The next one wraps and must wait for the first submission's blocks
+    TEST_ASSERT(stream.synchronize());
+    ArgBlock d;
+    TEST_ASSERT(ring.allocate(1024, &d));
+    TEST_ASSERT_EQ(a.gpuAddr, d.gpuAddr);
+    TEST_ASSERT(submitNop(stream, d));
+    ArgumentRingStats s = ring.stats();
+    TEST_ASSERT_EQ(1, s.timelineReads);
+    TEST_ASSERT_EQ(0, s.stalls);
+    TEST_ASSERT_EQ(1, s.wraps);
+    TEST_ASSERT_EQ(6, s.blocks);
+    TEST_ASSERT_EQ(256 + 768 + 4 * 1024, s.bytes);
+
+    // A block too big for what's left at the end skips to the front
+    ArgBlock e;
+    TEST_ASSERT(stream.synchronize());
+    TEST_ASSERT(ring.allocate(3 * 1024 + 256, &e));
+    TEST_ASSERT_EQ(a.gpuAddr, e.gpuAddr);
+    TEST_ASSERT_EQ(2, ring.stats().wraps);
+    TEST_ASSERT(submitNop(stream, e));
+
+    TEST_ASSERT(!ring.allocate(0, &e));
+    TEST_ASSERT(!ring.allocate(4097, &e));
+}
+
+void test_ring_waits_for_gpu(void) {
+    SimConfig config;
+    config.submitLatencyUs = 2000;
+    Loaded l(config);
+    Stream stream(l.client, l.allocator);
+    ArgumentRing ring(stream, l.allocator, 2048);
+
+    // Eight blocks round a two-block ring: the host has to wait for
+    // submissions still in flight, and never hands out space twice
+    uint64_t previous = 0;
+    for (int i = 0; i < 8; i++) {
+        ArgBlock block;
+        TEST_ASSERT(ring.allocate(1024, &block));
+        TEST_ASSERT(block.gpuAddr != previous);
+        previous = block.gpuAddr;
+        TEST_ASSERT(submitNop(stream, block));
+    }
+    TEST_ASSERT(ring.stats().stalls >= 1);
+    TEST_ASSERT(stream.synchronize());
+}
+
+void test_ring_unsubmitted_blocks(void) {
+    Loaded l;
+    Stream stream(l.client, l.allocator);
+    ArgumentRing ring(stream, l.allocator, 2048);
+    ArgBlock block;
+    TEST_ASSERT(ring.allocate(1024, &block));
+    TEST_ASSERT(ring.allocate(1024, &block));
+    // Nothing was submitted for the first two: reusing them could clobber
+    // work not yet submitted, so the ring refuses rather than waits forever
+    TEST_ASSERT(!ring.allocate(1024, &block));
+    TEST_ASSERT_EQ(1, ring.stats().failures);
+    TEST_ASSERT(submitNop(stream, block));
+    TEST_ASSERT(ring.allocate(1024, &block));
+    TEST_ASSERT(submitNop(stream, block));
+}
+
+// ============================================================================
+// Launches
+// ============================================================================
+
+void test_ring_launch(void) {
+    Loaded l;
+    Stream stream(l.client, l.allocator);
+    ArgumentRing ring(stream, l.allocator, 64 << 10);
+    QmdCache cache;
+    const QmdTemplate *saxpy = cache.get(l.module, *l.module.kernel("saxpy"), 256);
+    const QmdTemplate *empty = cache.get(l.module, *l.module.kernel("no_params"), 32);
+    TEST_ASSERT(saxpy && empty);
+
+    float a = 1.0f;
+    uint64_t x = 0, y = 0;
+    int32_t n = 0;
+    void *args[] = { &a, &x, &y, &n };
+    const int launches = 1000;
+    for (int i = 0; i < launches; i++) {
+        n = i;
+        TEST_ASSERT(ring.launch(*saxpy, (uint32_t)(i + 255) / 256 + 1, 1, 1, args, i % 2 == 0));
+    }
+    TEST_ASSERT(ring.launch(*empty, 1, 1, 1, nullptr));
+    TEST_ASSERT(stream.synchronize());
+
+    SimCounters c = sim(l.client)->counters();
+    TEST_ASSERT_EQ(launches + 1, c.dispatches);
+    TEST_ASSERT_EQ(0, c.faults);
+    ArgumentRingStats s = ring.stats();
+    TEST_ASSERT_EQ(launches + 1, s.launches);
+    TEST_ASSERT_EQ(launches + 1, stream.stats().submissions);
+    TEST_ASSERT(s.wraps >= 10);                               // 1 KiB per launch round 64 KiB
+    TEST_ASSERT(s.timelineReads <= launches / 32);            // Read once per stretch of ring, not per launch
+
+    // Bad grids and missing arguments fail without submitting
+    TEST_ASSERT(!ring.launch(*saxpy, 0, 1, 1, args));
+    TEST_ASSERT(!ring.launch(*saxpy, 1, 1, 1, nullptr));
+    TEST_ASSERT(!ring.launch(QmdTemplate(), 1, 1, 1, args));
+    TEST_ASSERT_EQ(launches + 1, stream.stats().submissions);
+}
+
+void test_ring_launch_copy_stream(void) {
+    SimConfig config;
+    config.copyChannels = 1;
+    Loaded l(config);
+    Stream copies(l.client, l.allocator, kCopyChannel);
+    TEST_ASSERT(copies.copyEngine());
+    ArgumentRing ring(copies, l.allocator, 4096);
+    QmdTemplate qmd;
+    TEST_ASSERT(qmd.init(l.module, *l.module.kernel("no_params"), 32));
+    TEST_ASSERT(!ring.launch(qmd, 1, 1, 1, nullptr));         // No compute class there
+    TEST_ASSERT_EQ(0, copies.stats().submissions);
+}
+
+TEST_MAIN("libNVDAAL Argument Ring Tests",
+    TEST_CASE(test_pack_constant_bank0),
+    TEST_CASE(test_ring_allocate_and_reclaim),
+    TEST_CASE(test_ring_waits_for_gpu),
+    TEST_CASE(test_ring_unsubmitted_blocks),
+    TEST_CASE(test_ring_launch),
+    TEST_CASE(test_ring_launch_copy_stream)
+)
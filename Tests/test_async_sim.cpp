@@ -0,0 +1,214 @@
+/**
+ * @file test_async_sim.cpp
+ * @brief libNVDAAL async API (completions, executor, coroutines)
+ *
+ * Runs Executor against SimBackend: submissions that release the executor's
+ * timeline semaphore, completion callbacks and futures, co_await inside
+ * Task coroutines, and teardown with work still outstanding.
+ *
+ * Compile: make test-async-sim
+ * Run: ./Build/test_async_sim
+ */
+
+#include "nvdaal_sim_test.h"
+#include "NVDAALAsync.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace nvdaal;
+
+// ============================================================================
+// Submission
+// ============================================================================
+
+void test_async_submit_releases_semaphore(void) {
+    Client client(makeSimBackend());
+    Semaphore sem;
+    TEST_ASSERT(client.createSemaphore(&sem));
+
+    // Immediate doorbell: the release lands as soon as the channel completes
+    TEST_ASSERT(client.submitCommand(0x10, sem, 3));
+    TEST_ASSERT(client.waitSemaphore(sem, 3, 1000));
+    TEST_ASSERT(!client.submitCommand(0x11, Semaphore{ 9999, 0 }, 1));
+    TEST_ASSERT_EQ(1, sim(client)->counters().submissions);
+}
+
+void test_async_completion_wait(void) {
+    SimConfig config;
+    config.submitLatencyUs = 200;
+    Client client(makeSimBackend(config));
+    Executor executor(client);
+    TEST_ASSERT(executor.valid());
+
+    Completion a = executor.submit(1);
+    Completion b = executor.submit(2);
+    TEST_ASSERT(a.valid());
+    TEST_ASSERT(b.wait(1000));
+    TEST_ASSERT(a.ok());                                 // Retired by the same payload
+    TEST_ASSERT_EQ(kStatusSuccess, b.status());
+
+    uint64_t value = 0;
+    TEST_ASSERT(client.readSemaphore(executor.timeline(), &value));
+    TEST_ASSERT_EQ(2, value);
+
+    Completion none;
+    TEST_ASSERT(!none.valid());
+    TEST_ASSERT(!none.wait(0));
+}
+
+void test_async_then_and_future(void) {
+    SimConfig config;
+    config.submitLatencyUs = 100;
+    Client client(makeSimBackend(config));
+    Executor executor(client, 2);
+
+    const int kSubmits = 64;
+    std::atomic<int> callbacks(0);
+    std::thread::id caller = std::this_thread::get_id();
+    std::atomic<bool> onCaller(false);
+    for (int i = 0; i < kSubmits; i++) {
+        executor.submit(i).then([&](Status status) {
+            if (status == kStatusSuccess) callbacks++;
+            if (std::this_thread::get_id() == caller) onCaller = true;
+        });
+    }
+
+    std::future<Status> last = executor.submit(kSubmits).future();
+    TEST_ASSERT(last.wait_for(std::chrono::seconds(1)) == std::future_status::ready);
+    TEST_ASSERT_EQ(kSubmits, sim(client)->counters().completed - 1);
+    TEST_ASSERT_EQ(kStatusSuccess, last.get());
+
+    for (int i = 0; i < 500 && callbacks < kSubmits; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    TEST_ASSERT_EQ(kSubmits, callbacks.load());
+    TEST_ASSERT(!onCaller);
+}
+
+void test_async_after(void) {
+    Client client(makeSimBackend());
+    Executor executor(client, 0);
+    Semaphore sem;
+    TEST_ASSERT(client.createSemaphore(&sem));
+
+    Completion c = executor.after(sem, 5);
+    TEST_ASSERT(!c.ready());
+    TEST_ASSERT_EQ(kStatusNotReady, c.status());
+
+    int ran = 0;
+    c.then([&](Status status) { ran = status == kStatusSuccess ? 1 : -1; });
+    TEST_ASSERT(client.signalSemaphore(sem, 5));
+    TEST_ASSERT(c.wait(1000));
+
+    // No worker threads: the callback waits for poll()
+    TEST_ASSERT_EQ(0, ran);
+    TEST_ASSERT_EQ(1, executor.poll());
+    TEST_ASSERT_EQ(1, ran);
+
+    TEST_ASSERT_EQ(kStatusNotFound, executor.after(Semaphore{ 4242, 0 }, 1).status());
+}
+
+void test_async_coalesced_deadline(void) {
+    Client client(makeSimBackend());
+    SubmitPolicy policy;
+    policy.maxEntries = 64;
+    policy.deadlineUs = 300;
+    TEST_ASSERT(client.setSubmitPolicy(policy));
+    Executor executor(client);
+
+    // Held until the deadline rings the doorbell
+    Completion c = executor.submit(7);
+    TEST_ASSERT(!c.ready());
+    TEST_ASSERT(c.wait(1000));
+    TEST_ASSERT_EQ(1, sim(client)->counters().doorbells);
+}
+
+void test_async_destroy_aborts(void) {
+    Client client(makeSimBackend());
+    SubmitPolicy policy;
+    policy.maxEntries = 64;                              // No deadline: never rung
+    TEST_ASSERT(client.setSubmitPolicy(policy));
+
+    Completion c;
+    std::atomic<Status> seen(kStatusSuccess);
+    {
+        Executor executor(client);
+        c = executor.submit(1);
+        c.then([&](Status status) { seen = status; });
+    }
+    TEST_ASSERT(c.ready());
+    TEST_ASSERT_EQ(kStatusAborted, c.status());
+    TEST_ASSERT_EQ(kStatusAborted, seen.load());
+
+    // Callbacks added after the executor is gone run inline
+    int ran = 0;
+    c.then([&](Status) { ran++; });
+    TEST_ASSERT_EQ(1, ran);
+}
+
+// ============================================================================
+// Coroutines
+// ============================================================================
+
+static Task<int> submitChain(Executor& executor, int count) {
+    int ok = 0;
+    for (int i = 0; i < count; i++) {
+        Status status = co_await executor.submit(i);
+        if (status == kStatusSuccess) ok++;
+    }
+    co_return ok;
+}
+
+static Task<int> fanIn(Executor& executor) {
+    Task<int> a = submitChain(executor, 4);
+    Task<int> b = submitChain(executor, 6);
+    co_return co_await a + co_await b;
+}
+
+static Task<> throwing(Executor& executor) {
+    co_await executor.schedule();
+    throw std::runtime_error("expected");
+}
+
+void test_async_coroutine_chain(void) {
+    SimConfig config;
+    config.submitLatencyUs = 50;
+    Client client(makeSimBackend(config));
+    Executor executor(client);
+
+    TEST_ASSERT_EQ(8, submitChain(executor, 8).get());
+    TEST_ASSERT_EQ(10, fanIn(executor).get());
+    TEST_ASSERT_EQ(18, sim(client)->counters().completed);
+}
+
+void test_async_coroutine_exception(void) {
+    Client client(makeSimBackend());
+    Executor executor(client);
+
+    bool caught = false;
+    try {
+        throwing(executor).get();
+    } catch (const std::runtime_error&) {
+        caught = true;
+    }
+    TEST_ASSERT(caught);
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+TEST_MAIN("libNVDAAL Async API Tests",
+    // Submission
+    TEST_CASE(test_async_submit_releases_semaphore),
+    TEST_CASE(test_async_completion_wait),
+    TEST_CASE(test_async_then_and_future),
+    TEST_CASE(test_async_after),
+    TEST_CASE(test_async_coalesced_deadline),
+    TEST_CASE(test_async_destroy_aborts),
+
+    // Coroutines
+    TEST_CASE(test_async_coroutine_chain),
+    TEST_CASE(test_async_coroutine_exception)
+)
@@ -0,0 +1,251 @@
+/**
+ * @file test_buffer_sim.cpp
+ * @brief Buffer handles and the caching VRAM allocator
+ *
+ * Runs BufferAllocator against SimBackend: slab reservation, size-class
+ * pools, best-fit reuse, splitting and merging, CPU and GPU addresses,
+ * move semantics and statistics.
+ *
+ * Compile: make test-buffer-sim
+ * Run: ./Build/test_buffer_sim
+ */
+
+#include "nvdaal_sim_test.h"
+#include "NVDAALBuffer.h"
+#include <thread>
+#include <vector>
+
+using namespace nvdaal;
+
+// ============================================================================
+// Allocation
+// ============================================================================
+
+void test_buffer_rounding(void) {
+    TEST_ASSERT_EQ(512, BufferAllocator::roundSize(1));
+    TEST_ASSERT_EQ(512, BufferAllocator::roundSize(512));
+    TEST_ASSERT_EQ(1024, BufferAllocator::roundSize(513));
+    TEST_ASSERT_EQ(1 << 20, BufferAllocator::roundSize(1 << 20));
+}
+
+void test_buffer_small_pool(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+
+    Buffer a = allocator.allocate(100);
+    Buffer b = allocator.allocate(4000);
+    TEST_ASSERT(a.valid());
+    TEST_ASSERT(b.valid());
+    TEST_ASSERT_EQ(100, a.size());
+    TEST_ASSERT_EQ(512, a.capacity());
+    TEST_ASSERT_EQ(a.vramOffset() + 512, b.vramOffset());        // Carved from one slab
+    TEST_ASSERT_EQ(a.gpuAddr() + 512, b.gpuAddr());
+    TEST_ASSERT_NEQ(0, a.gpuAddr());
+
+    BufferAllocatorStats s = allocator.stats();
+    TEST_ASSERT_EQ(1, s.slabs);
+    TEST_ASSERT_EQ(2 << 20, s.reservedBytes);
+    TEST_ASSERT_EQ(512 + 4096, s.allocatedBytes);
+    TEST_ASSERT_EQ(4100, s.requestedBytes);
+    TEST_ASSERT_EQ(2 << 20, sim(client)->counters().vramUsed);
+}
+
+void test_buffer_large_pool(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+
+    Buffer a = allocator.allocate(3 << 20);                      // Shares a 20 MiB slab
+    Buffer b = allocator.allocate(5 << 20);
+    Buffer c = allocator.allocate(33 << 20);                     // Own slab, rounded to 2 MiB
+    TEST_ASSERT(a && b && c);
+    TEST_ASSERT_EQ(a.vramOffset() + (3 << 20), b.vramOffset());
+
+    BufferAllocatorStats s = allocator.stats();
+    TEST_ASSERT_EQ(2, s.slabs);
+    TEST_ASSERT_EQ((20 << 20) + (34 << 20), s.reservedBytes);
+
+    // Small requests never come out of the large pool
+    Buffer d = allocator.allocate(64);
+    TEST_ASSERT_EQ(3, allocator.stats().slabs);
+}
+
+void test_buffer_reuse(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+
+    uint64_t offset;
+    {
+        Buffer a = allocator.allocate(8192);
+        offset = a.vramOffset();
+    }
+    uint64_t calls = sim(client)->counters().calls;
+
+    // The freed block merged back into the slab and is handed out again
+    for (int i = 0; i < 100; i++) {
+        Buffer b = allocator.allocate(8192);
+        TEST_ASSERT_EQ(offset, b.vramOffset());
+    }
+    TEST_ASSERT_EQ(calls, sim(client)->counters().calls);        // No driver calls
+
+    BufferAllocatorStats s = allocator.stats();
+    TEST_ASSERT_EQ(101, s.allocations);
+    TEST_ASSERT_EQ(101, s.frees);
+    TEST_ASSERT_EQ(100, s.cacheHits);
+    TEST_ASSERT_EQ(0, s.allocatedBytes);
+    TEST_ASSERT_EQ(2 << 20, s.cachedBytes());
+}
+
+void test_buffer_best_fit_and_merge(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+
+    Buffer a = allocator.allocate(4096);
+    Buffer b = allocator.allocate(1024);
+    Buffer c = allocator.allocate(4096);
+    Buffer d = allocator.allocate(4096);
+    Buffer e = allocator.allocate(512);                          // Keeps d's hole bounded
+    uint64_t aOff = a.vramOffset(), bOff = b.vramOffset();
+
+    // Holes of 1 KiB and 4 KiB: a 1 KiB request takes the tighter one
+    b.reset();
+    d.reset();
+    Buffer f = allocator.allocate(1000);
+    TEST_ASSERT_EQ(bOff, f.vramOffset());
+
+    // Freeing a, f and c merges everything up to e into one 13 KiB block
+    a.reset();
+    c.reset();
+    f.reset();
+    Buffer g = allocator.allocate(13 << 10);
+    TEST_ASSERT_EQ(aOff, g.vramOffset());
+    TEST_ASSERT(allocator.stats().merges >= 3);
+    TEST_ASSERT_EQ(1, allocator.stats().slabs);
+}
+
+void test_buffer_move(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+
+    Buffer a = allocator.allocate(256);
+    uint64_t offset = a.vramOffset();
+    Buffer b(std::move(a));
+    TEST_ASSERT(!a.valid());
+    TEST_ASSERT_EQ(offset, b.vramOffset());
+
+    Buffer c = allocator.allocate(256);
+    c = std::move(b);                                            // c's old block is freed
+    TEST_ASSERT_EQ(offset, c.vramOffset());
+    TEST_ASSERT_EQ(1, allocator.stats().frees);
+
+    std::vector<Buffer> buffers;
+    for (int i = 0; i < 16; i++) buffers.push_back(allocator.allocate(512));
+    buffers.clear();
+    TEST_ASSERT_EQ(17, allocator.stats().frees);
+}
+
+// ============================================================================
+// Mappings and Limits
+// ============================================================================
+
+void test_buffer_cpu_mapping(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+
+    Buffer a = allocator.allocate(4096);
+    Buffer b = allocator.allocate(4096);
+    uint8_t *pa = (uint8_t *)a.cpu();
+    uint8_t *pb = (uint8_t *)b.cpu();
+    TEST_ASSERT_NOT_NULL(pa);
+    TEST_ASSERT_EQ(pa + 4096, pb);                               // One mapping per slab
+
+    // a starts the slab, so a raw mapping of the slab aliases it
+    memset(pa, 0x5A, 4096);
+    uint8_t *raw = (uint8_t *)client.mapVramCpu(a.vramOffset());
+    TEST_ASSERT_NOT_NULL(raw);
+    TEST_ASSERT_EQ(0x5A, raw[4095]);
+    TEST_ASSERT(client.unmapVramCpu(a.vramOffset(), raw));
+}
+
+void test_buffer_no_gpu_map(void) {
+    Client client(makeSimBackend());
+    BufferAllocatorConfig config;
+    config.mapGpu = false;
+    BufferAllocator allocator(client, config);
+
+    Buffer a = allocator.allocate(100);
+    TEST_ASSERT(a.valid());
+    TEST_ASSERT_EQ(0, a.gpuAddr());
+    TEST_ASSERT_EQ(1, sim(client)->counters().calls);            // allocVram only
+}
+
+void test_buffer_exhaustion(void) {
+    SimConfig simConfig;
+    simConfig.vramBytes = 8 << 20;
+    Client client(makeSimBackend(simConfig));
+    BufferAllocator allocator(client);
+
+    TEST_ASSERT(!allocator.allocate(16 << 20).valid());
+    TEST_ASSERT_EQ(1, allocator.stats().failures);
+    TEST_ASSERT(!allocator.allocate(0).valid());
+
+    // Sizes that would wrap when rounded are refused before rounding
+    TEST_ASSERT(!allocator.allocate(SIZE_MAX).valid());
+    TEST_ASSERT(!allocator.allocate(SIZE_MAX - 100).valid());
+    TEST_ASSERT(!allocator.allocate(BufferAllocator::kMaxSize + 1).valid());
+    TEST_ASSERT(!allocator.reserve(SIZE_MAX));
+    TEST_ASSERT_EQ(4, allocator.stats().failures);
+    TEST_ASSERT_EQ(0, allocator.stats().slabs);
+
+    TEST_ASSERT(allocator.reserve(4 << 20));
+    Buffer a = allocator.allocate(3 << 20);                      // From the reservation
+    TEST_ASSERT(a.valid());
+    TEST_ASSERT_EQ(1, allocator.stats().slabs);
+    TEST_ASSERT_EQ(4 << 20, a.capacity());                       // 1 MiB tail too small to split off
+    TEST_ASSERT_EQ(4 << 20, allocator.stats().peakAllocatedBytes);
+    a.reset();
+    allocator.resetPeak();
+    TEST_ASSERT_EQ(0, allocator.stats().peakAllocatedBytes);
+}
+
+void test_buffer_threads(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&allocator, t] {
+            std::vector<Buffer> live;
+            for (int i = 0; i < 2000; i++) {
+                live.push_back(allocator.allocate(512 * (1 + (i + t) % 16)));
+                if (live.size() > 32) live.erase(live.begin());
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    BufferAllocatorStats s = allocator.stats();
+    TEST_ASSERT_EQ(8000, s.allocations);
+    TEST_ASSERT_EQ(8000, s.frees);
+    TEST_ASSERT_EQ(0, s.allocatedBytes);
+    TEST_ASSERT_EQ(0, s.failures);
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+TEST_MAIN("libNVDAAL Buffer Allocator Tests",
+    // Allocation
+    TEST_CASE(test_buffer_rounding),
+    TEST_CASE(test_buffer_small_pool),
+    TEST_CASE(test_buffer_large_pool),
+    TEST_CASE(test_buffer_reuse),
+    TEST_CASE(test_buffer_best_fit_and_merge),
+    TEST_CASE(test_buffer_move),
+
+    // Mappings and limits
+    TEST_CASE(test_buffer_cpu_mapping),
+    TEST_CASE(test_buffer_no_gpu_map),
+    TEST_CASE(test_buffer_exhaustion),
+    TEST_CASE(test_buffer_threads)
+)
@@ -0,0 +1,352 @@
+/**
+ * @file test_c_api_sim.c
+ * @brief The C API: handles, batched calls and caller-memory variants
+ *
+ * Written in C against nvdaal_c_api.h alone, as an FFI binding would see
+ * it. Allocates buffers, records copies and fills from command arrays,
+ * runs writes, submissions, records and reads through one nvdaal_execute(),
+ * orders streams with events and exchanges DLPack tensors, all on the
+ * simulator backend, which executes copies in its fake VRAM.
+ *
+ * Compile: make test-c-api-sim
+ * Run: ./Build/test_c_api_sim
+ */
+
+#include "nvdaal_test.h"
+#include "nvdaal_c_api.h"
+
+// ============================================================================
+// Clients
+// ============================================================================
+
+void test_null_handles(void) {
+    uint8_t image[64] = { 0 };
+    TEST_ASSERT(!nvdaal_connect(NULL));
+    TEST_ASSERT(!nvdaal_load_firmware_data(NULL, image, sizeof(image)));
+    TEST_ASSERT_EQ(0, nvdaal_buffer_alloc(NULL, 4096));
+    TEST_ASSERT_EQ(0, nvdaal_stream_create(NULL, NVDAAL_ANY_CHANNEL));
+    TEST_ASSERT_EQ(0, nvdaal_command_buffer_record(NULL, NULL, 1));
+    TEST_ASSERT(!nvdaal_stream_synchronize(NULL, 10));
+    TEST_ASSERT_EQ(0, nvdaal_execute(NULL, 4, 0));
+    TEST_ASSERT_EQ(0, nvdaal_context_create(99));
+    nvdaal_buffer_free(NULL);
+    nvdaal_stream_destroy(NULL);
+    nvdaal_context_destroy(NULL);
+}
+
+void test_firmware_from_memory(void) {
+    nvdaal_context_t context = nvdaal_context_create(NVDAAL_BACKEND_SIM);
+    TEST_ASSERT(context != NULL);
+    nvdaal_client_t client = nvdaal_context_client(context);
+    TEST_ASSERT(nvdaal_is_connected(client));
+
+    // Read in place from caller memory; no file needed
+    static uint8_t vbios[64 << 10];
+    static uint8_t bootloader[4096];
+    memset(vbios, 0x55, sizeof(vbios));
+    memset(bootloader, 0xAA, sizeof(bootloader));
+    TEST_ASSERT(nvdaal_load_vbios_data(client, vbios, sizeof(vbios)));
+    TEST_ASSERT(nvdaal_load_bootloader_data(client, bootloader, sizeof(bootloader)));
+    TEST_ASSERT(!nvdaal_load_booter_data(client, NULL, 16));
+    TEST_ASSERT(!nvdaal_load_firmware_data(client, vbios, 0));
+    nvdaal_context_destroy(context);
+}
+
+// ============================================================================
+// Buffers
+// ============================================================================
+
+void test_buffers(void) {
+    nvdaal_context_t context = nvdaal_context_create(NVDAAL_BACKEND_SIM);
+    size_t sizes[4] = { 100, 4096, 65536, 1 << 20 };
+    nvdaal_buffer_t buffers[4];
+    TEST_ASSERT(nvdaal_buffer_alloc_batch(context, sizes, 4, buffers));
+    for (int i = 0; i < 4; i++) {
+        TEST_ASSERT_EQ(sizes[i], nvdaal_buffer_size(buffers[i]));
+        TEST_ASSERT(nvdaal_buffer_gpu_addr(buffers[i]) != 0);
+        TEST_ASSERT(nvdaal_buffer_cpu(buffers[i]) != NULL);
+    }
+
+    uint32_t in[1024], out[1024];
+    for (int i = 0; i < 1024; i++) in[i] = 0x1000u + i;
+    TEST_ASSERT(nvdaal_buffer_write(buffers[1], 0, in, sizeof(in)));
+    TEST_ASSERT(nvdaal_buffer_read(buffers[1], 0, out, sizeof(out)));
+    TEST_ASSERT_EQ(0, memcmp(in, out, sizeof(in)));
+    TEST_ASSERT(!nvdaal_buffer_write(buffers[0], 64, in, 64));        // Past the 100 bytes asked for
+    TEST_ASSERT(!nvdaal_buffer_read(buffers[0], 101, out, 0));
+
+    // A failure leaves nothing behind
+    size_t bad[2] = { 4096, 0 };
+    nvdaal_buffer_t half[2] = { buffers[0], buffers[0] };
+    TEST_ASSERT(!nvdaal_buffer_alloc_batch(context, bad, 2, half));
+    TEST_ASSERT(half[0] == NULL && half[1] == NULL);
+
+    nvdaal_buffer_free_batch(buffers, 4);
+    nvdaal_context_destroy(context);
+}
+
+// ============================================================================
+// Command Buffers and Streams
+// ============================================================================
+
+void test_record_and_submit(void) {
+    nvdaal_context_t context = nvdaal_context_create(NVDAAL_BACKEND_SIM);
+    nvdaal_buffer_t src = nvdaal_buffer_alloc(context, 8192);
+    nvdaal_buffer_t dst = nvdaal_buffer_alloc(context, 8192);
+    nvdaal_stream_t stream = nvdaal_stream_create(context, NVDAAL_ANY_CHANNEL);
+    nvdaal_command_buffer_t cb = nvdaal_command_buffer_create(context, 0);
+    TEST_ASSERT(src && dst && stream && cb);
+
+    uint8_t pattern[4096];
+    for (int i = 0; i < 4096; i++) pattern[i] = (uint8_t)(i * 7);
+    TEST_ASSERT(nvdaal_buffer_write(src, 0, pattern, sizeof(pattern)));
+
+    nvdaal_command commands[3];
+    memset(commands, 0, sizeof(commands));
+    commands[0].op = NVDAAL_CMD_COPY;
+    commands[0].dst = dst;
+    commands[0].src = src;
+    commands[0].bytes = 4096;
+    commands[1].op = NVDAAL_CMD_FILL;
+    commands[1].dst = dst;
+    commands[1].dst_offset = 4096;
+    commands[1].bytes = 4096;
+    commands[1].value = 0xDEADBEEF;
+    commands[2].op = NVDAAL_CMD_BARRIER;
+    TEST_ASSERT_EQ(3, nvdaal_command_buffer_record(cb, commands, 3));
+    TEST_ASSERT(nvdaal_command_buffer_end(cb));
+    TEST_ASSERT(nvdaal_stream_submit(stream, cb));
+    TEST_ASSERT(nvdaal_stream_synchronize(stream, 1000));
+    TEST_ASSERT(nvdaal_stream_query(stream));
+
+    uint8_t back[8192];
+    TEST_ASSERT(nvdaal_buffer_read(dst, 0, back, sizeof(back)));
+    TEST_ASSERT_EQ(0, memcmp(back, pattern, 4096));
+    uint32_t word;
+    memcpy(&word, back + 8188, 4);
+    TEST_ASSERT_EQ(0xDEADBEEF, word);
+
+    // A bad command stops the array and fails the recording until begin()
+    nvdaal_command_buffer_begin(cb);
+    commands[0].bytes = 16384;                                         // Past the end of src
+    TEST_ASSERT_EQ(0, nvdaal_command_buffer_record(cb, commands, 3));
+    TEST_ASSERT_EQ(0, nvdaal_command_buffer_record(cb, commands + 1, 2));
+    TEST_ASSERT(!nvdaal_command_buffer_end(cb));
+    nvdaal_command_buffer_begin(cb);
+    TEST_ASSERT_EQ(2, nvdaal_command_buffer_record(cb, commands + 1, 2));
+    TEST_ASSERT(nvdaal_command_buffer_end(cb));
+
+    // Several recordings, one call
+    nvdaal_command_buffer_t many[3] = { cb, cb, cb };
+    TEST_ASSERT_EQ(3, nvdaal_stream_submit_batch(stream, many, 3));
+    TEST_ASSERT(nvdaal_stream_synchronize(stream, 1000));
+
+    nvdaal_command_buffer_destroy(cb);
+    nvdaal_stream_destroy(stream);
+    nvdaal_buffer_free(src);
+    nvdaal_buffer_free(dst);
+    nvdaal_context_destroy(context);
+}
+
+void test_events(void) {
+    nvdaal_context_t context = nvdaal_context_create(NVDAAL_BACKEND_SIM);
+    nvdaal_stream_t producer = nvdaal_stream_create(context, NVDAAL_ANY_CHANNEL);
+    nvdaal_stream_t consumer = nvdaal_stream_create(context, NVDAAL_ANY_CHANNEL);
+    nvdaal_buffer_t buffer = nvdaal_buffer_alloc(context, 4096);
+    nvdaal_command_buffer_t fill = nvdaal_command_buffer_create(context, 0);
+    nvdaal_command_buffer_t wait = nvdaal_command_buffer_create(context, 0);
+
+    nvdaal_event none;
+    memset(&none, 0, sizeof(none));
+    TEST_ASSERT(nvdaal_event_query(&none));                            // Nothing recorded: complete
+
+    nvdaal_command command;
+    memset(&command, 0, sizeof(command));
+    command.op = NVDAAL_CMD_FILL;
+    command.dst = buffer;
+    command.bytes = 4096;
+    command.value = 7;
+    TEST_ASSERT_EQ(1, nvdaal_command_buffer_record(fill, &command, 1));
+    TEST_ASSERT(nvdaal_command_buffer_end(fill));
+    TEST_ASSERT(nvdaal_stream_submit(producer, fill));
+
+    nvdaal_event done;
+    TEST_ASSERT(nvdaal_stream_record(producer, &done));
+    TEST_ASSERT(done.value != 0);
+    TEST_ASSERT(nvdaal_stream_wait(consumer, &done));
+
+    // Or inside a recording
+    memset(&command, 0, sizeof(command));
+    command.op = NVDAAL_CMD_WAIT;
+    command.event = &done;
+    TEST_ASSERT_EQ(1, nvdaal_command_buffer_record(wait, &command, 1));
+    TEST_ASSERT(nvdaal_command_buffer_end(wait));
+    TEST_ASSERT(nvdaal_stream_submit(consumer, wait));
+    TEST_ASSERT(nvdaal_stream_synchronize(consumer, 1000));
+    TEST_ASSERT(nvdaal_event_synchronize(&done, 1000));
+    TEST_ASSERT(nvdaal_event_query(&done));
+
+    nvdaal_command_buffer_destroy(fill);
+    nvdaal_command_buffer_destroy(wait);
+    nvdaal_buffer_free(buffer);
+    nvdaal_stream_destroy(producer);
+    nvdaal_stream_destroy(consumer);
+    nvdaal_context_destroy(context);
+}
+
+// ============================================================================
+// Batched Calls
+// ============================================================================
+
+void test_execute(void) {
+    nvdaal_context_t context = nvdaal_context_create(NVDAAL_BACKEND_SIM);
+    nvdaal_buffer_t src = nvdaal_buffer_alloc(context, 4096);
+    nvdaal_buffer_t dst = nvdaal_buffer_alloc(context, 4096);
+    nvdaal_stream_t stream = nvdaal_stream_create(context, NVDAAL_ANY_CHANNEL);
+    nvdaal_command_buffer_t cb = nvdaal_command_buffer_create(context, 0);
+
+    nvdaal_command copy;
+    memset(&copy, 0, sizeof(copy));
+    copy.op = NVDAAL_CMD_COPY;
+    copy.dst = dst;
+    copy.src = src;
+    copy.bytes = 256;
+    TEST_ASSERT_EQ(1, nvdaal_command_buffer_record(cb, &copy, 1));
+    TEST_ASSERT(nvdaal_command_buffer_end(cb));
+
+    // Upload, run, wait and read back: one crossing
+    uint8_t in[256], out[256];
+    for (int i = 0; i < 256; i++) in[i] = (uint8_t)(255 - i);
+    memset(out, 0, sizeof(out));
+    nvdaal_event event;
+    nvdaal_call calls[5];
+    memset(calls, 0, sizeof(calls));
+    calls[0].op = NVDAAL_CALL_WRITE;
+    calls[0].buffer = src;
+    calls[0].host = in;
+    calls[0].bytes = sizeof(in);
+    calls[1].op = NVDAAL_CALL_SUBMIT;
+    calls[1].stream = stream;
+    calls[1].command_buffer = cb;
+    calls[2].op = NVDAAL_CALL_RECORD;
+    calls[2].stream = stream;
+    calls[2].event = &event;
+    calls[3].op = NVDAAL_CALL_EVENT_SYNCHRONIZE;
+    calls[3].event = &event;
+    calls[4].op = NVDAAL_CALL_READ;
+    calls[4].buffer = dst;
+    calls[4].host = out;
+    calls[4].bytes = sizeof(out);
+    TEST_ASSERT_EQ(5, nvdaal_execute(calls, 5, 0));
+    for (int i = 0; i < 5; i++) TEST_ASSERT_EQ(NVDAAL_STATUS_OK, calls[i].status);
+    TEST_ASSERT_EQ(0, memcmp(in, out, sizeof(in)));
+
+    // Errors are per call; with STOP_ON_ERROR the rest are skipped
+    calls[0].offset = 4000;                                            // 4000 + 256 > 4096
+    calls[1].op = 99;
+    TEST_ASSERT_EQ(3, nvdaal_execute(calls, 5, 0));
+    TEST_ASSERT_EQ(NVDAAL_STATUS_FAILED, calls[0].status);
+    TEST_ASSERT_EQ(NVDAAL_STATUS_INVALID, calls[1].status);
+    TEST_ASSERT_EQ(NVDAAL_STATUS_OK, calls[4].status);
+    TEST_ASSERT_EQ(0, nvdaal_execute(calls, 5, NVDAAL_EXECUTE_STOP_ON_ERROR));
+    TEST_ASSERT_EQ(NVDAAL_STATUS_FAILED, calls[0].status);
+    for (int i = 1; i < 5; i++) TEST_ASSERT_EQ(NVDAAL_STATUS_SKIPPED, calls[i].status);
+
+    nvdaal_command_buffer_destroy(cb);
+    nvdaal_stream_destroy(stream);
+    nvdaal_buffer_free(src);
+    nvdaal_buffer_free(dst);
+    nvdaal_context_destroy(context);
+}
+
+// ============================================================================
+// DLPack Tensors
+// ============================================================================
+
+void test_dlpack(void) {
+    nvdaal_context_t context = nvdaal_context_create(NVDAAL_BACKEND_SIM);
+    nvdaal_buffer_t src = nvdaal_buffer_alloc(context, 4096);
+    nvdaal_buffer_t dst = nvdaal_buffer_alloc(context, 4096);
+    nvdaal_stream_t stream = nvdaal_stream_create(context, NVDAAL_ANY_CHANNEL);
+    nvdaal_command_buffer_t cb = nvdaal_command_buffer_create(context, 0);
+    DLDataType u8 = { kDLUInt, 8, 1 };
+    int64_t shape[2] = { 16, 128 };
+
+    // Host view of src: fill it in place
+    DLManagedTensor *host = nvdaal_buffer_to_dlpack(src, 2, shape, NULL, u8, 2048, NVDAAL_DLPACK_CPU);
+    TEST_ASSERT(host != NULL);
+    TEST_ASSERT(host->dl_tensor.data == nvdaal_buffer_cpu(src));
+    TEST_ASSERT_EQ(kDLCPU, host->dl_tensor.device.device_type);
+    TEST_ASSERT_EQ(128, host->dl_tensor.strides[0]);
+    uint8_t *bytes = (uint8_t *)host->dl_tensor.data + host->dl_tensor.byte_offset;
+    for (int i = 0; i < 2048; i++) bytes[i] = (uint8_t)(i ^ 0x5A);
+    host->deleter(host);
+
+    // Device view of dst, freed before the tensor is done with
+    DLManagedTensor *device = nvdaal_buffer_to_dlpack(dst, 2, shape, NULL, u8, 0, NVDAAL_DLPACK_GPU);
+    TEST_ASSERT(device != NULL);
+    TEST_ASSERT_EQ(kDLExtDev, device->dl_tensor.device.device_type);
+    TEST_ASSERT_EQ(nvdaal_buffer_gpu_addr(dst), (uint64_t)(uintptr_t)device->dl_tensor.data);
+    const uint8_t *mapped = (const uint8_t *)nvdaal_buffer_cpu(dst);
+    nvdaal_buffer_free(dst);
+
+    nvdaal_tensor_t tensor = nvdaal_tensor_from_dlpack(context, device);
+    TEST_ASSERT(tensor != NULL);
+    TEST_ASSERT(nvdaal_tensor_dl(tensor) == &device->dl_tensor);
+    TEST_ASSERT_EQ(2048, nvdaal_tensor_bytes(tensor));
+
+    nvdaal_command copy;
+    memset(&copy, 0, sizeof(copy));
+    copy.op = NVDAAL_CMD_COPY;
+    copy.dst_offset = nvdaal_tensor_gpu_addr(tensor);                  // By VA
+    copy.src = src;
+    copy.src_offset = 2048;
+    copy.bytes = nvdaal_tensor_bytes(tensor);
+    TEST_ASSERT_EQ(1, nvdaal_command_buffer_record(cb, &copy, 1));
+    TEST_ASSERT(nvdaal_command_buffer_use_tensor(cb, tensor));
+    TEST_ASSERT(nvdaal_command_buffer_end(cb));
+    TEST_ASSERT(nvdaal_stream_submit(stream, cb));
+    TEST_ASSERT(nvdaal_stream_synchronize(stream, 1000));
+    uint8_t expected[2048];
+    for (int i = 0; i < 2048; i++) expected[i] = (uint8_t)(i ^ 0x5A);
+    TEST_ASSERT_EQ(0, memcmp(expected, mapped, sizeof(expected)));
+
+    // Host views import too, by BAR1 address
+    DLManagedTensor *check = nvdaal_buffer_to_dlpack(src, 0, NULL, NULL, u8, 0, NVDAAL_DLPACK_CPU);
+    TEST_ASSERT(check != NULL);
+    nvdaal_tensor_t back = nvdaal_tensor_from_dlpack(context, check);
+    TEST_ASSERT(back != NULL);
+    TEST_ASSERT(nvdaal_tensor_gpu_addr(back) == nvdaal_buffer_gpu_addr(src));
+    nvdaal_tensor_destroy(back);
+
+    // Not NVDAAL memory: refused, and the tensor is still the caller's
+    uint8_t local[64];
+    int64_t n = 64;
+    DLManagedTensor foreign;
+    memset(&foreign, 0, sizeof(foreign));
+    foreign.dl_tensor.data = local;
+    foreign.dl_tensor.device.device_type = kDLCPU;
+    foreign.dl_tensor.ndim = 1;
+    foreign.dl_tensor.dtype = u8;
+    foreign.dl_tensor.shape = &n;
+    TEST_ASSERT_EQ(0, nvdaal_tensor_from_dlpack(context, &foreign));
+    TEST_ASSERT_EQ(0, nvdaal_buffer_to_dlpack(src, 1, &n, NULL, u8, 4090, NVDAAL_DLPACK_GPU));
+    TEST_ASSERT_EQ(0, nvdaal_buffer_to_dlpack(src, 1, &n, NULL, u8, 0, 7));
+    TEST_ASSERT(!nvdaal_command_buffer_use_tensor(cb, NULL));
+
+    nvdaal_tensor_destroy(tensor);                                     // Runs the deleter
+    nvdaal_command_buffer_destroy(cb);                                 // Drops the last pin on dst
+    nvdaal_stream_destroy(stream);
+    nvdaal_buffer_free(src);
+    nvdaal_context_destroy(context);
+}
+
+TEST_MAIN("libNVDAAL C API Tests",
+    TEST_CASE(test_null_handles),
+    TEST_CASE(test_firmware_from_memory),
+    TEST_CASE(test_buffers),
+    TEST_CASE(test_record_and_submit),
+    TEST_CASE(test_events),
+    TEST_CASE(test_execute),
+    TEST_CASE(test_dlpack)
+)
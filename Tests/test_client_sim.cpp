@@ -0,0 +1,316 @@
+/**
+ * @file test_client_sim.cpp
+ * @brief libNVDAAL against the in-process simulator backend
+ *
+ * Drives nvdaal::Client end to end through SimBackend: VRAM allocation and
+ * CPU mappings, coalesced submissions, timeline semaphores, the command
+ * ring, batches, notifications and call statistics.
+ *
+ * Compile: make test-client-sim
+ * Run: ./Build/test_client_sim
+ */
+
+#include "nvdaal_sim_test.h"
+#include "libNVDAAL.h"
+#include "NVDAALUserShared.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace nvdaal;
+
+// ============================================================================
+// Memory
+// ============================================================================
+
+void test_sim_connect(void) {
+    Client client(makeSimBackend());
+    TEST_ASSERT(client.connect());
+    TEST_ASSERT(client.isConnected());
+    TEST_ASSERT_STR_EQ("sim", client.getBackend()->name());
+
+    GpuStatus status;
+    TEST_ASSERT(client.getStatus(&status));
+    TEST_ASSERT_EQ(0x192000a1, status.pmcBoot0);
+    TEST_ASSERT(!status.wpr2Enabled);
+    TEST_ASSERT(client.executeFwsec());
+    TEST_ASSERT(client.getStatus(&status));
+    TEST_ASSERT(status.wpr2Enabled);
+
+    client.disconnect();
+    TEST_ASSERT(!client.isConnected());
+}
+
+void test_sim_vram(void) {
+    SimConfig config;
+    config.vramBytes = 1 << 20;
+    Client client(makeSimBackend(config));
+
+    uint64_t a = client.allocVram(100);
+    uint64_t b = client.allocVram(8192);
+    TEST_ASSERT_NEQ(0, a);
+    TEST_ASSERT_EQ(0, a % 4096);
+    TEST_ASSERT_EQ(a + 4096, b);
+    TEST_ASSERT_EQ(0, client.allocVram(2 << 20));
+
+    size_t size = 0;
+    uint8_t *p = (uint8_t *)client.mapVramCpu(b, CacheMode::WriteCombined, &size);
+    TEST_ASSERT_NOT_NULL(p);
+    TEST_ASSERT_EQ(8192, size);
+    memset(p, 0xA5, size);
+
+    // A second mapping aliases the same fake VRAM
+    uint8_t *q = (uint8_t *)client.mapVramCpu(b, CacheMode::Uncached);
+    TEST_ASSERT_EQ(0xA5, q[8191]);
+    TEST_ASSERT(client.unmapVramCpu(b, q));
+    TEST_ASSERT(client.unmapVramCpu(b, p));
+
+    TEST_ASSERT_NULL(client.mapVramCpu(b + 4096));      // Not the start of an allocation
+    TEST_ASSERT_EQ(12288, sim(client)->counters().vramUsed);
+}
+
+void test_sim_vram_map_budget(void) {
+    Client client(makeSimBackend());
+    uint64_t offset = client.allocVram(4096);
+    uint64_t gpuAddr = 0;
+
+    Batch batch;
+    for (uint32_t mapped = 0; mapped < NVDAAL_MAX_VRAM_MAPPINGS; mapped += NVDAAL_MAX_BATCH_OPS) {
+        batch.clear();
+        for (uint32_t i = 0; i < NVDAAL_MAX_BATCH_OPS; i++) batch.mapVram(offset, 4096);
+        TEST_ASSERT(client.execute(batch));
+        gpuAddr = batch.result(0).values[0];
+    }
+
+    // Unmapping does not give VA back, so the budget stays spent
+    batch.clear();
+    uint32_t unmap = batch.add(Op::unmapVram(gpuAddr, 4096));
+    uint32_t map = batch.mapVram(offset, 4096);
+    TEST_ASSERT(!client.execute(batch));
+    TEST_ASSERT(batch.result(unmap).ok());
+    TEST_ASSERT_EQ(kStatusNoResources, batch.result(map).status);
+}
+
+// ============================================================================
+// Channel
+// ============================================================================
+
+void test_sim_coalesced_submissions(void) {
+    Client client(makeSimBackend());
+    SubmitPolicy policy;
+    policy.maxEntries = 8;
+    TEST_ASSERT(client.setSubmitPolicy(policy));
+
+    for (int i = 0; i < 20; i++) TEST_ASSERT(client.submitCommand(i));
+    SimCounters c = sim(client)->counters();
+    TEST_ASSERT_EQ(20, c.submissions);
+    TEST_ASSERT_EQ(2, c.doorbells);
+    TEST_ASSERT_EQ(16, c.completed);
+
+    TEST_ASSERT(client.flushSubmissions());
+    c = sim(client)->counters();
+    TEST_ASSERT_EQ(3, c.doorbells);
+    TEST_ASSERT_EQ(20, c.completed);
+}
+
+void test_sim_deadline_flush(void) {
+    SimConfig config;
+    config.submitLatencyUs = 100;
+    Client client(makeSimBackend(config));
+    SubmitPolicy policy;
+    policy.maxEntries = 64;
+    policy.deadlineUs = 200;
+    TEST_ASSERT(client.setSubmitPolicy(policy));
+
+    TEST_ASSERT(client.submitCommand(1));
+    TEST_ASSERT(client.submitCommand(2));
+    TEST_ASSERT_EQ(0, sim(client)->counters().doorbells);
+
+    // The worker rings the doorbell at the deadline, then the channel completes both
+    for (int i = 0; i < 200 && sim(client)->counters().completed < 2; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    SimCounters c = sim(client)->counters();
+    TEST_ASSERT_EQ(1, c.doorbells);
+    TEST_ASSERT_EQ(2, c.completed);
+}
+
+// ============================================================================
+// Semaphores
+// ============================================================================
+
+void test_sim_semaphores(void) {
+    Client client(makeSimBackend());
+    Semaphore a, b;
+    TEST_ASSERT(client.createSemaphore(&a, 5));
+    TEST_ASSERT(client.createSemaphore(&b));
+    TEST_ASSERT_NEQ(a.gpuAddr, b.gpuAddr);
+
+    uint64_t value = 0;
+    TEST_ASSERT(client.readSemaphore(a, &value));
+    TEST_ASSERT_EQ(5, value);
+
+    // Payloads only move forward
+    TEST_ASSERT(client.signalSemaphore(a, 3));
+    TEST_ASSERT(client.readSemaphore(a, &value));
+    TEST_ASSERT_EQ(5, value);
+
+    TEST_ASSERT(client.waitSemaphore(a, 5, 0));
+    TEST_ASSERT(!client.waitSemaphore(b, 1, 5));        // Times out
+
+    Semaphore sems[2] = { a, b };
+    uint64_t values[2] = { 10, 0 };
+    uint32_t index = 99;
+    TEST_ASSERT(client.waitSemaphores(sems, values, 2, WaitMode::Any, 10, &index));
+    TEST_ASSERT_EQ(1, index);
+    TEST_ASSERT(!client.waitSemaphores(sems, values, 2, WaitMode::All, 5));
+
+    TEST_ASSERT(client.destroySemaphore(a));
+    TEST_ASSERT(!client.readSemaphore(a, &value));
+    TEST_ASSERT(client.destroySemaphore(b));
+}
+
+void test_sim_semaphore_cross_thread(void) {
+    Client client(makeSimBackend());
+    Semaphore sem;
+    TEST_ASSERT(client.createSemaphore(&sem));
+
+    std::thread signaler([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        client.signalSemaphore(sem, 7);
+    });
+    bool ok = client.waitSemaphore(sem, 7, 1000);
+    bool okVa = client.waitSemaphore(sem.gpuAddr, 7, 0);
+    signaler.join();
+    TEST_ASSERT(ok);
+    TEST_ASSERT(okVa);
+}
+
+// ============================================================================
+// Command Ring and Batches
+// ============================================================================
+
+void test_sim_command_ring(void) {
+    Client client(makeSimBackend());
+    TEST_ASSERT(client.openCommandRing());
+
+    const uint32_t kOps = 3000;                          // Spans several kicks
+    std::vector<Op> ops;
+    for (uint32_t i = 0; i < kOps; i++) ops.push_back(Op::query(Query::ChipId, i));
+    std::vector<OpResult> results(kOps);
+    TEST_ASSERT(client.execute(ops.data(), kOps, results.data()));
+    TEST_ASSERT_EQ(kOps - 1, results[kOps - 1].cookie);
+    TEST_ASSERT_EQ(0x192000a1, results[kOps - 1].values[0]);
+
+    SimCounters c = sim(client)->counters();
+    TEST_ASSERT_EQ(kOps, c.ops);
+    TEST_ASSERT(c.calls <= 4);
+    client.closeCommandRing();
+}
+
+void test_sim_command_ring_full(void) {
+    Client client(makeSimBackend());
+    TEST_ASSERT(client.openCommandRing());
+
+    // A full ring refuses more; unknown ops fail alone in the driver's drain
+    Op bad;
+    bad.code = (OpCode)0xDEAD;
+    uint32_t queued = 0;
+    while (client.enqueue(queued % 100 == 7 ? bad : Op::query(Query::ChipId, queued))) queued++;
+    TEST_ASSERT_EQ(NVDAAL_RING_REQUEST_SLOTS, queued);
+    TEST_ASSERT_EQ(queued, client.kick());
+
+    std::vector<OpResult> results(queued);
+    TEST_ASSERT_EQ(queued, client.reap(results.data(), queued));
+    for (uint32_t i = 0; i < queued; i++) {
+        TEST_ASSERT_EQ(i % 100 == 7 ? kStatusUnsupported : kStatusSuccess, results[i].status);
+    }
+    TEST_ASSERT(client.enqueue(Op::query(Query::ChipId)));
+    client.closeCommandRing();
+}
+
+void test_sim_batch(void) {
+    Client client(makeSimBackend());
+    Batch batch;
+    uint32_t alloc = batch.allocVram(4096);
+    batch.add(Op::readSemaphore(Semaphore{ 12345, 0 }));
+    uint32_t query = batch.query(Query::ChipId);
+
+    TEST_ASSERT(!client.execute(batch));
+    TEST_ASSERT(batch.result(alloc).ok());
+    TEST_ASSERT_NEQ(0, batch.result(alloc).values[0]);
+    TEST_ASSERT_EQ(kStatusNotFound, batch.result(1).status);
+    TEST_ASSERT(batch.result(query).ok());
+
+    TEST_ASSERT(!client.execute(batch, true));
+    TEST_ASSERT_EQ(kStatusAborted, batch.result(query).status);
+    TEST_ASSERT_EQ(2, sim(client)->counters().calls);
+}
+
+// ============================================================================
+// Notifications and Statistics
+// ============================================================================
+
+void test_sim_notifications(void) {
+    Client client(makeSimBackend());
+    Semaphore sem;
+    TEST_ASSERT(client.createSemaphore(&sem));
+
+    std::atomic<uint64_t> seen(0);
+    std::atomic<int> errors(0);
+    TEST_ASSERT_NEQ(0, client.notifyOnSemaphore(sem, 3, [&](const Notification& n) { seen = n.values[0]; }));
+    TEST_ASSERT_NEQ(0, client.notifyOnChannelError([&](const Notification&) { errors++; }));
+
+    TEST_ASSERT(client.signalSemaphore(sem, 4));
+    sim(client)->injectEvent(NVDAAL_NOTIFY_CHANNEL_ERROR, 0x100, 0);
+    for (int i = 0; i < 500 && (seen == 0 || errors == 0); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    TEST_ASSERT_EQ(4, seen.load());
+    TEST_ASSERT_EQ(1, errors.load());
+}
+
+void test_sim_stats(void) {
+    Client client(makeSimBackend());
+    for (int i = 0; i < 10; i++) client.submitCommand(i);
+    client.allocVram(0x100000000ULL);                    // Fails: larger than fake VRAM
+
+    CallStats stats;
+    TEST_ASSERT(client.getStats(&stats));
+    TEST_ASSERT(stats.methods.size() >= 21);
+    TEST_ASSERT_STR_EQ("SubmitCommand", stats.methods[2].name);
+    TEST_ASSERT_EQ(10, stats.methods[2].calls);
+    TEST_ASSERT_EQ(1, stats.methods[1].errors);
+
+    TEST_ASSERT(client.getStats(&stats, StatsScope::Client, true));
+    TEST_ASSERT(client.getStats(&stats));
+    TEST_ASSERT_EQ(0, stats.methods[2].calls);
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+TEST_MAIN("libNVDAAL Simulator Backend Tests",
+    // Memory
+    TEST_CASE(test_sim_connect),
+    TEST_CASE(test_sim_vram),
+    TEST_CASE(test_sim_vram_map_budget),
+
+    // Channel
+    TEST_CASE(test_sim_coalesced_submissions),
+    TEST_CASE(test_sim_deadline_flush),
+
+    // Semaphores
+    TEST_CASE(test_sim_semaphores),
+    TEST_CASE(test_sim_semaphore_cross_thread),
+
+    // Command ring and batches
+    TEST_CASE(test_sim_command_ring),
+    TEST_CASE(test_sim_command_ring_full),
+    TEST_CASE(test_sim_batch),
+
+    // Notifications and statistics
+    TEST_CASE(test_sim_notifications),
+    TEST_CASE(test_sim_stats)
+)
@@ -0,0 +1,437 @@
+/**
+ * @file test_command_buffer_sim.cpp
+ * @brief Command buffer recording, submission and pushbuffer execution
+ *
+ * Records CommandBuffers against SimBackend, which interprets the uploaded
+ * pushbuffers: semaphore acquires and releases, copies in fake VRAM and
+ * counted compute launches. Also covers 2D copies, fills and copy-engine
+ * releases on a copy channel, buffer pinning, reuse without allocation
+ * and channel errors.
+ *
+ * Compile: make test-command-buffer-sim
+ * Run: ./Build/test_command_buffer_sim
+ */
+
+#include "nvdaal_sim_test.h"
+#include "NVDAALCommandBuffer.h"
+#include "NVDAALPushbuffer.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace nvdaal;
+
+// ============================================================================
+// Recording
+// ============================================================================
+
+void test_cb_encoding(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    Semaphore sem;
+    TEST_ASSERT(client.createSemaphore(&sem));
+
+    CommandBuffer cb(allocator);
+    TEST_ASSERT(cb.dispatch(0x200010000ULL));
+    TEST_ASSERT(cb.barrier());
+    TEST_ASSERT(cb.signal(sem, 7));
+    TEST_ASSERT_EQ(3, cb.commands());
+    TEST_ASSERT_EQ((NV_PB_DISPATCH_DWORDS + NV_PB_BARRIER_DWORDS + NV_PB_SEMAPHORE_RELEASE_DWORDS) * 4,
+                   cb.sizeBytes());
+
+    // Same words the kernel-side encoders produce
+    uint32_t expected[16];
+    NvPushbuffer pb;
+    nvPbInit(&pb, expected, sizeof(expected));
+    nvPbPushDispatch(&pb, 0x200010000ULL);
+    nvPbPushBarrier(&pb);
+    nvPbPushSemaphoreRelease(&pb, sem.gpuAddr, 7, true);
+    TEST_ASSERT_EQ(0, memcmp(expected, cb.data(), cb.sizeBytes()));
+
+    TEST_ASSERT(!cb.ready());
+    TEST_ASSERT_EQ(0, cb.gpuAddr());
+    TEST_ASSERT(cb.end());
+    TEST_ASSERT(cb.ready());
+    TEST_ASSERT_NEQ(0, cb.gpuAddr());
+}
+
+void test_cb_invalid(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    CommandBuffer cb(allocator);
+
+    TEST_ASSERT(!client.submit(cb));                     // Never ended
+    TEST_ASSERT(!cb.end());                              // Empty
+
+    cb.begin();
+    TEST_ASSERT(cb.barrier());
+    TEST_ASSERT(!cb.dispatch(0x200000080ULL));           // QMD not 256-byte aligned
+    TEST_ASSERT(!cb.barrier());                          // Recording stays failed
+    TEST_ASSERT(!cb.end());
+
+    Buffer small = allocator.allocate(64);
+    cb.begin();
+    TEST_ASSERT(!cb.copy(small, 0, small, 32, 64));      // Out of bounds
+    TEST_ASSERT(!cb.end());
+
+    Semaphore none = { 0, 0 };
+    cb.begin();
+    TEST_ASSERT(!cb.signal(none, 1));
+
+    cb.begin();                                          // begin() recovers
+    TEST_ASSERT(cb.barrier());
+    TEST_ASSERT(cb.end());
+}
+
+void test_cb_copy_split(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    CommandBuffer cb(allocator);
+
+    TEST_ASSERT(cb.copy(0x300000000ULL, 0x400000000ULL, (3ULL << 31) + 5));
+    TEST_ASSERT_EQ(4, cb.commands());                    // 2 GiB chunks
+    TEST_ASSERT_EQ(4 * NV_PB_COPY_DWORDS * 4, cb.sizeBytes());
+    TEST_ASSERT_EQ(5, cb.data()[3 * NV_PB_COPY_DWORDS + 7]);  // Last LINE_LENGTH_IN
+}
+
+void test_cb_fields(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    Semaphore sem;
+    TEST_ASSERT(client.createSemaphore(&sem));
+    CommandBuffer cb(allocator);
+
+    // Patching a recording matches recording the new value
+    uint32_t words[16];
+    uint32_t expected[16];
+    NvPushbuffer pb;
+
+    TEST_ASSERT(cb.copy(0x300000000ULL, 0x400000000ULL, 64));
+    memcpy(words, cb.data(), cb.sizeBytes());
+    patch(words, cb.field(Field::CopyDst), 0x312345600ULL);
+    patch(words, cb.field(Field::CopySrc), 0x4ABCDEF00ULL);
+    patch(words, cb.field(Field::CopyBytes), 4096);
+    nvPbInit(&pb, expected, sizeof(expected));
+    nvPbPushCopy(&pb, 0x312345600ULL, 0x4ABCDEF00ULL, 4096);
+    TEST_ASSERT_EQ(0, memcmp(expected, words, NV_PB_COPY_DWORDS * 4));
+    TEST_ASSERT(!cb.field(Field::SemaphoreValue).valid());
+
+    cb.begin();
+    TEST_ASSERT(cb.wait(sem, 1));
+    memcpy(words, cb.data(), cb.sizeBytes());
+    patch(words, cb.field(Field::SemaphoreValue), 0x100000002ULL);
+    nvPbInit(&pb, expected, sizeof(expected));
+    nvPbPushSemaphoreAcquire(&pb, sem.gpuAddr, 0x100000002ULL);
+    TEST_ASSERT_EQ(0, memcmp(expected, words, NV_PB_SEMAPHORE_ACQUIRE_DWORDS * 4));
+
+    cb.begin();
+    TEST_ASSERT(cb.dispatch(0x200000100ULL));
+    memcpy(words, cb.data(), cb.sizeBytes());
+    patch(words, cb.field(Field::DispatchQmd), 0x200000400ULL);
+    nvPbInit(&pb, expected, sizeof(expected));
+    nvPbPushDispatch(&pb, 0x200000400ULL);
+    TEST_ASSERT_EQ(0, memcmp(expected, words, NV_PB_DISPATCH_DWORDS * 4));
+
+    // A split copy has no single field to patch
+    cb.begin();
+    TEST_ASSERT(cb.copy(0x300000000ULL, 0x400000000ULL, 3ULL << 31));
+    TEST_ASSERT(!cb.field(Field::CopySrc).valid());
+}
+
+// ============================================================================
+// Execution
+// ============================================================================
+
+void test_cb_copy_executes(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    Semaphore sem;
+    TEST_ASSERT(client.createSemaphore(&sem));
+
+    Buffer src = allocator.allocate(4096);
+    Buffer dst = allocator.allocate(4096);
+    memset(src.cpu(), 0xA5, 4096);
+    memset(dst.cpu(), 0, 4096);
+
+    CommandBuffer cb(allocator);
+    TEST_ASSERT(cb.copy(dst, 1024, src, 0, 2048));
+    TEST_ASSERT(cb.signal(sem, 1));
+    TEST_ASSERT(cb.end());
+    TEST_ASSERT_EQ(2, cb.pinned());
+
+    TEST_ASSERT(client.submit(cb));
+    TEST_ASSERT(client.waitSemaphore(sem, 1, 1000));
+
+    uint8_t *d = (uint8_t *)dst.cpu();
+    TEST_ASSERT_EQ(0, d[1023]);
+    TEST_ASSERT_EQ(0xA5, d[1024]);
+    TEST_ASSERT_EQ(0xA5, d[3071]);
+    TEST_ASSERT_EQ(0, d[3072]);
+    TEST_ASSERT_EQ(2048, sim(client)->counters().copiedBytes);
+}
+
+void test_cb_resubmit(void) {
+    SimConfig config;
+    config.submitLatencyUs = 20;
+    Client client(makeSimBackend(config));
+    BufferAllocator allocator(client);
+    Semaphore timeline;
+    TEST_ASSERT(client.createSemaphore(&timeline));
+
+    Buffer qmd = allocator.allocate(256);
+    CommandBuffer cb(allocator);
+    TEST_ASSERT(cb.dispatch(qmd));
+    TEST_ASSERT(cb.barrier());
+    TEST_ASSERT(cb.dispatch(qmd));
+    TEST_ASSERT(cb.end());
+
+    // The recording runs as often as it is submitted; the signal comes
+    // from the submission, not the recording
+    for (uint64_t i = 1; i <= 50; i++) {
+        TEST_ASSERT(client.submit(cb, timeline, i));
+    }
+    TEST_ASSERT(client.waitSemaphore(timeline, 50, 2000));
+    SimCounters c = sim(client)->counters();
+    TEST_ASSERT_EQ(100, c.dispatches);
+    TEST_ASSERT_EQ(50, c.completed);
+    TEST_ASSERT_EQ(0, c.faults);
+}
+
+void test_cb_wait_stalls_channel(void) {
+    SimConfig config;
+    config.submitLatencyUs = 10;
+    Client client(makeSimBackend(config));
+    BufferAllocator allocator(client);
+    Semaphore gate, done;
+    TEST_ASSERT(client.createSemaphore(&gate));
+    TEST_ASSERT(client.createSemaphore(&done));
+
+    CommandBuffer first(allocator);
+    TEST_ASSERT(first.wait(gate, 1));
+    TEST_ASSERT(first.signal(done, 1));
+    TEST_ASSERT(first.end());
+
+    CommandBuffer second(allocator);
+    TEST_ASSERT(second.signal(done, 2));
+    TEST_ASSERT(second.end());
+
+    TEST_ASSERT(client.submit(first));
+    TEST_ASSERT(client.submit(second));
+
+    // Neither runs past the acquire, in order
+    TEST_ASSERT(!client.waitSemaphore(done, 1, 30));
+    uint64_t value = 99;
+    TEST_ASSERT(client.readSemaphore(done, &value));
+    TEST_ASSERT_EQ(0, value);
+
+    TEST_ASSERT(client.signalSemaphore(gate, 1));
+    TEST_ASSERT(client.waitSemaphore(done, 2, 1000));
+    TEST_ASSERT_EQ(2, sim(client)->counters().completed);
+}
+
+void test_cb_vram_semaphore(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    Buffer payload = allocator.allocate(64);
+    memset(payload.cpu(), 0, 64);
+
+    // A release to plain VRAM lands where the CPU can read it
+    Semaphore mem = { 0, payload.gpuAddr() };
+    CommandBuffer cb(allocator);
+    TEST_ASSERT(cb.use(payload));
+    TEST_ASSERT(cb.signal(mem, 0x1122334455667788ULL, false));
+    TEST_ASSERT(cb.end());
+    TEST_ASSERT(client.submit(cb));
+
+    uint64_t value = 0;
+    memcpy(&value, payload.cpu(), 8);
+    TEST_ASSERT_EQ(0x1122334455667788ULL, value);
+}
+
+void test_cb_channel_error(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    std::atomic<uint64_t> faultVa(0);
+    TEST_ASSERT_NEQ(0, client.notifyOnChannelError([&](const Notification& n) { faultVa = n.values[0]; }));
+
+    CommandBuffer cb(allocator);
+    TEST_ASSERT(cb.barrier());
+    TEST_ASSERT(cb.copy(0x7000000000ULL, 0x7000001000ULL, 64));     // Never mapped
+    TEST_ASSERT(cb.end());
+    TEST_ASSERT(client.submit(cb));
+
+    for (int i = 0; i < 100 && !faultVa; i++) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    TEST_ASSERT_EQ(cb.gpuAddr() + (NV_PB_BARRIER_DWORDS + NV_PB_COPY_DWORDS - 1) * 4, faultVa.load());  // LAUNCH_DMA
+    TEST_ASSERT_EQ(1, sim(client)->counters().faults);
+
+    // Pushbuffers must come from this client's mappings
+    TEST_ASSERT(!client.submitPushbuffer(0x7000000000ULL, 64));
+    TEST_ASSERT(!client.submitPushbuffer(cb.gpuAddr() + 2, 64));
+}
+
+// ============================================================================
+// Copy Engine
+// ============================================================================
+
+void test_cb_copy_2d_and_fill(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    Semaphore sem;
+    TEST_ASSERT(client.createSemaphore(&sem));
+    TEST_ASSERT_EQ(1, client.getCopyChannelCount());
+
+    Buffer src = allocator.allocate(4096);
+    Buffer dst = allocator.allocate(4096);
+    uint8_t *s = (uint8_t *)src.cpu();
+    for (int i = 0; i < 4096; i++) s[i] = (uint8_t)i;
+    memset(dst.cpu(), 0, 4096);
+
+    // Zero the destination's first KB, then gather a 16x4 tile out of rows
+    // 256 bytes apart into rows 32 apart
+    CommandBuffer cb(allocator);
+    TEST_ASSERT(cb.fill(dst, 0, 0xCAFEF00D, 1024));
+    TEST_ASSERT(cb.copy2D(dst, 0, 32, src, 8, 256, 16, 4));
+    TEST_ASSERT(cb.signalCopies(sem, 1));
+    TEST_ASSERT_EQ(3, cb.commands());
+    TEST_ASSERT_EQ((NV_PB_FILL_DWORDS + NV_PB_COPY_DWORDS + NV_PB_COPY_RELEASE_DWORDS) * 4, cb.sizeBytes());
+    TEST_ASSERT(!cb.field(Field::CopyDst).valid());      // Nothing to patch after signalCopies()
+    TEST_ASSERT(cb.end());
+    TEST_ASSERT_EQ(2, cb.pinned());
+
+    TEST_ASSERT(client.submitPushbuffer(cb.gpuAddr(), cb.sizeBytes(), kCopyChannel));
+    TEST_ASSERT(client.waitSemaphore(sem, 1, 1000));
+
+    uint8_t *d = (uint8_t *)dst.cpu();
+    for (int row = 0; row < 4; row++) {
+        TEST_ASSERT_EQ(0, memcmp(d + row * 32, s + 8 + row * 256, 16));
+        uint32_t word;
+        memcpy(&word, d + row * 32 + 16, 4);                 // Between the rows: the fill
+        TEST_ASSERT_EQ(0xCAFEF00Du, word);
+    }
+    uint32_t last;
+    memcpy(&last, d + 1020, 4);
+    TEST_ASSERT_EQ(0xCAFEF00Du, last);
+    TEST_ASSERT_EQ(0, d[1024]);
+
+    SimCounters c = sim(client)->counters();
+    TEST_ASSERT_EQ(64, c.copiedBytes);
+    TEST_ASSERT_EQ(1024, c.filledBytes);
+    TEST_ASSERT_EQ(0, c.faults);
+
+    // Rejected shapes record nothing
+    TEST_ASSERT(!cb.fill(dst, 2, 0, 64));                // Misaligned
+    TEST_ASSERT(!cb.fill(dst, 0, 0, 6));
+    TEST_ASSERT(!cb.copy2D(dst, 0, 8, src, 0, 256, 16, 2));  // Rows overlap
+    TEST_ASSERT(!cb.copy2D(dst, 0, 32, src, 0, 256, 16, 64)); // Past the end of src
+}
+
+void test_cb_copy_channel_rejects_compute(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    std::atomic<uint64_t> faultVa(0);
+    TEST_ASSERT_NEQ(0, client.notifyOnChannelError([&](const Notification& n) { faultVa = n.values[0]; }));
+
+    // The copy engine has no compute class: a dispatch faults its channel
+    Buffer qmd = allocator.allocate(256);
+    CommandBuffer cb(allocator);
+    TEST_ASSERT(cb.dispatch(qmd));
+    TEST_ASSERT(cb.end());
+    TEST_ASSERT(client.submitPushbuffer(cb.gpuAddr(), cb.sizeBytes(), kCopyChannel));
+
+    for (int i = 0; i < 100 && !faultVa; i++) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    TEST_ASSERT_EQ(cb.gpuAddr(), faultVa.load());
+    TEST_ASSERT_EQ(1, sim(client)->counters().faults);
+    TEST_ASSERT_EQ(0, sim(client)->counters().dispatches);
+
+    // Only booted copy channels exist
+    TEST_ASSERT(!client.submitPushbuffer(cb.gpuAddr(), cb.sizeBytes(), kCopyChannel | 1));
+}
+
+// ============================================================================
+// Lifetime and Reuse
+// ============================================================================
+
+void test_cb_pins_buffers(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    CommandBuffer cb(allocator);
+
+    Buffer a = allocator.allocate(4096);
+    uint64_t offset = a.vramOffset();
+    TEST_ASSERT(cb.use(a));
+    TEST_ASSERT(cb.use(a));                              // Pinned once
+    TEST_ASSERT_EQ(1, cb.pinned());
+
+    // Released while recorded: the block stays out of the cache
+    a.reset();
+    TEST_ASSERT_EQ(0, allocator.stats().frees);
+    Buffer b = allocator.allocate(4096);
+    TEST_ASSERT_NEQ(offset, b.vramOffset());
+
+    cb.begin();                                          // Last pin frees it
+    TEST_ASSERT_EQ(1, allocator.stats().frees);
+    Buffer c = allocator.allocate(4096);
+    TEST_ASSERT_EQ(offset, c.vramOffset());
+}
+
+void test_cb_steady_state(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    Semaphore sem;
+    TEST_ASSERT(client.createSemaphore(&sem));
+    Buffer src = allocator.allocate(1 << 16);
+    Buffer dst = allocator.allocate(1 << 16);
+    CommandBuffer cb(allocator, 64);                     // Forced to grow once
+
+    const uint32_t *words = nullptr;
+    uint64_t gpuAddr = 0;
+    uint64_t allocations = 0;
+    for (uint64_t step = 1; step <= 10; step++) {
+        cb.begin();
+        for (int i = 0; i < 32; i++) {
+            TEST_ASSERT(cb.copy(dst, i * 2048, src, i * 2048, 2048));
+            TEST_ASSERT(cb.barrier());
+        }
+        TEST_ASSERT(cb.signal(sem, step));
+        TEST_ASSERT(cb.end());
+        TEST_ASSERT(client.submit(cb));
+        TEST_ASSERT(client.waitSemaphore(sem, step, 1000));
+
+        if (step == 1) {
+            words = cb.data();
+            gpuAddr = cb.gpuAddr();
+            allocations = allocator.stats().allocations;
+        }
+    }
+    // Later recordings reuse the host words and the VRAM copy
+    TEST_ASSERT_EQ(words, cb.data());
+    TEST_ASSERT_EQ(gpuAddr, cb.gpuAddr());
+    TEST_ASSERT_EQ(allocations, allocator.stats().allocations);
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+TEST_MAIN("libNVDAAL Command Buffer Tests",
+    // Recording
+    TEST_CASE(test_cb_encoding),
+    TEST_CASE(test_cb_invalid),
+    TEST_CASE(test_cb_copy_split),
+    TEST_CASE(test_cb_fields),
+
+    // Execution
+    TEST_CASE(test_cb_copy_executes),
+    TEST_CASE(test_cb_resubmit),
+    TEST_CASE(test_cb_wait_stalls_channel),
+    TEST_CASE(test_cb_vram_semaphore),
+    TEST_CASE(test_cb_channel_error),
+
+    // Copy engine
+    TEST_CASE(test_cb_copy_2d_and_fill),
+    TEST_CASE(test_cb_copy_channel_rejects_compute),
+
+    // Lifetime and reuse
+    TEST_CASE(test_cb_pins_buffers),
+    TEST_CASE(test_cb_steady_state)
+)
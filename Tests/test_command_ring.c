@@ -0,0 +1,257 @@
+/**
+ * @file test_command_ring.c
+ * @brief Unit tests for the shared-memory command ring
+ *
+ * Exercises the client-side helpers in NVDAALUserShared.h against the
+ * kernel consumer loop they share with NVDAALCommandRing::drain
+ * (nvRingDrain), with a stand-in for the op dispatch.
+ *
+ * Compile: make test-command-ring
+ * Run: ./Build/test_command_ring
+ */
+
+#include "nvdaal_test.h"
+#include "../Sources/NVDAALUserShared.h"
+#include <stddef.h>
+#include <stdlib.h>
+
+static NvdaalRingControl *ring_alloc(void) {
+    NvdaalRingControl *ring = (NvdaalRingControl *)calloc(1, NVDAAL_RING_SIZE);
+    nvRingInit(ring);
+    return ring;
+}
+
+#define TEST_STATUS_UNSUPPORTED ((int32_t)0xE00002C7)   // kIOReturnUnsupported
+
+// Op dispatch stand-in: echo args[0] + 1 for known ops, refuse the rest
+static int32_t echo_action(void *ctx, const NvdaalOpRequest *req, uint64_t result[2]) {
+    (*(uint32_t *)ctx)++;
+    if (req->op >= NVDAAL_OP_COUNT) return TEST_STATUS_UNSUPPORTED;
+    result[0] = req->args[0] + 1;
+    return 0;
+}
+
+// The kernel's drain state for one ring; drain() returns ~0u on corruption
+typedef struct {
+    uint32_t reqTail;
+    uint32_t cplHead;
+    uint32_t calls;
+} Consumer;
+
+static uint32_t drain(NvdaalRingControl *ring, Consumer *c, uint32_t budget) {
+    uint32_t done = 0;
+    if (!nvRingDrain(ring, &c->reqTail, &c->cplHead, budget, echo_action, &c->calls, &done)) return ~0u;
+    return done;
+}
+
+// ============================================================================
+// Layout
+// ============================================================================
+
+void test_ring_layout(void) {
+    TEST_ASSERT_EQ(48, sizeof(NvdaalOpRequest));
+    TEST_ASSERT_EQ(32, sizeof(NvdaalOpCompletion));
+    TEST_ASSERT_EQ(320, sizeof(NvdaalRingControl));
+    TEST_ASSERT_EQ(0, NVDAAL_RING_COMPLETION_OFFSET % 0x1000);
+    TEST_ASSERT_EQ(0, NVDAAL_RING_SIZE % 0x1000);
+
+    // Producer and consumer indices must not share a cache line
+    TEST_ASSERT_EQ(64, offsetof(NvdaalRingControl, reqTail) - offsetof(NvdaalRingControl, reqHead));
+    TEST_ASSERT_EQ(64, offsetof(NvdaalRingControl, cplTail) - offsetof(NvdaalRingControl, cplHead));
+}
+
+void test_batch_layout(void) {
+    TEST_ASSERT_EQ(16, sizeof(NvdaalBatchHeader));
+    TEST_ASSERT_EQ(16 + 48 * 3, NVDAAL_BATCH_INPUT_SIZE(3));
+    TEST_ASSERT_EQ(32 * 3, NVDAAL_BATCH_OUTPUT_SIZE(3));
+    TEST_ASSERT(NVDAAL_MAX_BATCH_OPS <= NVDAAL_RING_REQUEST_SLOTS);
+}
+
+void test_ring_init_valid(void) {
+    NvdaalRingControl *ring = ring_alloc();
+    TEST_ASSERT(nvRingValid(ring));
+    ring->version++;
+    TEST_ASSERT(!nvRingValid(ring));
+    free(ring);
+}
+
+// ============================================================================
+// Request / Completion Flow
+// ============================================================================
+
+void test_ring_round_trip(void) {
+    NvdaalRingControl *ring = ring_alloc();
+    Consumer c = { 0, 0, 0 };
+    NvdaalOpRequest req = { NVDAAL_OP_ALLOC_VRAM, 0, 0xC0FFEE, { 41, 0, 0, 0 } };
+    NvdaalOpCompletion cpl;
+
+    TEST_ASSERT(!nvRingPopCompletion(ring, &cpl));
+    TEST_ASSERT(nvRingPushRequest(ring, &req));
+    TEST_ASSERT_EQ(1, nvRingPendingRequests(ring));
+
+    TEST_ASSERT_EQ(1, drain(ring, &c, 16));
+    TEST_ASSERT_EQ(0, nvRingPendingRequests(ring));
+    TEST_ASSERT(nvRingPopCompletion(ring, &cpl));
+    TEST_ASSERT_EQ(0xC0FFEE, cpl.cookie);
+    TEST_ASSERT_EQ(NVDAAL_OP_ALLOC_VRAM, cpl.op);
+    TEST_ASSERT_EQ(42, cpl.result[0]);
+    TEST_ASSERT(!nvRingPopCompletion(ring, &cpl));
+    free(ring);
+}
+
+void test_ring_full(void) {
+    NvdaalRingControl *ring = ring_alloc();
+    Consumer c = { 0, 0, 0 };
+    NvdaalOpRequest req = { NVDAAL_OP_NOP, 0, 0, { 0, 0, 0, 0 } };
+
+    for (uint32_t i = 0; i < NVDAAL_RING_REQUEST_SLOTS; i++) {
+        TEST_ASSERT(nvRingPushRequest(ring, &req));
+    }
+    TEST_ASSERT(!nvRingPushRequest(ring, &req));
+
+    // Draining part of it frees exactly that many slots
+    TEST_ASSERT_EQ(3, drain(ring, &c, 3));
+    for (int i = 0; i < 3; i++) TEST_ASSERT(nvRingPushRequest(ring, &req));
+    TEST_ASSERT(!nvRingPushRequest(ring, &req));
+    free(ring);
+}
+
+void test_ring_completion_backpressure(void) {
+    NvdaalRingControl *ring = ring_alloc();
+    Consumer c = { 0, 0, 0 };
+    NvdaalOpRequest req = { NVDAAL_OP_NOP, 0, 0, { 0, 0, 0, 0 } };
+    NvdaalOpCompletion cpl;
+
+    // Fill completions without reaping; remaining requests stay queued
+    for (uint32_t i = 0; i < NVDAAL_RING_REQUEST_SLOTS; i++) nvRingPushRequest(ring, &req);
+    TEST_ASSERT_EQ(NVDAAL_RING_REQUEST_SLOTS, drain(ring, &c, ~0u));
+    nvRingPushRequest(ring, &req);
+    TEST_ASSERT_EQ(0, drain(ring, &c, ~0u));
+    TEST_ASSERT_EQ(1, nvRingPendingRequests(ring));
+
+    TEST_ASSERT(nvRingPopCompletion(ring, &cpl));
+    TEST_ASSERT_EQ(1, drain(ring, &c, ~0u));
+    free(ring);
+}
+
+void test_ring_index_wrap(void) {
+    NvdaalRingControl *ring = ring_alloc();
+    Consumer c = { 0, 0, 0 };
+    NvdaalOpCompletion cpl;
+
+    // Free-running indices must survive 32-bit wraparound
+    ring->reqHead = ring->reqTail = c.reqTail = 0xFFFFFFF0u;
+    ring->cplHead = ring->cplTail = c.cplHead = 0xFFFFFFF0u;
+
+    for (uint64_t i = 0; i < 40; i++) {
+        NvdaalOpRequest req = { NVDAAL_OP_NOP, 0, i, { i, 0, 0, 0 } };
+        TEST_ASSERT(nvRingPushRequest(ring, &req));
+    }
+    TEST_ASSERT_EQ(40, nvRingPendingRequests(ring));
+    TEST_ASSERT_EQ(40, drain(ring, &c, ~0u));
+    for (uint64_t i = 0; i < 40; i++) {
+        TEST_ASSERT(nvRingPopCompletion(ring, &cpl));
+        TEST_ASSERT_EQ(i, cpl.cookie);
+        TEST_ASSERT_EQ(i + 1, cpl.result[0]);
+    }
+    TEST_ASSERT_EQ(0x18, c.reqTail);
+    free(ring);
+}
+
+void test_ring_wrap_full(void) {
+    NvdaalRingControl *ring = ring_alloc();
+    Consumer c = { 0, 0, 0 };
+    NvdaalOpRequest req = { NVDAAL_OP_NOP, 0, 0, { 0, 0, 0, 0 } };
+    NvdaalOpCompletion cpl;
+
+    // A full ring straddling the 32-bit wrap drains in slot order
+    ring->reqHead = ring->reqTail = c.reqTail = 0u - NVDAAL_RING_REQUEST_SLOTS / 2;
+    ring->cplHead = ring->cplTail = c.cplHead = 0u - NVDAAL_RING_REQUEST_SLOTS / 2;
+    for (uint32_t i = 0; i < NVDAAL_RING_REQUEST_SLOTS; i++) {
+        req.cookie = i;
+        TEST_ASSERT(nvRingPushRequest(ring, &req));
+    }
+    TEST_ASSERT(!nvRingPushRequest(ring, &req));
+    TEST_ASSERT_EQ(NVDAAL_RING_REQUEST_SLOTS, drain(ring, &c, ~0u));
+    TEST_ASSERT_EQ(NVDAAL_RING_REQUEST_SLOTS / 2, c.cplHead);
+    for (uint32_t i = 0; i < NVDAAL_RING_REQUEST_SLOTS; i++) {
+        TEST_ASSERT(nvRingPopCompletion(ring, &cpl));
+        TEST_ASSERT_EQ(i, cpl.cookie);
+    }
+    TEST_ASSERT(!nvRingPopCompletion(ring, &cpl));
+    free(ring);
+}
+
+void test_ring_bad_opcode(void) {
+    NvdaalRingControl *ring = ring_alloc();
+    Consumer c = { 0, 0, 0 };
+    NvdaalOpCompletion cpl;
+
+    // An unknown op fails on its own; the ones around it still run
+    NvdaalOpRequest good = { NVDAAL_OP_NOP, 0, 1, { 7, 0, 0, 0 } };
+    NvdaalOpRequest bad = { 0xDEAD, 0, 2, { 7, 0, 0, 0 } };
+    nvRingPushRequest(ring, &good);
+    nvRingPushRequest(ring, &bad);
+    good.cookie = 3;
+    nvRingPushRequest(ring, &good);
+    TEST_ASSERT_EQ(3, drain(ring, &c, ~0u));
+
+    TEST_ASSERT(nvRingPopCompletion(ring, &cpl));
+    TEST_ASSERT_EQ(0, cpl.status);
+    TEST_ASSERT(nvRingPopCompletion(ring, &cpl));
+    TEST_ASSERT_EQ(2, cpl.cookie);
+    TEST_ASSERT_EQ(0xDEAD, cpl.op);
+    TEST_ASSERT_EQ(TEST_STATUS_UNSUPPORTED, cpl.status);
+    TEST_ASSERT_EQ(0, cpl.result[0]);
+    TEST_ASSERT(nvRingPopCompletion(ring, &cpl));
+    TEST_ASSERT_EQ(3, cpl.cookie);
+    TEST_ASSERT_EQ(0, cpl.status);
+    free(ring);
+}
+
+void test_ring_corrupt_indices(void) {
+    NvdaalRingControl *ring = ring_alloc();
+    Consumer c = { 0, 0, 0 };
+    uint32_t done = 1;
+
+    // A head more than a ring ahead of the kernel's tail is refused
+    ring->reqHead = NVDAAL_RING_REQUEST_SLOTS + 1;
+    TEST_ASSERT(!nvRingDrain(ring, &c.reqTail, &c.cplHead, ~0u, echo_action, &c.calls, &done));
+    TEST_ASSERT_EQ(0, done);
+    TEST_ASSERT_EQ(0, c.calls);
+    TEST_ASSERT_EQ(0, c.reqTail);
+
+    // As is a completion tail past any the kernel produced; the shared
+    // tail the client rewrote does not move the kernel's own copy
+    ring->reqHead = 1;
+    ring->reqTail = 0x1234;
+    ring->cplTail = 2;
+    TEST_ASSERT(!nvRingDrain(ring, &c.reqTail, &c.cplHead, ~0u, echo_action, &c.calls, &done));
+    TEST_ASSERT_EQ(0, c.calls);
+
+    // A sane client is served again once it repairs its index
+    ring->cplTail = 0;
+    TEST_ASSERT_EQ(1, drain(ring, &c, ~0u));
+    TEST_ASSERT_EQ(1, ring->reqTail);
+    free(ring);
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+TEST_MAIN("NVDAAL Command Ring Tests",
+    // Layout
+    TEST_CASE(test_ring_layout),
+    TEST_CASE(test_batch_layout),
+    TEST_CASE(test_ring_init_valid),
+
+    // Flow
+    TEST_CASE(test_ring_round_trip),
+    TEST_CASE(test_ring_full),
+    TEST_CASE(test_ring_completion_backpressure),
+    TEST_CASE(test_ring_index_wrap),
+    TEST_CASE(test_ring_wrap_full),
+    TEST_CASE(test_ring_bad_opcode),
+    TEST_CASE(test_ring_corrupt_indices)
+)
@@ -0,0 +1,211 @@
+/**
+ * @file test_context_sim.cpp
+ * @brief Thread-safe Client, multiple contexts and per-thread submission state
+ *
+ * Connects one Client from many threads at once and submits to it from
+ * threads with their own Streams, then launches kernels of a synthetic
+ * cubin (nvdaal_cubin.h) through each thread's ThreadContext of a Context
+ * and checks the simulator saw every launch.
+ *
+ * Compile: make test-context-sim
+ * Run: ./Build/test_context_sim
+ */
+
+#include "nvdaal_sim_test.h"
+#include "nvdaal_cubin.h"
+#include "NVDAALContext.h"
+#include <atomic>
+#include <thread>
+
+using namespace nvdaal;
+using cubin::TestKernel;
+
+static std::vector<uint8_t> saxpyImage() {
+    std::vector<TestKernel> kernels(1);
+    kernels[0].name = "saxpy";                      // (float a, const float *x, float *y, int n)
+    kernels[0].registers = 24;
+    kernels[0].paramSizes = { 4, 8, 8, 4 };
+    return cubin::buildCubin(kernels);
+}
+
+// Run fn(i) on `count` threads released together
+template <typename Fn>
+static void onThreads(uint32_t count, Fn fn) {
+    std::atomic<bool> go(false);
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < count; i++) {
+        threads.emplace_back([&go, &fn, i] {
+            while (!go.load()) std::this_thread::yield();
+            fn(i);
+        });
+    }
+    go.store(true);
+    for (std::thread& t : threads) t.join();
+}
+
+// ============================================================================
+// Client
+// ============================================================================
+
+void test_concurrent_connect(void) {
+    SimConfig config;
+    config.channels = 3;
+    Client client(makeSimBackend(config));
+    std::atomic<uint32_t> connected(0), rightCount(0);
+    onThreads(16, [&](uint32_t) {
+        if (client.connect()) connected++;
+        if (client.getChannelCount() == 3) rightCount++;
+    });
+    TEST_ASSERT_EQ(16, connected.load());
+    TEST_ASSERT_EQ(16, rightCount.load());
+    TEST_ASSERT(client.isConnected());
+
+    client.disconnect();
+    TEST_ASSERT(!client.isConnected());
+    TEST_ASSERT(client.connect());
+}
+
+void test_concurrent_submits(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    const uint32_t threads = 8, submits = 500;
+    std::atomic<uint32_t> ok(0);
+
+    // One Client, one Stream per thread, no lock around any of it
+    onThreads(threads, [&](uint32_t) {
+        Stream stream(client, allocator);
+        Buffer nop = allocator.allocate(256);
+        if (!stream.valid() || !nop.cpu()) return;
+        *(uint32_t *)nop.cpu() = 0;
+        uint32_t done = 0;
+        for (uint32_t i = 0; i < submits; i++) done += stream.submit(nop.gpuAddr(), 4);
+        if (stream.synchronize() && done == submits) ok++;
+    });
+    TEST_ASSERT_EQ(threads, ok.load());
+    TEST_ASSERT(sim(client)->counters().submissions >= threads * submits);
+    TEST_ASSERT_EQ(0, allocator.stats().allocatedBytes);
+}
+
+// ============================================================================
+// Context
+// ============================================================================
+
+void test_thread_contexts(void) {
+    Context context(makeSimBackend());
+    TEST_ASSERT(context.connect());
+    std::vector<uint8_t> image = saxpyImage();
+    std::shared_ptr<const Module> module = context.modules().load(image.data(), image.size());
+    TEST_ASSERT(module != nullptr);
+    const QmdTemplate *qmd = context.qmds().get(*module, *module->kernel("saxpy"), 256);
+    TEST_ASSERT(qmd != nullptr);
+
+    const uint32_t threads = 8, launches = 200;
+    std::vector<ThreadContext *> seen(threads, nullptr);
+    std::atomic<uint32_t> ok(0);
+    onThreads(threads, [&](uint32_t t) {
+        ThreadContext *state = context.current();
+        if (!state || context.current() != state) return;
+        seen[t] = state;
+        float a = 1.0f;
+        uint64_t x = 0, y = 0;
+        int32_t n = 0;
+        void *args[] = { &a, &x, &y, &n };
+        uint32_t done = 0;
+        for (uint32_t i = 0; i < launches; i++) {
+            n = (int32_t)i;
+            done += context.launch(*qmd, i + 1, 1, 1, args, i % 4 == 0);
+        }
+        if (context.synchronize() && done == launches) ok++;
+    });
+    TEST_ASSERT_EQ(threads, ok.load());
+
+    // Every thread had its own state; all of it stays until the Context goes
+    for (uint32_t i = 0; i < threads; i++) {
+        for (uint32_t j = i + 1; j < threads; j++) TEST_ASSERT(seen[i] != seen[j]);
+    }
+    TEST_ASSERT_EQ(threads, context.threadCount());
+    TEST_ASSERT_EQ(threads, context.stats().threadsCreated);
+    SimCounters c = sim(context.client())->counters();
+    TEST_ASSERT_EQ(threads * launches, c.dispatches);
+    TEST_ASSERT_EQ(0, c.faults);
+}
+
+void test_release_thread(void) {
+    Context context(makeSimBackend());
+    ThreadContext *first = context.current();
+    TEST_ASSERT(first != nullptr);
+    TEST_ASSERT(first->valid());
+    TEST_ASSERT_EQ(1, context.threadCount());
+
+    context.releaseThread();
+    TEST_ASSERT_EQ(0, context.threadCount());
+    TEST_ASSERT_EQ(1, context.stats().threadsReleased);
+    context.releaseThread();                          // Nothing bound: no-op
+    TEST_ASSERT_EQ(1, context.stats().threadsReleased);
+
+    TEST_ASSERT(context.current() != nullptr);        // Made again on next use
+    TEST_ASSERT_EQ(1, context.threadCount());
+    TEST_ASSERT_EQ(2, context.stats().threadsCreated);
+}
+
+void test_multiple_contexts(void) {
+    std::vector<uint8_t> image = saxpyImage();
+    Context a(makeSimBackend());
+    ThreadContext *stateA = a.current();
+    TEST_ASSERT(stateA != nullptr);
+    {
+        Context b(makeSimBackend());
+        ThreadContext *stateB = b.current();
+        TEST_ASSERT(stateB != nullptr && stateB != stateA);
+        TEST_ASSERT(&b.client() != &a.client());
+        TEST_ASSERT(stateB->stream().getClient() == &b.client());
+
+        // Modules are per Context: each uploads its own copy
+        std::shared_ptr<const Module> ma = a.modules().load(image.data(), image.size());
+        std::shared_ptr<const Module> mb = b.modules().load(image.data(), image.size());
+        TEST_ASSERT(ma && mb && ma != mb);
+        TEST_ASSERT_EQ(1, a.modules().stats().modules);
+    }
+
+    // A Context made after one is gone never finds the old one's state
+    Context c(makeSimBackend());
+    ThreadContext *stateC = c.current();
+    TEST_ASSERT(stateC != nullptr);
+    TEST_ASSERT(stateC->stream().getClient() == &c.client());
+    TEST_ASSERT(a.current() == stateA);
+}
+
+void test_shared_objects(void) {
+    Context context(makeSimBackend());
+    std::vector<uint8_t> image = saxpyImage();
+    const uint32_t threads = 16;
+    std::vector<const Module *> modules(threads, nullptr);
+    std::vector<const QmdTemplate *> qmds(threads, nullptr);
+
+    // The same image loaded from every thread at once ends up as one
+    // cached module, and one template for one CTA shape
+    onThreads(threads, [&](uint32_t t) {
+        std::shared_ptr<const Module> module = context.modules().load(image.data(), image.size());
+        if (!module) return;
+        modules[t] = module.get();
+        qmds[t] = context.qmds().get(*module, *module->kernel("saxpy"), 128);
+        Buffer scratch = context.allocator().allocate(4096 + t * 512);
+        if (!scratch.valid()) modules[t] = nullptr;
+    });
+    for (uint32_t t = 0; t < threads; t++) {
+        TEST_ASSERT(modules[t] != nullptr && modules[t] == modules[0]);
+        TEST_ASSERT(qmds[t] != nullptr && qmds[t] == qmds[0]);
+    }
+    TEST_ASSERT_EQ(1, context.modules().stats().modules);
+    TEST_ASSERT_EQ(1, context.qmds().stats().templates);
+    TEST_ASSERT(context.allocator().stats().frees >= threads);    // Scratch, and any upload that lost a race
+}
+
+TEST_MAIN("libNVDAAL Context Tests",
+    TEST_CASE(test_concurrent_connect),
+    TEST_CASE(test_concurrent_submits),
+    TEST_CASE(test_thread_contexts),
+    TEST_CASE(test_release_thread),
+    TEST_CASE(test_multiple_contexts),
+    TEST_CASE(test_shared_objects)
+)
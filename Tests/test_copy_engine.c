@@ -0,0 +1,413 @@
+/**
+ * @file test_copy_engine.c
+ * @brief Unit tests for copy-class (NVC7B5) method encoding
+ *
+ * Encodes copies, 2D copies, fills and copy-engine semaphore releases with
+ * NVDAALPushbuffer.h, then reads them back with an independent decoder:
+ * it walks the method headers, keeps the copy class state a real engine
+ * would, and turns every LAUNCH_DMA into the operation it describes. The
+ * decoded operations are run against a small fake address space, so a
+ * wrong field shows up as wrong bytes.
+ *
+ * Compile: make test-copy-engine
+ * Run: ./Build/test_copy_engine
+ */
+
+#include "nvdaal_test.h"
+#include "../Sources/NVDAALPushbuffer.h"
+#include "../Sources/NVDAALUserShared.h"
+
+// ============================================================================
+// Decoder
+// ============================================================================
+
+#define MAX_LAUNCHES 16
+
+typedef struct {
+    uint32_t flags;             // LAUNCH_DMA data
+    uint64_t src, dst;
+    uint32_t pitchIn, pitchOut;
+    uint32_t lineLength, lineCount;
+    uint32_t constA, constB, components;
+    uint64_t semVa, semPayload;
+} Launch;
+
+typedef struct {
+    uint32_t copy[0x800 / 4];   // Copy class method state
+    uint32_t boundClass[8];     // SET_OBJECT per subchannel
+    uint32_t hostMethods;       // Host-class method writes seen
+    Launch launches[MAX_LAUNCHES];
+    uint32_t launchCount;
+} Decoded;
+
+static void decode_method(Decoded *d, uint32_t subch, uint32_t addr, uint32_t data) {
+    if (addr == 0) {
+        d->boundClass[subch] = data;
+        return;
+    }
+    if (subch == NV_PB_SUBCH_HOST) {
+        d->hostMethods++;
+        return;
+    }
+    if (subch != NV_PB_SUBCH_COPY || addr >= sizeof(d->copy)) return;
+    if (addr != 0x0300) {                   // LAUNCH_DMA, spelled out on purpose
+        d->copy[addr / 4] = data;
+        return;
+    }
+    if (d->launchCount == MAX_LAUNCHES) return;
+
+    const uint32_t *c = d->copy;
+    Launch *l = &d->launches[d->launchCount++];
+    l->flags = data;
+    l->src = ((uint64_t)(c[0x400 / 4] & 0x01FFFFFF) << 32) | c[0x404 / 4];
+    l->dst = ((uint64_t)(c[0x408 / 4] & 0x01FFFFFF) << 32) | c[0x40C / 4];
+    l->pitchIn = c[0x410 / 4];
+    l->pitchOut = c[0x414 / 4];
+    l->lineLength = c[0x418 / 4];
+    l->lineCount = c[0x41C / 4];
+    l->constA = c[0x700 / 4];
+    l->constB = c[0x704 / 4];
+    l->components = c[0x708 / 4];
+    l->semVa = ((uint64_t)(c[0x240 / 4] & 0x01FFFFFF) << 32) | c[0x244 / 4];
+    l->semPayload = ((uint64_t)c[0x24C / 4] << 32) | c[0x248 / 4];
+}
+
+// Returns the dwords consumed; stops at the first malformed header
+static size_t decode(Decoded *d, const uint32_t *pb, size_t dwords) {
+    memset(d, 0, sizeof(*d));
+    size_t pos = 0;
+    while (pos < dwords) {
+        uint32_t header = pb[pos];
+        uint32_t secOp = header >> 29;
+        uint32_t count = (header >> 16) & 0x1FFF;
+        uint32_t subch = (header >> 13) & 0x7;
+        uint32_t addr = (header & 0xFFF) << 2;
+
+        if (secOp == 4) {                   // Immediate: data in the count field
+            decode_method(d, subch, addr, count);
+            pos++;
+            continue;
+        }
+        if ((secOp != 1 && secOp != 3 && secOp != 5) || pos + 1 + count > dwords) break;
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t a = secOp == 1 ? addr + i * 4 : secOp == 5 && i ? addr + 4 : addr;
+            decode_method(d, subch, a, pb[pos + 1 + i]);
+        }
+        pos += 1 + count;
+    }
+    return pos;
+}
+
+// ============================================================================
+// Fake Address Space
+// ============================================================================
+
+#define MEM_BASE    0x00FF123400000000ULL   // Exercises the upper address bits
+#define MEM_SIZE    0x4000
+
+static uint8_t g_mem[MEM_SIZE];
+
+static uint8_t *mem_at(uint64_t va, uint64_t bytes) {
+    if (va < MEM_BASE || va - MEM_BASE > MEM_SIZE || bytes > MEM_SIZE - (va - MEM_BASE)) return NULL;
+    return g_mem + (va - MEM_BASE);
+}
+
+static void mem_reset(void) {
+    for (uint32_t i = 0; i < MEM_SIZE; i++) g_mem[i] = (uint8_t)(i * 7 + 1);
+}
+
+// Run a decoded launch as the copy engine would; false on a bad address
+static bool run_launch(const Launch *l) {
+    if ((l->flags & 0x3) != 0) {
+        uint32_t lines = (l->flags & (1u << 9)) ? l->lineCount : 1;
+        uint32_t element = 0;
+        if (l->flags & (1u << 10)) {        // Remap: constants only
+            uint32_t size = ((l->components >> 16) & 0x3) + 1;
+            uint32_t count = ((l->components >> 24) & 0x3) + 1;
+            element = size * count;
+        }
+        uint64_t length = element ? (uint64_t)l->lineLength * element : l->lineLength;
+        for (uint32_t i = 0; i < lines; i++) {
+            uint8_t *to = mem_at(l->dst + (uint64_t)i * l->pitchOut, length);
+            if (!to) return false;
+            if (element) {
+                uint32_t size = ((l->components >> 16) & 0x3) + 1;
+                for (uint64_t p = 0; p < length; p += size) {
+                    uint32_t select = (l->components >> (4 * ((p % element) / size))) & 0x7;
+                    uint32_t value = select == 4 ? l->constA : select == 5 ? l->constB : 0;
+                    memcpy(to + p, &value, size);
+                }
+            } else {
+                uint8_t *from = mem_at(l->src + (uint64_t)i * l->pitchIn, length);
+                if (!from) return false;
+                memmove(to, from, length);
+            }
+        }
+    }
+    if (((l->flags >> 3) & 0x3) == 1) {     // RELEASE_ONE_WORD_SEMAPHORE
+        bool wide = (l->flags >> 27) & 1;
+        uint8_t *sem = mem_at(l->semVa, wide ? 8 : 4);
+        if (!sem) return false;
+        memcpy(sem, &l->semPayload, wide ? 8 : 4);
+    }
+    return true;
+}
+
+// ============================================================================
+// Copies
+// ============================================================================
+
+void test_copy_decodes_as_one_line(void) {
+    uint32_t buf[NV_PB_COPY_DWORDS];
+    NvPushbuffer pb;
+    nvPbInit(&pb, buf, sizeof(buf));
+    TEST_ASSERT(nvPbPushCopy(&pb, MEM_BASE + 0x2000, MEM_BASE + 0x100, 300));
+
+    Decoded d;
+    TEST_ASSERT_EQ(NV_PB_COPY_DWORDS, decode(&d, buf, NV_PB_COPY_DWORDS));
+    TEST_ASSERT_EQ(1, d.launchCount);
+    const Launch *l = &d.launches[0];
+    TEST_ASSERT_EQ(MEM_BASE + 0x100, l->src);
+    TEST_ASSERT_EQ(MEM_BASE + 0x2000, l->dst);
+    TEST_ASSERT_EQ(300, l->lineLength);
+    TEST_ASSERT_EQ(2u, l->flags & 0x3);                 // NON_PIPELINED
+    TEST_ASSERT(l->flags & (1u << 2));                  // FLUSH_ENABLE
+    TEST_ASSERT(l->flags & (1u << 7));                  // SRC pitch layout
+    TEST_ASSERT(l->flags & (1u << 8));                  // DST pitch layout
+    TEST_ASSERT(!(l->flags & (1u << 9)));               // Single line
+    TEST_ASSERT(!(l->flags & (1u << 10)));              // No remap
+    TEST_ASSERT_EQ(0u, (l->flags >> 3) & 0x3);          // No semaphore
+
+    mem_reset();
+    uint8_t expect[300];
+    memcpy(expect, g_mem + 0x100, sizeof(expect));
+    TEST_ASSERT(run_launch(l));
+    TEST_ASSERT(memcmp(g_mem + 0x2000, expect, sizeof(expect)) == 0);
+    TEST_ASSERT_EQ((uint8_t)(0x2000 * 7 + 300 * 7 + 1), g_mem[0x2000 + 300]);   // Past the end untouched
+}
+
+void test_copy_2d_moves_rows(void) {
+    uint32_t buf[NV_PB_COPY_DWORDS];
+    NvPushbuffer pb;
+    nvPbInit(&pb, buf, sizeof(buf));
+
+    // 3 rows of 40 bytes: source rows 64 apart, destination rows 100 apart
+    TEST_ASSERT(nvPbPushCopy2D(&pb, MEM_BASE + 0x1000, 100, MEM_BASE + 0x200, 64, 40, 3));
+    TEST_ASSERT_EQ(NV_PB_COPY_DWORDS * 4, nvPbBytesUsed(&pb));
+
+    Decoded d;
+    TEST_ASSERT_EQ(NV_PB_COPY_DWORDS, decode(&d, buf, NV_PB_COPY_DWORDS));
+    TEST_ASSERT_EQ(1, d.launchCount);
+    const Launch *l = &d.launches[0];
+    TEST_ASSERT(l->flags & (1u << 9));                  // MULTI_LINE_ENABLE
+    TEST_ASSERT_EQ(64, l->pitchIn);
+    TEST_ASSERT_EQ(100, l->pitchOut);
+    TEST_ASSERT_EQ(40, l->lineLength);
+    TEST_ASSERT_EQ(3, l->lineCount);
+
+    mem_reset();
+    uint8_t before[MEM_SIZE];
+    memcpy(before, g_mem, MEM_SIZE);
+    TEST_ASSERT(run_launch(l));
+    for (uint32_t row = 0; row < 3; row++) {
+        TEST_ASSERT(memcmp(g_mem + 0x1000 + row * 100, before + 0x200 + row * 64, 40) == 0);
+        // The 60 bytes between destination rows keep their old contents
+        TEST_ASSERT(memcmp(g_mem + 0x1000 + row * 100 + 40, before + 0x1000 + row * 100 + 40, 60) == 0);
+    }
+}
+
+void test_copy_2d_rejects_bad_shapes(void) {
+    uint32_t buf[NV_PB_COPY_DWORDS];
+    NvPushbuffer pb;
+    nvPbInit(&pb, buf, sizeof(buf));
+
+    TEST_ASSERT(!nvPbPushCopy2D(&pb, MEM_BASE, 64, MEM_BASE + 64, 64, 0, 2));    // No width
+    TEST_ASSERT(!nvPbPushCopy2D(&pb, MEM_BASE, 64, MEM_BASE + 64, 64, 64, 0));   // No rows
+    TEST_ASSERT(!nvPbPushCopy2D(&pb, MEM_BASE, 32, MEM_BASE + 64, 64, 64, 2));   // Rows would overlap
+    TEST_ASSERT(!nvPbPushCopy2D(&pb, MEM_BASE, 64, MEM_BASE + 64, 16, 64, 2));
+    TEST_ASSERT_EQ(0, nvPbBytesUsed(&pb));
+
+    // One row ignores the pitches
+    TEST_ASSERT(nvPbPushCopy2D(&pb, MEM_BASE, 0, MEM_BASE + 64, 0, 64, 1));
+
+    // Out of room: nothing written
+    NvPushbuffer small;
+    nvPbInit(&small, buf, (NV_PB_COPY_DWORDS - 1) * 4);
+    TEST_ASSERT(!nvPbPushCopy2D(&small, MEM_BASE, 64, MEM_BASE + 64, 64, 64, 2));
+    TEST_ASSERT_EQ(0, nvPbBytesUsed(&small));
+}
+
+// ============================================================================
+// Fills
+// ============================================================================
+
+void test_fill_writes_pattern(void) {
+    uint32_t buf[NV_PB_FILL_DWORDS];
+    NvPushbuffer pb;
+    nvPbInit(&pb, buf, sizeof(buf));
+    TEST_ASSERT(nvPbPushFill(&pb, MEM_BASE + 0x804, 0xDEADBEEF, 5));
+    TEST_ASSERT_EQ(NV_PB_FILL_DWORDS * 4, nvPbBytesUsed(&pb));
+
+    Decoded d;
+    TEST_ASSERT_EQ(NV_PB_FILL_DWORDS, decode(&d, buf, NV_PB_FILL_DWORDS));
+    TEST_ASSERT_EQ(1, d.launchCount);
+    const Launch *l = &d.launches[0];
+    TEST_ASSERT(l->flags & (1u << 10));                 // REMAP_ENABLE
+    TEST_ASSERT_EQ(0xDEADBEEFu, l->constA);
+    TEST_ASSERT_EQ(4u, l->components & 0x7);            // DST_X = CONST_A
+    TEST_ASSERT_EQ(3u, (l->components >> 16) & 0x3);    // 4-byte components
+    TEST_ASSERT_EQ(0u, (l->components >> 24) & 0x3);    // One destination component
+    TEST_ASSERT_EQ(5, l->lineLength);                   // In elements
+    TEST_ASSERT_EQ(MEM_BASE + 0x804, l->dst);
+
+    mem_reset();
+    uint8_t before[MEM_SIZE];
+    memcpy(before, g_mem, MEM_SIZE);
+    TEST_ASSERT(run_launch(l));
+    for (uint32_t i = 0; i < 5; i++) {
+        uint32_t word;
+        memcpy(&word, g_mem + 0x804 + i * 4, 4);
+        TEST_ASSERT_EQ(0xDEADBEEFu, word);
+    }
+    TEST_ASSERT(memcmp(g_mem, before, 0x804) == 0);
+    TEST_ASSERT(memcmp(g_mem + 0x818, before + 0x818, MEM_SIZE - 0x818) == 0);
+}
+
+void test_fill_rejects_bad_arguments(void) {
+    uint32_t buf[NV_PB_FILL_DWORDS];
+    NvPushbuffer pb;
+    nvPbInit(&pb, buf, sizeof(buf));
+
+    TEST_ASSERT(!nvPbPushFill(&pb, MEM_BASE + 2, 0, 4));          // Misaligned
+    TEST_ASSERT(!nvPbPushFill(&pb, MEM_BASE, 0, 0));              // Empty
+    TEST_ASSERT(!nvPbPushFill(&pb, MEM_BASE, 0, 0x40000000u));    // 4GB: pitch would wrap
+    TEST_ASSERT_EQ(0, nvPbBytesUsed(&pb));
+}
+
+// ============================================================================
+// Completion
+// ============================================================================
+
+void test_copy_release_encoding(void) {
+    uint32_t buf[NV_PB_COPY_RELEASE_DWORDS];
+    NvPushbuffer pb;
+    nvPbInit(&pb, buf, sizeof(buf));
+
+    TEST_ASSERT(!nvPbPushCopyRelease(&pb, MEM_BASE + 4, 1, false));    // 64-bit payloads need 8-byte alignment
+    TEST_ASSERT(nvPbPushCopyRelease(&pb, MEM_BASE + 0x3000, 0x0000000900000003ULL, true));
+    TEST_ASSERT_EQ(NV_PB_COPY_RELEASE_DWORDS * 4, nvPbBytesUsed(&pb));
+
+    // LAUNCH_DMA carries bit 27, so it cannot use the immediate form
+    TEST_ASSERT_EQ(NV_PB_SEC_OP_INC_METHOD, buf[5] >> NV_PB_HDR_SEC_OP_SHIFT);
+
+    Decoded d;
+    TEST_ASSERT_EQ(NV_PB_COPY_RELEASE_DWORDS, decode(&d, buf, NV_PB_COPY_RELEASE_DWORDS));
+    TEST_ASSERT_EQ(1, d.launchCount);
+    const Launch *l = &d.launches[0];
+    TEST_ASSERT_EQ(0u, l->flags & 0x3);                 // Moves no data
+    TEST_ASSERT_EQ(1u, (l->flags >> 3) & 0x3);          // RELEASE_ONE_WORD_SEMAPHORE
+    TEST_ASSERT_EQ(2u, (l->flags >> 5) & 0x3);          // NON_BLOCKING interrupt
+    TEST_ASSERT((l->flags >> 27) & 1);                  // 64-bit payload
+    TEST_ASSERT_EQ(MEM_BASE + 0x3000, l->semVa);
+    TEST_ASSERT_EQ(0x0000000900000003ULL, l->semPayload);
+
+    mem_reset();
+    TEST_ASSERT(run_launch(l));
+    uint64_t payload;
+    memcpy(&payload, g_mem + 0x3000, 8);
+    TEST_ASSERT_EQ(0x0000000900000003ULL, payload);
+
+    nvPbInit(&pb, buf, sizeof(buf));
+    TEST_ASSERT(nvPbPushCopyRelease(&pb, MEM_BASE, 1, false));
+    decode(&d, buf, NV_PB_COPY_RELEASE_DWORDS);
+    TEST_ASSERT_EQ(0u, (d.launches[0].flags >> 5) & 0x3);
+}
+
+// ============================================================================
+// Whole Pushbuffers
+// ============================================================================
+
+void test_set_object_binds_copy_class(void) {
+    uint32_t buf[NV_PB_SET_OBJECT_DWORDS];
+    NvPushbuffer pb;
+    nvPbInit(&pb, buf, sizeof(buf));
+    TEST_ASSERT(nvPbPushSetObject(&pb, NV_PB_SUBCH_COPY, 0xC7B5));
+
+    Decoded d;
+    TEST_ASSERT_EQ(NV_PB_SET_OBJECT_DWORDS, decode(&d, buf, NV_PB_SET_OBJECT_DWORDS));
+    TEST_ASSERT_EQ(0xC7B5u, d.boundClass[NV_PB_SUBCH_COPY]);
+    TEST_ASSERT_EQ(0u, d.boundClass[NV_PB_SUBCH_COMPUTE]);
+}
+
+void test_mixed_recording_runs_in_order(void) {
+    uint32_t buf[NV_PB_SET_OBJECT_DWORDS + 2 * NV_PB_COPY_DWORDS + NV_PB_FILL_DWORDS +
+                 NV_PB_COPY_RELEASE_DWORDS + NV_PB_SEMAPHORE_RELEASE_DWORDS];
+    NvPushbuffer pb;
+    nvPbInit(&pb, buf, sizeof(buf));
+
+    // Fill a 64-byte block, copy it on, copy two of its rows with a stride,
+    // then release from the copy engine and from host
+    TEST_ASSERT(nvPbPushSetObject(&pb, NV_PB_SUBCH_COPY, 0xC7B5));
+    TEST_ASSERT(nvPbPushFill(&pb, MEM_BASE + 0x100, 0x11223344, 16));
+    TEST_ASSERT(nvPbPushCopy(&pb, MEM_BASE + 0x200, MEM_BASE + 0x100, 64));
+    TEST_ASSERT(nvPbPushCopy2D(&pb, MEM_BASE + 0x400, 32, MEM_BASE + 0x200, 16, 8, 2));
+    TEST_ASSERT(nvPbPushCopyRelease(&pb, MEM_BASE + 0x600, 7, false));
+    TEST_ASSERT(nvPbPushSemaphoreRelease(&pb, MEM_BASE + 0x608, 8, true));
+    size_t dwords = nvPbBytesUsed(&pb) / 4;
+    TEST_ASSERT_EQ(sizeof(buf) / 4, dwords);
+
+    // The decoder must land exactly on the end: every header's count is right
+    Decoded d;
+    TEST_ASSERT_EQ(dwords, decode(&d, buf, dwords));
+    TEST_ASSERT_EQ(4, d.launchCount);
+    TEST_ASSERT_EQ(6u, d.hostMethods);                  // 5 semaphore methods + interrupt
+
+    // Method state carries over between launches: the 2D copy after the
+    // fill must not inherit its remap
+    TEST_ASSERT(!(d.launches[2].flags & (1u << 10)));
+
+    mem_reset();
+    for (uint32_t i = 0; i < d.launchCount; i++) TEST_ASSERT(run_launch(&d.launches[i]));
+    uint32_t word;
+    memcpy(&word, g_mem + 0x200 + 60, 4);
+    TEST_ASSERT_EQ(0x11223344u, word);
+    memcpy(&word, g_mem + 0x400 + 32, 4);
+    TEST_ASSERT_EQ(0x11223344u, word);
+    TEST_ASSERT_EQ((uint8_t)(0x408 * 7 + 1), g_mem[0x408]);   // Row gap untouched
+    uint64_t payload;
+    memcpy(&payload, g_mem + 0x600, 8);
+    TEST_ASSERT_EQ(7u, payload);
+}
+
+void test_copy_channel_index(void) {
+    uint64_t arg = NVDAAL_PUSHBUFFER_ARG(4096, NVDAAL_CHANNEL_COPY | 1);
+    TEST_ASSERT_EQ(4096, NVDAAL_PUSHBUFFER_ARG_BYTES(arg));
+    TEST_ASSERT_EQ(NVDAAL_CHANNEL_COPY | 1, NVDAAL_PUSHBUFFER_ARG_CHANNEL(arg));
+
+    // The flag sits above every compute channel index
+    TEST_ASSERT(NVDAAL_CHANNEL_COPY >= NVDAAL_MAX_CHANNELS);
+    TEST_ASSERT(NVDAAL_MAX_COPY_CHANNELS <= NVDAAL_CHANNEL_COPY);
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+TEST_MAIN("NVDAAL Copy Engine Encoding Tests",
+    // Copies
+    TEST_CASE(test_copy_decodes_as_one_line),
+    TEST_CASE(test_copy_2d_moves_rows),
+    TEST_CASE(test_copy_2d_rejects_bad_shapes),
+
+    // Fills
+    TEST_CASE(test_fill_writes_pattern),
+    TEST_CASE(test_fill_rejects_bad_arguments),
+
+    // Completion
+    TEST_CASE(test_copy_release_encoding),
+
+    // Whole pushbuffers
+    TEST_CASE(test_set_object_binds_copy_class),
+    TEST_CASE(test_mixed_recording_runs_in_order),
+    TEST_CASE(test_copy_channel_index)
+)
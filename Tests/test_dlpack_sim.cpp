@@ -0,0 +1,308 @@
+/**
+ * @file test_dlpack_sim.cpp
+ * @brief DLPack tensor export and import
+ *
+ * Exports Buffers as DLManagedTensors by GPU VA and by BAR1 mapping,
+ * imports them and framework-style views of them back, and checks layouts
+ * are validated, memory stays allocated until every deleter has run and
+ * each deleter runs exactly once, on the simulator backend, which
+ * executes copies in its fake VRAM.
+ *
+ * Compile: make test-dlpack-sim
+ * Run: ./Build/test_dlpack_sim
+ */
+
+#include "nvdaal_test.h"
+#include "NVDAALDLPack.h"
+#include "NVDAALStream.h"
+
+using namespace nvdaal;
+
+static const DLDataType kFloat32 = { kDLFloat, 32, 1 };
+
+static TensorLayout layout(std::vector<int64_t> shape, std::vector<int64_t> strides = {}, uint64_t byteOffset = 0) {
+    TensorLayout l;
+    l.shape = shape;
+    l.strides = strides;
+    l.byteOffset = byteOffset;
+    return l;
+}
+
+// A tensor as a framework would hand one over: its own arrays, its own deleter
+struct Foreign {
+    DLManagedTensor managed;
+    int64_t shape[2];
+    int64_t strides[2];
+    int deleted;
+
+    Foreign(void *data, DLDeviceType device, int64_t rows, int64_t cols, int64_t pitch, uint64_t byteOffset)
+        : deleted(0) {
+        shape[0] = rows;
+        shape[1] = cols;
+        strides[0] = pitch;
+        strides[1] = 1;
+        managed.dl_tensor = { data, { device, 0 }, 2, kFloat32, shape, strides, byteOffset };
+        managed.manager_ctx = this;
+        managed.deleter = [](DLManagedTensor *self) { static_cast<Foreign *>(self->manager_ctx)->deleted++; };
+    }
+};
+
+// ============================================================================
+// Layout
+// ============================================================================
+
+void test_extent(void) {
+    int64_t shape[3] = { 2, 3, 4 };
+    int64_t strides[3] = { 16, 4, 1 };
+    DLTensor t = { nullptr, { kDLExtDev, 0 }, 3, kFloat32, shape, nullptr, 0 };
+    uint64_t bytes;
+    TEST_ASSERT(tensorExtent(t, &bytes));
+    TEST_ASSERT_EQ(24 * 4, bytes);                                 // Compact
+
+    t.strides = strides;
+    TEST_ASSERT(tensorExtent(t, &bytes));
+    TEST_ASSERT_EQ((16 + 2 * 4 + 3 + 1) * 4, bytes);               // Padded rows: up to the last element
+
+    t.dtype = { kDLFloat, 16, 4 };                                 // half4
+    TEST_ASSERT(tensorExtent(t, &bytes));
+    TEST_ASSERT_EQ((16 + 2 * 4 + 3 + 1) * 8, bytes);
+
+    shape[1] = 0;
+    TEST_ASSERT(tensorExtent(t, &bytes));
+    TEST_ASSERT_EQ(0, bytes);
+
+    t.ndim = 0;                                                    // A scalar
+    TEST_ASSERT(tensorExtent(t, &bytes));
+    TEST_ASSERT_EQ(8, bytes);
+
+    t.ndim = 3;
+    shape[1] = 3;
+    strides[0] = -16;
+    TEST_ASSERT(!tensorExtent(t, &bytes));
+    strides[0] = INT64_MAX;
+    TEST_ASSERT(!tensorExtent(t, &bytes));
+    strides[0] = 16;
+    t.dtype.bits = 0;
+    TEST_ASSERT(!tensorExtent(t, &bytes));
+}
+
+// ============================================================================
+// Export
+// ============================================================================
+
+void test_export_gpu(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    Buffer buffer = allocator.allocate(4096);
+    uint64_t gpuAddr = buffer.gpuAddr();
+
+    DLManagedTensor *managed = toDLPack(buffer, layout({ 8, 16 }, {}, 512));
+    TEST_ASSERT(managed != nullptr);
+    const DLTensor& t = managed->dl_tensor;
+    TEST_ASSERT_EQ(gpuAddr, (uint64_t)(uintptr_t)t.data);
+    TEST_ASSERT_EQ(kDLExtDev, t.device.device_type);
+    TEST_ASSERT_EQ(0, t.device.device_id);
+    TEST_ASSERT_EQ(2, t.ndim);
+    TEST_ASSERT(t.shape[0] == 8 && t.shape[1] == 16);
+    TEST_ASSERT(t.strides[0] == 16 && t.strides[1] == 1);          // Filled in for older consumers
+    TEST_ASSERT_EQ(512, t.byte_offset);
+    TEST_ASSERT(t.dtype.code == kDLFloat && t.dtype.bits == 32 && t.dtype.lanes == 1);
+
+    // The tensor keeps the memory: releasing the Buffer frees nothing
+    buffer.reset();
+    TEST_ASSERT_EQ(0, allocator.stats().frees);
+    TEST_ASSERT_EQ(4096, allocator.stats().allocatedBytes);
+    Buffer other = allocator.allocate(4096);
+    TEST_ASSERT(other.gpuAddr() != gpuAddr);
+
+    managed->deleter(managed);
+    TEST_ASSERT_EQ(1, allocator.stats().frees);
+    TEST_ASSERT_EQ(4096, allocator.stats().allocatedBytes);        // Only `other`
+}
+
+void test_export_cpu(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    Buffer buffer = allocator.allocate(1024);
+    uint8_t *cpu = (uint8_t *)buffer.cpu();
+    TEST_ASSERT(cpu != nullptr);
+
+    DLManagedTensor *managed = toDLPack(buffer, layout({ 4, 4 }, { 8, 1 }, 64), TensorDevice::Cpu, 3);
+    TEST_ASSERT(managed != nullptr);
+    DLTensor& t = managed->dl_tensor;
+    TEST_ASSERT(t.data == cpu);
+    TEST_ASSERT_EQ(kDLCPU, t.device.device_type);
+    TEST_ASSERT_EQ(3, t.device.device_id);
+
+    // What a host framework writes lands in the buffer
+    float *base = (float *)((uint8_t *)t.data + t.byte_offset);
+    for (int i = 0; i < 4; i++) base[i * t.strides[0] + 2] = 1.5f * i;
+    float back;
+    memcpy(&back, cpu + 64 + (3 * 8 + 2) * 4, 4);
+    TEST_ASSERT(back == 4.5f);
+    managed->deleter(managed);
+}
+
+void test_export_rejects(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    Buffer buffer = allocator.allocate(1000);
+    Buffer none;
+
+    TEST_ASSERT(toDLPack(none, layout({ 4 })) == nullptr);
+    TEST_ASSERT(toDLPack(buffer, layout({ 251 })) == nullptr);     // Into the rounding: past size()
+    TEST_ASSERT(toDLPack(buffer, layout({ 250 }, {}, 4)) == nullptr);
+    TEST_ASSERT(toDLPack(buffer, layout({ 10, 10 }, { 10 })) == nullptr);
+    TEST_ASSERT(toDLPack(buffer, layout({ 10, 10 }, { -10, 1 })) == nullptr);
+    TEST_ASSERT(toDLPack(buffer, layout({ -1 })) == nullptr);
+
+    DLManagedTensor *whole = toDLPack(buffer, layout({ 250 }));    // Exactly size()
+    DLManagedTensor *empty = toDLPack(buffer, layout({ 0 }, {}, 1000));
+    TEST_ASSERT(whole != nullptr && empty != nullptr);
+
+    // Only the accepted tensors hold pins: the last deleter frees the block
+    buffer.reset();
+    whole->deleter(whole);
+    TEST_ASSERT_EQ(0, allocator.stats().frees);
+    empty->deleter(empty);
+    TEST_ASSERT_EQ(1, allocator.stats().frees);
+}
+
+// ============================================================================
+// Import
+// ============================================================================
+
+void test_round_trip(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    Buffer buffer = allocator.allocate(8192);
+    uint64_t gpuAddr = buffer.gpuAddr();
+
+    DLManagedTensor *managed = toDLPack(buffer, layout({ 32, 32 }, {}, 1024));
+    buffer.reset();
+    {
+        DLPackTensor imported = fromDLPack(allocator, managed);
+        TEST_ASSERT(imported.valid());
+        TEST_ASSERT(&imported.tensor() == &managed->dl_tensor);
+        TEST_ASSERT_EQ(gpuAddr + 1024, imported.gpuAddr());
+        TEST_ASSERT_EQ(4096, imported.bytes());
+        TEST_ASSERT(imported.pin().valid());
+        TEST_ASSERT_EQ(gpuAddr, imported.pin().gpuAddr());
+
+        DLPackTensor moved = std::move(imported);
+        TEST_ASSERT(!imported.valid());
+        TEST_ASSERT_EQ(0, allocator.stats().frees);
+    }
+    // Destroying the import ran the deleter: the block is back in the cache
+    TEST_ASSERT_EQ(1, allocator.stats().frees);
+    TEST_ASSERT_EQ(0, allocator.stats().allocatedBytes);
+}
+
+void test_import_views(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    Buffer buffer = allocator.allocate(64 << 10);
+    Buffer neighbour = allocator.allocate(64 << 10);
+    uint64_t gpuAddr = buffer.gpuAddr();
+    uint8_t *cpu = (uint8_t *)buffer.cpu();
+
+    // A framework's slice: its own data pointer inside the buffer
+    Foreign slice((void *)(uintptr_t)(gpuAddr + 4096), kDLExtDev, 16, 64, 128, 256);
+    {
+        DLPackTensor imported = fromDLPack(allocator, &slice.managed);
+        TEST_ASSERT(imported.valid());
+        TEST_ASSERT_EQ(gpuAddr + 4096 + 256, imported.gpuAddr());
+        TEST_ASSERT_EQ((15 * 128 + 64) * 4, imported.bytes());
+        TEST_ASSERT_EQ(gpuAddr, imported.pin().gpuAddr());
+        TEST_ASSERT_EQ(0, slice.deleted);
+    }
+    TEST_ASSERT_EQ(1, slice.deleted);
+
+    // By BAR1 address, with the GPU VA worked out
+    Foreign host(cpu + 512, kDLCPU, 4, 4, 4, 0);
+    DLPackTensor imported = fromDLPack(allocator, &host.managed);
+    TEST_ASSERT(imported.valid());
+    TEST_ASSERT_EQ(gpuAddr + 512, imported.gpuAddr());
+
+    // Refused, deleters untouched: past the end (into the neighbour),
+    // outside any buffer, host memory, an unknown device, a CUDA pointer
+    // (another address space, whatever its value), a bad layout
+    Foreign spill((void *)(uintptr_t)(gpuAddr + (60 << 10)), kDLExtDev, 8, 256, 256, 0);
+    Foreign stray((void *)(uintptr_t)0x1234000, kDLExtDev, 1, 1, 1, 0);
+    float local[16];
+    Foreign heap(local, kDLCPU, 4, 4, 4, 0);
+    Foreign metal((void *)(uintptr_t)gpuAddr, kDLMetal, 1, 1, 1, 0);
+    Foreign cuda((void *)(uintptr_t)gpuAddr, kDLCUDA, 1, 1, 1, 0);
+    Foreign negative((void *)(uintptr_t)gpuAddr, kDLExtDev, 4, 4, -4, 0);
+    Foreign *refused[] = { &spill, &stray, &heap, &metal, &cuda, &negative };
+    for (Foreign *f : refused) {
+        TEST_ASSERT(!fromDLPack(allocator, &f->managed).valid());
+        TEST_ASSERT_EQ(0, f->deleted);
+    }
+    TEST_ASSERT(!fromDLPack(allocator, nullptr).valid());
+
+    // A freed block is no longer NVDAAL memory
+    uint64_t gone = neighbour.gpuAddr();
+    neighbour.reset();
+    Foreign late((void *)(uintptr_t)gone, kDLExtDev, 1, 4, 4, 0);
+    TEST_ASSERT(!fromDLPack(allocator, &late.managed).valid());
+
+    // Nor is another allocator's
+    BufferAllocator separate(client);
+    TEST_ASSERT(!fromDLPack(separate, &slice.managed).valid());
+    TEST_ASSERT_EQ(1, slice.deleted);
+}
+
+void test_imported_in_commands(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    Stream stream(client, allocator);
+    Buffer src = allocator.allocate(4096);
+    Buffer dst = allocator.allocate(4096);
+    uint8_t *srcCpu = (uint8_t *)src.cpu();
+    for (int i = 0; i < 4096; i++) srcCpu[i] = (uint8_t)(i * 3);
+
+    DLManagedTensor *managed = toDLPack(dst, layout({ 1024 }));
+    const uint8_t *dstCpu = (const uint8_t *)dst.cpu();
+    dst.reset();
+    DLPackTensor imported = fromDLPack(allocator, managed);
+    TEST_ASSERT(imported.valid());
+
+    CommandBuffer cb(allocator);
+    TEST_ASSERT(cb.copy(imported.gpuAddr(), src.gpuAddr(), imported.bytes()));
+    TEST_ASSERT(cb.use(imported.pin()));
+    TEST_ASSERT_EQ(1, cb.pinned());
+    TEST_ASSERT(cb.end());
+
+    // The recording's pin outlives the import and its deleter
+    uint64_t gpuAddr = imported.gpuAddr();
+    imported.reset();
+    TEST_ASSERT_EQ(0, allocator.stats().frees);
+    TEST_ASSERT(stream.submit(cb));
+    TEST_ASSERT(stream.synchronize(1000));
+    TEST_ASSERT_EQ(0, memcmp(dstCpu, srcCpu, 4096));
+
+    // Still allocated, so a framework's view of it imports
+    Foreign view((void *)(uintptr_t)gpuAddr, kDLExtDev, 1, 1024, 1024, 0);
+    DLPackTensor again = fromDLPack(allocator, &view.managed);
+    TEST_ASSERT(again.valid());
+
+    cb.begin();
+    TEST_ASSERT_EQ(0, allocator.stats().frees);                    // Still pinned by `again`
+    again.reset();
+    TEST_ASSERT_EQ(1, allocator.stats().frees);
+
+    BufferPin none;
+    TEST_ASSERT(!cb.use(none));
+    TEST_ASSERT(cb.failed());
+}
+
+TEST_MAIN("libNVDAAL DLPack Tests",
+    TEST_CASE(test_extent),
+    TEST_CASE(test_export_gpu),
+    TEST_CASE(test_export_cpu),
+    TEST_CASE(test_export_rejects),
+    TEST_CASE(test_round_trip),
+    TEST_CASE(test_import_views),
+    TEST_CASE(test_imported_in_commands)
+)
@@ -0,0 +1,211 @@
+/**
+ * @file test_graph_sim.cpp
+ * @brief Command graph capture, parameter patching and replay
+ *
+ * Captures CommandBuffers into Graphs on SimBackend and replays them:
+ * dependency barriers, single-submission launches, pointer and payload
+ * parameters across replicated images, buffering stalls and lifetime.
+ *
+ * Compile: make test-graph-sim
+ * Run: ./Build/test_graph_sim
+ */
+
+#include "nvdaal_sim_test.h"
+#include "NVDAALGraph.h"
+#include "NVDAALPushbuffer.h"
+
+using namespace nvdaal;
+
+// ============================================================================
+// Capture
+// ============================================================================
+
+void test_graph_barriers(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    CommandBuffer cb(allocator);
+    TEST_ASSERT(cb.dispatch(0x200010000ULL));
+    uint32_t node = NV_PB_DISPATCH_DWORDS * 4;
+
+    Graph graph(allocator);
+    uint32_t a = graph.addNode(cb);
+    uint32_t b = graph.addNode(cb);                      // Independent: runs alongside a
+    uint32_t c = graph.addNode(cb, { a });               // Barrier
+    uint32_t d = graph.addNode(cb, { a, b });            // Already ordered by that barrier
+    uint32_t e = graph.addNode(cb, { c });               // Barrier
+    TEST_ASSERT_EQ(0, a);
+    TEST_ASSERT_EQ(4, e);
+    (void)d;
+
+    GraphStats s = graph.stats();
+    TEST_ASSERT_EQ(5, s.nodes);
+    TEST_ASSERT_EQ(2, s.barriers);
+    TEST_ASSERT_EQ(5 * node + 2 * NV_PB_BARRIER_DWORDS * 4, s.sizeBytes);
+}
+
+void test_graph_invalid(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    CommandBuffer cb(allocator);
+    Graph graph(allocator);
+
+    TEST_ASSERT_EQ(Graph::kInvalid, graph.addNode(cb));          // Empty recording
+    TEST_ASSERT(!graph.instantiate(client));                     // Nothing captured
+    TEST_ASSERT_EQ(0, graph.launch());                           // Not instantiated
+
+    TEST_ASSERT(cb.barrier());
+    TEST_ASSERT_EQ(Graph::kInvalid, graph.addParam(0, cb.field(Field::CopySrc)));  // No node yet
+    TEST_ASSERT_EQ(0, graph.addNode(cb));
+    TEST_ASSERT_EQ(Graph::kInvalid, graph.addNode(cb, { 1 }));   // Forward dependency
+    TEST_ASSERT_EQ(Graph::kInvalid, graph.addParam(0, cb.field(Field::CopySrc)));  // Not a copy
+
+    TEST_ASSERT(graph.instantiate(client));
+    TEST_ASSERT_EQ(Graph::kInvalid, graph.addNode(cb));          // Frozen
+    TEST_ASSERT(!graph.setParam(0, 1));
+}
+
+// ============================================================================
+// Replay
+// ============================================================================
+
+void test_graph_launch(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    Buffer src = allocator.allocate(4096);
+    Buffer mid = allocator.allocate(4096);
+    Buffer dst = allocator.allocate(4096);
+    memset(src.cpu(), 0x3C, 4096);
+    memset(mid.cpu(), 0, 4096);
+    memset(dst.cpu(), 0, 4096);
+
+    Graph graph(allocator);
+    CommandBuffer cb(allocator);
+    TEST_ASSERT(cb.copy(mid, 0, src, 0, 4096));
+    uint32_t first = graph.addNode(cb);
+    cb.begin();                                          // Captured by copy: reusable
+    TEST_ASSERT(cb.copy(dst, 0, mid, 0, 4096));
+    graph.addNode(cb, { first });
+    TEST_ASSERT(graph.instantiate(client));
+
+    uint64_t submissions = sim(client)->counters().submissions;
+    uint64_t value = graph.launch();
+    TEST_ASSERT_EQ(1, value);
+    TEST_ASSERT(graph.wait(value));
+    TEST_ASSERT_EQ(0x3C, ((uint8_t *)dst.cpu())[4095]);
+    TEST_ASSERT_EQ(submissions + 1, sim(client)->counters().submissions);   // One per launch
+}
+
+void test_graph_params(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    Buffer a = allocator.allocate(256);
+    Buffer b = allocator.allocate(256);
+    Buffer dst = allocator.allocate(256);
+    memset(a.cpu(), 0xAA, 256);
+    memset(b.cpu(), 0xBB, 256);
+    Semaphore done;
+    TEST_ASSERT(client.createSemaphore(&done));
+
+    CommandBuffer cb(allocator);
+    TEST_ASSERT(cb.copy(dst, 0, a, 0, 256));
+    PatchPoint src = cb.field(Field::CopySrc);
+    PatchPoint bytes = cb.field(Field::CopyBytes);
+    TEST_ASSERT(cb.use(b));
+    TEST_ASSERT(cb.signal(done, 0));
+    PatchPoint step = cb.field(Field::SemaphoreValue);
+    TEST_ASSERT(src.valid() && bytes.valid() && step.valid());
+    TEST_ASSERT(!cb.field(Field::CopySrc).valid());     // Last command is the signal
+
+    Graph graph(allocator, 2);
+    uint32_t node = graph.addNode(cb);
+    uint32_t pSrc = graph.addParam(node, src);
+    uint32_t pBytes = graph.addParam(node, bytes);
+    uint32_t pStep = graph.addParam(node, step);
+    TEST_ASSERT(graph.instantiate(client));
+
+    for (uint64_t i = 1; i <= 6; i++) {
+        memset(dst.cpu(), 0, 256);
+        TEST_ASSERT(graph.setParam(pSrc, i % 2 ? b.gpuAddr() : a.gpuAddr()));
+        TEST_ASSERT(graph.setParam(pBytes, 128));
+        TEST_ASSERT(graph.setParam(pStep, i * 10));
+        TEST_ASSERT(graph.launch());
+        TEST_ASSERT(client.waitSemaphore(done, i * 10, 1000));
+
+        uint8_t *d = (uint8_t *)dst.cpu();
+        TEST_ASSERT_EQ(i % 2 ? 0xBB : 0xAA, d[127]);
+        TEST_ASSERT_EQ(0, d[128]);
+    }
+    // 2 + 3 + 2 dwords per launch, whichever image it went to
+    TEST_ASSERT_EQ(6 * 7, graph.stats().patchedDwords);
+
+    // Image 0 still lags by launch 6's values; after that only what
+    // changed is written, and nothing once both images have it
+    TEST_ASSERT(graph.setParam(pStep, 70));
+    TEST_ASSERT(graph.launch());                         // Image 0: all three
+    TEST_ASSERT(graph.launch());                         // Image 1: step
+    TEST_ASSERT(graph.launch());                         // Image 0: up to date
+    TEST_ASSERT(graph.synchronize());
+    TEST_ASSERT_EQ(6 * 7 + 7 + 2, graph.stats().patchedDwords);
+}
+
+void test_graph_buffering_stall(void) {
+    SimConfig config;
+    config.submitLatencyUs = 2000;
+    Client client(makeSimBackend(config));
+    BufferAllocator allocator(client);
+    CommandBuffer cb(allocator);
+    TEST_ASSERT(cb.barrier());
+
+    Graph graph(allocator, 2);
+    graph.addNode(cb);
+    TEST_ASSERT(graph.instantiate(client));
+
+    // Two launches fit; the third reuses image 0 and waits for launch 1
+    TEST_ASSERT_EQ(1, graph.launch());
+    TEST_ASSERT_EQ(2, graph.launch());
+    TEST_ASSERT_EQ(0, graph.stats().stalls);
+    TEST_ASSERT_EQ(3, graph.launch());
+    TEST_ASSERT_EQ(1, graph.stats().stalls);
+    uint64_t value = 0;
+    TEST_ASSERT(client.readSemaphore(graph.timeline(), &value));
+    TEST_ASSERT(value >= 1);
+    TEST_ASSERT(graph.synchronize());
+    TEST_ASSERT_EQ(3, graph.stats().launches);
+}
+
+void test_graph_keeps_buffers(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    Buffer a = allocator.allocate(4096);
+    {
+        Graph graph(allocator);
+        {
+            CommandBuffer cb(allocator);
+            TEST_ASSERT(cb.use(a));
+            TEST_ASSERT(cb.barrier());
+            graph.addNode(cb);
+        }
+        a.reset();                                       // The graph still references it
+        TEST_ASSERT_EQ(0, allocator.stats().frees);
+        TEST_ASSERT(graph.instantiate(client));
+        TEST_ASSERT(graph.launch());
+    }
+    // The graph's pins and images are gone
+    TEST_ASSERT_EQ(0, allocator.stats().allocatedBytes);
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+TEST_MAIN("libNVDAAL Command Graph Tests",
+    // Capture
+    TEST_CASE(test_graph_barriers),
+    TEST_CASE(test_graph_invalid),
+
+    // Replay
+    TEST_CASE(test_graph_launch),
+    TEST_CASE(test_graph_params),
+    TEST_CASE(test_graph_buffering_stall),
+    TEST_CASE(test_graph_keeps_buffers)
+)
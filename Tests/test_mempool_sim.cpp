@@ -0,0 +1,292 @@
+/**
+ * @file test_mempool_sim.cpp
+ * @brief Stream-ordered allocation with MemoryPool
+ *
+ * Runs MemoryPool on SimBackend: immediate reuse on the freeing stream,
+ * reuse by other streams once the free completes or behind a GPU-side
+ * wait, size fitting, release thresholds and trimming, and recovery when
+ * the allocator runs out of VRAM.
+ *
+ * Compile: make test-mempool-sim
+ * Run: ./Build/test_mempool_sim
+ */
+
+#include "nvdaal_test.h"
+#include "NVDAALMemoryPool.h"
+
+using namespace nvdaal;
+
+// A CommandBuffer that blocks its channel until `gate` reaches 1
+static void recordGate(CommandBuffer& cb, const Semaphore& gate) {
+    cb.begin();
+    cb.wait(gate, 1);
+    cb.end();
+}
+
+// ============================================================================
+// Reuse
+// ============================================================================
+
+void test_pool_same_stream(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    MemoryPool pool(allocator);
+    Semaphore gate;
+    TEST_ASSERT(client.createSemaphore(&gate));
+    CommandBuffer gated(allocator);
+    recordGate(gated, gate);
+    Stream stream(client, allocator);
+
+    Buffer a = pool.allocate(4096, stream);
+    TEST_ASSERT(a.valid());
+    uint64_t addr = a.gpuAddr();
+    TEST_ASSERT(stream.submit(gated));
+    TEST_ASSERT(pool.free(std::move(a), stream));
+    TEST_ASSERT(!a.valid());
+    uint64_t requested = allocator.stats().requestedBytes;
+
+    // Still in use on the GPU, but only by work this stream runs first
+    Buffer b = pool.allocate(3000, stream);
+    TEST_ASSERT_EQ(addr, b.gpuAddr());
+    TEST_ASSERT_EQ(3000, b.size());
+    TEST_ASSERT_EQ(requested - 4096 + 3000, allocator.stats().requestedBytes);
+
+    MemoryPoolStats s = pool.stats();
+    TEST_ASSERT_EQ(2, s.allocations);
+    TEST_ASSERT_EQ(1, s.allocatorCalls);
+    TEST_ASSERT_EQ(1, s.reusedSameStream);
+    TEST_ASSERT_EQ(0, s.cachedBytes);
+    TEST_ASSERT_EQ(4096, s.peakCachedBytes);
+
+    TEST_ASSERT(client.signalSemaphore(gate, 1));
+}
+
+void test_pool_other_stream_completed(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    MemoryPool pool(allocator);
+    Semaphore gate;
+    TEST_ASSERT(client.createSemaphore(&gate));
+    CommandBuffer gated(allocator);
+    recordGate(gated, gate);
+    Stream producer(client, allocator, 0);
+    Stream consumer(client, allocator, 1);
+
+    Buffer a = pool.allocate(8192, producer);
+    uint64_t addr = a.gpuAddr();
+    TEST_ASSERT(producer.submit(gated));
+    TEST_ASSERT(pool.free(std::move(a), producer));
+
+    // Pending on another stream: not handed out
+    Buffer b = pool.allocate(8192, consumer);
+    TEST_ASSERT(b.valid());
+    TEST_ASSERT_NEQ(addr, b.gpuAddr());
+
+    TEST_ASSERT(client.signalSemaphore(gate, 1));
+    TEST_ASSERT(producer.synchronize());
+    Buffer c = pool.allocate(8192, consumer);
+    TEST_ASSERT_EQ(addr, c.gpuAddr());
+
+    MemoryPoolStats s = pool.stats();
+    TEST_ASSERT_EQ(2, s.allocatorCalls);
+    TEST_ASSERT_EQ(1, s.reusedCompleted);
+    TEST_ASSERT_EQ(0, s.reusedWithWait);
+}
+
+void test_pool_reuse_with_wait(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    MemoryPoolConfig config;
+    config.reuseWithWait = true;
+    MemoryPool pool(allocator, config);
+    Semaphore gate;
+    TEST_ASSERT(client.createSemaphore(&gate));
+    CommandBuffer gated(allocator);
+    recordGate(gated, gate);
+    Stream producer(client, allocator, 0);
+    Stream consumer(client, allocator, 1);
+
+    Buffer a = pool.allocate(8192, producer);
+    uint64_t addr = a.gpuAddr();
+    TEST_ASSERT(producer.submit(gated));
+    TEST_ASSERT(pool.free(std::move(a), producer));
+
+    // Handed over at once; the consumer's next work waits for the free
+    Buffer b = pool.allocate(8192, consumer);
+    TEST_ASSERT_EQ(addr, b.gpuAddr());
+    TEST_ASSERT_EQ(1, pool.stats().reusedWithWait);
+
+    CommandBuffer work(allocator);
+    TEST_ASSERT(work.barrier() && work.end());
+    TEST_ASSERT(consumer.submit(work));
+    TEST_ASSERT(!consumer.synchronize(30));
+    TEST_ASSERT_EQ(1, consumer.stats().acquires);
+
+    TEST_ASSERT(client.signalSemaphore(gate, 1));
+    TEST_ASSERT(consumer.synchronize(1000));
+}
+
+void test_pool_size_fit(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    MemoryPool pool(allocator);
+    Stream stream(client, allocator);
+
+    Buffer big = pool.allocate(4096, stream);
+    uint64_t addr = big.gpuAddr();
+    TEST_ASSERT(pool.free(std::move(big), stream));
+
+    Buffer tiny = pool.allocate(1024, stream);             // Would waste more than half
+    TEST_ASSERT_NEQ(addr, tiny.gpuAddr());
+    Buffer fits = pool.allocate(2500, stream);             // Rounds to 2560: >= half of 4096
+    TEST_ASSERT_EQ(addr, fits.gpuAddr());
+    TEST_ASSERT_EQ(4096, fits.capacity());
+    TEST_ASSERT_EQ(2500, fits.size());
+
+    // Zero bytes never allocates
+    TEST_ASSERT(!pool.allocate(0, stream).valid());
+    TEST_ASSERT_EQ(3, pool.stats().allocations);
+}
+
+// ============================================================================
+// Trimming
+// ============================================================================
+
+void test_pool_release_threshold(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    MemoryPoolConfig config;
+    config.releaseThreshold = 8192;
+    MemoryPool pool(allocator, config);
+    Stream stream(client, allocator);                      // Nothing submitted: frees complete at once
+
+    Buffer buffers[4];
+    for (Buffer& b : buffers) b = pool.allocate(4096, stream);
+    uint64_t allocatorFrees = allocator.stats().frees;
+    for (Buffer& b : buffers) TEST_ASSERT(pool.free(std::move(b), stream));
+
+    MemoryPoolStats s = pool.stats();
+    TEST_ASSERT_EQ(8192, s.cachedBytes);
+    TEST_ASSERT_EQ(2, s.trimmed);
+    TEST_ASSERT_EQ(allocatorFrees + 2, allocator.stats().frees);
+
+    pool.setReleaseThreshold(4096);
+    TEST_ASSERT_EQ(4096, pool.stats().cachedBytes);
+    TEST_ASSERT_EQ(4096, pool.trim());
+    TEST_ASSERT_EQ(0, pool.stats().cachedBytes);
+}
+
+void test_pool_trim_keeps_pending(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    MemoryPool pool(allocator);
+    Semaphore gate;
+    TEST_ASSERT(client.createSemaphore(&gate));
+    CommandBuffer gated(allocator);
+    recordGate(gated, gate);
+    Stream idle(client, allocator, 0);
+    Stream busy(client, allocator, 1);
+
+    Buffer done = pool.allocate(4096, idle);
+    Buffer inUse = pool.allocate(65536, busy);
+    TEST_ASSERT(pool.free(std::move(done), idle));
+    TEST_ASSERT(busy.submit(gated));
+    TEST_ASSERT(pool.free(std::move(inUse), busy));
+
+    TEST_ASSERT_EQ(4096, pool.trim());                     // The GPU may still touch the other
+    TEST_ASSERT_EQ(65536, pool.stats().cachedBytes);
+
+    TEST_ASSERT(client.signalSemaphore(gate, 1));
+    TEST_ASSERT(busy.synchronize());
+    TEST_ASSERT_EQ(65536, pool.trim());
+    TEST_ASSERT_EQ(2, pool.stats().trimmed);
+}
+
+void test_pool_out_of_memory(void) {
+    SimConfig sim;
+    sim.vramBytes = 32ULL << 20;
+    Client client(makeSimBackend(sim));
+    BufferAllocator allocator(client);
+    MemoryPool pool(allocator);
+    Stream stream(client, allocator);
+
+    // The cached 16 MiB block can't serve 4 MiB, and there's no room for a
+    // new slab until the pool gives it back
+    Buffer big = pool.allocate(16 << 20, stream);
+    TEST_ASSERT(big.valid());
+    TEST_ASSERT(pool.free(std::move(big), stream));
+    Buffer small = pool.allocate(4 << 20, stream);
+    TEST_ASSERT(small.valid());
+
+    MemoryPoolStats s = pool.stats();
+    TEST_ASSERT_EQ(1, s.trimmed);
+    TEST_ASSERT_EQ(0, s.failures);
+    TEST_ASSERT(!pool.allocate(64 << 20, stream).valid());
+    TEST_ASSERT_EQ(1, pool.stats().failures);
+}
+
+void test_pool_wait_when_full(void) {
+    SimConfig sim;
+    sim.vramBytes = 16ULL << 20;
+    Client client(makeSimBackend(sim));
+    BufferAllocator allocator(client);
+    MemoryPool pool(allocator);
+    Semaphore gate;
+    TEST_ASSERT(client.createSemaphore(&gate));
+    CommandBuffer gated(allocator);
+    recordGate(gated, gate);
+    Stream producer(client, allocator, 0);
+    Stream consumer(client, allocator, 1);
+
+    Buffer a = pool.allocate(12 << 20, producer);
+    uint64_t addr = a.gpuAddr();
+    TEST_ASSERT(producer.submit(gated));
+    TEST_ASSERT(pool.free(std::move(a), producer));
+
+    // No room for another: the pending block is the only way to serve it
+    Buffer b = pool.allocate(12 << 20, consumer);
+    TEST_ASSERT_EQ(addr, b.gpuAddr());
+    MemoryPoolStats s = pool.stats();
+    TEST_ASSERT_EQ(1, s.reusedWithWait);
+    TEST_ASSERT_EQ(0, s.failures);
+
+    CommandBuffer work(allocator);
+    TEST_ASSERT(work.barrier() && work.end());
+    TEST_ASSERT(consumer.submit(work));
+    TEST_ASSERT(!consumer.synchronize(30));
+    TEST_ASSERT(client.signalSemaphore(gate, 1));
+    TEST_ASSERT(consumer.synchronize(1000));
+}
+
+void test_pool_foreign_buffer(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    BufferAllocator other(client);
+    MemoryPool pool(allocator);
+    Stream stream(client, allocator);
+
+    Buffer b = other.allocate(4096);
+    TEST_ASSERT(!pool.free(std::move(b), stream));
+    TEST_ASSERT(b.valid());                                // Left with the caller
+    TEST_ASSERT(pool.free(Buffer(), stream));
+    TEST_ASSERT_EQ(0, pool.stats().frees);
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+TEST_MAIN("libNVDAAL Memory Pool Tests",
+    // Reuse
+    TEST_CASE(test_pool_same_stream),
+    TEST_CASE(test_pool_other_stream_completed),
+    TEST_CASE(test_pool_reuse_with_wait),
+    TEST_CASE(test_pool_size_fit),
+
+    // Trimming
+    TEST_CASE(test_pool_release_threshold),
+    TEST_CASE(test_pool_trim_keeps_pending),
+    TEST_CASE(test_pool_out_of_memory),
+    TEST_CASE(test_pool_wait_when_full),
+    TEST_CASE(test_pool_foreign_buffer)
+)
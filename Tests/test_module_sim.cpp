@@ -0,0 +1,400 @@
+/**
+ * @file test_module_sim.cpp
+ * @brief Cubin and fatbin parsing, upload and the module cache
+ *
+ * Parses synthetic cubins (nvdaal_cubin.h): kernel entries, register and
+ * stack sizes, parameter layouts, shared memory and constant banks,
+ * fatbin SM selection, and the images the loader must reject. Uploads
+ * run against SimBackend and are checked by copying the code back out of
+ * fake VRAM.
+ *
+ * Compile: make test-module-sim
+ * Run: ./Build/test_module_sim
+ */
+
+#include "nvdaal_test.h"
+#include "nvdaal_cubin.h"
+#include "NVDAALModule.h"
+#include "NVDAALCommandBuffer.h"
+#include <thread>
+#include <unistd.h>
+
+using namespace nvdaal;
+using cubin::TestKernel;
+
+static std::vector<TestKernel> sampleKernels() {
+    std::vector<TestKernel> kernels(3);
+    kernels[0].name = "vector_add";
+    kernels[0].registers = 16;
+    kernels[0].paramSizes = { 8, 8, 8, 4 };
+    kernels[1].name = "_Z6reducePKfPfi";
+    kernels[1].codeBytes = 1000;
+    kernels[1].registers = 40;
+    kernels[1].sharedBytes = 4096;
+    kernels[1].stackBytes = 64;
+    kernels[1].maxThreads = 256;
+    kernels[1].paramSizes = { 8, 8, 4 };
+    kernels[1].constant2 = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    kernels[2].name = "no_params";
+    return kernels;
+}
+
+// Copy `bytes` at `gpuAddr` back out of fake VRAM
+static bool readBack(Client& client, BufferAllocator& allocator, uint64_t gpuAddr, void *out, uint32_t bytes) {
+    Buffer dst = allocator.allocate(bytes);
+    CommandBuffer cb(allocator);
+    Semaphore sem;
+    if (!client.createSemaphore(&sem)) return false;
+    bool ok = cb.copy(dst.gpuAddr(), gpuAddr, bytes) && cb.signal(sem, 1) && cb.end() &&
+              client.submit(cb) && client.waitSemaphore(sem, 1, 1000);
+    if (ok) memcpy(out, dst.cpu(), bytes);
+    client.destroySemaphore(sem);
+    return ok;
+}
+
+// ============================================================================
+// Parsing
+// ============================================================================
+
+void test_module_hash(void) {
+    TEST_ASSERT_EQ(0xEF46DB3751D8E999ULL, moduleHash("", 0));
+    TEST_ASSERT_EQ(0x44BC2CF5AD770999ULL, moduleHash("abc", 3));
+    const char *fox = "The quick brown fox jumps over the lazy dog";
+    TEST_ASSERT_EQ(0x0B242D361FDA71BCULL, moduleHash(fox, strlen(fox)));
+
+    std::vector<uint8_t> bytes;
+    for (int r = 0; r < 3; r++) {
+        for (int i = 0; i < 256; i++) bytes.push_back((uint8_t)i);
+    }
+    bytes.insert(bytes.end(), { 'x', 'y', 'z' });
+    TEST_ASSERT_EQ(0xE921A1B45BD779F8ULL, moduleHash(bytes.data(), bytes.size()));
+}
+
+void test_module_parse_kernels(void) {
+    std::vector<TestKernel> kernels = sampleKernels();
+    std::vector<uint8_t> image = cubin::buildCubin(kernels);
+
+    Module module;
+    TEST_ASSERT(module.parse(image.data(), image.size()));
+    TEST_ASSERT(module.parsed());
+    TEST_ASSERT(!module.uploaded());
+    TEST_ASSERT_EQ(89, module.arch());
+    TEST_ASSERT_EQ(moduleHash(image.data(), image.size()), module.hash());
+    TEST_ASSERT_EQ(3, module.kernels().size());
+
+    const Kernel *add = module.kernel("vector_add");
+    TEST_ASSERT(add != nullptr);
+    TEST_ASSERT_EQ(0, strcmp("vector_add", add->name));
+    TEST_ASSERT_EQ(256, add->codeBytes);
+    TEST_ASSERT_EQ(0, add->codeOffset % 128);
+    TEST_ASSERT_EQ(16, add->registers);
+    TEST_ASSERT_EQ(0, add->sharedBytes);
+    TEST_ASSERT_EQ(0x160, add->paramBase);
+    TEST_ASSERT_EQ(28, add->paramBytes);
+    TEST_ASSERT_EQ(4, add->paramCount);
+    for (uint32_t i = 0; i < add->paramCount; i++) {
+        TEST_ASSERT_EQ(i, add->params[i].ordinal);             // Sorted though listed last first
+        TEST_ASSERT_EQ(cubin::paramOffset(kernels[0], i), add->params[i].offset);
+        TEST_ASSERT_EQ(kernels[0].paramSizes[i], add->params[i].size);
+    }
+    TEST_ASSERT_EQ(0, add->codeAddr);
+
+    const Kernel *reduce = module.kernel("_Z6reducePKfPfi");
+    TEST_ASSERT(reduce != nullptr);
+    TEST_ASSERT_EQ(1000, reduce->codeBytes);
+    TEST_ASSERT_EQ(40, reduce->registers);
+    TEST_ASSERT_EQ(4096, reduce->sharedBytes);
+    TEST_ASSERT_EQ(64, reduce->localBytes);
+    TEST_ASSERT_EQ(256, reduce->maxThreads);
+    TEST_ASSERT_EQ(20, reduce->paramBytes);
+    TEST_ASSERT_EQ(2, reduce->bankCount);
+    TEST_ASSERT_EQ(0, reduce->banks[0].bank);
+    TEST_ASSERT_EQ(ConstantBank::kNoData, reduce->bank(0)->imageOffset);    // Filled per launch
+    TEST_ASSERT_EQ(0x160 + 20, reduce->bank(0)->size);
+    TEST_ASSERT(reduce->bank(2) != nullptr);
+    TEST_ASSERT_EQ(8, reduce->bank(2)->size);
+    TEST_ASSERT_EQ(0, reduce->bank(2)->imageOffset % 256);
+    TEST_ASSERT(reduce->bank(3) == nullptr);
+
+    const Kernel *none = module.kernel("no_params");
+    TEST_ASSERT(none != nullptr);
+    TEST_ASSERT_EQ(0, none->paramCount);
+    TEST_ASSERT_EQ(0, none->paramBytes);
+    TEST_ASSERT(none->params == nullptr);
+
+    TEST_ASSERT(module.kernel("vector_ad") == nullptr);
+    TEST_ASSERT(module.kernel("") == nullptr);
+
+    // Code sections don't overlap
+    TEST_ASSERT(add->codeOffset + add->codeBytes <= reduce->codeOffset);
+    TEST_ASSERT(reduce->codeOffset + reduce->codeBytes <= none->codeOffset);
+}
+
+void test_module_device_functions(void) {
+    std::vector<TestKernel> kernels = sampleKernels();
+    cubin::CubinOptions options;
+    options.deviceFunction = true;
+    options.constant3 = std::vector<uint8_t>(300, 0x42);
+    std::vector<uint8_t> image = cubin::buildCubin(kernels, options);
+
+    Module module;
+    TEST_ASSERT(module.parse(image.data(), image.size()));
+    TEST_ASSERT_EQ(3, module.kernels().size());                 // The helper is no entry point
+    TEST_ASSERT(module.kernel("helper") == nullptr);
+
+    // Its code is still uploaded: kernels may call it
+    size_t code = 0;
+    for (const Kernel& k : module.kernels()) code += k.codeBytes;
+    TEST_ASSERT(module.imageBytes() >= code + 128 + 300);
+
+    TEST_ASSERT_EQ(1, module.constantBanks().size());
+    TEST_ASSERT_EQ(3, module.constantBanks()[0].bank);
+    TEST_ASSERT_EQ(300, module.constantBanks()[0].size);
+}
+
+void test_module_rejects(void) {
+    std::vector<TestKernel> kernels = sampleKernels();
+    std::vector<uint8_t> image = cubin::buildCubin(kernels);
+    Module module;
+
+    TEST_ASSERT(!module.parse(nullptr, 0));
+    TEST_ASSERT(!module.parse("not a cubin", 11));
+    TEST_ASSERT(!module.parse(image.data(), 63));               // Truncated header
+    TEST_ASSERT(!module.parse(image.data(), image.size() - 8)); // Truncated section table
+    TEST_ASSERT(!module.parsed());
+
+    // Another architecture, same major but newer, other major
+    cubin::CubinOptions options;
+    options.sm = 90;
+    std::vector<uint8_t> hopper = cubin::buildCubin(kernels, options);
+    TEST_ASSERT(!module.parse(hopper.data(), hopper.size()));
+    options.sm = 86;
+    std::vector<uint8_t> ampere = cubin::buildCubin(kernels, options);
+    TEST_ASSERT(module.parse(ampere.data(), ampere.size()));
+    TEST_ASSERT_EQ(86, module.arch());
+    TEST_ASSERT(!module.parse(ampere.data(), ampere.size(), 75));
+
+    // Relocations
+    options.sm = 89;
+    options.relocation = true;
+    std::vector<uint8_t> relocatable = cubin::buildCubin(kernels, options);
+    TEST_ASSERT(!module.parse(relocatable.data(), relocatable.size()));
+    TEST_ASSERT(!module.parsed());
+
+    // No entry points
+    std::vector<uint8_t> empty = cubin::buildCubin({});
+    TEST_ASSERT(!module.parse(empty.data(), empty.size()));
+
+    // Corrupt section offsets
+    std::vector<uint8_t> bad = image;
+    uint64_t shoff;
+    memcpy(&shoff, &bad[40], 8);
+    uint64_t huge = 1ULL << 40;
+    memcpy(&bad[shoff + 64 * 5 + 24], &huge, 8);                // Section 5's offset
+    TEST_ASSERT(!module.parse(bad.data(), bad.size()));
+}
+
+// ============================================================================
+// Fatbins
+// ============================================================================
+
+void test_fatbin_picks_newest_runnable(void) {
+    std::vector<TestKernel> kernels = sampleKernels();
+    cubin::CubinOptions options;
+    std::vector<cubin::FatbinEntry> entries;
+    for (uint32_t sm : { 75u, 80u, 86u, 89u, 90u }) {
+        options.sm = sm;
+        cubin::FatbinEntry e = { 2, sm, cubin::buildCubin(kernels, options) };
+        entries.push_back(e);
+    }
+    cubin::FatbinEntry ptx = { 1, 90, std::vector<uint8_t>(64, 'p') };
+    entries.insert(entries.begin(), ptx);
+    std::vector<uint8_t> fat = cubin::buildFatbin(entries);
+
+    Module module;
+    TEST_ASSERT(module.parse(fat.data(), fat.size()));
+    TEST_ASSERT_EQ(89, module.arch());
+    TEST_ASSERT_EQ(3, module.kernels().size());
+    TEST_ASSERT_EQ(moduleHash(fat.data(), fat.size()), module.hash());   // Of the whole fatbin
+
+    TEST_ASSERT(module.parse(fat.data(), fat.size(), 87));
+    TEST_ASSERT_EQ(86, module.arch());
+    TEST_ASSERT(module.parse(fat.data(), fat.size(), 75));
+    TEST_ASSERT_EQ(75, module.arch());
+
+    // Compressed entries are skipped, falling back to an older SM
+    entries[4].compressed = true;                               // sm_89
+    std::vector<uint8_t> compressed = cubin::buildFatbin(entries);
+    TEST_ASSERT(module.parse(compressed.data(), compressed.size()));
+    TEST_ASSERT_EQ(86, module.arch());
+
+    // PTX alone doesn't do
+    std::vector<uint8_t> ptxOnly = cubin::buildFatbin({ ptx });
+    TEST_ASSERT(!module.parse(ptxOnly.data(), ptxOnly.size()));
+
+    // An entry running past its container
+    std::vector<uint8_t> truncated(fat.begin(), fat.end() - 100);
+    TEST_ASSERT(!module.parse(truncated.data(), truncated.size()));
+}
+
+// ============================================================================
+// Upload and Cache
+// ============================================================================
+
+void test_module_upload(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    std::vector<TestKernel> kernels = sampleKernels();
+    cubin::CubinOptions options;
+    options.constant3 = std::vector<uint8_t>(64, 0x5A);
+    std::vector<uint8_t> image = cubin::buildCubin(kernels, options);
+
+    Module module;
+    TEST_ASSERT(!module.upload(allocator));                     // Nothing parsed
+    TEST_ASSERT(module.parse(image.data(), image.size()));
+    TEST_ASSERT(module.upload(allocator));
+    TEST_ASSERT(module.uploaded());
+    TEST_ASSERT(module.upload(allocator));                      // Once
+    TEST_ASSERT_EQ(1, allocator.stats().allocations);
+    TEST_ASSERT_NEQ(0, module.gpuAddr());
+
+    for (uint32_t k = 0; k < kernels.size(); k++) {
+        const Kernel *kernel = module.kernel(kernels[k].name.c_str());
+        TEST_ASSERT(kernel != nullptr);
+        TEST_ASSERT_EQ(module.gpuAddr() + kernel->codeOffset, kernel->codeAddr);
+        std::vector<uint8_t> code(kernel->codeBytes);
+        TEST_ASSERT(readBack(client, allocator, kernel->codeAddr, code.data(), kernel->codeBytes));
+        for (uint32_t i = 0; i < kernel->codeBytes; i++) TEST_ASSERT_EQ(cubin::codeByte(k, i), code[i]);
+    }
+
+    const Kernel *reduce = module.kernel("_Z6reducePKfPfi");
+    uint8_t c2[8];
+    TEST_ASSERT_NEQ(0, reduce->bank(2)->gpuAddr);
+    TEST_ASSERT_EQ(0, reduce->bank(2)->gpuAddr % 256);
+    TEST_ASSERT(readBack(client, allocator, reduce->bank(2)->gpuAddr, c2, 8));
+    TEST_ASSERT_EQ(0, memcmp(c2, kernels[1].constant2.data(), 8));
+    TEST_ASSERT_EQ(0, reduce->bank(0)->gpuAddr);
+
+    uint8_t c3[64];
+    TEST_ASSERT(readBack(client, allocator, module.constantBanks()[0].gpuAddr, c3, 64));
+    TEST_ASSERT_EQ(0x5A, c3[0]);
+    TEST_ASSERT_EQ(0x5A, c3[63]);
+}
+
+void test_loader_cache(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    ModuleLoader loader(allocator);
+    std::vector<TestKernel> kernels = sampleKernels();
+    std::vector<uint8_t> image = cubin::buildCubin(kernels);
+
+    std::shared_ptr<const Module> a = loader.load(image.data(), image.size());
+    TEST_ASSERT(a != nullptr);
+    TEST_ASSERT(a->uploaded());
+
+    // Same bytes from another buffer: the cached module, no new upload
+    std::vector<uint8_t> copy = image;
+    std::shared_ptr<const Module> b = loader.load(copy.data(), copy.size());
+    TEST_ASSERT(a == b);
+    TEST_ASSERT_EQ(1, allocator.stats().allocations);
+
+    // One byte of code different: a new module
+    std::vector<TestKernel> changed = kernels;
+    changed[0].registers = 17;
+    std::vector<uint8_t> other = cubin::buildCubin(changed);
+    std::shared_ptr<const Module> c = loader.load(other.data(), other.size());
+    TEST_ASSERT(c != nullptr && c != a);
+    TEST_ASSERT_EQ(17, c->kernel("vector_add")->registers);
+
+    TEST_ASSERT(loader.load("junk", 4) == nullptr);
+    TEST_ASSERT(loader.load(std::string("/nonexistent/module.cubin")) == nullptr);
+
+    ModuleLoaderStats s = loader.stats();
+    TEST_ASSERT_EQ(3, s.loads);
+    TEST_ASSERT_EQ(1, s.cacheHits);
+    TEST_ASSERT_EQ(2, s.failures);
+    TEST_ASSERT_EQ(2, s.modules);
+    TEST_ASSERT_EQ(6, s.kernels);
+    TEST_ASSERT_EQ(a->imageBytes() + c->imageBytes(), s.uploadedBytes);
+
+    // Only modules nobody holds are dropped
+    uint64_t kept = a->imageBytes();
+    c.reset();
+    TEST_ASSERT_EQ(1, loader.evict());
+    TEST_ASSERT_EQ(0, loader.evict());
+    TEST_ASSERT_EQ(1, loader.stats().modules);
+    TEST_ASSERT_EQ(kept, loader.stats().uploadedBytes);
+    TEST_ASSERT(loader.load(image.data(), image.size()) == a);
+}
+
+void test_loader_file(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    ModuleLoader loader(allocator);
+    std::vector<uint8_t> image = cubin::buildCubin(sampleKernels());
+
+    char path[] = "/tmp/nvdaal_module_XXXXXX";
+    int fd = mkstemp(path);
+    TEST_ASSERT(fd >= 0);
+    TEST_ASSERT_EQ((ssize_t)image.size(), write(fd, image.data(), image.size()));
+    close(fd);
+
+    std::shared_ptr<const Module> fromFile = loader.load(std::string(path));
+    unlink(path);
+    TEST_ASSERT(fromFile != nullptr);
+    TEST_ASSERT(loader.load(image.data(), image.size()) == fromFile);
+}
+
+void test_loader_threads(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    ModuleLoader loader(allocator);
+
+    // Eight threads load the same four modules
+    std::vector<std::vector<uint8_t>> images;
+    for (int m = 0; m < 4; m++) {
+        std::vector<TestKernel> kernels = sampleKernels();
+        kernels[0].registers = 10 + m;
+        images.push_back(cubin::buildCubin(kernels));
+    }
+    std::vector<std::thread> threads;
+    std::vector<const Module *> seen(8 * 4, nullptr);
+    for (int t = 0; t < 8; t++) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < 4; i++) {
+                int m = (t + i) % 4;
+                seen[t * 4 + m] = loader.load(images[m].data(), images[m].size()).get();
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    ModuleLoaderStats s = loader.stats();
+    TEST_ASSERT_EQ(4, s.modules);
+    TEST_ASSERT_EQ(32, s.loads);
+    TEST_ASSERT_EQ(28, s.cacheHits);
+    for (int t = 1; t < 8; t++) {
+        for (int m = 0; m < 4; m++) TEST_ASSERT(seen[t * 4 + m] == seen[m]);
+    }
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+TEST_MAIN("libNVDAAL Module Loader Tests",
+    // Parsing
+    TEST_CASE(test_module_hash),
+    TEST_CASE(test_module_parse_kernels),
+    TEST_CASE(test_module_device_functions),
+    TEST_CASE(test_module_rejects),
+
+    // Fatbins
+    TEST_CASE(test_fatbin_picks_newest_runnable),
+
+    // Upload and cache
+    TEST_CASE(test_module_upload),
+    TEST_CASE(test_loader_cache),
+    TEST_CASE(test_loader_file),
+    TEST_CASE(test_loader_threads)
+)
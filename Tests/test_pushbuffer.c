@@ -0,0 +1,245 @@
+/**
+ * @file test_pushbuffer.c
+ * @brief Unit tests for pushbuffer method encoding
+ *
+ * Verifies the header bit layout and the semaphore release/acquire
+ * sequences emitted by NVDAALPushbuffer.h against the host class
+ * (NVC56F) definitions.
+ *
+ * Compile: make test-pushbuffer
+ * Run: ./Build/test_pushbuffer
+ */
+
+#include "nvdaal_test.h"
+#include "../Sources/NVDAALPushbuffer.h"
+#include "../Sources/NVDAALUserShared.h"
+
+// ============================================================================
+// Header Encoding
+// ============================================================================
+
+void test_inc_header_layout(void) {
+    // SEC_OP=INC(1), count=5, subch=0, method=0x5C >> 2
+    TEST_ASSERT_EQ(0x20050017u, nvPbIncHeader(NV_PB_SUBCH_HOST, NVC56F_SEM_ADDR_LO, 5));
+}
+
+void test_subchannel_field(void) {
+    uint32_t hdr = nvPbIncHeader(NV_PB_SUBCH_COMPUTE, 0x0200, 1);
+    TEST_ASSERT_EQ(NV_PB_SUBCH_COMPUTE, (hdr >> NV_PB_HDR_SUBCH_SHIFT) & NV_PB_HDR_SUBCH_MASK);
+    TEST_ASSERT_EQ(0x0200 >> 2, hdr & NV_PB_HDR_ADDR_MASK);
+    TEST_ASSERT_EQ(1, (hdr >> NV_PB_HDR_COUNT_SHIFT) & NV_PB_HDR_COUNT_MASK);
+}
+
+void test_immediate_header(void) {
+    uint32_t hdr = nvPbImmdHeader(NV_PB_SUBCH_HOST, NVC56F_NON_STALL_INTERRUPT, 0);
+    TEST_ASSERT_EQ(NV_PB_SEC_OP_IMMD_DATA_METHOD, hdr >> NV_PB_HDR_SEC_OP_SHIFT);
+    TEST_ASSERT_EQ(NVC56F_NON_STALL_INTERRUPT >> 2, hdr & NV_PB_HDR_ADDR_MASK);
+}
+
+void test_push_method_picks_immediate(void) {
+    uint32_t buf[4];
+    NvPushbuffer pb;
+    nvPbInit(&pb, buf, sizeof(buf));
+
+    TEST_ASSERT(nvPbPushMethod(&pb, 1, 0x0100, 0x10));       // fits in 13 bits
+    TEST_ASSERT(nvPbPushMethod(&pb, 1, 0x0104, 0x12345));    // needs a data dword
+    TEST_ASSERT_EQ(3 * sizeof(uint32_t), nvPbBytesUsed(&pb));
+    TEST_ASSERT_EQ(NV_PB_SEC_OP_IMMD_DATA_METHOD, buf[0] >> NV_PB_HDR_SEC_OP_SHIFT);
+    TEST_ASSERT_EQ(NV_PB_SEC_OP_INC_METHOD, buf[1] >> NV_PB_HDR_SEC_OP_SHIFT);
+    TEST_ASSERT_EQ(0x12345, buf[2]);
+}
+
+// ============================================================================
+// Semaphores
+// ============================================================================
+
+void test_semaphore_release_encoding(void) {
+    uint32_t buf[NV_PB_SEMAPHORE_RELEASE_DWORDS];
+    NvPushbuffer pb;
+    nvPbInit(&pb, buf, sizeof(buf));
+
+    uint64_t va = 0x1000001230ULL;
+    uint64_t value = 0x0000000500000007ULL;
+    TEST_ASSERT(nvPbPushSemaphoreRelease(&pb, va, value, true));
+    TEST_ASSERT_EQ(sizeof(buf), nvPbBytesUsed(&pb));
+
+    TEST_ASSERT_EQ(nvPbIncHeader(NV_PB_SUBCH_HOST, NVC56F_SEM_ADDR_LO, 5), buf[0]);
+    TEST_ASSERT_EQ(0x00001230u, buf[1]);
+    TEST_ASSERT_EQ(0x10u, buf[2]);
+    TEST_ASSERT_EQ(7u, buf[3]);
+    TEST_ASSERT_EQ(5u, buf[4]);
+    TEST_ASSERT_EQ(NVC56F_SEM_EXECUTE_OPERATION_RELEASE, buf[5] & 0x7);
+    TEST_ASSERT(buf[5] & NVC56F_SEM_EXECUTE_RELEASE_WFI_EN);
+    TEST_ASSERT(buf[5] & NVC56F_SEM_EXECUTE_PAYLOAD_SIZE_64BIT);
+    TEST_ASSERT_EQ(nvPbImmdHeader(NV_PB_SUBCH_HOST, NVC56F_NON_STALL_INTERRUPT, 0), buf[6]);
+}
+
+void test_semaphore_acquire_encoding(void) {
+    uint32_t buf[NV_PB_SEMAPHORE_ACQUIRE_DWORDS];
+    NvPushbuffer pb;
+    nvPbInit(&pb, buf, sizeof(buf));
+
+    TEST_ASSERT(nvPbPushSemaphoreAcquire(&pb, 0x2000ULL, 42));
+    TEST_ASSERT_EQ(NVC56F_SEM_EXECUTE_OPERATION_ACQ_STRICT_GEQ, buf[5] & 0x7);
+    TEST_ASSERT(buf[5] & NVC56F_SEM_EXECUTE_ACQUIRE_SWITCH_TSG_EN);
+    TEST_ASSERT(buf[5] & NVC56F_SEM_EXECUTE_PAYLOAD_SIZE_64BIT);
+    TEST_ASSERT_EQ(42u, buf[3]);
+    TEST_ASSERT_EQ(0u, buf[4]);
+}
+
+void test_nop_carries_any_tag(void) {
+    uint32_t buf[NV_PB_NOP_DWORDS];
+    NvPushbuffer pb;
+    nvPbInit(&pb, buf, sizeof(buf));
+
+    // Even a value that decodes as a method header is only data here
+    uint32_t tag = nvPbIncHeader(NV_PB_SUBCH_COMPUTE, NVC9C0_SEND_PCAS_A, 1);
+    TEST_ASSERT(nvPbPushNop(&pb, tag));
+    TEST_ASSERT_EQ(nvPbIncHeader(NV_PB_SUBCH_HOST, NVC56F_NOP, 1), buf[0]);
+    TEST_ASSERT_EQ(tag, buf[1]);
+    TEST_ASSERT(!nvPbPushNop(&pb, 0));
+}
+
+void test_pushbuffer_overflow(void) {
+    uint32_t buf[NV_PB_SEMAPHORE_RELEASE_DWORDS - 1];
+    NvPushbuffer pb;
+    nvPbInit(&pb, buf, sizeof(buf));
+
+    // Release with interrupt needs 7 dwords; must fail without writing
+    TEST_ASSERT(!nvPbPushSemaphoreRelease(&pb, 0x1000ULL, 1, true));
+    TEST_ASSERT_EQ(0, nvPbBytesUsed(&pb));
+    TEST_ASSERT(nvPbPushSemaphoreRelease(&pb, 0x1000ULL, 1, false));
+}
+
+// ============================================================================
+// Compute and Copy
+// ============================================================================
+
+void test_barrier_encoding(void) {
+    uint32_t buf[NV_PB_BARRIER_DWORDS];
+    NvPushbuffer pb;
+    nvPbInit(&pb, buf, sizeof(buf));
+
+    TEST_ASSERT(nvPbPushBarrier(&pb));
+    TEST_ASSERT_EQ(nvPbImmdHeader(NV_PB_SUBCH_COMPUTE, NVC9C0_WAIT_FOR_IDLE, 0), buf[0]);
+    TEST_ASSERT_EQ(nvPbImmdHeader(NV_PB_SUBCH_HOST, NVC56F_WFI, NVC56F_WFI_SCOPE_ALL), buf[1]);
+    TEST_ASSERT(!nvPbPushBarrier(&pb));
+}
+
+void test_dispatch_encoding(void) {
+    uint32_t buf[NV_PB_DISPATCH_DWORDS];
+    NvPushbuffer pb;
+    nvPbInit(&pb, buf, sizeof(buf));
+
+    TEST_ASSERT(!nvPbPushDispatch(&pb, 0x200000080ULL));        // QMD must be 256-byte aligned
+    TEST_ASSERT_EQ(0, nvPbBytesUsed(&pb));
+    TEST_ASSERT(nvPbPushDispatch(&pb, 0x200001000ULL));
+    TEST_ASSERT_EQ(nvPbIncHeader(NV_PB_SUBCH_COMPUTE, NVC9C0_SEND_PCAS_A, 1), buf[0]);
+    TEST_ASSERT_EQ(0x2000010u, buf[1]);
+    TEST_ASSERT_EQ(3u, (buf[2] >> NV_PB_HDR_COUNT_SHIFT) & NV_PB_HDR_COUNT_MASK);
+}
+
+void test_copy_encoding(void) {
+    uint32_t buf[NV_PB_COPY_DWORDS];
+    NvPushbuffer pb;
+    nvPbInit(&pb, buf, sizeof(buf));
+
+    TEST_ASSERT(!nvPbPushCopy(&pb, 0x1000ULL, 0x2000ULL, 0));
+    TEST_ASSERT(nvPbPushCopy(&pb, 0x300001000ULL, 0x200002000ULL, 4096));
+    TEST_ASSERT_EQ(NV_PB_COPY_DWORDS * 4, nvPbBytesUsed(&pb));
+    TEST_ASSERT_EQ(nvPbIncHeader(NV_PB_SUBCH_COPY, NVC7B5_OFFSET_IN_UPPER, 8), buf[0]);
+    TEST_ASSERT_EQ(2u, buf[1]);
+    TEST_ASSERT_EQ(0x2000u, buf[2]);
+    TEST_ASSERT_EQ(3u, buf[3]);
+    TEST_ASSERT_EQ(0x1000u, buf[4]);
+    TEST_ASSERT_EQ(4096u, buf[7]);
+    TEST_ASSERT_EQ(1u, buf[8]);
+    TEST_ASSERT_EQ((uint32_t)NVC7B5_LAUNCH_DMA >> 2, buf[9] & NV_PB_HDR_ADDR_MASK);
+}
+
+// ============================================================================
+// Shared ABI
+// ============================================================================
+
+void test_semaphore_wait_args_layout(void) {
+    TEST_ASSERT_EQ(16, sizeof(NvdaalSemaphoreWaitEntry));
+    TEST_ASSERT_EQ(16 + 16 * NVDAAL_MAX_WAIT_SEMAPHORES, sizeof(NvdaalSemaphoreWaitArgs));
+    TEST_ASSERT_EQ(16 + 16 * 3, NVDAAL_SEMAPHORE_WAIT_ARGS_SIZE(3));
+}
+
+void test_vram_memory_type_encoding(void) {
+    uint32_t type = NVDAAL_MEMORY_VRAM(0x12345000ULL);
+    TEST_ASSERT(NVDAAL_MEMORY_IS_VRAM(type));
+    TEST_ASSERT(!NVDAAL_MEMORY_IS_VRAM(NVDAAL_MEMORY_COMMAND_RING));
+    TEST_ASSERT_EQ(0x12345000ULL, NVDAAL_MEMORY_VRAM_OFFSET(type));
+
+    // Top of a 24GB aperture still round-trips
+    uint64_t top = 24ULL * 1024 * 1024 * 1024 - 0x1000;
+    TEST_ASSERT_EQ(top, NVDAAL_MEMORY_VRAM_OFFSET(NVDAAL_MEMORY_VRAM(top)));
+}
+
+void test_pushbuffer_arg_encoding(void) {
+    uint64_t arg = NVDAAL_PUSHBUFFER_ARG(0x10000, 3);
+    TEST_ASSERT_EQ(0x10000, NVDAAL_PUSHBUFFER_ARG_BYTES(arg));
+    TEST_ASSERT_EQ(3, NVDAAL_PUSHBUFFER_ARG_CHANNEL(arg));
+
+    // Channel 0 keeps the old byte-count-only encoding
+    TEST_ASSERT_EQ(4096, NVDAAL_PUSHBUFFER_ARG(4096, 0));
+    TEST_ASSERT_EQ(0, NVDAAL_PUSHBUFFER_ARG_CHANNEL(4096));
+}
+
+void test_call_stats_layout(void) {
+    TEST_ASSERT_EQ(32 + 8 * NVDAAL_STATS_BUCKETS, sizeof(NvdaalSelectorStats));
+    TEST_ASSERT_EQ(16 + NVDAAL_STATS_MAX_SELECTORS * sizeof(NvdaalSelectorStats), sizeof(NvdaalStats));
+    TEST_ASSERT(strcmp("LoadFirmware", nvdaalMethodName(0)) == 0);
+    TEST_ASSERT(strcmp("GetStats", nvdaalMethodName(20)) == 0);
+    TEST_ASSERT(strcmp("Unknown", nvdaalMethodName(NVDAAL_STATS_MAX_SELECTORS)) == 0);
+}
+
+void test_call_stats_buckets(void) {
+    TEST_ASSERT_EQ(0, nvStatsBucket(999));              // < 1us
+    TEST_ASSERT_EQ(1, nvStatsBucket(1000));             // [1, 2) us
+    TEST_ASSERT_EQ(2, nvStatsBucket(3999));             // [2, 4) us
+    TEST_ASSERT_EQ(11, nvStatsBucket(1500000));         // [1024, 2048) us
+    TEST_ASSERT_EQ(NVDAAL_STATS_BUCKETS - 1, nvStatsBucket(10ULL * 1000 * 1000 * 1000));
+
+    NvdaalSelectorStats s;
+    memset(&s, 0, sizeof(s));
+    TEST_ASSERT_EQ(0, nvStatsPercentileUs(&s, 500));
+    s.calls = 100;
+    s.histogram[1] = 90;                                // 90 calls in [1, 2) us
+    s.histogram[5] = 10;                                // 10 calls in [16, 32) us
+    TEST_ASSERT_EQ(2, nvStatsPercentileUs(&s, 500));
+    TEST_ASSERT_EQ(2, nvStatsPercentileUs(&s, 900));
+    TEST_ASSERT_EQ(32, nvStatsPercentileUs(&s, 990));
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+TEST_MAIN("NVDAAL Pushbuffer Tests",
+    // Headers
+    TEST_CASE(test_inc_header_layout),
+    TEST_CASE(test_subchannel_field),
+    TEST_CASE(test_immediate_header),
+    TEST_CASE(test_push_method_picks_immediate),
+
+    // Semaphores
+    TEST_CASE(test_semaphore_release_encoding),
+    TEST_CASE(test_semaphore_acquire_encoding),
+    TEST_CASE(test_nop_carries_any_tag),
+    TEST_CASE(test_pushbuffer_overflow),
+
+    // Compute and copy
+    TEST_CASE(test_barrier_encoding),
+    TEST_CASE(test_dispatch_encoding),
+    TEST_CASE(test_copy_encoding),
+
+    // Shared ABI
+    TEST_CASE(test_semaphore_wait_args_layout),
+    TEST_CASE(test_vram_memory_type_encoding),
+    TEST_CASE(test_pushbuffer_arg_encoding),
+    TEST_CASE(test_call_stats_layout),
+    TEST_CASE(test_call_stats_buckets)
+)
@@ -0,0 +1,350 @@
+/**
+ * @file test_qmd_sim.cpp
+ * @brief Compute launch descriptors: field layout, templates and the cache
+ *
+ * Checks the QMD V03_00 field table (no overlaps, every field inside one
+ * dword), builds templates from kernels of synthetic cubins (nvdaal_cubin.h)
+ * uploaded to SimBackend, and compares encode()'s patched descriptors with
+ * the fields a launch should carry. The encoded QMDs are then dispatched
+ * through a CommandBuffer.
+ *
+ * Compile: make test-qmd-sim
+ * Run: ./Build/test_qmd_sim
+ */
+
+#include "nvdaal_sim_test.h"
+#include "nvdaal_cubin.h"
+#include "NVDAALQmd.h"
+#include "NVDAALCommandBuffer.h"
+#include <thread>
+
+using namespace nvdaal;
+using cubin::TestKernel;
+
+static std::vector<TestKernel> sampleKernels() {
+    std::vector<TestKernel> kernels(2);
+    kernels[0].name = "saxpy";
+    kernels[0].registers = 24;
+    kernels[0].paramSizes = { 4, 8, 8, 4 };
+    kernels[1].name = "_Z6reducePKfPfi";
+    kernels[1].registers = 40;
+    kernels[1].sharedBytes = 4096;
+    kernels[1].stackBytes = 40;
+    kernels[1].maxThreads = 256;
+    kernels[1].paramSizes = { 8, 8, 4 };
+    kernels[1].constant2 = std::vector<uint8_t>(32, 7);
+    return kernels;
+}
+
+struct Loaded {
+    Client client;
+    BufferAllocator allocator;
+    Module module;
+
+    Loaded() : client(makeSimBackend()), allocator(client) {
+        cubin::CubinOptions options;
+        options.constant3 = std::vector<uint8_t>(100, 3);
+        std::vector<uint8_t> image = cubin::buildCubin(sampleKernels(), options);
+        module.parse(image.data(), image.size());
+        module.upload(allocator);
+    }
+};
+
+// ============================================================================
+// Field Layout
+// ============================================================================
+
+// Positions as clc6c0qmd.h gives them, fixed at compile time
+static_assert(qmd::CtaRasterWidth::word == 12 && qmd::CtaRasterWidth::mask == 0xFFFFFFFFu, "");
+static_assert(qmd::CtaRasterHeight::word == 13 && qmd::CtaRasterHeight::max == 0xFFFF, "");
+static_assert(qmd::QmdMajorVersion::word == 18 && qmd::QmdMajorVersion::shift == 4, "");
+static_assert(qmd::ConstantBufferAddrLower<0>::word == 32 && qmd::ConstantBufferAddrLower<7>::word == 46, "");
+static_assert(qmd::ConstantBufferSizeShifted4<3>::mask == 0xFFF80000u, "");
+static_assert(qmd::ConstantBufferValid<5>::word == 20 && qmd::ConstantBufferValid<5>::shift == 5, "");
+static_assert(qmd::ProgramAddressUpper::word == 52 && qmd::ProgramAddressUpper::max == 0x1FFFF, "");
+
+void test_qmd_field_table(void) {
+    // Every field, banks expanded, claims bits no other field does
+    uint32_t owned[kQmdDwords] = {};
+    uint32_t fields = 0;
+    for (const qmd::FieldInfo& f : qmd::kFields) {
+        uint32_t copies = f.stride ? qmd::kConstantBanks : 1;
+        for (uint32_t b = 0; b < copies; b++) {
+            uint32_t lo = f.lo + b * f.stride, hi = f.hi + b * f.stride;
+            TEST_ASSERT(hi < kQmdBytes * 8);
+            TEST_ASSERT_EQ(lo / 32, hi / 32);
+            for (uint32_t bit = lo; bit <= hi; bit++) {
+                TEST_ASSERT_EQ(0, owned[bit / 32] & (1u << (bit % 32)));
+                owned[bit / 32] |= 1u << (bit % 32);
+            }
+            fields++;
+        }
+    }
+    TEST_ASSERT_EQ(29 + 4 * 8, fields);
+}
+
+void test_qmd_field_set_get(void) {
+    uint32_t q[kQmdDwords];
+    memset(q, 0xFF, sizeof(q));
+    qmd::CtaRasterHeight::set(q, 0x12345);                      // Wider than the field: masked
+    TEST_ASSERT_EQ(0x2345, qmd::CtaRasterHeight::get(q));
+    TEST_ASSERT_EQ(0xFFFF2345u, q[13]);                          // Reserved half untouched
+
+    memset(q, 0, sizeof(q));
+    qmd::ConstantBufferSizeShifted4<1>::set(q, 0x1FFF);
+    qmd::ConstantBufferAddrUpper<1>::set(q, 0x1ABCD);
+    TEST_ASSERT_EQ(0xFFF9ABCDu, q[35]);
+    qmd::ConstantBufferValid<6>::set(q, 1);
+    TEST_ASSERT_EQ(1u << 6, q[20]);
+
+    // The runtime reader agrees with the compile-time one
+    for (const qmd::FieldInfo& f : qmd::kFields) {
+        if (strcmp(f.name, "ConstantBufferAddrUpper") == 0) TEST_ASSERT_EQ(0x1ABCD, qmd::read(q, f, 1));
+        if (strcmp(f.name, "ConstantBufferSizeShifted4") == 0) TEST_ASSERT_EQ(0x1FFF, qmd::read(q, f, 1));
+        if (strcmp(f.name, "ConstantBufferValid") == 0) TEST_ASSERT_EQ(1, qmd::read(q, f, 6));
+    }
+}
+
+// ============================================================================
+// Templates
+// ============================================================================
+
+void test_qmd_template_fields(void) {
+    Loaded l;
+    TEST_ASSERT(l.module.uploaded());
+    const Kernel *reduce = l.module.kernel("_Z6reducePKfPfi");
+
+    QmdTemplate t;
+    TEST_ASSERT(!t.valid());
+    TEST_ASSERT(t.init(l.module, *reduce, 128, 2, 1, 20000));
+    TEST_ASSERT(t.valid());
+    TEST_ASSERT(t.kernel() == reduce);
+    const uint32_t *q = t.words();
+
+    TEST_ASSERT_EQ(0, qmd::QmdVersion::get(q));
+    TEST_ASSERT_EQ(3, qmd::QmdMajorVersion::get(q));
+    TEST_ASSERT_EQ(reduce->codeAddr,
+                   (uint64_t)qmd::ProgramAddressUpper::get(q) << 32 | qmd::ProgramAddressLower::get(q));
+    TEST_ASSERT_EQ(128, qmd::CtaThreadDimension0::get(q));
+    TEST_ASSERT_EQ(2, qmd::CtaThreadDimension1::get(q));
+    TEST_ASSERT_EQ(1, qmd::CtaThreadDimension2::get(q));
+    TEST_ASSERT_EQ(40, qmd::RegisterCount::get(q));
+    TEST_ASSERT_EQ(1, qmd::BarrierCount::get(q));
+    TEST_ASSERT_EQ(48, qmd::ShaderLocalMemoryLowSize::get(q));  // 40 bytes of stack, 16-byte granules
+
+    // 4096 static + 20000 dynamic, 256-byte granules; a 32 KiB carveout
+    TEST_ASSERT_EQ(24320, qmd::SharedMemorySize::get(q));
+    TEST_ASSERT_EQ(32 / 4 + 1, qmd::TargetSmConfigSharedMemSize::get(q));
+    TEST_ASSERT_EQ(8 / 4 + 1, qmd::MinSmConfigSharedMemSize::get(q));
+    TEST_ASSERT_EQ(100 / 4 + 1, qmd::MaxSmConfigSharedMemSize::get(q));
+    TEST_ASSERT_EQ(1, qmd::InvalidateShaderConstantCache::get(q));
+
+    // Bank 0: sized for the parameter block, address left for encode()
+    TEST_ASSERT_EQ(1, qmd::ConstantBufferValid<0>::get(q));
+    TEST_ASSERT_EQ((reduce->paramBase + reduce->paramBytes + 15) / 16, qmd::ConstantBufferSizeShifted4<0>::get(q));
+    TEST_ASSERT_EQ(t.paramBankBytes(), qmd::ConstantBufferSizeShifted4<0>::get(q) * 16);
+    TEST_ASSERT_EQ(0, qmd::ConstantBufferAddrLower<0>::get(q));
+
+    // The kernel's bank 2 and the module-wide bank 3 are bound; others not
+    const ConstantBank *c2 = reduce->bank(2);
+    TEST_ASSERT_EQ(1, qmd::ConstantBufferValid<2>::get(q));
+    TEST_ASSERT_EQ((uint32_t)c2->gpuAddr, qmd::ConstantBufferAddrLower<2>::get(q));
+    TEST_ASSERT_EQ((uint32_t)(c2->gpuAddr >> 32), qmd::ConstantBufferAddrUpper<2>::get(q));
+    TEST_ASSERT_EQ(2, qmd::ConstantBufferSizeShifted4<2>::get(q));
+    const ConstantBank& c3 = l.module.constantBanks()[0];
+    TEST_ASSERT_EQ(3, c3.bank);
+    TEST_ASSERT_EQ(1, qmd::ConstantBufferValid<3>::get(q));
+    TEST_ASSERT_EQ((uint32_t)c3.gpuAddr, qmd::ConstantBufferAddrLower<3>::get(q));
+    TEST_ASSERT_EQ(7, qmd::ConstantBufferSizeShifted4<3>::get(q));   // 100 bytes
+    TEST_ASSERT_EQ(0, qmd::ConstantBufferValid<1>::get(q));
+    TEST_ASSERT_EQ(0, qmd::ConstantBufferValid<4>::get(q));
+
+    // Rebinding a bank by hand
+    TEST_ASSERT(t.bindBank(4, 0x300000000ULL, 4096));
+    TEST_ASSERT_EQ(1, qmd::ConstantBufferValid<4>::get(q));
+    TEST_ASSERT_EQ(3, qmd::ConstantBufferAddrUpper<4>::get(q));
+    TEST_ASSERT_EQ(256, qmd::ConstantBufferSizeShifted4<4>::get(q));
+    TEST_ASSERT(!t.bindBank(0, 0x300000000ULL, 256));           // Bank 0 is encode()'s
+    TEST_ASSERT(!t.bindBank(8, 0x300000000ULL, 256));
+    TEST_ASSERT(!t.bindBank(4, 0x300000080ULL, 256));           // Misaligned
+    TEST_ASSERT(!t.bindBank(4, 0x300000000ULL, 65537));
+}
+
+void test_qmd_template_rejects(void) {
+    Loaded l;
+    const Kernel *saxpy = l.module.kernel("saxpy");
+    const Kernel *reduce = l.module.kernel("_Z6reducePKfPfi");
+    QmdTemplate t;
+
+    TEST_ASSERT(t.init(l.module, *saxpy, 1024));
+    TEST_ASSERT(!t.init(l.module, *saxpy, 1025));               // Over the CTA limit
+    TEST_ASSERT(!t.valid());                                    // A failed init() leaves nothing behind
+    TEST_ASSERT(!t.init(l.module, *saxpy, 0));
+    TEST_ASSERT(!t.init(l.module, *saxpy, 1, 1, 65));           // z is at most 64
+    TEST_ASSERT(t.init(l.module, *reduce, 256));
+    TEST_ASSERT(!t.init(l.module, *reduce, 512));               // __launch_bounds__(256)
+    TEST_ASSERT(!t.init(l.module, *reduce, 64, 1, 1, 99 << 10)); // Shared memory past 99 KiB
+
+    // Registers: 255 per thread fits 256 threads, not 512
+    std::vector<TestKernel> heavy(1);
+    heavy[0].name = "heavy";
+    heavy[0].registers = 255;
+    std::vector<uint8_t> image = cubin::buildCubin(heavy);
+    Module module;
+    TEST_ASSERT(module.parse(image.data(), image.size()));
+    TEST_ASSERT(!t.init(module, *module.kernel("heavy"), 32));  // Not uploaded
+    TEST_ASSERT(module.upload(l.allocator));
+    TEST_ASSERT(t.init(module, *module.kernel("heavy"), 256));
+    TEST_ASSERT(!t.init(module, *module.kernel("heavy"), 512));
+}
+
+void test_qmd_encode(void) {
+    Loaded l;
+    const Kernel *saxpy = l.module.kernel("saxpy");
+    QmdTemplate t;
+    uint32_t q[kQmdDwords];
+    TEST_ASSERT(!t.encode(q, 1, 1, 1, 0));                      // Not initialized
+    TEST_ASSERT(t.init(l.module, *saxpy, 256));
+
+    uint64_t params = 0x2000ABC00ULL;
+    memset(q, 0xEE, sizeof(q));
+    TEST_ASSERT(t.encode(q, 100000, 3, 2, params));
+    TEST_ASSERT_EQ(100000, qmd::CtaRasterWidth::get(q));
+    TEST_ASSERT_EQ(3, qmd::CtaRasterHeight::get(q));
+    TEST_ASSERT_EQ(2, qmd::CtaRasterDepth::get(q));
+    TEST_ASSERT_EQ(0x000ABC00u, qmd::ConstantBufferAddrLower<0>::get(q));
+    TEST_ASSERT_EQ(2, qmd::ConstantBufferAddrUpper<0>::get(q));
+
+    // Only the grid and bank 0's address differ from the template, and the
+    // first launch also invalidates the instruction cache (same dword as
+    // the other cache invalidates)
+    TEST_ASSERT_EQ(0, qmd::InvalidateInstructionCache::get(t.words()));
+    TEST_ASSERT_EQ(1, qmd::InvalidateInstructionCache::get(q));
+    uint32_t changed = 0;
+    for (uint32_t i = 0; i < kQmdDwords; i++) changed += q[i] != t.words()[i];
+    TEST_ASSERT_EQ(6, changed);
+    TEST_ASSERT_EQ(t.paramBankBytes() / 16, qmd::ConstantBufferSizeShifted4<0>::get(q));
+
+    // A second launch through the same template leaves nothing of the first
+    TEST_ASSERT(t.encode(q, 1, 1, 1, 0x100ULL));
+    TEST_ASSERT_EQ(1, qmd::CtaRasterWidth::get(q));
+    TEST_ASSERT_EQ(1, qmd::CtaRasterDepth::get(q));
+    TEST_ASSERT_EQ(0, qmd::ConstantBufferAddrUpper<0>::get(q));
+    TEST_ASSERT_EQ(0, qmd::InvalidateInstructionCache::get(q));
+
+    // Every init() starts over
+    TEST_ASSERT(t.init(l.module, *saxpy, 128));
+    TEST_ASSERT(t.encode(q, 1, 1, 1, params));
+    TEST_ASSERT_EQ(1, qmd::InvalidateInstructionCache::get(q));
+
+    TEST_ASSERT(t.encode(q, 0xFFFFFFFFu, 65535, 65535, params));
+    TEST_ASSERT(!t.encode(q, 0, 1, 1, params));
+    TEST_ASSERT(!t.encode(q, 1, 0, 1, params));
+    TEST_ASSERT(!t.encode(q, 1, 65536, 1, params));
+    TEST_ASSERT(!t.encode(q, 1, 1, 65536, params));
+    TEST_ASSERT(!t.encode(q, 1, 1, 1, params + 0x40));          // Bank 0 misaligned
+}
+
+void test_qmd_dispatch(void) {
+    Loaded l;
+    const Kernel *saxpy = l.module.kernel("saxpy");
+    QmdTemplate t;
+    TEST_ASSERT(t.init(l.module, *saxpy, 256));
+
+    // Four launches, QMD and bank 0 side by side in one buffer each
+    Buffer ring = l.allocator.allocate(4 * 512);
+    TEST_ASSERT(ring.valid());
+    CommandBuffer cb(l.allocator);
+    for (uint32_t i = 0; i < 4; i++) {
+        uint8_t *slot = (uint8_t *)ring.cpu() + i * 512;
+        TEST_ASSERT(t.encode(slot, 64 * (i + 1), 1, 1, ring.gpuAddr() + i * 512 + 256));
+        TEST_ASSERT_EQ(64 * (i + 1), qmd::CtaRasterWidth::get((const uint32_t *)slot));
+        TEST_ASSERT(cb.dispatch(ring, i * 512));
+    }
+    TEST_ASSERT(cb.end());
+    Semaphore sem;
+    TEST_ASSERT(l.client.createSemaphore(&sem));
+    TEST_ASSERT(l.client.submit(cb, sem, 1));
+    TEST_ASSERT(l.client.waitSemaphore(sem, 1, 1000));
+    TEST_ASSERT_EQ(4, sim(l.client)->counters().dispatches);
+    TEST_ASSERT_EQ(0, sim(l.client)->counters().faults);
+    l.client.destroySemaphore(sem);
+}
+
+// ============================================================================
+// Cache
+// ============================================================================
+
+void test_qmd_cache(void) {
+    Loaded l;
+    const Kernel *saxpy = l.module.kernel("saxpy");
+    const Kernel *reduce = l.module.kernel("_Z6reducePKfPfi");
+    QmdCache cache;
+
+    const QmdTemplate *a = cache.get(l.module, *saxpy, 256);
+    TEST_ASSERT(a != nullptr);
+    TEST_ASSERT(cache.get(l.module, *saxpy, 256) == a);
+    TEST_ASSERT(cache.get(l.module, *saxpy, 256, 1, 1, 0) == a);
+    TEST_ASSERT(cache.get(l.module, *saxpy, 128) != a);
+    TEST_ASSERT(cache.get(l.module, *saxpy, 256, 1, 1, 1024) != a);
+    TEST_ASSERT(cache.get(l.module, *reduce, 256) != a);
+    TEST_ASSERT(cache.get(l.module, *reduce, 512) == nullptr);  // Failures aren't cached
+    TEST_ASSERT(cache.get(l.module, *reduce, 512) == nullptr);
+
+    QmdCacheStats s = cache.stats();
+    TEST_ASSERT_EQ(8, s.lookups);
+    TEST_ASSERT_EQ(2, s.hits);
+    TEST_ASSERT_EQ(2, s.failures);
+    TEST_ASSERT_EQ(4, s.templates);
+
+    // Concurrent lookups of one shape share a template
+    const QmdTemplate *seen[4] = {};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; i++) {
+        threads.emplace_back([&, i] {
+            for (int r = 0; r < 1000; r++) seen[i] = cache.get(l.module, *saxpy, 64);
+        });
+    }
+    for (auto& th : threads) th.join();
+    for (int i = 1; i < 4; i++) TEST_ASSERT(seen[i] == seen[0]);
+    TEST_ASSERT_EQ(5, cache.stats().templates);
+
+    cache.clear();
+    TEST_ASSERT_EQ(0, cache.stats().templates);
+    TEST_ASSERT(cache.get(l.module, *saxpy, 256) != nullptr);
+}
+
+// A module reloaded into the same Module reuses its Kernel storage, and
+// may land where its predecessor was: the cache must not hand back the
+// old module's template
+void test_qmd_cache_reloaded_module(void) {
+    Loaded l;
+    QmdCache cache;
+    const Kernel *saxpy = l.module.kernel("saxpy");
+    const QmdTemplate *a = cache.get(l.module, *saxpy, 256);
+    TEST_ASSERT(a != nullptr);
+
+    std::vector<TestKernel> kernels = sampleKernels();
+    for (TestKernel& k : kernels) k.registers = 24;
+    std::vector<uint8_t> image = cubin::buildCubin(kernels);
+    TEST_ASSERT(l.module.parse(image.data(), image.size()));
+    TEST_ASSERT(l.module.upload(l.allocator));
+    const Kernel *reloaded = l.module.kernel("saxpy");
+    TEST_ASSERT(reloaded == saxpy);                             // Same storage, new contents
+
+    const QmdTemplate *b = cache.get(l.module, *reloaded, 256);
+    TEST_ASSERT(b != nullptr && b != a);
+    TEST_ASSERT_EQ(24, qmd::RegisterCount::get(b->words()));
+    TEST_ASSERT(cache.get(l.module, *reloaded, 256) == b);
+}
+
+TEST_MAIN("libNVDAAL QMD Builder Tests",
+    TEST_CASE(test_qmd_field_table),
+    TEST_CASE(test_qmd_field_set_get),
+    TEST_CASE(test_qmd_template_fields),
+    TEST_CASE(test_qmd_template_rejects),
+    TEST_CASE(test_qmd_encode),
+    TEST_CASE(test_qmd_dispatch),
+    TEST_CASE(test_qmd_cache),
+    TEST_CASE(test_qmd_cache_reloaded_module)
+)
@@ -0,0 +1,333 @@
+/**
+ * @file test_staging_sim.cpp
+ * @brief Pinned sysmem and staged host/VRAM transfers
+ *
+ * Runs Client::allocSysmem and StagingEngine on SimBackend: sysmem
+ * mapping and copies into it, chunked uploads and downloads through the
+ * copy engine, BAR1 transfers and the threaded streaming copy behind
+ * them, Auto's choice between them, stream ordering and argument checks.
+ *
+ * Compile: make test-staging-sim
+ * Run: ./Build/test_staging_sim
+ */
+
+#include "nvdaal_sim_test.h"
+#include "NVDAALStaging.h"
+#include "NVDAALCopy.h"
+#include "NVDAALUserShared.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+using namespace nvdaal;
+
+static std::vector<uint8_t> pattern(size_t bytes, uint32_t seed) {
+    std::vector<uint8_t> data(bytes);
+    for (size_t i = 0; i < bytes; i++) data[i] = (uint8_t)((i * 2654435761u + seed) >> 7);
+    return data;
+}
+
+// ============================================================================
+// Pinned Sysmem
+// ============================================================================
+
+void test_sysmem_alloc(void) {
+    Client client(makeSimBackend());
+    Sysmem a = {}, b = {};
+    TEST_ASSERT(client.allocSysmem(5000, &a));
+    TEST_ASSERT(client.allocSysmem(4096, &b));
+    TEST_ASSERT_NEQ(0, a.handle);
+    TEST_ASSERT_NEQ(a.handle, b.handle);
+    TEST_ASSERT_EQ(8192, a.size);                          // Page-rounded
+    TEST_ASSERT(a.gpuAddr && a.cpu);
+    TEST_ASSERT(b.gpuAddr >= a.gpuAddr + a.size);
+    TEST_ASSERT_EQ(0, ((uint8_t *)a.cpu)[a.size - 1]);    // Zeroed
+    TEST_ASSERT_EQ(12288, sim(client)->counters().sysmemUsed);
+
+    Sysmem copy = a;
+    memset(a.cpu, 0xAB, a.size);
+    TEST_ASSERT(client.freeSysmem(&a));
+    TEST_ASSERT_EQ(0, a.handle);
+    TEST_ASSERT(!client.freeSysmem(&copy));                // Already gone
+    TEST_ASSERT_EQ(12288, sim(client)->counters().sysmemUsed);  // The driver never unwires it
+
+    Batch batch;
+    batch.add(Op::freeSysmem(copy.handle));
+    TEST_ASSERT(!client.execute(batch));
+    TEST_ASSERT_EQ(kStatusUnsupported, batch.result(0).status);
+
+    Sysmem again = {};
+    TEST_ASSERT(client.allocSysmem(4096, &again));          // Reuses the freed allocation
+    TEST_ASSERT_EQ(copy.handle, again.handle);
+    TEST_ASSERT_EQ(copy.gpuAddr, again.gpuAddr);
+    TEST_ASSERT_EQ(8192, again.size);
+    TEST_ASSERT_EQ(0, ((uint8_t *)again.cpu)[0]);          // Zeroed again
+    TEST_ASSERT_EQ(12288, sim(client)->counters().sysmemUsed);
+
+    Sysmem bad = {};
+    TEST_ASSERT(!client.allocSysmem(0, &bad));
+    TEST_ASSERT(!client.allocSysmem(NVDAAL_MAX_SYSMEM_SIZE + 1, &bad));
+}
+
+void test_sysmem_limit(void) {
+    Client client(makeSimBackend());
+    std::vector<Sysmem> mems(NVDAAL_MAX_SYSMEM_ALLOCS);
+    for (Sysmem& m : mems) TEST_ASSERT(client.allocSysmem(4096, &m));
+    Sysmem extra = {};
+    TEST_ASSERT(!client.allocSysmem(4096, &extra));
+    TEST_ASSERT(client.freeSysmem(&mems[0]));
+    TEST_ASSERT(client.allocSysmem(4096, &extra));
+}
+
+void test_sysmem_copy_engine(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    Sysmem host = {};
+    TEST_ASSERT(client.allocSysmem(8192, &host));
+    Buffer vram = allocator.allocate(8192);
+    std::vector<uint8_t> data = pattern(8192, 1);
+    memcpy(host.cpu, data.data(), data.size());
+
+    // Sysmem -> VRAM -> sysmem at an offset, by GPU VA alone
+    CommandBuffer cb(allocator);
+    TEST_ASSERT(cb.copy(vram.gpuAddr(), host.gpuAddr, 8192));
+    TEST_ASSERT(cb.barrier());
+    TEST_ASSERT(cb.copy(host.gpuAddr + 4096, vram.gpuAddr(), 4096));
+    TEST_ASSERT(cb.end());
+    Semaphore done;
+    TEST_ASSERT(client.createSemaphore(&done));
+    TEST_ASSERT(client.submit(cb, done, 1));
+    TEST_ASSERT(client.waitSemaphore(done, 1));
+
+    TEST_ASSERT_MEM_EQ(data.data(), vram.cpu(), 8192);
+    TEST_ASSERT_MEM_EQ(data.data(), (uint8_t *)host.cpu + 4096, 4096);
+    TEST_ASSERT_EQ(0, sim(client)->counters().faults);
+}
+
+// ============================================================================
+// StagingEngine
+// ============================================================================
+
+void test_staging_upload_chunked(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    StagingConfig config;
+    config.chunkBytes = 64 << 10;
+    StagingEngine engine(client, allocator, config);
+    TEST_ASSERT(engine.valid());
+
+    size_t bytes = (1 << 20) + 1234;                       // 17 chunks, the last partial
+    std::vector<uint8_t> data = pattern(bytes, 2);
+    Buffer dst = allocator.allocate(bytes + 100);
+    TEST_ASSERT(engine.upload(dst, 100, data.data(), bytes));
+    TEST_ASSERT(engine.stream().synchronize());
+    TEST_ASSERT_MEM_EQ(data.data(), (uint8_t *)dst.cpu() + 100, bytes);
+
+    StagingStats s = engine.stats();
+    TEST_ASSERT_EQ(1, s.uploads);
+    TEST_ASSERT_EQ(bytes, s.uploadBytes);
+    TEST_ASSERT_EQ(17, s.chunkCopies);
+    TEST_ASSERT_EQ(0, s.bar1Transfers);
+    TEST_ASSERT_EQ(bytes, sim(client)->counters().copiedBytes);
+}
+
+void test_staging_download_chunked(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    StagingConfig config;
+    config.chunkBytes = 64 << 10;
+    config.chunks = 3;
+    StagingEngine engine(client, allocator, config);
+
+    size_t bytes = 1 << 20;
+    std::vector<uint8_t> data = pattern(bytes, 3);
+    Buffer src = allocator.allocate(bytes);
+    memcpy(src.cpu(), data.data(), bytes);
+
+    std::vector<uint8_t> out(bytes - 10);
+    TEST_ASSERT(engine.download(out.data(), src, 10, out.size()));
+    TEST_ASSERT_MEM_EQ(data.data() + 10, out.data(), out.size());
+
+    StagingStats s = engine.stats();
+    TEST_ASSERT_EQ(1, s.downloads);
+    TEST_ASSERT_EQ(16, s.chunkCopies);
+    TEST_ASSERT(engine.stream().query());                  // Nothing left behind
+}
+
+void test_staging_round_trip_slow_gpu(void) {
+    SimConfig sim;
+    sim.submitLatencyUs = 2000;
+    Client client(makeSimBackend(sim));
+    BufferAllocator allocator(client);
+    StagingConfig config;
+    config.chunkBytes = 16 << 10;
+    StagingEngine engine(client, allocator, config);
+
+    // Every chunk after the second has to wait for its slot to drain
+    size_t bytes = 8 * config.chunkBytes;
+    std::vector<uint8_t> data = pattern(bytes, 4);
+    Buffer buffer = allocator.allocate(bytes);
+    TEST_ASSERT(engine.upload(buffer, 0, data.data(), bytes));
+    TEST_ASSERT(engine.stats().chunkWaits >= 6);
+
+    // Stream order: the download sees the upload without a host sync
+    std::vector<uint8_t> out(bytes);
+    TEST_ASSERT(engine.download(out.data(), buffer, 0, bytes));
+    TEST_ASSERT_MEM_EQ(data.data(), out.data(), bytes);
+}
+
+void test_staging_bar1(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    StagingEngine engine(client, allocator);
+    Buffer buffer = allocator.allocate(256 << 10);
+    std::vector<uint8_t> data = pattern(256 << 10, 5);
+
+    // Auto: small uploads and tiny downloads skip the copy engine
+    TEST_ASSERT(engine.upload(buffer, 0, data.data(), 4096));
+    TEST_ASSERT_EQ(1, engine.stats().bar1Transfers);
+    TEST_ASSERT_MEM_EQ(data.data(), buffer.cpu(), 4096);
+    uint8_t small[256];
+    TEST_ASSERT(engine.download(small, buffer, 0, sizeof(small)));
+    TEST_ASSERT_EQ(2, engine.stats().bar1Transfers);
+    TEST_ASSERT_EQ(0, engine.stats().chunkCopies);
+
+    // Above the thresholds Auto stages; the methods can be forced either way
+    TEST_ASSERT(engine.upload(buffer, 0, data.data(), data.size()));
+    TEST_ASSERT_EQ(1, engine.stats().chunkCopies);
+    TEST_ASSERT(engine.upload(buffer, 0, data.data(), 512, TransferMethod::CopyEngine));
+    TEST_ASSERT_EQ(2, engine.stats().chunkCopies);
+    std::vector<uint8_t> out(data.size());
+    TEST_ASSERT(engine.download(out.data(), buffer, 0, out.size(), TransferMethod::Bar1));
+    TEST_ASSERT_EQ(3, engine.stats().bar1Transfers);
+    TEST_ASSERT_MEM_EQ(data.data(), out.data(), out.size());
+}
+
+void test_stream_copy_threaded(void) {
+    // Line-aligned pieces on 4 threads, from an odd offset
+    size_t bytes = (9 << 20) + 77;
+    std::vector<uint8_t> src = pattern(bytes, 8);
+    std::vector<uint8_t> dst(bytes + 64, 0xEE);
+    StreamCopyConfig config;
+    config.threads = 4;
+    streamCopy(dst.data() + 3, src.data(), bytes, config);
+    TEST_ASSERT_MEM_EQ(src.data(), dst.data() + 3, bytes);
+    TEST_ASSERT_EQ(0xEE, dst[2]);
+    TEST_ASSERT_EQ(0xEE, dst[bytes + 3]);
+
+    std::fill(dst.begin(), dst.end(), 0xEE);
+    streamFill(dst.data() + 1, 0x42, bytes, config);
+    TEST_ASSERT_EQ(0xEE, dst[0]);
+    TEST_ASSERT_EQ(0x42, dst[1]);
+    TEST_ASSERT_EQ(0x42, dst[bytes]);
+    TEST_ASSERT_EQ(0xEE, dst[bytes + 1]);
+    size_t wrong = 0;
+    for (size_t i = 1; i <= bytes; i++) wrong += dst[i] != 0x42;
+    TEST_ASSERT_EQ(0, wrong);
+
+    // Below parallelMin, and zero bytes, stay on the caller
+    streamCopy(dst.data(), src.data(), 100);
+    TEST_ASSERT_MEM_EQ(src.data(), dst.data(), 100);
+    streamCopy(dst.data(), nullptr, 0);
+}
+
+void test_staging_bar1_after_staged(void) {
+    SimConfig sim;
+    sim.submitLatencyUs = 5000;
+    Client client(makeSimBackend(sim));
+    BufferAllocator allocator(client);
+    StagingEngine engine(client, allocator);
+    Buffer buffer = allocator.allocate(128 << 10);
+    std::vector<uint8_t> big = pattern(128 << 10, 6);
+    std::vector<uint8_t> patch = pattern(1024, 7);
+
+    // The staged copy is still queued; the BAR1 write must land after it
+    TEST_ASSERT(engine.upload(buffer, 0, big.data(), big.size()));
+    TEST_ASSERT(engine.upload(buffer, 0, patch.data(), patch.size(), TransferMethod::Bar1));
+    TEST_ASSERT_MEM_EQ(patch.data(), buffer.cpu(), patch.size());
+    TEST_ASSERT_MEM_EQ(big.data() + 1024, (uint8_t *)buffer.cpu() + 1024, big.size() - 1024);
+}
+
+void test_staging_bad_arguments(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    StagingEngine engine(client, allocator);
+    Buffer buffer = allocator.allocate(4096);
+    uint8_t bytes[8192] = {};
+
+    TEST_ASSERT(!engine.upload(buffer, 0, bytes, 4097));
+    TEST_ASSERT(!engine.upload(buffer, 4000, bytes, 100));
+    TEST_ASSERT(!engine.download(bytes, buffer, 4097, 0));
+    TEST_ASSERT(!engine.upload(buffer, 0, nullptr, 16));
+    Buffer none;
+    TEST_ASSERT(!engine.upload(none, 0, bytes, 16));
+    TEST_ASSERT(engine.upload(buffer, 0, bytes, 0));       // Nothing to do
+    TEST_ASSERT_EQ(0, engine.stats().uploads);
+
+    // A buffer the GPU can't reach can't be staged
+    BufferAllocatorConfig cpuOnly;
+    cpuOnly.mapGpu = false;
+    BufferAllocator hostAllocator(client, cpuOnly);
+    Buffer unmapped = hostAllocator.allocate(1 << 20);
+    TEST_ASSERT(!engine.upload(unmapped, 0, bytes, sizeof(bytes), TransferMethod::CopyEngine));
+    TEST_ASSERT(engine.upload(unmapped, 0, bytes, sizeof(bytes)));    // Auto falls back to BAR1
+}
+
+void test_staging_reuses_sysmem(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    StagingConfig config;
+    config.chunkBytes = 1 << 20;
+    config.chunks = 3;
+    for (int i = 0; i < 4; i++) {
+        StagingEngine engine(client, allocator, config);
+        TEST_ASSERT_EQ(3ULL << 20, sim(client)->counters().sysmemUsed);   // The last engine's chunks
+    }
+}
+
+// A spare from freeSysmem() can be larger than the chunks asked for, so
+// the slots differ in size; no chunk may overrun the smaller ones
+void test_staging_mixed_slot_sizes(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    Sysmem big = {};
+    TEST_ASSERT(client.allocSysmem(256 << 10, &big));
+    TEST_ASSERT(client.freeSysmem(&big));
+
+    StagingConfig config;
+    config.chunkBytes = 64 << 10;
+    config.chunks = 3;
+    StagingEngine engine(client, allocator, config);
+    TEST_ASSERT(engine.valid());
+
+    size_t bytes = 1 << 20;
+    std::vector<uint8_t> data = pattern(bytes, 6);
+    Buffer buffer = allocator.allocate(bytes);
+    TEST_ASSERT(engine.upload(buffer, 0, data.data(), bytes));
+    std::vector<uint8_t> out(bytes - 10);
+    TEST_ASSERT(engine.download(out.data(), buffer, 10, out.size()));
+    TEST_ASSERT_MEM_EQ(data.data() + 10, out.data(), out.size());
+    TEST_ASSERT_EQ(0, sim(client)->counters().faults);
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+TEST_MAIN("libNVDAAL Staging Tests",
+    // Pinned Sysmem
+    TEST_CASE(test_sysmem_alloc),
+    TEST_CASE(test_sysmem_limit),
+    TEST_CASE(test_sysmem_copy_engine),
+
+    // StagingEngine
+    TEST_CASE(test_staging_upload_chunked),
+    TEST_CASE(test_staging_download_chunked),
+    TEST_CASE(test_staging_round_trip_slow_gpu),
+    TEST_CASE(test_staging_bar1),
+    TEST_CASE(test_stream_copy_threaded),
+    TEST_CASE(test_staging_bar1_after_staged),
+    TEST_CASE(test_staging_bad_arguments),
+    TEST_CASE(test_staging_reuses_sysmem),
+    TEST_CASE(test_staging_mixed_slot_sizes)
+)
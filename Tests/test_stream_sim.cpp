@@ -0,0 +1,300 @@
+/**
+ * @file test_stream_sim.cpp
+ * @brief Streams on independent channels and cross-stream events
+ *
+ * Runs Streams on SimBackend: channel assignment, in-order submission,
+ * channels that progress independently of a stalled one, copy-engine
+ * streams, GPU-side waits
+ * on another stream's events, wait batching and elision, and host event
+ * queries.
+ *
+ * Compile: make test-stream-sim
+ * Run: ./Build/test_stream_sim
+ */
+
+#include "nvdaal_sim_test.h"
+#include "NVDAALStream.h"
+
+using namespace nvdaal;
+
+// A CommandBuffer that blocks its channel until `gate` reaches 1
+static void recordGate(CommandBuffer& cb, const Semaphore& gate) {
+    cb.begin();
+    cb.wait(gate, 1);
+    cb.end();
+}
+
+// ============================================================================
+// Channels
+// ============================================================================
+
+void test_stream_channels(void) {
+    SimConfig config;
+    config.channels = 2;
+    Client client(makeSimBackend(config));
+    BufferAllocator allocator(client);
+    TEST_ASSERT_EQ(2, client.getChannelCount());
+
+    Stream a(client, allocator);
+    Stream b(client, allocator);
+    Stream c(client, allocator, 5);                      // Wraps onto the booted channels
+    TEST_ASSERT(a.valid() && b.valid() && c.valid());
+    TEST_ASSERT(a.channel() != b.channel());
+    TEST_ASSERT_EQ(1, c.channel());
+
+    // The driver rejects channels it did not boot
+    Buffer pb = allocator.allocate(64);
+    TEST_ASSERT(!client.submitPushbuffer(pb.gpuAddr(), 8, 2));
+}
+
+void test_stream_order(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    Buffer src = allocator.allocate(4096);
+    Buffer mid = allocator.allocate(4096);
+    Buffer dst = allocator.allocate(4096);
+    memset(src.cpu(), 0x5A, 4096);
+    memset(mid.cpu(), 0, 4096);
+    memset(dst.cpu(), 0, 4096);
+
+    Stream stream(client, allocator);
+    CommandBuffer first(allocator), second(allocator);
+    TEST_ASSERT(first.copy(mid, 0, src, 0, 4096) && first.end());
+    TEST_ASSERT(second.copy(dst, 0, mid, 0, 4096) && second.end());
+    TEST_ASSERT(stream.submit(first));
+    TEST_ASSERT(stream.submit(second));
+
+    Event done = stream.record();
+    TEST_ASSERT_EQ(2, done.value);                       // One timeline step per submission
+    TEST_ASSERT(done.synchronize());
+    TEST_ASSERT(stream.query());
+    TEST_ASSERT_EQ(0x5A, ((uint8_t *)dst.cpu())[4095]);
+    TEST_ASSERT_EQ(2, stream.stats().submissions);
+}
+
+void test_stream_independent(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    Semaphore gate;
+    TEST_ASSERT(client.createSemaphore(&gate));
+
+    Stream blocked(client, allocator, 0);
+    Stream other(client, allocator, 1);
+    CommandBuffer wait(allocator), work(allocator);
+    recordGate(wait, gate);
+    TEST_ASSERT(work.barrier() && work.end());
+
+    // A stalled channel holds up only its own stream
+    TEST_ASSERT(blocked.submit(wait));
+    TEST_ASSERT(other.submit(work));
+    TEST_ASSERT(other.synchronize(1000));
+    TEST_ASSERT(!blocked.query());
+
+    TEST_ASSERT(client.signalSemaphore(gate, 1));
+    TEST_ASSERT(blocked.synchronize(1000));
+}
+
+void test_stream_copy_engine(void) {
+    SimConfig config;
+    config.copyChannels = 1;
+    Client client(makeSimBackend(config));
+    BufferAllocator allocator(client);
+    Semaphore gate;
+    TEST_ASSERT(client.createSemaphore(&gate));
+
+    Stream compute(client, allocator);
+    Stream copies(client, allocator, kCopyChannel | 3);     // Wraps onto the booted copy channels
+    TEST_ASSERT(copies.valid());
+    TEST_ASSERT(copies.copyEngine());
+    TEST_ASSERT(!compute.copyEngine());
+    TEST_ASSERT_EQ(kCopyChannel, copies.channel());
+
+    Buffer src = allocator.allocate(4096);
+    Buffer dst = allocator.allocate(4096);
+    memset(src.cpu(), 0x3C, 4096);
+    memset(dst.cpu(), 0, 4096);
+    CommandBuffer wait(allocator), copy(allocator);
+    recordGate(wait, gate);
+    TEST_ASSERT(copy.copy(dst, 0, src, 0, 4096) && copy.end());
+
+    // Copies proceed while every compute channel is stalled, and compute
+    // work can wait on them like on any stream
+    TEST_ASSERT(compute.submit(wait));
+    TEST_ASSERT(copies.submit(copy));
+    Event copied = copies.record();
+    TEST_ASSERT(copied.synchronize());
+    TEST_ASSERT(!compute.query());
+    TEST_ASSERT_EQ(0x3C, ((uint8_t *)dst.cpu())[4095]);
+    TEST_ASSERT(compute.wait(copied));
+
+    TEST_ASSERT(client.signalSemaphore(gate, 1));
+    TEST_ASSERT(compute.synchronize(1000));
+    TEST_ASSERT_EQ(0, sim(client)->counters().faults);
+}
+
+void test_stream_copy_fallback(void) {
+    SimConfig config;
+    config.channels = 2;
+    config.copyChannels = 0;
+    Client client(makeSimBackend(config));
+    BufferAllocator allocator(client);
+    TEST_ASSERT_EQ(0, client.getCopyChannelCount());
+
+    // Without a copy engine the stream lands on a compute channel
+    Stream copies(client, allocator, kCopyChannel);
+    TEST_ASSERT(copies.valid());
+    TEST_ASSERT(!copies.copyEngine());
+    TEST_ASSERT(copies.channel() < 2);
+
+    Buffer pb = allocator.allocate(64);
+    TEST_ASSERT(!client.submitPushbuffer(pb.gpuAddr(), 8, kCopyChannel));
+}
+
+// ============================================================================
+// Events
+// ============================================================================
+
+void test_stream_cross_event(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    Buffer src = allocator.allocate(4096);
+    Buffer mid = allocator.allocate(4096);
+    Buffer dst = allocator.allocate(4096);
+    memset(src.cpu(), 0xC3, 4096);
+    memset(mid.cpu(), 0, 4096);
+    memset(dst.cpu(), 0, 4096);
+    Semaphore gate;
+    TEST_ASSERT(client.createSemaphore(&gate));
+
+    Stream copyIn(client, allocator, 0);
+    Stream consume(client, allocator, 1);
+    CommandBuffer hold(allocator), upload(allocator), use(allocator);
+    recordGate(hold, gate);
+    TEST_ASSERT(upload.copy(mid, 0, src, 0, 4096) && upload.end());
+    TEST_ASSERT(use.copy(dst, 0, mid, 0, 4096) && use.end());
+
+    TEST_ASSERT(copyIn.submit(hold));
+    TEST_ASSERT(copyIn.submit(upload));
+    Event uploaded = copyIn.record();
+
+    // The wait is on the GPU: nothing here blocks, and `use` doesn't run early
+    uint64_t calls = sim(client)->counters().calls;
+    TEST_ASSERT(consume.wait(uploaded));
+    TEST_ASSERT_EQ(calls, sim(client)->counters().calls);   // Deferred to the next submit
+    TEST_ASSERT(consume.submit(use));
+    Event consumed = consume.record();
+    TEST_ASSERT(!consumed.synchronize(30));
+    TEST_ASSERT(!uploaded.query());
+    TEST_ASSERT_EQ(0, ((uint8_t *)dst.cpu())[0]);
+
+    TEST_ASSERT(client.signalSemaphore(gate, 1));
+    TEST_ASSERT(consumed.synchronize(1000));
+    TEST_ASSERT(uploaded.query());
+    TEST_ASSERT_EQ(0xC3, ((uint8_t *)dst.cpu())[4095]);
+
+    StreamStats s = consume.stats();
+    TEST_ASSERT_EQ(1, s.acquires);
+    TEST_ASSERT_EQ(1, s.waitSubmissions);
+    TEST_ASSERT_EQ(1, s.submissions);
+}
+
+void test_stream_wait_batching(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    Stream a(client, allocator), b(client, allocator), c(client, allocator);
+    CommandBuffer work(allocator);
+    TEST_ASSERT(work.barrier() && work.end());
+
+    TEST_ASSERT(a.submit(work));
+    Event a1 = a.record();
+    TEST_ASSERT(a.submit(work));
+    Event a2 = a.record();
+    TEST_ASSERT(b.submit(work));
+    Event b1 = b.record();
+    TEST_ASSERT(c.submit(work));
+
+    TEST_ASSERT(c.wait(Event()));                        // Never recorded
+    TEST_ASSERT(c.wait(c.record()));                     // Own timeline
+    TEST_ASSERT(c.wait(a1));
+    TEST_ASSERT(c.wait(a2));                             // Replaces a1
+    TEST_ASSERT(c.wait(b1));
+    TEST_ASSERT(c.submit(work));
+    TEST_ASSERT(c.synchronize());
+
+    StreamStats s = c.stats();
+    TEST_ASSERT_EQ(5, s.waits);
+    TEST_ASSERT_EQ(3, s.waitsElided);
+    TEST_ASSERT_EQ(2, s.acquires);                       // a2 and b1
+    TEST_ASSERT_EQ(1, s.waitSubmissions);                // In one pushbuffer
+
+    // Events from another client's timelines can't be waited on
+    Client other(makeSimBackend());
+    TEST_ASSERT(other.connect());
+    Event foreign = { &other, a1.sem, 1 };
+    TEST_ASSERT(!c.wait(foreign));
+}
+
+void test_stream_slot_reuse(void) {
+    SimConfig config;
+    config.submitLatencyUs = 20;
+    Client client(makeSimBackend(config));
+    BufferAllocator allocator(client);
+    Stream producer(client, allocator, 0);
+    Stream consumer(client, allocator, 1);
+    CommandBuffer work(allocator);
+    TEST_ASSERT(work.barrier() && work.end());
+
+    // More waits than slots: slots are reused once the timeline passes them
+    for (int i = 0; i < 150; i++) {
+        TEST_ASSERT(producer.submit(work));
+        TEST_ASSERT(consumer.wait(producer.record()));
+        TEST_ASSERT(consumer.submit(work));
+    }
+    TEST_ASSERT(consumer.synchronize(5000));
+    TEST_ASSERT(producer.query());
+    TEST_ASSERT_EQ(150, consumer.stats().waitSubmissions);
+    TEST_ASSERT_EQ(300, consumer.record().value);
+}
+
+void test_event_host(void) {
+    Client client(makeSimBackend());
+    BufferAllocator allocator(client);
+    Semaphore gate;
+    TEST_ASSERT(client.createSemaphore(&gate));
+
+    Event none;
+    TEST_ASSERT(none.query());
+    TEST_ASSERT(none.synchronize(0));
+
+    Stream stream(client, allocator);
+    TEST_ASSERT(!stream.record().recorded());            // Nothing submitted yet
+    CommandBuffer hold(allocator);
+    recordGate(hold, gate);
+    TEST_ASSERT(stream.submit(hold));
+    Event e = stream.record();
+    TEST_ASSERT(e.recorded());
+    TEST_ASSERT(!e.query());
+    TEST_ASSERT(!e.synchronize(10));
+    TEST_ASSERT(client.signalSemaphore(gate, 1));
+    TEST_ASSERT(e.synchronize(1000));
+    TEST_ASSERT(e.query());
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+TEST_MAIN("libNVDAAL Stream Tests",
+    // Channels
+    TEST_CASE(test_stream_channels),
+    TEST_CASE(test_stream_order),
+    TEST_CASE(test_stream_independent),
+    TEST_CASE(test_stream_copy_engine),
+    TEST_CASE(test_stream_copy_fallback),
+
+    // Events
+    TEST_CASE(test_stream_cross_event),
+    TEST_CASE(test_stream_wait_batching),
+    TEST_CASE(test_stream_slot_reuse),
+    TEST_CASE(test_event_host)
+)
@@ -0,0 +1,154 @@
+/**
+ * @file test_wc_copy.c
+ * @brief Unit tests for the write-combining copy and fill kernels
+ *
+ * Runs every store width NVDAALWcCopy.h offers on this CPU over all
+ * source and destination alignments within a cache line and lengths
+ * around the line and unroll boundaries, and checks the bytes around the
+ * range are untouched.
+ *
+ * Compile: make test-wc-copy
+ * Run: ./Build/test_wc_copy
+ */
+
+#include "nvdaal_test.h"
+#include "../Sources/NVDAALWcCopy.h"
+
+#define GUARD   64
+#define MAX_LEN (NV_WC_LINE * NV_WC_UNROLL_LINES * 3 + 2 * NV_WC_LINE)
+
+static uint8_t srcBuf[MAX_LEN + 2 * GUARD] __attribute__((aligned(64)));
+static uint8_t dstBuf[MAX_LEN + 2 * GUARD] __attribute__((aligned(64)));
+
+static const size_t kLengths[] = {
+    0, 1, 7, 8, 63, 64, 65, 127, 128, 129, 255, 256, 257, 511, 512, 513,
+    NV_WC_LINE * NV_WC_UNROLL_LINES * 3 + NV_WC_LINE - 1, MAX_LEN
+};
+
+static void fillPattern(uint8_t *p, size_t n, uint8_t seed) {
+    for (size_t i = 0; i < n; i++) p[i] = (uint8_t)(i * 31 + seed);
+}
+
+// True if dstBuf holds srcBuf[srcOff..] at dstOff and 0xEE everywhere else
+static int copyIntact(size_t dstOff, size_t srcOff, size_t len) {
+    for (size_t i = 0; i < sizeof(dstBuf); i++) {
+        uint8_t want = i >= dstOff && i < dstOff + len ? srcBuf[srcOff + i - dstOff] : 0xEE;
+        if (dstBuf[i] != want) return 0;
+    }
+    return 1;
+}
+
+static int fillIntact(size_t dstOff, size_t len, uint8_t value) {
+    for (size_t i = 0; i < sizeof(dstBuf); i++) {
+        uint8_t want = i >= dstOff && i < dstOff + len ? value : 0xEE;
+        if (dstBuf[i] != want) return 0;
+    }
+    return 1;
+}
+
+static void checkCopy(NvWcIsa isa) {
+    fillPattern(srcBuf, sizeof(srcBuf), 3);
+    for (size_t l = 0; l < sizeof(kLengths) / sizeof(kLengths[0]); l++) {
+        int ok = 1;
+        for (size_t dstAlign = 0; dstAlign < NV_WC_LINE && ok; dstAlign++) {
+            size_t srcAlign = (dstAlign * 7 + l) % NV_WC_LINE;
+            memset(dstBuf, 0xEE, sizeof(dstBuf));
+            nvWcCopyIsa(isa, dstBuf + GUARD + dstAlign, srcBuf + GUARD + srcAlign, kLengths[l]);
+            if (!copyIntact(GUARD + dstAlign, GUARD + srcAlign, kLengths[l])) {
+                printf("    %s: copy of %zu bytes, dst +%zu src +%zu\n",
+                       nvWcIsaName(isa), kLengths[l], dstAlign, srcAlign);
+                ok = 0;
+            }
+        }
+        TEST_ASSERT(ok);
+    }
+}
+
+static void checkFill(NvWcIsa isa) {
+    for (size_t l = 0; l < sizeof(kLengths) / sizeof(kLengths[0]); l++) {
+        int ok = 1;
+        for (size_t dstAlign = 0; dstAlign < NV_WC_LINE && ok; dstAlign++) {
+            uint8_t value = (uint8_t)(0x5A + dstAlign);
+            memset(dstBuf, 0xEE, sizeof(dstBuf));
+            nvWcFillIsa(isa, dstBuf + GUARD + dstAlign, value, kLengths[l]);
+            if (!fillIntact(GUARD + dstAlign, kLengths[l], value)) {
+                printf("    %s: fill of %zu bytes, dst +%zu\n", nvWcIsaName(isa), kLengths[l], dstAlign);
+                ok = 0;
+            }
+        }
+        TEST_ASSERT(ok);
+    }
+}
+
+// ============================================================================
+// Copy
+// ============================================================================
+
+void test_copy_plain(void) { checkCopy(NV_WC_PLAIN); }
+void test_copy_gpr(void) { checkCopy(NV_WC_GPR); }
+void test_copy_sse2(void) { checkCopy(NV_WC_SSE2); }
+void test_copy_avx(void) { checkCopy(NV_WC_AVX); }
+void test_copy_avx512(void) { checkCopy(NV_WC_AVX512); }
+
+// ============================================================================
+// Fill
+// ============================================================================
+
+void test_fill_gpr(void) { checkFill(NV_WC_GPR); }
+void test_fill_sse2(void) { checkFill(NV_WC_SSE2); }
+void test_fill_avx(void) { checkFill(NV_WC_AVX); }
+void test_fill_avx512(void) { checkFill(NV_WC_AVX512); }
+
+// memcpy/memset with a null pointer are undefined even for zero bytes
+void test_empty_null(void) {
+    for (int isa = NV_WC_PLAIN; isa <= NV_WC_AVX512; isa++) {
+        nvWcCopyIsa((NvWcIsa)isa, NULL, NULL, 0);
+        nvWcCopyIsa((NvWcIsa)isa, dstBuf, NULL, 0);
+        nvWcFillIsa((NvWcIsa)isa, NULL, 0xAB, 0);
+    }
+    TEST_ASSERT(1);
+}
+
+// ============================================================================
+// Selection
+// ============================================================================
+
+void test_best_isa_supported(void) {
+    NvWcIsa best = nvWcBestIsa();
+    TEST_ASSERT(best != NV_WC_PLAIN);
+    TEST_ASSERT(nvWcIsaSupported(best));
+    TEST_ASSERT(nvWcIsaSupported(NV_WC_GPR));
+    printf("    best: %s, avx512 %s\n", nvWcIsaName(best), nvWcIsaSupported(NV_WC_AVX512) ? "yes" : "no");
+
+    // The default entry points use it
+    fillPattern(srcBuf, sizeof(srcBuf), 9);
+    memset(dstBuf, 0xEE, sizeof(dstBuf));
+    nvWcCopy(dstBuf + GUARD + 5, srcBuf + GUARD, 1000);
+    TEST_ASSERT(copyIntact(GUARD + 5, GUARD, 1000));
+    memset(dstBuf, 0xEE, sizeof(dstBuf));
+    nvWcFill(dstBuf + GUARD + 1, 0, 700);
+    TEST_ASSERT(fillIntact(GUARD + 1, 700, 0));
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+TEST_MAIN("NVDAAL Write-Combining Copy Tests",
+    // Copy
+    TEST_CASE(test_copy_plain),
+    TEST_CASE(test_copy_gpr),
+    TEST_CASE(test_copy_sse2),
+    TEST_CASE(test_copy_avx),
+    TEST_CASE(test_copy_avx512),
+
+    // Fill
+    TEST_CASE(test_fill_gpr),
+    TEST_CASE(test_fill_sse2),
+    TEST_CASE(test_fill_avx),
+    TEST_CASE(test_fill_avx512),
+    TEST_CASE(test_empty_null),
+
+    // Selection
+    TEST_CASE(test_best_isa_supported)
+)
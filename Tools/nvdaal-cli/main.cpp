@@ -3,11 +3,16 @@
  *
  * Usage: nvdaal-cli boot <firmware_dir>
  *        nvdaal-cli load <gsp.bin>
+ *        nvdaal-cli stats [--once] [interval_ms]
  */
 
 #include <iostream>
 #include <string>
 #include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <chrono>
 #include "../../Library/libNVDAAL.h"
 
 void print_usage(const char *prog) {
@@ -18,6 +23,7 @@ void print_usage(const char *prog) {
     std::cout << "  boot <firmware_dir>   Full boot sequence with all firmwares\n";
     std::cout << "  load <firmware.bin>   Load GSP firmware only (legacy)\n";
     std::cout << "  test                  Verify VRAM allocation and Queue kicking\n";
+    std::cout << "  stats [--once] [ms]   Live per-method driver call statistics (all clients)\n";
     std::cout << "\n";
     std::cout << "Full Boot Sequence (boot command):\n";
     std::cout << "  Expects these files in <firmware_dir>:\n";
@@ -271,6 +277,55 @@ int cmd_test() {
     return 0;
 }
 
+static void print_stats(const nvdaal::CallStats& now, const nvdaal::CallStats *prev, double intervalSec) {
+    printf("%-22s %10s %9s %7s %9s %8s %8s %10s\n",
+           "method", "calls", "calls/s", "errors", "mean(us)", "p50(us)", "p99(us)", "max(us)");
+    for (size_t i = 0; i < now.methods.size(); i++) {
+        const nvdaal::MethodStats& m = now.methods[i];
+        if (!m.calls) continue;
+
+        double rate = 0.0;
+        if (prev && i < prev->methods.size() && intervalSec > 0) {
+            rate = (m.calls - prev->methods[i].calls) / intervalSec;
+        }
+        printf("%-22s %10llu %9.0f %7llu %9.1f %8llu %8llu %10.1f\n",
+               m.name, (unsigned long long)m.calls, rate, (unsigned long long)m.errors,
+               m.meanUs(), (unsigned long long)m.percentileUs(500),
+               (unsigned long long)m.percentileUs(990), m.maxNs / 1000.0);
+    }
+}
+
+int cmd_stats(bool once, uint32_t intervalMs) {
+    nvdaal::Client client;
+
+    if (!client.connect()) {
+        std::cerr << "[-] Error: Could not connect to driver." << std::endl;
+        return 1;
+    }
+
+    // Per-client counters are published as "CallStats" on each
+    // NVDAALUserClient: ioreg -r -c NVDAALUserClient -l
+    nvdaal::CallStats prev;
+    bool havePrev = false;
+    for (;;) {
+        nvdaal::CallStats now;
+        if (!client.getStats(&now, nvdaal::StatsScope::Global)) {
+            std::cerr << "[-] Error: Could not read driver statistics." << std::endl;
+            return 1;
+        }
+
+        if (!once) printf("\033[H\033[2J");
+        printf("NVDAAL driver calls (all clients, every %u ms)\n\n", intervalMs);
+        print_stats(now, havePrev ? &prev : nullptr, intervalMs / 1000.0);
+        fflush(stdout);
+        if (once) return 0;
+
+        prev = now;
+        havePrev = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+    }
+}
+
 int main(int argc, char *argv[]) {
     if (argc < 2) {
         print_usage(argv[0]);
@@ -304,6 +359,16 @@ int main(int argc, char *argv[]) {
         return cmd_load_firmware(argv[2]);
     } else if (command == "test") {
         return cmd_test();
+    } else if (command == "stats") {
+        bool once = false;
+        uint32_t intervalMs = 1000;
+        for (int i = 2; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--once") once = true;
+            else intervalMs = (uint32_t)strtoul(argv[i], nullptr, 0);
+        }
+        if (intervalMs == 0) intervalMs = 1000;
+        return cmd_stats(once, intervalMs);
     } else {
         std::cerr << "Unknown command: " << command << std::endl;
         print_usage(argv[0]);
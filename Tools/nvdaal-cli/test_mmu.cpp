@@ -1,6 +1,11 @@
 #include "../../Library/libNVDAAL.h"
 #include <iostream>
 #include <cassert>
+#include <vector>
+#include <cstring>
+#include <future>
+#include <chrono>
+#include <dispatch/dispatch.h>
 
 int main() {
     nvdaal::Client gpu;
@@ -24,10 +29,129 @@ int main() {
 
     std::cout << "MMU Test PASSED!" << std::endl;
 
+    std::cout << "Testing VRAM CPU Mapping..." << std::endl;
+    const size_t kMapBytes = 256 * 1024;
+    uint64_t mapOffset = gpu.allocVram(kMapBytes);
+    assert(mapOffset != 0);
+
+    // Upload through a write-combined mapping, read back uncached
+    size_t mappedSize = 0;
+    uint32_t *upload = (uint32_t *)gpu.mapVramCpu(mapOffset, nvdaal::CacheMode::WriteCombined, &mappedSize);
+    assert(upload && mappedSize >= kMapBytes);
+    std::vector<uint32_t> pattern(kMapBytes / sizeof(uint32_t));
+    for (size_t i = 0; i < pattern.size(); i++) pattern[i] = (uint32_t)(i * 2654435761u);
+    memcpy(upload, pattern.data(), kMapBytes);
+
+    const uint32_t *readback = (const uint32_t *)gpu.mapVramCpu(mapOffset, nvdaal::CacheMode::Uncached);
+    assert(readback);
+    assert(memcmp(readback, pattern.data(), kMapBytes) == 0);
+    assert(gpu.unmapVramCpu(mapOffset, (void *)readback));
+    assert(gpu.unmapVramCpu(mapOffset, upload));
+
+    // Only allocations this client owns can be mapped
+    assert(gpu.mapVramCpu(mapOffset + 0x1000) == nullptr);
+    std::cout << "VRAM CPU Mapping Test PASSED!" << std::endl;
+
     std::cout << "Testing Sync primitive..." << std::endl;
-    bool ok = gpu.waitSemaphore(addr1, 1);
-    assert(ok);
+    nvdaal::Semaphore sems[2];
+    assert(gpu.createSemaphore(&sems[0], 0));
+    assert(gpu.createSemaphore(&sems[1], 0));
+
+    // Unsignaled semaphore must time out
+    assert(!gpu.waitSemaphore(sems[0], 1, 10));
+
+    // Host release, then wait-any reports which one fired
+    assert(gpu.signalSemaphore(sems[1], 5));
+    uint64_t values[2] = { 1, 5 };
+    uint32_t index = 0;
+    assert(gpu.waitSemaphores(sems, values, 2, nvdaal::WaitMode::Any, 100, &index));
+    assert(index == 1);
+    assert(!gpu.waitSemaphores(sems, values, 2, nvdaal::WaitMode::All, 10));
+
+    // Timeline semaphores never move backwards
+    uint64_t value = 0;
+    assert(gpu.signalSemaphore(sems[1], 3));
+    assert(gpu.readSemaphore(sems[1], &value) && value == 5);
+
+    gpu.destroySemaphore(sems[0]);
+    gpu.destroySemaphore(sems[1]);
     std::cout << "Sync Test PASSED!" << std::endl;
 
+    std::cout << "Testing Command Ring..." << std::endl;
+    assert(gpu.openCommandRing());
+
+    nvdaal::Semaphore ringSem;
+    assert(gpu.createSemaphore(&ringSem, 0));
+
+    // Many small ops, one kernel entry per ring-full; results stay in order
+    const uint32_t kOps = 2000;
+    std::vector<nvdaal::Op> ops;
+    for (uint32_t i = 0; i < kOps; i++) {
+        ops.push_back(i % 2 ? nvdaal::Op::readSemaphore(ringSem, i)
+                            : nvdaal::Op::signalSemaphore(ringSem, i + 2, i));
+    }
+    ops.push_back(nvdaal::Op::query(nvdaal::Query::ChipId, kOps));
+    std::vector<nvdaal::OpResult> results(ops.size());
+    assert(gpu.execute(ops.data(), (uint32_t)ops.size(), results.data()));
+    for (uint32_t i = 0; i < kOps; i++) {
+        assert(results[i].cookie == i);
+        if (i % 2) assert(results[i].values[0] == i + 1);
+    }
+    assert(results[kOps].values[0] != 0);
+
+    gpu.destroySemaphore(ringSem);
+    gpu.closeCommandRing();
+    std::cout << "Command Ring Test PASSED!" << std::endl;
+
+    std::cout << "Testing Batched Calls..." << std::endl;
+    nvdaal::Batch batch;
+    uint32_t allocIdx = batch.allocVram(64 * 1024);
+    uint32_t chipIdx = batch.query(nvdaal::Query::ChipId);
+    assert(gpu.execute(batch));
+    assert(batch.result(chipIdx).values[0] != 0);
+
+    // Reuse the batch: map what was allocated, then unmap it
+    uint64_t vramOffset = batch.result(allocIdx).values[0];
+    batch.clear();
+    uint32_t mapIdx = batch.mapVram(vramOffset, 64 * 1024);
+    assert(gpu.execute(batch));
+    uint64_t gpuAddr = batch.result(mapIdx).values[0];
+    assert(gpuAddr != 0);
+
+    batch.clear();
+    batch.add(nvdaal::Op::unmapVram(gpuAddr, 64 * 1024));
+    assert(gpu.execute(batch, true));
+    std::cout << "Batched Calls Test PASSED!" << std::endl;
+
+    std::cout << "Testing Async Notifications..." << std::endl;
+    dispatch_queue_t queue = dispatch_queue_create("com.nvdaal.test.notify", DISPATCH_QUEUE_SERIAL);
+    assert(gpu.setNotificationQueue(queue));
+
+    nvdaal::Semaphore notifySem;
+    assert(gpu.createSemaphore(&notifySem, 0));
+
+    std::promise<nvdaal::Notification> fired;
+    std::future<nvdaal::Notification> firedFuture = fired.get_future();
+    uint32_t notifyId = gpu.notifyOnSemaphore(notifySem, 7, [&](const nvdaal::Notification& n) {
+        fired.set_value(n);
+    });
+    assert(notifyId != 0);
+
+    // Nothing until the payload reaches 7, then exactly one message
+    assert(firedFuture.wait_for(std::chrono::milliseconds(50)) == std::future_status::timeout);
+    assert(gpu.signalSemaphore(notifySem, 7));
+    assert(firedFuture.wait_for(std::chrono::seconds(1)) == std::future_status::ready);
+    nvdaal::Notification n = firedFuture.get();
+    assert(n.id == notifyId && n.kind == nvdaal::NotifyKind::Semaphore);
+    assert(n.status == 0 && n.values[0] == 7);
+
+    uint32_t errorId = gpu.notifyOnChannelError([](const nvdaal::Notification&) {});
+    assert(errorId != 0);
+    assert(gpu.cancelNotification(errorId));
+    assert(!gpu.cancelNotification(errorId));
+
+    gpu.destroySemaphore(notifySem);
+    std::cout << "Async Notification Test PASSED!" << std::endl;
+
     return 0;
 }